@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <tuple>
 #include <type_traits>
@@ -23,6 +24,59 @@ enum ConnectionType {
 	ConnectionTypeBlocking,
 };
 
+namespace details {
+
+class MemoryPool
+{
+public:
+	static void *allocate(std::size_t size);
+	static void deallocate(void *ptr, std::size_t size) noexcept;
+};
+
+template<typename T>
+class PoolAllocator
+{
+public:
+	using value_type = T;
+
+	PoolAllocator() = default;
+
+	template<typename U>
+	PoolAllocator([[maybe_unused]] const PoolAllocator<U> &other)
+	{
+	}
+
+	T *allocate(std::size_t n)
+	{
+		if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			return std::allocator<T>().allocate(n);
+		else
+			return static_cast<T *>(MemoryPool::allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T *ptr, std::size_t n) noexcept
+	{
+		if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+			std::allocator<T>().deallocate(ptr, n);
+		else
+			MemoryPool::deallocate(ptr, n * sizeof(T));
+	}
+
+	template<typename U>
+	bool operator==([[maybe_unused]] const PoolAllocator<U> &other) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=([[maybe_unused]] const PoolAllocator<U> &other) const
+	{
+		return false;
+	}
+};
+
+} /* namespace details */
+
 class BoundMethodPackBase
 {
 public:
@@ -72,6 +126,16 @@ public:
 	}
 	virtual ~BoundMethodBase() = default;
 
+	static void *operator new(std::size_t size)
+	{
+		return details::MemoryPool::allocate(size);
+	}
+
+	static void operator delete(void *ptr, std::size_t size) noexcept
+	{
+		details::MemoryPool::deallocate(ptr, size);
+	}
+
 	template<typename T, std::enable_if_t<!std::is_same<Object, T>::value> * = nullptr>
 	bool match(T *obj) { return obj == obj_; }
 	bool match(Object *object) { return object == object_; }
@@ -145,7 +209,8 @@ public:
 		if (!this->object_)
 			return func_(args...);
 
-		auto pack = std::make_shared<PackType>(args...);
+		auto pack = std::allocate_shared<PackType>(details::PoolAllocator<PackType>(),
+							   args...);
 		bool sync = BoundMethodBase::activatePack(pack, deleteMethod);
 		return sync ? pack->returnValue() : R();
 	}
@@ -180,7 +245,8 @@ public:
 			return (obj->*func_)(args...);
 		}
 
-		auto pack = std::make_shared<PackType>(args...);
+		auto pack = std::allocate_shared<PackType>(details::PoolAllocator<PackType>(),
+							   args...);
 		bool sync = BoundMethodBase::activatePack(pack, deleteMethod);
 		return sync ? pack->returnValue() : R();
 	}
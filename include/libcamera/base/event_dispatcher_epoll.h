@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Epoll-based event dispatcher
+ */
+
+#pragma once
+
+#include <map>
+#include <stdint.h>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/timer_queue.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+class EventNotifier;
+class Timer;
+
+class EventDispatcherEpoll final : public EventDispatcher
+{
+public:
+	EventDispatcherEpoll();
+	~EventDispatcherEpoll();
+
+	void registerEventNotifier(EventNotifier *notifier);
+	void unregisterEventNotifier(EventNotifier *notifier);
+
+	void registerTimer(Timer *timer);
+	void unregisterTimer(Timer *timer);
+
+	void processEvents();
+	void interrupt();
+
+private:
+	struct EventNotifierSetEpoll {
+		uint32_t events() const;
+		EventNotifier *notifiers[3];
+	};
+
+	void updateNotifiers(int fd, uint32_t oldEvents, uint32_t newEvents);
+	void armTimer();
+	void processInterrupt();
+	void processTimerExpiry();
+	void processNotifiers(int fd, uint32_t events);
+	void processTimers();
+
+	std::map<int, EventNotifierSetEpoll> notifiers_;
+	TimerQueue timers_;
+	utils::time_point armedDeadline_;
+
+	UniqueFD epollfd_;
+	UniqueFD eventfd_;
+	UniqueFD timerfd_;
+
+	bool processingEvents_;
+};
+
+} /* namespace libcamera */
@@ -107,10 +107,48 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
 #ifndef __DOXYGEN__
 #define _LOG_CATEGORY(name) logCategory##name
 
-#define _LOG1(severity) \
-	_log(nullptr, Log##severity).stream()
-#define _LOG2(category, severity) \
-	_log(&_LOG_CATEGORY(category)(), Log##severity).stream()
+#ifndef LIBCAMERA_LOG_MIN_SEVERITY
+#define LIBCAMERA_LOG_MIN_SEVERITY 0
+#endif
+
+static_assert(LIBCAMERA_LOG_MIN_SEVERITY >= LogDebug &&
+	      LIBCAMERA_LOG_MIN_SEVERITY < LogFatal,
+	      "Fatal log messages can't be compiled out");
+
+namespace details {
+
+/*
+ * Give the log stream the void type of the disabled branch of the conditional
+ * operator in the LOG() macro. The & operator has a lower precedence than <<
+ * and a higher precedence than ?:, it thus applies to the whole log stream.
+ */
+struct LogVoidify {
+	void operator&(std::ostream &) {}
+};
+
+} /* namespace details */
+
+/*
+ * Check whether a message is disabled before constructing it. The category is
+ * passed as a function to skip its lookup when the severity is below the
+ * compile-time minimum.
+ */
+inline bool _logDisabled(const LogCategory &(*category)(), LogSeverity severity)
+{
+	return severity < LIBCAMERA_LOG_MIN_SEVERITY ||
+	       severity < category().severity();
+}
+
+#define _LOG1(severity)							\
+	_logDisabled(LogCategory::defaultCategory, Log##severity)	\
+		? (void)0						\
+		: libcamera::details::LogVoidify() &			\
+		  _log(nullptr, Log##severity).stream()
+#define _LOG2(category, severity)					\
+	_logDisabled(_LOG_CATEGORY(category), Log##severity)		\
+		? (void)0						\
+		: libcamera::details::LogVoidify() &			\
+		  _log(&_LOG_CATEGORY(category)(), Log##severity).stream()
 
 /*
  * Expand the LOG() macro to _LOG1() or _LOG2() based on the number of
@@ -16,6 +16,7 @@
 namespace libcamera {
 
 class BoundMethodBase;
+class MessageQueue;
 class Object;
 class Semaphore;
 class Thread;
@@ -40,10 +41,13 @@ public:
 	static Type registerMessageType();
 
 private:
+	friend class MessageQueue;
 	friend class Thread;
 
 	Type type_;
 	Object *receiver_;
+	/* Link in the queue of posted messages of the receiver's thread */
+	Message *next_;
 
 	static std::atomic_uint nextUserType_;
 };
@@ -57,6 +61,9 @@ public:
 		      bool deleteMethod = false);
 	~InvokeMessage();
 
+	static void *operator new(std::size_t size);
+	static void operator delete(void *ptr, std::size_t size) noexcept;
+
 	Semaphore *semaphore() const { return semaphore_; }
 
 	void invoke();
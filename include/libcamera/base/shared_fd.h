@@ -28,6 +28,7 @@ public:
 
 	bool isValid() const { return fd_ != nullptr; }
 	int get() const { return fd_ ? fd_->fd() : -1; }
+	long useCount() const { return fd_.use_count(); }
 	UniqueFD dup() const;
 
 private:
@@ -8,7 +8,7 @@
 #pragma once
 
 #include <functional>
-#include <list>
+#include <memory>
 #include <type_traits>
 #include <vector>
 
@@ -24,15 +24,15 @@ public:
 	void disconnect(Object *object);
 
 protected:
-	using SlotList = std::list<BoundMethodBase *>;
+	using SlotArray = std::vector<std::shared_ptr<BoundMethodBase>>;
 
 	void connect(BoundMethodBase *slot);
-	void disconnect(std::function<bool(SlotList::iterator &)> match);
+	void disconnect(std::function<bool(BoundMethodBase *)> match);
 
-	SlotList slots();
+	std::shared_ptr<const SlotArray> slots() const;
 
 private:
-	SlotList slots_;
+	std::shared_ptr<const SlotArray> slots_;
 };
 
 template<typename... Args>
@@ -97,7 +97,7 @@ public:
 
 	void disconnect()
 	{
-		SignalBase::disconnect([]([[maybe_unused]] SlotList::iterator &iter) {
+		SignalBase::disconnect([]([[maybe_unused]] BoundMethodBase *slot) {
 			return true;
 		});
 	}
@@ -105,17 +105,17 @@ public:
 	template<typename T>
 	void disconnect(T *obj)
 	{
-		SignalBase::disconnect([obj](SlotList::iterator &iter) {
-			return (*iter)->match(obj);
+		SignalBase::disconnect([obj](BoundMethodBase *slot) {
+			return slot->match(obj);
 		});
 	}
 
 	template<typename T, typename R>
 	void disconnect(T *obj, R (T::*func)(Args...))
 	{
-		SignalBase::disconnect([obj, func](SlotList::iterator &iter) {
+		SignalBase::disconnect([obj, func](BoundMethodBase *base) {
 			BoundMethodArgs<R, Args...> *slot =
-				static_cast<BoundMethodArgs<R, Args...> *>(*iter);
+				static_cast<BoundMethodArgs<R, Args...> *>(base);
 
 			if (!slot->match(obj))
 				return false;
@@ -133,9 +133,9 @@ public:
 	template<typename R>
 	void disconnect(R (*func)(Args...))
 	{
-		SignalBase::disconnect([func](SlotList::iterator &iter) {
+		SignalBase::disconnect([func](BoundMethodBase *base) {
 			BoundMethodArgs<R, Args...> *slot =
-				static_cast<BoundMethodArgs<R, Args...> *>(*iter);
+				static_cast<BoundMethodArgs<R, Args...> *>(base);
 
 			if (!slot->match(nullptr))
 				return false;
@@ -147,11 +147,17 @@ public:
 	void emit(Args... args)
 	{
 		/*
-		 * Make a copy of the slots list as the slot could call the
-		 * disconnect operation, invalidating the iterator.
+		 * Take a reference to the current slots array. The array is
+		 * never modified, connect() and disconnect() replace it, so the
+		 * slots can be called without holding any lock, even if a slot
+		 * connects or disconnects the signal.
 		 */
-		for (BoundMethodBase *slot : slots())
-			static_cast<BoundMethodArgs<void, Args...> *>(slot)->activate(args...);
+		std::shared_ptr<const SlotArray> slots = SignalBase::slots();
+		if (!slots)
+			return;
+
+		for (const std::shared_ptr<BoundMethodBase> &slot : *slots)
+			static_cast<BoundMethodArgs<void, Args...> *>(slot.get())->activate(args...);
 	}
 };
 
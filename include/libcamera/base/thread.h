@@ -8,6 +8,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <sys/types.h>
 #include <thread>
 
@@ -15,6 +16,7 @@
 
 #include <libcamera/base/message.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
 #include <libcamera/base/utils.h>
 
 namespace libcamera {
@@ -28,6 +30,12 @@ class ThreadMain;
 class Thread
 {
 public:
+	enum class SchedulingPolicy {
+		Normal,
+		Fifo,
+		RoundRobin,
+	};
+
 	Thread();
 	virtual ~Thread();
 
@@ -37,6 +45,10 @@ public:
 
 	bool isRunning();
 
+	int setThreadAffinity(const Span<const unsigned int> &cpus);
+	int setSchedulingPolicy(SchedulingPolicy policy, int priority);
+	void setThreadName(const std::string &name);
+
 	Signal<> finished;
 
 	static Thread *current();
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Shared worker thread pool
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+
+namespace libcamera {
+
+class ThreadPool
+{
+public:
+	enum class Priority {
+		High,
+		Normal,
+		Low,
+	};
+
+	using Task = std::function<void()>;
+
+	ThreadPool(unsigned int workers = 0);
+	~ThreadPool();
+
+	static ThreadPool *instance();
+
+	unsigned int workers() const { return workers_.size(); }
+
+	void submit(Task task, Priority priority = Priority::Normal);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(ThreadPool)
+
+	class Worker;
+
+	bool takeTask(Worker *worker, Task *task);
+	void work(Worker *worker);
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::atomic<unsigned int> nextWorker_;
+	std::atomic<unsigned int> pending_;
+
+	Mutex mutex_;
+	ConditionVariable cv_;
+	bool exit_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace libcamera */
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <chrono>
+#include <stddef.h>
 #include <stdint.h>
 
 #include <libcamera/base/private.h>
@@ -38,11 +39,16 @@ protected:
 	void message(Message *msg) override;
 
 private:
+	friend class TimerQueue;
+
+	static constexpr size_t kNotQueued = SIZE_MAX;
+
 	void registerTimer();
 	void unregisterTimer();
 
 	bool running_;
 	std::chrono::steady_clock::time_point deadline_;
+	size_t queueIndex_;
 };
 
 } /* namespace libcamera */
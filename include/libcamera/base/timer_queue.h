@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Timer queue for event dispatchers
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+class Timer;
+
+class TimerQueue
+{
+public:
+	bool empty() const { return heap_.empty(); }
+	Timer *front() const { return heap_.front().timer; }
+	utils::time_point deadline() const { return heap_.front().deadline; }
+
+	void insert(Timer *timer);
+	void remove(Timer *timer);
+
+private:
+	struct Entry {
+		utils::time_point deadline;
+		Timer *timer;
+	};
+
+	void place(size_t index, const Entry &entry);
+	void siftUp(size_t index);
+	void siftDown(size_t index);
+
+	std::vector<Entry> heap_;
+};
+
+} /* namespace libcamera */
@@ -7,17 +7,21 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
 #include <initializer_list>
 #include <memory>
 #include <optional>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
 #include <libcamera/base/object.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/controls.h>
 #include <libcamera/geometry.h>
@@ -56,6 +60,53 @@ public:
 	bool isValid() const;
 };
 
+class CameraStatistics
+{
+public:
+	enum Stage {
+		StageDequeue,
+		StageIpa,
+		StageIsp,
+		StageComplete,
+	};
+
+	static constexpr unsigned int kNumStages = StageComplete + 1;
+
+	struct Latency {
+		void add(std::chrono::nanoseconds latency);
+		std::chrono::nanoseconds average() const;
+
+		uint64_t count = 0;
+		std::chrono::nanoseconds min = std::chrono::nanoseconds::max();
+		std::chrono::nanoseconds max = std::chrono::nanoseconds::zero();
+		std::chrono::nanoseconds total = std::chrono::nanoseconds::zero();
+	};
+
+	std::array<Latency, kNumStages> stages;
+	Latency requestLatency;
+
+	uint64_t requestsCompleted = 0;
+	uint64_t requestsCancelled = 0;
+	uint64_t buffersFailed = 0;
+	uint64_t framesDropped = 0;
+};
+
+class CameraMemoryUsage
+{
+public:
+	enum Purpose {
+		PurposeApplication,
+		PurposeInternal,
+		PurposeShared,
+	};
+
+	static constexpr unsigned int kNumPurposes = PurposeShared + 1;
+
+	uint64_t total() const;
+
+	std::array<uint64_t, kNumPurposes> bytes = {};
+};
+
 class CameraConfiguration
 {
 public:
@@ -116,14 +167,21 @@ class Camera final : public Object, public std::enable_shared_from_this<Camera>,
 	LIBCAMERA_DECLARE_PRIVATE()
 
 public:
+	enum class CompletionOrder {
+		InOrder,
+		OutOfOrder,
+	};
+
 	static std::shared_ptr<Camera> create(std::unique_ptr<Private> d,
 					      const std::string &id,
 					      const std::set<Stream *> &streams);
 
 	const std::string &id() const;
 
+	Signal<Request *, const ControlList &> metadataAvailable;
 	Signal<Request *, FrameBuffer *> bufferCompleted;
 	Signal<Request *> requestCompleted;
+	Signal<> requestSlotsAvailable;
 	Signal<> disconnected;
 
 	int acquire();
@@ -133,6 +191,7 @@ public:
 	const ControlList &properties() const;
 
 	const std::set<Stream *> &streams() const;
+	bool supportsReprocessing() const;
 
 	std::unique_ptr<CameraConfiguration>
 	generateConfiguration(Span<const StreamRole> roles = {});
@@ -145,12 +204,28 @@ public:
 
 	int configure(CameraConfiguration *config);
 
+	int registerFrameBuffers(Stream *stream, Span<FrameBuffer *const> buffers);
+
 	std::unique_ptr<Request> createRequest(uint64_t cookie = 0);
+	int createRequests(unsigned int count, std::vector<Request *> *requests);
 	int queueRequest(Request *request);
+	int queueRequests(Span<Request *const> requests);
+	unsigned int availableRequestSlots() const;
+
+	int setCompletionQueue(unsigned int size);
+	int setCompletionOrder(CompletionOrder order);
+	int completionFd() const;
+	Request *completedRequest();
 
 	int start(const ControlList *controls = nullptr);
 	int stop();
 
+	CameraStatistics statistics() const;
+
+	CameraMemoryUsage memoryUsage() const;
+	int setMemoryBudget(uint64_t budget);
+	uint64_t memoryBudget() const;
+
 private:
 	LIBCAMERA_DISABLE_COPY(Camera)
 
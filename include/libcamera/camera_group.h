@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Groups of frame-synchronised cameras
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/class.h>
+
+namespace libcamera {
+
+class Camera;
+
+class CameraGroup : public Extensible
+{
+	LIBCAMERA_DECLARE_PRIVATE()
+
+public:
+	CameraGroup();
+	~CameraGroup();
+
+	int addCamera(std::shared_ptr<Camera> camera);
+	int removeCamera(Camera *camera);
+
+	std::vector<std::shared_ptr<Camera>> cameras() const;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(CameraGroup)
+};
+
+} /* namespace libcamera */
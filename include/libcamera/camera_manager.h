@@ -28,6 +28,7 @@ public:
 	~CameraManager();
 
 	int start();
+	int start(const std::vector<std::string> &pipelines);
 	void stop();
 
 	std::vector<std::shared_ptr<Camera>> cameras() const;
@@ -13,6 +13,7 @@
 #include <stdint.h>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/class.h>
@@ -126,7 +127,9 @@ public:
 	~ControlValue();
 
 	ControlValue(const ControlValue &other);
+	ControlValue(ControlValue &&other) noexcept;
 	ControlValue &operator=(const ControlValue &other);
+	ControlValue &operator=(ControlValue &&other) noexcept;
 
 	ControlType type() const { return type_; }
 	bool isNone() const { return type_ == ControlTypeNone; }
@@ -197,11 +200,13 @@ public:
 		     std::size_t numElements = 1);
 
 private:
+	static constexpr std::size_t kInlineStorageSize = 56;
+
 	ControlType type_ : 8;
 	bool isArray_;
 	std::size_t numElements_ : 32;
 	union {
-		uint64_t value_;
+		alignas(uint64_t) uint8_t value_[kInlineStorageSize];
 		void *storage_;
 	};
 
@@ -349,7 +354,7 @@ private:
 class ControlList
 {
 private:
-	using ControlListMap = std::unordered_map<unsigned int, ControlValue>;
+	using ControlListMap = std::vector<std::pair<unsigned int, ControlValue>>;
 
 public:
 	enum class MergePolicy {
@@ -380,12 +385,11 @@ public:
 	template<typename T>
 	std::optional<T> get(const Control<T> &ctrl) const
 	{
-		const auto entry = controls_.find(ctrl.id());
-		if (entry == controls_.end())
+		const ControlValue *val = lookup(ctrl.id());
+		if (!val)
 			return std::nullopt;
 
-		const ControlValue &val = entry->second;
-		return val.get<T>();
+		return val->get<T>();
 	}
 
 	template<typename T, typename V>
@@ -410,11 +414,14 @@ public:
 
 	const ControlValue &get(unsigned int id) const;
 	void set(unsigned int id, const ControlValue &value);
+	void set(unsigned int id, ControlValue &&value);
 
 	const ControlInfoMap *infoMap() const { return infoMap_; }
 	const ControlIdMap *idMap() const { return idmap_; }
 
 private:
+	ControlListMap::const_iterator lowerBound(unsigned int id) const;
+	const ControlValue *lookup(unsigned int id) const;
 	const ControlValue *find(unsigned int id) const;
 	ControlValue *find(unsigned int id);
 
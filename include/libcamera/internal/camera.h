@@ -9,18 +9,25 @@
 
 #include <atomic>
 #include <list>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/unique_fd.h>
 
 #include <libcamera/camera.h>
 
 namespace libcamera {
 
 class CameraControlValidator;
+class CameraGroup;
+class DelayedControls;
 class PipelineHandler;
+class Request;
 class Stream;
 
 class Camera::Private : public Extensible::Private
@@ -38,8 +45,29 @@ public:
 	ControlList properties_;
 
 	uint32_t requestSequence_;
+	unsigned int maxQueuedRequests_;
+
+	CameraGroup *group_;
+	DelayedControls *delayedControls_;
+
+	bool isRunning() const;
 
 	const CameraControlValidator *validator() const { return validator_.get(); }
+	CompletionOrder completionOrder() const { return completionOrder_; }
+
+	CameraStatistics statistics() const;
+	void resetStatistics();
+	void recordLatency(CameraStatistics::Stage stage,
+			   std::chrono::nanoseconds latency);
+	void recordRequest(const Request *request,
+			   std::chrono::nanoseconds latency);
+	void recordBuffer(const Stream *stream, const FrameBuffer *buffer);
+
+	CameraMemoryUsage memoryUsage() const;
+	uint64_t memoryBudget() const;
+	int chargeMemory(CameraMemoryUsage::Purpose purpose, uint64_t bytes);
+	void unchargeMemory(CameraMemoryUsage::Purpose purpose, uint64_t bytes);
+	static uint64_t bufferMemory(const std::vector<std::unique_ptr<FrameBuffer>> &buffers);
 
 private:
 	enum State {
@@ -51,12 +79,12 @@ private:
 	};
 
 	bool isAcquired() const;
-	bool isRunning() const;
 	int isAccessAllowed(State state, bool allowDisconnected = false,
 			    const char *from = __builtin_FUNCTION()) const;
 	int isAccessAllowed(State low, State high,
 			    bool allowDisconnected = false,
 			    const char *from = __builtin_FUNCTION()) const;
+	int validateRequest(const Request *request) const;
 
 	void disconnect();
 	void setState(State state);
@@ -70,6 +98,25 @@ private:
 	std::atomic<State> state_;
 
 	std::unique_ptr<CameraControlValidator> validator_;
+
+	std::vector<std::unique_ptr<Request>> requestPool_;
+	CompletionOrder completionOrder_;
+	std::atomic<unsigned int> pendingRequests_;
+
+	bool pushCompletedRequest(Request *request);
+
+	UniqueFD completionFd_;
+	std::vector<Request *> completionQueue_;
+	std::atomic<unsigned int> completionHead_;
+	std::atomic<unsigned int> completionTail_;
+
+	mutable Mutex statisticsLock_;
+	CameraStatistics statistics_ LIBCAMERA_TSA_GUARDED_BY(statisticsLock_);
+	std::map<const Stream *, uint32_t> lastSequences_;
+
+	mutable Mutex memoryLock_;
+	CameraMemoryUsage memoryUsage_ LIBCAMERA_TSA_GUARDED_BY(memoryLock_);
+	uint64_t memoryBudget_ LIBCAMERA_TSA_GUARDED_BY(memoryLock_);
 };
 
 } /* namespace libcamera */
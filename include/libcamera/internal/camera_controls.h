@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "libcamera/internal/control_validator.h"
 
 namespace libcamera {
@@ -21,8 +23,11 @@ public:
 	const std::string &name() const override;
 	bool validate(unsigned int id) const override;
 
+	void update();
+
 private:
 	Camera *camera_;
+	std::vector<bool> valid_;
 };
 
 } /* namespace libcamera */
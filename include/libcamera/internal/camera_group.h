@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Camera group private data
+ */
+
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+
+#include <libcamera/camera_group.h>
+
+namespace libcamera {
+
+class CameraGroup::Private : public Extensible::Private
+{
+	LIBCAMERA_DECLARE_PUBLIC(CameraGroup)
+
+public:
+	struct SyncInfo {
+		int64_t frame;
+		int64_t error;
+	};
+
+	Private();
+
+	std::optional<SyncInfo> synchronise(Camera *camera, uint32_t sequence,
+					    uint64_t timestamp);
+	void stop(Camera *camera);
+
+private:
+	struct Member {
+		std::shared_ptr<Camera> camera;
+		std::optional<int64_t> offset;
+	};
+
+	Member *member(Camera *camera) LIBCAMERA_TSA_REQUIRES(mutex_);
+	void align() LIBCAMERA_TSA_REQUIRES(mutex_);
+
+	mutable Mutex mutex_;
+	std::vector<Member> members_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
+	Camera *reference_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::optional<int64_t> referenceFrame_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	uint64_t referenceTimestamp_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	double framePeriod_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace libcamera */
@@ -7,10 +7,13 @@
 #pragma once
 
 #include <memory>
+#include <optional>
+#include <stdint.h>
 #include <string>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/controls.h>
 
@@ -18,6 +21,7 @@ namespace libcamera {
 
 class MediaEntity;
 class V4L2Subdevice;
+struct CameraLensProperties;
 
 class CameraLens : protected Loggable
 {
@@ -27,6 +31,7 @@ public:
 
 	int init();
 	int setFocusPosition(int32_t position);
+	bool isMoving(uint64_t timestamp) const { return timestamp < settled_; }
 
 	const std::string &model() const { return model_; }
 
@@ -39,11 +44,18 @@ private:
 	LIBCAMERA_DISABLE_COPY_AND_MOVE(CameraLens)
 
 	int validateLensDriver();
+	utils::Duration settleTime(int32_t position) const;
 
 	const MediaEntity *entity_;
 	std::unique_ptr<V4L2Subdevice> subdev_;
 
 	std::string model_;
+	const CameraLensProperties *staticProps_;
+
+	int32_t minPosition_;
+	int32_t maxPosition_;
+	std::optional<int32_t> position_;
+	uint64_t settled_;
 };
 
 } /* namespace libcamera */
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Database of camera lens properties
+ */
+
+#pragma once
+
+#include <string>
+
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+struct CameraLensProperties {
+	static const CameraLensProperties *get(const std::string &lens);
+
+	utils::Duration minSettleTime;
+	utils::Duration maxSettleTime;
+};
+
+} /* namespace libcamera */
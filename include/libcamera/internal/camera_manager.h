@@ -11,6 +11,7 @@
 
 #include <map>
 #include <memory>
+#include <string>
 #include <sys/types.h>
 #include <vector>
 
@@ -34,7 +35,7 @@ class CameraManager::Private : public Extensible::Private, public Thread
 public:
 	Private();
 
-	int start();
+	int start(const std::vector<std::string> &pipelines);
 	void addCamera(std::shared_ptr<Camera> camera) LIBCAMERA_TSA_EXCLUDES(mutex_);
 	void removeCamera(std::shared_ptr<Camera> camera) LIBCAMERA_TSA_EXCLUDES(mutex_);
 
@@ -44,6 +45,7 @@ protected:
 private:
 	int init();
 	void createPipelineHandlers();
+	void pipelineFactoryMatch(const std::string &name);
 	void pipelineFactoryMatch(const PipelineHandlerFactoryBase *factory);
 	void cleanup() LIBCAMERA_TSA_EXCLUDES(mutex_);
 
@@ -61,6 +63,8 @@ private:
 	int status_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
 
 	std::unique_ptr<DeviceEnumerator> enumerator_;
+	/* Pipeline handlers selected by the application, all if empty */
+	std::vector<std::string> pipelines_;
 
 	IPAManager ipaManager_;
 	ProcessManager processManager_;
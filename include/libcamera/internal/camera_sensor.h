@@ -8,6 +8,7 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -109,7 +110,7 @@ private:
 	std::vector<unsigned int> mbusCodes_;
 	std::vector<Size> sizes_;
 	std::vector<controls::draft::TestPatternModeEnum> testPatternModes_;
-	controls::draft::TestPatternModeEnum testPatternMode_;
+	std::optional<controls::draft::TestPatternModeEnum> testPatternMode_;
 
 	Size pixelArraySize_;
 	Rectangle activeArea_;
@@ -51,11 +51,23 @@ private:
 				      bool isArray = false, unsigned int count = 1);
 	ControlInfo loadControlInfo(ByteStreamBuffer &buffer);
 
+	struct SerializedInfoMap {
+		uint64_t hash;
+		uint32_t idMapType;
+		std::vector<uint8_t> data;
+		bool used;
+	};
+
+	struct DeserializedInfoMap {
+		ControlInfoMap infoMap;
+		std::unique_ptr<ControlIdMap> idMap;
+		std::vector<std::unique_ptr<ControlId>> controlIds;
+		bool used;
+	};
+
 	unsigned int serial_;
-	unsigned int serialSeed_;
-	std::vector<std::unique_ptr<ControlId>> controlIds_;
-	std::vector<std::unique_ptr<ControlIdMap>> controlIdMaps_;
-	std::map<unsigned int, ControlInfoMap> infoMaps_;
+	std::map<unsigned int, SerializedInfoMap> serializedInfoMaps_;
+	std::map<unsigned int, DeserializedInfoMap> infoMaps_;
 	std::map<const ControlInfoMap *, unsigned int> infoMapHandles_;
 };
 
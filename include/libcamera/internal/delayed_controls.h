@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <unordered_map>
+#include <vector>
 
 #include <libcamera/controls.h>
 
@@ -24,16 +25,24 @@ public:
 		bool priorityWrite;
 	};
 
+	static constexpr unsigned int kDefaultDepth = 16;
+
 	DelayedControls(V4L2Device *device,
-			const std::unordered_map<uint32_t, ControlParams> &controlParams);
+			const std::unordered_map<uint32_t, ControlParams> &controlParams,
+			unsigned int depth = kDefaultDepth);
 
-	void reset();
+	void reset(unsigned int cookie = 0);
 
-	bool push(const ControlList &controls);
-	ControlList get(uint32_t sequence);
+	bool push(const ControlList &controls, unsigned int cookie = 0);
+	ControlList get(uint32_t sequence, unsigned int *cookie = nullptr);
 
 	void applyControls(uint32_t sequence);
 
+	unsigned int depth() const { return depth_; }
+	unsigned int maxDelay() const { return maxDelay_; }
+	uint32_t nextSequence() const { return queueCount_ + maxDelay_; }
+	void skipTo(uint32_t sequence);
+
 private:
 	class Info : public ControlValue
 	{
@@ -51,19 +60,23 @@ private:
 		bool updated;
 	};
 
-	/* \todo Make the listSize configurable at instance creation time. */
-	static constexpr int listSize = 16;
-	class ControlRingBuffer : public std::array<Info, listSize>
+	template<typename T>
+	class RingBuffer : public std::vector<T>
 	{
 	public:
-		Info &operator[](unsigned int index)
+		RingBuffer(unsigned int size = 0)
+			: std::vector<T>(size)
+		{
+		}
+
+		T &operator[](unsigned int index)
 		{
-			return std::array<Info, listSize>::operator[](index % listSize);
+			return std::vector<T>::operator[](index % this->size());
 		}
 
-		const Info &operator[](unsigned int index) const
+		const T &operator[](unsigned int index) const
 		{
-			return std::array<Info, listSize>::operator[](index % listSize);
+			return std::vector<T>::operator[](index % this->size());
 		}
 	};
 
@@ -71,11 +84,13 @@ private:
 	/* \todo Evaluate if we should index on ControlId * or unsigned int */
 	std::unordered_map<const ControlId *, ControlParams> controlParams_;
 	unsigned int maxDelay_;
+	unsigned int depth_;
 
 	uint32_t queueCount_;
 	uint32_t writeCount_;
 	/* \todo Evaluate if we should index on ControlId * or unsigned int */
-	std::unordered_map<const ControlId *, ControlRingBuffer> values_;
+	std::unordered_map<const ControlId *, RingBuffer<Info>> values_;
+	RingBuffer<unsigned int> cookies_;
 };
 
 } /* namespace libcamera */
@@ -13,6 +13,9 @@
 #include <set>
 #include <string>
 #include <sys/types.h>
+#include <vector>
+
+#include <libcamera/base/timer.h>
 
 #include "libcamera/internal/device_enumerator.h"
 
@@ -55,11 +58,13 @@ private:
 	};
 
 	int addUdevDevice(struct udev_device *dev);
+	int addMediaDevice(std::unique_ptr<MediaDevice> media);
 	int populateMediaDevice(MediaDevice *media, DependencyMap *deps);
 	std::string lookupDeviceNode(dev_t devnum);
 
 	int addV4L2Device(dev_t devnum);
 	void udevNotify();
+	void hotplugNotify();
 
 	struct udev *udev_;
 	struct udev_monitor *monitor_;
@@ -68,6 +73,11 @@ private:
 	std::set<dev_t> orphans_;
 	std::list<MediaDeviceDeps> pending_;
 	std::map<dev_t, MediaDeviceDeps *> devMap_;
+
+	Timer hotplugTimer_;
+	std::vector<std::string> hotplugMedia_;
+	std::vector<dev_t> hotplugV4L2_;
+	bool added_;
 };
 
 } /* namespace libcamera */
@@ -8,8 +8,12 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+#include <vector>
 
+#include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
+#include <libcamera/base/shared_fd.h>
 #include <libcamera/base/unique_fd.h>
 
 namespace libcamera {
@@ -21,6 +25,7 @@ public:
 		CmaHeap = 1 << 0,
 		SystemHeap = 1 << 1,
 		UDmaBuf = 1 << 2,
+		HugePages = 1 << 3,
 	};
 
 	using DmaBufAllocatorFlags = Flags<DmaBufAllocatorFlag>;
@@ -28,15 +33,57 @@ public:
 	DmaBufAllocator(DmaBufAllocatorFlags flags = DmaBufAllocatorFlag::CmaHeap);
 	~DmaBufAllocator();
 	bool isValid() const { return providerHandle_.isValid(); }
+	DmaBufAllocatorFlag type() const { return type_; }
 	UniqueFD alloc(const char *name, std::size_t size);
 
+	SharedFD acquire(const char *name, std::size_t size);
+	int reserve(std::size_t size, unsigned int count);
+	void trim();
+
 private:
+	struct PoolEntry {
+		std::size_t size;
+		SharedFD fd;
+	};
+
 	UniqueFD allocFromHeap(const char *name, std::size_t size);
 	UniqueFD allocFromUDmaBuf(const char *name, std::size_t size);
+	UniqueFD createHugeMemFd(const char *name, std::size_t *size);
+	UniqueFD createMemFd(const char *name, std::size_t size);
+	std::size_t sizeClass(std::size_t size) const;
+
 	UniqueFD providerHandle_;
 	DmaBufAllocatorFlag type_;
+	bool hugePages_;
+
+	std::vector<PoolEntry> pool_;
 };
 
 LIBCAMERA_FLAGS_ENABLE_OPERATORS(DmaBufAllocator::DmaBufAllocatorFlag)
 
+class DmaSyncer final
+{
+public:
+	enum class SyncType {
+		Read = 0,
+		Write,
+		ReadWrite,
+	};
+
+	explicit DmaSyncer(SharedFD fd, SyncType type = SyncType::ReadWrite);
+
+	DmaSyncer(DmaSyncer &&other) = default;
+	DmaSyncer &operator=(DmaSyncer &&other) = default;
+
+	~DmaSyncer();
+
+private:
+	LIBCAMERA_DISABLE_COPY(DmaSyncer)
+
+	void sync(uint64_t step);
+
+	SharedFD fd_;
+	uint64_t flags_ = 0;
+};
+
 } /* namespace libcamera */
@@ -53,7 +53,7 @@ public:
 	/* \todo Add support for non-contiguous memory planes */
 	const char *name;
 	PixelFormat format;
-	std::vector<V4L2PixelFormat> v4l2Formats;
+	std::array<V4L2PixelFormat, 2> v4l2Formats;
 	unsigned int bitsPerPixel;
 	enum ColourEncoding colourEncoding;
 	bool packed;
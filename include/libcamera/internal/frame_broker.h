@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Share frame buffers with other processes
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/framebuffer.h>
+
+namespace libcamera {
+
+class EventNotifier;
+class IPCUnixSocket;
+
+class FrameBroker
+{
+public:
+	FrameBroker();
+	~FrameBroker();
+
+	int listen(const std::string &path);
+	void close();
+
+	unsigned int consumers() const;
+
+	int publish(FrameBuffer *buffer);
+	int removeBuffer(FrameBuffer *buffer);
+
+	Signal<FrameBuffer *> bufferReleased;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(FrameBroker)
+
+	struct Consumer {
+		std::unique_ptr<IPCUnixSocket> socket;
+		std::set<uint32_t> known;
+		std::multiset<uint32_t> held;
+	};
+
+	struct Buffer {
+		FrameBuffer *buffer;
+		unsigned int refs;
+	};
+
+	void accept();
+	void receive(Consumer *consumer);
+	void disconnect(Consumer *consumer);
+	void unref(uint32_t id);
+
+	std::string path_;
+	UniqueFD fd_;
+	std::unique_ptr<EventNotifier> notifier_;
+
+	std::vector<std::unique_ptr<Consumer>> consumers_;
+	std::map<uint32_t, Buffer> buffers_;
+	std::map<FrameBuffer *, uint32_t> ids_;
+	uint32_t nextId_;
+};
+
+class FrameBrokerClient
+{
+public:
+	struct Frame {
+		uint32_t id;
+		unsigned int sequence;
+		uint64_t timestamp;
+		std::vector<FrameBuffer::Plane> planes;
+		std::vector<unsigned int> bytesused;
+	};
+
+	FrameBrokerClient();
+	~FrameBrokerClient();
+
+	int connect(const std::string &path);
+	void close();
+	bool isConnected() const;
+
+	int release(uint32_t id);
+
+	Signal<const Frame &> frameReady;
+	Signal<> disconnected;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(FrameBrokerClient)
+
+	void receive();
+	void remoteClosed();
+
+	std::unique_ptr<IPCUnixSocket> socket_;
+	std::map<uint32_t, std::vector<FrameBuffer::Plane>> buffers_;
+};
+
+} /* namespace libcamera */
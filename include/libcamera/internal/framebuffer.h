@@ -11,6 +11,7 @@
 #include <utility>
 
 #include <libcamera/base/class.h>
+#include <libcamera/base/unique_fd.h>
 
 #include <libcamera/fence.h>
 #include <libcamera/framebuffer.h>
@@ -31,6 +32,9 @@ public:
 	Fence *fence() const { return fence_.get(); }
 	void setFence(std::unique_ptr<Fence> fence) { fence_ = std::move(fence); }
 
+	void setOutputFence(UniqueFD fd) { outputFence_ = std::move(fd); }
+	void signalOutputFence();
+
 	void cancel() { metadata_.status = FrameMetadata::FrameCancelled; }
 
 	FrameMetadata &metadata() { return metadata_; }
@@ -41,6 +45,7 @@ private:
 	uint64_t cookie_;
 
 	std::unique_ptr<Fence> fence_;
+	UniqueFD outputFence_;
 	Request *request_;
 	bool isContiguous_;
 };
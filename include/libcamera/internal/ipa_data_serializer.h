@@ -41,6 +41,15 @@ void appendPOD(std::vector<uint8_t> &vec, T val)
 	memcpy(&*(vec.end() - byteWidth), &val, byteWidth);
 }
 
+template<typename T,
+	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
+void writePOD(std::vector<uint8_t> &vec, size_t pos, T val)
+{
+	ASSERT(pos + sizeof(val) <= vec.size());
+
+	memcpy(vec.data() + pos, &val, sizeof(val));
+}
+
 template<typename T,
 	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
 T readPOD(std::vector<uint8_t>::const_iterator it, size_t pos,
@@ -69,6 +78,9 @@ class IPADataSerializer
 public:
 	static std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
 	serialize(const T &data, ControlSerializer *cs = nullptr);
+	static void serialize(const T &data, std::vector<uint8_t> *dataVec,
+			      std::vector<SharedFD> *fdsVec,
+			      ControlSerializer *cs = nullptr);
 
 	static T deserialize(const std::vector<uint8_t> &data,
 			     ControlSerializer *cs = nullptr);
@@ -88,6 +100,30 @@ public:
 
 #ifndef __DOXYGEN__
 
+namespace {
+
+/*
+ * Serialize a container element with its size and number of fds. The sizes
+ * are not known before the element is serialized, reserve space for them and
+ * fill them afterwards to serialize the element in place.
+ */
+template<typename T>
+void serializeElement(const T &data, std::vector<uint8_t> *dataVec,
+		      std::vector<SharedFD> *fdsVec, ControlSerializer *cs)
+{
+	const size_t sizesPos = dataVec->size();
+	const size_t fdsPos = fdsVec->size();
+
+	dataVec->resize(sizesPos + 8);
+
+	IPADataSerializer<T>::serialize(data, dataVec, fdsVec, cs);
+
+	writePOD<uint32_t>(*dataVec, sizesPos, dataVec->size() - sizesPos - 8);
+	writePOD<uint32_t>(*dataVec, sizesPos + 4, fdsVec->size() - fdsPos);
+}
+
+} /* namespace */
+
 /*
  * Serialization format for vector of type V:
  *
@@ -111,26 +147,21 @@ public:
 		std::vector<uint8_t> dataVec;
 		std::vector<SharedFD> fdsVec;
 
+		serialize(data, &dataVec, &fdsVec, cs);
+
+		return { std::move(dataVec), std::move(fdsVec) };
+	}
+
+	static void serialize(const std::vector<V> &data, std::vector<uint8_t> *dataVec,
+			      std::vector<SharedFD> *fdsVec, ControlSerializer *cs = nullptr)
+	{
 		/* Serialize the length. */
 		uint32_t vecLen = data.size();
-		appendPOD<uint32_t>(dataVec, vecLen);
+		appendPOD<uint32_t>(*dataVec, vecLen);
 
 		/* Serialize the members. */
-		for (auto const &it : data) {
-			std::vector<uint8_t> dvec;
-			std::vector<SharedFD> fvec;
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<V>::serialize(it, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
-		}
-
-		return { dataVec, fdsVec };
+		for (auto const &it : data)
+			serializeElement(it, dataVec, fdsVec, cs);
 	}
 
 	static std::vector<V> deserialize(std::vector<uint8_t> &data, ControlSerializer *cs = nullptr)
@@ -208,35 +239,23 @@ public:
 		std::vector<uint8_t> dataVec;
 		std::vector<SharedFD> fdsVec;
 
+		serialize(data, &dataVec, &fdsVec, cs);
+
+		return { std::move(dataVec), std::move(fdsVec) };
+	}
+
+	static void serialize(const std::map<K, V> &data, std::vector<uint8_t> *dataVec,
+			      std::vector<SharedFD> *fdsVec, ControlSerializer *cs = nullptr)
+	{
 		/* Serialize the length. */
 		uint32_t mapLen = data.size();
-		appendPOD<uint32_t>(dataVec, mapLen);
+		appendPOD<uint32_t>(*dataVec, mapLen);
 
 		/* Serialize the members. */
 		for (auto const &it : data) {
-			std::vector<uint8_t> dvec;
-			std::vector<SharedFD> fvec;
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<K>::serialize(it.first, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<V>::serialize(it.second, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
+			serializeElement(it.first, dataVec, fdsVec, cs);
+			serializeElement(it.second, dataVec, fdsVec, cs);
 		}
-
-		return { dataVec, fdsVec };
 	}
 
 	static std::map<K, V> deserialize(std::vector<uint8_t> &data, ControlSerializer *cs = nullptr)
@@ -314,7 +333,14 @@ public:
 		dataVec.reserve(sizeof(Flags<E>));
 		appendPOD<uint32_t>(dataVec, static_cast<typename Flags<E>::Type>(data));
 
-		return { dataVec, {} };
+		return { std::move(dataVec), {} };
+	}
+
+	static void serialize(const Flags<E> &data, std::vector<uint8_t> *dataVec,
+			      [[maybe_unused]] std::vector<SharedFD> *fdsVec,
+			      [[maybe_unused]] ControlSerializer *cs = nullptr)
+	{
+		appendPOD<uint32_t>(*dataVec, static_cast<typename Flags<E>::Type>(data));
 	}
 
 	static Flags<E> deserialize(std::vector<uint8_t> &data,
@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <stdint.h>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/log.h>
@@ -23,6 +27,8 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPAManager)
 
+class IPCPipeUnixSocket;
+
 class IPAManager
 {
 public:
@@ -47,6 +53,9 @@ public:
 		return proxy;
 	}
 
+	static std::unique_ptr<IPCPipeUnixSocket>
+	createPipe(const IPAModule *ipam, const std::string &workerPath);
+
 #if HAVE_IPA_PUBKEY
 	static const PubKey &pubKey()
 	{
@@ -66,9 +75,23 @@ private:
 
 	bool isSignatureValid(IPAModule *ipa) const;
 
+	std::vector<std::string> modulePaths_;
+	unsigned int probedPaths_;
 	std::vector<IPAModule *> modules_;
 
+	unsigned int workerPoolSize_;
+	std::map<std::pair<std::string, std::string>,
+		 std::vector<std::unique_ptr<IPCPipeUnixSocket>>> workerPool_;
+
 #if HAVE_IPA_PUBKEY
+	struct SignatureStatus {
+		int64_t mtime;
+		int64_t size;
+		bool valid;
+	};
+
+	mutable std::map<std::string, SignatureStatus> signatures_;
+
 	static const uint8_t publicKeyData_[];
 	static const PubKey pubKey_;
 #endif
@@ -31,6 +31,10 @@ public:
 
 	IPCUnixSocket::Payload payload() const;
 
+	static IPCMessage batch(const Header &header,
+				const std::vector<IPCMessage> &messages);
+	int unbatch(std::vector<IPCMessage> *messages) const;
+
 	Header &header() { return header_; }
 	std::vector<uint8_t> &data() { return data_; }
 	std::vector<SharedFD> &fds() { return fds_; }
@@ -13,11 +13,10 @@
 
 #include "libcamera/internal/ipc_pipe.h"
 #include "libcamera/internal/ipc_unixsocket.h"
+#include "libcamera/internal/process.h"
 
 namespace libcamera {
 
-class Process;
-
 class IPCPipeUnixSocket : public IPCPipe
 {
 public:
@@ -36,6 +35,7 @@ private:
 	};
 
 	void readyRead();
+	void workerFinished(enum Process::ExitStatus exitStatus, int exitCode);
 	int call(const IPCUnixSocket::Payload &message,
 		 IPCUnixSocket::Payload *response, uint32_t seq);
 
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <memory>
 #include <stdint.h>
 #include <sys/types.h>
 #include <vector>
@@ -34,26 +35,42 @@ public:
 	void close();
 	bool isBound() const;
 
+	int enableSharedMemory();
+
 	int send(const Payload &payload);
 	int receive(Payload *payload);
 
 	Signal<> readyRead;
+	Signal<> disconnected;
 
 private:
+	class Ring;
+
 	struct Header {
 		uint32_t data;
 		uint8_t fds;
+		uint8_t type;
 	};
 
+	int sendSocket(const Payload &payload);
+	int sendRing(const Payload &payload);
+	int receiveSocket(Payload *payload);
+
 	int sendData(const void *buffer, size_t length, const int32_t *fds, unsigned int num);
 	int recvData(void *buffer, size_t length, int32_t *fds, unsigned int num);
 
+	int attachRing(Payload &setup);
+	void startRingReception();
+
 	void dataNotifier();
+	void ringNotifier();
 
 	UniqueFD fd_;
 	bool headerReceived_;
 	struct Header header_;
 	EventNotifier *notifier_;
+
+	std::unique_ptr<Ring> ring_;
 };
 
 } /* namespace libcamera */
@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2020, Google Inc.
+ *
+ * Per-frame ISP buffers tracking
+ */
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/signal.h>
+
+#include <libcamera/framebuffer.h>
+#include <libcamera/request.h>
+
+#include "libcamera/internal/framebuffer.h"
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(IspFrames)
+
+struct IspFrameInfo {
+	unsigned int frame;
+	Request *request;
+
+	FrameBuffer *paramBuffer;
+	FrameBuffer *statBuffer;
+
+	bool paramDequeued;
+	bool metadataProcessed;
+};
+
+template<typename Info, unsigned int Capacity = 32>
+class IspFrames
+{
+	static_assert(std::is_base_of_v<IspFrameInfo, Info>,
+		      "Info must derive from IspFrameInfo");
+
+public:
+	IspFrames()
+		: underruns_(0)
+	{
+		active_.fill(false);
+	}
+
+	void init(const std::vector<std::unique_ptr<FrameBuffer>> &paramBuffers,
+		  const std::vector<std::unique_ptr<FrameBuffer>> &statBuffers)
+	{
+		clear();
+
+		availableParamBuffers_.reserve(paramBuffers.size());
+		for (const std::unique_ptr<FrameBuffer> &buffer : paramBuffers)
+			availableParamBuffers_.push_back(buffer.get());
+
+		availableStatBuffers_.reserve(statBuffers.size());
+		for (const std::unique_ptr<FrameBuffer> &buffer : statBuffers)
+			availableStatBuffers_.push_back(buffer.get());
+	}
+
+	void clear()
+	{
+		if (underruns_)
+			LOG(IspFrames, Debug) << underruns_ << " frame underruns";
+
+		active_.fill(false);
+		availableParamBuffers_.clear();
+		availableStatBuffers_.clear();
+		underruns_ = 0;
+	}
+
+	Info *create(unsigned int frame, Request *request, bool useBuffers = true)
+	{
+		unsigned int index = frame % Capacity;
+		Info &info = infos_[index];
+
+		if (active_[index]) {
+			LOG(IspFrames, Debug)
+				<< "Frame " << frame << " underrun, frame "
+				<< info.frame << " still in flight";
+			underruns_++;
+			return nullptr;
+		}
+
+		FrameBuffer *paramBuffer = nullptr;
+		FrameBuffer *statBuffer = nullptr;
+
+		if (useBuffers) {
+			if (availableParamBuffers_.empty()) {
+				LOG(IspFrames, Debug) << "Parameters buffer underrun";
+				underruns_++;
+				return nullptr;
+			}
+
+			if (availableStatBuffers_.empty()) {
+				LOG(IspFrames, Debug) << "Statistics buffer underrun";
+				underruns_++;
+				return nullptr;
+			}
+
+			paramBuffer = availableParamBuffers_.back();
+			availableParamBuffers_.pop_back();
+			statBuffer = availableStatBuffers_.back();
+			availableStatBuffers_.pop_back();
+
+			paramBuffer->_d()->setRequest(request);
+			statBuffer->_d()->setRequest(request);
+		}
+
+		info = {};
+		info.frame = frame;
+		info.request = request;
+		info.paramBuffer = paramBuffer;
+		info.statBuffer = statBuffer;
+		info.paramDequeued = false;
+		info.metadataProcessed = false;
+
+		active_[index] = true;
+
+		return &info;
+	}
+
+	void remove(Info *info)
+	{
+		if (info->paramBuffer)
+			availableParamBuffers_.push_back(info->paramBuffer);
+		if (info->statBuffer)
+			availableStatBuffers_.push_back(info->statBuffer);
+
+		active_[info - infos_.data()] = false;
+	}
+
+	bool tryComplete(Info *info)
+	{
+		if (info->request->hasPendingBuffers())
+			return false;
+
+		if (!info->metadataProcessed)
+			return false;
+
+		if (info->paramBuffer && !info->paramDequeued)
+			return false;
+
+		remove(info);
+
+		bufferAvailable.emit();
+
+		return true;
+	}
+
+	Info *find(unsigned int frame)
+	{
+		unsigned int index = frame % Capacity;
+
+		if (active_[index] && infos_[index].frame == frame)
+			return &infos_[index];
+
+		LOG(IspFrames, Fatal)
+			<< "Can't find tracking information for frame " << frame;
+
+		return nullptr;
+	}
+
+	Info *find(const Request *request)
+	{
+		for (unsigned int i = 0; i < Capacity; ++i) {
+			if (active_[i] && infos_[i].request == request)
+				return &infos_[i];
+		}
+
+		LOG(IspFrames, Fatal) << "Can't find tracking information from request";
+
+		return nullptr;
+	}
+
+	Info *find(const FrameBuffer *buffer)
+	{
+		return find(buffer->request());
+	}
+
+	unsigned int underruns() const { return underruns_; }
+
+	Signal<> bufferAvailable;
+
+private:
+	std::array<Info, Capacity> infos_;
+	std::array<bool, Capacity> active_;
+
+	std::vector<FrameBuffer *> availableParamBuffers_;
+	std::vector<FrameBuffer *> availableStatBuffers_;
+
+	unsigned int underruns_;
+};
+
+} /* namespace libcamera */
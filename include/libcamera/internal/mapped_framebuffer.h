@@ -7,15 +7,20 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <stdint.h>
 #include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
+#include <libcamera/base/shared_fd.h>
 #include <libcamera/base/span.h>
 
 #include <libcamera/framebuffer.h>
 
+#include "libcamera/internal/dma_buf_allocator.h"
+
 namespace libcamera {
 
 class MappedBuffer
@@ -59,4 +64,22 @@ public:
 
 LIBCAMERA_FLAGS_ENABLE_OPERATORS(MappedFrameBuffer::MapFlag)
 
+class MappedFrameBufferCache
+{
+public:
+	MappedFrameBuffer *map(const FrameBuffer *buffer,
+			       MappedFrameBuffer::MapFlags flags,
+			       std::vector<DmaSyncer> *syncers = nullptr);
+	void clear();
+
+private:
+	struct Entry {
+		SharedFD fd;
+		MappedFrameBuffer::MapFlags flags;
+		std::unique_ptr<MappedFrameBuffer> mapping;
+	};
+
+	std::map<const FrameBuffer *, Entry> mappings_;
+};
+
 } /* namespace libcamera */
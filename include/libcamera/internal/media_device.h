@@ -8,12 +8,14 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
 
 #include <linux/media.h>
 
+#include <libcamera/base/class.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/signal.h>
 #include <libcamera/base/unique_fd.h>
@@ -22,6 +24,33 @@
 
 namespace libcamera {
 
+class EventNotifier;
+
+class MediaRequest
+{
+public:
+	~MediaRequest();
+
+	const UniqueFD &fd() const { return fd_; }
+
+	int queue();
+	int reinit();
+
+	Signal<MediaRequest *> completed;
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(MediaRequest)
+
+	friend class MediaDevice;
+
+	MediaRequest(UniqueFD fd);
+
+	void requestReady();
+
+	UniqueFD fd_;
+	std::unique_ptr<EventNotifier> notifier_;
+};
+
 class MediaDevice : protected Loggable
 {
 public:
@@ -54,6 +83,9 @@ public:
 	MediaLink *link(const MediaPad *source, const MediaPad *sink);
 	int disableLinks();
 
+	int allocateRequests(unsigned int count,
+			     std::vector<std::unique_ptr<MediaRequest>> *requests);
+
 	Signal<> disconnected;
 
 protected:
@@ -76,6 +108,7 @@ private:
 
 	friend int MediaLink::setEnabled(bool enable);
 	int setupLink(const MediaLink *link, unsigned int flags);
+	int updateLinks();
 
 	std::string driver_;
 	std::string deviceNode_;
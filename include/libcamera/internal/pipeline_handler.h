@@ -17,6 +17,7 @@
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
 
+#include <libcamera/camera.h>
 #include <libcamera/controls.h>
 #include <libcamera/stream.h>
 
@@ -54,6 +55,9 @@ public:
 
 	virtual int exportFrameBuffers(Camera *camera, Stream *stream,
 				       std::vector<std::unique_ptr<FrameBuffer>> *buffers) = 0;
+	virtual int registerFrameBuffers(Camera *camera, Stream *stream,
+					 Span<FrameBuffer *const> buffers);
+	virtual bool supportsReprocessing(const Camera *camera) const;
 
 	virtual int start(Camera *camera, const ControlList *controls) = 0;
 	void stop(Camera *camera);
@@ -61,9 +65,13 @@ public:
 
 	void registerRequest(Request *request);
 	void queueRequest(Request *request);
+	void queueRequests(const std::vector<Request *> &requests);
 
+	void metadataAvailable(Request *request, const ControlList &metadata);
 	bool completeBuffer(Request *request, FrameBuffer *buffer);
 	void completeRequest(Request *request);
+	void recordLatency(Request *request, CameraStatistics::Stage stage,
+			   uint64_t timestamp);
 
 	std::string configurationFile(const std::string &subdir,
 				      const std::string &name) const;
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <list>
 #include <signal.h>
 #include <string>
 #include <vector>
@@ -42,8 +43,6 @@ public:
 	Signal<enum ExitStatus, int> finished;
 
 private:
-	void closeAllFdsExcept(const std::vector<int> &fds);
-	int isolate();
 	void died(int wstatus);
 
 	pid_t pid_;
@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Unpacking of packed RAW pixel data
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include "libcamera/internal/bayer_format.h"
+
+namespace libcamera {
+
+namespace raw {
+
+void unpack10P(const uint8_t *src, uint16_t *dst, unsigned int pixels,
+	       unsigned int shift = 0);
+void unpack12P(const uint8_t *src, uint16_t *dst, unsigned int pixels,
+	       unsigned int shift = 0);
+void unpackIPU3(const uint8_t *src, uint16_t *dst, unsigned int pixels,
+		unsigned int shift = 0);
+
+int unpackLine(const BayerFormat &format, const uint8_t *src, uint16_t *dst,
+	       unsigned int pixels, unsigned int shift = 0);
+
+inline void unpackMsb10P(const uint8_t *src, uint8_t *dst, unsigned int pixels)
+{
+	for (unsigned int i = 0; i < pixels; i += 4, src += 5, dst += 4)
+		memcpy(dst, src, 4);
+}
+
+} /* namespace raw */
+
+} /* namespace libcamera */
@@ -8,11 +8,13 @@
 #pragma once
 
 #include <chrono>
-#include <map>
 #include <memory>
+#include <vector>
 
 #include <libcamera/base/event_notifier.h>
 #include <libcamera/base/timer.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/request.h>
 
@@ -38,6 +40,7 @@ public:
 	void complete();
 	void cancel();
 	void reset();
+	void reserve(unsigned int numBuffers);
 
 	void prepare(std::chrono::milliseconds timeout = 0ms);
 	Signal<> prepared;
@@ -48,16 +51,23 @@ private:
 
 	void doCancelRequest();
 	void emitPrepareCompleted();
-	void notifierActivated(FrameBuffer *buffer);
+	bool watchFences();
+	void unwatchFences();
+	void fencesActivated();
 	void timeout();
 
 	Camera *camera_;
 	bool cancelled_;
 	uint32_t sequence_ = 0;
 	bool prepared_ = false;
+	utils::time_point queuedTime_;
 
-	std::unordered_set<FrameBuffer *> pending_;
-	std::map<FrameBuffer *, std::unique_ptr<EventNotifier>> notifiers_;
+	FrameBuffer *reprocessBuffer_ = nullptr;
+
+	std::vector<FrameBuffer *> pending_;
+	std::vector<FrameBuffer *> fenced_;
+	UniqueFD fenceWaitFd_;
+	std::unique_ptr<EventNotifier> fenceNotifier_;
 	std::unique_ptr<Timer> timer_;
 };
 
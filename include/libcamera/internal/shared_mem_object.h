@@ -8,10 +8,13 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <stddef.h>
 #include <stdint.h>
 #include <string>
 #include <sys/mman.h>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 
@@ -24,9 +27,15 @@ namespace libcamera {
 class SharedMem
 {
 public:
+	enum class Backing {
+		Pages,
+		HugePages,
+	};
+
 	SharedMem();
 
-	SharedMem(const std::string &name, std::size_t size);
+	SharedMem(const std::string &name, std::size_t size,
+		  Backing backing = Backing::Pages);
 	SharedMem(SharedMem &&rhs);
 
 	virtual ~SharedMem();
@@ -43,6 +52,11 @@ public:
 		return mem_;
 	}
 
+	Backing backing() const
+	{
+		return backing_;
+	}
+
 	explicit operator bool() const
 	{
 		return !mem_.empty();
@@ -51,9 +65,13 @@ public:
 private:
 	LIBCAMERA_DISABLE_COPY(SharedMem)
 
+	bool allocate(const std::string &name, std::size_t size,
+		      Backing backing);
+
 	SharedFD fd_;
 
 	Span<uint8_t> mem_;
+	Backing backing_ = Backing::Pages;
 };
 
 template<class T, typename = std::enable_if_t<std::is_standard_layout<T>::value>>
@@ -124,4 +142,152 @@ private:
 	T *obj_;
 };
 
+#ifndef __DOXYGEN__
+namespace details {
+
+template<class... Ts>
+constexpr std::array<std::size_t, sizeof...(Ts) + 1> sharedMemLayout()
+{
+	/* Align objects to cache lines to avoid false sharing between them. */
+	constexpr std::size_t kAlignment = 64;
+	constexpr std::size_t sizes[] = { sizeof(Ts)... };
+	constexpr std::size_t alignments[] = { std::max(alignof(Ts), kAlignment)... };
+
+	std::array<std::size_t, sizeof...(Ts) + 1> layout{};
+	std::size_t offset = 0;
+
+	for (std::size_t i = 0; i < sizeof...(Ts); ++i) {
+		offset = (offset + alignments[i] - 1) / alignments[i] * alignments[i];
+		layout[i] = offset;
+		offset += sizes[i];
+	}
+
+	layout[sizeof...(Ts)] = offset;
+
+	return layout;
+}
+
+template<class T, class... Ts>
+constexpr std::size_t sharedMemIndex()
+{
+	constexpr bool matches[] = { std::is_same_v<T, Ts>... };
+
+	for (std::size_t i = 0; i < sizeof...(Ts); ++i) {
+		if (matches[i])
+			return i;
+	}
+
+	return sizeof...(Ts);
+}
+
+template<class... Ts>
+constexpr bool sharedMemUnique()
+{
+	constexpr std::size_t indices[] = { sharedMemIndex<Ts, Ts...>()... };
+
+	for (std::size_t i = 0; i < sizeof...(Ts); ++i) {
+		if (indices[i] != i)
+			return false;
+	}
+
+	return true;
+}
+
+} /* namespace details */
+#endif /* __DOXYGEN__ */
+
+template<class... Ts>
+class SharedMemObjects : public SharedMem
+{
+	static_assert(sizeof...(Ts) > 0, "SharedMemObjects requires objects");
+	static_assert((std::is_standard_layout<Ts>::value && ...),
+		      "Shared objects must have a standard layout");
+	static_assert(details::sharedMemUnique<Ts...>(),
+		      "Shared objects must have distinct types");
+
+public:
+	static constexpr std::size_t kSize =
+		details::sharedMemLayout<Ts...>()[sizeof...(Ts)];
+
+	SharedMemObjects()
+		: SharedMem()
+	{
+	}
+
+	SharedMemObjects(const std::string &name, Backing backing = Backing::Pages)
+		: SharedMem(name, kSize, backing)
+	{
+		if (mem().empty())
+			return;
+
+		construct(std::index_sequence_for<Ts...>{});
+	}
+
+	SharedMemObjects(SharedMemObjects<Ts...> &&rhs)
+		: SharedMem(std::move(rhs)), objs_(rhs.objs_)
+	{
+		rhs.objs_ = {};
+	}
+
+	~SharedMemObjects()
+	{
+		destroy();
+	}
+
+	SharedMemObjects<Ts...> &operator=(SharedMemObjects<Ts...> &&rhs)
+	{
+		destroy();
+		SharedMem::operator=(std::move(rhs));
+		this->objs_ = rhs.objs_;
+		rhs.objs_ = {};
+		return *this;
+	}
+
+	template<class T>
+	static constexpr std::size_t offset()
+	{
+		return details::sharedMemLayout<Ts...>()[index<T>()];
+	}
+
+	template<class T>
+	T &get()
+	{
+		return *std::get<index<T>()>(objs_);
+	}
+
+	template<class T>
+	const T &get() const
+	{
+		return *std::get<index<T>()>(objs_);
+	}
+
+private:
+	LIBCAMERA_DISABLE_COPY(SharedMemObjects)
+
+	template<class T>
+	static constexpr std::size_t index()
+	{
+		constexpr std::size_t i = details::sharedMemIndex<T, Ts...>();
+		static_assert(i < sizeof...(Ts), "Type not stored in SharedMemObjects");
+		return i;
+	}
+
+	template<std::size_t... Is>
+	void construct(std::index_sequence<Is...>)
+	{
+		constexpr auto layout = details::sharedMemLayout<Ts...>();
+
+		((std::get<Is>(objs_) = new (mem().data() + layout[Is]) Ts()), ...);
+	}
+
+	void destroy()
+	{
+		std::apply([](Ts *...objs) {
+			((objs ? objs->~Ts() : void()), ...);
+		}, objs_);
+	}
+
+	std::tuple<Ts *...> objs_{};
+};
+
 } /* namespace libcamera */
@@ -17,12 +17,26 @@ namespace libcamera {
 
 struct DebayerParams {
 	static constexpr unsigned int kRGBLookupSize = 256;
+	static constexpr unsigned int kGammaLookupSize = 1024;
+	static constexpr unsigned int kLscGridWidth = 16;
+	static constexpr unsigned int kLscGridHeight = 12;
 
 	using ColorLookupTable = std::array<uint8_t, kRGBLookupSize>;
+	using GammaLookupTable = std::array<uint8_t, kGammaLookupSize>;
+	using LscGrid = std::array<uint16_t, kLscGridWidth * kLscGridHeight>;
 
 	ColorLookupTable red;
 	ColorLookupTable green;
 	ColorLookupTable blue;
+
+	bool colorCorrection;
+	LscGrid lscRed;
+	LscGrid lscGreen;
+	LscGrid lscBlue;
+	std::array<int16_t, 9> ccm;
+	GammaLookupTable gamma;
 };
 
+static constexpr unsigned int kDebayerParamsBufferCount = 8;
+
 } /* namespace libcamera */
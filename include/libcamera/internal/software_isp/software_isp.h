@@ -7,18 +7,24 @@
 
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <functional>
 #include <initializer_list>
 #include <map>
 #include <memory>
+#include <optional>
+#include <stdint.h>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/signal.h>
 #include <libcamera/base/thread.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/geometry.h>
 #include <libcamera/pixel_format.h>
@@ -29,8 +35,8 @@
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/dma_buf_allocator.h"
 #include "libcamera/internal/pipeline_handler.h"
-#include "libcamera/internal/shared_mem_object.h"
 #include "libcamera/internal/software_isp/debayer_params.h"
+#include "libcamera/internal/software_isp/swisp_shared_mem.h"
 
 namespace libcamera {
 
@@ -44,6 +50,15 @@ LOG_DECLARE_CATEGORY(SoftwareIsp)
 class SoftwareIsp
 {
 public:
+	struct Metrics {
+		uint64_t processedFrames;
+		uint64_t droppedFrames;
+		unsigned int queueDepth;
+		utils::Duration lastProcessingTime;
+		utils::Duration averageProcessingTime;
+		utils::Duration maxProcessingTime;
+	};
+
 	SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor);
 	~SoftwareIsp();
 
@@ -65,34 +80,73 @@ public:
 	int exportBuffers(unsigned int output, unsigned int count,
 			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
 
-	void processStats(const ControlList &sensorControls);
+	void processStats(const uint32_t frame, const uint32_t bufferId,
+			  const ControlList &sensorControls);
 
 	int start();
 	void stop();
 
-	int queueBuffers(FrameBuffer *input,
-			 const std::map<unsigned int, FrameBuffer *> &outputs);
+	Size minCropSize() const;
+
+	int queueBuffers(uint32_t frame, FrameBuffer *input,
+			 const std::map<unsigned int, FrameBuffer *> &outputs,
+			 const Rectangle &crop = {});
 
-	void process(FrameBuffer *input, FrameBuffer *output);
+	void process(uint32_t frame, FrameBuffer *input, FrameBuffer *output,
+		     const Rectangle &crop = {});
+
+	Metrics metrics() const;
 
 	Signal<FrameBuffer *> inputBufferReady;
 	Signal<FrameBuffer *> outputBufferReady;
-	Signal<> ispStatsReady;
+	Signal<uint32_t, uint32_t> ispStatsReady;
 	Signal<const ControlList &> setSensorControls;
 
 private:
-	void saveIspParams();
+	struct QueuedFrame {
+		FrameBuffer *input;
+		FrameBuffer *output;
+		Rectangle crop;
+		const DebayerParams *params;
+	};
+
+	void paramsBufferReady(uint32_t frame, uint32_t bufferId);
+	void dispatchFrames() LIBCAMERA_TSA_REQUIRES(pendingMutex_);
 	void setSensorCtrls(const ControlList &sensorControls);
-	void statsReady();
+	void statsReady(uint32_t frame, uint32_t bufferId);
 	void inputReady(FrameBuffer *input);
 	void outputReady(FrameBuffer *output);
 
+	/* Parameters and statistics rings, must outlive the debayer */
+	SwIspSharedMem sharedMem_;
 	std::unique_ptr<DebayerCpu> debayer_;
 	Thread ispWorkerThread_;
-	SharedMemObject<DebayerParams> sharedParams_;
-	DebayerParams debayerParams_;
+	/* Frames waiting for the IPA to fill their parameters buffer */
+	std::map<uint32_t, QueuedFrame> queuedFrames_;
 	DmaBufAllocator dmaHeap_;
 
+	/* Input frames sequence tracking to detect frame drops */
+	std::optional<uint32_t> lastSequence_;
+	uint64_t droppedFrames_;
+	/* Frames queued for processing, decremented in the ISP worker thread */
+	std::atomic<unsigned int> queueDepth_;
+
+	/*
+	 * Frames handed to the ISP worker, and frames with their parameters
+	 * ready waiting for the worker. The parameters of all these frames must
+	 * be held in distinct parameters buffers. The number of frames in
+	 * flight follows the number of input buffers.
+	 */
+	static constexpr unsigned int kMaxPendingFrames = 1;
+	static constexpr unsigned int kMaxFramesInFlight =
+		kDebayerParamsBufferCount - kMaxPendingFrames - 1;
+	unsigned int maxFramesInFlight_;
+
+	Mutex pendingMutex_;
+	std::deque<std::pair<uint32_t, QueuedFrame>> pendingFrames_
+		LIBCAMERA_TSA_GUARDED_BY(pendingMutex_);
+	unsigned int framesInFlight_ LIBCAMERA_TSA_GUARDED_BY(pendingMutex_);
+
 	std::unique_ptr<ipa::soft::IPAProxySoft> ipa_;
 };
 
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Memory shared between the Software ISP and the IPA
+ */
+
+#pragma once
+
+#include <array>
+
+#include "libcamera/internal/shared_mem_object.h"
+#include "libcamera/internal/software_isp/debayer_params.h"
+#include "libcamera/internal/software_isp/swisp_stats.h"
+
+namespace libcamera {
+
+using DebayerParamsRing = std::array<DebayerParams, kDebayerParamsBufferCount>;
+using SwIspStatsRing = std::array<SwIspStats, kSwIspStatsBufferCount>;
+
+using SwIspSharedMem = SharedMemObjects<DebayerParamsRing, SwIspStatsRing>;
+
+} /* namespace libcamera */
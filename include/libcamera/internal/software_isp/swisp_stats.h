@@ -44,6 +44,51 @@ struct SwIspStats {
 	 * \brief A histogram of luminance values
 	 */
 	Histogram yHistogram;
+	/**
+	 * \brief Number of zones in each line of the zones grid
+	 */
+	static constexpr unsigned int kGridWidth = 16;
+	/**
+	 * \brief Number of zones in each column of the zones grid
+	 */
+	static constexpr unsigned int kGridHeight = 12;
+	/**
+	 * \brief Statistics of a zone of the image
+	 */
+	struct Zone {
+		/**
+		 * \brief Sum of the sampled red pixels in the zone
+		 */
+		uint64_t sumR;
+		/**
+		 * \brief Sum of the sampled green pixels in the zone
+		 */
+		uint64_t sumG;
+		/**
+		 * \brief Sum of the sampled blue pixels in the zone
+		 */
+		uint64_t sumB;
+		/**
+		 * \brief Number of samples in the zone
+		 */
+		uint32_t count;
+	};
+	/**
+	 * \brief Statistics of a grid of kGridWidth x kGridHeight zones
+	 *
+	 * The zones split the statistics window evenly and are stored in raster
+	 * order. Their sums add up to sumR_, sumG_ and sumB_.
+	 */
+	std::array<Zone, kGridWidth * kGridHeight> zones;
 };
 
+/**
+ * \brief Number of statistics buffers shared between the Software ISP and the IPA
+ *
+ * The statistics are stored in a ring of buffers, allowing the IPA to process
+ * the statistics of a frame while the statistics of the next frames are being
+ * gathered.
+ */
+static constexpr unsigned int kSwIspStatsBufferCount = 4;
+
 } /* namespace libcamera */
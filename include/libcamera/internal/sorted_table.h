@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Lookup tables sorted at compile time
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <stddef.h>
+
+namespace libcamera {
+
+namespace utils {
+
+template<typename T, size_t N, typename Projection>
+constexpr std::array<T, N> sortedTable(const T (&entries)[N], Projection proj)
+{
+	std::array<T, N> table{};
+
+	/* Insertion sort, stable to keep the first of equivalent entries first. */
+	for (size_t i = 0; i < N; ++i) {
+		const T &entry = entries[i];
+		size_t j = i;
+
+		for (; j > 0 && proj(entry) < proj(table[j - 1]); --j)
+			table[j] = table[j - 1];
+
+		table[j] = entry;
+	}
+
+	return table;
+}
+
+template<typename T, size_t N, typename Projection>
+constexpr std::array<unsigned int, N>
+sortedTableIndex(const std::array<T, N> &table, Projection proj)
+{
+	std::array<unsigned int, N> index{};
+
+	for (size_t i = 0; i < N; ++i) {
+		size_t j = i;
+
+		for (; j > 0 && proj(table[i]) < proj(table[index[j - 1]]); --j)
+			index[j] = index[j - 1];
+
+		index[j] = i;
+	}
+
+	return index;
+}
+
+template<typename T, size_t N, typename Projection>
+constexpr bool sortedTableIsUnique(const std::array<T, N> &table, Projection proj)
+{
+	for (size_t i = 1; i < N; ++i) {
+		if (!(proj(table[i - 1]) < proj(table[i])))
+			return false;
+	}
+
+	return true;
+}
+
+template<typename T, size_t N, typename Key, typename Projection>
+const T *sortedTableFind(const std::array<T, N> &table, const Key &key,
+			 Projection proj)
+{
+	auto it = std::lower_bound(table.begin(), table.end(), key,
+				   [&](const T &entry, const Key &value) {
+					   return proj(entry) < value;
+				   });
+	if (it == table.end() || !(proj(*it) == key))
+		return nullptr;
+
+	return &*it;
+}
+
+template<typename T, size_t N, typename Key, typename Projection>
+const T *sortedTableFind(const std::array<T, N> &table,
+			 const std::array<unsigned int, N> &index,
+			 const Key &key, Projection proj)
+{
+	auto it = std::lower_bound(index.begin(), index.end(), key,
+				   [&](unsigned int i, const Key &value) {
+					   return proj(table[i]) < value;
+				   });
+	if (it == index.end() || !(proj(table[*it]) == key))
+		return nullptr;
+
+	return &table[*it];
+}
+
+} /* namespace utils */
+
+} /* namespace libcamera */
@@ -0,0 +1,159 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * In-process ring buffer tracer
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+
+namespace libcamera {
+
+class Tracer
+{
+public:
+	static constexpr unsigned int kMaxArgs = 4;
+	static constexpr unsigned int kMaxStringLength = 24;
+
+	enum class ArgType : uint8_t {
+		None,
+		Unsigned,
+		Signed,
+		Pointer,
+		String,
+	};
+
+	struct Event {
+		uint64_t timestamp;
+		unsigned int id;
+		ArgType types[kMaxArgs];
+		union {
+			uint64_t value;
+			char string[kMaxStringLength];
+		} args[kMaxArgs];
+	};
+
+	~Tracer();
+
+	static Tracer *instance();
+
+	static bool enabled()
+	{
+		State state = state_.load(std::memory_order_relaxed);
+		if (state == State::Unknown) [[unlikely]]
+			state = initialize();
+
+		return state == State::Enabled;
+	}
+
+	static unsigned int registerEvent(const char *name, const char *argNames);
+
+	template<typename... Args>
+	static void record(unsigned int id, const Args &...args)
+	{
+		static_assert(sizeof...(Args) <= kMaxArgs,
+			      "Too many tracepoint arguments");
+
+		Event event;
+		unsigned int index = 0;
+
+		event.id = id;
+		(setArg(event, index++, args), ...);
+		for (; index < kMaxArgs; ++index)
+			event.types[index] = ArgType::None;
+
+		write(event);
+	}
+
+	void dump(std::ostream &stream);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(Tracer)
+
+	enum class State : unsigned int {
+		Unknown,
+		Disabled,
+		Enabled,
+	};
+
+	struct EventInfo {
+		std::string name;
+		std::vector<std::string> argNames;
+	};
+
+	class Ring;
+
+	Tracer();
+
+	static State initialize();
+	static void write(Event &event);
+
+	template<typename T>
+	static void setArg(Event &event, unsigned int index, const T &value)
+	{
+		using U = std::decay_t<T>;
+
+		if constexpr (std::is_same_v<U, const char *> || std::is_same_v<U, char *>) {
+			event.types[index] = ArgType::String;
+			strncpy(event.args[index].string, value ? value : "",
+				kMaxStringLength - 1);
+			event.args[index].string[kMaxStringLength - 1] = '\0';
+		} else if constexpr (std::is_pointer_v<U>) {
+			event.types[index] = ArgType::Pointer;
+			event.args[index].value = reinterpret_cast<uintptr_t>(value);
+		} else if constexpr (std::is_enum_v<U>) {
+			setArg(event, index, static_cast<std::underlying_type_t<U>>(value));
+		} else if constexpr (std::is_signed_v<U>) {
+			event.types[index] = ArgType::Signed;
+			event.args[index].value = static_cast<int64_t>(value);
+		} else {
+			static_assert(std::is_integral_v<U>,
+				      "Unsupported tracepoint argument type");
+			event.types[index] = ArgType::Unsigned;
+			event.args[index].value = static_cast<uint64_t>(value);
+		}
+	}
+
+	Ring *threadRing();
+	void dumpToFile();
+
+	static std::atomic<State> state_;
+
+	std::string path_;
+	unsigned int capacity_;
+
+	Mutex mutex_;
+	std::vector<EventInfo> events_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::vector<std::shared_ptr<Ring>> rings_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
+	Mutex dumpMutex_;
+
+	struct SignalHandler;
+	std::unique_ptr<SignalHandler> signal_;
+};
+
+#define LIBCAMERA_TRACER_RECORD_ARGS(event, names, ...)				\
+	do {									\
+		if (libcamera::Tracer::enabled()) {				\
+			static const unsigned int tracerEventId =		\
+				libcamera::Tracer::registerEvent(#event, names); \
+			libcamera::Tracer::record(tracerEventId, __VA_ARGS__);	\
+		}								\
+	} while (0)
+
+#define LIBCAMERA_TRACER_RECORD(event, ...) \
+	LIBCAMERA_TRACER_RECORD_ARGS(event, #__VA_ARGS__, __VA_ARGS__)
+
+} /* namespace libcamera */
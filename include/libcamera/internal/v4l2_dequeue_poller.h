@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Dedicated thread to dequeue buffers from V4L2 video devices
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include <linux/videodev2.h>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+
+namespace libcamera {
+
+class EventNotifier;
+
+class V4L2DequeuePoller
+{
+private:
+	class Worker;
+
+public:
+	struct Completion {
+		struct v4l2_buffer buffer;
+		struct v4l2_plane planes[VIDEO_MAX_PLANES];
+	};
+
+	class Channel
+	{
+	public:
+		~Channel();
+
+		void queued();
+		bool pop(Completion *completion);
+		void stop();
+
+		Signal<> ready;
+
+	private:
+		LIBCAMERA_DISABLE_COPY_AND_MOVE(Channel)
+
+		friend class V4L2DequeuePoller;
+		friend class Worker;
+
+		static constexpr unsigned int kRingSize = 64;
+
+		Channel(Worker *worker, int fd, enum v4l2_buf_type bufferType,
+			enum v4l2_memory memoryType, unsigned int queued);
+
+		void notified();
+		bool armed() const;
+		bool dequeue();
+
+		Worker *worker_;
+		int fd_;
+		enum v4l2_buf_type bufferType_;
+		enum v4l2_memory memoryType_;
+		bool stopped_;
+
+		UniqueFD eventFd_;
+		std::unique_ptr<EventNotifier> eventNotifier_;
+
+		std::atomic<unsigned int> queued_;
+		std::atomic<bool> stalled_;
+		alignas(64) std::atomic<unsigned int> head_;
+		alignas(64) std::atomic<unsigned int> tail_;
+		std::array<Completion, kRingSize> ring_;
+	};
+
+	V4L2DequeuePoller(const std::string &name, int priority = 0);
+	~V4L2DequeuePoller();
+
+	std::unique_ptr<Channel> attach(int fd, enum v4l2_buf_type bufferType,
+					enum v4l2_memory memoryType,
+					unsigned int queued);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(V4L2DequeuePoller)
+
+	Thread thread_;
+	std::unique_ptr<Worker> worker_;
+};
+
+} /* namespace libcamera */
@@ -27,6 +27,7 @@
 namespace libcamera {
 
 class EventNotifier;
+class MediaRequest;
 
 class V4L2Device : protected Loggable
 {
@@ -37,7 +38,10 @@ public:
 	const ControlInfoMap &controls() const { return controls_; }
 
 	ControlList getControls(const std::vector<uint32_t> &ids);
-	int setControls(ControlList *ctrls);
+	int setControls(ControlList *ctrls, const MediaRequest *request = nullptr);
+
+	void queueControls(const ControlList &ctrls);
+	int flushControls(ControlList *ctrls = nullptr);
 
 	const struct v4l2_query_ext_ctrl *controlInfo(uint32_t id) const;
 
@@ -45,6 +49,7 @@ public:
 	std::string devicePath() const;
 
 	int setFrameStartEnabled(bool enable);
+	void setFrameStartCoalescing(bool coalesce) { frameStartCoalescing_ = coalesce; }
 	Signal<uint32_t> frameStart;
 
 	void updateControlInfo();
@@ -83,11 +88,13 @@ private:
 	std::vector<std::unique_ptr<ControlId>> controlIds_;
 	ControlIdMap controlIdMap_;
 	ControlInfoMap controls_;
+	ControlList pendingControls_;
 	std::string deviceNode_;
 	UniqueFD fd_;
 
 	EventNotifier *fdEventNotifier_;
 	bool frameStartEnabled_;
+	bool frameStartCoalescing_;
 };
 
 } /* namespace libcamera */
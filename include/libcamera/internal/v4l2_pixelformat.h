@@ -16,6 +16,8 @@
 
 #include <linux/videodev2.h>
 
+#include <libcamera/base/span.h>
+
 #include <libcamera/pixel_format.h>
 
 namespace libcamera {
@@ -28,25 +30,25 @@ public:
 		const char *description;
 	};
 
-	V4L2PixelFormat()
+	constexpr V4L2PixelFormat()
 		: fourcc_(0)
 	{
 	}
 
-	explicit V4L2PixelFormat(uint32_t fourcc)
+	explicit constexpr V4L2PixelFormat(uint32_t fourcc)
 		: fourcc_(fourcc)
 	{
 	}
 
-	bool isValid() const { return fourcc_ != 0; }
-	uint32_t fourcc() const { return fourcc_; }
-	operator uint32_t() const { return fourcc_; }
+	constexpr bool isValid() const { return fourcc_ != 0; }
+	constexpr uint32_t fourcc() const { return fourcc_; }
+	constexpr operator uint32_t() const { return fourcc_; }
 
 	std::string toString() const;
 	const char *description() const;
 
 	PixelFormat toPixelFormat(bool warn = true) const;
-	static const std::vector<V4L2PixelFormat> &
+	static Span<const V4L2PixelFormat>
 	fromPixelFormat(const PixelFormat &pixelFormat);
 
 private:
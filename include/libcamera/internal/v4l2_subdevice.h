@@ -7,10 +7,13 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <optional>
 #include <ostream>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <linux/v4l2-subdev.h>
@@ -157,6 +160,9 @@ public:
 	int getRouting(Routing *routing, Whence whence = ActiveFormat);
 	int setRouting(Routing *routing, Whence whence = ActiveFormat);
 
+	void enableStateCache(bool enable);
+	void invalidateStateCache();
+
 	const std::string &model();
 	const V4L2SubdeviceCapability &caps() const { return caps_; }
 
@@ -179,10 +185,24 @@ private:
 	int getRoutingLegacy(Routing *routing, Whence whence);
 	int setRoutingLegacy(Routing *routing, Whence whence);
 
+	struct StateCache {
+		std::map<std::pair<unsigned int, unsigned int>,
+			 V4L2SubdeviceFormat> formats;
+		std::map<std::tuple<unsigned int, unsigned int, unsigned int>,
+			 Rectangle> selections;
+		std::optional<Routing> routing;
+	};
+
+	StateCache *stateCache(Whence whence);
+
 	const MediaEntity *entity_;
 
 	std::string model_;
 	struct V4L2SubdeviceCapability caps_;
+	std::map<std::pair<unsigned int, unsigned int>, Formats> formatsCache_;
+
+	bool stateCacheEnabled_;
+	StateCache stateCache_[2];
 };
 
 bool operator==(const V4L2Subdevice::Stream &lhs, const V4L2Subdevice::Stream &rhs);
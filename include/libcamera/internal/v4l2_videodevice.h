@@ -12,9 +12,12 @@
 #include <memory>
 #include <optional>
 #include <ostream>
+#include <set>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include <linux/videodev2.h>
@@ -22,6 +25,7 @@
 #include <libcamera/base/class.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
 #include <libcamera/base/timer.h>
 #include <libcamera/base/unique_fd.h>
 #include <libcamera/base/utils.h>
@@ -32,6 +36,7 @@
 #include <libcamera/pixel_format.h>
 
 #include "libcamera/internal/formats.h"
+#include "libcamera/internal/v4l2_dequeue_poller.h"
 #include "libcamera/internal/v4l2_device.h"
 #include "libcamera/internal/v4l2_pixelformat.h"
 
@@ -124,7 +129,8 @@ struct V4L2Capability final : v4l2_capability {
 class V4L2BufferCache
 {
 public:
-	V4L2BufferCache(unsigned int numEntries);
+	V4L2BufferCache(unsigned int numEntries,
+			Span<const FrameBuffer *const> buffers = {});
 	V4L2BufferCache(const std::vector<std::unique_ptr<FrameBuffer>> &buffers);
 	~V4L2BufferCache();
 
@@ -141,8 +147,11 @@ private:
 
 		bool operator==(const FrameBuffer &buffer) const;
 
+		static size_t hash(const FrameBuffer &buffer);
+
 		bool free_;
 		uint64_t lastUsed_;
+		size_t hash_;
 
 	private:
 		struct Plane {
@@ -158,8 +167,13 @@ private:
 		std::vector<Plane> planes_;
 	};
 
+	void addEntry(const FrameBuffer &buffer);
+	void addFree(unsigned int index);
+
 	std::atomic<uint64_t> lastUsedCounter_;
 	std::vector<Entry> cache_;
+	std::unordered_multimap<size_t, unsigned int> index_;
+	std::set<std::pair<uint64_t, unsigned int>> freeEntries_;
 	/* \todo Expose the miss counter through an instrumentation API. */
 	unsigned int missCounter_;
 };
@@ -214,10 +228,12 @@ public:
 			    std::vector<std::unique_ptr<FrameBuffer>> *buffers);
 	int exportBuffers(unsigned int count,
 			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
-	int importBuffers(unsigned int count);
+	int importBuffers(unsigned int count,
+			  Span<const FrameBuffer *const> buffers = {});
 	int releaseBuffers();
 
-	int queueBuffer(FrameBuffer *buffer);
+	int queueBuffer(FrameBuffer *buffer, const MediaRequest *request = nullptr);
+	int queueBuffers(Span<FrameBuffer *const> buffers);
 	Signal<FrameBuffer *> bufferReady;
 
 	int streamOn();
@@ -226,6 +242,8 @@ public:
 	void setDequeueTimeout(utils::Duration timeout);
 	Signal<> dequeueTimeout;
 
+	void setDequeuePoller(V4L2DequeuePoller *poller);
+
 	static std::unique_ptr<V4L2VideoDevice>
 	fromEntityName(const MediaDevice *media, const std::string &entity);
 
@@ -275,6 +293,7 @@ private:
 	V4L2DeviceFormat format_;
 	const PixelFormatInfo *formatInfo_;
 	std::unordered_set<V4L2PixelFormat> pixelFormats_;
+	std::map<uint32_t, Formats> formatsCache_;
 
 	enum v4l2_buf_type bufferType_;
 	enum v4l2_memory memoryType_;
@@ -283,6 +302,8 @@ private:
 	std::map<unsigned int, FrameBuffer *> queuedBuffers_;
 
 	EventNotifier *fdBufferNotifier_;
+	V4L2DequeuePoller *dequeuePoller_;
+	std::unique_ptr<V4L2DequeuePoller::Channel> dequeueChannel_;
 
 	State state_;
 	std::optional<unsigned int> firstFrame_;
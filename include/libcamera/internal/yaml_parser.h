@@ -9,11 +9,13 @@
 
 #include <iterator>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
 #include <libcamera/base/class.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/geometry.h>
 
@@ -203,6 +205,8 @@ public:
 #endif
 	std::optional<std::vector<T>> getList() const;
 
+	std::optional<Span<const double>> getDoubleList() const;
+
 	DictAdapter asDict() const { return DictAdapter{ list_ }; }
 	ListAdapter asList() const { return ListAdapter{ list_ }; }
 
@@ -222,17 +226,27 @@ private:
 		Value,
 	};
 
+	void parseNumbers();
+	void collectNumbers();
+
 	Type type_;
 
 	std::string value_;
 	Container list_;
 	std::map<std::string, YamlObject *> dictionary_;
+
+	std::optional<long> signed_;
+	std::optional<unsigned long> unsigned_;
+	std::optional<double> double_;
+	std::optional<std::vector<double>> doubles_;
 };
 
 class YamlParser final
 {
 public:
 	static std::unique_ptr<YamlObject> parse(File &file);
+	static std::unique_ptr<YamlObject> parse(File &file, Span<const std::string> keys);
+	static std::shared_ptr<const YamlObject> parseShared(File &file);
 };
 
 } /* namespace libcamera */
@@ -56,6 +56,10 @@ public:
 	int addBuffer(const Stream *stream, FrameBuffer *buffer,
 		      std::unique_ptr<Fence> fence = nullptr);
 	FrameBuffer *findBuffer(const Stream *stream) const;
+	std::unique_ptr<Fence> exportFence(const Stream *stream);
+
+	int setReprocessBuffer(FrameBuffer *buffer);
+	FrameBuffer *reprocessBuffer() const;
 
 	uint32_t sequence() const;
 	uint64_t cookie() const { return cookie_; }
@@ -854,6 +854,7 @@ int CameraCapabilities::initializeStaticMetadata()
 		ANDROID_CONTROL_AWB_MODE,
 		ANDROID_CONTROL_CAPTURE_INTENT,
 		ANDROID_CONTROL_EFFECT_MODE,
+		ANDROID_CONTROL_ENABLE_ZSL,
 		ANDROID_CONTROL_MODE,
 		ANDROID_CONTROL_SCENE_MODE,
 		ANDROID_CONTROL_VIDEO_STABILIZATION_MODE,
@@ -886,6 +887,7 @@ int CameraCapabilities::initializeStaticMetadata()
 		ANDROID_CONTROL_AWB_STATE,
 		ANDROID_CONTROL_CAPTURE_INTENT,
 		ANDROID_CONTROL_EFFECT_MODE,
+		ANDROID_CONTROL_ENABLE_ZSL,
 		ANDROID_CONTROL_MODE,
 		ANDROID_CONTROL_SCENE_MODE,
 		ANDROID_CONTROL_VIDEO_STABILIZATION_MODE,
@@ -1560,6 +1562,9 @@ std::unique_ptr<CameraMetadata> CameraCapabilities::requestTemplatePreview() con
 	uint8_t controlMode = ANDROID_CONTROL_MODE_AUTO;
 	requestTemplate->addEntry(ANDROID_CONTROL_MODE, controlMode);
 
+	uint8_t enableZsl = ANDROID_CONTROL_ENABLE_ZSL_FALSE;
+	requestTemplate->addEntry(ANDROID_CONTROL_ENABLE_ZSL, enableZsl);
+
 	float lensAperture = 2.53 / 100;
 	requestTemplate->addEntry(ANDROID_LENS_APERTURE, lensAperture);
 
@@ -15,6 +15,7 @@
 #include <vector>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/span.h>
 #include <libcamera/base/unique_fd.h>
 #include <libcamera/base/utils.h>
 
@@ -231,6 +232,54 @@ bool validateCropRotate(const camera3_stream_configuration_t &streamList)
 }
 #endif
 
+/*
+ * Entries added to the result metadata for each capture on top of the result
+ * metadata template, with their maximum number of elements.
+ */
+struct ResultEntry {
+	uint32_t tag;
+	size_t count;
+};
+
+const ResultEntry dynamicResultEntries[] = {
+	{ ANDROID_CONTROL_AE_TARGET_FPS_RANGE, 2 },
+	{ ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, 1 },
+	{ ANDROID_CONTROL_ENABLE_ZSL, 1 },
+	{ ANDROID_LENS_APERTURE, 1 },
+	{ ANDROID_SENSOR_TIMESTAMP, 1 },
+	{ ANDROID_REQUEST_PIPELINE_DEPTH, 1 },
+	{ ANDROID_SENSOR_EXPOSURE_TIME, 1 },
+	{ ANDROID_SENSOR_FRAME_DURATION, 1 },
+	{ ANDROID_SCALER_CROP_REGION, 4 },
+	{ ANDROID_SENSOR_TEST_PATTERN_MODE, 1 },
+};
+
+/*
+ * Entries added by the JPEG post-processor. The GPS processing method is a
+ * string of arbitrary length, reserve 32 bytes for it.
+ */
+const ResultEntry jpegResultEntries[] = {
+	{ ANDROID_JPEG_GPS_COORDINATES, 3 },
+	{ ANDROID_JPEG_GPS_PROCESSING_METHOD, 32 },
+	{ ANDROID_JPEG_GPS_TIMESTAMP, 1 },
+	{ ANDROID_JPEG_SIZE, 1 },
+	{ ANDROID_JPEG_QUALITY, 1 },
+	{ ANDROID_JPEG_ORIENTATION, 1 },
+	{ ANDROID_JPEG_THUMBNAIL_QUALITY, 1 },
+	{ ANDROID_JPEG_THUMBNAIL_SIZE, 2 },
+};
+
+size_t resultEntriesDataSize(Span<const ResultEntry> entries)
+{
+	size_t size = 0;
+
+	for (const ResultEntry &entry : entries)
+		size += calculate_camera_metadata_entry_data_size(
+			get_camera_metadata_tag_type(entry.tag), entry.count);
+
+	return size;
+}
+
 } /* namespace */
 
 /*
@@ -248,7 +297,9 @@ bool validateCropRotate(const camera3_stream_configuration_t &streamList)
 
 CameraDevice::CameraDevice(unsigned int id, std::shared_ptr<Camera> camera)
 	: id_(id), state_(State::Stopped), camera_(std::move(camera)),
-	  facing_(CAMERA_FACING_FRONT), orientation_(0)
+	  resultEntryCapacity_(0), resultDataCapacity_(0),
+	  facing_(CAMERA_FACING_FRONT), orientation_(0), zslBuffers_(0),
+	  lastControls_(controls::controls), lastControlsValid_(false)
 {
 	camera_->requestCompleted.connect(this, &CameraDevice::requestComplete);
 
@@ -376,6 +427,9 @@ int CameraDevice::initialize(const CameraConfigData *cameraConfigData)
 		orientation_ = 0;
 	}
 
+	if (cameraConfigData)
+		zslBuffers_ = cameraConfigData->zslBuffers;
+
 	return capabilities_.initialize(camera_, orientation_, facing_);
 }
 
@@ -426,6 +480,10 @@ void CameraDevice::flush()
 
 	camera_->stop();
 
+	/* Frames captured before the flush must not be used for ZSL captures. */
+	for (CameraStream &cameraStream : streams_)
+		cameraStream.clearZslBuffers();
+
 	MutexLocker stateLock(stateMutex_);
 	state_ = State::Stopped;
 }
@@ -766,10 +824,150 @@ int CameraDevice::configureStreams(camera3_stream_configuration_t *stream_list)
 		}
 	}
 
+	ret = createResultTemplate();
+	if (ret)
+		return ret;
+
 	config_ = std::move(config);
 	return 0;
 }
 
+/*
+ * Create the result metadata template that holds the result metadata entries
+ * whose value doesn't depend on the capture, and compute the capacity of the
+ * result metadata packs for the configured streams. Result metadata packs are
+ * then allocated with their final size and filled by copying the template,
+ * without being resized when the entries of the capture are added.
+ */
+int CameraDevice::createResultTemplate()
+{
+	/*
+	 * \todo The value of the results metadata copied from the settings
+	 * will have to be passed to the libcamera::Camera and extracted
+	 * from libcamera::Request::metadata.
+	 */
+	auto resultTemplate = std::make_unique<CameraMetadata>(32, 8);
+	if (!resultTemplate->isValid()) {
+		LOG(HAL, Error) << "Failed to allocate result metadata template";
+		return -ENOMEM;
+	}
+
+	uint8_t value = ANDROID_COLOR_CORRECTION_ABERRATION_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_COLOR_CORRECTION_ABERRATION_MODE,
+				 value);
+
+	value = ANDROID_CONTROL_AE_ANTIBANDING_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_CONTROL_AE_ANTIBANDING_MODE, value);
+
+	int32_t value32 = 0;
+	resultTemplate->addEntry(ANDROID_CONTROL_AE_EXPOSURE_COMPENSATION,
+				 value32);
+
+	value = ANDROID_CONTROL_AE_LOCK_OFF;
+	resultTemplate->addEntry(ANDROID_CONTROL_AE_LOCK, value);
+
+	value = ANDROID_CONTROL_AE_MODE_ON;
+	resultTemplate->addEntry(ANDROID_CONTROL_AE_MODE, value);
+
+	value = ANDROID_CONTROL_AE_STATE_CONVERGED;
+	resultTemplate->addEntry(ANDROID_CONTROL_AE_STATE, value);
+
+	value = ANDROID_CONTROL_AF_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_CONTROL_AF_MODE, value);
+
+	value = ANDROID_CONTROL_AF_STATE_INACTIVE;
+	resultTemplate->addEntry(ANDROID_CONTROL_AF_STATE, value);
+
+	value = ANDROID_CONTROL_AF_TRIGGER_IDLE;
+	resultTemplate->addEntry(ANDROID_CONTROL_AF_TRIGGER, value);
+
+	value = ANDROID_CONTROL_AWB_MODE_AUTO;
+	resultTemplate->addEntry(ANDROID_CONTROL_AWB_MODE, value);
+
+	value = ANDROID_CONTROL_AWB_LOCK_OFF;
+	resultTemplate->addEntry(ANDROID_CONTROL_AWB_LOCK, value);
+
+	value = ANDROID_CONTROL_AWB_STATE_CONVERGED;
+	resultTemplate->addEntry(ANDROID_CONTROL_AWB_STATE, value);
+
+	value = ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW;
+	resultTemplate->addEntry(ANDROID_CONTROL_CAPTURE_INTENT, value);
+
+	value = ANDROID_CONTROL_EFFECT_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_CONTROL_EFFECT_MODE, value);
+
+	value = ANDROID_CONTROL_MODE_AUTO;
+	resultTemplate->addEntry(ANDROID_CONTROL_MODE, value);
+
+	value = ANDROID_CONTROL_SCENE_MODE_DISABLED;
+	resultTemplate->addEntry(ANDROID_CONTROL_SCENE_MODE, value);
+
+	value = ANDROID_CONTROL_VIDEO_STABILIZATION_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_CONTROL_VIDEO_STABILIZATION_MODE, value);
+
+	value = ANDROID_FLASH_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_FLASH_MODE, value);
+
+	value = ANDROID_FLASH_STATE_UNAVAILABLE;
+	resultTemplate->addEntry(ANDROID_FLASH_STATE, value);
+
+	float focal_length = 1.0;
+	resultTemplate->addEntry(ANDROID_LENS_FOCAL_LENGTH, focal_length);
+
+	value = ANDROID_LENS_STATE_STATIONARY;
+	resultTemplate->addEntry(ANDROID_LENS_STATE, value);
+
+	value = ANDROID_LENS_OPTICAL_STABILIZATION_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_LENS_OPTICAL_STABILIZATION_MODE,
+				 value);
+
+	value32 = ANDROID_SENSOR_TEST_PATTERN_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_SENSOR_TEST_PATTERN_MODE, value32);
+
+	value = ANDROID_STATISTICS_FACE_DETECT_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_STATISTICS_FACE_DETECT_MODE, value);
+
+	value = ANDROID_STATISTICS_LENS_SHADING_MAP_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_STATISTICS_LENS_SHADING_MAP_MODE,
+				 value);
+
+	value = ANDROID_STATISTICS_HOT_PIXEL_MAP_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_STATISTICS_HOT_PIXEL_MAP_MODE, value);
+
+	value = ANDROID_STATISTICS_SCENE_FLICKER_NONE;
+	resultTemplate->addEntry(ANDROID_STATISTICS_SCENE_FLICKER, value);
+
+	value = ANDROID_NOISE_REDUCTION_MODE_OFF;
+	resultTemplate->addEntry(ANDROID_NOISE_REDUCTION_MODE, value);
+
+	/* 33.3 msec */
+	const int64_t rolling_shutter_skew = 33300000;
+	resultTemplate->addEntry(ANDROID_SENSOR_ROLLING_SHUTTER_SKEW,
+				 rolling_shutter_skew);
+
+	if (!resultTemplate->isValid()) {
+		LOG(HAL, Error) << "Failed to construct result metadata template";
+		return -ENOMEM;
+	}
+
+	auto [entryCount, dataCount] = resultTemplate->usage();
+	resultEntryCapacity_ = entryCount + std::size(dynamicResultEntries);
+	resultDataCapacity_ = dataCount + resultEntriesDataSize(dynamicResultEntries);
+
+	bool hasJpeg = std::any_of(streams_.begin(), streams_.end(),
+				   [](const CameraStream &stream) {
+					   return stream.camera3Stream()->format == HAL_PIXEL_FORMAT_BLOB;
+				   });
+	if (hasJpeg) {
+		resultEntryCapacity_ += std::size(jpegResultEntries);
+		resultDataCapacity_ += resultEntriesDataSize(jpegResultEntries);
+	}
+
+	resultTemplate_ = std::move(resultTemplate);
+
+	return 0;
+}
+
 std::unique_ptr<HALFrameBuffer>
 CameraDevice::createFrameBuffer(const buffer_handle_t camera3buffer,
 				PixelFormat pixelFormat, const Size &size)
@@ -802,9 +1000,21 @@ int CameraDevice::processControls(Camera3RequestDescriptor *descriptor)
 	if (!settings.isValid())
 		return 0;
 
+	/*
+	 * Requests without settings repeat the settings of the previous
+	 * request, whose translation is cached in lastControls_.
+	 */
+	if (lastControlsValid_) {
+		descriptor->request_->controls().merge(lastControls_);
+		return 0;
+	}
+
 	/* Translate the Android request settings to libcamera controls. */
-	ControlList &controls = descriptor->request_->controls();
+	ControlList &controls = lastControls_;
 	camera_metadata_ro_entry_t entry;
+
+	controls.clear();
+
 	if (settings.getEntry(ANDROID_SCALER_CROP_REGION, &entry)) {
 		const int32_t *data = entry.data.i32;
 		Rectangle cropRegion{ data[0], data[1],
@@ -851,6 +1061,9 @@ int CameraDevice::processControls(Camera3RequestDescriptor *descriptor)
 		controls.set(controls::draft::TestPatternMode, testPatternMode);
 	}
 
+	lastControlsValid_ = true;
+	descriptor->request_->controls().merge(lastControls_);
+
 	return 0;
 }
 
@@ -948,8 +1161,10 @@ int CameraDevice::processCaptureRequest(camera3_capture_request_t *camera3Reques
 	 * a new request. Do we need to cache settings incrementally here, or is
 	 * it handled by the Android camera service ?
 	 */
-	if (camera3Request->settings)
+	if (camera3Request->settings) {
 		lastSettings_ = camera3Request->settings;
+		lastControlsValid_ = false;
+	}
 
 	descriptor->settings_ = lastSettings_;
 
@@ -963,6 +1178,12 @@ int CameraDevice::processCaptureRequest(camera3_capture_request_t *camera3Reques
 	 * Collect the CameraStream associated to each requested capture stream.
 	 * Since requestedStreams is an std:set<>, no duplications can happen.
 	 */
+	camera_metadata_ro_entry_t entry;
+	bool zsl = descriptor->settings_.getEntry(ANDROID_CONTROL_ENABLE_ZSL, &entry) &&
+		   *entry.data.u8 == ANDROID_CONTROL_ENABLE_ZSL_TRUE &&
+		   descriptor->settings_.getEntry(ANDROID_CONTROL_CAPTURE_INTENT, &entry) &&
+		   *entry.data.u8 == ANDROID_CONTROL_CAPTURE_INTENT_STILL_CAPTURE;
+
 	std::set<CameraStream *> requestedStreams;
 	for (const auto &[i, buffer] : utils::enumerate(descriptor->buffers_)) {
 		CameraStream *cameraStream = buffer.stream;
@@ -1006,6 +1227,28 @@ int CameraDevice::processCaptureRequest(camera3_capture_request_t *camera3Reques
 			break;
 
 		case CameraStream::Type::Internal:
+			/*
+			 * Serve zero-shutter-lag still captures from the most
+			 * recent frame retained by the stream, without adding
+			 * a buffer to the request.
+			 */
+			if (zsl) {
+				ControlList metadata;
+				frameBuffer = cameraStream->takeZslBuffer(&metadata);
+				if (frameBuffer) {
+					if (!descriptor->zslMetadata_)
+						descriptor->zslMetadata_ = std::move(metadata);
+
+					buffer.internalBuffer = frameBuffer;
+					buffer.srcBuffer = frameBuffer;
+					LOG(HAL, Debug) << ss.str() << " (zsl)";
+
+					descriptor->pendingStreamsToProcess_.insert(
+						{ cameraStream, &buffer });
+					continue;
+				}
+			}
+
 			/*
 			 * Get the frame buffer from the CameraStream internal
 			 * buffer pool.
@@ -1078,6 +1321,26 @@ int CameraDevice::processCaptureRequest(camera3_capture_request_t *camera3Reques
 		requestedStreams.insert(sourceStream);
 	}
 
+	/*
+	 * Keep the zero-shutter-lag ring of the streams not requested by the
+	 * framework fed with frames captured by this request. This also
+	 * ensures that requests fully served from the ring still capture a
+	 * frame.
+	 */
+	for (CameraStream &cameraStream : streams_) {
+		if (!cameraStream.zslEnabled() ||
+		    requestedStreams.find(&cameraStream) != requestedStreams.end())
+			continue;
+
+		FrameBuffer *frameBuffer = cameraStream.getBuffer();
+		if (!frameBuffer)
+			continue;
+
+		descriptor->request_->addBuffer(cameraStream.stream(),
+						frameBuffer, nullptr);
+		descriptor->zslBuffers_.emplace_back(&cameraStream, frameBuffer);
+	}
+
 	/*
 	 * Translate controls from Android to libcamera and queue the request
 	 * to the camera.
@@ -1094,6 +1357,10 @@ int CameraDevice::processCaptureRequest(camera3_capture_request_t *camera3Reques
 	MutexLocker stateLock(stateMutex_);
 
 	if (state_ == State::Flushing) {
+		for (const auto &[cameraStream, frameBuffer] : descriptor->zslBuffers_)
+			cameraStream->putBuffer(frameBuffer);
+		descriptor->zslBuffers_.clear();
+
 		Camera3RequestDescriptor *rawDescriptor = descriptor.get();
 		{
 			MutexLocker descriptorsLock(descriptorsMutex_);
@@ -1107,6 +1374,7 @@ int CameraDevice::processCaptureRequest(camera3_capture_request_t *camera3Reques
 
 	if (state_ == State::Stopped) {
 		lastSettings_ = {};
+		lastControlsValid_ = false;
 
 		ret = camera_->start();
 		if (ret) {
@@ -1160,6 +1428,19 @@ void CameraDevice::requestComplete(Request *request)
 		buffer.status = Camera3RequestDescriptor::Status::Success;
 	}
 
+	/*
+	 * Retain the frames captured for zero-shutter-lag, or return them to
+	 * their stream if the capture failed.
+	 */
+	for (const auto &[stream, frameBuffer] : descriptor->zslBuffers_) {
+		if (request->status() == Request::RequestComplete &&
+		    frameBuffer->metadata().status == FrameMetadata::FrameSuccess)
+			stream->pushZslBuffer(frameBuffer, request->metadata());
+		else
+			stream->putBuffer(frameBuffer);
+	}
+	descriptor->zslBuffers_.clear();
+
 	/*
 	 * If the Request has failed, abort the request by notifying the error
 	 * and complete the request with all buffers in error state.
@@ -1181,8 +1462,10 @@ void CameraDevice::requestComplete(Request *request)
 	 * \todo The shutter event notification should be sent to the framework
 	 * as soon as possible, earlier than request completion time.
 	 */
-	uint64_t sensorTimestamp = static_cast<uint64_t>(request->metadata()
-								 .get(controls::SensorTimestamp)
+	const ControlList &metadata = descriptor->zslMetadata_
+				    ? *descriptor->zslMetadata_
+				    : request->metadata();
+	uint64_t sensorTimestamp = static_cast<uint64_t>(metadata.get(controls::SensorTimestamp)
 								 .value_or(0));
 	notifyShutter(descriptor->frameNumber_, sensorTimestamp);
 
@@ -1222,7 +1505,10 @@ void CameraDevice::requestComplete(Request *request)
 		CameraStream *stream = iter->first;
 		Camera3RequestDescriptor::StreamBuffer *buffer = iter->second;
 
-		FrameBuffer *src = request->findBuffer(stream->stream());
+		/* ZSL captures have their source buffer set already. */
+		const FrameBuffer *src = buffer->srcBuffer;
+		if (!src)
+			src = request->findBuffer(stream->stream());
 		if (!src) {
 			LOG(HAL, Error) << "Failed to find a source stream buffer";
 			setBufferStatus(*buffer, Camera3RequestDescriptor::Status::Error);
@@ -1231,6 +1517,7 @@ void CameraDevice::requestComplete(Request *request)
 		}
 
 		buffer->srcBuffer = src;
+		buffer->srcMapped = stream->mappedBuffer(src);
 
 		++iter;
 		int ret = stream->process(buffer);
@@ -1417,57 +1704,26 @@ void CameraDevice::notifyError(uint32_t frameNumber, camera3_stream_t *stream,
 std::unique_ptr<CameraMetadata>
 CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) const
 {
-	const ControlList &metadata = descriptor.request_->metadata();
+	/*
+	 * Zero-shutter-lag captures are served from a frame captured by an
+	 * earlier request, report the metadata of that frame.
+	 */
+	const ControlList &metadata = descriptor.zslMetadata_
+				    ? *descriptor.zslMetadata_
+				    : descriptor.request_->metadata();
 	const CameraMetadata &settings = descriptor.settings_;
 	camera_metadata_ro_entry_t entry;
 	bool found;
 
-	/*
-	 * \todo Keep this in sync with the actual number of entries.
-	 * Currently: 40 entries, 156 bytes
-	 *
-	 * Reserve more space for the JPEG metadata set by the post-processor.
-	 * Currently:
-	 * ANDROID_JPEG_GPS_COORDINATES (double x 3) = 24 bytes
-	 * ANDROID_JPEG_GPS_PROCESSING_METHOD (byte x 32) = 32 bytes
-	 * ANDROID_JPEG_GPS_TIMESTAMP (int64) = 8 bytes
-	 * ANDROID_JPEG_SIZE (int32_t) = 4 bytes
-	 * ANDROID_JPEG_QUALITY (byte) = 1 byte
-	 * ANDROID_JPEG_ORIENTATION (int32_t) = 4 bytes
-	 * ANDROID_JPEG_THUMBNAIL_QUALITY (byte) = 1 byte
-	 * ANDROID_JPEG_THUMBNAIL_SIZE (int32 x 2) = 8 bytes
-	 * Total bytes for JPEG metadata: 82
-	 */
 	std::unique_ptr<CameraMetadata> resultMetadata =
-		std::make_unique<CameraMetadata>(88, 166);
-	if (!resultMetadata->isValid()) {
+		std::make_unique<CameraMetadata>(resultEntryCapacity_,
+						 resultDataCapacity_);
+	if (!resultTemplate_ || !resultMetadata->isValid() ||
+	    !resultMetadata->append(*resultTemplate_)) {
 		LOG(HAL, Error) << "Failed to allocate result metadata";
 		return nullptr;
 	}
 
-	/*
-	 * \todo The value of the results metadata copied from the settings
-	 * will have to be passed to the libcamera::Camera and extracted
-	 * from libcamera::Request::metadata.
-	 */
-
-	uint8_t value = ANDROID_COLOR_CORRECTION_ABERRATION_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_COLOR_CORRECTION_ABERRATION_MODE,
-				 value);
-
-	value = ANDROID_CONTROL_AE_ANTIBANDING_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_CONTROL_AE_ANTIBANDING_MODE, value);
-
-	int32_t value32 = 0;
-	resultMetadata->addEntry(ANDROID_CONTROL_AE_EXPOSURE_COMPENSATION,
-				 value32);
-
-	value = ANDROID_CONTROL_AE_LOCK_OFF;
-	resultMetadata->addEntry(ANDROID_CONTROL_AE_LOCK, value);
-
-	value = ANDROID_CONTROL_AE_MODE_ON;
-	resultMetadata->addEntry(ANDROID_CONTROL_AE_MODE, value);
-
 	if (settings.getEntry(ANDROID_CONTROL_AE_TARGET_FPS_RANGE, &entry))
 		/*
 		 * \todo Retrieve the AE FPS range from the libcamera metadata.
@@ -1478,89 +1734,17 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 					 entry.data.i32, 2);
 
 	found = settings.getEntry(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, &entry);
-	value = found ? *entry.data.u8 :
-			(uint8_t)ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
+	uint8_t value = found ? *entry.data.u8 :
+				(uint8_t)ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER_IDLE;
 	resultMetadata->addEntry(ANDROID_CONTROL_AE_PRECAPTURE_TRIGGER, value);
 
-	value = ANDROID_CONTROL_AE_STATE_CONVERGED;
-	resultMetadata->addEntry(ANDROID_CONTROL_AE_STATE, value);
-
-	value = ANDROID_CONTROL_AF_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_CONTROL_AF_MODE, value);
-
-	value = ANDROID_CONTROL_AF_STATE_INACTIVE;
-	resultMetadata->addEntry(ANDROID_CONTROL_AF_STATE, value);
-
-	value = ANDROID_CONTROL_AF_TRIGGER_IDLE;
-	resultMetadata->addEntry(ANDROID_CONTROL_AF_TRIGGER, value);
-
-	value = ANDROID_CONTROL_AWB_MODE_AUTO;
-	resultMetadata->addEntry(ANDROID_CONTROL_AWB_MODE, value);
-
-	value = ANDROID_CONTROL_AWB_LOCK_OFF;
-	resultMetadata->addEntry(ANDROID_CONTROL_AWB_LOCK, value);
-
-	value = ANDROID_CONTROL_AWB_STATE_CONVERGED;
-	resultMetadata->addEntry(ANDROID_CONTROL_AWB_STATE, value);
-
-	value = ANDROID_CONTROL_CAPTURE_INTENT_PREVIEW;
-	resultMetadata->addEntry(ANDROID_CONTROL_CAPTURE_INTENT, value);
-
-	value = ANDROID_CONTROL_EFFECT_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_CONTROL_EFFECT_MODE, value);
-
-	value = ANDROID_CONTROL_MODE_AUTO;
-	resultMetadata->addEntry(ANDROID_CONTROL_MODE, value);
-
-	value = ANDROID_CONTROL_SCENE_MODE_DISABLED;
-	resultMetadata->addEntry(ANDROID_CONTROL_SCENE_MODE, value);
-
-	value = ANDROID_CONTROL_VIDEO_STABILIZATION_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_CONTROL_VIDEO_STABILIZATION_MODE, value);
-
-	value = ANDROID_FLASH_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_FLASH_MODE, value);
-
-	value = ANDROID_FLASH_STATE_UNAVAILABLE;
-	resultMetadata->addEntry(ANDROID_FLASH_STATE, value);
+	found = settings.getEntry(ANDROID_CONTROL_ENABLE_ZSL, &entry);
+	value = found ? *entry.data.u8 : (uint8_t)ANDROID_CONTROL_ENABLE_ZSL_FALSE;
+	resultMetadata->addEntry(ANDROID_CONTROL_ENABLE_ZSL, value);
 
 	if (settings.getEntry(ANDROID_LENS_APERTURE, &entry))
 		resultMetadata->addEntry(ANDROID_LENS_APERTURE, entry.data.f, 1);
 
-	float focal_length = 1.0;
-	resultMetadata->addEntry(ANDROID_LENS_FOCAL_LENGTH, focal_length);
-
-	value = ANDROID_LENS_STATE_STATIONARY;
-	resultMetadata->addEntry(ANDROID_LENS_STATE, value);
-
-	value = ANDROID_LENS_OPTICAL_STABILIZATION_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_LENS_OPTICAL_STABILIZATION_MODE,
-				 value);
-
-	value32 = ANDROID_SENSOR_TEST_PATTERN_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_SENSOR_TEST_PATTERN_MODE, value32);
-
-	value = ANDROID_STATISTICS_FACE_DETECT_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_STATISTICS_FACE_DETECT_MODE, value);
-
-	value = ANDROID_STATISTICS_LENS_SHADING_MAP_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_STATISTICS_LENS_SHADING_MAP_MODE,
-				 value);
-
-	value = ANDROID_STATISTICS_HOT_PIXEL_MAP_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_STATISTICS_HOT_PIXEL_MAP_MODE, value);
-
-	value = ANDROID_STATISTICS_SCENE_FLICKER_NONE;
-	resultMetadata->addEntry(ANDROID_STATISTICS_SCENE_FLICKER, value);
-
-	value = ANDROID_NOISE_REDUCTION_MODE_OFF;
-	resultMetadata->addEntry(ANDROID_NOISE_REDUCTION_MODE, value);
-
-	/* 33.3 msec */
-	const int64_t rolling_shutter_skew = 33300000;
-	resultMetadata->addEntry(ANDROID_SENSOR_ROLLING_SHUTTER_SKEW,
-				 rolling_shutter_skew);
-
 	/* Add metadata tags reported by libcamera. */
 	const int64_t timestamp = metadata.get(controls::SensorTimestamp).value_or(0);
 	resultMetadata->addEntry(ANDROID_SENSOR_TIMESTAMP, timestamp);
@@ -1595,6 +1779,14 @@ CameraDevice::getResultMetadata(const Camera3RequestDescriptor &descriptor) cons
 		resultMetadata->addEntry(ANDROID_SENSOR_TEST_PATTERN_MODE,
 					 *testPatternMode);
 
+	const auto &lensState = metadata.get(controls::draft::LensState);
+	if (lensState) {
+		value = *lensState == controls::draft::LensStateMoving
+		      ? ANDROID_LENS_STATE_MOVING
+		      : ANDROID_LENS_STATE_STATIONARY;
+		resultMetadata->updateEntry(ANDROID_LENS_STATE, value);
+	}
+
 	/*
 	 * Return the result metadata pack even is not valid: get() will return
 	 * nullptr.
@@ -20,6 +20,7 @@
 #include <libcamera/base/mutex.h>
 
 #include <libcamera/camera.h>
+#include <libcamera/controls.h>
 #include <libcamera/framebuffer.h>
 #include <libcamera/geometry.h>
 #include <libcamera/pixel_format.h>
@@ -57,6 +58,7 @@ public:
 	const std::string &model() const { return model_; }
 	int facing() const { return facing_; }
 	int orientation() const { return orientation_; }
+	unsigned int zslBuffers() const { return zslBuffers_; }
 	unsigned int maxJpegBufferSize() const;
 
 	void setCallbacks(const camera3_callback_ops_t *callbacks);
@@ -99,6 +101,7 @@ private:
 	void sendCaptureResults() LIBCAMERA_TSA_REQUIRES(descriptorsMutex_);
 	void setBufferStatus(Camera3RequestDescriptor::StreamBuffer &buffer,
 			     Camera3RequestDescriptor::Status status);
+	int createResultTemplate();
 	std::unique_ptr<CameraMetadata> getResultMetadata(
 		const Camera3RequestDescriptor &descriptor) const;
 
@@ -113,6 +116,9 @@ private:
 	CameraCapabilities capabilities_;
 
 	std::map<unsigned int, std::unique_ptr<CameraMetadata>> requestTemplates_;
+	std::unique_ptr<CameraMetadata> resultTemplate_;
+	size_t resultEntryCapacity_;
+	size_t resultDataCapacity_;
 	const camera3_callback_ops_t *callbacks_;
 
 	std::vector<CameraStream> streams_;
@@ -126,6 +132,9 @@ private:
 
 	int facing_;
 	int orientation_;
+	unsigned int zslBuffers_;
 
 	CameraMetadata lastSettings_;
+	libcamera::ControlList lastControls_;
+	bool lastControlsValid_;
 };
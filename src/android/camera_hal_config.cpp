@@ -6,6 +6,7 @@
  */
 #include "camera_hal_config.h"
 
+#include <optional>
 #include <stdlib.h>
 #include <string>
 
@@ -20,6 +21,13 @@ using namespace libcamera;
 
 LOG_DEFINE_CATEGORY(HALConfig)
 
+namespace {
+
+/* Maximum number of frames retained for zero-shutter-lag still captures. */
+constexpr unsigned int kMaxZslBuffers = 8;
+
+} /* namespace */
+
 class CameraHalConfig::Private : public Extensible::Private
 {
 	LIBCAMERA_DECLARE_PUBLIC(CameraHalConfig)
@@ -33,6 +41,7 @@ private:
 	int parseCameraConfigData(const std::string &cameraId, const YamlObject &);
 	int parseLocation(const YamlObject &, CameraConfigData &cameraConfigData);
 	int parseRotation(const YamlObject &, CameraConfigData &cameraConfigData);
+	int parseZslBuffers(const YamlObject &, CameraConfigData &cameraConfigData);
 
 	std::map<std::string, CameraConfigData> *cameras_;
 };
@@ -55,6 +64,7 @@ int CameraHalConfig::Private::parseConfigFile(File &file,
 	 *   "camera0 id":
 	 *     location: value
 	 *     rotation: value
+	 *     zsl_buffers: value (optional)
 	 *     ...
 	 *
 	 *   "camera1 id":
@@ -106,6 +116,10 @@ int CameraHalConfig::Private::parseCameraConfigData(const std::string &cameraId,
 	if (parseRotation(cameraObject, cameraConfigData))
 		return -EINVAL;
 
+	/* Parse property "zsl_buffers" */
+	if (parseZslBuffers(cameraObject, cameraConfigData))
+		return -EINVAL;
+
 	return 0;
 }
 
@@ -145,6 +159,26 @@ int CameraHalConfig::Private::parseRotation(const YamlObject &cameraObject,
 	return 0;
 }
 
+int CameraHalConfig::Private::parseZslBuffers(const YamlObject &cameraObject,
+					      CameraConfigData &cameraConfigData)
+{
+	/* Zero-shutter-lag is disabled when the property is not specified. */
+	if (!cameraObject.contains("zsl_buffers"))
+		return 0;
+
+	std::optional<unsigned int> zslBuffers =
+		cameraObject["zsl_buffers"].get<unsigned int>();
+	if (!zslBuffers || *zslBuffers > kMaxZslBuffers) {
+		LOG(HALConfig, Error)
+			<< "Invalid number of ZSL buffers, expected up to "
+			<< kMaxZslBuffers;
+		return -EINVAL;
+	}
+
+	cameraConfigData.zslBuffers = *zslBuffers;
+	return 0;
+}
+
 CameraHalConfig::CameraHalConfig()
 	: Extensible(std::make_unique<Private>()), exists_(false), valid_(false)
 {
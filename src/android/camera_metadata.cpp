@@ -121,6 +121,28 @@ bool CameraMetadata::resize(size_t count, size_t size)
 	return true;
 }
 
+/*
+ * \brief Append all entries of another metadata container
+ * \param[in] other The metadata container to copy entries from
+ *
+ * The container is resized if it can't hold the entries of \a other.
+ *
+ * \return True if the entries were appended, false otherwise
+ */
+bool CameraMetadata::append(const CameraMetadata &other)
+{
+	auto [entryCount, dataCount] = other.usage();
+	if (!resize(entryCount, dataCount))
+		return false;
+
+	if (append_camera_metadata(metadata_, other.getMetadata())) {
+		valid_ = false;
+		return false;
+	}
+
+	return true;
+}
+
 template<> bool CameraMetadata::entryContains(uint32_t tag, uint8_t value) const
 {
 	camera_metadata_ro_entry_t entry;
@@ -172,6 +172,10 @@ Camera3RequestDescriptor::~Camera3RequestDescriptor() = default;
  * \var Camera3RequestDescriptor::StreamBuffer::srcBuffer
  * \brief Pointer to the source frame buffer used for post-processing
  *
+ * \var Camera3RequestDescriptor::StreamBuffer::srcMapped
+ * \brief Pointer to a persistent read-only mapping of the source frame buffer,
+ * or nullptr if the post-processor has to map the source buffer itself
+ *
  * \var Camera3RequestDescriptor::StreamBuffer::dstBuffer
  * \brief Pointer to the destination frame buffer used for post-processing
  *
@@ -9,6 +9,8 @@
 
 #include <map>
 #include <memory>
+#include <optional>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/class.h>
@@ -20,6 +22,8 @@
 
 #include <hardware/camera3.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 #include "camera_metadata.h"
 #include "hal_framebuffer.h"
 
@@ -50,6 +54,7 @@ public:
 		Status status = Status::Success;
 		libcamera::FrameBuffer *internalBuffer = nullptr;
 		const libcamera::FrameBuffer *srcBuffer = nullptr;
+		const libcamera::MappedFrameBuffer *srcMapped = nullptr;
 		std::unique_ptr<CameraBuffer> dstBuffer;
 		Camera3RequestDescriptor *request;
 
@@ -72,6 +77,18 @@ public:
 
 	std::vector<StreamBuffer> buffers_;
 
+	/*
+	 * Internal buffers added to the request to feed the zero-shutter-lag
+	 * ring of streams not requested by the framework.
+	 */
+	std::vector<std::pair<CameraStream *, libcamera::FrameBuffer *>> zslBuffers_;
+
+	/*
+	 * Metadata of the frame served from the zero-shutter-lag ring, reported
+	 * in the capture result instead of the metadata of the request.
+	 */
+	std::optional<libcamera::ControlList> zslMetadata_;
+
 	CameraMetadata settings_;
 	std::unique_ptr<libcamera::Request> request_;
 	std::unique_ptr<CameraMetadata> resultMetadata_;
@@ -16,6 +16,7 @@
 #include <libcamera/formats.h>
 
 #include "jpeg/post_processor_jpeg.h"
+#include "yuv/post_processor_converter.h"
 #include "yuv/post_processor_yuv.h"
 
 #include "camera_buffer.h"
@@ -29,6 +30,17 @@ using namespace libcamera;
 
 LOG_DECLARE_CATEGORY(HAL)
 
+namespace {
+
+/*
+ * Number of post-processing workers for JPEG streams. Encoding full resolution
+ * still captures takes long enough for back-to-back captures to pile up behind
+ * a single worker.
+ */
+constexpr unsigned int kJpegWorkers = 2;
+
+} /* namespace */
+
 /*
  * \class CameraStream
  * \brief Map a camera3_stream_t to a StreamConfiguration
@@ -68,7 +80,7 @@ CameraStream::~CameraStream()
 	 * Manually delete buffers and then the allocator to make sure buffers
 	 * are released while the allocator is still valid.
 	 */
-	allocatedBuffers_.clear();
+	pool_.reset();
 	allocator_.reset();
 }
 
@@ -92,13 +104,15 @@ int CameraStream::configure()
 		output.size.width = camera3Stream_->width;
 		output.size.height = camera3Stream_->height;
 
+		unsigned int numWorkers;
+
 		switch (outFormat) {
 		case formats::NV12:
-			postProcessor_ = std::make_unique<PostProcessorYuv>();
+			numWorkers = 1;
 			break;
 
 		case formats::MJPEG:
-			postProcessor_ = std::make_unique<PostProcessorJpeg>(cameraDevice_);
+			numWorkers = kJpegWorkers;
 			break;
 
 		default:
@@ -106,30 +120,103 @@ int CameraStream::configure()
 			return -EINVAL;
 		}
 
-		int ret = postProcessor_->configure(configuration(), output);
-		if (ret)
-			return ret;
+		/*
+		 * Post-processors are not reentrant, create one per worker.
+		 * Capture results are sent to the framework in request order
+		 * by the CameraDevice, regardless of the order in which the
+		 * workers complete.
+		 */
+		for (unsigned int i = 0; i < numWorkers; i++) {
+			std::unique_ptr<PostProcessor> postProcessor;
+			int ret;
+
+			if (outFormat == formats::MJPEG) {
+				postProcessor = std::make_unique<PostProcessorJpeg>(cameraDevice_);
+				ret = postProcessor->configure(configuration(), output);
+			} else {
+				/*
+				 * Scale YUV streams with a memory-to-memory
+				 * converter when available, and fall back to
+				 * software scaling otherwise.
+				 */
+				postProcessor = std::make_unique<PostProcessorConverter>();
+				ret = postProcessor->configure(configuration(), output);
+				if (ret) {
+					postProcessor = std::make_unique<PostProcessorYuv>();
+					ret = postProcessor->configure(configuration(), output);
+				}
+			}
+
+			if (ret)
+				return ret;
+
+			postProcessor->processComplete.connect(
+				this, [&](Camera3RequestDescriptor::StreamBuffer *streamBuffer,
+					  PostProcessor::Status status) {
+					Camera3RequestDescriptor::Status bufferStatus;
+
+					if (status == PostProcessor::Status::Success)
+						bufferStatus = Camera3RequestDescriptor::Status::Success;
+					else
+						bufferStatus = Camera3RequestDescriptor::Status::Error;
+
+					cameraDevice_->streamProcessingComplete(streamBuffer,
+										bufferStatus);
+				});
+
+			workers_.push_back(std::make_unique<PostProcessorWorker>(postProcessor.get()));
+			postProcessors_.push_back(std::move(postProcessor));
+		}
 
-		worker_ = std::make_unique<PostProcessorWorker>(postProcessor_.get());
-		postProcessor_->processComplete.connect(
-			this, [&](Camera3RequestDescriptor::StreamBuffer *streamBuffer,
-				  PostProcessor::Status status) {
-				Camera3RequestDescriptor::Status bufferStatus;
+		for (std::unique_ptr<PostProcessorWorker> &worker : workers_)
+			worker->start();
+	}
 
-				if (status == PostProcessor::Status::Success)
-					bufferStatus = Camera3RequestDescriptor::Status::Success;
-				else
-					bufferStatus = Camera3RequestDescriptor::Status::Error;
+	allocator_ = std::make_unique<PlatformFrameBufferAllocator>(cameraDevice_);
+	pool_ = std::make_unique<BufferPool>();
 
-				cameraDevice_->streamProcessingComplete(streamBuffer,
-									bufferStatus);
-			});
+	/*
+	 * Internal streams use an internal buffer for every request, allocate
+	 * the pool upfront. Other streams only need internal buffers when
+	 * their source stream isn't requested, allocate them on demand.
+	 *
+	 * When zero-shutter-lag is enabled for JPEG streams, the most recent
+	 * frames are retained in a ring to serve still captures without waiting
+	 * for a new frame. Reserve the ring buffers on top of the pool.
+	 */
+	unsigned int bufferCount = configuration().bufferCount;
+
+	if (type_ == Type::Internal &&
+	    camera3Stream_->format == HAL_PIXEL_FORMAT_BLOB &&
+	    cameraDevice_->zslBuffers()) {
+		unsigned int capacity = cameraDevice_->zslBuffers();
+
+		/* The ring buffers come from the pool, keep them within bounds. */
+		if (bufferCount + capacity > BufferPool::kMaxBuffers) {
+			capacity = bufferCount < BufferPool::kMaxBuffers
+				 ? BufferPool::kMaxBuffers - bufferCount : 0;
+			LOG(HAL, Warning)
+				<< "Internal buffer pool too small for "
+				<< cameraDevice_->zslBuffers()
+				<< " zero-shutter-lag buffers, using " << capacity;
+		}
 
-		worker_->start();
+		if (capacity) {
+			zsl_ = std::make_unique<ZslRing>();
+			zsl_->capacity = capacity;
+			bufferCount += capacity;
+		}
 	}
 
-	allocator_ = std::make_unique<PlatformFrameBufferAllocator>(cameraDevice_);
-	mutex_ = std::make_unique<Mutex>();
+	if (type_ == Type::Internal) {
+		for (unsigned int i = 0; i < bufferCount; i++) {
+			FrameBuffer *buffer = allocateBuffer();
+			if (!buffer)
+				return -ENOMEM;
+
+			putBuffer(buffer);
+		}
+	}
 
 	camera3Stream_->max_buffers = configuration().bufferCount;
 
@@ -191,57 +278,197 @@ int CameraStream::process(Camera3RequestDescriptor::StreamBuffer *streamBuffer)
 		return -EINVAL;
 	}
 
-	worker_->queueRequest(streamBuffer);
+	/* Dispatch the request to the least loaded worker. */
+	PostProcessorWorker *worker = workers_.front().get();
+	unsigned int load = worker->load();
+
+	for (const std::unique_ptr<PostProcessorWorker> &w : workers_) {
+		unsigned int l = w->load();
+		if (l < load) {
+			worker = w.get();
+			load = l;
+		}
+	}
+
+	worker->queueRequest(streamBuffer);
 
 	return 0;
 }
 
 void CameraStream::flush()
 {
-	if (!postProcessor_)
+	for (std::unique_ptr<PostProcessorWorker> &worker : workers_)
+		worker->flush();
+}
+
+/*
+ * The internal buffers are stored in a fixed-size pool, with a bitmask of the
+ * free entries. getBuffer() and putBuffer() update the bitmask atomically and
+ * never block, the pool mutex only serialises the allocation of new buffers
+ * when no free buffer is available. Buffers are mapped when allocated, the
+ * mapping is kept for the lifetime of the buffer and retrieved with
+ * mappedBuffer() to avoid remapping the buffer for every post-processing
+ * operation.
+ */
+FrameBuffer *CameraStream::getBuffer()
+{
+	if (!pool_)
+		return nullptr;
+
+	uint64_t free = pool_->free.load(std::memory_order_acquire);
+	while (free) {
+		unsigned int index = __builtin_ctzll(free);
+		if (pool_->free.compare_exchange_weak(free, free & ~(1ULL << index),
+						      std::memory_order_acquire))
+			return pool_->buffers[index].buffer.get();
+	}
+
+	return allocateBuffer();
+}
+
+void CameraStream::putBuffer(FrameBuffer *buffer)
+{
+	if (!pool_)
+		return;
+
+	int index = findBuffer(buffer);
+	if (index < 0) {
+		LOG(HAL, Error) << "Unknown internal buffer";
 		return;
+	}
 
-	worker_->flush();
+	pool_->free.fetch_or(1ULL << index, std::memory_order_release);
 }
 
-FrameBuffer *CameraStream::getBuffer()
+const MappedFrameBuffer *CameraStream::mappedBuffer(const FrameBuffer *buffer) const
 {
-	if (!allocator_)
+	if (!pool_)
+		return nullptr;
+
+	int index = findBuffer(buffer);
+	if (index < 0)
 		return nullptr;
 
-	MutexLocker locker(*mutex_);
+	return pool_->buffers[index].mapped.get();
+}
 
-	if (buffers_.empty()) {
-		/*
-		 * Use HAL_PIXEL_FORMAT_YCBCR_420_888 unconditionally.
-		 *
-		 * YCBCR_420 is the source format for both the JPEG and the YUV
-		 * post-processors.
-		 *
-		 * \todo Store a reference to the format of the source stream
-		 * instead of hardcoding.
-		 */
-		auto frameBuffer = allocator_->allocate(HAL_PIXEL_FORMAT_YCBCR_420_888,
-							configuration().size,
-							camera3Stream_->usage);
-		allocatedBuffers_.push_back(std::move(frameBuffer));
-		buffers_.emplace_back(allocatedBuffers_.back().get());
+/*
+ * The zero-shutter-lag ring holds internal buffers of completed captures,
+ * along with the metadata of the request that captured them. When the ring is
+ * full the oldest buffer is returned to the pool.
+ */
+void CameraStream::pushZslBuffer(FrameBuffer *buffer, const ControlList &metadata)
+{
+	FrameBuffer *evicted = nullptr;
+
+	{
+		MutexLocker locker(zsl_->mutex);
+
+		zsl_->frames.push_back({ buffer, metadata });
+		if (zsl_->frames.size() > zsl_->capacity) {
+			evicted = zsl_->frames.front().buffer;
+			zsl_->frames.pop_front();
+		}
 	}
 
-	FrameBuffer *buffer = buffers_.back();
-	buffers_.pop_back();
+	if (evicted)
+		putBuffer(evicted);
+}
+
+/*
+ * Take the most recent frame out of the zero-shutter-lag ring, and return the
+ * metadata it has been captured with in \a metadata. The caller owns the
+ * buffer and shall return it with putBuffer().
+ */
+FrameBuffer *CameraStream::takeZslBuffer(ControlList *metadata)
+{
+	if (!zsl_)
+		return nullptr;
+
+	MutexLocker locker(zsl_->mutex);
+
+	if (zsl_->frames.empty())
+		return nullptr;
+
+	ZslRing::Frame &frame = zsl_->frames.back();
+	FrameBuffer *buffer = frame.buffer;
+	*metadata = std::move(frame.metadata);
+	zsl_->frames.pop_back();
 
 	return buffer;
 }
 
-void CameraStream::putBuffer(FrameBuffer *buffer)
+void CameraStream::clearZslBuffers()
 {
-	if (!allocator_)
+	if (!zsl_)
 		return;
 
-	MutexLocker locker(*mutex_);
+	std::deque<ZslRing::Frame> frames;
+
+	{
+		MutexLocker locker(zsl_->mutex);
+		frames.swap(zsl_->frames);
+	}
+
+	for (const ZslRing::Frame &frame : frames)
+		putBuffer(frame.buffer);
+}
+
+int CameraStream::findBuffer(const FrameBuffer *buffer) const
+{
+	unsigned int count = pool_->count.load(std::memory_order_acquire);
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (pool_->buffers[i].buffer.get() == buffer)
+			return i;
+	}
+
+	return -1;
+}
+
+FrameBuffer *CameraStream::allocateBuffer()
+{
+	MutexLocker locker(pool_->mutex);
+
+	unsigned int index = pool_->count.load(std::memory_order_relaxed);
+	if (index == BufferPool::kMaxBuffers) {
+		LOG(HAL, Error) << "Internal buffer pool exhausted";
+		return nullptr;
+	}
+
+	/*
+	 * Use HAL_PIXEL_FORMAT_YCBCR_420_888 unconditionally.
+	 *
+	 * YCBCR_420 is the source format for both the JPEG and the YUV
+	 * post-processors.
+	 *
+	 * \todo Store a reference to the format of the source stream
+	 * instead of hardcoding.
+	 */
+	std::unique_ptr<FrameBuffer> frameBuffer =
+		allocator_->allocate(HAL_PIXEL_FORMAT_YCBCR_420_888,
+				     configuration().size, camera3Stream_->usage);
+	if (!frameBuffer)
+		return nullptr;
 
-	buffers_.push_back(buffer);
+	/*
+	 * A mapping failure isn't fatal, the post-processors map the buffer
+	 * themselves when no mapping is available.
+	 */
+	auto mapped = std::make_unique<MappedFrameBuffer>(frameBuffer.get(),
+							  MappedFrameBuffer::MapFlag::Read);
+	if (!mapped->isValid()) {
+		LOG(HAL, Warning) << "Failed to map internal buffer";
+		mapped.reset();
+	}
+
+	BufferPool::Buffer &entry = pool_->buffers[index];
+	entry.buffer = std::move(frameBuffer);
+	entry.mapped = std::move(mapped);
+
+	pool_->count.store(index + 1, std::memory_order_release);
+
+	return entry.buffer.get();
 }
 
 /**
@@ -255,6 +482,9 @@ void CameraStream::putBuffer(FrameBuffer *buffer)
  * requests is maintained by the PostProcessorWorker and it will run the
  * post-processing on an internal thread as soon as any request is available on
  * its queue.
+ *
+ * A CameraStream may use multiple workers, each with its own PostProcessor
+ * instance, to process consecutive requests concurrently.
  */
 CameraStream::PostProcessorWorker::PostProcessorWorker(PostProcessor *postProcessor)
 	: postProcessor_(postProcessor)
@@ -294,6 +524,12 @@ void CameraStream::PostProcessorWorker::queueRequest(Camera3RequestDescriptor::S
 	cv_.notify_one();
 }
 
+unsigned int CameraStream::PostProcessorWorker::load()
+{
+	MutexLocker lock(mutex_);
+	return requests_.size() + busy_;
+}
+
 void CameraStream::PostProcessorWorker::run()
 {
 	MutexLocker locker(mutex_);
@@ -308,11 +544,13 @@ void CameraStream::PostProcessorWorker::run()
 
 		Camera3RequestDescriptor::StreamBuffer *streamBuffer = requests_.front();
 		requests_.pop();
+		busy_ = true;
 		locker.unlock();
 
 		postProcessor_->process(streamBuffer);
 
 		locker.lock();
+		busy_ = false;
 	}
 
 	if (state_ == State::Flushing) {
@@ -329,6 +567,9 @@ void CameraStream::PostProcessorWorker::run()
 		locker.lock();
 		state_ = State::Stopped;
 	}
+
+	locker.unlock();
+	postProcessor_->stop();
 }
 
 void CameraStream::PostProcessorWorker::flush()
@@ -7,8 +7,12 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <queue>
+#include <stdint.h>
 #include <vector>
 
 #include <hardware/camera3.h>
@@ -21,6 +25,8 @@
 #include <libcamera/geometry.h>
 #include <libcamera/pixel_format.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 #include "camera_request.h"
 #include "post_processor.h"
 
@@ -130,6 +136,13 @@ public:
 	int process(Camera3RequestDescriptor::StreamBuffer *streamBuffer);
 	libcamera::FrameBuffer *getBuffer();
 	void putBuffer(libcamera::FrameBuffer *buffer);
+	bool zslEnabled() const { return zsl_ != nullptr; }
+	void pushZslBuffer(libcamera::FrameBuffer *buffer,
+			   const libcamera::ControlList &metadata);
+	libcamera::FrameBuffer *takeZslBuffer(libcamera::ControlList *metadata);
+	void clearZslBuffers();
+	const libcamera::MappedFrameBuffer *
+	mappedBuffer(const libcamera::FrameBuffer *buffer) const;
 	void flush();
 
 private:
@@ -148,6 +161,7 @@ private:
 		void start();
 		void queueRequest(Camera3RequestDescriptor::StreamBuffer *request);
 		void flush();
+		unsigned int load();
 
 	protected:
 		void run() override;
@@ -162,6 +176,7 @@ private:
 			LIBCAMERA_TSA_GUARDED_BY(mutex_);
 
 		State state_ LIBCAMERA_TSA_GUARDED_BY(mutex_) = State::Stopped;
+		bool busy_ LIBCAMERA_TSA_GUARDED_BY(mutex_) = false;
 	};
 
 	int waitFence(int fence);
@@ -173,15 +188,47 @@ private:
 	CameraStream *const sourceStream_;
 	const unsigned int index_;
 
+	struct BufferPool {
+		static constexpr unsigned int kMaxBuffers = 64;
+
+		struct Buffer {
+			std::unique_ptr<libcamera::FrameBuffer> buffer;
+			std::unique_ptr<libcamera::MappedFrameBuffer> mapped;
+		};
+
+		std::array<Buffer, kMaxBuffers> buffers;
+		/* Number of populated entries in buffers. */
+		std::atomic<unsigned int> count = 0;
+		/* Bitmask of the free entries in buffers. */
+		std::atomic<uint64_t> free = 0;
+		/* Serialises buffer allocations. */
+		libcamera::Mutex mutex;
+	};
+
+	struct ZslRing {
+		struct Frame {
+			libcamera::FrameBuffer *buffer;
+			/* Metadata of the request that captured the frame. */
+			libcamera::ControlList metadata;
+		};
+
+		libcamera::Mutex mutex;
+		/* Recently captured frames, from oldest to newest. */
+		std::deque<Frame> frames LIBCAMERA_TSA_GUARDED_BY(mutex);
+		unsigned int capacity;
+	};
+
+	int findBuffer(const libcamera::FrameBuffer *buffer) const;
+	libcamera::FrameBuffer *allocateBuffer();
+
 	std::unique_ptr<PlatformFrameBufferAllocator> allocator_;
-	std::vector<std::unique_ptr<libcamera::FrameBuffer>> allocatedBuffers_;
-	std::vector<libcamera::FrameBuffer *> buffers_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
 	/*
 	 * The class has to be MoveConstructible as instances are stored in
 	 * an std::vector in CameraDevice.
 	 */
-	std::unique_ptr<libcamera::Mutex> mutex_;
-	std::unique_ptr<PostProcessor> postProcessor_;
+	std::unique_ptr<BufferPool> pool_;
+	std::unique_ptr<ZslRing> zsl_;
+	std::vector<std::unique_ptr<PostProcessor>> postProcessors_;
 
-	std::unique_ptr<PostProcessorWorker> worker_;
+	std::vector<std::unique_ptr<PostProcessorWorker>> workers_;
 };
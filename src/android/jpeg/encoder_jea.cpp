@@ -11,9 +11,15 @@
 
 #include <cros-camera/camera_mojo_channel_manager_token.h>
 
+#include <libcamera/base/log.h>
+
 #include "../cros_mojo_token.h"
 #include "../hal_framebuffer.h"
 
+using namespace libcamera;
+
+LOG_DECLARE_CATEGORY(JPEG)
+
 EncoderJea::EncoderJea() = default;
 
 EncoderJea::~EncoderJea() = default;
@@ -43,7 +49,18 @@ int EncoderJea::encode(Camera3RequestDescriptor::StreamBuffer *buffer,
 	uint32_t outDataSize = 0;
 	const HALFrameBuffer *fb =
 		dynamic_cast<const HALFrameBuffer *>(buffer->srcBuffer);
+	if (!fb) {
+		LOG(JPEG, Error) << "Source buffer has no native handle";
+		return -EINVAL;
+	}
 
+	/*
+	 * The JEA client API is synchronous. The call blocks the calling
+	 * post-processing worker only: each worker owns its own
+	 * PostProcessorJpeg and thus its own JpegCompressor instance, so
+	 * back-to-back still captures are encoded concurrently by the
+	 * accelerator while the HAL keeps capturing.
+	 */
 	if (!jpegCompressor_->CompressImageFromHandle(fb->handle(),
 						      *buffer->camera3Buffer,
 						      size_.width, size_.height,
@@ -7,6 +7,7 @@
 
 #include "encoder_libjpeg.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iomanip>
 #include <iostream>
@@ -102,6 +103,29 @@ int EncoderLibJpeg::configure(const StreamConfiguration &cfg)
 	nv_ = pixelFormatInfo_->numPlanes() == 2;
 	nvSwap_ = info.nvSwap;
 
+	/*
+	 * NV12 and NV21 images whose width is a multiple of the MCU width are
+	 * encoded from raw data, passing the luma rows directly to libjpeg and
+	 * only deinterleaving the chroma samples. The default YCbCr sampling
+	 * factors set by jpeg_set_defaults() already match 4:2:0 subsampling.
+	 */
+	raw_ = false;
+	if (nv_) {
+		unsigned int horzSubSample = 2 * cfg.size.width /
+					     pixelFormatInfo_->stride(cfg.size.width, 1);
+		unsigned int vertSubSample = pixelFormatInfo_->planes[1].verticalSubSampling;
+
+		raw_ = horzSubSample == 2 && vertSubSample == 2 &&
+		       cfg.size.width % (2 * DCTSIZE) == 0;
+	}
+
+	compress_.raw_data_in = raw_;
+
+	if (raw_)
+		chromaRows_.resize(cfg.size.width / 2 * DCTSIZE * 2);
+	else
+		chromaRows_.clear();
+
 	return 0;
 }
 
@@ -180,10 +204,72 @@ void EncoderLibJpeg::compressNV(const std::vector<Span<uint8_t>> &planes)
 	}
 }
 
+/*
+ * Compress the incoming buffer from NV12 or NV21 through the libjpeg raw data
+ * interface. Each call to jpeg_write_raw_data() consumes one row of MCUs,
+ * 16 luma rows that are read directly from the source plane and 8 rows of each
+ * chroma component deinterleaved in chromaRows_. Rows past the bottom of the
+ * image replicate the last row.
+ */
+void EncoderLibJpeg::compressNVRaw(const std::vector<Span<uint8_t>> &planes)
+{
+	const unsigned int width = compress_.image_width;
+	const unsigned int height = compress_.image_height;
+	const unsigned int cWidth = width / 2;
+	const unsigned int cHeight = (height + 1) / 2;
+
+	unsigned int yStride = pixelFormatInfo_->stride(width, 0);
+	unsigned int cStride = pixelFormatInfo_->stride(width, 1);
+
+	unsigned int cbPos = nvSwap_ ? 1 : 0;
+	unsigned int crPos = nvSwap_ ? 0 : 1;
+
+	const unsigned char *srcY = planes[0].data();
+	const unsigned char *srcC = planes[1].data();
+
+	JSAMPROW yRows[2 * DCTSIZE];
+	JSAMPROW cbRows[DCTSIZE];
+	JSAMPROW crRows[DCTSIZE];
+	JSAMPARRAY data[3] = { yRows, cbRows, crRows };
+
+	for (unsigned int i = 0; i < DCTSIZE; i++) {
+		cbRows[i] = &chromaRows_[i * cWidth];
+		crRows[i] = &chromaRows_[(DCTSIZE + i) * cWidth];
+	}
+
+	while (compress_.next_scanline < height) {
+		unsigned int y0 = compress_.next_scanline;
+
+		for (unsigned int i = 0; i < 2 * DCTSIZE; i++) {
+			unsigned int y = std::min(y0 + i, height - 1);
+			yRows[i] = const_cast<JSAMPROW>(srcY + y * yStride);
+		}
+
+		for (unsigned int i = 0; i < DCTSIZE; i++) {
+			unsigned int y = std::min(y0 / 2 + i, cHeight - 1);
+			const unsigned char *src = srcC + y * cStride;
+			unsigned char *cb = cbRows[i];
+			unsigned char *cr = crRows[i];
+
+			for (unsigned int x = 0; x < cWidth; x++) {
+				cb[x] = src[2 * x + cbPos];
+				cr[x] = src[2 * x + crPos];
+			}
+		}
+
+		jpeg_write_raw_data(&compress_, data, 2 * DCTSIZE);
+	}
+}
+
 int EncoderLibJpeg::encode(Camera3RequestDescriptor::StreamBuffer *buffer,
 			   libcamera::Span<const uint8_t> exifData,
 			   unsigned int quality)
 {
+	/* Use the persistent mapping of the source buffer when available. */
+	if (buffer->srcMapped)
+		return encode(buffer->srcMapped->planes(), buffer->dstBuffer->plane(0),
+			      exifData, quality);
+
 	MappedFrameBuffer frame(buffer->srcBuffer,
 				MappedFrameBuffer::MapFlag::Read);
 	if (!frame.isValid()) {
@@ -228,7 +314,9 @@ int EncoderLibJpeg::encode(const std::vector<Span<uint8_t>> &src,
 
 	ASSERT(src.size() == pixelFormatInfo_->numPlanes());
 
-	if (nv_)
+	if (raw_)
+		compressNVRaw(src);
+	else if (nv_)
 		compressNV(src);
 	else
 		compressRGB(src);
@@ -33,6 +33,7 @@ public:
 private:
 	void compressRGB(const std::vector<libcamera::Span<uint8_t>> &planes);
 	void compressNV(const std::vector<libcamera::Span<uint8_t>> &planes);
+	void compressNVRaw(const std::vector<libcamera::Span<uint8_t>> &planes);
 
 	struct jpeg_compress_struct compress_;
 	struct jpeg_error_mgr jerr_;
@@ -41,4 +42,7 @@ private:
 
 	bool nv_;
 	bool nvSwap_;
+	bool raw_;
+
+	std::vector<uint8_t> chromaRows_;
 };
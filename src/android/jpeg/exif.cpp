@@ -41,6 +41,11 @@ enum class _ExifTag {
  * Calls to generate() must check the return code to determine if any error
  * occurred during the construction of the Exif data, and if successful the
  * data can be obtained using the data() function.
+ *
+ * An Exif instance can be reused for multiple images. Properties keep their
+ * value until they are set again, and optional properties can be removed with
+ * the clear*() functions. Entries whose size doesn't change are updated in
+ * place.
  */
 Exif::Exif()
 	: valid_(false), data_(nullptr), order_(EXIF_BYTE_ORDER_INTEL),
@@ -125,9 +130,21 @@ ExifEntry *Exif::createEntry(ExifIfd ifd, ExifTag tag, ExifFormat format,
 {
 	ExifContent *content = data_->ifd[ifd];
 
-	/* Replace any existing entry with the same tag. */
+	/*
+	 * Reuse any existing entry with the same tag and layout, or replace
+	 * it otherwise.
+	 */
 	ExifEntry *existing = exif_content_get_entry(content, tag);
-	exif_content_remove_entry(content, existing);
+	if (existing) {
+		if (existing->format == format &&
+		    existing->components == components &&
+		    existing->size == size) {
+			exif_entry_ref(existing);
+			return existing;
+		}
+
+		exif_content_remove_entry(content, existing);
+	}
 
 	ExifEntry *entry = exif_entry_new_mem(mem_);
 	if (!entry) {
@@ -155,6 +172,14 @@ ExifEntry *Exif::createEntry(ExifIfd ifd, ExifTag tag, ExifFormat format,
 	return entry;
 }
 
+void Exif::removeEntry(ExifIfd ifd, ExifTag tag)
+{
+	ExifContent *content = data_->ifd[ifd];
+	ExifEntry *entry = exif_content_get_entry(content, tag);
+	if (entry)
+		exif_content_remove_entry(content, entry);
+}
+
 void Exif::setByte(ExifIfd ifd, ExifTag tag, uint8_t item)
 {
 	ExifEntry *entry = createEntry(ifd, tag, EXIF_FORMAT_BYTE, 1, 1);
@@ -408,6 +433,14 @@ void Exif::setGPSMethod(const std::string &method)
 		  EXIF_FORMAT_UNDEFINED, method, NoEncoding);
 }
 
+void Exif::clearGPS()
+{
+	ExifContent *content = data_->ifd[EXIF_IFD_GPS];
+
+	while (content->count)
+		exif_content_remove_entry(content, content->entries[0]);
+}
+
 void Exif::setOrientation(int orientation)
 {
 	int value;
@@ -441,6 +474,15 @@ void Exif::setThumbnail(std::vector<unsigned char> &&thumbnail,
 	setShort(EXIF_IFD_0, EXIF_TAG_COMPRESSION, compression);
 }
 
+void Exif::clearThumbnail()
+{
+	data_->data = nullptr;
+	data_->size = 0;
+	thumbnailData_.clear();
+
+	removeEntry(EXIF_IFD_0, EXIF_TAG_COMPRESSION);
+}
+
 void Exif::setFocalLength(float length)
 {
 	ExifRational rational = { static_cast<ExifLong>(length * 1000), 1000 };
@@ -459,6 +501,11 @@ void Exif::setAperture(float size)
 	setRational(EXIF_IFD_EXIF, EXIF_TAG_FNUMBER, rational);
 }
 
+void Exif::clearAperture()
+{
+	removeEntry(EXIF_IFD_EXIF, EXIF_TAG_FNUMBER);
+}
+
 void Exif::setISO(uint16_t iso)
 {
 	setShort(EXIF_IFD_EXIF, EXIF_TAG_ISO_SPEED_RATINGS, iso);
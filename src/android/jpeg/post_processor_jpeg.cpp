@@ -17,8 +17,6 @@
 #else /* !defined(OS_CHROMEOS) */
 #include "encoder_libjpeg.h"
 #endif
-#include "exif.h"
-
 #include <libcamera/base/log.h>
 
 #include <libcamera/formats.h>
@@ -50,6 +48,8 @@ int PostProcessorJpeg::configure(const StreamConfiguration &inCfg,
 
 	thumbnailer_.configure(inCfg.size, inCfg.pixelFormat);
 
+	resetExif();
+
 #if defined(OS_CHROMEOS)
 	encoder_ = std::make_unique<EncoderJea>();
 #else /* !defined(OS_CHROMEOS) */
@@ -59,27 +59,50 @@ int PostProcessorJpeg::configure(const StreamConfiguration &inCfg,
 	return encoder_->configure(inCfg);
 }
 
-void PostProcessorJpeg::generateThumbnail(const FrameBuffer &source,
+/*
+ * The EXIF data is reused across captures, only the tags that depend on the
+ * capture are updated. Create it with the tags that don't change for the
+ * lifetime of the stream.
+ */
+void PostProcessorJpeg::resetExif()
+{
+	exif_ = std::make_unique<Exif>();
+	exif_->setMake(cameraDevice_->maker());
+	exif_->setModel(cameraDevice_->model());
+	exif_->setSize(streamSize_);
+	exif_->setFlash(Exif::Flash::FlashNotPresent);
+	exif_->setWhiteBalance(Exif::WhiteBalance::Auto);
+	exif_->setFocalLength(1.0);
+}
+
+void PostProcessorJpeg::generateThumbnail(const Camera3RequestDescriptor::StreamBuffer *streamBuffer,
 					  const Size &targetSize,
 					  unsigned int quality,
 					  std::vector<unsigned char> *thumbnail)
 {
-	/* Stores the raw scaled-down thumbnail bytes. */
-	std::vector<unsigned char> rawThumbnail;
-
-	thumbnailer_.createThumbnail(source, targetSize, &rawThumbnail);
+	/*
+	 * The raw scaled-down thumbnail bytes are stored in rawThumbnail_,
+	 * reused across captures to avoid reallocating it. Use the persistent
+	 * mapping of the source buffer when available.
+	 */
+	if (streamBuffer->srcMapped)
+		thumbnailer_.createThumbnail(streamBuffer->srcMapped->planes(),
+					     targetSize, &rawThumbnail_);
+	else
+		thumbnailer_.createThumbnail(*streamBuffer->srcBuffer,
+					     targetSize, &rawThumbnail_);
 
 	StreamConfiguration thCfg;
 	thCfg.size = targetSize;
 	thCfg.pixelFormat = thumbnailer_.pixelFormat();
 	int ret = thumbnailEncoder_.configure(thCfg);
 
-	if (!rawThumbnail.empty() && !ret) {
+	if (!rawThumbnail_.empty() && !ret) {
 		/*
 		 * \todo Avoid value-initialization of all elements of the
 		 * vector.
 		 */
-		thumbnail->resize(rawThumbnail.size());
+		thumbnail->resize(rawThumbnail_.size());
 
 		/*
 		 * Split planes manually as the encoder expects a vector of
@@ -93,8 +116,8 @@ void PostProcessorJpeg::generateThumbnail(const FrameBuffer &source,
 		const PixelFormatInfo &formatNV12 = PixelFormatInfo::info(formats::NV12);
 		size_t yPlaneSize = formatNV12.planeSize(targetSize, 0);
 		size_t uvPlaneSize = formatNV12.planeSize(targetSize, 1);
-		thumbnailPlanes.push_back({ rawThumbnail.data(), yPlaneSize });
-		thumbnailPlanes.push_back({ rawThumbnail.data() + yPlaneSize, uvPlaneSize });
+		thumbnailPlanes.push_back({ rawThumbnail_.data(), yPlaneSize });
+		thumbnailPlanes.push_back({ rawThumbnail_.data() + yPlaneSize, uvPlaneSize });
 
 		int jpeg_size = thumbnailEncoder_.encode(thumbnailPlanes,
 							 *thumbnail, {}, quality);
@@ -110,7 +133,6 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 {
 	ASSERT(encoder_);
 
-	const FrameBuffer &source = *streamBuffer->srcBuffer;
 	CameraBuffer *destination = streamBuffer->dstBuffer.get();
 
 	ASSERT(destination->numPlanes() == 1);
@@ -120,10 +142,8 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 	camera_metadata_ro_entry_t entry;
 	int ret;
 
-	/* Set EXIF metadata for various tags. */
-	Exif exif;
-	exif.setMake(cameraDevice_->maker());
-	exif.setModel(cameraDevice_->model());
+	/* Update the EXIF tags that depend on the capture. */
+	Exif &exif = *exif_;
 
 	ret = requestMetadata.getEntry(ANDROID_JPEG_ORIENTATION, &entry);
 
@@ -131,7 +151,6 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 	resultMetadata->addEntry(ANDROID_JPEG_ORIENTATION, jpegOrientation);
 	exif.setOrientation(jpegOrientation);
 
-	exif.setSize(streamSize_);
 	/*
 	 * We set the frame's EXIF timestamp as the time of encode.
 	 * Since the precision we need for EXIF timestamp is only one
@@ -144,14 +163,14 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 	ret = requestMetadata.getEntry(ANDROID_LENS_APERTURE, &entry);
 	if (ret)
 		exif.setAperture(*entry.data.f);
+	else
+		exif.clearAperture();
 
 	ret = resultMetadata->getEntry(ANDROID_SENSOR_SENSITIVITY, &entry);
 	exif.setISO(ret ? *entry.data.i32 : 100);
 
-	exif.setFlash(Exif::Flash::FlashNotPresent);
-	exif.setWhiteBalance(Exif::WhiteBalance::Auto);
-
-	exif.setFocalLength(1.0);
+	exif.clearGPS();
+	exif.clearThumbnail();
 
 	ret = requestMetadata.getEntry(ANDROID_JPEG_GPS_TIMESTAMP, &entry);
 	if (ret) {
@@ -172,7 +191,7 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 
 		if (thumbnailSize != Size(0, 0)) {
 			std::vector<unsigned char> thumbnail;
-			generateThumbnail(source, thumbnailSize, quality, &thumbnail);
+			generateThumbnail(streamBuffer, thumbnailSize, quality, &thumbnail);
 			if (!thumbnail.empty())
 				exif.setThumbnail(std::move(thumbnail), Exif::Compression::JPEG);
 		}
@@ -195,7 +214,8 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 					 entry.data.u8, entry.count);
 	}
 
-	if (exif.generate() != 0)
+	bool exifValid = exif.generate() == 0;
+	if (!exifValid)
 		LOG(JPEG, Error) << "Failed to generate valid EXIF data";
 
 	ret = requestMetadata.getEntry(ANDROID_JPEG_QUALITY, &entry);
@@ -203,6 +223,11 @@ void PostProcessorJpeg::process(Camera3RequestDescriptor::StreamBuffer *streamBu
 	resultMetadata->addEntry(ANDROID_JPEG_QUALITY, quality);
 
 	int jpeg_size = encoder_->encode(streamBuffer, exif.data(), quality);
+
+	/* Recreate the EXIF data, it can't recover from errors. */
+	if (!exifValid)
+		resetExif();
+
 	if (jpeg_size < 0) {
 		LOG(JPEG, Error) << "Failed to encode stream image";
 		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
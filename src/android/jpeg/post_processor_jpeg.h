@@ -9,6 +9,7 @@
 
 #include "../post_processor.h"
 #include "encoder_libjpeg.h"
+#include "exif.h"
 #include "thumbnailer.h"
 
 #include <libcamera/geometry.h>
@@ -25,7 +26,8 @@ public:
 	void process(Camera3RequestDescriptor::StreamBuffer *streamBuffer) override;
 
 private:
-	void generateThumbnail(const libcamera::FrameBuffer &source,
+	void resetExif();
+	void generateThumbnail(const Camera3RequestDescriptor::StreamBuffer *streamBuffer,
 			       const libcamera::Size &targetSize,
 			       unsigned int quality,
 			       std::vector<unsigned char> *thumbnail);
@@ -35,4 +37,6 @@ private:
 	libcamera::Size streamSize_;
 	EncoderLibJpeg thumbnailEncoder_;
 	Thumbnailer thumbnailer_;
+	std::vector<unsigned char> rawThumbnail_;
+	std::unique_ptr<Exif> exif_;
 };
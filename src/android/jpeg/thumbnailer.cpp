@@ -7,6 +7,8 @@
 
 #include "thumbnailer.h"
 
+#include <algorithm>
+
 #include <libcamera/base/log.h>
 
 #include <libcamera/formats.h>
@@ -17,6 +19,13 @@ using namespace libcamera;
 
 LOG_DEFINE_CATEGORY(Thumbnailer)
 
+namespace {
+
+/* Maximum number of source rows and columns averaged per destination sample. */
+constexpr unsigned int kMaxTaps = 4;
+
+} /* namespace */
+
 Thumbnailer::Thumbnailer()
 	: valid_(false)
 {
@@ -46,11 +55,20 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 		LOG(Thumbnailer, Error)
 			<< "Failed to map FrameBuffer : "
 			<< strerror(frame.error());
+		destination->clear();
 		return;
 	}
 
+	createThumbnail(frame.planes(), targetSize, destination);
+}
+
+void Thumbnailer::createThumbnail(const std::vector<Span<uint8_t>> &planes,
+				  const Size &targetSize,
+				  std::vector<unsigned char> *destination)
+{
 	if (!valid_) {
 		LOG(Thumbnailer, Error) << "Config is unconfigured or invalid.";
+		destination->clear();
 		return;
 	}
 
@@ -59,38 +77,76 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 	const unsigned int tw = targetSize.width;
 	const unsigned int th = targetSize.height;
 
-	ASSERT(frame.planes().size() == 2);
+	ASSERT(planes.size() == 2);
 	ASSERT(tw % 2 == 0 && th % 2 == 0);
 
-	/* Image scaling block implementing nearest-neighbour algorithm. */
-	unsigned char *src = frame.planes()[0].data();
-	unsigned char *srcC = frame.planes()[1].data();
-	unsigned char *srcCb, *srcCr;
-	unsigned char *dstY, *srcY;
-
+	/*
+	 * The destination is resized without shrinking its capacity, callers
+	 * are expected to reuse it across captures to avoid reallocations.
+	 */
 	size_t dstSize = (th * tw) + ((th / 2) * tw);
 	destination->resize(dstSize);
 	unsigned char *dst = destination->data();
-	unsigned char *dstC = dst + th * tw;
 
-	for (unsigned int y = 0; y < th; y += 2) {
-		unsigned int sourceY = (sh * y + th / 2) / th;
+	/* The luma plane, followed by the interleaved CbCr plane. */
+	scalePlane(planes[0].data(), sw, sh, 1, dst, tw, th);
+	scalePlane(planes[1].data(), sw / 2, sh / 2, 2,
+		   dst + th * tw, tw / 2, th / 2);
+}
+
+/*
+ * Downscale a plane with a box filter. Each destination sample is the average
+ * of up to kMaxTaps x kMaxTaps source samples evenly spread over the box it
+ * covers, which avoids the aliasing of nearest-neighbour scaling without
+ * reading the whole source image. The rows are first accumulated in rowSums_
+ * with a loop over contiguous samples that the compiler vectorises, and the
+ * columns are then averaged.
+ *
+ * The widths are expressed in pixels, each pixel being stored as a number of
+ * interleaved samples given by components.
+ */
+void Thumbnailer::scalePlane(const unsigned char *src, unsigned int sw,
+			     unsigned int sh, unsigned int components,
+			     unsigned char *dst, unsigned int tw, unsigned int th)
+{
+	const unsigned int stride = sw * components;
+
+	rowSums_.resize(stride);
+
+	for (unsigned int y = 0; y < th; y++) {
+		unsigned int y0 = sh * y / th;
+		unsigned int y1 = std::max(sh * (y + 1) / th, y0 + 1);
+		unsigned int rows = std::min(y1 - y0, kMaxTaps);
+
+		std::fill(rowSums_.begin(), rowSums_.end(), 0);
+
+		for (unsigned int i = 0; i < rows; i++) {
+			const unsigned char *line =
+				src + (y0 + (y1 - y0) * (2 * i + 1) / (2 * rows)) * stride;
+			uint16_t *sums = rowSums_.data();
+
+			for (unsigned int x = 0; x < stride; x++)
+				sums[x] += line[x];
+		}
+
+		unsigned char *dstLine = dst + y * tw * components;
 
-		dstY = dst + y * tw;
-		srcY = src + sw * sourceY;
-		srcCb = srcC + (sourceY / 2) * sw + 0;
-		srcCr = srcC + (sourceY / 2) * sw + 1;
+		for (unsigned int x = 0; x < tw; x++) {
+			unsigned int x0 = sw * x / tw;
+			unsigned int x1 = std::max(sw * (x + 1) / tw, x0 + 1);
+			unsigned int cols = std::min(x1 - x0, kMaxTaps);
+			unsigned int taps = rows * cols;
 
-		for (unsigned int x = 0; x < tw; x += 2) {
-			unsigned int sourceX = (sw * x + tw / 2) / tw;
+			for (unsigned int c = 0; c < components; c++) {
+				unsigned int sum = 0;
 
-			dstY[x] = srcY[sourceX];
-			dstY[tw + x] = srcY[sw + sourceX];
-			dstY[x + 1] = srcY[sourceX + 1];
-			dstY[tw + x + 1] = srcY[sw + sourceX + 1];
+				for (unsigned int i = 0; i < cols; i++) {
+					unsigned int sx = x0 + (x1 - x0) * (2 * i + 1) / (2 * cols);
+					sum += rowSums_[sx * components + c];
+				}
 
-			dstC[(y / 2) * tw + x + 0] = srcCb[(sourceX / 2) * 2];
-			dstC[(y / 2) * tw + x + 1] = srcCr[(sourceX / 2) * 2];
+				dstLine[x * components + c] = (sum + taps / 2) / taps;
+			}
 		}
 	}
 }
@@ -7,6 +7,11 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/base/span.h>
+
 #include <libcamera/framebuffer.h>
 #include <libcamera/geometry.h>
 
@@ -22,11 +27,20 @@ public:
 	void createThumbnail(const libcamera::FrameBuffer &source,
 			     const libcamera::Size &targetSize,
 			     std::vector<unsigned char> *dest);
+	void createThumbnail(const std::vector<libcamera::Span<uint8_t>> &planes,
+			     const libcamera::Size &targetSize,
+			     std::vector<unsigned char> *dest);
 	const libcamera::PixelFormat &pixelFormat() const { return pixelFormat_; }
 
 private:
+	void scalePlane(const unsigned char *src, unsigned int sw,
+			unsigned int sh, unsigned int components,
+			unsigned char *dst, unsigned int tw, unsigned int th);
+
 	libcamera::PixelFormat pixelFormat_;
 	libcamera::Size sourceSize_;
 
 	bool valid_;
+
+	std::vector<uint16_t> rowSums_;
 };
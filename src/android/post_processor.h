@@ -29,5 +29,11 @@ public:
 			      const libcamera::StreamConfiguration &outCfg) = 0;
 	virtual void process(Camera3RequestDescriptor::StreamBuffer *streamBuffer) = 0;
 
+	/*
+	 * Release the resources acquired by process(). Called from the thread
+	 * that runs process(), after the last request has been processed.
+	 */
+	virtual void stop() {}
+
 	libcamera::Signal<Camera3RequestDescriptor::StreamBuffer *, Status> processComplete;
 };
@@ -0,0 +1,269 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Post Processor using a memory-to-memory converter
+ */
+
+#include "post_processor_converter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/log.h>
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include <libcamera/formats.h>
+
+#include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/framebuffer.h"
+
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+LOG_DEFINE_CATEGORY(HALConverter)
+
+namespace {
+
+/* Maximum time to wait for the converter to process a frame. */
+constexpr std::chrono::milliseconds kConversionTimeout = 500ms;
+
+} /* namespace */
+
+/*
+ * The PostProcessorConverter scales frames with a memory-to-memory converter
+ * device. The source and destination buffers are imported with dma-buf, the
+ * frames are never mapped to the CPU.
+ *
+ * The converter device is located at configure() time. As the converter event
+ * notifiers are bound to the thread that creates them, the converter is
+ * instantiated for streaming in the post-processing thread by the first call
+ * to process(), and released by stop() in the same thread.
+ */
+
+PostProcessorConverter::~PostProcessorConverter()
+{
+	ASSERT(!converter_);
+}
+
+int PostProcessorConverter::configure(const StreamConfiguration &inCfg,
+				      const StreamConfiguration &outCfg)
+{
+	if (inCfg.pixelFormat != formats::NV12 ||
+	    outCfg.pixelFormat != formats::NV12) {
+		LOG(HALConverter, Debug) << "Unsupported format conversion "
+					 << inCfg.pixelFormat << " to "
+					 << outCfg.pixelFormat;
+		return -EINVAL;
+	}
+
+	std::unique_ptr<DeviceEnumerator> enumerator = DeviceEnumerator::create();
+	if (!enumerator || enumerator->enumerate() < 0)
+		return -ENODEV;
+
+	for (ConverterFactoryBase *factory : ConverterFactoryBase::factories()) {
+		for (const std::string &compatible : factory->compatibles()) {
+			media_ = enumerator->search(DeviceMatch(compatible));
+			if (media_)
+				break;
+		}
+
+		if (media_)
+			break;
+	}
+
+	if (!media_) {
+		LOG(HALConverter, Debug) << "No converter device found";
+		return -ENODEV;
+	}
+
+	/*
+	 * Validate the conversion with a temporary converter instance, the
+	 * streaming instance is created later in the post-processing thread.
+	 */
+	std::unique_ptr<Converter> converter = ConverterFactoryBase::create(media_.get());
+	if (!converter || !converter->isValid()) {
+		LOG(HALConverter, Error) << "Failed to open converter "
+					 << media_->driver();
+		media_.reset();
+		return -ENODEV;
+	}
+
+	std::vector<PixelFormat> outFormats = converter->formats(inCfg.pixelFormat);
+	if (std::find(outFormats.begin(), outFormats.end(), outCfg.pixelFormat) ==
+	    outFormats.end() ||
+	    !converter->sizes(inCfg.size).contains(outCfg.size)) {
+		LOG(HALConverter, Debug) << "Conversion from " << inCfg.toString()
+					 << " to " << outCfg.toString()
+					 << " not supported by " << media_->driver();
+		media_.reset();
+		return -EINVAL;
+	}
+
+	std::tie(destinationStride_, std::ignore) =
+		converter->strideAndFrameSize(outCfg.pixelFormat, outCfg.size);
+	if (!destinationStride_) {
+		media_.reset();
+		return -EINVAL;
+	}
+
+	inCfg_ = inCfg;
+	outCfg_ = outCfg;
+	outCfg_.bufferCount = inCfg.bufferCount;
+
+	LOG(HALConverter, Debug) << "Using converter " << media_->driver()
+				 << " for " << inCfg.toString() << " to "
+				 << outCfg.toString();
+
+	return 0;
+}
+
+int PostProcessorConverter::start()
+{
+	converter_ = ConverterFactoryBase::create(media_.get());
+	if (!converter_ || !converter_->isValid()) {
+		LOG(HALConverter, Error) << "Failed to open converter";
+		converter_.reset();
+		return -ENODEV;
+	}
+
+	converter_->inputBufferReady.connect(this, &PostProcessorConverter::inputBufferReady);
+	converter_->outputBufferReady.connect(this, &PostProcessorConverter::outputBufferReady);
+
+	int ret = converter_->configure(inCfg_, { outCfg_ });
+	if (ret < 0) {
+		converter_.reset();
+		return ret;
+	}
+
+	ret = converter_->start();
+	if (ret < 0) {
+		converter_.reset();
+		return ret;
+	}
+
+	return 0;
+}
+
+void PostProcessorConverter::stop()
+{
+	if (!converter_)
+		return;
+
+	converter_->stop();
+	converter_.reset();
+}
+
+void PostProcessorConverter::process(Camera3RequestDescriptor::StreamBuffer *streamBuffer)
+{
+	const FrameBuffer &source = *streamBuffer->srcBuffer;
+	CameraBuffer *destination = streamBuffer->dstBuffer.get();
+
+	if (destination->stride(0) != destinationStride_) {
+		LOG(HALConverter, Error)
+			<< "Destination stride " << destination->stride(0)
+			<< " doesn't match converter stride " << destinationStride_;
+		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
+		return;
+	}
+
+	if (!converter_ && start() < 0) {
+		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
+		return;
+	}
+
+	/*
+	 * Wrap the source planes in a new FrameBuffer, as the converter updates
+	 * the metadata of the buffers it processes and the source buffer may be
+	 * shared with other post-processors.
+	 */
+	FrameBuffer input(source.planes());
+	Span<FrameMetadata::Plane> inputPlanes = input._d()->metadata().planes();
+	for (auto [i, plane] : utils::enumerate(inputPlanes))
+		plane.bytesused = source.metadata().planes()[i].bytesused;
+
+	std::unique_ptr<FrameBuffer> output = createDestination(streamBuffer);
+	if (!output) {
+		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
+		return;
+	}
+
+	inputDone_ = false;
+	outputDone_ = false;
+
+	int ret = converter_->queueBuffers(&input, { { 0, output.get() } });
+	if (ret < 0) {
+		LOG(HALConverter, Error) << "Failed to queue buffers: " << ret;
+		stop();
+		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
+		return;
+	}
+
+	/*
+	 * The post-processing thread doesn't run an event loop, process the
+	 * converter events here until both buffers complete.
+	 */
+	EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+	Timer timer;
+	timer.start(kConversionTimeout);
+
+	while (!(inputDone_ && outputDone_) && timer.isRunning())
+		dispatcher->processEvents();
+
+	if (!inputDone_ || !outputDone_) {
+		LOG(HALConverter, Error) << "Conversion timeout";
+
+		/* Stopping the converter returns the queued buffers. */
+		stop();
+		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
+		return;
+	}
+
+	timer.stop();
+
+	if (output->metadata().status != FrameMetadata::FrameSuccess) {
+		LOG(HALConverter, Error) << "Conversion failed";
+		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
+		return;
+	}
+
+	processComplete.emit(streamBuffer, PostProcessor::Status::Success);
+}
+
+std::unique_ptr<FrameBuffer>
+PostProcessorConverter::createDestination(Camera3RequestDescriptor::StreamBuffer *streamBuffer) const
+{
+	const buffer_handle_t camera3Buffer = *streamBuffer->camera3Buffer;
+	const CameraBuffer *destination = streamBuffer->dstBuffer.get();
+
+	std::vector<FrameBuffer::Plane> planes(destination->numPlanes());
+	for (unsigned int i = 0; i < destination->numPlanes(); ++i) {
+		SharedFD fd{ camera3Buffer->data[i] };
+		if (!fd.isValid()) {
+			LOG(HALConverter, Error) << "No valid fd for plane " << i;
+			return nullptr;
+		}
+
+		planes[i].fd = fd;
+		planes[i].offset = destination->offset(i);
+		planes[i].length = destination->size(i);
+	}
+
+	return std::make_unique<FrameBuffer>(planes);
+}
+
+void PostProcessorConverter::inputBufferReady([[maybe_unused]] FrameBuffer *buffer)
+{
+	inputDone_ = true;
+}
+
+void PostProcessorConverter::outputBufferReady([[maybe_unused]] FrameBuffer *buffer)
+{
+	outputDone_ = true;
+}
@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Post Processor using a memory-to-memory converter
+ */
+
+#pragma once
+
+#include <memory>
+
+#include <libcamera/geometry.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/converter.h"
+#include "libcamera/internal/media_device.h"
+
+#include "../post_processor.h"
+
+class PostProcessorConverter : public PostProcessor
+{
+public:
+	PostProcessorConverter() = default;
+	~PostProcessorConverter();
+
+	int configure(const libcamera::StreamConfiguration &inCfg,
+		      const libcamera::StreamConfiguration &outCfg) override;
+	void process(Camera3RequestDescriptor::StreamBuffer *streamBuffer) override;
+	void stop() override;
+
+private:
+	int start();
+
+	std::unique_ptr<libcamera::FrameBuffer>
+	createDestination(Camera3RequestDescriptor::StreamBuffer *streamBuffer) const;
+
+	void inputBufferReady(libcamera::FrameBuffer *buffer);
+	void outputBufferReady(libcamera::FrameBuffer *buffer);
+
+	std::shared_ptr<libcamera::MediaDevice> media_;
+	std::unique_ptr<libcamera::Converter> converter_;
+
+	libcamera::StreamConfiguration inCfg_;
+	libcamera::StreamConfiguration outCfg_;
+	unsigned int destinationStride_ = 0;
+
+	bool inputDone_ = false;
+	bool outputDone_ = false;
+};
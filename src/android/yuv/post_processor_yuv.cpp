@@ -7,6 +7,8 @@
 
 #include "post_processor_yuv.h"
 
+#include <optional>
+
 #include <libyuv/scale.h>
 
 #include <libcamera/base/log.h>
@@ -59,16 +61,23 @@ void PostProcessorYuv::process(Camera3RequestDescriptor::StreamBuffer *streamBuf
 		return;
 	}
 
-	const MappedFrameBuffer sourceMapped(&source, MappedFrameBuffer::MapFlag::Read);
-	if (!sourceMapped.isValid()) {
+	/* Use the persistent mapping of the source buffer when available. */
+	std::optional<MappedFrameBuffer> mapped;
+	const MappedFrameBuffer *sourceMapped = streamBuffer->srcMapped;
+	if (!sourceMapped) {
+		mapped.emplace(&source, MappedFrameBuffer::MapFlag::Read);
+		sourceMapped = &*mapped;
+	}
+
+	if (!sourceMapped->isValid()) {
 		LOG(YUV, Error) << "Failed to mmap camera frame buffer";
 		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
 		return;
 	}
 
-	int ret = libyuv::NV12Scale(sourceMapped.planes()[0].data(),
+	int ret = libyuv::NV12Scale(sourceMapped->planes()[0].data(),
 				    sourceStride_[0],
-				    sourceMapped.planes()[1].data(),
+				    sourceMapped->planes()[1].data(),
 				    sourceStride_[1],
 				    sourceSize_.width, sourceSize_.height,
 				    destination->plane(0).data(),
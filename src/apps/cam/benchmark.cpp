@@ -0,0 +1,174 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Capture performance measurement
+ */
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sys/resource.h>
+#include <time.h>
+
+#include <libcamera/framebuffer.h>
+#include <libcamera/request.h>
+
+using namespace libcamera;
+
+/*
+ * The Benchmark class collects statistics about a capture session, and prints
+ * them as a summary when the session stops. It measures, for each request,
+ * the time from queueing to completion by the camera and from completion to
+ * processing in the event loop. For each stream, it measures the interval
+ * between frames, the time from the sensor timestamp to the completion of the
+ * request, and counts the frames dropped by the camera, detected as gaps in
+ * the sequence numbers.
+ */
+
+Benchmark::Benchmark(const std::map<const Stream *, std::string> &streamNames)
+	: streamNames_(streamNames), startTime_(0), startCpuTime_(0)
+{
+}
+
+void Benchmark::start()
+{
+	startTime_ = now();
+	startCpuTime_ = cpuTime();
+}
+
+/*
+ * Use the clock of the buffer timestamps, to compute the latency from the
+ * sensor.
+ */
+uint64_t Benchmark::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* CPU time spent by all threads of the process, including libcamera's. */
+uint64_t Benchmark::cpuTime()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ULL +
+	       (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ULL;
+}
+
+void Benchmark::requestQueued(const Request *request)
+{
+	std::lock_guard<std::mutex> locker(lock_);
+	requests_[request] = { now(), 0 };
+}
+
+void Benchmark::requestCompleted(const Request *request)
+{
+	std::lock_guard<std::mutex> locker(lock_);
+	requests_[request].completed = now();
+}
+
+void Benchmark::requestProcessed(const Request *request)
+{
+	uint64_t processed = now();
+	RequestTimes times;
+
+	{
+		std::lock_guard<std::mutex> locker(lock_);
+		times = requests_[request];
+	}
+
+	if (times.queued && times.completed) {
+		queueToComplete_.push_back(times.completed - times.queued);
+		completeToProcess_.push_back(processed - times.completed);
+	}
+
+	for (const auto &[stream, buffer] : request->buffers()) {
+		const FrameMetadata &metadata = buffer->metadata();
+		StreamStats &stats = streams_[stream];
+
+		if (metadata.status != FrameMetadata::FrameSuccess) {
+			stats.errors++;
+			continue;
+		}
+
+		if (stats.frames) {
+			if (metadata.sequence > stats.lastSequence + 1)
+				stats.dropped += metadata.sequence - stats.lastSequence - 1;
+			if (metadata.timestamp > stats.lastTimestamp)
+				stats.intervals.push_back(metadata.timestamp - stats.lastTimestamp);
+		}
+
+		if (times.completed > metadata.timestamp)
+			stats.sensorToComplete.push_back(times.completed - metadata.timestamp);
+
+		stats.frames++;
+		stats.lastSequence = metadata.sequence;
+		stats.lastTimestamp = metadata.timestamp;
+	}
+}
+
+void Benchmark::printLatencies(const std::string &label,
+			       std::vector<uint64_t> samples)
+{
+	std::cout << "    " << std::left << std::setw(20) << label
+		  << std::right << " (ms):";
+
+	if (samples.empty()) {
+		std::cout << " no samples" << std::endl;
+		return;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	auto percentile = [&](unsigned int p) {
+		size_t index = (samples.size() - 1) * p / 100;
+		return samples[index] / 1000000.0;
+	};
+
+	uint64_t sum = 0;
+	for (uint64_t sample : samples)
+		sum += sample;
+
+	std::cout << std::fixed << std::setprecision(3)
+		  << " mean " << sum / samples.size() / 1000000.0
+		  << " min " << samples.front() / 1000000.0
+		  << " p50 " << percentile(50)
+		  << " p90 " << percentile(90)
+		  << " p99 " << percentile(99)
+		  << " max " << samples.back() / 1000000.0
+		  << std::endl;
+}
+
+void Benchmark::printSummary(const std::string &name) const
+{
+	double elapsed = (now() - startTime_) / 1000000000.0;
+	double cpu = (cpuTime() - startCpuTime_) / 1000000000.0;
+
+	std::cout << std::fixed << std::setprecision(2)
+		  << name << ": Benchmark: " << elapsed << " s, CPU usage "
+		  << (elapsed ? cpu / elapsed * 100.0 : 0.0) << "%" << std::endl;
+
+	printLatencies("queue -> complete", queueToComplete_);
+	printLatencies("complete -> process", completeToProcess_);
+
+	for (const auto &[stream, stats] : streams_) {
+		auto streamName = streamNames_.find(stream);
+		unsigned int expected = stats.frames + stats.dropped;
+
+		std::cout << std::fixed << std::setprecision(2)
+			  << "  " << (streamName != streamNames_.end() ? streamName->second : "")
+			  << ": " << stats.frames << " frames, "
+			  << (elapsed ? stats.frames / elapsed : 0.0) << " fps, "
+			  << stats.dropped << " dropped ("
+			  << (expected ? stats.dropped * 100.0 / expected : 0.0)
+			  << "%), " << stats.errors << " errors" << std::endl;
+
+		printLatencies("frame interval", stats.intervals);
+		printLatencies("sensor -> complete", stats.sensorToComplete);
+	}
+}
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Capture performance measurement
+ */
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace libcamera {
+class Request;
+class Stream;
+} /* namespace libcamera */
+
+class Benchmark
+{
+public:
+	Benchmark(const std::map<const libcamera::Stream *, std::string> &streamNames);
+
+	void start();
+
+	void requestQueued(const libcamera::Request *request);
+	void requestCompleted(const libcamera::Request *request);
+	void requestProcessed(const libcamera::Request *request);
+
+	void printSummary(const std::string &name) const;
+
+private:
+	struct StreamStats {
+		unsigned int frames = 0;
+		unsigned int dropped = 0;
+		unsigned int errors = 0;
+		unsigned int lastSequence = 0;
+		uint64_t lastTimestamp = 0;
+
+		/* Durations in nanoseconds */
+		std::vector<uint64_t> intervals;
+		std::vector<uint64_t> sensorToComplete;
+	};
+
+	struct RequestTimes {
+		uint64_t queued = 0;
+		uint64_t completed = 0;
+	};
+
+	static uint64_t now();
+	static uint64_t cpuTime();
+	static void printLatencies(const std::string &label,
+				   std::vector<uint64_t> samples);
+
+	const std::map<const libcamera::Stream *, std::string> &streamNames_;
+
+	uint64_t startTime_;
+	uint64_t startCpuTime_;
+
+	std::map<const libcamera::Stream *, StreamStats> streams_;
+	std::vector<uint64_t> queueToComplete_;
+	std::vector<uint64_t> completeToProcess_;
+
+	/* Accessed from the camera manager thread in requestCompleted() */
+	mutable std::mutex lock_;
+	std::map<const libcamera::Request *, RequestTimes> requests_;
+};
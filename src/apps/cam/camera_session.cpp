@@ -5,6 +5,7 @@
  * Camera capture session
  */
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <limits.h>
@@ -16,6 +17,7 @@
 #include "../common/event_loop.h"
 #include "../common/stream_options.h"
 
+#include "benchmark.h"
 #include "camera_session.h"
 #include "capture_script.h"
 #include "file_sink.h"
@@ -219,9 +221,18 @@ int CameraSession::start()
 
 	camera_->requestCompleted.connect(this, &CameraSession::requestComplete);
 
+	if (options_.isSet(OptBenchmark))
+		benchmark_ = std::make_unique<Benchmark>(streamNames_);
+
 #ifdef HAVE_KMS
-	if (options_.isSet(OptDisplay))
-		sink_ = std::make_unique<KMSSink>(options_[OptDisplay].toString());
+	if (options_.isSet(OptDisplay)) {
+		unsigned int queueDepth = 1;
+		if (options_.isSet(OptDisplayQueue))
+			queueDepth = std::max(options_[OptDisplayQueue].toInteger(), 1);
+
+		sink_ = std::make_unique<KMSSink>(options_[OptDisplay].toString(),
+						  queueDepth);
+	}
 #endif
 
 #ifdef HAVE_SDL
@@ -235,6 +246,10 @@ int CameraSession::start()
 							   options_[OptFile]);
 		else
 			sink_ = std::make_unique<FileSink>(camera_.get(), streamNames_);
+
+#ifdef HAVE_ZLIB
+		static_cast<FileSink *>(sink_.get())->setDngDeflate(options_.isSet(OptDngDeflate));
+#endif
 	}
 
 	if (sink_) {
@@ -267,6 +282,11 @@ void CameraSession::stop()
 
 	sink_.reset();
 
+	if (benchmark_) {
+		benchmark_->printSummary("cam" + std::to_string(cameraIndex_));
+		benchmark_.reset();
+	}
+
 	requests_.clear();
 
 	allocator_.reset();
@@ -329,6 +349,9 @@ int CameraSession::startCapture()
 		}
 	}
 
+	if (benchmark_)
+		benchmark_->start();
+
 	ret = camera_->start();
 	if (ret) {
 		std::cout << "Failed to start capture" << std::endl;
@@ -370,6 +393,9 @@ int CameraSession::queueRequest(Request *request)
 
 	queueCount_++;
 
+	if (benchmark_)
+		benchmark_->requestQueued(request);
+
 	return camera_->queueRequest(request);
 }
 
@@ -378,6 +404,9 @@ void CameraSession::requestComplete(Request *request)
 	if (request->status() == Request::RequestCancelled)
 		return;
 
+	if (benchmark_)
+		benchmark_->requestCompleted(request);
+
 	/*
 	 * Defer processing of the completed request to the event loop, to avoid
 	 * blocking the camera manager thread.
@@ -397,6 +426,43 @@ void CameraSession::processRequest(Request *request)
 	if (captureLimit_ && captureCount_ >= captureLimit_)
 		return;
 
+	bool requeue = true;
+
+	if (benchmark_) {
+		/* Only record statistics, to minimize the processing overhead. */
+		benchmark_->requestProcessed(request);
+	} else {
+		printRequest(request);
+	}
+
+	if (sink_) {
+		if (!sink_->processRequest(request))
+			requeue = false;
+	}
+
+	/*
+	 * Notify the user that capture is complete if the limit has just been
+	 * reached.
+	 */
+	captureCount_++;
+	if (captureLimit_ && captureCount_ >= captureLimit_) {
+		captureDone.emit();
+		return;
+	}
+
+	/*
+	 * If the frame sink holds on the request, we'll requeue it later in the
+	 * complete handler.
+	 */
+	if (!requeue)
+		return;
+
+	request->reuse(Request::ReuseBuffers);
+	queueRequest(request);
+}
+
+void CameraSession::printRequest(Request *request)
+{
 	const Request::BufferMap &buffers = request->buffers();
 
 	/*
@@ -408,8 +474,6 @@ void CameraSession::processRequest(Request *request)
 	fps = last_ != 0 && fps ? 1000000000.0 / fps : 0.0;
 	last_ = ts;
 
-	bool requeue = true;
-
 	std::stringstream info;
 	info << ts / 1000000000 << "."
 	     << std::setw(6) << std::setfill('0') << ts / 1000 % 1000000
@@ -430,11 +494,6 @@ void CameraSession::processRequest(Request *request)
 		}
 	}
 
-	if (sink_) {
-		if (!sink_->processRequest(request))
-			requeue = false;
-	}
-
 	std::cout << info.str() << std::endl;
 
 	if (printMetadata_) {
@@ -445,26 +504,6 @@ void CameraSession::processRequest(Request *request)
 				  << value.toString() << std::endl;
 		}
 	}
-
-	/*
-	 * Notify the user that capture is complete if the limit has just been
-	 * reached.
-	 */
-	captureCount_++;
-	if (captureLimit_ && captureCount_ >= captureLimit_) {
-		captureDone.emit();
-		return;
-	}
-
-	/*
-	 * If the frame sink holds on the request, we'll requeue it later in the
-	 * complete handler.
-	 */
-	if (!requeue)
-		return;
-
-	request->reuse(Request::ReuseBuffers);
-	queueRequest(request);
 }
 
 void CameraSession::sinkRelease(Request *request)
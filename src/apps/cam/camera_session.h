@@ -23,6 +23,7 @@
 
 #include "../common/options.h"
 
+class Benchmark;
 class CaptureScript;
 class FrameSink;
 
@@ -55,6 +56,7 @@ private:
 	int queueRequest(libcamera::Request *request);
 	void requestComplete(libcamera::Request *request);
 	void processRequest(libcamera::Request *request);
+	void printRequest(libcamera::Request *request);
 	void sinkRelease(libcamera::Request *request);
 
 	const OptionsParser::Options &options_;
@@ -62,6 +64,7 @@ private:
 	std::unique_ptr<libcamera::CameraConfiguration> config_;
 
 	std::unique_ptr<CaptureScript> script_;
+	std::unique_ptr<Benchmark> benchmark_;
 
 	std::map<const libcamera::Stream *, std::string> streamNames_;
 	std::unique_ptr<FrameSink> sink_;
@@ -16,6 +16,7 @@
 #include <libcamera/camera.h>
 
 #include "../common/dng_writer.h"
+#include "../common/event_loop.h"
 #include "../common/image.h"
 #include "../common/ppm_writer.h"
 
@@ -30,12 +31,14 @@ FileSink::FileSink([[maybe_unused]] const libcamera::Camera *camera,
 #ifdef HAVE_TIFF
 	  camera_(camera),
 #endif
-	  streamNames_(streamNames), pattern_(pattern)
+	  dngDeflate_(false), streamNames_(streamNames), pattern_(pattern),
+	  stopping_(false)
 {
 }
 
 FileSink::~FileSink()
 {
+	stop();
 }
 
 int FileSink::configure(const libcamera::CameraConfiguration &config)
@@ -44,6 +47,16 @@ int FileSink::configure(const libcamera::CameraConfiguration &config)
 	if (ret < 0)
 		return ret;
 
+	if (pattern_.size() > 6 &&
+	    pattern_.compare(pattern_.size() - 6, 6, ".lcraw") == 0) {
+		container_ = std::make_unique<RawContainerWriter>();
+		ret = container_->open(pattern_, config, streamNames_);
+		if (ret < 0) {
+			container_.reset();
+			return ret;
+		}
+	}
+
 	return 0;
 }
 
@@ -56,12 +69,98 @@ void FileSink::mapBuffer(FrameBuffer *buffer)
 	mappedBuffers_[buffer] = std::move(image);
 }
 
+int FileSink::start()
+{
+	/* DNG and PPM files are written synchronously. */
+	bool raw = pattern_.empty() ||
+		   (pattern_.find(".ppm", pattern_.size() - 4) == std::string::npos &&
+		    pattern_.find(".dng", pattern_.size() - 4) == std::string::npos);
+	if (!raw)
+		return 0;
+
+	stopping_ = false;
+	writer_ = std::thread(&FileSink::writerThread, this);
+
+	return 0;
+}
+
+int FileSink::stop()
+{
+	if (writer_.joinable()) {
+		{
+			std::unique_lock<std::mutex> locker(lock_);
+			stopping_ = true;
+		}
+		cv_.notify_one();
+
+		/* The writer thread completes the pending requests first. */
+		writer_.join();
+	}
+
+	for (auto &[filename, fd] : files_)
+		close(fd);
+	files_.clear();
+
+	container_.reset();
+
+	return 0;
+}
+
 bool FileSink::processRequest(Request *request)
 {
-	for (auto [stream, buffer] : request->buffers())
-		writeBuffer(stream, buffer, request->metadata());
+	if (!writer_.joinable()) {
+		for (auto [stream, buffer] : request->buffers())
+			writeBuffer(stream, buffer, request->metadata());
+
+		return true;
+	}
+
+	{
+		std::unique_lock<std::mutex> locker(lock_);
+		pending_.push(request);
+	}
+	cv_.notify_one();
+
+	return false;
+}
+
+void FileSink::writerThread()
+{
+	std::unique_lock<std::mutex> locker(lock_);
+
+	while (true) {
+		cv_.wait(locker, [&] { return stopping_ || !pending_.empty(); });
+		if (pending_.empty())
+			return;
+
+		Request *request = pending_.front();
+		pending_.pop();
+		locker.unlock();
+
+		for (auto [stream, buffer] : request->buffers())
+			writeBuffer(stream, buffer, request->metadata());
+
+		EventLoop::instance()->callLater([this, request]() {
+			requestProcessed.emit(request);
+		});
 
-	return true;
+		locker.lock();
+	}
+}
+
+int FileSink::openFile(const std::string &filename, bool append)
+{
+	int fd = open(filename.c_str(), O_CREAT | O_WRONLY |
+		      (append ? O_APPEND : O_TRUNC),
+		      S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	if (fd == -1) {
+		int ret = -errno;
+		std::cerr << "failed to open file " << filename << ": "
+			  << strerror(-ret) << std::endl;
+		return ret;
+	}
+
+	return fd;
 }
 
 void FileSink::writeBuffer(const Stream *stream, FrameBuffer *buffer,
@@ -71,6 +170,12 @@ void FileSink::writeBuffer(const Stream *stream, FrameBuffer *buffer,
 	size_t pos;
 	int fd, ret = 0;
 
+	if (container_) {
+		container_->write(stream, buffer, mappedBuffers_[buffer].get(),
+				  metadata);
+		return;
+	}
+
 	if (!pattern_.empty())
 		filename = pattern_;
 
@@ -96,7 +201,9 @@ void FileSink::writeBuffer(const Stream *stream, FrameBuffer *buffer,
 	if (dng) {
 		ret = DNGWriter::write(filename.c_str(), camera_,
 				       stream->configuration(), metadata,
-				       buffer, image->data(0).data());
+				       buffer, image->data(0).data(),
+				       dngDeflate_ ? DNGWriter::Compression::Deflate
+						   : DNGWriter::Compression::None);
 		if (ret < 0)
 			std::cerr << "failed to write DNG file `" << filename
 				  << "'" << std::endl;
@@ -114,14 +221,21 @@ void FileSink::writeBuffer(const Stream *stream, FrameBuffer *buffer,
 		return;
 	}
 
-	fd = open(filename.c_str(), O_CREAT | O_WRONLY |
-		  (pos == std::string::npos ? O_APPEND : O_TRUNC),
-		  S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
-	if (fd == -1) {
-		ret = -errno;
-		std::cerr << "failed to open file " << filename << ": "
-			  << strerror(-ret) << std::endl;
-		return;
+	/*
+	 * Without a '#' in the file name, all frames are appended to a single
+	 * file, which is kept open until the sink stops.
+	 */
+	bool append = pos == std::string::npos;
+	auto file = files_.find(filename);
+	if (append && file != files_.end()) {
+		fd = file->second;
+	} else {
+		fd = openFile(filename, append);
+		if (fd < 0)
+			return;
+
+		if (append)
+			files_[filename] = fd;
 	}
 
 	for (unsigned int i = 0; i < buffer->planes().size(); ++i) {
@@ -154,5 +268,6 @@ void FileSink::writeBuffer(const Stream *stream, FrameBuffer *buffer,
 		}
 	}
 
-	close(fd);
+	if (!append)
+		close(fd);
 }
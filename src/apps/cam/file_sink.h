@@ -7,13 +7,18 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <thread>
 
 #include <libcamera/stream.h>
 
 #include "frame_sink.h"
+#include "raw_container.h"
 
 class Image;
 
@@ -29,17 +34,42 @@ public:
 
 	void mapBuffer(libcamera::FrameBuffer *buffer) override;
 
+	int start() override;
+	int stop() override;
+
+	void setDngDeflate(bool enable) { dngDeflate_ = enable; }
+
 	bool processRequest(libcamera::Request *request) override;
 
 private:
 	void writeBuffer(const libcamera::Stream *stream,
 			 libcamera::FrameBuffer *buffer,
 			 const libcamera::ControlList &metadata);
+	int openFile(const std::string &filename, bool append);
+	void writerThread();
 
 #ifdef HAVE_TIFF
 	const libcamera::Camera *camera_;
 #endif
+	bool dngDeflate_;
 	std::map<const libcamera::Stream *, std::string> streamNames_;
 	std::string pattern_;
 	std::map<libcamera::FrameBuffer *, std::unique_ptr<Image>> mappedBuffers_;
+
+	/*
+	 * Raw frames are written by a separate thread, to avoid stalling the
+	 * event loop when the storage is slow. The requests are held until
+	 * they are written, which bounds the queue to the number of requests.
+	 */
+	std::thread writer_;
+	std::mutex lock_;
+	std::condition_variable cv_;
+	std::queue<libcamera::Request *> pending_;
+	bool stopping_;
+
+	/* Files that all frames are appended to, kept open while running. */
+	std::map<std::string, int> files_;
+
+	/* Container all frames are written to, for '.lcraw' file names. */
+	std::unique_ptr<RawContainerWriter> container_;
 };
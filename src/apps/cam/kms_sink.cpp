@@ -23,8 +23,10 @@
 
 #include "drm.h"
 
-KMSSink::KMSSink(const std::string &connectorName)
-	: connector_(nullptr), crtc_(nullptr), plane_(nullptr), mode_(nullptr)
+KMSSink::KMSSink(const std::string &connectorName, unsigned int queueDepth)
+	: connector_(nullptr), crtc_(nullptr), plane_(nullptr), mode_(nullptr),
+	  queueDepth_(std::max(queueDepth, 1U)), displayed_(0), dropped_(0),
+	  missedVblanks_(0)
 {
 	int ret = dev_.init();
 	if (ret < 0)
@@ -326,6 +328,10 @@ int KMSSink::start()
 		return ret;
 	}
 
+	displayed_ = 0;
+	dropped_ = 0;
+	missedVblanks_ = 0;
+
 	return 0;
 }
 
@@ -348,8 +354,13 @@ int KMSSink::stop()
 		return ret;
 	}
 
+	std::cout
+		<< "KMS: " << displayed_ << " frames displayed, " << dropped_
+		<< " dropped, " << missedVblanks_ << " vblanks missed"
+		<< std::endl;
+
 	/* Free all buffers. */
-	pending_.reset();
+	pending_.clear();
 	queued_.reset();
 	active_.reset();
 	buffers_.clear();
@@ -420,7 +431,31 @@ bool KMSSink::setupComposition(DRM::FrameBuffer *drmBuffer)
 		return true;
 	}
 
-	/* 3. Center the frame buffer on the display. */
+	/*
+	 * 3. Scale the frame buffer by an integer factor, preserving aspect
+	 *    ratio. Planes that can't scale arbitrarily often support integer
+	 *    ratios.
+	 */
+	unsigned int upscale = std::min(display.width / framebuffer.width,
+					display.height / framebuffer.height);
+	unsigned int downscale = std::max((framebuffer.width + display.width - 1) / display.width,
+					  (framebuffer.height + display.height - 1) / display.height);
+
+	if (upscale > 1 || downscale > 1) {
+		src = framebuffer;
+		dst = (upscale > 1 ? framebuffer.size() * upscale
+				   : framebuffer.size() / downscale)
+			      .centeredTo(display.center());
+
+		if (testModeSet(drmBuffer, src, dst)) {
+			std::cout << "KMS: integer scaled output" << std::endl;
+			src_ = src;
+			dst_ = dst;
+			return true;
+		}
+	}
+
+	/* 4. Center the frame buffer on the display. */
 	src = display.size().centeredTo(framebuffer.center()).boundedTo(framebuffer);
 	dst = framebuffer.size().centeredTo(display.center()).boundedTo(display);
 
@@ -431,7 +466,7 @@ bool KMSSink::setupComposition(DRM::FrameBuffer *drmBuffer)
 		return true;
 	}
 
-	/* 4. Align the frame buffer on the top-left of the display. */
+	/* 5. Align the frame buffer on the top-left of the display. */
 	src = framebuffer.boundedTo(display);
 	dst = display.boundedTo(framebuffer);
 
@@ -447,13 +482,6 @@ bool KMSSink::setupComposition(DRM::FrameBuffer *drmBuffer)
 
 bool KMSSink::processRequest(libcamera::Request *camRequest)
 {
-	/*
-	 * Perform a very crude rate adaptation by simply dropping the request
-	 * if the display queue is full.
-	 */
-	if (pending_)
-		return true;
-
 	libcamera::FrameBuffer *buffer = camRequest->buffers().begin()->second;
 	auto iter = buffers_.find(buffer);
 	if (iter == buffers_.end())
@@ -466,6 +494,8 @@ bool KMSSink::processRequest(libcamera::Request *camRequest)
 		std::make_unique<DRM::AtomicRequest>(&dev_);
 	drmRequest->addProperty(plane_, "FB_ID", drmBuffer->id());
 
+	std::lock_guard<std::mutex> lock(lock_);
+
 	if (!active_ && !queued_) {
 		/* Enable the display pipeline on the first frame. */
 		if (!setupComposition(drmBuffer)) {
@@ -496,31 +526,68 @@ bool KMSSink::processRequest(libcamera::Request *camRequest)
 		flags |= DRM::AtomicRequest::FlagAllowModeset;
 	}
 
-	pending_ = std::make_unique<Request>(std::move(drmRequest), camRequest);
+	/*
+	 * Perform rate adaptation by dropping the oldest frame when the
+	 * display queue is full. This bounds the display latency while the
+	 * queue absorbs jitter between the camera and display frame rates.
+	 */
+	if (pending_.size() >= queueDepth_) {
+		requestProcessed.emit(pending_.front()->camRequest_);
+		pending_.pop_front();
+		dropped_++;
+	}
 
-	std::lock_guard<std::mutex> lock(lock_);
+	pending_.push_back(std::make_unique<Request>(std::move(drmRequest), camRequest));
 
-	if (!queued_) {
-		int ret = pending_->drmRequest_->commit(flags);
-		if (ret < 0) {
-			std::cerr
-				<< "Failed to commit atomic request: "
-				<< strerror(-ret) << std::endl;
-			/* \todo Implement error handling */
+	if (!queued_)
+		queueNext(flags);
+
+	return false;
+}
+
+/*
+ * Commit the oldest pending request. Requests that fail to commit are
+ * released immediately, as no page flip event would complete them. Must be
+ * called with lock_ held.
+ */
+void KMSSink::queueNext(unsigned int flags)
+{
+	while (!pending_.empty()) {
+		std::unique_ptr<Request> request = std::move(pending_.front());
+		pending_.pop_front();
+
+		int ret = request->drmRequest_->commit(flags);
+		if (!ret) {
+			queued_ = std::move(request);
+			return;
 		}
 
-		queued_ = std::move(pending_);
-	}
+		std::cerr
+			<< "Failed to commit atomic request: "
+			<< strerror(-ret) << std::endl;
 
-	return false;
+		requestProcessed.emit(request->camRequest_);
+		dropped_++;
+	}
 }
 
-void KMSSink::requestComplete([[maybe_unused]] DRM::AtomicRequest *request)
+void KMSSink::requestComplete(DRM::AtomicRequest *request)
 {
 	std::lock_guard<std::mutex> lock(lock_);
 
 	assert(queued_ && queued_->drmRequest_.get() == request);
 
+	/*
+	 * A request committed from the previous page flip event should be
+	 * displayed on the next vblank. Any gap means the frame has been
+	 * committed too late and the previous one has been displayed twice.
+	 */
+	if (queued_->previousSequence_ &&
+	    request->sequence() - queued_->previousSequence_ > 1)
+		missedVblanks_ += request->sequence() - queued_->previousSequence_ - 1;
+
+	displayed_++;
+
 	/* Complete the active request, if any. */
 	if (active_)
 		requestProcessed.emit(active_->camRequest_);
@@ -528,9 +595,8 @@ void KMSSink::requestComplete([[maybe_unused]] DRM::AtomicRequest *request)
 	/* The queued request becomes active. */
 	active_ = std::move(queued_);
 
-	/* Queue the pending request, if any. */
-	if (pending_) {
-		pending_->drmRequest_->commit(DRM::AtomicRequest::FlagAsync);
-		queued_ = std::move(pending_);
-	}
+	/* Queue the next pending request, if any. */
+	queueNext(DRM::AtomicRequest::FlagAsync);
+	if (queued_)
+		queued_->previousSequence_ = request->sequence();
 }
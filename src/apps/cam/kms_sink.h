@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <deque>
 #include <list>
 #include <memory>
 #include <mutex>
@@ -25,7 +26,7 @@
 class KMSSink : public FrameSink
 {
 public:
-	KMSSink(const std::string &connectorName);
+	KMSSink(const std::string &connectorName, unsigned int queueDepth = 1);
 
 	void mapBuffer(libcamera::FrameBuffer *buffer) override;
 
@@ -41,12 +42,19 @@ private:
 	public:
 		Request(std::unique_ptr<DRM::AtomicRequest> drmRequest,
 			libcamera::Request *camRequest)
-			: drmRequest_(std::move(drmRequest)), camRequest_(camRequest)
+			: drmRequest_(std::move(drmRequest)), camRequest_(camRequest),
+			  previousSequence_(0)
 		{
 		}
 
 		std::unique_ptr<DRM::AtomicRequest> drmRequest_;
 		libcamera::Request *camRequest_;
+
+		/*
+		 * Vblank sequence of the page flip the request has been
+		 * committed from, 0 if committed from processRequest().
+		 */
+		unsigned int previousSequence_;
 	};
 
 	int selectPipeline(const libcamera::PixelFormat &format);
@@ -56,6 +64,7 @@ private:
 			 const libcamera::Rectangle &dst);
 	bool setupComposition(DRM::FrameBuffer *drmBuffer);
 
+	void queueNext(unsigned int flags);
 	void requestComplete(DRM::AtomicRequest *request);
 
 	DRM::Device dev_;
@@ -76,8 +85,14 @@ private:
 
 	std::map<libcamera::FrameBuffer *, std::unique_ptr<DRM::FrameBuffer>> buffers_;
 
+	unsigned int queueDepth_;
+
 	std::mutex lock_;
-	std::unique_ptr<Request> pending_;
+	std::deque<std::unique_ptr<Request>> pending_;
 	std::unique_ptr<Request> queued_;
 	std::unique_ptr<Request> active_;
+
+	unsigned int displayed_;
+	unsigned int dropped_;
+	unsigned int missedVblanks_;
 };
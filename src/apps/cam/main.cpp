@@ -143,6 +143,12 @@ int CamApp::parseOptions(int argc, char *argv[])
 			 "Display viewfinder through DRM/KMS on specified connector",
 			 "display", ArgumentOptional, "connector", false,
 			 OptCamera);
+	parser.addOption(OptDisplayQueue, OptionInteger,
+			 "Set the number of frames queued for display through DRM/KMS\n"
+			 "Frames are dropped when the queue is full. The camera must\n"
+			 "provide at least <depth> + 2 buffers. The default is 1.",
+			 "display-queue", ArgumentRequired, "depth", false,
+			 OptCamera);
 #endif
 	parser.addOption(OptFile, OptionString,
 			 "Write captured frames to disk\n"
@@ -150,12 +156,16 @@ int CamApp::parseOptions(int argc, char *argv[])
 			 "to write files, using the default file name. Otherwise it sets the\n"
 			 "full file path and name. The first '#' character in the file name\n"
 			 "is expanded to the camera index, stream name and frame sequence number.\n"
+			 "If the file name contains no '#' character, all the frames are appended\n"
+			 "to a single file.\n"
 #ifdef HAVE_TIFF
 			 "If the file name ends with '.dng', then the frame will be written to\n"
 			 "the output file(s) in DNG format.\n"
 #endif
 			 "If the file name ends with '.ppm', then the frame will be written to\n"
 			 "the output file(s) in PPM format.\n"
+			 "If the file name ends with '.lcraw', then all the frames will be written\n"
+			 "to a single container file, with per-frame metadata.\n"
 			 "The default file name is 'frame-#.bin'.",
 			 "file", ArgumentOptional, "filename", false,
 			 OptCamera);
@@ -174,10 +184,23 @@ int CamApp::parseOptions(int argc, char *argv[])
 			 "Print the metadata for completed requests",
 			 "metadata", ArgumentNone, nullptr, false,
 			 OptCamera);
+	parser.addOption(OptBenchmark, OptionNone,
+			 "Measure the capture performance and print a summary when\n"
+			 "capture stops, instead of printing information for each frame.\n"
+			 "Frames are dropped without being processed unless a frame sink\n"
+			 "is also selected.",
+			 "benchmark", ArgumentNone, nullptr, false,
+			 OptCamera);
 	parser.addOption(OptCaptureScript, OptionString,
 			 "Load a capture session configuration script from a file",
 			 "script", ArgumentRequired, "script", false,
 			 OptCamera);
+#ifdef HAVE_ZLIB
+	parser.addOption(OptDngDeflate, OptionNone,
+			 "Compress the RAW data of DNG files with Deflate",
+			 "dng-deflate", ArgumentNone, nullptr, false,
+			 OptCamera);
+#endif
 
 	options_ = parser.parse(argc, argv);
 	if (!options_.valid())
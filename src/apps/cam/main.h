@@ -24,4 +24,7 @@ enum {
 	OptStrictFormats = 257,
 	OptMetadata = 258,
 	OptCaptureScript = 259,
+	OptDngDeflate = 260,
+	OptDisplayQueue = 261,
+	OptBenchmark = 262,
 };
@@ -0,0 +1,200 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Multi-frame raw container writer
+ */
+
+#include "raw_container.h"
+
+#include <algorithm>
+#include <array>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "../common/image.h"
+
+using namespace libcamera;
+
+static_assert(sizeof(RawContainerWriter::FileHeader) == 32);
+static_assert(sizeof(RawContainerWriter::StreamHeader) == 64);
+static_assert(sizeof(RawContainerWriter::FrameHeader) == 64);
+
+namespace {
+
+const std::array<uint8_t, RawContainerWriter::kAlignment> padding{};
+
+size_t paddingSize(size_t size)
+{
+	const size_t alignment = RawContainerWriter::kAlignment;
+
+	return (alignment - size % alignment) % alignment;
+}
+
+} /* namespace */
+
+RawContainerWriter::RawContainerWriter()
+	: fd_(-1)
+{
+}
+
+RawContainerWriter::~RawContainerWriter()
+{
+	close();
+}
+
+int RawContainerWriter::open(const std::string &filename,
+			     const CameraConfiguration &config,
+			     const std::map<const Stream *, std::string> &streamNames)
+{
+	fd_ = ::open(filename.c_str(), O_CREAT | O_WRONLY | O_TRUNC,
+		     S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	if (fd_ == -1) {
+		int ret = -errno;
+		std::cerr << "failed to open file " << filename << ": "
+			  << strerror(-ret) << std::endl;
+		return ret;
+	}
+
+	std::vector<uint8_t> header(sizeof(FileHeader) +
+				    config.size() * sizeof(StreamHeader));
+
+	FileHeader *fileHeader = reinterpret_cast<FileHeader *>(header.data());
+	memcpy(fileHeader->magic, "LCRAWCNT", sizeof(fileHeader->magic));
+	fileHeader->version = kVersion;
+	fileHeader->numStreams = config.size();
+	fileHeader->alignment = kAlignment;
+
+	StreamHeader *streamHeader =
+		reinterpret_cast<StreamHeader *>(header.data() + sizeof(FileHeader));
+
+	uint32_t index = 0;
+	for (const StreamConfiguration &cfg : config) {
+		auto name = streamNames.find(cfg.stream());
+		if (name != streamNames.end())
+			strncpy(streamHeader->name, name->second.c_str(),
+				sizeof(streamHeader->name) - 1);
+
+		streamHeader->pixelFormat = cfg.pixelFormat.fourcc();
+		streamHeader->width = cfg.size.width;
+		streamHeader->height = cfg.size.height;
+		streamHeader->stride = cfg.stride;
+		streamHeader->frameSize = cfg.frameSize;
+
+		streams_[cfg.stream()] = index++;
+		streamHeader++;
+	}
+
+	int ret = writeHeader(header.data(), header.size());
+	if (ret < 0) {
+		close();
+		return ret;
+	}
+
+	return 0;
+}
+
+void RawContainerWriter::close()
+{
+	if (fd_ == -1)
+		return;
+
+	::close(fd_);
+	fd_ = -1;
+	streams_.clear();
+}
+
+int RawContainerWriter::writeHeader(const void *data, size_t size)
+{
+	iovec iov[2] = {
+		{ const_cast<void *>(data), size },
+		{ const_cast<uint8_t *>(padding.data()), paddingSize(size) },
+	};
+
+	ssize_t ret = ::writev(fd_, iov, 2);
+	if (ret < 0) {
+		ret = -errno;
+		std::cerr << "write error: " << strerror(-ret) << std::endl;
+		return ret;
+	}
+
+	if (static_cast<size_t>(ret) != size + iov[1].iov_len) {
+		std::cerr << "write error: short write" << std::endl;
+		return -ENOSPC;
+	}
+
+	return 0;
+}
+
+int RawContainerWriter::write(const Stream *stream, const FrameBuffer *buffer,
+			      Image *image, const ControlList &metadata)
+{
+	auto index = streams_.find(stream);
+	if (fd_ == -1 || index == streams_.end())
+		return -EINVAL;
+
+	const FrameMetadata &fmd = buffer->metadata();
+	unsigned int numPlanes = std::min<unsigned int>(buffer->planes().size(),
+							kMaxPlanes);
+
+	FrameHeader header = {};
+	memcpy(header.magic, "FRAM", sizeof(header.magic));
+	header.stream = index->second;
+	header.sequence = fmd.sequence;
+	header.numPlanes = numPlanes;
+	header.timestamp = fmd.timestamp;
+	header.sensorTimestamp = metadata.get(controls::SensorTimestamp).value_or(0);
+	header.exposureTime = metadata.get(controls::ExposureTime).value_or(0);
+	header.analogueGain = metadata.get(controls::AnalogueGain).value_or(0.0f);
+
+	/*
+	 * Write the header and all planes with a single system call, the
+	 * header and payload padding come from a shared zeroed buffer.
+	 */
+	std::array<iovec, kMaxPlanes + 3> iov;
+	unsigned int count = 0;
+
+	iov[count++] = { &header, sizeof(header) };
+	iov[count++] = { const_cast<uint8_t *>(padding.data()),
+			 paddingSize(sizeof(header)) };
+
+	for (unsigned int i = 0; i < numPlanes; ++i) {
+		Span<uint8_t> data = image->data(i);
+		unsigned int length = std::min<unsigned int>(fmd.planes()[i].bytesused,
+							     data.size());
+
+		header.bytesused[i] = length;
+		header.payloadSize += length;
+		iov[count++] = { data.data(), length };
+	}
+
+	iov[count++] = { const_cast<uint8_t *>(padding.data()),
+			 paddingSize(header.payloadSize) };
+
+	size_t total = kAlignment + header.payloadSize + iov[count - 1].iov_len;
+
+	ssize_t ret = ::writev(fd_, iov.data(), count);
+	if (ret < 0) {
+		ret = -errno;
+		std::cerr << "write error: " << strerror(-ret) << std::endl;
+		return ret;
+	}
+
+	if (static_cast<size_t>(ret) != total) {
+		std::cerr << "write error: only " << ret
+			  << " bytes written instead of " << total << std::endl;
+		return -ENOSPC;
+	}
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Multi-frame raw container writer
+ */
+
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <string>
+
+namespace libcamera {
+class CameraConfiguration;
+class ControlList;
+class FrameBuffer;
+class Stream;
+} /* namespace libcamera */
+
+class Image;
+
+/*
+ * The raw container stores the frames of all streams sequentially in a single
+ * file. All fields are little-endian. Every section starts on a kAlignment
+ * boundary, so that frame payloads can be mapped directly by readers.
+ *
+ * The file starts with a FileHeader followed by one StreamHeader per stream.
+ * Each frame is then stored as a FrameHeader, padded to kAlignment, followed
+ * by the payload of all planes concatenated and padded to kAlignment.
+ */
+class RawContainerWriter
+{
+public:
+	static constexpr uint32_t kVersion = 1;
+	static constexpr unsigned int kAlignment = 4096;
+	static constexpr unsigned int kMaxPlanes = 4;
+
+	struct FileHeader {
+		char magic[8];		/* "LCRAWCNT" */
+		uint32_t version;
+		uint32_t numStreams;
+		uint32_t alignment;
+		uint32_t reserved[3];
+	};
+
+	struct StreamHeader {
+		char name[32];
+		uint32_t pixelFormat;	/* DRM fourcc */
+		uint32_t width;
+		uint32_t height;
+		uint32_t stride;
+		uint32_t frameSize;
+		uint32_t reserved[3];
+	};
+
+	struct FrameHeader {
+		char magic[4];		/* "FRAM" */
+		uint32_t stream;	/* Index in the stream headers */
+		uint32_t sequence;
+		uint32_t numPlanes;
+		uint64_t timestamp;	/* Buffer timestamp, in nanoseconds */
+		uint64_t sensorTimestamp; /* SensorTimestamp control, 0 if unknown */
+		int32_t exposureTime;	/* In microseconds, 0 if unknown */
+		float analogueGain;	/* 0 if unknown */
+		uint64_t payloadSize;	/* Without padding */
+		uint32_t bytesused[kMaxPlanes];
+	};
+
+	RawContainerWriter();
+	~RawContainerWriter();
+
+	int open(const std::string &filename,
+		 const libcamera::CameraConfiguration &config,
+		 const std::map<const libcamera::Stream *, std::string> &streamNames);
+	void close();
+
+	int write(const libcamera::Stream *stream,
+		  const libcamera::FrameBuffer *buffer, Image *image,
+		  const libcamera::ControlList &metadata);
+
+private:
+	int writeHeader(const void *data, size_t size);
+
+	int fd_;
+	std::map<const libcamera::Stream *, uint32_t> streams_;
+};
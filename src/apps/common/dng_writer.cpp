@@ -8,10 +8,16 @@
 #include "dng_writer.h"
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <map>
+#include <thread>
+#include <vector>
 
 #include <tiffio.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #include <libcamera/control_ids.h>
 #include <libcamera/formats.h>
@@ -27,7 +33,10 @@ enum CFAPatternColour : uint8_t {
 
 struct FormatInfo {
 	uint8_t bitsPerSample;
+	/* Number of significant bits, lower than bitsPerSample for LSB-aligned data. */
+	uint8_t significantBits;
 	CFAPatternColour pattern[4];
+	/* Pack a line in the output format, or nullptr if stored as-is. */
 	void (*packScanline)(void *output, const void *input,
 			     unsigned int width);
 	void (*thumbScanline)(const FormatInfo &info, void *output,
@@ -183,6 +192,28 @@ void thumbScanlineSBGGRxxP(const FormatInfo &info, void *output,
 	}
 }
 
+void thumbScanlineUnpacked(const FormatInfo &info, void *output,
+			   const void *input, unsigned int width,
+			   unsigned int stride)
+{
+	const uint16_t *in = static_cast<const uint16_t *>(input);
+	const uint16_t *in2 = reinterpret_cast<const uint16_t *>(
+		static_cast<const uint8_t *>(input) + stride);
+	uint8_t *out = static_cast<uint8_t *>(output);
+
+	/* Average 4 samples and scale the result to 8 bits. */
+	unsigned int shift = info.significantBits - 8 + 2;
+
+	for (unsigned int x = 0; x < width; x++) {
+		uint8_t value = (in[0] + in[1] + in2[0] + in2[1]) >> shift;
+		*out++ = value;
+		*out++ = value;
+		*out++ = value;
+		in += 16;
+		in2 += 16;
+	}
+}
+
 void packScanlineIPU3(void *output, const void *input, unsigned int width)
 {
 	const uint8_t *in = static_cast<const uint8_t *>(input);
@@ -285,107 +316,374 @@ void thumbScanlineIPU3([[maybe_unused]] const FormatInfo &info, void *output,
 static const std::map<PixelFormat, FormatInfo> formatInfo = {
 	{ formats::SBGGR8, {
 		.bitsPerSample = 8,
+		.significantBits = 8,
 		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
 		.packScanline = packScanlineSBGGR8,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SGBRG8, {
 		.bitsPerSample = 8,
+		.significantBits = 8,
 		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
 		.packScanline = packScanlineSBGGR8,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SGRBG8, {
 		.bitsPerSample = 8,
+		.significantBits = 8,
 		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
 		.packScanline = packScanlineSBGGR8,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SRGGB8, {
 		.bitsPerSample = 8,
+		.significantBits = 8,
 		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
 		.packScanline = packScanlineSBGGR8,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SBGGR10_CSI2P, {
 		.bitsPerSample = 10,
+		.significantBits = 10,
 		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
 		.packScanline = packScanlineSBGGR10P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SGBRG10_CSI2P, {
 		.bitsPerSample = 10,
+		.significantBits = 10,
 		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
 		.packScanline = packScanlineSBGGR10P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SGRBG10_CSI2P, {
 		.bitsPerSample = 10,
+		.significantBits = 10,
 		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
 		.packScanline = packScanlineSBGGR10P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SRGGB10_CSI2P, {
 		.bitsPerSample = 10,
+		.significantBits = 10,
 		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
 		.packScanline = packScanlineSBGGR10P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SBGGR12_CSI2P, {
 		.bitsPerSample = 12,
+		.significantBits = 12,
 		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
 		.packScanline = packScanlineSBGGR12P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SGBRG12_CSI2P, {
 		.bitsPerSample = 12,
+		.significantBits = 12,
 		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
 		.packScanline = packScanlineSBGGR12P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SGRBG12_CSI2P, {
 		.bitsPerSample = 12,
+		.significantBits = 12,
 		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
 		.packScanline = packScanlineSBGGR12P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SRGGB12_CSI2P, {
 		.bitsPerSample = 12,
+		.significantBits = 12,
 		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
 		.packScanline = packScanlineSBGGR12P,
 		.thumbScanline = thumbScanlineSBGGRxxP,
 	} },
 	{ formats::SBGGR10_IPU3, {
 		.bitsPerSample = 16,
+		.significantBits = 16,
 		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
 		.packScanline = packScanlineIPU3,
 		.thumbScanline = thumbScanlineIPU3,
 	} },
 	{ formats::SGBRG10_IPU3, {
 		.bitsPerSample = 16,
+		.significantBits = 16,
 		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
 		.packScanline = packScanlineIPU3,
 		.thumbScanline = thumbScanlineIPU3,
 	} },
 	{ formats::SGRBG10_IPU3, {
 		.bitsPerSample = 16,
+		.significantBits = 16,
 		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
 		.packScanline = packScanlineIPU3,
 		.thumbScanline = thumbScanlineIPU3,
 	} },
 	{ formats::SRGGB10_IPU3, {
 		.bitsPerSample = 16,
+		.significantBits = 16,
 		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
 		.packScanline = packScanlineIPU3,
 		.thumbScanline = thumbScanlineIPU3,
 	} },
+	{ formats::SBGGR10, {
+		.bitsPerSample = 16,
+		.significantBits = 10,
+		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGBRG10, {
+		.bitsPerSample = 16,
+		.significantBits = 10,
+		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGRBG10, {
+		.bitsPerSample = 16,
+		.significantBits = 10,
+		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SRGGB10, {
+		.bitsPerSample = 16,
+		.significantBits = 10,
+		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SBGGR12, {
+		.bitsPerSample = 16,
+		.significantBits = 12,
+		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGBRG12, {
+		.bitsPerSample = 16,
+		.significantBits = 12,
+		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGRBG12, {
+		.bitsPerSample = 16,
+		.significantBits = 12,
+		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SRGGB12, {
+		.bitsPerSample = 16,
+		.significantBits = 12,
+		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SBGGR14, {
+		.bitsPerSample = 16,
+		.significantBits = 14,
+		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGBRG14, {
+		.bitsPerSample = 16,
+		.significantBits = 14,
+		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGRBG14, {
+		.bitsPerSample = 16,
+		.significantBits = 14,
+		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SRGGB14, {
+		.bitsPerSample = 16,
+		.significantBits = 14,
+		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SBGGR16, {
+		.bitsPerSample = 16,
+		.significantBits = 16,
+		.pattern = { CFAPatternBlue, CFAPatternGreen, CFAPatternGreen, CFAPatternRed },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGBRG16, {
+		.bitsPerSample = 16,
+		.significantBits = 16,
+		.pattern = { CFAPatternGreen, CFAPatternBlue, CFAPatternRed, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SGRBG16, {
+		.bitsPerSample = 16,
+		.significantBits = 16,
+		.pattern = { CFAPatternGreen, CFAPatternRed, CFAPatternBlue, CFAPatternGreen },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
+	{ formats::SRGGB16, {
+		.bitsPerSample = 16,
+		.significantBits = 16,
+		.pattern = { CFAPatternRed, CFAPatternGreen, CFAPatternGreen, CFAPatternBlue },
+		.packScanline = nullptr,
+		.thumbScanline = thumbScanlineUnpacked,
+	} },
 };
 
+static int writeRawStrips(TIFF *tif, const FormatInfo &info,
+			  const StreamConfiguration &config,
+			  const uint8_t *data, uint8_t *scanline)
+{
+	const size_t lineSize = (config.size.width * info.bitsPerSample + 7) / 8;
+
+	/*
+	 * Lines that are stored as-is and contiguous in memory are written
+	 * directly from the frame buffer, in a single strip.
+	 */
+	if (!info.packScanline && config.stride == lineSize) {
+		tmsize_t size = lineSize * config.size.height;
+
+		TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, config.size.height);
+		if (TIFFWriteEncodedStrip(tif, 0, const_cast<uint8_t *>(data), size) != size) {
+			std::cerr << "Failed to write RAW strip" << std::endl;
+			return -EINVAL;
+		}
+
+		return 0;
+	}
+
+	const uint8_t *row = data;
+	for (unsigned int y = 0; y < config.size.height; y++) {
+		const uint8_t *line = row;
+		if (info.packScanline) {
+			info.packScanline(scanline, row, config.size.width);
+			line = scanline;
+		}
+
+		if (TIFFWriteScanline(tif, const_cast<uint8_t *>(line), y, 0) != 1) {
+			std::cerr << "Failed to write RAW scanline"
+				  << std::endl;
+			return -EINVAL;
+		}
+
+		row += config.stride;
+	}
+
+	return 0;
+}
+
+#ifdef HAVE_ZLIB
+/*
+ * Write the image in Deflate compressed tiles. The tiles are compressed in
+ * parallel, with one band of tiles per job, and then written sequentially as
+ * libtiff isn't thread-safe.
+ */
+static int writeRawTilesDeflate(TIFF *tif, const FormatInfo &info,
+				const StreamConfiguration &config,
+				const uint8_t *data)
+{
+	/* Tile line sizes must be byte aligned for all supported formats. */
+	constexpr unsigned int kTileSize = 256;
+
+	const unsigned int width = config.size.width;
+	const unsigned int height = config.size.height;
+	const size_t lineSize = (width * info.bitsPerSample + 7) / 8;
+	const size_t tileLineSize = kTileSize * info.bitsPerSample / 8;
+	const unsigned int tilesX = (width + kTileSize - 1) / kTileSize;
+	const unsigned int tilesY = (height + kTileSize - 1) / kTileSize;
+
+	TIFFSetField(tif, TIFFTAG_TILEWIDTH, kTileSize);
+	TIFFSetField(tif, TIFFTAG_TILELENGTH, kTileSize);
+
+	std::vector<std::vector<uint8_t>> tiles(tilesX * tilesY);
+	std::atomic<unsigned int> nextBand = 0;
+	std::atomic<bool> failed = false;
+
+	auto compressBands = [&]() {
+		std::vector<uint8_t> band(info.packScanline ? lineSize * kTileSize : 0);
+		std::vector<uint8_t> tile(tileLineSize * kTileSize);
+
+		for (unsigned int ty = nextBand++; ty < tilesY && !failed; ty = nextBand++) {
+			unsigned int rows = std::min(kTileSize, height - ty * kTileSize);
+			const uint8_t *lines = data + ty * kTileSize * config.stride;
+			size_t stride = config.stride;
+
+			if (info.packScanline) {
+				for (unsigned int y = 0; y < rows; y++)
+					info.packScanline(&band[y * lineSize],
+							  lines + y * config.stride, width);
+				lines = band.data();
+				stride = lineSize;
+			}
+
+			for (unsigned int tx = 0; tx < tilesX; tx++) {
+				size_t offset = tx * tileLineSize;
+				size_t length = std::min(tileLineSize, lineSize - offset);
+
+				/* Edge tiles are padded with zeros. */
+				std::fill(tile.begin(), tile.end(), 0);
+				for (unsigned int y = 0; y < rows; y++)
+					std::copy_n(lines + y * stride + offset, length,
+						    &tile[y * tileLineSize]);
+
+				std::vector<uint8_t> &output = tiles[ty * tilesX + tx];
+				uLongf size = compressBound(tile.size());
+				output.resize(size);
+
+				if (compress2(output.data(), &size, tile.data(),
+					      tile.size(), Z_BEST_SPEED) != Z_OK) {
+					failed = true;
+					return;
+				}
+
+				output.resize(size);
+			}
+		}
+	};
+
+	unsigned int numThreads = std::clamp(std::thread::hardware_concurrency(),
+					     1u, tilesY);
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < numThreads; i++)
+		threads.emplace_back(compressBands);
+
+	compressBands();
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	if (failed) {
+		std::cerr << "Failed to compress RAW tiles" << std::endl;
+		return -EINVAL;
+	}
+
+	for (unsigned int i = 0; i < tiles.size(); i++) {
+		tmsize_t size = tiles[i].size();
+		if (TIFFWriteRawTile(tif, i, tiles[i].data(), size) != size) {
+			std::cerr << "Failed to write RAW tile" << std::endl;
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+#endif /* HAVE_ZLIB */
+
 int DNGWriter::write(const char *filename, const Camera *camera,
 		     const StreamConfiguration &config,
 		     const ControlList &metadata,
 		     [[maybe_unused]] const FrameBuffer *buffer,
-		     const void *data)
+		     const void *data, Compression compression)
 {
 	const ControlList &cameraProperties = camera->properties();
 
@@ -396,6 +694,13 @@ int DNGWriter::write(const char *filename, const Camera *camera,
 	}
 	const FormatInfo *info = &it->second;
 
+#ifndef HAVE_ZLIB
+	if (compression == Compression::Deflate) {
+		std::cerr << "Deflate compression not supported" << std::endl;
+		return -ENOTSUP;
+	}
+#endif
+
 	TIFF *tif = TIFFOpen(filename, "w");
 	if (!tif) {
 		std::cerr << "Failed to open tiff file" << std::endl;
@@ -534,7 +839,9 @@ int DNGWriter::write(const char *filename, const Camera *camera,
 	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, config.size.width);
 	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, config.size.height);
 	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, info->bitsPerSample);
-	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+	TIFFSetField(tif, TIFFTAG_COMPRESSION,
+		     compression == Compression::Deflate ? COMPRESSION_ADOBE_DEFLATE
+							 : COMPRESSION_NONE);
 	TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_CFA);
 	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
 	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
@@ -549,7 +856,7 @@ int DNGWriter::write(const char *filename, const Camera *camera,
 
 	const uint16_t blackLevelRepeatDim[] = { 2, 2 };
 	float blackLevel[] = { 0.0f, 0.0f, 0.0f, 0.0f };
-	uint32_t whiteLevel = (1 << info->bitsPerSample) - 1;
+	uint32_t whiteLevel = (1 << info->significantBits) - 1;
 
 	const auto &blackLevels = metadata.get(controls::SensorBlackLevels);
 	if (blackLevels) {
@@ -582,7 +889,7 @@ int DNGWriter::write(const char *filename, const Camera *camera,
 			}
 
 			/* Map the 16-bit value to the bits per sample range. */
-			blackLevel[i] = level >> (16 - info->bitsPerSample);
+			blackLevel[i] = level >> (16 - info->significantBits);
 		}
 	}
 
@@ -591,18 +898,18 @@ int DNGWriter::write(const char *filename, const Camera *camera,
 	TIFFSetField(tif, TIFFTAG_WHITELEVEL, 1, &whiteLevel);
 
 	/* Write RAW content. */
-	row = static_cast<const uint8_t *>(data);
-	for (unsigned int y = 0; y < config.size.height; y++) {
-		info->packScanline(&scanline, row, config.size.width);
-
-		if (TIFFWriteScanline(tif, &scanline, y, 0) != 1) {
-			std::cerr << "Failed to write RAW scanline"
-				  << std::endl;
-			TIFFClose(tif);
-			return -EINVAL;
-		}
-
-		row += config.stride;
+	int ret;
+#ifdef HAVE_ZLIB
+	if (compression == Compression::Deflate)
+		ret = writeRawTilesDeflate(tif, *info, config,
+					   static_cast<const uint8_t *>(data));
+	else
+#endif
+		ret = writeRawStrips(tif, *info, config,
+				     static_cast<const uint8_t *>(data), scanline);
+	if (ret < 0) {
+		TIFFClose(tif);
+		return ret;
 	}
 
 	/* Checkpoint the IFD to retrieve its offset, and write it out. */
@@ -42,7 +42,7 @@ void Capture::configure(StreamRole role)
 	}
 }
 
-void Capture::start()
+void Capture::start(const ControlList *controls)
 {
 	Stream *stream = config_->at(0).stream();
 	int count = allocator_->allocate(stream);
@@ -52,7 +52,7 @@ void Capture::start()
 
 	camera_->requestCompleted.connect(this, &Capture::requestComplete);
 
-	ASSERT_EQ(camera_->start(), 0) << "Failed to start camera";
+	ASSERT_EQ(camera_->start(controls), 0) << "Failed to start camera";
 }
 
 void Capture::stop()
@@ -141,6 +141,134 @@ void CaptureBalanced::requestComplete(Request *request)
 		loop_->exit(-EINVAL);
 }
 
+/* CapturePerformance */
+
+CapturePerformance::CapturePerformance(std::shared_ptr<Camera> camera)
+	: Capture(camera), importBuffers_(false)
+{
+}
+
+void CapturePerformance::capture(unsigned int numRequests,
+				 const ControlList *controls, bool importBuffers)
+{
+	using clock = std::chrono::steady_clock;
+
+	importBuffers_ = importBuffers;
+	captureCount_ = 0;
+	captureLimit_ = numRequests;
+	firstFrameTime_ = Duration::zero();
+	importTime_ = Duration::zero();
+	frames_.clear();
+	frames_.reserve(numRequests);
+
+	startPoint_ = clock::now();
+	start(controls);
+	startTime_ = clock::now() - startPoint_;
+
+	Stream *stream = config_->at(0).stream();
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers = allocator_->buffers(stream);
+
+	/* Queue the recommended number of requests. */
+	for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+		std::unique_ptr<Request> request = camera_->createRequest();
+		ASSERT_TRUE(request) << "Can't create request";
+
+		ASSERT_EQ(request->addBuffer(stream, buffer.get()), 0) << "Can't set buffer for request";
+
+		ASSERT_EQ(camera_->queueRequest(request.get()), 0) << "Failed to queue request";
+
+		requests_.push_back(std::move(request));
+	}
+
+	/*
+	 * Run capture session. Requests are requeued until the camera is
+	 * stopped, to measure the stop latency with requests in flight.
+	 */
+	loop_ = new EventLoop();
+	int status = loop_->exec();
+
+	clock::time_point stopPoint = clock::now();
+	stop();
+	stopTime_ = clock::now() - stopPoint;
+
+	imported_.clear();
+	delete loop_;
+
+	ASSERT_EQ(status, 0);
+	ASSERT_EQ(captureCount_, captureLimit_);
+}
+
+/*
+ * Replace the buffer of the request with a new FrameBuffer that references
+ * duplicated file descriptors of the same memory, as an application importing
+ * buffers from another device would do. This defeats the caching of buffer
+ * mappings in the pipeline handler, which has to import the buffer again.
+ */
+int CapturePerformance::importBuffer(Request *request)
+{
+	const Stream *stream = request->buffers().begin()->first;
+	const FrameBuffer *buffer = request->buffers().begin()->second;
+
+	std::vector<FrameBuffer::Plane> planes;
+	for (const FrameBuffer::Plane &plane : buffer->planes()) {
+		FrameBuffer::Plane dup = plane;
+		dup.fd = SharedFD(plane.fd.get());
+		planes.push_back(std::move(dup));
+	}
+
+	std::unique_ptr<FrameBuffer> imported = std::make_unique<FrameBuffer>(planes);
+
+	request->reuse();
+
+	int ret = request->addBuffer(stream, imported.get());
+	if (ret)
+		return ret;
+
+	imported_[request] = std::move(imported);
+
+	return 0;
+}
+
+void CapturePerformance::requestComplete(Request *request)
+{
+	using clock = std::chrono::steady_clock;
+
+	/* Ignore the requests completed or cancelled after the limit. */
+	if (captureCount_ >= captureLimit_)
+		return;
+
+	EXPECT_EQ(request->status(), Request::Status::RequestComplete)
+		<< "Request didn't complete successfully";
+
+	if (!captureCount_)
+		firstFrameTime_ = clock::now() - startPoint_;
+
+	const FrameMetadata &metadata = request->buffers().begin()->second->metadata();
+	frames_.push_back({ metadata.sequence, metadata.timestamp });
+
+	captureCount_++;
+	if (captureCount_ >= captureLimit_) {
+		loop_->exit(0);
+		return;
+	}
+
+	if (importBuffers_) {
+		clock::time_point begin = clock::now();
+		int ret = importBuffer(request);
+		if (!ret)
+			ret = camera_->queueRequest(request);
+		importTime_ += clock::now() - begin;
+
+		if (ret)
+			loop_->exit(ret);
+		return;
+	}
+
+	request->reuse(Request::ReuseBuffers);
+	if (camera_->queueRequest(request))
+		loop_->exit(-EINVAL);
+}
+
 /* CaptureUnbalanced */
 
 CaptureUnbalanced::CaptureUnbalanced(std::shared_ptr<Camera> camera)
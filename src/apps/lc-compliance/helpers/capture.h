@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <map>
 #include <memory>
+#include <stdint.h>
+#include <vector>
 
 #include <libcamera/libcamera.h>
 
@@ -22,7 +26,7 @@ protected:
 	Capture(std::shared_ptr<libcamera::Camera> camera);
 	virtual ~Capture();
 
-	void start();
+	void start(const libcamera::ControlList *controls = nullptr);
 	void stop();
 
 	virtual void requestComplete(libcamera::Request *request) = 0;
@@ -51,6 +55,46 @@ private:
 	unsigned int captureLimit_;
 };
 
+class CapturePerformance : public Capture
+{
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	struct Frame {
+		unsigned int sequence;
+		uint64_t timestamp;
+	};
+
+	CapturePerformance(std::shared_ptr<libcamera::Camera> camera);
+
+	void capture(unsigned int numRequests,
+		     const libcamera::ControlList *controls = nullptr,
+		     bool importBuffers = false);
+
+	const std::vector<Frame> &frames() const { return frames_; }
+	Duration startTime() const { return startTime_; }
+	Duration firstFrameTime() const { return firstFrameTime_; }
+	Duration stopTime() const { return stopTime_; }
+	Duration importTime() const { return importTime_; }
+
+private:
+	void requestComplete(libcamera::Request *request) override;
+	int importBuffer(libcamera::Request *request);
+
+	bool importBuffers_;
+	unsigned int captureCount_;
+	unsigned int captureLimit_;
+
+	std::chrono::steady_clock::time_point startPoint_;
+	Duration startTime_;
+	Duration firstFrameTime_;
+	Duration stopTime_;
+	Duration importTime_;
+
+	std::vector<Frame> frames_;
+	std::map<libcamera::Request *, std::unique_ptr<libcamera::FrameBuffer>> imported_;
+};
+
 class CaptureUnbalanced : public Capture
 {
 public:
@@ -0,0 +1,321 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Test camera capture performance
+ */
+
+#include "capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+#include "environment.h"
+
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+namespace {
+
+/*
+ * Performance limits that a camera has to meet to pass the tests. The
+ * measured values are also recorded as test properties, and are written to
+ * the machine-readable report produced with GTEST_OUTPUT=json:<file> or
+ * GTEST_OUTPUT=xml:<file>.
+ */
+
+/* Minimum sustained frame rate, relative to the fastest rate it reports */
+constexpr double kMinFrameRateRatio = 0.95;
+
+/* Maximum standard deviation of the frame interval, relative to its mean */
+constexpr double kMaxJitterRatio = 0.10;
+
+/* Maximum time to configure the camera */
+constexpr auto kMaxConfigureTime = 500ms;
+
+/* Maximum time from the start of the camera to the first completed frame */
+constexpr auto kMaxFirstFrameTime = 1000ms;
+
+/* Maximum time to stop the camera with requests in flight */
+constexpr auto kMaxStopTime = 500ms;
+
+/* Frames captured for each measurement, and initial frames ignored */
+constexpr unsigned int kNumFrames = 120;
+constexpr unsigned int kNumWarmupFrames = 10;
+
+const std::vector<StreamRole> ROLES = {
+	StreamRole::Raw,
+	StreamRole::StillCapture,
+	StreamRole::VideoRecording,
+	StreamRole::Viewfinder
+};
+
+double toMilliseconds(CapturePerformance::Duration duration)
+{
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+struct IntervalStats {
+	double mean;
+	double stddev;
+	unsigned int dropped;
+};
+
+/* Compute the frame interval statistics in microseconds, after the warmup. */
+IntervalStats frameIntervals(const std::vector<CapturePerformance::Frame> &frames)
+{
+	IntervalStats stats = {};
+	std::vector<double> intervals;
+
+	for (unsigned int i = kNumWarmupFrames + 1; i < frames.size(); ++i) {
+		const CapturePerformance::Frame &prev = frames[i - 1];
+		const CapturePerformance::Frame &frame = frames[i];
+
+		/*
+		 * Normalize the interval by the sequence number difference, to
+		 * account the dropped frames separately from the jitter.
+		 */
+		unsigned int delta = std::max(frame.sequence - prev.sequence, 1U);
+		stats.dropped += delta - 1;
+		intervals.push_back((frame.timestamp - prev.timestamp) / 1000.0 / delta);
+	}
+
+	if (intervals.empty())
+		return stats;
+
+	stats.mean = std::accumulate(intervals.begin(), intervals.end(), 0.0) /
+		     intervals.size();
+
+	double variance = 0.0;
+	for (double interval : intervals)
+		variance += (interval - stats.mean) * (interval - stats.mean);
+	stats.stddev = std::sqrt(variance / intervals.size());
+
+	return stats;
+}
+
+} /* namespace */
+
+class Performance : public testing::TestWithParam<StreamRole>
+{
+public:
+	static std::string nameParameters(const testing::TestParamInfo<Performance::ParamType> &info);
+
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	void configure(CapturePerformance &capture);
+	void checkFrameRate(const CapturePerformance &capture);
+
+	std::shared_ptr<Camera> camera_;
+	std::unique_ptr<ControlList> controls_;
+	int64_t minFrameDuration_;
+};
+
+void Performance::SetUp()
+{
+	Environment *env = Environment::get();
+
+	camera_ = env->cm()->get(env->cameraId());
+	minFrameDuration_ = 0;
+
+	ASSERT_EQ(camera_->acquire(), 0);
+}
+
+void Performance::TearDown()
+{
+	if (!camera_)
+		return;
+
+	camera_->release();
+	camera_.reset();
+}
+
+std::string Performance::nameParameters(const testing::TestParamInfo<Performance::ParamType> &info)
+{
+	std::map<StreamRole, std::string> rolesMap = {
+		{ StreamRole::Raw, "Raw" },
+		{ StreamRole::StillCapture, "StillCapture" },
+		{ StreamRole::VideoRecording, "VideoRecording" },
+		{ StreamRole::Viewfinder, "Viewfinder" }
+	};
+
+	return rolesMap[info.param];
+}
+
+/*
+ * Configure the camera and request its fastest frame rate, based on the
+ * FrameDurationLimits reported for the configuration.
+ */
+void Performance::configure(CapturePerformance &capture)
+{
+	capture.configure(GetParam());
+
+	controls_ = std::make_unique<ControlList>(controls::controls);
+
+	const ControlInfoMap &info = camera_->controls();
+	auto limits = info.find(&controls::FrameDurationLimits);
+	if (limits == info.end())
+		return;
+
+	minFrameDuration_ = limits->second.min().get<int64_t>();
+	if (minFrameDuration_ <= 0)
+		return;
+
+	controls_->set(controls::FrameDurationLimits,
+		       { minFrameDuration_, minFrameDuration_ });
+}
+
+void Performance::checkFrameRate(const CapturePerformance &capture)
+{
+	IntervalStats stats = frameIntervals(capture.frames());
+	ASSERT_GT(stats.mean, 0.0) << "Not enough frames to measure the frame rate";
+
+	double frameRate = 1000000.0 / stats.mean;
+	double jitter = stats.stddev / stats.mean;
+
+	RecordProperty("frame_rate", std::to_string(frameRate));
+	RecordProperty("frame_interval_stddev_us", std::to_string(stats.stddev));
+	RecordProperty("dropped_frames", stats.dropped);
+
+	std::cout << "Frame rate " << frameRate << " fps, interval jitter "
+		  << stats.stddev << " us, " << stats.dropped
+		  << " dropped frames" << std::endl;
+
+	EXPECT_EQ(stats.dropped, 0U) << "Frames dropped during sustained capture";
+	EXPECT_LE(jitter, kMaxJitterRatio)
+		<< "Frame interval jitter of " << stats.stddev << " us too high";
+
+	if (!minFrameDuration_) {
+		std::cout << "FrameDurationLimits not supported, frame rate not checked"
+			  << std::endl;
+		return;
+	}
+
+	double maxFrameRate = 1000000.0 / minFrameDuration_;
+	RecordProperty("max_frame_rate", std::to_string(maxFrameRate));
+
+	EXPECT_GE(frameRate, maxFrameRate * kMinFrameRateRatio)
+		<< "Sustained frame rate lower than the "
+		<< maxFrameRate << " fps reported by FrameDurationLimits";
+}
+
+/*
+ * Test sustained frame rate and jitter
+ *
+ * Captures continuously at the fastest frame rate reported by the camera, and
+ * makes sure the camera sustains that rate without dropping frames and with a
+ * regular frame interval. Example failure is a pipeline handler that can't
+ * keep up with the sensor and skips frames.
+ */
+TEST_P(Performance, FrameRate)
+{
+	CapturePerformance capture(camera_);
+
+	configure(capture);
+
+	capture.capture(kNumFrames, controls_.get());
+
+	checkFrameRate(capture);
+}
+
+/*
+ * Test configuration latency
+ *
+ * Makes sure generating, validating and applying a configuration completes
+ * in bounded time. Example failure is a pipeline handler that performs slow
+ * hardware probing for every configuration.
+ */
+TEST_P(Performance, ConfigureLatency)
+{
+	using clock = std::chrono::steady_clock;
+
+	CapturePerformance capture(camera_);
+
+	clock::time_point begin = clock::now();
+	capture.configure(GetParam());
+	CapturePerformance::Duration duration = clock::now() - begin;
+
+	RecordProperty("configure_time_ms", std::to_string(toMilliseconds(duration)));
+	std::cout << "Configured in " << toMilliseconds(duration) << " ms" << std::endl;
+
+	EXPECT_LE(duration, kMaxConfigureTime) << "Configuration too slow";
+}
+
+/*
+ * Test start and stop latency
+ *
+ * Measures the time from starting the camera to the completion of the first
+ * frame, and the time to stop the camera with requests still queued, over
+ * several start/stop cycles. Example failure is a camera that waits for a
+ * timeout on stop instead of cancelling the pending requests.
+ */
+TEST_P(Performance, StartStopLatency)
+{
+	constexpr unsigned int numRepeats = 3;
+
+	CapturePerformance capture(camera_);
+
+	configure(capture);
+
+	CapturePerformance::Duration maxStart{}, maxFirstFrame{}, maxStop{};
+
+	for (unsigned int i = 0; i < numRepeats; i++) {
+		capture.capture(kNumWarmupFrames, controls_.get());
+
+		maxStart = std::max(maxStart, capture.startTime());
+		maxFirstFrame = std::max(maxFirstFrame, capture.firstFrameTime());
+		maxStop = std::max(maxStop, capture.stopTime());
+	}
+
+	RecordProperty("start_time_ms", std::to_string(toMilliseconds(maxStart)));
+	RecordProperty("first_frame_time_ms", std::to_string(toMilliseconds(maxFirstFrame)));
+	RecordProperty("stop_time_ms", std::to_string(toMilliseconds(maxStop)));
+
+	std::cout << "Started in " << toMilliseconds(maxStart)
+		  << " ms, first frame after " << toMilliseconds(maxFirstFrame)
+		  << " ms, stopped in " << toMilliseconds(maxStop) << " ms"
+		  << std::endl;
+
+	EXPECT_LE(maxFirstFrame, kMaxFirstFrameTime) << "First frame too late";
+	EXPECT_LE(maxStop, kMaxStopTime) << "Stop too slow";
+}
+
+/*
+ * Test buffer import throughput
+ *
+ * Queues a newly imported buffer with every request instead of reusing the
+ * buffers known to the camera, and makes sure the frame rate is sustained.
+ * Example failure is a pipeline handler that performs costly mapping or
+ * cache maintenance for every new buffer.
+ */
+TEST_P(Performance, BufferImport)
+{
+	CapturePerformance capture(camera_);
+
+	configure(capture);
+
+	capture.capture(kNumFrames, controls_.get(), true);
+
+	unsigned int imports = capture.frames().size() - 1;
+	double importTime = toMilliseconds(capture.importTime());
+	if (importTime > 0.0) {
+		double rate = imports / importTime * 1000.0;
+		RecordProperty("import_rate", std::to_string(rate));
+		std::cout << imports << " buffers imported at " << rate
+			  << " buffers/s" << std::endl;
+	}
+
+	checkFrameRate(capture);
+}
+
+INSTANTIATE_TEST_SUITE_P(PerformanceTests,
+			 Performance,
+			 testing::ValuesIn(ROLES),
+			 Performance::nameParameters);
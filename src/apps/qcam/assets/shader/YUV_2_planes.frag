@@ -9,6 +9,17 @@
 precision mediump float;
 #endif
 
+/*
+ * The second chroma component is stored in the alpha channel of the
+ * GL_LUMINANCE_ALPHA texture used for uploads, and in the green channel of
+ * the GR88 texture used for dma-buf imports.
+ */
+#if defined(TEX_CHROMA_RG)
+#define CHROMA_2 g
+#else
+#define CHROMA_2 a
+#endif
+
 varying vec2 textureOut;
 uniform sampler2D tex_y;
 uniform sampler2D tex_u;
@@ -28,9 +39,9 @@ void main(void)
 	yuv.x = texture2D(tex_y, textureOut).r;
 #if defined(YUV_PATTERN_UV)
 	yuv.y = texture2D(tex_u, textureOut).r;
-	yuv.z = texture2D(tex_u, textureOut).a;
+	yuv.z = texture2D(tex_u, textureOut).CHROMA_2;
 #elif defined(YUV_PATTERN_VU)
-	yuv.y = texture2D(tex_u, textureOut).a;
+	yuv.y = texture2D(tex_u, textureOut).CHROMA_2;
 	yuv.z = texture2D(tex_u, textureOut).r;
 #else
 #error Invalid pattern
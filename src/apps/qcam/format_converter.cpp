@@ -7,8 +7,13 @@
 
 #include "format_converter.h"
 
+#include <algorithm>
 #include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
 #include <utility>
+#include <vector>
 
 #include <QImage>
 
@@ -212,21 +217,162 @@ static void yuv_to_rgb(int y, int u, int v, int *r, int *g, int *b)
 	*b = CLIP(( 298 * c + 516 * d           + 128) >> RGBSHIFT);
 }
 
-void FormatConverter::convertRGB(const Image *srcImage, unsigned char *dst)
+/*
+ * The YUV conversions first unpack each line to full resolution Y, Cb and Cr
+ * samples, and then convert them to BGRA with a kernel written with the
+ * compiler vector extensions, which are lowered to the SIMD instructions of
+ * the target. Lines are distributed to multiple threads.
+ */
+
+/* Number of pixels processed in one go by the vectorized kernel */
+static constexpr unsigned int kSimdLanes = 8;
+
+/* Minimum number of lines converted by a thread */
+static constexpr unsigned int kMinLinesPerThread = 32;
+
+/*
+ * The kernel computes with 16-bit lanes, which fill 128-bit SIMD registers
+ * and can be multiplied natively on all architectures. The yuv_to_rgb()
+ * coefficients are split into a multiple of 256 and a remainder, to keep the
+ * intermediate values within 16 bits while producing identical results:
+ *
+ * r = c + e      + ((42 * c           + 153 * e + 128) >> 8)
+ * g = c - e      + ((42 * c - 100 * d +  48 * e + 128) >> 8)
+ * b = c + 2 * d  + ((42 * c +   4 * d           + 128) >> 8)
+ */
+using SimdVec8 = uint8_t __attribute__((vector_size(kSimdLanes)));
+using SimdVec = int16_t __attribute__((vector_size(kSimdLanes * sizeof(int16_t))));
+using SimdHalf = uint16_t __attribute__((vector_size(kSimdLanes / 2 * sizeof(uint16_t))));
+using SimdPixels = uint32_t __attribute__((vector_size(kSimdLanes / 2 * sizeof(uint32_t))));
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_convertvector)
+#define FORMAT_CONVERTER_HAVE_CONVERTVECTOR 1
+#endif
+#endif
+
+static inline SimdVec simdLoad(const unsigned char *src)
 {
-	const unsigned char *src = srcImage->data(0).data();
-	unsigned int x, y;
-	int r, g, b;
-
-	for (y = 0; y < height_; y++) {
-		for (x = 0; x < width_; x++) {
-			r = src[bpp_ * x + r_pos_];
-			g = src[bpp_ * x + g_pos_];
-			b = src[bpp_ * x + b_pos_];
-
-			dst[4 * x + 0] = b;
-			dst[4 * x + 1] = g;
-			dst[4 * x + 2] = r;
+	SimdVec8 v8;
+	memcpy(&v8, src, sizeof(v8));
+
+#if FORMAT_CONVERTER_HAVE_CONVERTVECTOR
+	return __builtin_convertvector(v8, SimdVec);
+#else
+	SimdVec v;
+	for (unsigned int i = 0; i < kSimdLanes; i++)
+		v[i] = v8[i];
+	return v;
+#endif
+}
+
+static inline SimdVec simdClip(SimdVec v)
+{
+	v &= v > 0;
+
+	SimdVec over = v > 255;
+	return (v & ~over) | (over & 255);
+}
+
+/*
+ * Store the 16-bit B | G << 8 and R | A << 8 lanes as native-endian
+ * 0xAARRGGBB pixels.
+ */
+static inline void simdStore(unsigned char *dst, SimdVec bg, SimdVec ra)
+{
+	SimdHalf bgHalves[2];
+	SimdHalf raHalves[2];
+	memcpy(bgHalves, &bg, sizeof(bgHalves));
+	memcpy(raHalves, &ra, sizeof(raHalves));
+
+	for (unsigned int i = 0; i < 2; i++) {
+#if FORMAT_CONVERTER_HAVE_CONVERTVECTOR
+		SimdPixels pixels = __builtin_convertvector(bgHalves[i], SimdPixels) |
+				    __builtin_convertvector(raHalves[i], SimdPixels) << 16;
+#else
+		SimdPixels pixels;
+		for (unsigned int j = 0; j < kSimdLanes / 2; j++)
+			pixels[j] = bgHalves[i][j] | raHalves[i][j] << 16;
+#endif
+
+		memcpy(dst, &pixels, sizeof(pixels));
+		dst += sizeof(pixels);
+	}
+}
+
+static void yuv_line_to_bgra(const unsigned char *src_y,
+			     const unsigned char *src_cb,
+			     const unsigned char *src_cr,
+			     unsigned char *dst, unsigned int width)
+{
+	unsigned int x = 0;
+
+	for (; x + kSimdLanes <= width; x += kSimdLanes) {
+		SimdVec c = simdLoad(src_y + x) - 16;
+		SimdVec d = simdLoad(src_cb + x) - 128;
+		SimdVec e = simdLoad(src_cr + x) - 128;
+		SimdVec c42 = 42 * c + 128;
+
+		SimdVec r = simdClip(c + e     + ((c42           + 153 * e) >> RGBSHIFT));
+		SimdVec g = simdClip(c - e     + ((c42 - 100 * d +  48 * e) >> RGBSHIFT));
+		SimdVec b = simdClip(c + 2 * d + ((c42 +   4 * d)           >> RGBSHIFT));
+
+		simdStore(dst, b | (g << 8), r | static_cast<int16_t>(0xff00));
+		dst += kSimdLanes * 4;
+	}
+
+	for (; x < width; x++) {
+		int r, g, b;
+
+		yuv_to_rgb(src_y[x], src_cb[x], src_cr[x], &r, &g, &b);
+		dst[0] = b;
+		dst[1] = g;
+		dst[2] = r;
+		dst[3] = 0xff;
+		dst += 4;
+	}
+}
+
+/*
+ * Call func(begin, end) for consecutive ranges of lines covering the whole
+ * image, in parallel.
+ */
+template<typename Func>
+void FormatConverter::processLines(Func func)
+{
+	unsigned int numThreads =
+		std::clamp(std::thread::hardware_concurrency(), 1U,
+			   std::max(height_ / kMinLinesPerThread, 1U));
+	unsigned int linesPerThread = (height_ + numThreads - 1) / numThreads;
+
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < numThreads; i++) {
+		unsigned int begin = i * linesPerThread;
+		unsigned int end = std::min(begin + linesPerThread, height_);
+
+		if (begin < end)
+			threads.emplace_back(func, begin, end);
+	}
+
+	func(0, std::min(linesPerThread, height_));
+
+	for (std::thread &thread : threads)
+		thread.join();
+}
+
+template<unsigned int bpp>
+void FormatConverter::convertRGBLines(const unsigned char *src,
+				      unsigned char *dst,
+				      unsigned int begin, unsigned int end)
+{
+	src += begin * stride_;
+	dst += begin * width_ * 4;
+
+	for (unsigned int y = begin; y < end; y++) {
+		for (unsigned int x = 0; x < width_; x++) {
+			dst[4 * x + 0] = src[bpp * x + b_pos_];
+			dst[4 * x + 1] = src[bpp * x + g_pos_];
+			dst[4 * x + 2] = src[bpp * x + r_pos_];
 			dst[4 * x + 3] = 0xff;
 		}
 
@@ -235,125 +381,123 @@ void FormatConverter::convertRGB(const Image *srcImage, unsigned char *dst)
 	}
 }
 
+void FormatConverter::convertRGB(const Image *srcImage, unsigned char *dst)
+{
+	const unsigned char *src = srcImage->data(0).data();
+
+	/* Specialize the line conversion for each pixel size. */
+	processLines([&](unsigned int begin, unsigned int end) {
+		switch (bpp_) {
+		case 1:
+			convertRGBLines<1>(src, dst, begin, end);
+			break;
+		case 3:
+			convertRGBLines<3>(src, dst, begin, end);
+			break;
+		case 4:
+			convertRGBLines<4>(src, dst, begin, end);
+			break;
+		}
+	});
+}
+
 void FormatConverter::convertYUVPacked(const Image *srcImage, unsigned char *dst)
 {
 	const unsigned char *src = srcImage->data(0).data();
-	unsigned int src_x, src_y, dst_x, dst_y;
-	unsigned int src_stride;
-	unsigned int dst_stride;
-	unsigned int cr_pos;
-	int r, g, b, y, cr, cb;
-
-	cr_pos = (cb_pos_ + 2) % 4;
-	src_stride = stride_;
-	dst_stride = width_ * 4;
-
-	for (src_y = 0, dst_y = 0; dst_y < height_; src_y++, dst_y++) {
-		for (src_x = 0, dst_x = 0; dst_x < width_; ) {
-			cb = src[src_y * src_stride + src_x * 4 + cb_pos_];
-			cr = src[src_y * src_stride + src_x * 4 + cr_pos];
-
-			y = src[src_y * src_stride + src_x * 4 + y_pos_];
-			yuv_to_rgb(y, cb, cr, &r, &g, &b);
-			dst[dst_y * dst_stride + 4 * dst_x + 0] = b;
-			dst[dst_y * dst_stride + 4 * dst_x + 1] = g;
-			dst[dst_y * dst_stride + 4 * dst_x + 2] = r;
-			dst[dst_y * dst_stride + 4 * dst_x + 3] = 0xff;
-			dst_x++;
-
-			y = src[src_y * src_stride + src_x * 4 + y_pos_ + 2];
-			yuv_to_rgb(y, cb, cr, &r, &g, &b);
-			dst[dst_y * dst_stride + 4 * dst_x + 0] = b;
-			dst[dst_y * dst_stride + 4 * dst_x + 1] = g;
-			dst[dst_y * dst_stride + 4 * dst_x + 2] = r;
-			dst[dst_y * dst_stride + 4 * dst_x + 3] = 0xff;
-			dst_x++;
-
-			src_x++;
+	unsigned int cr_pos = (cb_pos_ + 2) % 4;
+
+	processLines([&](unsigned int begin, unsigned int end) {
+		/* Round the width up to process pairs of pixels. */
+		unsigned int width = (width_ + 1) & ~1U;
+		std::vector<unsigned char> line(width * 3);
+		unsigned char *line_y = line.data();
+		unsigned char *line_cb = line_y + width;
+		unsigned char *line_cr = line_cb + width;
+
+		for (unsigned int y = begin; y < end; y++) {
+			const unsigned char *src_line = src + y * stride_;
+
+			for (unsigned int x = 0; x < width; x += 2) {
+				const unsigned char *pair = src_line + x * 2;
+
+				line_y[x] = pair[y_pos_];
+				line_y[x + 1] = pair[y_pos_ + 2];
+				line_cb[x] = line_cb[x + 1] = pair[cb_pos_];
+				line_cr[x] = line_cr[x + 1] = pair[cr_pos];
+			}
+
+			yuv_line_to_bgra(line_y, line_cb, line_cr,
+					 dst + y * width_ * 4, width_);
 		}
-	}
+	});
 }
 
 void FormatConverter::convertYUVPlanar(const Image *srcImage, unsigned char *dst)
 {
 	unsigned int c_stride = stride_ / horzSubSample_;
-	unsigned int c_inc = horzSubSample_ == 1 ? 1 : 0;
 	const unsigned char *src_y = srcImage->data(0).data();
 	const unsigned char *src_cb = srcImage->data(1).data();
 	const unsigned char *src_cr = srcImage->data(2).data();
-	int r, g, b;
 
 	if (nvSwap_)
 		std::swap(src_cb, src_cr);
 
-	for (unsigned int y = 0; y < height_; y++) {
-		const unsigned char *line_y = src_y + y * stride_;
-		const unsigned char *line_cb = src_cb + (y / vertSubSample_) *
-					       c_stride;
-		const unsigned char *line_cr = src_cr + (y / vertSubSample_) *
-					       c_stride;
-
-		for (unsigned int x = 0; x < width_; x += 2) {
-			yuv_to_rgb(*line_y, *line_cb, *line_cr, &r, &g, &b);
-			dst[0] = b;
-			dst[1] = g;
-			dst[2] = r;
-			dst[3] = 0xff;
-			line_y++;
-			line_cb += c_inc;
-			line_cr += c_inc;
-			dst += 4;
-
-			yuv_to_rgb(*line_y, *line_cb, *line_cr, &r, &g, &b);
-			dst[0] = b;
-			dst[1] = g;
-			dst[2] = r;
-			dst[3] = 0xff;
-			line_y++;
-			line_cb += 1;
-			line_cr += 1;
-			dst += 4;
+	processLines([&](unsigned int begin, unsigned int end) {
+		std::vector<unsigned char> line(width_ * 2);
+		unsigned char *up_cb = line.data();
+		unsigned char *up_cr = up_cb + width_;
+
+		for (unsigned int y = begin; y < end; y++) {
+			const unsigned char *line_cb = src_cb + (y / vertSubSample_) * c_stride;
+			const unsigned char *line_cr = src_cr + (y / vertSubSample_) * c_stride;
+
+			/* Upsample the chroma lines horizontally if needed. */
+			if (horzSubSample_ == 2) {
+				for (unsigned int x = 0; x < width_; x++) {
+					up_cb[x] = line_cb[x / 2];
+					up_cr[x] = line_cr[x / 2];
+				}
+
+				line_cb = up_cb;
+				line_cr = up_cr;
+			}
+
+			yuv_line_to_bgra(src_y + y * stride_, line_cb, line_cr,
+					 dst + y * width_ * 4, width_);
 		}
-	}
+	});
 }
 
 void FormatConverter::convertYUVSemiPlanar(const Image *srcImage, unsigned char *dst)
 {
 	unsigned int c_stride = stride_ * (2 / horzSubSample_);
-	unsigned int c_inc = horzSubSample_ == 1 ? 2 : 0;
 	unsigned int cb_pos = nvSwap_ ? 1 : 0;
 	unsigned int cr_pos = nvSwap_ ? 0 : 1;
-	const unsigned char *src = srcImage->data(0).data();
+	const unsigned char *src_y = srcImage->data(0).data();
 	const unsigned char *src_c = srcImage->data(1).data();
-	int r, g, b;
-
-	for (unsigned int y = 0; y < height_; y++) {
-		const unsigned char *src_y = src + y * stride_;
-		const unsigned char *src_cb = src_c + (y / vertSubSample_) *
-					      c_stride + cb_pos;
-		const unsigned char *src_cr = src_c + (y / vertSubSample_) *
-					      c_stride + cr_pos;
-
-		for (unsigned int x = 0; x < width_; x += 2) {
-			yuv_to_rgb(*src_y, *src_cb, *src_cr, &r, &g, &b);
-			dst[0] = b;
-			dst[1] = g;
-			dst[2] = r;
-			dst[3] = 0xff;
-			src_y++;
-			src_cb += c_inc;
-			src_cr += c_inc;
-			dst += 4;
-
-			yuv_to_rgb(*src_y, *src_cb, *src_cr, &r, &g, &b);
-			dst[0] = b;
-			dst[1] = g;
-			dst[2] = r;
-			dst[3] = 0xff;
-			src_y++;
-			src_cb += 2;
-			src_cr += 2;
-			dst += 4;
+
+	processLines([&](unsigned int begin, unsigned int end) {
+		std::vector<unsigned char> line(width_ * 2);
+		unsigned char *line_cb = line.data();
+		unsigned char *line_cr = line_cb + width_;
+
+		for (unsigned int y = begin; y < end; y++) {
+			const unsigned char *c_line = src_c + (y / vertSubSample_) * c_stride;
+
+			if (horzSubSample_ == 2) {
+				for (unsigned int x = 0; x < width_; x++) {
+					line_cb[x] = c_line[(x & ~1U) + cb_pos];
+					line_cr[x] = c_line[(x & ~1U) + cr_pos];
+				}
+			} else {
+				for (unsigned int x = 0; x < width_; x++) {
+					line_cb[x] = c_line[x * 2 + cb_pos];
+					line_cr[x] = c_line[x * 2 + cr_pos];
+				}
+			}
+
+			yuv_line_to_bgra(src_y + y * stride_, line_cb, line_cr,
+					 dst + y * width_ * 4, width_);
 		}
-	}
+	});
 }
@@ -33,6 +33,13 @@ private:
 		YUVSemiPlanar,
 	};
 
+	template<typename Func>
+	void processLines(Func func);
+
+	template<unsigned int bpp>
+	void convertRGBLines(const unsigned char *src, unsigned char *dst,
+			     unsigned int begin, unsigned int end);
+
 	void convertRGB(const Image *src, unsigned char *dst);
 	void convertYUVPacked(const Image *src, unsigned char *dst);
 	void convertYUVPlanar(const Image *src, unsigned char *dst);
@@ -8,12 +8,30 @@
 #include "viewfinder_gl.h"
 
 #include <array>
+#ifdef HAVE_EGL
+#include <map>
+#include <string.h>
+#include <utility>
+#endif
 
 #include <QByteArray>
 #include <QFile>
 #include <QImage>
+#include <QOpenGLContext>
 #include <QStringList>
 
+/*
+ * Include the EGL headers after the Qt headers, and without the X11 headers
+ * whose macros conflict with Qt.
+ */
+#ifdef HAVE_EGL
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2ext.h>
+#endif
+
 #include <libcamera/formats.h>
 
 #include "../common/image.h"
@@ -58,6 +76,164 @@ static const QList<libcamera::PixelFormat> supportedFormats{
 	libcamera::formats::SRGGB12_CSI2P,
 };
 
+#ifdef HAVE_EGL
+/*
+ * Import the planes of frame buffers as EGLImages, and bind them to textures
+ * that the shaders sample directly. The textures are cached per buffer and
+ * plane, as the same buffers are rendered repeatedly. All functions must be
+ * called with the OpenGL context current.
+ */
+class DmaBufImporter
+{
+public:
+	static std::unique_ptr<DmaBufImporter> create(QOpenGLContext *context);
+
+	~DmaBufImporter();
+
+	GLuint texture(const libcamera::FrameBuffer *buffer, unsigned int plane,
+		       GLenum format, GLsizei width, GLsizei height);
+	void clear();
+
+private:
+	struct Texture {
+		EGLImageKHR image;
+		GLuint id;
+	};
+
+	DmaBufImporter(QOpenGLContext *context, EGLDisplay display);
+
+	QOpenGLFunctions *gl_;
+	EGLDisplay display_;
+	PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR_;
+	PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR_;
+	PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES_;
+
+	std::map<std::pair<const libcamera::FrameBuffer *, unsigned int>, Texture> textures_;
+};
+
+DmaBufImporter::DmaBufImporter(QOpenGLContext *context, EGLDisplay display)
+	: gl_(context->functions()), display_(display)
+{
+	eglCreateImageKHR_ = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+		eglGetProcAddress("eglCreateImageKHR"));
+	eglDestroyImageKHR_ = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+		eglGetProcAddress("eglDestroyImageKHR"));
+	glEGLImageTargetTexture2DOES_ = reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(
+		eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+}
+
+DmaBufImporter::~DmaBufImporter()
+{
+	clear();
+}
+
+std::unique_ptr<DmaBufImporter> DmaBufImporter::create(QOpenGLContext *context)
+{
+	/* No EGL display is current when Qt uses GLX. */
+	EGLDisplay display = eglGetCurrentDisplay();
+	if (display == EGL_NO_DISPLAY)
+		return nullptr;
+
+	const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (!extensions || !strstr(extensions, "EGL_EXT_image_dma_buf_import"))
+		return nullptr;
+
+	if (!context->hasExtension("GL_OES_EGL_image"))
+		return nullptr;
+
+	std::unique_ptr<DmaBufImporter> importer{ new DmaBufImporter(context, display) };
+	if (!importer->eglCreateImageKHR_ || !importer->eglDestroyImageKHR_ ||
+	    !importer->glEGLImageTargetTexture2DOES_)
+		return nullptr;
+
+	return importer;
+}
+
+/*
+ * Return the texture for \a plane of \a buffer, importing it if needed. The
+ * plane is described with the format and size of the texture that would be
+ * uploaded with glTexImage2D(), which the DRM format and pitch are derived
+ * from. Return 0 if the plane can't be imported.
+ */
+GLuint DmaBufImporter::texture(const libcamera::FrameBuffer *buffer,
+			       unsigned int plane, GLenum format,
+			       GLsizei width, GLsizei height)
+{
+	auto key = std::make_pair(buffer, plane);
+	auto iter = textures_.find(key);
+	if (iter != textures_.end())
+		return iter->second.id;
+
+	uint32_t fourcc;
+	unsigned int bpp;
+
+	switch (format) {
+	case GL_LUMINANCE:
+		fourcc = libcamera::formats::R8.fourcc();
+		bpp = 1;
+		break;
+	case GL_LUMINANCE_ALPHA:
+		/* DRM_FORMAT_GR88, which has no libcamera equivalent. */
+		fourcc = 'G' | ('R' << 8) | ('8' << 16) | ('8' << 24);
+		bpp = 2;
+		break;
+	case GL_RGB:
+		fourcc = libcamera::formats::BGR888.fourcc();
+		bpp = 3;
+		break;
+	case GL_RGBA:
+		fourcc = libcamera::formats::ABGR8888.fourcc();
+		bpp = 4;
+		break;
+	default:
+		return 0;
+	}
+
+	if (plane >= buffer->planes().size())
+		return 0;
+
+	const libcamera::FrameBuffer::Plane &fbPlane = buffer->planes()[plane];
+	const EGLint attribs[] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_LINUX_DRM_FOURCC_EXT, static_cast<EGLint>(fourcc),
+		EGL_DMA_BUF_PLANE0_FD_EXT, fbPlane.fd.get(),
+		EGL_DMA_BUF_PLANE0_OFFSET_EXT, static_cast<EGLint>(fbPlane.offset),
+		EGL_DMA_BUF_PLANE0_PITCH_EXT, static_cast<EGLint>(width * bpp),
+		EGL_NONE,
+	};
+
+	EGLImageKHR image = eglCreateImageKHR_(display_, EGL_NO_CONTEXT,
+					       EGL_LINUX_DMA_BUF_EXT, nullptr,
+					       attribs);
+	if (image == EGL_NO_IMAGE_KHR) {
+		qWarning() << "[ViewFinderGL]:"
+			   << "failed to import dma-buf, error"
+			   << eglGetError();
+		return 0;
+	}
+
+	GLuint id;
+	gl_->glGenTextures(1, &id);
+	gl_->glBindTexture(GL_TEXTURE_2D, id);
+	glEGLImageTargetTexture2DOES_(GL_TEXTURE_2D, image);
+
+	textures_[key] = { image, id };
+
+	return id;
+}
+
+void DmaBufImporter::clear()
+{
+	for (const auto &[key, texture] : textures_) {
+		gl_->glDeleteTextures(1, &texture.id);
+		eglDestroyImageKHR_(display_, texture.image);
+	}
+
+	textures_.clear();
+}
+#endif /* HAVE_EGL */
+
 ViewFinderGL::ViewFinderGL(QWidget *parent)
 	: QOpenGLWidget(parent), buffer_(nullptr),
 	  colorSpace_(libcamera::ColorSpace::Raw), image_(nullptr),
@@ -67,6 +243,12 @@ ViewFinderGL::ViewFinderGL(QWidget *parent)
 
 ViewFinderGL::~ViewFinderGL()
 {
+#ifdef HAVE_EGL
+	makeCurrent();
+	dmaBufImporter_.reset();
+	doneCurrent();
+#endif
+
 	removeShader();
 }
 
@@ -113,6 +295,15 @@ void ViewFinderGL::stop()
 		buffer_ = nullptr;
 		image_ = nullptr;
 	}
+
+#ifdef HAVE_EGL
+	/* The frame buffers are freed when the capture stops. */
+	if (dmaBufImporter_) {
+		makeCurrent();
+		dmaBufImporter_->clear();
+		doneCurrent();
+	}
+#endif
 }
 
 QImage ViewFinderGL::getCurrentImage()
@@ -426,7 +617,13 @@ bool ViewFinderGL::createFragmentShader()
 		return false;
 	}
 
-	QString defines = fragmentShaderDefines_.join('\n') + "\n";
+	QStringList shaderDefines = fragmentShaderDefines_;
+#ifdef HAVE_EGL
+	if (dmaBufImporter_)
+		shaderDefines.append("#define TEX_CHROMA_RG");
+#endif
+
+	QString defines = shaderDefines.join('\n') + "\n";
 	QByteArray src = file.readAll();
 	src.prepend(defines.toUtf8());
 
@@ -486,9 +683,9 @@ bool ViewFinderGL::createFragmentShader()
 	return true;
 }
 
-void ViewFinderGL::configureTexture(QOpenGLTexture &texture)
+void ViewFinderGL::configureTexture(GLuint texture)
 {
-	glBindTexture(GL_TEXTURE_2D, texture.textureId());
+	glBindTexture(GL_TEXTURE_2D, texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
 			textureMinMagFilters_);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
@@ -497,6 +694,43 @@ void ViewFinderGL::configureTexture(QOpenGLTexture &texture)
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
+/*
+ * Bind the texture of image plane \a plane to texture unit \a unit. The plane
+ * is sampled directly from the frame buffer when dma-buf import is supported,
+ * and uploaded from the mapped image otherwise. Return false if the dma-buf
+ * import fails.
+ */
+bool ViewFinderGL::bindTexture(unsigned int unit, unsigned int plane,
+			       GLenum format, GLsizei width, GLsizei height)
+{
+	glActiveTexture(GL_TEXTURE0 + unit);
+
+#ifdef HAVE_EGL
+	if (dmaBufImporter_) {
+		GLuint texture = dmaBufImporter_->texture(buffer_, plane, format,
+							  width, height);
+		if (!texture)
+			return false;
+
+		configureTexture(texture);
+		return true;
+	}
+#endif
+
+	configureTexture(textures_[unit]->textureId());
+	glTexImage2D(GL_TEXTURE_2D,
+		     0,
+		     format,
+		     width,
+		     height,
+		     0,
+		     format,
+		     GL_UNSIGNED_BYTE,
+		     image_->data(plane).data());
+
+	return true;
+}
+
 void ViewFinderGL::removeShader()
 {
 	if (shaderProgram_.isLinked()) {
@@ -536,10 +770,14 @@ void ViewFinderGL::initializeGL()
 	if (!createVertexShader())
 		qWarning() << "[ViewFinderGL]: create vertex shader failed.";
 
+#ifdef HAVE_EGL
+	dmaBufImporter_ = DmaBufImporter::create(context());
+#endif
+
 	glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
 }
 
-void ViewFinderGL::doRender()
+bool ViewFinderGL::doRender()
 {
 	/* Stride of the first plane, in pixels. */
 	unsigned int stridePixels;
@@ -552,31 +790,15 @@ void ViewFinderGL::doRender()
 	case libcamera::formats::NV24:
 	case libcamera::formats::NV42:
 		/* Activate texture Y */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_LUMINANCE, stride_, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 
 		/* Activate texture UV/VU */
-		glActiveTexture(GL_TEXTURE1);
-		configureTexture(*textures_[1]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE_ALPHA,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE_ALPHA,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(1).data());
+		if (!bindTexture(1, 1, GL_LUMINANCE_ALPHA,
+				 stride_ / horzSubSample_,
+				 size_.height() / vertSubSample_))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformU_, 1);
 
 		stridePixels = stride_;
@@ -584,45 +806,22 @@ void ViewFinderGL::doRender()
 
 	case libcamera::formats::YUV420:
 		/* Activate texture Y */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_LUMINANCE, stride_, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 
 		/* Activate texture U */
-		glActiveTexture(GL_TEXTURE1);
-		configureTexture(*textures_[1]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(1).data());
+		if (!bindTexture(1, 1, GL_LUMINANCE,
+				 stride_ / horzSubSample_,
+				 size_.height() / vertSubSample_))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformU_, 1);
 
 		/* Activate texture V */
-		glActiveTexture(GL_TEXTURE2);
-		configureTexture(*textures_[2]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(2).data());
+		if (!bindTexture(2, 2, GL_LUMINANCE,
+				 stride_ / horzSubSample_,
+				 size_.height() / vertSubSample_))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformV_, 2);
 
 		stridePixels = stride_;
@@ -630,45 +829,22 @@ void ViewFinderGL::doRender()
 
 	case libcamera::formats::YVU420:
 		/* Activate texture Y */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_LUMINANCE, stride_, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 
 		/* Activate texture V */
-		glActiveTexture(GL_TEXTURE2);
-		configureTexture(*textures_[2]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(1).data());
+		if (!bindTexture(2, 1, GL_LUMINANCE,
+				 stride_ / horzSubSample_,
+				 size_.height() / vertSubSample_))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformV_, 2);
 
 		/* Activate texture U */
-		glActiveTexture(GL_TEXTURE1);
-		configureTexture(*textures_[1]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(2).data());
+		if (!bindTexture(1, 2, GL_LUMINANCE,
+				 stride_ / horzSubSample_,
+				 size_.height() / vertSubSample_))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformU_, 1);
 
 		stridePixels = stride_;
@@ -683,17 +859,8 @@ void ViewFinderGL::doRender()
 		 * OpenGL texel size with the 4 bytes repeating pattern in YUV.
 		 * The texture width is thus half of the image_ with.
 		 */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_RGBA,
-			     stride_ / 4,
-			     size_.height(),
-			     0,
-			     GL_RGBA,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_RGBA, stride_ / 4, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 
 		/*
@@ -713,17 +880,8 @@ void ViewFinderGL::doRender()
 	case libcamera::formats::ARGB8888:
 	case libcamera::formats::BGRA8888:
 	case libcamera::formats::RGBA8888:
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_RGBA,
-			     stride_ / 4,
-			     size_.height(),
-			     0,
-			     GL_RGBA,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_RGBA, stride_ / 4, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 
 		stridePixels = stride_ / 4;
@@ -731,17 +889,8 @@ void ViewFinderGL::doRender()
 
 	case libcamera::formats::BGR888:
 	case libcamera::formats::RGB888:
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_RGB,
-			     stride_ / 3,
-			     size_.height(),
-			     0,
-			     GL_RGB,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_RGB, stride_ / 3, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 
 		stridePixels = stride_ / 3;
@@ -764,17 +913,8 @@ void ViewFinderGL::doRender()
 		 * are stored in a GL_LUMINANCE texture. The texture width is
 		 * equal to the stride.
 		 */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
+		if (!bindTexture(0, 0, GL_LUMINANCE, stride_, size_.height()))
+			return false;
 		shaderProgram_.setUniformValue(textureUniformY_, 0);
 		shaderProgram_.setUniformValue(textureUniformBayerFirstRed_,
 					       firstRed_);
@@ -805,6 +945,8 @@ void ViewFinderGL::doRender()
 	shaderProgram_.setUniformValue(textureUniformStrideFactor_,
 				       static_cast<float>(size_.width() - 1) /
 				       (stridePixels - 1));
+
+	return true;
 }
 
 void ViewFinderGL::paintGL()
@@ -819,8 +961,37 @@ void ViewFinderGL::paintGL()
 		glClearColor(0.0, 0.0, 0.0, 1.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+#ifdef HAVE_EGL
+		if (!doRender()) {
+			/*
+			 * Fall back to uploading frames if the dma-buf can't
+			 * be imported. The fragment shader depends on the
+			 * texture format and must be recreated.
+			 */
+			dmaBufImporter_.reset();
+
+			shaderProgram_.release();
+			shaderProgram_.removeShader(fragmentShader_.get());
+			fragmentShader_.reset();
+
+			if (!createFragmentShader())
+				return;
+
+			doRender();
+		}
+#else
 		doRender();
+#endif
 		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+#ifdef HAVE_EGL
+		/*
+		 * Wait for the GPU to sample the frame buffer, as it is
+		 * queued back to the camera once the next frame is rendered.
+		 */
+		if (dmaBufImporter_)
+			glFinish();
+#endif
 	}
 }
 
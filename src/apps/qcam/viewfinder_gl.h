@@ -25,6 +25,10 @@
 
 #include "viewfinder.h"
 
+#ifdef HAVE_EGL
+class DmaBufImporter;
+#endif
+
 class ViewFinderGL : public QOpenGLWidget,
 		     public ViewFinder,
 		     protected QOpenGLFunctions
@@ -58,11 +62,13 @@ private:
 	bool selectFormat(const libcamera::PixelFormat &format);
 	void selectColorSpace(const libcamera::ColorSpace &colorSpace);
 
-	void configureTexture(QOpenGLTexture &texture);
+	void configureTexture(GLuint texture);
+	bool bindTexture(unsigned int unit, unsigned int plane, GLenum format,
+			 GLsizei width, GLsizei height);
 	bool createFragmentShader();
 	bool createVertexShader();
 	void removeShader();
-	void doRender();
+	bool doRender();
 
 	/* Captured image size, format and buffer */
 	libcamera::FrameBuffer *buffer_;
@@ -86,6 +92,11 @@ private:
 	/* Textures */
 	std::array<std::unique_ptr<QOpenGLTexture>, 3> textures_;
 
+#ifdef HAVE_EGL
+	/* Textures imported from the frame buffers dma-bufs, if supported */
+	std::unique_ptr<DmaBufImporter> dmaBufImporter_;
+#endif
+
 	/* Common texture parameters */
 	GLuint textureMinMagFilters_;
 
@@ -8,6 +8,10 @@
 
 #include "gstlibcamera-utils.h"
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include <libcamera/control_ids.h>
 #include <libcamera/formats.h>
 
@@ -330,9 +334,56 @@ bare_structure_from_format(const PixelFormat &format)
 	}
 }
 
+static GstCaps *
+sizes_to_caps(const GstStructure *bare_s, const StreamFormats &formats,
+	      const PixelFormat &pixelformat)
+{
+	GstCaps *caps = gst_caps_new_empty();
+	const SizeRange &range = formats.range(pixelformat);
+	bool stepped = range.hStep && range.vStep;
+
+	for (const Size &size : formats.sizes(pixelformat)) {
+		/*
+		 * Sizes enumerated from a stepped range are described by the
+		 * range structure, don't list them individually.
+		 */
+		if (stepped && range.contains(size))
+			continue;
+
+		GstStructure *s = gst_structure_copy(bare_s);
+		gst_structure_set(s,
+				  "width", G_TYPE_INT, size.width,
+				  "height", G_TYPE_INT, size.height,
+				  nullptr);
+		caps = gst_caps_merge_structure(caps, s);
+	}
+
+	if (stepped) {
+		GstStructure *s = gst_structure_copy(bare_s);
+		GValue val = G_VALUE_INIT;
+
+		g_value_init(&val, GST_TYPE_INT_RANGE);
+		gst_value_set_int_range_step(&val, range.min.width, range.max.width, range.hStep);
+		gst_structure_set_value(s, "width", &val);
+		gst_value_set_int_range_step(&val, range.min.height, range.max.height, range.vStep);
+		gst_structure_set_value(s, "height", &val);
+		g_value_unset(&val);
+
+		gst_caps_append_structure(caps, s);
+	}
+
+	return caps;
+}
+
 GstCaps *
 gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 {
+	/*
+	 * Raw formats supporting the same sizes are grouped in structures
+	 * carrying a list of formats, which keeps the caps small for cameras
+	 * that expose many formats. Other media types have no formats list.
+	 */
+	std::vector<std::pair<GstCaps *, std::vector<const gchar *>>> groups;
 	GstCaps *caps = gst_caps_new_empty();
 
 	for (PixelFormat pixelformat : formats.pixelformats()) {
@@ -344,29 +395,58 @@ gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 			continue;
 		}
 
-		for (const Size &size : formats.sizes(pixelformat)) {
-			GstStructure *s = gst_structure_copy(bare_s);
-			gst_structure_set(s,
-					  "width", G_TYPE_INT, size.width,
-					  "height", G_TYPE_INT, size.height,
-					  nullptr);
-			gst_caps_append_structure(caps, s);
+		if (!gst_structure_has_name(bare_s, "video/x-raw")) {
+			groups.push_back({ sizes_to_caps(bare_s, formats, pixelformat), {} });
+			continue;
+		}
+
+		const gchar *format =
+			gst_video_format_to_string(pixel_format_to_gst_format(pixelformat));
+		gst_structure_remove_field(bare_s, "format");
+
+		GstCaps *sizes = sizes_to_caps(bare_s, formats, pixelformat);
+
+		auto group = std::find_if(groups.begin(), groups.end(),
+					  [&](const auto &item) {
+						  return !item.second.empty() &&
+							 gst_caps_is_strictly_equal(item.first, sizes);
+					  });
+		if (group != groups.end()) {
+			group->second.push_back(format);
+			gst_caps_unref(sizes);
+		} else {
+			groups.push_back({ sizes, { format } });
 		}
+	}
+
+	for (auto &[sizes, group_formats] : groups) {
+		GValue val = G_VALUE_INIT;
 
-		const SizeRange &range = formats.range(pixelformat);
-		if (range.hStep && range.vStep) {
-			GstStructure *s = gst_structure_copy(bare_s);
-			GValue val = G_VALUE_INIT;
+		if (group_formats.empty()) {
+			gst_caps_append(caps, sizes);
+			continue;
+		}
 
-			g_value_init(&val, GST_TYPE_INT_RANGE);
-			gst_value_set_int_range_step(&val, range.min.width, range.max.width, range.hStep);
-			gst_structure_set_value(s, "width", &val);
-			gst_value_set_int_range_step(&val, range.min.height, range.max.height, range.vStep);
-			gst_structure_set_value(s, "height", &val);
-			g_value_unset(&val);
+		if (group_formats.size() == 1) {
+			g_value_init(&val, G_TYPE_STRING);
+			g_value_set_static_string(&val, group_formats[0]);
+		} else {
+			g_value_init(&val, GST_TYPE_LIST);
+			for (const gchar *format : group_formats) {
+				GValue item = G_VALUE_INIT;
 
-			gst_caps_append_structure(caps, s);
+				g_value_init(&item, G_TYPE_STRING);
+				g_value_set_static_string(&item, format);
+				gst_value_list_append_and_take_value(&val, &item);
+			}
 		}
+
+		for (guint i = 0; i < gst_caps_get_size(sizes); i++)
+			gst_structure_set_value(gst_caps_get_structure(sizes, i),
+						"format", &val);
+
+		g_value_unset(&val);
+		gst_caps_append(caps, sizes);
 	}
 
 	return caps;
@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Collabora Ltd.
+ *
+ * GStreamer Frame Metadata
+ */
+
+#include "gstlibcamerameta.h"
+
+#include <libcamera/control_ids.h>
+
+using namespace libcamera;
+
+static gboolean
+gst_libcamera_meta_init(GstMeta *meta, [[maybe_unused]] gpointer params,
+			[[maybe_unused]] GstBuffer *buffer)
+{
+	auto *lmeta = reinterpret_cast<GstLibcameraMeta *>(meta);
+
+	lmeta->sequence = 0;
+	lmeta->sensor_timestamp = 0;
+	lmeta->exposure_time = 0;
+	lmeta->frame_duration = 0;
+	lmeta->analogue_gain = 0.0f;
+	lmeta->colour_temperature = 0;
+	lmeta->lux = 0.0f;
+
+	return TRUE;
+}
+
+static gboolean
+gst_libcamera_meta_transform(GstBuffer *dest, GstMeta *meta,
+			     [[maybe_unused]] GstBuffer *buffer, GQuark type,
+			     [[maybe_unused]] gpointer data)
+{
+	/* The metadata describes the frame, it survives any transformation. */
+	if (!GST_META_TRANSFORM_IS_COPY(type))
+		return FALSE;
+
+	auto *src = reinterpret_cast<GstLibcameraMeta *>(meta);
+	auto *dst = reinterpret_cast<GstLibcameraMeta *>(
+		gst_buffer_add_meta(dest, GST_LIBCAMERA_META_INFO, nullptr));
+	if (!dst)
+		return FALSE;
+
+	dst->sequence = src->sequence;
+	dst->sensor_timestamp = src->sensor_timestamp;
+	dst->exposure_time = src->exposure_time;
+	dst->frame_duration = src->frame_duration;
+	dst->analogue_gain = src->analogue_gain;
+	dst->colour_temperature = src->colour_temperature;
+	dst->lux = src->lux;
+
+	return TRUE;
+}
+
+GType
+gst_libcamera_meta_api_get_type()
+{
+	static gsize type = 0;
+	static const gchar *tags[] = { nullptr };
+
+	if (g_once_init_enter(&type)) {
+		GType api = gst_meta_api_type_register("GstLibcameraMetaAPI", tags);
+		g_once_init_leave(&type, api);
+	}
+
+	return type;
+}
+
+const GstMetaInfo *
+gst_libcamera_meta_get_info()
+{
+	static const GstMetaInfo *meta_info = nullptr;
+
+	if (g_once_init_enter(&meta_info)) {
+		const GstMetaInfo *info =
+			gst_meta_register(GST_LIBCAMERA_META_API_TYPE,
+					  "GstLibcameraMeta",
+					  sizeof(GstLibcameraMeta),
+					  gst_libcamera_meta_init, nullptr,
+					  gst_libcamera_meta_transform);
+		g_once_init_leave(&meta_info, info);
+	}
+
+	return meta_info;
+}
+
+GstLibcameraMeta *
+gst_buffer_add_libcamera_meta(GstBuffer *buffer, guint32 sequence,
+			      const ControlList &metadata)
+{
+	auto *meta = reinterpret_cast<GstLibcameraMeta *>(
+		gst_buffer_add_meta(buffer, GST_LIBCAMERA_META_INFO, nullptr));
+	if (!meta)
+		return nullptr;
+
+	meta->sequence = sequence;
+	meta->sensor_timestamp = metadata.get(controls::SensorTimestamp).value_or(0);
+	meta->exposure_time = metadata.get(controls::ExposureTime).value_or(0);
+	meta->frame_duration = metadata.get(controls::FrameDuration).value_or(0);
+	meta->analogue_gain = metadata.get(controls::AnalogueGain).value_or(0.0f);
+	meta->colour_temperature = metadata.get(controls::ColourTemperature).value_or(0);
+	meta->lux = metadata.get(controls::Lux).value_or(0.0f);
+
+	return meta;
+}
+
+/*
+ * Caps identifying the sensor timestamp in GstReferenceTimestampMeta, for
+ * elements that don't know about GstLibcameraMeta.
+ */
+GstCaps *
+gst_libcamera_sensor_timestamp_caps()
+{
+	static GstStaticCaps caps = GST_STATIC_CAPS("timestamp/x-libcamera-sensor");
+
+	return gst_static_caps_get(&caps);
+}
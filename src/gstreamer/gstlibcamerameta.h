@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Collabora Ltd.
+ *
+ * GStreamer Frame Metadata
+ */
+
+#pragma once
+
+#include <gst/gst.h>
+
+#include <libcamera/controls.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Per-frame metadata reported by libcamera. Fields not reported by the camera
+ * are set to 0.
+ */
+struct GstLibcameraMeta {
+	GstMeta meta;
+
+	guint32 sequence;
+	/* Start of exposure of the first line, in nanoseconds (CLOCK_BOOTTIME). */
+	guint64 sensor_timestamp;
+	/* Exposure time and frame duration, in microseconds. */
+	gint32 exposure_time;
+	gint64 frame_duration;
+	gfloat analogue_gain;
+	gint32 colour_temperature;
+	gfloat lux;
+};
+
+GType gst_libcamera_meta_api_get_type();
+#define GST_LIBCAMERA_META_API_TYPE (gst_libcamera_meta_api_get_type())
+
+const GstMetaInfo *gst_libcamera_meta_get_info();
+#define GST_LIBCAMERA_META_INFO (gst_libcamera_meta_get_info())
+
+#define gst_buffer_get_libcamera_meta(b) \
+	((GstLibcameraMeta *)gst_buffer_get_meta((b), GST_LIBCAMERA_META_API_TYPE))
+
+G_END_DECLS
+
+GstLibcameraMeta *gst_buffer_add_libcamera_meta(GstBuffer *buffer, guint32 sequence,
+						const libcamera::ControlList &metadata);
+
+GstCaps *gst_libcamera_sensor_timestamp_caps();
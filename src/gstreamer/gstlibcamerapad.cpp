@@ -18,7 +18,8 @@ struct _GstLibcameraPad {
 	GstPad parent;
 	StreamRole role;
 	GstLibcameraPool *pool;
-	GstClockTime latency;
+	GstClockTime min_latency;
+	GstClockTime max_latency;
 };
 
 enum {
@@ -70,9 +71,12 @@ gst_libcamera_pad_query(GstPad *pad, GstObject *parent, GstQuery *query)
 	if (query->type != GST_QUERY_LATENCY)
 		return gst_pad_query_default(pad, parent, query);
 
-	/* TRUE here means live, we assumes that max latency is the same as min
-	 * as we have no idea that duration of frames. */
-	gst_query_set_latency(query, TRUE, self->latency, self->latency);
+	/*
+	 * TRUE here means live. The min latency is the capture latency, the
+	 * max latency adds the duration of the frames queued in the camera.
+	 */
+	GLibLocker lock(GST_OBJECT(self));
+	gst_query_set_latency(query, TRUE, self->min_latency, self->max_latency);
 	return TRUE;
 }
 
@@ -165,9 +169,11 @@ gst_libcamera_pad_get_stream(GstPad *pad)
 }
 
 void
-gst_libcamera_pad_set_latency(GstPad *pad, GstClockTime latency)
+gst_libcamera_pad_set_latency(GstPad *pad, GstClockTime min_latency,
+			      GstClockTime max_latency)
 {
 	auto *self = GST_LIBCAMERA_PAD(pad);
 	GLibLocker lock(GST_OBJECT(self));
-	self->latency = latency;
+	self->min_latency = min_latency;
+	self->max_latency = max_latency;
 }
@@ -25,4 +25,5 @@ void gst_libcamera_pad_set_pool(GstPad *pad, GstLibcameraPool *pool);
 
 libcamera::Stream *gst_libcamera_pad_get_stream(GstPad *pad);
 
-void gst_libcamera_pad_set_latency(GstPad *pad, GstClockTime latency);
+void gst_libcamera_pad_set_latency(GstPad *pad, GstClockTime min_latency,
+				   GstClockTime max_latency);
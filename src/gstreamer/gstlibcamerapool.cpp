@@ -8,8 +8,15 @@
 
 #include "gstlibcamerapool.h"
 
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+
+#include <libcamera/framebuffer.h>
 #include <libcamera/stream.h>
 
+#include <gst/allocators/allocators.h>
+
 #include "gstlibcamera-utils.h"
 
 using namespace libcamera;
@@ -27,15 +34,131 @@ struct _GstLibcameraPool {
 	GstAtomicQueue *queue;
 	GstLibcameraAllocator *allocator;
 	Stream *stream;
+
+	/*
+	 * Downstream pool whose dma-buf buffers are imported, in which case
+	 * the queue and allocator are not used.
+	 */
+	GstBufferPool *downstream;
+	GstVideoInfo info;
+	guint stride;
 };
 
 G_DEFINE_TYPE(GstLibcameraPool, gst_libcamera_pool, GST_TYPE_BUFFER_POOL)
 
+static GQuark
+gst_libcamera_pool_import_quark()
+{
+	static gsize import_quark = 0;
+
+	if (g_once_init_enter(&import_quark)) {
+		GQuark quark = g_quark_from_string("GstLibcameraImportedFrameBuffer");
+		g_once_init_leave(&import_quark, quark);
+	}
+
+	return import_quark;
+}
+
+static void
+gst_libcamera_pool_free_frame_buffer(gpointer data)
+{
+	delete reinterpret_cast<FrameBuffer *>(data);
+}
+
+/*
+ * Wrap the dma-buf memories of a downstream buffer in a FrameBuffer. The
+ * FrameBuffer is attached to the first memory of the buffer, and thus reused
+ * as long as the downstream pool recycles its memories.
+ */
+static bool
+gst_libcamera_pool_import_buffer(GstLibcameraPool *self, GstBuffer *buffer)
+{
+	GstMemory *mem = gst_buffer_peek_memory(buffer, 0);
+	if (gst_mini_object_get_qdata(GST_MINI_OBJECT(mem),
+				      gst_libcamera_pool_import_quark()))
+		return true;
+
+	const GstVideoInfo *info = &self->info;
+	GstVideoMeta *meta = gst_buffer_get_video_meta(buffer);
+	guint n_planes = GST_VIDEO_INFO_N_PLANES(info);
+	gsize size = gst_buffer_get_size(buffer);
+
+	gint stride = meta ? meta->stride[0] : GST_VIDEO_INFO_PLANE_STRIDE(info, 0);
+	if (stride < 0 || static_cast<guint>(stride) != self->stride) {
+		GST_DEBUG_OBJECT(self, "Stride %d doesn't match stream stride %u",
+				 stride, self->stride);
+		return false;
+	}
+
+	std::vector<FrameBuffer::Plane> planes(n_planes);
+
+	for (guint i = 0; i < n_planes; i++) {
+		gsize offset = meta ? meta->offset[i] : GST_VIDEO_INFO_PLANE_OFFSET(info, i);
+		gsize end = i + 1 < n_planes
+			  ? (meta ? meta->offset[i + 1] : GST_VIDEO_INFO_PLANE_OFFSET(info, i + 1))
+			  : size;
+		guint idx, length;
+		gsize skip;
+
+		if (end <= offset ||
+		    !gst_buffer_find_memory(buffer, offset, 1, &idx, &length, &skip))
+			return false;
+
+		GstMemory *plane_mem = gst_buffer_peek_memory(buffer, idx);
+		if (!gst_is_dmabuf_memory(plane_mem) ||
+		    skip + (end - offset) > plane_mem->size) {
+			GST_DEBUG_OBJECT(self, "Plane %u isn't backed by a dma-buf", i);
+			return false;
+		}
+
+		/* Duplicate the fd, it is owned by the downstream memory. */
+		int fd = gst_dmabuf_memory_get_fd(plane_mem);
+		planes[i].fd = SharedFD(fd);
+		planes[i].offset = plane_mem->offset + skip;
+		planes[i].length = end - offset;
+	}
+
+	gst_mini_object_set_qdata(GST_MINI_OBJECT(mem),
+				  gst_libcamera_pool_import_quark(),
+				  new FrameBuffer(planes),
+				  gst_libcamera_pool_free_frame_buffer);
+
+	return true;
+}
+
+static GstFlowReturn
+gst_libcamera_pool_acquire_import(GstLibcameraPool *self, GstBuffer **buffer,
+				  GstBufferPoolAcquireParams *params)
+{
+	GstBuffer *buf;
+
+	GstFlowReturn ret = gst_buffer_pool_acquire_buffer(self->downstream,
+							   &buf, params);
+	if (ret != GST_FLOW_OK)
+		return ret;
+
+	if (!gst_libcamera_pool_import_buffer(self, buf)) {
+		gst_buffer_unref(buf);
+		return GST_FLOW_ERROR;
+	}
+
+	*buffer = buf;
+	return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_libcamera_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer,
-				  [[maybe_unused]] GstBufferPoolAcquireParams *params)
+				  GstBufferPoolAcquireParams *params)
 {
 	GstLibcameraPool *self = GST_LIBCAMERA_POOL(pool);
+
+	/*
+	 * Imported buffers are acquired from, and released to, the downstream
+	 * pool directly.
+	 */
+	if (self->downstream)
+		return gst_libcamera_pool_acquire_import(self, buffer, params);
+
 	GstBuffer *buf = GST_BUFFER(gst_atomic_queue_pop(self->queue));
 	if (!buf)
 		return GST_FLOW_ERROR;
@@ -88,7 +211,12 @@ gst_libcamera_pool_finalize(GObject *object)
 		gst_buffer_unref(buf);
 
 	gst_atomic_queue_unref(self->queue);
-	g_object_unref(self->allocator);
+	g_clear_object(&self->allocator);
+
+	if (self->downstream) {
+		gst_buffer_pool_set_active(self->downstream, FALSE);
+		gst_object_unref(self->downstream);
+	}
 
 	G_OBJECT_CLASS(gst_libcamera_pool_parent_class)->finalize(object);
 }
@@ -128,6 +256,33 @@ gst_libcamera_pool_new(GstLibcameraAllocator *allocator, Stream *stream)
 	return pool;
 }
 
+GstLibcameraPool *
+gst_libcamera_pool_new_import(GstBufferPool *downstream,
+			      const StreamConfiguration &stream_cfg, GstCaps *caps)
+{
+	g_autoptr(GstLibcameraPool) pool =
+		GST_LIBCAMERA_POOL(g_object_new(GST_TYPE_LIBCAMERA_POOL, nullptr));
+
+	pool->downstream = GST_BUFFER_POOL(gst_object_ref(downstream));
+	pool->stream = stream_cfg.stream();
+	pool->stride = stream_cfg.stride;
+
+	if (!gst_video_info_from_caps(&pool->info, caps))
+		return nullptr;
+
+	/* Check that the downstream buffers can be imported. */
+	GstBufferPoolAcquireParams params = {};
+	params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+	GstBuffer *buffer;
+	if (gst_libcamera_pool_acquire_import(pool, &buffer, &params) != GST_FLOW_OK)
+		return nullptr;
+
+	gst_buffer_unref(buffer);
+
+	return GST_LIBCAMERA_POOL(g_steal_pointer(&pool));
+}
+
 Stream *
 gst_libcamera_pool_get_stream(GstLibcameraPool *self)
 {
@@ -138,5 +293,11 @@ FrameBuffer *
 gst_libcamera_buffer_get_frame_buffer(GstBuffer *buffer)
 {
 	GstMemory *mem = gst_buffer_peek_memory(buffer, 0);
+
+	auto *fb = reinterpret_cast<FrameBuffer *>(gst_mini_object_get_qdata(GST_MINI_OBJECT(mem),
+									     gst_libcamera_pool_import_quark()));
+	if (fb)
+		return fb;
+
 	return gst_libcamera_memory_get_frame_buffer(mem);
 }
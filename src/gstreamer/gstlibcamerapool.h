@@ -7,6 +7,9 @@
  *
  * This is a partial implementation of GstBufferPool intended for internal use
  * only. This pool cannot be configured or activated.
+ *
+ * The pool either hands out buffers from the libcamera allocator, or imports
+ * the dma-buf buffers of a downstream pool, which stays owned by the pool.
  */
 
 #pragma once
@@ -23,6 +26,10 @@ G_DECLARE_FINAL_TYPE(GstLibcameraPool, gst_libcamera_pool, GST_LIBCAMERA, POOL,
 GstLibcameraPool *gst_libcamera_pool_new(GstLibcameraAllocator *allocator,
 					 libcamera::Stream *stream);
 
+GstLibcameraPool *gst_libcamera_pool_new_import(GstBufferPool *downstream,
+						const libcamera::StreamConfiguration &stream_cfg,
+						GstCaps *caps);
+
 libcamera::Stream *gst_libcamera_pool_get_stream(GstLibcameraPool *self);
 
 libcamera::FrameBuffer *gst_libcamera_buffer_get_frame_buffer(GstBuffer *buffer);
@@ -7,6 +7,8 @@
  */
 
 #include <array>
+#include <map>
+#include <string>
 
 #include "gstlibcameraprovider.h"
 
@@ -140,16 +142,17 @@ gst_libcamera_device_class_init(GstLibcameraDeviceClass *klass)
 	g_object_class_install_property(object_class, PROP_AUTO_FOCUS_MODE, pspec);
 }
 
-static GstDevice *
-gst_libcamera_device_new(const std::shared_ptr<Camera> &camera)
+static GstCaps *
+gst_libcamera_device_probe_caps(const std::shared_ptr<Camera> &camera)
 {
 	static const std::array roles{ StreamRole::VideoRecording };
-	g_autoptr(GstCaps) caps = gst_caps_new_empty();
-	const gchar *name = camera->id().c_str();
+	GstCaps *caps = gst_caps_new_empty();
 
 	std::unique_ptr<CameraConfiguration> config = camera->generateConfiguration(roles);
 	if (!config || config->size() != roles.size()) {
-		GST_ERROR("Failed to generate a default configuration for %s", name);
+		GST_ERROR("Failed to generate a default configuration for %s",
+			  camera->id().c_str());
+		gst_caps_unref(caps);
 		return nullptr;
 	}
 
@@ -159,6 +162,14 @@ gst_libcamera_device_new(const std::shared_ptr<Camera> &camera)
 			gst_caps_append(caps, sub_caps);
 	}
 
+	return caps;
+}
+
+static GstDevice *
+gst_libcamera_device_new(const std::shared_ptr<Camera> &camera, GstCaps *caps)
+{
+	const gchar *name = camera->id().c_str();
+
 	return GST_DEVICE(g_object_new(GST_TYPE_LIBCAMERA_DEVICE,
 				       /* \todo Use a unique identifier instead of camera name. */
 				       "name", name,
@@ -176,8 +187,75 @@ gst_libcamera_device_new(const std::shared_ptr<Camera> &camera)
  * libcamera devices. The implementation is private to the plugin.
  */
 
+/* Used for C++ object with destructors. */
+struct GstLibcameraProviderState {
+	~GstLibcameraProviderState();
+
+	GstCaps *cameraCaps(const std::shared_ptr<Camera> &camera);
+	void cameraRemoved(std::shared_ptr<Camera> camera);
+
+	/*
+	 * The CameraManager is kept across probes, it tracks hotplugged
+	 * cameras and thus doesn't need to be restarted to list them.
+	 */
+	std::shared_ptr<CameraManager> cm_;
+
+	/*
+	 * Caps cached per camera id, as generating configurations is costly.
+	 * Protected by lock_, as cameraRemoved() runs in the CameraManager
+	 * thread.
+	 */
+	GMutex lock_;
+	std::map<std::string, GstCaps *> caps_;
+};
+
+GstLibcameraProviderState::~GstLibcameraProviderState()
+{
+	if (cm_)
+		cm_->cameraRemoved.disconnect(this);
+
+	for (auto &[id, caps] : caps_)
+		gst_caps_unref(caps);
+}
+
+/* Return a new reference to the caps of the camera. */
+GstCaps *GstLibcameraProviderState::cameraCaps(const std::shared_ptr<Camera> &camera)
+{
+	{
+		GLibLocker locker(&lock_);
+		auto it = caps_.find(camera->id());
+		if (it != caps_.end())
+			return gst_caps_ref(it->second);
+	}
+
+	GstCaps *caps = gst_libcamera_device_probe_caps(camera);
+	if (!caps)
+		return nullptr;
+
+	GLibLocker locker(&lock_);
+	GstCaps *&entry = caps_[camera->id()];
+	if (entry)
+		gst_caps_unref(entry);
+	entry = gst_caps_ref(caps);
+
+	return caps;
+}
+
+void GstLibcameraProviderState::cameraRemoved(std::shared_ptr<Camera> camera)
+{
+	GLibLocker locker(&lock_);
+
+	auto it = caps_.find(camera->id());
+	if (it == caps_.end())
+		return;
+
+	gst_caps_unref(it->second);
+	caps_.erase(it);
+}
+
 struct _GstLibcameraProvider {
 	GstDeviceProvider parent;
+	GstLibcameraProviderState *state;
 };
 
 G_DEFINE_TYPE_WITH_CODE(GstLibcameraProvider, gst_libcamera_provider,
@@ -189,28 +267,37 @@ static GList *
 gst_libcamera_provider_probe(GstDeviceProvider *provider)
 {
 	GstLibcameraProvider *self = GST_LIBCAMERA_PROVIDER(provider);
-	std::shared_ptr<CameraManager> cm;
+	GstLibcameraProviderState *state = self->state;
 	GList *devices = nullptr;
 	gint ret;
 
 	GST_INFO_OBJECT(self, "Probing cameras using libcamera");
 
-	/* \todo Move the CameraMananger start()/stop() calls into
-	 * GstDeviceProvider start()/stop() virtual function when CameraMananger
-	 * gains monitoring support. Meanwhile we need to cycle start()/stop()
-	 * to ensure every probe() calls return the latest list.
+	/*
+	 * Share the CameraManager with the libcamerasrc elements, and keep it
+	 * for the next probes.
+	 *
+	 * \todo Move the CameraManager retrieval to the GstDeviceProvider
+	 * start() virtual function and post device added/removed messages
+	 * from the cameraAdded and cameraRemoved signals.
 	 */
-	cm = gst_libcamera_get_camera_manager(ret);
-	if (ret) {
-		GST_ERROR_OBJECT(self, "Failed to retrieve device list: %s",
-				 g_strerror(-ret));
-		return nullptr;
+	if (!state->cm_) {
+		state->cm_ = gst_libcamera_get_camera_manager(ret);
+		if (ret) {
+			GST_ERROR_OBJECT(self, "Failed to retrieve device list: %s",
+					 g_strerror(-ret));
+			state->cm_.reset();
+			return nullptr;
+		}
+
+		state->cm_->cameraRemoved.connect(state, &GstLibcameraProviderState::cameraRemoved);
 	}
 
-	for (const std::shared_ptr<Camera> &camera : cm->cameras()) {
+	for (const std::shared_ptr<Camera> &camera : state->cm_->cameras()) {
 		GST_INFO_OBJECT(self, "Found camera '%s'", camera->id().c_str());
 
-		GstDevice *dev = gst_libcamera_device_new(camera);
+		g_autoptr(GstCaps) caps = state->cameraCaps(camera);
+		GstDevice *dev = caps ? gst_libcamera_device_new(camera, caps) : nullptr;
 		if (!dev) {
 			GST_ERROR_OBJECT(self, "Failed to add camera '%s'",
 					 camera->id().c_str());
@@ -229,15 +316,32 @@ gst_libcamera_provider_init(GstLibcameraProvider *self)
 {
 	GstDeviceProvider *provider = GST_DEVICE_PROVIDER(self);
 
+	self->state = new GstLibcameraProviderState();
+	g_mutex_init(&self->state->lock_);
+
 	/* Avoid devices being duplicated. */
 	gst_device_provider_hide_provider(provider, "v4l2deviceprovider");
 }
 
+static void
+gst_libcamera_provider_finalize(GObject *object)
+{
+	GstLibcameraProvider *self = GST_LIBCAMERA_PROVIDER(object);
+	gpointer klass = gst_libcamera_provider_parent_class;
+
+	g_mutex_clear(&self->state->lock_);
+	delete self->state;
+
+	G_OBJECT_CLASS(klass)->finalize(object);
+}
+
 static void
 gst_libcamera_provider_class_init(GstLibcameraProviderClass *klass)
 {
 	GstDeviceProviderClass *provider_class = GST_DEVICE_PROVIDER_CLASS(klass);
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
 
+	object_class->finalize = gst_libcamera_provider_finalize;
 	provider_class->probe = gst_libcamera_provider_probe;
 
 	gst_device_provider_class_set_metadata(provider_class,
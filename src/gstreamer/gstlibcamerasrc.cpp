@@ -15,20 +15,20 @@
  *    + Evaluate if a single streaming thread is fine
  *  - Add application driven request (snapshot)
  *  - Add framerate control
- *  - Add buffer importation support
  *
  *  Requires new libcamera API:
  *  - Add framerate negotiation support
  *  - Add colorimetry support
- *  - Add timestamp support
  *  - Use unique names to select the camera devices
  *  - Add GstVideoMeta support (strides and offsets)
  */
 
 #include "gstlibcamerasrc.h"
 
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <queue>
+#include <utility>
 #include <vector>
 
 #include <libcamera/camera.h>
@@ -38,8 +38,10 @@
 #include <gst/base/base.h>
 
 #include "gstlibcameraallocator.h"
+#include "gstlibcamerameta.h"
 #include "gstlibcamerapad.h"
 #include "gstlibcamerapool.h"
+#include "gstlibcamerasyncgroup.h"
 #include "gstlibcamera-utils.h"
 
 using namespace libcamera;
@@ -48,27 +50,39 @@ GST_DEBUG_CATEGORY_STATIC(source_debug);
 #define GST_CAT_DEFAULT source_debug
 
 struct RequestWrap {
-	RequestWrap(std::unique_ptr<Request> request);
+	RequestWrap(Camera *camera);
 	~RequestWrap();
 
 	void attachBuffer(Stream *stream, GstBuffer *buffer);
 	GstBuffer *detachBuffer(Stream *stream);
+	void recycle();
 
 	std::unique_ptr<Request> request_;
-	std::map<Stream *, GstBuffer *> buffers_;
+	/*
+	 * The number of streams is small, a flat array is cheaper than a map
+	 * and keeps its storage when the wrap is recycled.
+	 */
+	std::vector<std::pair<Stream *, GstBuffer *>> buffers_;
 
 	GstClockTime latency_;
 	GstClockTime pts_;
+	GstClockTime frameDuration_;
+	int64_t sensorTimestamp_;
+	/* Number of requests still queued to the camera at completion time. */
+	size_t queueDepth_;
 };
 
-RequestWrap::RequestWrap(std::unique_ptr<Request> request)
-	: request_(std::move(request)), latency_(0), pts_(GST_CLOCK_TIME_NONE)
+RequestWrap::RequestWrap(Camera *camera)
+	: latency_(0), pts_(GST_CLOCK_TIME_NONE), frameDuration_(0),
+	  sensorTimestamp_(0), queueDepth_(0)
 {
+	/* The cookie lets the completion handler retrieve the wrap. */
+	request_ = camera->createRequest(reinterpret_cast<uint64_t>(this));
 }
 
 RequestWrap::~RequestWrap()
 {
-	for (std::pair<Stream *const, GstBuffer *> &item : buffers_) {
+	for (std::pair<Stream *, GstBuffer *> &item : buffers_) {
 		if (item.second)
 			gst_buffer_unref(item.second);
 	}
@@ -80,28 +94,94 @@ void RequestWrap::attachBuffer(Stream *stream, GstBuffer *buffer)
 
 	request_->addBuffer(stream, fb);
 
-	auto item = buffers_.find(stream);
-	if (item != buffers_.end()) {
-		gst_buffer_unref(item->second);
-		item->second = buffer;
-	} else {
-		buffers_[stream] = buffer;
+	for (std::pair<Stream *, GstBuffer *> &item : buffers_) {
+		if (item.first != stream)
+			continue;
+
+		if (item.second)
+			gst_buffer_unref(item.second);
+		item.second = buffer;
+		return;
 	}
+
+	buffers_.emplace_back(stream, buffer);
 }
 
 GstBuffer *RequestWrap::detachBuffer(Stream *stream)
 {
-	GstBuffer *buffer = nullptr;
+	for (std::pair<Stream *, GstBuffer *> &item : buffers_) {
+		if (item.first == stream)
+			return std::exchange(item.second, nullptr);
+	}
+
+	return nullptr;
+}
 
-	auto item = buffers_.find(stream);
-	if (item != buffers_.end()) {
-		buffer = item->second;
-		item->second = nullptr;
+/* Release the buffers and prepare the wrap to be queued again. */
+void RequestWrap::recycle()
+{
+	for (std::pair<Stream *, GstBuffer *> &item : buffers_) {
+		if (item.second)
+			gst_buffer_unref(item.second);
 	}
 
-	return buffer;
+	buffers_.clear();
+	request_->reuse();
+
+	latency_ = 0;
+	pts_ = GST_CLOCK_TIME_NONE;
+	frameDuration_ = 0;
+	sensorTimestamp_ = 0;
+	queueDepth_ = 0;
 }
 
+/*
+ * Single-producer single-consumer ring of completed requests, between the
+ * libcamera completion handler and the streaming thread. The ring size bounds
+ * the number of RequestWrap instances, it can thus never overflow.
+ */
+class RequestRing
+{
+public:
+	static constexpr size_t kSize = 32;
+
+	void push(RequestWrap *wrap)
+	{
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		entries_[tail % kSize] = wrap;
+		tail_.store(tail + 1, std::memory_order_release);
+	}
+
+	RequestWrap *front() const
+	{
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tail_.load(std::memory_order_acquire))
+			return nullptr;
+
+		return entries_[head % kSize];
+	}
+
+	RequestWrap *pop()
+	{
+		RequestWrap *wrap = front();
+		if (wrap)
+			head_.store(head_.load(std::memory_order_relaxed) + 1,
+				    std::memory_order_release);
+		return wrap;
+	}
+
+	bool empty() const
+	{
+		return head_.load(std::memory_order_acquire) ==
+		       tail_.load(std::memory_order_acquire);
+	}
+
+private:
+	std::array<RequestWrap *, kSize> entries_;
+	std::atomic<size_t> head_ = 0;
+	std::atomic<size_t> tail_ = 0;
+};
+
 /* Used for C++ object with destructors. */
 struct GstLibcameraSrcState {
 	GstLibcameraSrc *src_;
@@ -113,26 +193,59 @@ struct GstLibcameraSrcState {
 	std::vector<GstPad *> srcpads_; /* Protected by stream_lock */
 
 	/*
-	 * Contention on this lock_ must be minimized, as it has to be taken in
-	 * the realtime-sensitive requestCompleted() handler to protect
-	 * queuedRequests_ and completedRequests_.
-	 *
+	 * Caps of the formats supported by each stream of config_, computed
+	 * once per configuration and reused on renegotiation. Protected by
+	 * stream_lock.
+	 */
+	std::vector<GstCaps *> formatsCaps_;
+
+	/*
+	 * The realtime-sensitive requestCompleted() handler doesn't take any
+	 * lock. It only decrements queuedRequests_ and pushes the request to
+	 * the completedRequests_ ring, consumed by the streaming thread.
+	 */
+	std::atomic<unsigned int> queuedRequests_ = 0;
+	RequestRing completedRequests_;
+
+	/*
+	 * All the RequestWrap instances, and the ones not queued to the
+	 * camera. Protected by stream_lock.
+	 */
+	std::vector<std::unique_ptr<RequestWrap>> requestWraps_;
+	std::vector<RequestWrap *> freeRequests_;
+
+	/*
 	 * stream_lock must be taken before lock_ in contexts where both locks
 	 * need to be taken. In particular, this means that the lock_ must not
 	 * be held while calling into other graph elements (e.g. when calling
 	 * gst_pad_query()).
 	 */
 	GMutex lock_;
-	std::queue<std::unique_ptr<RequestWrap>> queuedRequests_;
-	std::queue<std::unique_ptr<RequestWrap>> completedRequests_;
+
+	/*
+	 * Downstream pools whose buffers are imported, kept to unblock the
+	 * streaming thread when stopping. Protected by lock_.
+	 */
+	std::vector<GstBufferPool *> downstreamPools_;
 
 	ControlList initControls_;
 	guint group_id_;
+	/* Maximum number of requests queued to the camera, 0 for no limit. */
+	guint queueDepth_; /* Protected by stream_lock */
+
+	/* Group of cameras whose frames are matched by timestamp. */
+	GstLibcameraSyncGroup *syncGroup_; /* Protected by stream_lock */
+	GstClockTime syncTolerance_; /* Protected by stream_lock */
 
 	int queueRequest();
 	void requestCompleted(Request *request);
 	int processRequest();
+	void releaseRequest(RequestWrap *wrap);
 	void clearRequests();
+	void clearDownstreamPools();
+	void flushDownstreamPools();
+	void updateFormatsCaps();
+	void clearFormatsCaps();
 };
 
 struct _GstLibcameraSrc {
@@ -143,6 +256,10 @@ struct _GstLibcameraSrc {
 
 	gchar *camera_name;
 	controls::AfModeEnum auto_focus_mode = controls::AfModeManual;
+	guint buffer_count;
+	guint queue_depth;
+	gchar *sync_group;
+	guint64 sync_tolerance;
 
 	std::atomic<GstEvent *> pending_eos;
 
@@ -155,6 +272,10 @@ enum {
 	PROP_0,
 	PROP_CAMERA_NAME,
 	PROP_AUTO_FOCUS_MODE,
+	PROP_BUFFER_COUNT,
+	PROP_QUEUE_DEPTH,
+	PROP_SYNC_GROUP,
+	PROP_SYNC_TOLERANCE,
 };
 
 G_DEFINE_TYPE_WITH_CODE(GstLibcameraSrc, gst_libcamera_src, GST_TYPE_ELEMENT,
@@ -176,12 +297,35 @@ GstStaticPadTemplate request_src_template = {
 /* Must be called with stream_lock held. */
 int GstLibcameraSrcState::queueRequest()
 {
-	std::unique_ptr<Request> request = cam_->createRequest();
-	if (!request)
-		return -ENOMEM;
+	if (queueDepth_ && queuedRequests_.load() >= queueDepth_)
+		return -ENOBUFS;
+
+	/* Reuse a free RequestWrap, or create one if the ring permits. */
+	RequestWrap *wrap;
+	if (!freeRequests_.empty()) {
+		wrap = freeRequests_.back();
+		freeRequests_.pop_back();
+	} else {
+		if (requestWraps_.size() >= RequestRing::kSize)
+			return -ENOBUFS;
+
+		auto newWrap = std::make_unique<RequestWrap>(cam_.get());
+		if (!newWrap->request_)
+			return -ENOMEM;
 
-	std::unique_ptr<RequestWrap> wrap =
-		std::make_unique<RequestWrap>(std::move(request));
+		wrap = newWrap.get();
+		requestWraps_.push_back(std::move(newWrap));
+	}
+
+	/*
+	 * Buffers imported from downstream are released to the downstream
+	 * pool, which doesn't resume the task. Only wait for a buffer when no
+	 * request is in flight, the task is otherwise resumed when the next
+	 * request completes.
+	 */
+	GstBufferPoolAcquireParams params = {};
+	if (queuedRequests_.load() || !completedRequests_.empty())
+		params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
 
 	for (GstPad *srcpad : srcpads_) {
 		Stream *stream = gst_libcamera_pad_get_stream(srcpad);
@@ -190,12 +334,13 @@ int GstLibcameraSrcState::queueRequest()
 		GstFlowReturn ret;
 
 		ret = gst_buffer_pool_acquire_buffer(GST_BUFFER_POOL(pool),
-						     &buffer, nullptr);
+						     &buffer, &params);
 		if (ret != GST_FLOW_OK) {
 			/*
-			 * RequestWrap has ownership of the request, and we
-			 * won't be queueing this one due to lack of buffers.
+			 * We won't be queueing this request due to lack of
+			 * buffers, return the wrap to the free list.
 			 */
+			releaseRequest(wrap);
 			return -ENOBUFS;
 		}
 
@@ -203,14 +348,20 @@ int GstLibcameraSrcState::queueRequest()
 	}
 
 	GST_TRACE_OBJECT(src_, "Requesting buffers");
-	cam_->queueRequest(wrap->request_.get());
 
-	{
-		GLibLocker locker(&lock_);
-		queuedRequests_.push(std::move(wrap));
+	/*
+	 * Account for the request before queuing it, as it may complete
+	 * before queueRequest() returns.
+	 */
+	queuedRequests_++;
+	int ret = cam_->queueRequest(wrap->request_.get());
+	if (ret) {
+		queuedRequests_--;
+		releaseRequest(wrap);
+		return ret;
 	}
 
-	/* The RequestWrap will be deleted in the completion handler. */
+	/* The RequestWrap will be recycled after completion. */
 	return 0;
 }
 
@@ -219,23 +370,22 @@ GstLibcameraSrcState::requestCompleted(Request *request)
 {
 	GST_DEBUG_OBJECT(src_, "buffers are ready");
 
-	std::unique_ptr<RequestWrap> wrap;
-
-	{
-		GLibLocker locker(&lock_);
-		wrap = std::move(queuedRequests_.front());
-		queuedRequests_.pop();
-	}
-
-	g_return_if_fail(wrap->request_.get() == request);
+	auto *wrap = reinterpret_cast<RequestWrap *>(request->cookie());
+	wrap->queueDepth_ = --queuedRequests_;
+	wrap->sensorTimestamp_ = request->metadata().get(controls::SensorTimestamp).value_or(0);
 
+	/*
+	 * Cancelled requests are recycled by the streaming thread, which owns
+	 * the RequestWrap instances.
+	 */
 	if ((request->status() == Request::RequestCancelled)) {
 		GST_DEBUG_OBJECT(src_, "Request was cancelled");
+		completedRequests_.push(wrap);
 		return;
 	}
 
 	if (GST_ELEMENT_CLOCK(src_)) {
-		int64_t timestamp = request->metadata().get(controls::SensorTimestamp).value_or(0);
+		int64_t timestamp = wrap->sensorTimestamp_;
 
 		GstClockTime gst_base_time = GST_ELEMENT(src_)->base_time;
 		GstClockTime gst_now = gst_clock_get_time(GST_ELEMENT_CLOCK(src_));
@@ -248,10 +398,11 @@ GstLibcameraSrcState::requestCompleted(Request *request)
 		wrap->latency_ = sys_now - timestamp;
 	}
 
-	{
-		GLibLocker locker(&lock_);
-		completedRequests_.push(std::move(wrap));
-	}
+	const auto &frameDuration = request->metadata().get(controls::FrameDuration);
+	if (frameDuration)
+		wrap->frameDuration_ = *frameDuration * GST_USECOND;
+
+	completedRequests_.push(wrap);
 
 	gst_task_resume(src_->task);
 }
@@ -259,23 +410,40 @@ GstLibcameraSrcState::requestCompleted(Request *request)
 /* Must be called with stream_lock held. */
 int GstLibcameraSrcState::processRequest()
 {
-	std::unique_ptr<RequestWrap> wrap;
-	int err = 0;
+	RequestWrap *wrap = completedRequests_.front();
+	if (!wrap)
+		return -ENOBUFS;
 
-	{
-		GLibLocker locker(&lock_);
+	/*
+	 * When synchronizing with other cameras, only push the frames matched
+	 * with a frame of every other camera. A waiting task is resumed by the
+	 * group when another camera makes progress.
+	 */
+	if (syncGroup_ && wrap->request_->status() != Request::RequestCancelled) {
+		GstLibcameraSyncResult result =
+			gst_libcamera_sync_group_check(syncGroup_, src_->task,
+						       wrap->sensorTimestamp_,
+						       syncTolerance_);
+		if (result == GstLibcameraSyncResult::Wait)
+			return -ENOBUFS;
 
-		if (!completedRequests_.empty()) {
-			wrap = std::move(completedRequests_.front());
+		if (result == GstLibcameraSyncResult::Drop) {
+			GST_DEBUG_OBJECT(src_, "Dropping unmatched frame %" G_GINT64_FORMAT,
+					 wrap->sensorTimestamp_);
 			completedRequests_.pop();
+			releaseRequest(wrap);
+			return completedRequests_.empty() ? -ENOBUFS : 0;
 		}
-
-		if (completedRequests_.empty())
-			err = -ENOBUFS;
 	}
 
-	if (!wrap)
-		return -ENOBUFS;
+	completedRequests_.pop();
+
+	int err = completedRequests_.empty() ? -ENOBUFS : 0;
+
+	if (wrap->request_->status() == Request::RequestCancelled) {
+		releaseRequest(wrap);
+		return err;
+	}
 
 	GstFlowReturn ret = GST_FLOW_OK;
 	gst_flow_combiner_reset(src_->flow_combiner);
@@ -288,7 +456,9 @@ int GstLibcameraSrcState::processRequest()
 
 		if (GST_CLOCK_TIME_IS_VALID(wrap->pts_)) {
 			GST_BUFFER_PTS(buffer) = wrap->pts_;
-			gst_libcamera_pad_set_latency(srcpad, wrap->latency_);
+			gst_libcamera_pad_set_latency(srcpad, wrap->latency_,
+						      wrap->latency_ +
+						      wrap->queueDepth_ * wrap->frameDuration_);
 		} else {
 			GST_BUFFER_PTS(buffer) = 0;
 		}
@@ -296,6 +466,20 @@ int GstLibcameraSrcState::processRequest()
 		GST_BUFFER_OFFSET(buffer) = fb->metadata().sequence;
 		GST_BUFFER_OFFSET_END(buffer) = fb->metadata().sequence;
 
+		/*
+		 * Expose the frame metadata, and the sensor timestamp as a
+		 * reference timestamp for elements unaware of the libcamera
+		 * meta.
+		 */
+		gst_buffer_add_libcamera_meta(buffer, fb->metadata().sequence,
+					      wrap->request_->metadata());
+		if (wrap->sensorTimestamp_) {
+			g_autoptr(GstCaps) caps = gst_libcamera_sensor_timestamp_caps();
+			gst_buffer_add_reference_timestamp_meta(buffer, caps,
+								wrap->sensorTimestamp_,
+								GST_CLOCK_TIME_NONE);
+		}
+
 		ret = gst_pad_push(srcpad, buffer);
 		ret = gst_flow_combiner_update_pad_flow(src_->flow_combiner,
 							srcpad, ret);
@@ -343,13 +527,60 @@ int GstLibcameraSrcState::processRequest()
 		break;
 	}
 
+	releaseRequest(wrap);
+
 	return err;
 }
 
+/* Must be called with stream_lock held. */
+void GstLibcameraSrcState::releaseRequest(RequestWrap *wrap)
+{
+	wrap->recycle();
+	freeRequests_.push_back(wrap);
+}
+
+/* Must be called with stream_lock held, after stopping the camera. */
 void GstLibcameraSrcState::clearRequests()
+{
+	while (RequestWrap *wrap = completedRequests_.pop())
+		releaseRequest(wrap);
+}
+
+void GstLibcameraSrcState::clearDownstreamPools()
+{
+	GLibLocker locker(&lock_);
+
+	for (GstBufferPool *pool : downstreamPools_)
+		gst_object_unref(pool);
+
+	downstreamPools_.clear();
+}
+
+/* Must be called with stream_lock held. */
+void GstLibcameraSrcState::updateFormatsCaps()
+{
+	clearFormatsCaps();
+
+	for (const StreamConfiguration &stream_cfg : *config_)
+		formatsCaps_.push_back(gst_libcamera_stream_formats_to_caps(stream_cfg.formats()));
+}
+
+/* Must be called with stream_lock held. */
+void GstLibcameraSrcState::clearFormatsCaps()
+{
+	for (GstCaps *caps : formatsCaps_)
+		gst_caps_unref(caps);
+
+	formatsCaps_.clear();
+}
+
+/* Wake up the streaming thread if it waits for a downstream buffer. */
+void GstLibcameraSrcState::flushDownstreamPools()
 {
 	GLibLocker locker(&lock_);
-	completedRequests_ = {};
+
+	for (GstBufferPool *pool : downstreamPools_)
+		gst_buffer_pool_set_flushing(pool, TRUE);
 }
 
 static bool
@@ -414,6 +645,68 @@ gst_libcamera_src_open(GstLibcameraSrc *self)
 	return true;
 }
 
+/*
+ * Query the downstream allocation for a pool of dma-buf buffers that can be
+ * imported in the camera, to avoid copies in the downstream elements.
+ *
+ * Must be called with stream_lock held.
+ */
+static GstLibcameraPool *
+gst_libcamera_src_create_import_pool(GstLibcameraSrc *self, GstPad *srcpad,
+				     const StreamConfiguration &stream_cfg)
+{
+	g_autoptr(GstCaps) caps = gst_pad_get_current_caps(srcpad);
+	if (!caps)
+		return nullptr;
+
+	g_autoptr(GstQuery) query = gst_query_new_allocation(caps, TRUE);
+	if (!gst_pad_peer_query(srcpad, query) ||
+	    !gst_query_get_n_allocation_pools(query))
+		return nullptr;
+
+	g_autoptr(GstBufferPool) downstream = nullptr;
+	guint size, min, max;
+	gst_query_parse_nth_allocation_pool(query, 0, &downstream, &size, &min, &max);
+	if (!downstream)
+		return nullptr;
+
+	/* Reserve the buffers needed by the camera on top of downstream's. */
+	guint count = min + stream_cfg.bufferCount;
+	if (max)
+		count = std::min(count, max);
+
+	GstStructure *config = gst_buffer_pool_get_config(downstream);
+	gst_buffer_pool_config_set_params(config, caps,
+					  std::max<guint>(size, stream_cfg.frameSize),
+					  count, max);
+	if (gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, nullptr))
+		gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+	if (!gst_buffer_pool_set_config(downstream, config) ||
+	    !gst_buffer_pool_set_active(downstream, TRUE)) {
+		GST_DEBUG_OBJECT(self, "Failed to configure downstream pool %" GST_PTR_FORMAT,
+				 downstream);
+		return nullptr;
+	}
+
+	GstLibcameraPool *pool = gst_libcamera_pool_new_import(downstream, stream_cfg, caps);
+	if (!pool) {
+		GST_DEBUG_OBJECT(self, "Can't import buffers from pool %" GST_PTR_FORMAT,
+				 downstream);
+		return nullptr;
+	}
+
+	GST_INFO_OBJECT(self, "Importing buffers from pool %" GST_PTR_FORMAT,
+			downstream);
+
+	{
+		GLibLocker locker(&self->state->lock_);
+		self->state->downstreamPools_.push_back(GST_BUFFER_POOL(gst_object_ref(downstream)));
+	}
+
+	return pool;
+}
+
 /* Must be called with stream_lock held. */
 static bool
 gst_libcamera_src_negotiate(GstLibcameraSrc *self)
@@ -422,12 +715,23 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 
 	g_autoptr(GstStructure) element_caps = gst_structure_new_empty("caps");
 
+	guint buffer_count;
+	{
+		GLibLocker lock(GST_OBJECT(self));
+		buffer_count = self->buffer_count;
+		state->queueDepth_ = self->queue_depth;
+	}
+
 	for (gsize i = 0; i < state->srcpads_.size(); i++) {
 		GstPad *srcpad = state->srcpads_[i];
 		StreamConfiguration &stream_cfg = state->config_->at(i);
 
+		/* Override the default number of buffers if requested. */
+		if (buffer_count)
+			stream_cfg.bufferCount = buffer_count;
+
 		/* Retrieve the supported caps. */
-		g_autoptr(GstCaps) filter = gst_libcamera_stream_formats_to_caps(stream_cfg.formats());
+		GstCaps *filter = state->formatsCaps_[i];
 		g_autoptr(GstCaps) caps = gst_pad_peer_query_caps(srcpad, filter);
 		if (gst_caps_is_empty(caps))
 			return false;
@@ -442,6 +746,12 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 	if (state->config_->validate() == CameraConfiguration::Invalid)
 		return false;
 
+	for (const StreamConfiguration &stream_cfg : *state->config_) {
+		if (buffer_count && stream_cfg.bufferCount != buffer_count)
+			GST_WARNING_OBJECT(self, "Buffer count adjusted to %u by the camera",
+					   stream_cfg.bufferCount);
+	}
+
 	int ret = state->cam_->configure(state->config_.get());
 	if (ret) {
 		GST_ELEMENT_ERROR(self, RESOURCE, SETTINGS,
@@ -480,12 +790,28 @@ gst_libcamera_src_negotiate(GstLibcameraSrc *self)
 		return false;
 	}
 
+	/*
+	 * Release the previous pools first, downstream may propose the same
+	 * pool again, which can only be reconfigured once deactivated.
+	 */
+	for (GstPad *srcpad : state->srcpads_)
+		gst_libcamera_pad_set_pool(srcpad, nullptr);
+	state->clearDownstreamPools();
+
 	for (gsize i = 0; i < state->srcpads_.size(); i++) {
 		GstPad *srcpad = state->srcpads_[i];
 		const StreamConfiguration &stream_cfg = state->config_->at(i);
 
-		GstLibcameraPool *pool = gst_libcamera_pool_new(self->allocator,
-								stream_cfg.stream());
+		/*
+		 * Import the downstream buffers when possible, and fall back
+		 * to the buffers allocated by libcamera otherwise.
+		 */
+		GstLibcameraPool *pool =
+			gst_libcamera_src_create_import_pool(self, srcpad, stream_cfg);
+		if (!pool)
+			pool = gst_libcamera_pool_new(self->allocator,
+						      stream_cfg.stream());
+
 		g_signal_connect_swapped(pool, "buffer-notify",
 					 G_CALLBACK(gst_task_resume), self->task);
 
@@ -641,6 +967,8 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 	}
 	g_assert(state->config_->size() == state->srcpads_.size());
 
+	state->updateFormatsCaps();
+
 	if (!gst_libcamera_src_negotiate(self)) {
 		state->initControls_.clear();
 		GST_ELEMENT_FLOW_ERROR(self, GST_FLOW_NOT_NEGOTIATED);
@@ -670,6 +998,15 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 		}
 	}
 
+	{
+		GLibLocker lock(GST_OBJECT(self));
+		if (self->sync_group) {
+			state->syncGroup_ = gst_libcamera_sync_group_join(self->sync_group,
+									  self->task);
+			state->syncTolerance_ = self->sync_tolerance;
+		}
+	}
+
 	ret = state->cam_->start(&state->initControls_);
 	if (ret) {
 		GST_ELEMENT_ERROR(self, RESOURCE, SETTINGS,
@@ -691,14 +1028,24 @@ gst_libcamera_src_task_leave([[maybe_unused]] GstTask *task,
 	GST_DEBUG_OBJECT(self, "Streaming thread is about to stop");
 
 	state->cam_->stop();
-	state->clearRequests();
 
 	{
 		GLibRecLocker locker(&self->stream_lock);
+
+		if (state->syncGroup_) {
+			gst_libcamera_sync_group_leave(state->syncGroup_, self->task);
+			state->syncGroup_ = nullptr;
+		}
+
+		state->clearRequests();
+		state->freeRequests_.clear();
+		state->requestWraps_.clear();
+
 		for (GstPad *srcpad : state->srcpads_)
 			gst_libcamera_pad_set_pool(srcpad, nullptr);
 	}
 
+	state->clearDownstreamPools();
 	g_clear_object(&self->allocator);
 	g_clear_pointer(&self->flow_combiner,
 			(GDestroyNotify)gst_flow_combiner_free);
@@ -712,6 +1059,7 @@ gst_libcamera_src_close(GstLibcameraSrc *self)
 
 	GST_DEBUG_OBJECT(self, "Releasing resources");
 
+	state->clearFormatsCaps();
 	state->config_.reset();
 
 	ret = state->cam_->release();
@@ -740,6 +1088,19 @@ gst_libcamera_src_set_property(GObject *object, guint prop_id,
 	case PROP_AUTO_FOCUS_MODE:
 		self->auto_focus_mode = static_cast<controls::AfModeEnum>(g_value_get_enum(value));
 		break;
+	case PROP_BUFFER_COUNT:
+		self->buffer_count = g_value_get_uint(value);
+		break;
+	case PROP_QUEUE_DEPTH:
+		self->queue_depth = g_value_get_uint(value);
+		break;
+	case PROP_SYNC_GROUP:
+		g_free(self->sync_group);
+		self->sync_group = g_value_dup_string(value);
+		break;
+	case PROP_SYNC_TOLERANCE:
+		self->sync_tolerance = g_value_get_uint64(value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -760,6 +1121,18 @@ gst_libcamera_src_get_property(GObject *object, guint prop_id, GValue *value,
 	case PROP_AUTO_FOCUS_MODE:
 		g_value_set_enum(value, static_cast<gint>(self->auto_focus_mode));
 		break;
+	case PROP_BUFFER_COUNT:
+		g_value_set_uint(value, self->buffer_count);
+		break;
+	case PROP_QUEUE_DEPTH:
+		g_value_set_uint(value, self->queue_depth);
+		break;
+	case PROP_SYNC_GROUP:
+		g_value_set_string(value, self->sync_group);
+		break;
+	case PROP_SYNC_TOLERANCE:
+		g_value_set_uint64(value, self->sync_tolerance);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -803,6 +1176,7 @@ gst_libcamera_src_change_state(GstElement *element, GstStateChange transition)
 		 * before pad deactivation, so before chaining to the parent
 		 * change_state function.
 		 */
+		self->state->flushDownstreamPools();
 		gst_task_join(self->task);
 		break;
 	case GST_STATE_CHANGE_READY_TO_NULL:
@@ -846,6 +1220,7 @@ gst_libcamera_src_finalize(GObject *object)
 	g_clear_object(&self->task);
 	g_mutex_clear(&self->state->lock_);
 	g_free(self->camera_name);
+	g_free(self->sync_group);
 	delete self->state;
 
 	return klass->finalize(object);
@@ -964,4 +1339,44 @@ gst_libcamera_src_class_init(GstLibcameraSrcClass *klass)
 				 static_cast<gint>(controls::AfModeManual),
 				 G_PARAM_WRITABLE);
 	g_object_class_install_property(object_class, PROP_AUTO_FOCUS_MODE, spec);
+
+	spec = g_param_spec_uint("buffer-count", "Buffer Count",
+				 "Number of buffers allocated per stream, "
+				 "0 for the camera default",
+				 0, G_MAXUINT, 0,
+				 (GParamFlags)(GST_PARAM_MUTABLE_READY
+					       | G_PARAM_CONSTRUCT
+					       | G_PARAM_READWRITE
+					       | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_BUFFER_COUNT, spec);
+
+	spec = g_param_spec_uint("queue-depth", "Queue Depth",
+				 "Maximum number of requests queued to the camera, "
+				 "0 to queue as many as buffers allow",
+				 0, G_MAXUINT, 0,
+				 (GParamFlags)(GST_PARAM_MUTABLE_READY
+					       | G_PARAM_CONSTRUCT
+					       | G_PARAM_READWRITE
+					       | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_QUEUE_DEPTH, spec);
+
+	spec = g_param_spec_string("sync-group", "Sync Group",
+				   "Name of a group of libcamerasrc elements whose "
+				   "frames are matched by sensor timestamp",
+				   nullptr,
+				   (GParamFlags)(GST_PARAM_MUTABLE_READY
+						 | G_PARAM_CONSTRUCT
+						 | G_PARAM_READWRITE
+						 | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_SYNC_GROUP, spec);
+
+	spec = g_param_spec_uint64("sync-tolerance", "Sync Tolerance",
+				   "Maximum sensor timestamp difference of matched "
+				   "frames in the sync group, in nanoseconds",
+				   0, G_MAXUINT64, GST_MSECOND,
+				   (GParamFlags)(GST_PARAM_MUTABLE_READY
+						 | G_PARAM_CONSTRUCT
+						 | G_PARAM_READWRITE
+						 | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_SYNC_TOLERANCE, spec);
 }
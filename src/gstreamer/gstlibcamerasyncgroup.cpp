@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Collabora Ltd.
+ *
+ * GStreamer Multi-Camera Synchronization Group
+ */
+
+#include "gstlibcamerasyncgroup.h"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gstlibcamera-utils.h"
+
+/**
+ * \struct GstLibcameraSyncGroup
+ * \brief Match the frames of several libcamerasrc elements by timestamp
+ *
+ * The libcamerasrc elements that share a synchronization group name only push
+ * the frames whose sensor timestamps match, within a tolerance, a frame from
+ * every other element of the group. Each element submits the timestamp of its
+ * oldest completed frame, and is told to emit it, to drop it as a newer frame
+ * from another camera makes a match impossible, or to wait for the other
+ * cameras to catch up.
+ *
+ * Once a match is found, all members are marked as matched and the group
+ * waits for each of them to emit its frame before the next match is computed.
+ * The streaming tasks of the other members are resumed whenever the state of
+ * the group changes, as a waiting task pauses until then.
+ */
+struct GstLibcameraSyncGroup {
+	struct Member {
+		/* Timestamp of the oldest completed frame, -1 when unknown. */
+		int64_t head = -1;
+		bool matched = false;
+	};
+
+	std::string name;
+	unsigned int refcount = 0;
+
+	GMutex lock;
+	std::map<GstTask *, Member> members; /* Protected by lock */
+};
+
+static GMutex groups_lock;
+static std::map<std::string, GstLibcameraSyncGroup *> groups; /* Protected by groups_lock */
+
+static void
+gst_libcamera_sync_group_resume(const std::vector<GstTask *> &tasks)
+{
+	for (GstTask *task : tasks)
+		gst_task_resume(task);
+}
+
+GstLibcameraSyncGroup *
+gst_libcamera_sync_group_join(const gchar *name, GstTask *task)
+{
+	GLibLocker locker(&groups_lock);
+
+	GstLibcameraSyncGroup *&group = groups[name];
+	if (!group) {
+		group = new GstLibcameraSyncGroup();
+		group->name = name;
+		g_mutex_init(&group->lock);
+	}
+
+	group->refcount++;
+
+	GLibLocker groupLocker(&group->lock);
+	group->members[task] = {};
+
+	return group;
+}
+
+void
+gst_libcamera_sync_group_leave(GstLibcameraSyncGroup *group, GstTask *task)
+{
+	std::vector<GstTask *> others;
+
+	{
+		GLibLocker locker(&groups_lock);
+
+		{
+			GLibLocker groupLocker(&group->lock);
+			group->members.erase(task);
+
+			/* A pending match can't complete without this member. */
+			for (auto &[other, member] : group->members) {
+				member.matched = false;
+				others.push_back(other);
+			}
+		}
+
+		if (--group->refcount == 0) {
+			groups.erase(group->name);
+			g_mutex_clear(&group->lock);
+			delete group;
+			return;
+		}
+	}
+
+	gst_libcamera_sync_group_resume(others);
+}
+
+GstLibcameraSyncResult
+gst_libcamera_sync_group_check(GstLibcameraSyncGroup *group, GstTask *task,
+			       int64_t timestamp, GstClockTime tolerance)
+{
+	GstLibcameraSyncResult result = GstLibcameraSyncResult::Wait;
+	std::vector<GstTask *> others;
+	int64_t tol = static_cast<int64_t>(tolerance);
+	bool changed;
+
+	{
+		GLibLocker locker(&group->lock);
+
+		GstLibcameraSyncGroup::Member &self = group->members[task];
+
+		changed = self.head != timestamp;
+
+		for (const auto &[other, member] : group->members) {
+			if (other != task)
+				others.push_back(other);
+		}
+
+		if (self.matched && self.head == timestamp) {
+			/* The frame has been matched, emit it. */
+			self.matched = false;
+			self.head = -1;
+			result = GstLibcameraSyncResult::Emit;
+		} else {
+			self.matched = false;
+			self.head = timestamp;
+
+			bool pending = false;
+			bool complete = true;
+			int64_t newest = timestamp;
+
+			for (const auto &[other, member] : group->members) {
+				pending |= member.matched;
+				complete &= member.head >= 0;
+				newest = std::max(newest, member.head);
+			}
+
+			if (pending) {
+				/* Wait for the other members to emit the last match. */
+				result = GstLibcameraSyncResult::Wait;
+			} else if (timestamp + tol < newest) {
+				/* Another camera is ahead, this frame can't be matched. */
+				self.head = -1;
+				result = GstLibcameraSyncResult::Drop;
+			} else if (complete &&
+				   std::all_of(group->members.begin(), group->members.end(),
+					       [&](const auto &item) {
+						       return item.second.head + tol >= newest;
+					       })) {
+				for (auto &[other, member] : group->members) {
+					if (other != task)
+						member.matched = true;
+				}
+
+				self.head = -1;
+				result = GstLibcameraSyncResult::Emit;
+			}
+		}
+	}
+
+	/*
+	 * Waiting with an unchanged frame doesn't affect the other members,
+	 * don't resume them to avoid spinning.
+	 */
+	if (changed || result != GstLibcameraSyncResult::Wait)
+		gst_libcamera_sync_group_resume(others);
+
+	return result;
+}
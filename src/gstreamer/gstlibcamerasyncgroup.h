@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Collabora Ltd.
+ *
+ * GStreamer Multi-Camera Synchronization Group
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <gst/gst.h>
+
+struct GstLibcameraSyncGroup;
+
+enum class GstLibcameraSyncResult {
+	Emit,
+	Drop,
+	Wait,
+};
+
+GstLibcameraSyncGroup *gst_libcamera_sync_group_join(const gchar *name,
+						     GstTask *task);
+
+void gst_libcamera_sync_group_leave(GstLibcameraSyncGroup *group,
+				    GstTask *task);
+
+GstLibcameraSyncResult gst_libcamera_sync_group_check(GstLibcameraSyncGroup *group,
+						      GstTask *task,
+						      int64_t timestamp,
+						      GstClockTime tolerance);
@@ -21,6 +21,7 @@
 
 #include <libcamera/base/log.h>
 
+#include <libcamera/control_ids.h>
 #include <libcamera/ipa/core_ipa_interface.h>
 
 #include "libipa/histogram.h"
@@ -81,6 +82,9 @@ static constexpr uint32_t kIgnoreFrame = 10;
 /* Fine scan range 0 < kFineRange < 1 */
 static constexpr double kFineRange = 0.05;
 
+/* Half width of the fine scan range around the predicted peak */
+static constexpr uint32_t kPredictedFineRange = kCoarseSearchStep / 4;
+
 /* Settings for IPU3 AF filter */
 static struct ipu3_uapi_af_filter_config afFilterConfigDefault = {
 	.y1_coeff_0 = { 0, 1, 3, 7 },
@@ -106,13 +110,32 @@ static struct ipu3_uapi_af_filter_config afFilterConfigDefault = {
  * blurred one. Therefore, if an image with the highest contrast can be
  * found through the scan, the position of the len indicates to a clearest
  * image.
+ *
+ * The speed of the scan is selected with the AfSpeed control. In the normal
+ * mode, the fine scan covers a range proportional to the focus position found
+ * by the coarse scan. In the fast mode, the variance samples around the
+ * coarse scan maximum are used to predict the position of the peak, and the
+ * fine scan is restricted to a narrow range around the prediction.
  */
 Af::Af()
-	: focus_(0), bestFocus_(0), currentVariance_(0.0), previousVariance_(0.0),
-	  coarseCompleted_(false), fineCompleted_(false)
+	: focus_(0), bestFocus_(0), currentVariance_(0.0), lensState_(false),
+	  lensMoving_(false), previousVariance_(0.0), lowerVariance_(0.0),
+	  coarseCompleted_(false), fineCompleted_(false), scanFrames_(0)
 {
 }
 
+/**
+ * \copydoc libcamera::ipa::Algorithm::init
+ */
+int Af::init(IPAContext &context, [[maybe_unused]] const YamlObject &tuningData)
+{
+	context.ctrlMap[&controls::AfSpeed] =
+		ControlInfo(controls::AfSpeedValues,
+			    static_cast<int32_t>(controls::AfSpeedNormal));
+
+	return 0;
+}
+
 /**
  * \brief Configure the Af given a configInfo
  * \param[in] context The shared IPA context
@@ -171,16 +194,39 @@ int Af::configure(IPAContext &context, const IPAConfigInfo &configInfo)
 	/* Initial frame ignore counter */
 	afIgnoreFrameReset();
 
+	/* The lens state is reported when the camera has a lens. */
+	lensState_ = !configInfo.lensControls.empty();
+	lensMoving_ = false;
+
 	/* Initial focus value */
 	context.activeState.af.focus = 0;
 	/* Maximum variance of the AF statistics */
 	context.activeState.af.maxVariance = 0;
 	/* The stable AF value flag. if it is true, the AF should be in a stable state. */
 	context.activeState.af.stable = false;
+	/* Scan speed */
+	context.activeState.af.speed = controls::AfSpeedNormal;
+
+	scanFrames_ = 0;
 
 	return 0;
 }
 
+/**
+ * \copydoc libcamera::ipa::Algorithm::queueRequest
+ */
+void Af::queueRequest(IPAContext &context,
+		      [[maybe_unused]] const uint32_t frame,
+		      [[maybe_unused]] IPAFrameContext &frameContext,
+		      const ControlList &controls)
+{
+	const auto &speed = controls.get(controls::AfSpeed);
+	if (speed) {
+		context.activeState.af.speed = *speed;
+		LOG(IPU3Af, Debug) << "Set AF speed to " << *speed;
+	}
+}
+
 /**
  * \copydoc libcamera::ipa::Algorithm::prepare
  */
@@ -214,13 +260,22 @@ void Af::afCoarseScan(IPAContext &context)
 
 	if (afScan(context, kCoarseSearchStep)) {
 		coarseCompleted_ = true;
+
+		if (context.activeState.af.speed == controls::AfSpeedFast) {
+			uint32_t peak = afEstimatePeak(context, kCoarseSearchStep);
+
+			focus_ = peak > kPredictedFineRange ? peak - kPredictedFineRange : 0;
+			maxStep_ = std::min(peak + kPredictedFineRange, kMaxFocusSteps);
+		} else {
+			focus_ = context.activeState.af.focus -
+				 (context.activeState.af.focus * kFineRange);
+			maxStep_ = std::clamp(focus_ + static_cast<uint32_t>((focus_ * kFineRange)),
+					      0U, kMaxFocusSteps);
+		}
+
 		context.activeState.af.maxVariance = 0;
-		focus_ = context.activeState.af.focus -
-			 (context.activeState.af.focus * kFineRange);
 		context.activeState.af.focus = focus_;
 		previousVariance_ = 0;
-		maxStep_ = std::clamp(focus_ + static_cast<uint32_t>((focus_ * kFineRange)),
-				      0U, kMaxFocusSteps);
 	}
 }
 
@@ -261,6 +316,8 @@ void Af::afReset(IPAContext &context)
 	context.activeState.af.stable = false;
 	ignoreCounter_ = kIgnoreFrame;
 	previousVariance_ = 0.0;
+	lowerVariance_ = 0.0;
+	scanFrames_ = 0;
 	coarseCompleted_ = false;
 	fineCompleted_ = false;
 	maxStep_ = kMaxFocusSteps;
@@ -297,6 +354,7 @@ bool Af::afScan(IPAContext &context, int min_step)
 			 * increased for the next comparison. Also, the max variance
 			 * and previous focus value are updated.
 			 */
+			lowerVariance_ = context.activeState.af.maxVariance;
 			bestFocus_ = focus_;
 			focus_ += min_step;
 			context.activeState.af.focus = focus_;
@@ -321,12 +379,58 @@ bool Af::afScan(IPAContext &context, int min_step)
 	return false;
 }
 
+/**
+ * \brief Predict the position of the variance peak
+ * \param[in] context The IPA context
+ * \param[in] step The VCM movement step of the completed scan
+ *
+ * When the scan stops on a negative derivative, the variance has been sampled
+ * one step before the best VCM step, at the best VCM step and one step after
+ * it. Fit a parabola through the three samples and return the position of its
+ * vertex, which is a better estimate of the peak than the best sampled step.
+ *
+ * \return The predicted VCM step of the peak, or the best sampled step if the
+ * peak isn't bracketed by samples or the samples are not concave
+ */
+uint32_t Af::afEstimatePeak(IPAContext &context, uint32_t step)
+{
+	if (bestFocus_ < step || focus_ > maxStep_)
+		return bestFocus_;
+
+	double y0 = lowerVariance_;
+	double y1 = context.activeState.af.maxVariance;
+	double y2 = currentVariance_;
+	double curvature = y0 - 2 * y1 + y2;
+
+	if (curvature >= 0)
+		return bestFocus_;
+
+	double offset = std::clamp(step * (y0 - y2) / (2 * curvature),
+				   -static_cast<double>(step),
+				   static_cast<double>(step));
+	long position = static_cast<long>(bestFocus_) + std::lround(offset);
+	uint32_t peak = std::clamp(position, 0L, static_cast<long>(kMaxFocusSteps));
+
+	LOG(IPU3Af, Debug) << "Predicted peak at step " << peak
+			   << " (best sampled step " << bestFocus_ << ")";
+
+	return peak;
+}
+
 /**
  * \brief Determine the frame to be ignored
+ *
+ * When the pipeline handler reports the lens state, only the frames captured
+ * while the lens is moving are ignored. Otherwise a fixed number of frames is
+ * ignored after the lens is moved to its initial position.
+ *
  * \return Return True if the frame should be ignored, false otherwise
  */
 bool Af::afNeedIgnoreFrame()
 {
+	if (lensState_)
+		return lensMoving_;
+
 	if (ignoreCounter_ == 0)
 		return false;
 	else
@@ -420,12 +524,16 @@ bool Af::afIsOutOfFocus(IPAContext &context)
  * negative derivative we have just passed the peak, and we infer that the best
  * focus is found.
  *
+ * The AF state is reported in the metadata as scanning until the best focus
+ * is found, and as focused afterwards. The number of frames needed to find the
+ * focus is logged.
+ *
  * [1] Hill Climbing Algorithm, https://en.wikipedia.org/wiki/Hill_climbing
  */
 void Af::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
-		 [[maybe_unused]] IPAFrameContext &frameContext,
+		 IPAFrameContext &frameContext,
 		 const ipu3_uapi_stats_3a *stats,
-		 [[maybe_unused]] ControlList &metadata)
+		 ControlList &metadata)
 {
 	/* Evaluate the AF buffer length */
 	uint32_t afRawBufferLen = context.configuration.af.afGrid.width *
@@ -442,16 +550,28 @@ void Af::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
 	 * For fine: y2 results are used.
 	 */
 	currentVariance_ = afEstimateVariance(y_items, !coarseCompleted_);
+	lensMoving_ = frameContext.lens.moving;
 
 	if (!context.activeState.af.stable) {
+		scanFrames_++;
+
 		afCoarseScan(context);
 		afFineScan(context);
+
+		if (context.activeState.af.stable)
+			LOG(IPU3Af, Debug) << "Focus found at step "
+					   << context.activeState.af.focus
+					   << " in " << scanFrames_ << " frames";
 	} else {
 		if (afIsOutOfFocus(context))
 			afReset(context);
 		else
 			afIgnoreFrameReset();
 	}
+
+	metadata.set(controls::AfState, context.activeState.af.stable
+					? controls::AfStateFocused
+					: controls::AfStateScanning);
 }
 
 REGISTER_IPA_ALGORITHM(Af, "Af")
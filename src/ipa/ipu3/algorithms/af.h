@@ -30,7 +30,11 @@ public:
 	Af();
 	~Af() = default;
 
+	int init(IPAContext &context, const YamlObject &tuningData) override;
 	int configure(IPAContext &context, const IPAConfigInfo &configInfo) override;
+	void queueRequest(IPAContext &context, const uint32_t frame,
+			  IPAFrameContext &frameContext,
+			  const ControlList &controls) override;
 	void prepare(IPAContext &context, const uint32_t frame,
 		     IPAFrameContext &frameContext,
 		     ipu3_uapi_params *params) override;
@@ -43,6 +47,7 @@ private:
 	void afCoarseScan(IPAContext &context);
 	void afFineScan(IPAContext &context);
 	bool afScan(IPAContext &context, int min_step);
+	uint32_t afEstimatePeak(IPAContext &context, uint32_t step);
 	void afReset(IPAContext &context);
 	bool afNeedIgnoreFrame();
 	void afIgnoreFrameReset();
@@ -58,14 +63,22 @@ private:
 	double currentVariance_;
 	/* The frames are ignore before starting measuring. */
 	uint32_t ignoreCounter_;
+	/* The pipeline handler reports the lens movement state per frame. */
+	bool lensState_;
+	/* The lens was moving during the exposure of the current frame. */
+	bool lensMoving_;
 	/* It is used to determine the derivative during scanning */
 	double previousVariance_;
+	/* The variance one step before the best VCM step. */
+	double lowerVariance_;
 	/* The designated maximum range of focus scanning. */
 	uint32_t maxStep_;
 	/* If the coarse scan completes, it is set to true. */
 	bool coarseCompleted_;
 	/* If the fine scan completes, it is set to true. */
 	bool fineCompleted_;
+	/* The number of frames processed since the scan started. */
+	uint32_t scanFrames_;
 };
 
 } /* namespace ipa::ipu3::algorithms */
@@ -53,9 +53,6 @@ static constexpr double kMinAnalogueGain = 1.0;
 /* \todo Honour the FrameDurationLimits control instead of hardcoding a limit */
 static constexpr utils::Duration kMaxShutterSpeed = 60ms;
 
-/* Histogram constants */
-static constexpr uint32_t knumHistogramBins = 256;
-
 Agc::Agc()
 	: minShutterSpeed_(0s), maxShutterSpeed_(0s)
 {
@@ -125,34 +122,30 @@ int Agc::configure(IPAContext &context,
 Histogram Agc::parseStatistics(const ipu3_uapi_stats_3a *stats,
 			       const ipu3_uapi_grid_config &grid)
 {
-	uint32_t hist[knumHistogramBins] = { 0 };
+	for (auto &histogram : rgbHistograms_)
+		histogram.fill(0);
 
-	rgbTriples_.clear();
+	auto &[red, green, blue] = rgbHistograms_;
 
 	for (unsigned int cellY = 0; cellY < grid.height; cellY++) {
-		for (unsigned int cellX = 0; cellX < grid.width; cellX++) {
-			uint32_t cellPosition = cellY * stride_ + cellX;
+		const ipu3_uapi_awb_set_item *cells =
+			&stats->awb_raw_buffer.meta_data[cellY * stride_];
 
-			const ipu3_uapi_awb_set_item *cell =
-				reinterpret_cast<const ipu3_uapi_awb_set_item *>(
-					&stats->awb_raw_buffer.meta_data[cellPosition]);
-
-			rgbTriples_.push_back({
-				cell->R_avg,
-				(cell->Gr_avg + cell->Gb_avg) / 2,
-				cell->B_avg
-			});
+		for (unsigned int cellX = 0; cellX < grid.width; cellX++) {
+			const ipu3_uapi_awb_set_item &cell = cells[cellX];
 
 			/*
-			 * Store the average green value to estimate the
+			 * Store the average colour values to estimate the
 			 * brightness. Even the overexposed pixels are
 			 * taken into account.
 			 */
-			hist[(cell->Gr_avg + cell->Gb_avg) / 2]++;
+			red[cell.R_avg]++;
+			green[(cell.Gr_avg + cell.Gb_avg) / 2]++;
+			blue[cell.B_avg]++;
 		}
 	}
 
-	return Histogram(Span<uint32_t>(hist));
+	return Histogram(Span<const uint32_t>(green));
 }
 
 /**
@@ -177,14 +170,21 @@ Histogram Agc::parseStatistics(const ipu3_uapi_stats_3a *stats,
  */
 double Agc::estimateLuminance(double gain) const
 {
-	double redSum = 0, greenSum = 0, blueSum = 0;
+	double sums[3] = {};
 
-	for (unsigned int i = 0; i < rgbTriples_.size(); i++) {
-		redSum += std::min(std::get<0>(rgbTriples_[i]) * gain, 255.0);
-		greenSum += std::min(std::get<1>(rgbTriples_[i]) * gain, 255.0);
-		blueSum += std::min(std::get<2>(rgbTriples_[i]) * gain, 255.0);
+	/*
+	 * The cell averages are 8-bit values, iterate over the histograms
+	 * instead of the cells to make the cost independent of the grid size.
+	 */
+	for (unsigned int i = 0; i < rgbHistograms_.size(); i++) {
+		const auto &histogram = rgbHistograms_[i];
+
+		for (unsigned int value = 0; value < histogram.size(); value++)
+			sums[i] += histogram[value] * std::min(value * gain, 255.0);
 	}
 
+	auto [redSum, greenSum, blueSum] = sums;
+
 	double ySum = redSum * rGain_ * 0.299
 		    + greenSum * gGain_ * 0.587
 		    + blueSum * bGain_ * 0.114;
@@ -192,6 +192,20 @@ double Agc::estimateLuminance(double gain) const
 	return ySum / (bdsGrid_.height * bdsGrid_.width) / 255;
 }
 
+/**
+ * \brief Retrieve the luminance model of the current frame
+ *
+ * The model combines the red, green and blue histograms of the cell averages,
+ * weighted by the AWB gains and the Rec. 601 coefficients, and matches the
+ * estimateLuminance() implementation.
+ *
+ * \return The luminance model
+ */
+const Agc::LuminanceModel *Agc::luminanceModel() const
+{
+	return &luminanceModel_;
+}
+
 /**
  * \brief Process IPU3 statistics, and run AGC operations
  * \param[in] context The shared IPA context
@@ -213,6 +227,15 @@ void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
 	gGain_ = context.activeState.awb.gains.blue;
 	bGain_ = context.activeState.awb.gains.green;
 
+	const auto &[red, green, blue] = rgbHistograms_;
+	luminanceModel_.weights.resize(knumHistogramBins);
+	for (unsigned int value = 0; value < knumHistogramBins; value++)
+		luminanceModel_.weights[value] = red[value] * rGain_ * 0.299
+					       + green[value] * gGain_ * 0.587
+					       + blue[value] * bGain_ * 0.114;
+	luminanceModel_.saturation = 255.0;
+	luminanceModel_.normalisation = bdsGrid_.height * bdsGrid_.width * 255.0;
+
 	/*
 	 * The Agc algorithm needs to know the effective exposure value that was
 	 * applied to the sensor when the statistics were collected.
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <array>
+
 #include <linux/intel-ipu3.h>
 
 #include <libcamera/base/utils.h>
@@ -24,6 +26,9 @@ struct IPACameraSensorInfo;
 
 namespace ipa::ipu3::algorithms {
 
+/* Histogram constants */
+static constexpr uint32_t knumHistogramBins = 256;
+
 class Agc : public Algorithm, public AgcMeanLuminance
 {
 public:
@@ -39,6 +44,7 @@ public:
 
 private:
 	double estimateLuminance(double gain) const override;
+	const LuminanceModel *luminanceModel() const override;
 	Histogram parseStatistics(const ipu3_uapi_stats_3a *stats,
 				  const ipu3_uapi_grid_config &grid);
 
@@ -53,7 +59,9 @@ private:
 	double gGain_;
 	double bGain_;
 	ipu3_uapi_grid_config bdsGrid_;
-	std::vector<std::tuple<uint8_t, uint8_t, uint8_t>> rgbTriples_;
+	/* Histograms of the red, green and blue cell averages. */
+	std::array<std::array<uint32_t, knumHistogramBins>, 3> rgbHistograms_;
+	LuminanceModel luminanceModel_;
 };
 
 } /* namespace ipa::ipu3::algorithms */
@@ -191,6 +191,7 @@ Awb::Awb()
 	asyncResults_.temperatureK = 4500;
 
 	zones_.reserve(kAwbStatsSizeX * kAwbStatsSizeY);
+	blueDerivative_.reserve(kAwbStatsSizeX * kAwbStatsSizeY);
 }
 
 Awb::~Awb() = default;
@@ -355,39 +356,37 @@ void Awb::generateAwbStats(const ipu3_uapi_stats_3a *stats)
 {
 	/*
 	 * Generate a (kAwbStatsSizeX x kAwbStatsSizeY) array from the IPU3 grid which is
-	 * (grid.width x grid.height).
+	 * (grid.width x grid.height). Iterate over the zones and the cells they
+	 * contain to avoid computing the zone position of each cell.
 	 */
 	for (unsigned int cellY = 0; cellY < kAwbStatsSizeY * cellsPerZoneY_; cellY++) {
-		for (unsigned int cellX = 0; cellX < kAwbStatsSizeX * cellsPerZoneX_; cellX++) {
-			uint32_t cellPosition = cellY * stride_ + cellX;
-			uint32_t zoneX = cellX / cellsPerZoneX_;
-			uint32_t zoneY = cellY / cellsPerZoneY_;
-
-			uint32_t awbZonePosition = zoneY * kAwbStatsSizeX + zoneX;
-
-			/* Cast the initial IPU3 structure to simplify the reading */
-			const ipu3_uapi_awb_set_item *currentCell =
-				reinterpret_cast<const ipu3_uapi_awb_set_item *>(
-					&stats->awb_raw_buffer.meta_data[cellPosition]
-				);
-
-			/*
-			 * Use cells which have less than 90%
-			 * saturation as an initial means to include
-			 * otherwise bright cells which are not fully
-			 * saturated.
-			 *
-			 * \todo The 90% saturation rate may require
-			 * further empirical measurements and
-			 * optimisation during camera tuning phases.
-			 */
-			if (currentCell->sat_ratio <= kMinCellsPerZoneRatio) {
+		Accumulator *zones = &awbStats_[cellY / cellsPerZoneY_ * kAwbStatsSizeX];
+		const ipu3_uapi_awb_set_item *cell =
+			&stats->awb_raw_buffer.meta_data[cellY * stride_];
+
+		for (unsigned int zoneX = 0; zoneX < kAwbStatsSizeX; zoneX++) {
+			Accumulator &zone = zones[zoneX];
+
+			for (unsigned int i = 0; i < cellsPerZoneX_; i++, cell++) {
+				/*
+				 * Use cells which have less than 90%
+				 * saturation as an initial means to include
+				 * otherwise bright cells which are not fully
+				 * saturated.
+				 *
+				 * \todo The 90% saturation rate may require
+				 * further empirical measurements and
+				 * optimisation during camera tuning phases.
+				 */
+				if (cell->sat_ratio > kMinCellsPerZoneRatio)
+					continue;
+
 				/* The cell is not saturated, use the current cell */
-				awbStats_[awbZonePosition].counted++;
-				uint32_t greenValue = currentCell->Gr_avg + currentCell->Gb_avg;
-				awbStats_[awbZonePosition].sum.green += greenValue / 2;
-				awbStats_[awbZonePosition].sum.red += currentCell->R_avg;
-				awbStats_[awbZonePosition].sum.blue += currentCell->B_avg;
+				zone.counted++;
+				uint32_t greenValue = cell->Gr_avg + cell->Gb_avg;
+				zone.sum.green += greenValue / 2;
+				zone.sum.red += cell->R_avg;
+				zone.sum.blue += cell->B_avg;
 			}
 		}
 	}
@@ -395,12 +394,7 @@ void Awb::generateAwbStats(const ipu3_uapi_stats_3a *stats)
 
 void Awb::clearAwbStats()
 {
-	for (unsigned int i = 0; i < kAwbStatsSizeX * kAwbStatsSizeY; i++) {
-		awbStats_[i].sum.blue = 0;
-		awbStats_[i].sum.red = 0;
-		awbStats_[i].sum.green = 0;
-		awbStats_[i].counted = 0;
-	}
+	std::fill(std::begin(awbStats_), std::end(awbStats_), Accumulator{});
 }
 
 void Awb::awbGreyWorld()
@@ -413,7 +407,8 @@ void Awb::awbGreyWorld()
 	 * doing an L2 average etc.
 	 */
 	std::vector<RGB> &redDerivative(zones_);
-	std::vector<RGB> blueDerivative(redDerivative);
+	std::vector<RGB> &blueDerivative(blueDerivative_);
+	blueDerivative.assign(redDerivative.begin(), redDerivative.end());
 	std::sort(redDerivative.begin(), redDerivative.end(),
 		  [](RGB const &a, RGB const &b) {
 			  return a.G * b.R < b.G * a.R;
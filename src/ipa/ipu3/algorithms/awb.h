@@ -80,6 +80,7 @@ private:
 	static constexpr uint16_t gainValue(double gain);
 
 	std::vector<RGB> zones_;
+	std::vector<RGB> blueDerivative_;
 	Accumulator awbStats_[kAwbStatsSizeX * kAwbStatsSizeY];
 	AwbStatus asyncResults_;
 
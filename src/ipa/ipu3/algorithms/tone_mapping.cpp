@@ -27,7 +27,7 @@ namespace ipa::ipu3::algorithms {
  */
 
 ToneMapping::ToneMapping()
-	: gamma_(1.0)
+	: gamma_(1.0), paramsGamma_(0.0)
 {
 }
 
@@ -56,12 +56,24 @@ int ToneMapping::configure(IPAContext &context,
  *
  * Populate the IPU3 parameter structure with our tone mapping look up table and
  * enable the gamma control module in the processing blocks.
+ *
+ * The ImgU retains the configuration of the processing blocks that are not
+ * marked for update in the parameters buffer. The look up table is thus only
+ * copied when it has changed since it was last applied, and on the first frame
+ * after the camera is started as the driver resets the configuration when
+ * streaming starts.
  */
-void ToneMapping::prepare([[maybe_unused]] IPAContext &context,
-			  [[maybe_unused]] const uint32_t frame,
+void ToneMapping::prepare(IPAContext &context, const uint32_t frame,
 			  [[maybe_unused]] IPAFrameContext &frameContext,
 			  ipu3_uapi_params *params)
 {
+	const double gamma = context.activeState.toneMapping.gamma;
+
+	if (frame > 0 && gamma == paramsGamma_)
+		return;
+
+	paramsGamma_ = gamma;
+
 	/* Copy the calculated LUT into the parameters buffer. */
 	memcpy(params->acc_param.gamma.gc_lut.lut,
 	       context.activeState.toneMapping.gammaCorrection.lut,
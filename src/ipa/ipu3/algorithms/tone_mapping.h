@@ -28,6 +28,7 @@ public:
 
 private:
 	double gamma_;
+	double paramsGamma_;
 };
 
 } /* namespace ipa::ipu3::algorithms */
@@ -86,6 +86,9 @@ namespace libcamera::ipa::ipu3 {
  *
  * \var IPAActiveState::af.stable
  * \brief It is set to true, if the best focus is found
+ *
+ * \var IPAActiveState::af.speed
+ * \brief The AF scan speed, as a controls::AfSpeedEnum value
  */
 
 /**
@@ -51,6 +51,7 @@ struct IPAActiveState {
 		uint32_t focus;
 		double maxVariance;
 		bool stable;
+		int32_t speed;
 	} af;
 
 	struct {
@@ -81,6 +82,10 @@ struct IPAFrameContext : public FrameContext {
 		uint32_t exposure;
 		double gain;
 	} sensor;
+
+	struct {
+		bool moving;
+	} lens;
 };
 
 struct IPAContext {
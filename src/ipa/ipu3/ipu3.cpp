@@ -160,7 +160,8 @@ public:
 	void fillParamsBuffer(const uint32_t frame, const uint32_t bufferId) override;
 	void processStatsBuffer(const uint32_t frame, const int64_t frameTimestamp,
 				const uint32_t bufferId,
-				const ControlList &sensorControls) override;
+				const ControlList &sensorControls,
+				const bool lensMoving) override;
 
 protected:
 	std::string logPrefix() const override;
@@ -224,6 +225,7 @@ void IPAIPU3::updateSessionConfiguration(const ControlInfoMap &sensorControls)
 	 */
 	context_.configuration.agc.minShutterSpeed = minExposure * context_.configuration.sensor.lineDuration;
 	context_.configuration.agc.maxShutterSpeed = maxExposure * context_.configuration.sensor.lineDuration;
+	camHelper_->setGainCodeLimits(minGain, maxGain);
 	context_.configuration.agc.minAnalogueGain = camHelper_->gain(minGain);
 	context_.configuration.agc.maxAnalogueGain = camHelper_->gain(maxGain);
 }
@@ -326,7 +328,7 @@ int IPAIPU3::init(const IPASettings &settings,
 		return ret;
 	}
 
-	std::unique_ptr<libcamera::YamlObject> data = YamlParser::parse(file);
+	std::shared_ptr<const libcamera::YamlObject> data = YamlParser::parseShared(file);
 	if (!data)
 		return -EINVAL;
 
@@ -372,6 +374,9 @@ int IPAIPU3::start()
  */
 void IPAIPU3::stop()
 {
+	timings().report();
+	timings().reset();
+
 	context_.frameContexts.clear();
 }
 
@@ -565,8 +570,10 @@ void IPAIPU3::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
 
 	IPAFrameContext &frameContext = context_.frameContexts.get(frame);
 
-	for (auto const &algo : algorithms())
+	for (auto const &[i, algo] : utils::enumerate(algorithms())) {
+		auto scope = timings().measure(i, AlgorithmTimings::Prepare);
 		algo->prepare(context_, frame, frameContext, params);
+	}
 
 	paramsBufferReady.emit(frame);
 }
@@ -577,6 +584,7 @@ void IPAIPU3::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
  * \param[in] frameTimestamp Timestamp of the frame
  * \param[in] bufferId ID of the statistics buffer
  * \param[in] sensorControls Sensor controls
+ * \param[in] lensMoving True if the lens was moving during the frame exposure
  *
  * Parse the most recently processed image statistics from the ImgU. The
  * statistics are passed to each algorithm module to run their calculations and
@@ -584,7 +592,8 @@ void IPAIPU3::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
  */
 void IPAIPU3::processStatsBuffer(const uint32_t frame,
 				 [[maybe_unused]] const int64_t frameTimestamp,
-				 const uint32_t bufferId, const ControlList &sensorControls)
+				 const uint32_t bufferId, const ControlList &sensorControls,
+				 const bool lensMoving)
 {
 	auto it = buffers_.find(bufferId);
 	if (it == buffers_.end()) {
@@ -600,11 +609,14 @@ void IPAIPU3::processStatsBuffer(const uint32_t frame,
 
 	frameContext.sensor.exposure = sensorControls.get(V4L2_CID_EXPOSURE).get<int32_t>();
 	frameContext.sensor.gain = camHelper_->gain(sensorControls.get(V4L2_CID_ANALOGUE_GAIN).get<int32_t>());
+	frameContext.lens.moving = lensMoving;
 
 	ControlList metadata(controls::controls);
 
-	for (auto const &algo : algorithms())
+	for (auto const &[i, algo] : utils::enumerate(algorithms())) {
+		auto scope = timings().measure(i, AlgorithmTimings::Process);
 		algo->process(context_, frame, frameContext, stats, metadata);
+	}
 
 	setControls(frame);
 
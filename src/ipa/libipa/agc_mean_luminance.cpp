@@ -125,7 +125,9 @@ static constexpr double kDefaultRelativeLuminanceTarget = 0.16;
  *
  * IPA modules that want to use this class to implement their AEGC algorithm
  * should derive it and provide an overriding estimateLuminance() function for
- * this class to use. They must call parseTuningData() in init(), and must also
+ * this class to use. They may additionally override luminanceModel() to let
+ * the initial gain be computed in a single pass over the statistics instead of
+ * iteratively. They must call parseTuningData() in init(), and must also
  * call setLimits() and resetFrameCounter() in configure(). They may then use
  * calculateNewEv() in process(). If the limits passed to setLimits() change for
  * any reason (for example, in response to a FrameDurationLimit control being
@@ -222,6 +224,21 @@ int AgcMeanLuminance::parseConstraintModes(const YamlObject &tuningData)
 			AeConstraintModeNameValueMap.at("ConstraintNormal"));
 	}
 
+	/*
+	 * Cache the quantiles of the constraints of each mode to compute all
+	 * the inter-quantile means of a mode in one call.
+	 */
+	size_t maxConstraints = 0;
+	for (const auto &[id, constraints] : constraintModes_) {
+		std::vector<std::pair<double, double>> &quantiles = constraintQuantiles_[id];
+		for (const AgcConstraint &constraint : constraints)
+			quantiles.emplace_back(constraint.qLo, constraint.qHi);
+
+		maxConstraints = std::max(maxConstraints, constraints.size());
+	}
+
+	constraintMeans_.resize(maxConstraints);
+
 	controls_[&controls::AeConstraintMode] = ControlInfo(availableConstraintModes);
 
 	return 0;
@@ -418,6 +435,90 @@ void AgcMeanLuminance::setLimits(utils::Duration minShutter,
  * \return The normalised relative luminance of the image
  */
 
+/**
+ * \struct AgcMeanLuminance::LuminanceModel
+ * \brief Saturation-aware model of the luminance of an image
+ *
+ * The luminance model describes the image statistics as a table of weights
+ * indexed by the cell values, such that the luminance estimated for a \a gain
+ * is
+ *
+ * \f$ Y(gain) = \frac{1}{normalisation} \sum_{v} weights[v] \min(v \times
+ * gain, saturation) \f$
+ *
+ * This matches the estimateLuminance() implementation of ISPs that provide
+ * cell averages of limited precision. As the table size is independent of the
+ * number of cells, the gain that achieves a luminance target can be computed
+ * in a single pass over the table regardless of the statistics grid size.
+ *
+ * \var AgcMeanLuminance::LuminanceModel::weights
+ * \brief The contribution to the luminance of the cells of each value
+ *
+ * \var AgcMeanLuminance::LuminanceModel::saturation
+ * \brief The value at which the cells saturate
+ *
+ * \var AgcMeanLuminance::LuminanceModel::normalisation
+ * \brief The normalisation factor of the luminance to the [0.0, 1.0] range
+ */
+
+/**
+ * \fn AgcMeanLuminance::luminanceModel()
+ * \brief Retrieve the luminance model of the current frame
+ *
+ * Derived classes may override this function to provide a luminance model that
+ * matches their estimateLuminance() implementation for the statistics being
+ * processed. The model is used by calculateNewEv() to compute the initial gain
+ * in a single pass. The default implementation returns nullptr, in which case
+ * the gain is computed iteratively with estimateLuminance().
+ *
+ * \return The luminance model, or nullptr if no model is available
+ */
+
+/**
+ * \brief Solve the gain needed to achieve a luminance target with a model
+ * \param[in] model The luminance model
+ * \param[in] yTarget The relative luminance target
+ *
+ * The modelled luminance is a continuous, increasing and piecewise linear
+ * function of the gain, with a break point at the gain that saturates each
+ * value. Walk the pieces in increasing gain order, saturating the values from
+ * the highest down, and return the gain of the first piece that reaches the
+ * target.
+ *
+ * \return The gain, or std::nullopt if the target can't be reached
+ */
+std::optional<double>
+AgcMeanLuminance::solveLuminanceModel(const LuminanceModel &model,
+				      double yTarget) const
+{
+	const std::vector<double> &weights = model.weights;
+	const double target = yTarget * model.normalisation;
+
+	/* Sums of the unsaturated values and of the saturated weights. */
+	double linear = 0.0;
+	double saturated = 0.0;
+
+	for (unsigned int value = 1; value < weights.size(); value++)
+		linear += weights[value] * value;
+
+	for (unsigned int value = weights.size() - 1; value > 0; value--) {
+		/*
+		 * Within this piece the values above \a value are saturated,
+		 * and the piece ends when \a value saturates.
+		 */
+		if (linear > 0.0) {
+			double gain = (target - saturated * model.saturation) / linear;
+			if (gain * value < model.saturation)
+				return gain;
+		}
+
+		linear -= weights[value] * value;
+		saturated += weights[value];
+	}
+
+	return std::nullopt;
+}
+
 /**
  * \brief Estimate the initial gain needed to achieve a relative luminance
  * target
@@ -428,6 +529,17 @@ double AgcMeanLuminance::estimateInitialGain() const
 	double yTarget = relativeLuminanceTarget_;
 	double yGain = 1.0;
 
+	const LuminanceModel *model = luminanceModel();
+	if (model) {
+		std::optional<double> gain = solveLuminanceModel(*model, yTarget);
+		if (gain) {
+			LOG(AgcMeanLuminance, Debug)
+				<< "Y target: " << yTarget
+				<< ", gives gain " << *gain;
+			return *gain;
+		}
+	}
+
 	/*
 	* To account for non-linearity caused by saturation, the value needs to
 	* be estimated in an iterative process, as multiplying by a gain will
@@ -463,9 +575,14 @@ double AgcMeanLuminance::constraintClampGain(uint32_t constraintModeIndex,
 					     double gain)
 {
 	std::vector<AgcConstraint> &constraints = constraintModes_[constraintModeIndex];
-	for (const AgcConstraint &constraint : constraints) {
-		double newGain = constraint.yTarget * hist.bins() /
-				 hist.interQuantileMean(constraint.qLo, constraint.qHi);
+	const std::vector<std::pair<double, double>> &quantiles =
+		constraintQuantiles_[constraintModeIndex];
+	Span<double> means{ constraintMeans_.data(), quantiles.size() };
+
+	hist.interQuantileMeans(quantiles, means);
+
+	for (const auto &[i, constraint] : utils::enumerate(constraints)) {
+		double newGain = constraint.yTarget * hist.bins() / means[i];
 
 		if (constraint.bound == AgcConstraint::Bound::lower &&
 		    newGain > gain)
@@ -9,7 +9,9 @@
 
 #include <map>
 #include <memory>
+#include <optional>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <libcamera/controls.h>
@@ -69,14 +71,27 @@ public:
 		frameCount_ = 0;
 	}
 
+protected:
+	struct LuminanceModel {
+		std::vector<double> weights;
+		double saturation;
+		double normalisation;
+	};
+
 private:
 	virtual double estimateLuminance(const double gain) const = 0;
+	virtual const LuminanceModel *luminanceModel() const
+	{
+		return nullptr;
+	}
 
 	void parseRelativeLuminanceTarget(const YamlObject &tuningData);
 	void parseConstraint(const YamlObject &modeDict, int32_t id);
 	int parseConstraintModes(const YamlObject &tuningData);
 	int parseExposureModes(const YamlObject &tuningData);
 	double estimateInitialGain() const;
+	std::optional<double> solveLuminanceModel(const LuminanceModel &model,
+						  double yTarget) const;
 	double constraintClampGain(uint32_t constraintModeIndex,
 				   const Histogram &hist,
 				   double gain);
@@ -87,6 +102,8 @@ private:
 	double relativeLuminanceTarget_;
 
 	std::map<int32_t, std::vector<AgcConstraint>> constraintModes_;
+	std::map<int32_t, std::vector<std::pair<double, double>>> constraintQuantiles_;
+	std::vector<double> constraintMeans_;
 	std::map<int32_t, std::shared_ptr<ExposureModeHelper>> exposureModeHelpers_;
 	ControlInfoMap::Map controls_;
 };
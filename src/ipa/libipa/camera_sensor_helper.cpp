@@ -7,6 +7,7 @@
  */
 #include "camera_sensor_helper.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <libcamera/base/log.h>
@@ -54,9 +55,105 @@ namespace ipa {
  * This function aims to abstract the calculation of the gain letting the IPA
  * use the real gain for its estimations.
  *
+ * When the gain code limits have been set with setGainCodeLimits(), the gain
+ * code is looked up in the precomputed gains of the sensor, and is the largest
+ * gain code whose gain doesn't exceed \a gain, clamped to the limits. It is the
+ * exact inverse of gain() for the gains of all the codes within the limits.
+ * Otherwise, the gain code is computed with the sensor-specific formula.
+ *
  * \return The gain code to pass to V4L2
  */
 uint32_t CameraSensorHelper::gainCode(double gain) const
+{
+	if (gains_.empty())
+		return computeGainCode(gain);
+
+	auto it = std::upper_bound(gains_.begin(), gains_.end(), gain);
+	if (it == gains_.begin())
+		return minGainCode_;
+
+	return minGainCode_ + std::distance(gains_.begin(), it) - 1;
+}
+
+/**
+ * \brief Compute the real gain from the V4L2 subdev control gain code
+ * \param[in] gainCode The V4L2 subdev control gain
+ *
+ * This function aims to abstract the calculation of the gain letting the IPA
+ * use the real gain for its estimations. It is the counterpart of the function
+ * CameraSensorHelper::gainCode.
+ *
+ * The gains of the codes within the limits set with setGainCodeLimits() are
+ * looked up in the precomputed gains of the sensor.
+ *
+ * \return The real gain
+ */
+double CameraSensorHelper::gain(uint32_t gainCode) const
+{
+	if (gainCode >= minGainCode_ && gainCode - minGainCode_ < gains_.size())
+		return gains_[gainCode - minGainCode_];
+
+	return computeGain(gainCode);
+}
+
+/**
+ * \brief Set the range of gain codes supported by the sensor
+ * \param[in] minGainCode The minimum gain code
+ * \param[in] maxGainCode The maximum gain code
+ *
+ * Precompute the gains of all the codes in the [\a minGainCode, \a maxGainCode]
+ * range, typically the limits of the V4L2_CID_ANALOGUE_GAIN control, to speed
+ * up the conversions performed by gain() and gainCode() for every frame and
+ * make them exact inverses of each other. This function should be called when
+ * configuring the IPA, as the limits may depend on the sensor mode.
+ *
+ * The gains are not precomputed if the range is too large, or if the gain
+ * doesn't increase monotonically with the gain code, in which case the
+ * sensor-specific formulas are used for all conversions.
+ */
+void CameraSensorHelper::setGainCodeLimits(uint32_t minGainCode,
+					   uint32_t maxGainCode)
+{
+	gains_.clear();
+	minGainCode_ = minGainCode;
+
+	if (maxGainCode < minGainCode || maxGainCode - minGainCode >= kMaxGainCodes) {
+		LOG(CameraSensorHelper, Debug)
+			<< "Not precomputing gains for codes ["
+			<< minGainCode << ", " << maxGainCode << "]";
+		return;
+	}
+
+	std::vector<double> gains;
+	gains.reserve(maxGainCode - minGainCode + 1);
+
+	for (uint32_t code = minGainCode; code <= maxGainCode; ++code) {
+		double gain = computeGain(code);
+		if (!gains.empty() && gain < gains.back()) {
+			LOG(CameraSensorHelper, Warning)
+				<< "Gain decreases at code " << code
+				<< ", not precomputing gains";
+			return;
+		}
+
+		gains.push_back(gain);
+	}
+
+	gains_ = std::move(gains);
+}
+
+/**
+ * \brief Compute gain code from the analogue gain absolute value
+ * \param[in] gain The real gain to pass
+ *
+ * This function implements the sensor-specific conversion used by gainCode()
+ * for gains that have not been precomputed. The default implementation uses
+ * the gainType_ model and the gainConstants_ of the sensor. Sensors whose gain
+ * model isn't supported shall override this function and computeGain().
+ *
+ * \return The gain code to pass to V4L2
+ */
+uint32_t CameraSensorHelper::computeGainCode(double gain) const
 {
 	const AnalogueGainConstants &k = gainConstants_;
 
@@ -82,13 +179,13 @@ uint32_t CameraSensorHelper::gainCode(double gain) const
  * \brief Compute the real gain from the V4L2 subdev control gain code
  * \param[in] gainCode The V4L2 subdev control gain
  *
- * This function aims to abstract the calculation of the gain letting the IPA
- * use the real gain for its estimations. It is the counterpart of the function
- * CameraSensorHelper::gainCode.
+ * This function implements the sensor-specific conversion used by gain() and
+ * to precompute gains in setGainCodeLimits(). It is the counterpart of
+ * computeGainCode().
  *
  * \return The real gain
  */
-double CameraSensorHelper::gain(uint32_t gainCode) const
+double CameraSensorHelper::computeGain(uint32_t gainCode) const
 {
 	const AnalogueGainConstants &k = gainConstants_;
 	double gain = static_cast<double>(gainCode);
@@ -369,7 +466,7 @@ static constexpr double expGainDb(double step)
 class CameraSensorHelperAr0521 : public CameraSensorHelper
 {
 public:
-	uint32_t gainCode(double gain) const override
+	uint32_t computeGainCode(double gain) const override
 	{
 		gain = std::clamp(gain, 1.0, 15.5);
 		unsigned int coarse = std::log2(gain);
@@ -378,7 +475,7 @@ public:
 		return (coarse << 4) | (fine & 0xf);
 	}
 
-	double gain(uint32_t gainCode) const override
+	double computeGain(uint32_t gainCode) const override
 	{
 		unsigned int coarse = gainCode >> 4;
 		unsigned int fine = gainCode & 0xf;
@@ -25,10 +25,15 @@ public:
 	CameraSensorHelper() = default;
 	virtual ~CameraSensorHelper() = default;
 
-	virtual uint32_t gainCode(double gain) const;
-	virtual double gain(uint32_t gainCode) const;
+	uint32_t gainCode(double gain) const;
+	double gain(uint32_t gainCode) const;
+
+	void setGainCodeLimits(uint32_t minGainCode, uint32_t maxGainCode);
 
 protected:
+	virtual uint32_t computeGainCode(double gain) const;
+	virtual double computeGain(uint32_t gainCode) const;
+
 	enum AnalogueGainType {
 		AnalogueGainLinear,
 		AnalogueGainExponential,
@@ -56,6 +61,12 @@ protected:
 
 private:
 	LIBCAMERA_DISABLE_COPY_AND_MOVE(CameraSensorHelper)
+
+	static constexpr uint32_t kMaxGainCodes = 4096;
+
+	/* Gains of the codes in the [minGainCode_, minGainCode_ + gains_.size()[ range */
+	uint32_t minGainCode_ = 0;
+	std::vector<double> gains_;
 };
 
 class CameraSensorHelperFactoryBase
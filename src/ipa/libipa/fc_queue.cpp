@@ -36,6 +36,9 @@ namespace ipa {
  *
  * \var FrameContext::frame
  * \brief The frame number
+ *
+ * \var FrameContext::pending
+ * \brief The context has been allocated but not retrieved with get() yet
  */
 
 /**
@@ -78,11 +81,19 @@ namespace ipa {
  *
  * At its core, the queue uses a circular buffer to avoid dynamic memory
  * allocation at runtime. The buffer is pre-allocated with a maximum number of
- * entries when the FCQueue instance is constructed. Entries are initialized on
- * first use by alloc() or, in underrun conditions, get(). The queue is not
- * allowed to overflow, which must be ensured by pipeline handlers never
- * queuing more in-flight requests to the IPA module than the queue size. If an
- * overflow condition is detected, the queue will log a fatal error.
+ * entries when the FCQueue instance is constructed, and can be resized with
+ * resize() when the IPA module is configured. Entries are initialized on first
+ * use by alloc() or, in underrun conditions, get(), and neither function
+ * allocates memory. The queue is not allowed to overflow, which must be ensured
+ * by pipeline handlers never queuing more in-flight requests to the IPA module
+ * than the queue size. If an overflow condition is detected, the queue will log
+ * a fatal error.
+ *
+ * The queue counts the contexts that are overwritten by alloc() before having
+ * been retrieved with get(), which indicates that the frames they have been
+ * allocated for have not been processed, as well as the underruns handled by
+ * get(). The counters are available through overwrites() and underruns(), and
+ * are reset by clear().
  *
  * IPA module-specific frame context implementations shall inherit from the
  * FrameContext base class to support the minimum required features for a
@@ -95,12 +106,29 @@ namespace ipa {
  * \param[in] size The number of contexts in the queue
  */
 
+/**
+ * \fn FCQueue::resize()
+ * \brief Set the number of contexts in the queue
+ * \param[in] size The number of contexts in the queue
+ *
+ * The queue depth can be adjusted to the needs of the pipeline, typically when
+ * the IPA module is configured. This function allocates memory and shall not be
+ * called while streaming. The queue is cleared.
+ */
+
+/**
+ * \fn FCQueue::size()
+ * \brief Retrieve the number of contexts in the queue
+ * \return The number of contexts in the queue
+ */
+
 /**
  * \fn FCQueue::clear()
  * \brief Clear the contexts queue
  *
  * IPA modules must clear the frame context queue at the beginning of a new
- * streaming session, in IPAModule::start().
+ * streaming session, in IPAModule::start(). The overwrite and underrun
+ * counters are logged if not zero, and reset.
  *
  * \todo Fix any issue this may cause with requests queued before the camera is
  * started.
@@ -135,6 +163,28 @@ namespace ipa {
  * \return A reference to the FrameContext for sequence \a frame
  */
 
+/**
+ * \fn FCQueue::overwrites()
+ * \brief Retrieve the number of contexts overwritten before being retrieved
+ *
+ * A context is overwritten when alloc() reuses its queue slot for a new frame
+ * before the context has been retrieved with get(). This typically indicates
+ * that frames have been dropped, or that the queue is too shallow for the
+ * pipeline.
+ *
+ * \return The number of overwritten contexts since the last clear()
+ */
+
+/**
+ * \fn FCQueue::underruns()
+ * \brief Retrieve the number of underruns
+ *
+ * An underrun occurs when get() is called for a frame whose context hasn't been
+ * allocated with alloc().
+ *
+ * \return The number of underruns since the last clear()
+ */
+
 } /* namespace ipa */
 
 } /* namespace libcamera */
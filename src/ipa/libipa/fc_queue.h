@@ -25,6 +25,7 @@ struct FrameContext {
 private:
 	template<typename T> friend class FCQueue;
 	uint32_t frame;
+	bool pending;
 };
 
 template<typename FrameContext>
@@ -32,14 +33,33 @@ class FCQueue
 {
 public:
 	FCQueue(unsigned int size)
-		: contexts_(size)
+		: contexts_(size), overwrites_(0), underruns_(0)
 	{
+		clear();
 	}
 
+	void resize(unsigned int size)
+	{
+		contexts_.resize(size);
+		clear();
+	}
+
+	unsigned int size() const { return contexts_.size(); }
+
 	void clear()
 	{
-		for (FrameContext &ctx : contexts_)
+		if (overwrites_ || underruns_)
+			LOG(FCQueue, Debug)
+				<< overwrites_ << " frame contexts overwritten, "
+				<< underruns_ << " underruns";
+
+		for (FrameContext &ctx : contexts_) {
 			ctx.frame = 0;
+			ctx.pending = false;
+		}
+
+		overwrites_ = 0;
+		underruns_ = 0;
 	}
 
 	FrameContext &alloc(const uint32_t frame)
@@ -57,11 +77,22 @@ public:
 		 * time the application has queued a request. Does this deserve
 		 * an error condition ?
 		 */
-		if (frame != 0 && frame <= frameContext.frame)
+		if (frame != 0 && frame <= frameContext.frame) {
 			LOG(FCQueue, Warning)
 				<< "Frame " << frame << " already initialised";
-		else
-			init(frameContext, frame);
+			return frameContext;
+		}
+
+		/*
+		 * The slot still holds a context that has never been retrieved
+		 * with get(), the frame it was allocated for has thus not been
+		 * processed.
+		 */
+		if (frameContext.pending)
+			overwrites_++;
+
+		init(frameContext, frame);
+		frameContext.pending = true;
 
 		return frameContext;
 	}
@@ -83,8 +114,10 @@ public:
 					    << " has been overwritten by "
 					    << frameContext.frame;
 
-		if (frame == frameContext.frame)
+		if (frame == frameContext.frame) {
+			frameContext.pending = false;
 			return frameContext;
+		}
 
 		/*
 		 * The frame context has been retrieved before it was
@@ -98,19 +131,27 @@ public:
 		LOG(FCQueue, Warning)
 			<< "Obtained an uninitialised FrameContext for " << frame;
 
+		underruns_++;
 		init(frameContext, frame);
 
 		return frameContext;
 	}
 
+	unsigned int overwrites() const { return overwrites_; }
+	unsigned int underruns() const { return underruns_; }
+
 private:
 	void init(FrameContext &frameContext, const uint32_t frame)
 	{
 		frameContext = {};
 		frameContext.frame = frame;
+		frameContext.pending = false;
 	}
 
 	std::vector<FrameContext> contexts_;
+
+	unsigned int overwrites_;
+	unsigned int underruns_;
 };
 
 } /* namespace ipa */
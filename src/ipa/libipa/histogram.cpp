@@ -6,8 +6,6 @@
  */
 #include "histogram.h"
 
-#include <cmath>
-
 #include <libcamera/base/log.h>
 
 /**
@@ -26,6 +24,11 @@ namespace ipa {
  * This class stores a cumulative frequency histogram, which is a mapping that
  * counts the cumulative number of observations in all of the bins up to the
  * specified bin. It can be used to find quantiles and averages between quantiles.
+ *
+ * The cumulative sum of the observations weighted by their bin index is stored
+ * alongside the cumulative frequencies. Both are computed in a single pass when
+ * the histogram is constructed, which allows computing inter-quantile means
+ * without iterating over the bins.
  */
 
 /**
@@ -42,11 +45,8 @@ namespace ipa {
  * \param[in] data A (non-cumulative) histogram
  */
 Histogram::Histogram(Span<const uint32_t> data)
+	: Histogram(data, [](uint32_t value) { return value; })
 {
-	cumulative_.resize(data.size() + 1);
-	cumulative_[0] = 0;
-	for (const auto &[i, value] : utils::enumerate(data))
-		cumulative_[i + 1] = cumulative_[i] + value;
 }
 
 /**
@@ -128,6 +128,28 @@ double Histogram::quantile(double q, uint32_t first, uint32_t last) const
 	return first + frac;
 }
 
+/**
+ * \brief Compute multiple quantiles in a single pass
+ * \param[in] q The desired points, in ascending order (0 <= q <= 1)
+ * \param[out] points The fractional bins of the points
+ *
+ * This function is equivalent to calling quantile() for each value of \a q, but
+ * restricts the search of each quantile to the bins above the previous one.
+ * The \a points span shall be at least as large as the \a q span.
+ */
+void Histogram::quantiles(Span<const double> q, Span<double> points) const
+{
+	ASSERT(points.size() >= q.size());
+
+	uint32_t first = 0;
+	for (const auto &[i, value] : utils::enumerate(q)) {
+		ASSERT(!i || value >= q[i - 1]);
+
+		points[i] = quantile(value, first);
+		first = static_cast<uint32_t>(points[i]);
+	}
+}
+
 /**
  * \brief Calculate the mean between two quantiles
  * \param[in] lowQuantile low Quantile
@@ -146,22 +168,58 @@ double Histogram::interQuantileMean(double lowQuantile, double highQuantile) con
 	double lowPoint = quantile(lowQuantile);
 	/* Proportion of pixels which lies below highQuantile */
 	double highPoint = quantile(highQuantile, static_cast<uint32_t>(lowPoint));
-	double sumBinFreq = 0, cumulFreq = 0;
-
-	for (double p_next = floor(lowPoint) + 1.0;
-	     p_next <= ceil(highPoint);
-	     lowPoint = p_next, p_next += 1.0) {
-		int bin = floor(lowPoint);
-		double freq = (cumulative_[bin + 1] - cumulative_[bin])
-			* (std::min(p_next, highPoint) - lowPoint);
-
-		/* Accumulate weighted bin */
-		sumBinFreq += bin * freq;
-		/* Accumulate weights */
-		cumulFreq += freq;
-	}
+
+	return pointMean(lowPoint, highPoint);
+}
+
+/**
+ * \brief Calculate the means between multiple pairs of quantiles
+ * \param[in] quantiles The low and high quantiles of each mean
+ * \param[out] means The mean histogram bin values between the quantiles
+ *
+ * This function is equivalent to calling interQuantileMean() for each pair of
+ * \a quantiles. The \a means span shall be at least as large as the
+ * \a quantiles span.
+ */
+void Histogram::interQuantileMeans(Span<const std::pair<double, double>> quantiles,
+				   Span<double> means) const
+{
+	ASSERT(means.size() >= quantiles.size());
+
+	for (const auto &[i, range] : utils::enumerate(quantiles))
+		means[i] = interQuantileMean(range.first, range.second);
+}
+
+/*
+ * Compute the mean of the pixels between two fractional bins. The pixels are
+ * spread evenly throughout the bin in which they lie, as in
+ * cumulativeFrequency().
+ */
+double Histogram::pointMean(double lowPoint, double highPoint) const
+{
+	auto accumulate = [this](double point, double &freq, double &weighted) {
+		unsigned int bin = static_cast<unsigned int>(point);
+		if (bin >= bins()) {
+			freq = cumulative_[bins()];
+			weighted = weighted_[bins()];
+			return;
+		}
+
+		double frac = point - bin;
+		uint64_t count = cumulative_[bin + 1] - cumulative_[bin];
+
+		freq = cumulative_[bin] + frac * count;
+		weighted = weighted_[bin] + frac * count * bin;
+	};
+
+	double lowFreq, lowWeighted;
+	double highFreq, highWeighted;
+
+	accumulate(lowPoint, lowFreq, lowWeighted);
+	accumulate(highPoint, highFreq, highWeighted);
+
 	/* add 0.5 to give an average for bin mid-points */
-	return sumBinFreq / cumulFreq + 0.5;
+	return (highWeighted - lowWeighted) / (highFreq - lowFreq) + 0.5;
 }
 
 } /* namespace ipa */
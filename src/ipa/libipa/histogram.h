@@ -11,6 +11,7 @@
 #include <limits.h>
 #include <stdint.h>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/span.h>
@@ -23,7 +24,11 @@ namespace ipa {
 class Histogram
 {
 public:
-	Histogram() { cumulative_.push_back(0); }
+	Histogram()
+	{
+		cumulative_.push_back(0);
+		weighted_.push_back(0);
+	}
 	Histogram(Span<const uint32_t> data);
 
 	template<typename Transform,
@@ -31,19 +36,39 @@ public:
 	Histogram(Span<const uint32_t> data, Transform transform)
 	{
 		cumulative_.resize(data.size() + 1);
+		weighted_.resize(data.size() + 1);
 		cumulative_[0] = 0;
-		for (const auto &[i, value] : utils::enumerate(data))
-			cumulative_[i + 1] = cumulative_[i] + transform(value);
+		weighted_[0] = 0;
+
+		/*
+		 * Keep the running sums in local variables to avoid a
+		 * store-to-load dependency through the vectors.
+		 */
+		uint64_t cumulative = 0;
+		uint64_t weighted = 0;
+		for (size_t i = 0; i < data.size(); ++i) {
+			uint64_t value = transform(data[i]);
+			cumulative += value;
+			weighted += i * value;
+			cumulative_[i + 1] = cumulative;
+			weighted_[i + 1] = weighted;
+		}
 	}
 
 	size_t bins() const { return cumulative_.size() - 1; }
 	uint64_t total() const { return cumulative_[cumulative_.size() - 1]; }
 	uint64_t cumulativeFrequency(double bin) const;
 	double quantile(double q, uint32_t first = 0, uint32_t last = UINT_MAX) const;
+	void quantiles(Span<const double> q, Span<double> points) const;
 	double interQuantileMean(double lowQuantile, double hiQuantile) const;
+	void interQuantileMeans(Span<const std::pair<double, double>> quantiles,
+				Span<double> means) const;
 
 private:
+	double pointMean(double lowPoint, double highPoint) const;
+
 	std::vector<uint64_t> cumulative_;
+	std::vector<uint64_t> weighted_;
 };
 
 } /* namespace ipa */
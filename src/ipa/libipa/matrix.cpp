@@ -0,0 +1,182 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas On Board Oy
+ *
+ * Matrix and related operations
+ */
+
+#include "matrix.h"
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file matrix.h
+ * \brief Matrix class
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(Matrix)
+
+namespace ipa {
+
+/**
+ * \class Matrix
+ * \brief Matrix class
+ * \tparam T Type of numerical values to be stored in the matrix
+ * \tparam Rows Number of rows in the matrix
+ * \tparam Cols Number of columns in the matrix
+ *
+ * The Matrix class stores its elements in a fixed-size array in row-major
+ * order, without any dynamic memory allocation. All operations are constexpr
+ * and iterate over contiguous elements, which allows the compiler to
+ * vectorise them.
+ */
+
+/**
+ * \fn Matrix::Matrix()
+ * \brief Construct a zero matrix
+ */
+
+/**
+ * \fn Matrix::Matrix(const std::array<T, Rows * Cols> &data)
+ * \brief Construct a matrix from supplied data
+ * \param[in] data Data from which to construct a matrix
+ *
+ * \a data is a one-dimensional array and will be turned into a matrix in
+ * row-major order. The size of \a data must be equal to the product of the
+ * number of rows and columns of the matrix (Rows x Cols).
+ */
+
+/**
+ * \fn Matrix::identity()
+ * \brief Construct an identity matrix
+ * \return An identity matrix
+ */
+
+/**
+ * \fn Matrix::readYaml
+ * \brief Populate the matrix with yaml data
+ * \param[in] yaml Yaml data to populate the matrix with
+ *
+ * Any existing data in the matrix will be overwritten. The size of the data
+ * read from \a yaml must be equal to the product of the number of rows and
+ * columns of the matrix (Rows x Cols).
+ *
+ * The yaml data is expected to be a list with elements of type T, in
+ * row-major order.
+ *
+ * \return 0 on success, negative error code otherwise
+ */
+
+/**
+ * \fn Matrix::toString()
+ * \brief Assemble and return a string describing the matrix
+ * \return A string describing the matrix
+ */
+
+/**
+ * \fn Span<const T, Cols> Matrix::operator[](size_t i) const
+ * \brief Index to a row in the matrix
+ * \param[in] i Index of row to retrieve
+ *
+ * This operator[] returns a Span, which can then be indexed into again with
+ * another operator[], allowing a convenient m[i][j] to access elements of the
+ * matrix.
+ *
+ * \return Row \a i from the matrix, as a Span
+ */
+
+/**
+ * \fn Span<T, Cols> Matrix::operator[](size_t i)
+ * \copydoc Matrix::operator[](size_t i) const
+ */
+
+/**
+ * \fn Matrix::data()
+ * \brief Retrieve the matrix elements
+ * \return The matrix elements in row-major order
+ */
+
+/**
+ * \fn Matrix::operator+=()
+ * \brief Add another matrix to this matrix element-wise
+ * \param[in] other The matrix to add
+ * \return This matrix
+ */
+
+/**
+ * \fn Matrix::operator*=()
+ * \brief Multiply all elements of the matrix by a scalar
+ * \param[in] factor The scalar factor
+ * \return This matrix
+ */
+
+/**
+ * \fn Matrix<T, Rows, Cols> operator+(const Matrix<T, Rows, Cols> &m1, const Matrix<T, Rows, Cols> &m2)
+ * \brief Matrix addition
+ * \param[in] m1 Summand
+ * \param[in] m2 Summand
+ * \return Matrix sum of m1 and m2
+ */
+
+/**
+ * \fn Matrix<T, Rows, Cols> operator*(U d, const Matrix<T, Rows, Cols> &m)
+ * \brief Multiply the matrix by a scalar
+ * \param[in] d The scalar multiplier
+ * \param[in] m The matrix
+ * \return Product of \a d and \a m
+ */
+
+/**
+ * \fn Matrix<T, Rows, Cols> operator*(const Matrix<T, Rows, Cols> &m, U d)
+ * \copydoc operator*(U d, const Matrix<T, Rows, Cols> &m)
+ */
+
+/**
+ * \fn Matrix<T, R1, C2> operator*(const Matrix<T, R1, C1> &m1, const Matrix<T, R2, C2> &m2)
+ * \brief Matrix multiplication
+ * \param[in] m1 Multiplicand
+ * \param[in] m2 Multiplier
+ *
+ * The number of columns of \a m1 must be equal to the number of rows of \a m2.
+ *
+ * \return Matrix product of m1 and m2
+ */
+
+/**
+ * \fn Vector<T, Rows> operator*(const Matrix<T, Rows, Cols> &m, const Vector<T, Cols> &v)
+ * \brief Multiply a matrix by a vector
+ * \param[in] m The matrix
+ * \param[in] v The vector
+ * \return Product of \a m and \a v
+ */
+
+/**
+ * \fn Matrix<T, Rows, Cols> lerp(const Matrix<T, Rows, Cols> &m0, const Matrix<T, Rows, Cols> &m1, double lambda)
+ * \brief Linearly interpolate between two matrices
+ * \param[in] m0 The matrix at \a lambda = 0
+ * \param[in] m1 The matrix at \a lambda = 1
+ * \param[in] lambda The interpolation factor
+ *
+ * Each element of the result is computed as lambda * m1 + (1 - lambda) * m0
+ * in a single pass over the elements, without creating temporary matrices.
+ *
+ * \return The interpolated matrix
+ */
+
+/**
+ * \fn bool operator==(const Matrix<T, Rows, Cols> &lhs, const Matrix<T, Rows, Cols> &rhs)
+ * \brief Compare matrices for equality
+ * \return True if the two matrices are equal, false otherwise
+ */
+
+/**
+ * \fn bool operator!=(const Matrix<T, Rows, Cols> &lhs, const Matrix<T, Rows, Cols> &rhs)
+ * \brief Compare matrices for inequality
+ * \return True if the two matrices are not equal, false otherwise
+ */
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
@@ -0,0 +1,262 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas On Board Oy
+ *
+ * Matrix and related operations
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <string>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/span.h>
+
+#include "libcamera/internal/yaml_parser.h"
+
+#include "vector.h"
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(Matrix)
+
+namespace ipa {
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols,
+	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
+#else
+template<typename T, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+class Matrix
+{
+public:
+	constexpr Matrix()
+		: data_{}
+	{
+	}
+
+	constexpr Matrix(const std::array<T, Rows * Cols> &data)
+		: data_(data)
+	{
+	}
+
+	static constexpr Matrix identity()
+	{
+		Matrix ret;
+		for (unsigned int i = 0; i < std::min(Rows, Cols); i++)
+			ret.data_[i * Cols + i] = 1;
+		return ret;
+	}
+
+	int readYaml(const libcamera::YamlObject &yaml)
+	{
+		if (yaml.size() != Rows * Cols) {
+			LOG(Matrix, Error)
+				<< "Wrong number of values in matrix: expected "
+				<< Rows * Cols << ", got " << yaml.size();
+			return -EINVAL;
+		}
+
+		unsigned int i = 0;
+		for (const auto &x : yaml.asList()) {
+			auto value = x.get<T>();
+			if (!value) {
+				LOG(Matrix, Error) << "Failed to read matrix value";
+				return -EINVAL;
+			}
+
+			data_[i++] = *value;
+		}
+
+		return 0;
+	}
+
+	std::string toString() const
+	{
+		std::stringstream out;
+
+		out << "Matrix { ";
+		for (unsigned int i = 0; i < Rows; i++) {
+			out << "[ ";
+			for (unsigned int j = 0; j < Cols; j++) {
+				out << (*this)[i][j];
+				out << ((j + 1 < Cols) ? ", " : " ");
+			}
+			out << ((i + 1 < Rows) ? "], " : "]");
+		}
+		out << " }";
+
+		return out.str();
+	}
+
+	constexpr Span<const T, Cols> operator[](size_t i) const
+	{
+		return Span<const T, Cols>{ &data_.data()[i * Cols], Cols };
+	}
+
+	constexpr Span<T, Cols> operator[](size_t i)
+	{
+		return Span<T, Cols>{ &data_.data()[i * Cols], Cols };
+	}
+
+	constexpr Span<const T, Rows * Cols> data() const
+	{
+		return data_;
+	}
+
+	constexpr Matrix &operator+=(const Matrix &other)
+	{
+		for (unsigned int i = 0; i < Rows * Cols; i++)
+			data_[i] += other.data_[i];
+		return *this;
+	}
+
+	constexpr Matrix &operator*=(T factor)
+	{
+		for (unsigned int i = 0; i < Rows * Cols; i++)
+			data_[i] *= factor;
+		return *this;
+	}
+
+private:
+	/*
+	 * The elements are stored contiguously in row-major order, which lets
+	 * the compiler vectorise the element-wise operations.
+	 */
+	std::array<T, Rows * Cols> data_;
+};
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+constexpr Matrix<T, Rows, Cols> operator+(const Matrix<T, Rows, Cols> &m1,
+					  const Matrix<T, Rows, Cols> &m2)
+{
+	Matrix<T, Rows, Cols> ret = m1;
+	ret += m2;
+	return ret;
+}
+
+#ifndef __DOXYGEN__
+template<typename T, typename U, unsigned int Rows, unsigned int Cols,
+	 std::enable_if_t<std::is_arithmetic_v<U>> * = nullptr>
+#else
+template<typename T, typename U, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+constexpr Matrix<T, Rows, Cols> operator*(U d, const Matrix<T, Rows, Cols> &m)
+{
+	Matrix<T, Rows, Cols> ret = m;
+	ret *= d;
+	return ret;
+}
+
+#ifndef __DOXYGEN__
+template<typename T, typename U, unsigned int Rows, unsigned int Cols,
+	 std::enable_if_t<std::is_arithmetic_v<U>> * = nullptr>
+#else
+template<typename T, typename U, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+constexpr Matrix<T, Rows, Cols> operator*(const Matrix<T, Rows, Cols> &m, U d)
+{
+	return d * m;
+}
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int R1, unsigned int C1, unsigned int R2, unsigned int C2,
+	 std::enable_if_t<C1 == R2> * = nullptr>
+#else
+template<typename T, unsigned int R1, unsigned int C1, unsigned int R2, unsigned int C2>
+#endif /* __DOXYGEN__ */
+constexpr Matrix<T, R1, C2> operator*(const Matrix<T, R1, C1> &m1,
+				      const Matrix<T, R2, C2> &m2)
+{
+	Matrix<T, R1, C2> ret;
+
+	/*
+	 * Accumulate scaled rows of m2 instead of computing dot products, to
+	 * keep the innermost loop on contiguous elements.
+	 */
+	for (unsigned int i = 0; i < R1; i++) {
+		for (unsigned int k = 0; k < C1; k++) {
+			T factor = m1[i][k];
+			for (unsigned int j = 0; j < C2; j++)
+				ret[i][j] += factor * m2[k][j];
+		}
+	}
+
+	return ret;
+}
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+constexpr Vector<T, Rows> operator*(const Matrix<T, Rows, Cols> &m,
+				    const Vector<T, Cols> &v)
+{
+	Vector<T, Rows> ret;
+
+	for (unsigned int i = 0; i < Rows; i++) {
+		T sum = 0;
+		for (unsigned int j = 0; j < Cols; j++)
+			sum += m[i][j] * v[j];
+		ret[i] = sum;
+	}
+
+	return ret;
+}
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+constexpr Matrix<T, Rows, Cols> lerp(const Matrix<T, Rows, Cols> &m0,
+				     const Matrix<T, Rows, Cols> &m1,
+				     double lambda)
+{
+	Matrix<T, Rows, Cols> ret;
+	Span<const T, Rows * Cols> d0 = m0.data();
+	Span<const T, Rows * Cols> d1 = m1.data();
+
+	for (unsigned int i = 0; i < Rows; i++) {
+		for (unsigned int j = 0; j < Cols; j++) {
+			unsigned int idx = i * Cols + j;
+			ret[i][j] = lambda * d1[idx] + (1.0 - lambda) * d0[idx];
+		}
+	}
+
+	return ret;
+}
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+bool operator==(const Matrix<T, Rows, Cols> &lhs, const Matrix<T, Rows, Cols> &rhs)
+{
+	Span<const T, Rows * Cols> l = lhs.data();
+	Span<const T, Rows * Cols> r = rhs.data();
+
+	return std::equal(l.begin(), l.end(), r.begin());
+}
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols>
+#endif /* __DOXYGEN__ */
+bool operator!=(const Matrix<T, Rows, Cols> &lhs, const Matrix<T, Rows, Cols> &rhs)
+{
+	return !(lhs == rhs);
+}
+
+} /* namespace ipa */
+
+#ifndef __DOXYGEN__
+template<typename T, unsigned int Rows, unsigned int Cols>
+std::ostream &operator<<(std::ostream &out, const ipa::Matrix<T, Rows, Cols> &m)
+{
+	out << m.toString();
+	return out;
+}
+#endif /* __DOXYGEN__ */
+
+} /* namespace libcamera */
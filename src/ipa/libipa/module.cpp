@@ -83,6 +83,18 @@ namespace ipa {
  * \return The list of instantiated algorithms
  */
 
+/**
+ * \fn Module::timings()
+ * \brief Retrieve the processing time statistics of the algorithms
+ *
+ * Algorithms are registered in the returned AlgorithmTimings in the order of
+ * the algorithms() list, the index of an algorithm in the list is thus its
+ * AlgorithmTimings index. IPA modules are responsible for measuring the calls
+ * they make to the algorithms.
+ *
+ * \return The processing time statistics of the algorithms
+ */
+
 /**
  * \fn Module::createAlgorithms()
  * \brief Create algorithms from YAML configuration data
@@ -18,6 +18,7 @@
 #include "libcamera/internal/yaml_parser.h"
 
 #include "algorithm.h"
+#include "timing.h"
 
 namespace libcamera {
 
@@ -43,6 +44,8 @@ public:
 		return algorithms_;
 	}
 
+	AlgorithmTimings &timings() { return timings_; }
+
 	int createAlgorithms(Context &context, const YamlObject &algorithms)
 	{
 		const auto &list = algorithms.asList();
@@ -52,12 +55,14 @@ public:
 				LOG(IPAModuleAlgo, Error)
 					<< "Invalid YAML syntax for algorithm " << i;
 				algorithms_.clear();
+				timings_.clear();
 				return -EINVAL;
 			}
 
 			int ret = createAlgorithm(context, algo);
 			if (ret) {
 				algorithms_.clear();
+				timings_.clear();
 				return ret;
 			}
 		}
@@ -92,6 +97,7 @@ private:
 			<< "Instantiated algorithm '" << name << "'";
 
 		algorithms_.push_back(std::move(algo));
+		timings_.add(name);
 		return 0;
 	}
 
@@ -117,6 +123,7 @@ private:
 	}
 
 	std::list<std::unique_ptr<Algorithm<Module>>> algorithms_;
+	AlgorithmTimings timings_;
 };
 
 } /* namespace ipa */
@@ -99,6 +99,7 @@ namespace ipa {
  * \brief Construct an empty piecewise linear function
  */
 Pwl::Pwl()
+	: spansScale_(0.0)
 {
 }
 
@@ -109,7 +110,7 @@ Pwl::Pwl()
  * \a points must be in ascending order of x-value.
  */
 Pwl::Pwl(const std::vector<Point> &points)
-	: points_(points)
+	: points_(points), spansScale_(0.0)
 {
 }
 
@@ -133,6 +134,7 @@ int Pwl::readYaml(const libcamera::YamlObject &params)
 	const auto &list = params.asList();
 
 	points_.clear();
+	spans_.clear();
 
 	for (auto it = list.begin(); it != list.end(); it++) {
 		auto x = it->get<double>();
@@ -162,8 +164,10 @@ int Pwl::readYaml(const libcamera::YamlObject &params)
  */
 void Pwl::append(double x, double y, const double eps)
 {
-	if (points_.empty() || points_.back().x() + eps < x)
+	if (points_.empty() || points_.back().x() + eps < x) {
 		points_.push_back(Point({ x, y }));
+		spans_.clear();
+	}
 }
 
 /**
@@ -177,8 +181,10 @@ void Pwl::append(double x, double y, const double eps)
  */
 void Pwl::prepend(double x, double y, const double eps)
 {
-	if (points_.empty() || points_.front().x() - eps > x)
+	if (points_.empty() || points_.front().x() - eps > x) {
 		points_.insert(points_.begin(), Point({ x, y }));
+		spans_.clear();
+	}
 }
 
 /**
@@ -222,13 +228,22 @@ bool Pwl::empty() const
  * the "span" value but don't have an initial guess you can set it to
  * -1.
  *
+ * Without an initial guess, the span search starts from the lookup table built
+ * by bake() if available, or from the middle of the function otherwise.
+ *
  *  \return The result of evaluating the piecewise linear function at position \a x
  */
 double Pwl::eval(double x, int *span, bool updateSpan) const
 {
-	int index = findSpan(x, span && *span != -1
-					? *span
-					: points_.size() / 2 - 1);
+	int guess;
+	if (span && *span != -1)
+		guess = *span;
+	else if (!spans_.empty())
+		guess = lookupSpan(x);
+	else
+		guess = points_.size() / 2 - 1;
+
+	int index = findSpan(x, guess);
 	if (span && updateSpan)
 		*span = index;
 	return points_[index].y() +
@@ -255,6 +270,50 @@ int Pwl::findSpan(double x, int span) const
 	return span;
 }
 
+/**
+ * \brief Build a lookup table to speed up evaluation
+ * \param[in] resolution The number of lookup table entries
+ *
+ * Divide the domain of the function in \a resolution intervals of equal
+ * length, and store the span in which each interval starts. eval() then finds
+ * the span of any x value in constant time, independently of the number of
+ * points, when no initial guess for the span is supplied. This is useful for
+ * functions with many points that are evaluated many times at unrelated
+ * positions. The result of eval() is not affected.
+ *
+ * The lookup table is discarded when points are added to the function, and
+ * bake() must then be called again.
+ */
+void Pwl::bake(unsigned int resolution)
+{
+	spans_.clear();
+
+	if (points_.size() < 2 || !resolution)
+		return;
+
+	Interval dom = domain();
+	if (dom.length() <= 0)
+		return;
+
+	spansScale_ = resolution / dom.length();
+
+	spans_.resize(resolution);
+
+	int span = 0;
+	for (unsigned int i = 0; i < resolution; i++) {
+		span = findSpan(dom.start + i / spansScale_, span);
+		spans_[i] = span;
+	}
+}
+
+int Pwl::lookupSpan(double x) const
+{
+	double pos = (x - points_[0].x()) * spansScale_;
+	pos = std::clamp(pos, 0.0, spans_.size() - 1.0);
+
+	return spans_[static_cast<unsigned int>(pos)];
+}
+
 /**
  * \brief Compute the inverse function
  * \param[in] eps Epsilon for the minimum x distance between points (optional)
@@ -268,25 +327,44 @@ int Pwl::findSpan(double x, int span) const
 std::pair<Pwl, bool> Pwl::inverse(const double eps) const
 {
 	bool appended = false, prepended = false, neither = false;
-	Pwl inverse;
+
+	/*
+	 * Collect the points prepended to the inverse in reverse order in a
+	 * separate vector, to avoid inserting at the front of the points
+	 * vector repeatedly.
+	 */
+	std::vector<Point> front;
+	std::vector<Point> back;
+	back.reserve(points_.size());
 
 	for (Point const &p : points_) {
-		if (inverse.empty()) {
-			inverse.append(p.y(), p.x(), eps);
-		} else if (std::abs(inverse.points_.back().x() - p.y()) <= eps ||
-			   std::abs(inverse.points_.front().x() - p.y()) <= eps) {
+		if (back.empty()) {
+			back.push_back(Point({ p.y(), p.x() }));
+			continue;
+		}
+
+		double firstX = front.empty() ? back.front().x() : front.back().x();
+		double lastX = back.back().x();
+
+		if (std::abs(lastX - p.y()) <= eps ||
+		    std::abs(firstX - p.y()) <= eps) {
 			/* do nothing */;
-		} else if (p.y() > inverse.points_.back().x()) {
-			inverse.append(p.y(), p.x(), eps);
+		} else if (p.y() > lastX) {
+			back.push_back(Point({ p.y(), p.x() }));
 			appended = true;
-		} else if (p.y() < inverse.points_.front().x()) {
-			inverse.prepend(p.y(), p.x(), eps);
+		} else if (p.y() < firstX) {
+			front.push_back(Point({ p.y(), p.x() }));
 			prepended = true;
 		} else {
 			neither = true;
 		}
 	}
 
+	Pwl inverse;
+	inverse.points_.reserve(front.size() + back.size());
+	inverse.points_.insert(inverse.points_.end(), front.rbegin(), front.rend());
+	inverse.points_.insert(inverse.points_.end(), back.begin(), back.end());
+
 	/*
 	 * This is not a proper inverse if we found ourselves putting points
 	 * onto both ends of the inverse, or if there were points that couldn't
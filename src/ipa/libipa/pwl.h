@@ -57,6 +57,7 @@ public:
 
 	double eval(double x, int *span = nullptr,
 		    bool updateSpan = true) const;
+	void bake(unsigned int resolution);
 
 	std::pair<Pwl, bool> inverse(double eps = 1e-6) const;
 	Pwl compose(const Pwl &other, double eps = 1e-6) const;
@@ -77,8 +78,12 @@ private:
 			 std::function<void(double x, double y0, double y1)> f);
 	void prepend(double x, double y, double eps = 1e-6);
 	int findSpan(double x, int span) const;
+	int lookupSpan(double x) const;
 
 	std::vector<Point> points_;
+
+	std::vector<int> spans_;
+	double spansScale_;
 };
 
 } /* namespace ipa */
@@ -0,0 +1,310 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas On Board
+ *
+ * Algorithm processing time measurement
+ */
+
+#include "timing.h"
+
+#include <sstream>
+
+#include <libcamera/base/log.h>
+
+#include "libcamera/internal/tracepoints.h"
+
+/**
+ * \file timing.h
+ * \brief Measurement of the processing time of IPA algorithms
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(IPATimings)
+
+namespace ipa {
+
+namespace {
+
+const char *const stageNames[] = { "prepare", "process" };
+
+} /* namespace */
+
+/**
+ * \class TimingHistogram
+ * \brief Histogram of processing durations
+ *
+ * The TimingHistogram class accumulates durations in kNumBins logarithmic
+ * bins. Bin 0 counts durations shorter than 2µs, bin i counts durations in the
+ * [2^i, 2^(i+1)[ µs range, and the last bin counts all longer durations. The
+ * minimum, maximum and mean durations are tracked alongside the bins.
+ *
+ * Recording a duration doesn't allocate memory.
+ */
+
+/**
+ * \var TimingHistogram::kNumBins
+ * \brief The number of bins in the histogram
+ */
+
+/**
+ * \brief Construct an empty TimingHistogram
+ */
+TimingHistogram::TimingHistogram()
+{
+	reset();
+}
+
+/**
+ * \brief Record a duration in the histogram
+ * \param[in] duration The duration
+ */
+void TimingHistogram::record(std::chrono::nanoseconds duration)
+{
+	uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+	unsigned int bin = 0;
+
+	while (us > 1 && bin < kNumBins - 1) {
+		us >>= 1;
+		bin++;
+	}
+
+	bins_[bin]++;
+
+	if (!count_ || duration < min_)
+		min_ = duration;
+	if (!count_ || duration > max_)
+		max_ = duration;
+
+	total_ += duration;
+	count_++;
+}
+
+/**
+ * \brief Reset the histogram to its initial empty state
+ */
+void TimingHistogram::reset()
+{
+	bins_.fill(0);
+	count_ = 0;
+	total_ = {};
+	min_ = {};
+	max_ = {};
+}
+
+/**
+ * \fn TimingHistogram::count()
+ * \brief Retrieve the number of durations recorded in the histogram
+ * \return The number of recorded durations
+ */
+
+/**
+ * \fn TimingHistogram::min()
+ * \brief Retrieve the shortest recorded duration
+ * \return The shortest recorded duration, or 0 if the histogram is empty
+ */
+
+/**
+ * \fn TimingHistogram::max()
+ * \brief Retrieve the longest recorded duration
+ * \return The longest recorded duration, or 0 if the histogram is empty
+ */
+
+/**
+ * \brief Retrieve the mean recorded duration
+ * \return The mean recorded duration, or 0 if the histogram is empty
+ */
+std::chrono::nanoseconds TimingHistogram::mean() const
+{
+	if (!count_)
+		return {};
+
+	return total_ / count_;
+}
+
+/**
+ * \fn TimingHistogram::bins()
+ * \brief Retrieve the histogram bins
+ * \return The number of durations recorded in each bin
+ */
+
+/**
+ * \brief Assemble and return a string describing the histogram
+ * \return A string describing the histogram
+ */
+std::string TimingHistogram::toString() const
+{
+	using std::chrono::duration_cast;
+	using std::chrono::microseconds;
+
+	std::stringstream ss;
+
+	ss << "count " << count_
+	   << " min " << duration_cast<microseconds>(min_).count() << "us"
+	   << " mean " << duration_cast<microseconds>(mean()).count() << "us"
+	   << " max " << duration_cast<microseconds>(max_).count() << "us"
+	   << " bins [";
+
+	for (unsigned int i = 0; i < kNumBins; ++i)
+		ss << (i ? " " : "") << bins_[i];
+
+	ss << "]";
+
+	return ss.str();
+}
+
+/**
+ * \class AlgorithmTimings
+ * \brief Per-algorithm processing time statistics
+ *
+ * The AlgorithmTimings class records the duration of the prepare() and
+ * process() calls of each algorithm of an IPA module in a TimingHistogram, to
+ * identify the algorithms that consume the largest part of the per-frame
+ * processing budget.
+ *
+ * Algorithms are registered with add(), which returns the index used to
+ * identify them. Calls are measured by keeping the Scope returned by measure()
+ * alive for the duration of the call:
+ *
+ * \code{.cpp}
+ * {
+ *	AlgorithmTimings::Scope scope = timings.measure(index, AlgorithmTimings::Process);
+ *	algo->process(...);
+ * }
+ * \endcode
+ *
+ * Every measured call is also reported through the ipa_algorithm_timing
+ * tracepoint when tracing is enabled.
+ */
+
+/**
+ * \enum AlgorithmTimings::Stage
+ * \brief The algorithm function being measured
+ * \var AlgorithmTimings::Prepare
+ * \brief The prepare() function
+ * \var AlgorithmTimings::Process
+ * \brief The process() function
+ * \var AlgorithmTimings::NumStages
+ * \brief The number of stages
+ */
+
+/**
+ * \class AlgorithmTimings::Scope
+ * \brief Measure the duration of a scope
+ *
+ * The Scope class records the time elapsed between its construction and its
+ * destruction in the AlgorithmTimings it has been created from.
+ */
+
+/**
+ * \fn AlgorithmTimings::Scope::Scope()
+ * \brief Start measuring a call
+ * \param[in] timings The AlgorithmTimings to record the duration in
+ * \param[in] index The algorithm index
+ * \param[in] stage The algorithm function being measured
+ */
+
+/**
+ * \fn AlgorithmTimings::Scope::~Scope()
+ * \brief Stop measuring the call and record its duration
+ */
+
+/**
+ * \brief Register an algorithm
+ * \param[in] name The algorithm name
+ * \return The index identifying the algorithm
+ */
+unsigned int AlgorithmTimings::add(const std::string &name)
+{
+	entries_.push_back({ name, {} });
+	return entries_.size() - 1;
+}
+
+/**
+ * \brief Unregister all algorithms
+ */
+void AlgorithmTimings::clear()
+{
+	entries_.clear();
+}
+
+/**
+ * \fn AlgorithmTimings::measure()
+ * \brief Start measuring a call
+ * \param[in] index The algorithm index
+ * \param[in] stage The algorithm function being measured
+ * \return A Scope that records the call duration when destroyed
+ */
+
+/**
+ * \brief Record the duration of a call
+ * \param[in] index The algorithm index
+ * \param[in] stage The algorithm function that has been measured
+ * \param[in] duration The call duration
+ */
+void AlgorithmTimings::record(unsigned int index, Stage stage,
+			      std::chrono::nanoseconds duration)
+{
+	Entry &entry = entries_[index];
+	entry.histograms[stage].record(duration);
+
+	LIBCAMERA_TRACEPOINT(ipa_algorithm_timing, entry.name.c_str(),
+			     stageNames[stage], duration.count());
+}
+
+/**
+ * \fn AlgorithmTimings::size()
+ * \brief Retrieve the number of registered algorithms
+ * \return The number of registered algorithms
+ */
+
+/**
+ * \fn AlgorithmTimings::name()
+ * \brief Retrieve the name of an algorithm
+ * \param[in] index The algorithm index
+ * \return The algorithm name
+ */
+
+/**
+ * \fn AlgorithmTimings::histogram()
+ * \brief Retrieve the timing histogram of an algorithm function
+ * \param[in] index The algorithm index
+ * \param[in] stage The algorithm function
+ * \return The timing histogram
+ */
+
+/**
+ * \brief Log the timing histograms of all algorithms
+ *
+ * The histograms are logged at debug level in the IPATimings category. Only
+ * the functions that have been measured at least once are reported.
+ */
+void AlgorithmTimings::report() const
+{
+	for (const Entry &entry : entries_) {
+		for (unsigned int stage = 0; stage < NumStages; ++stage) {
+			const TimingHistogram &histogram = entry.histograms[stage];
+			if (!histogram.count())
+				continue;
+
+			LOG(IPATimings, Debug)
+				<< entry.name << " " << stageNames[stage] << ": "
+				<< histogram.toString();
+		}
+	}
+}
+
+/**
+ * \brief Reset the timing histograms of all algorithms
+ */
+void AlgorithmTimings::reset()
+{
+	for (Entry &entry : entries_) {
+		for (TimingHistogram &histogram : entry.histograms)
+			histogram.reset();
+	}
+}
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
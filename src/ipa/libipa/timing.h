@@ -0,0 +1,116 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas On Board
+ *
+ * Algorithm processing time measurement
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+namespace ipa {
+
+class TimingHistogram
+{
+public:
+	static constexpr unsigned int kNumBins = 16;
+
+	TimingHistogram();
+
+	void record(std::chrono::nanoseconds duration);
+	void reset();
+
+	unsigned int count() const { return count_; }
+	std::chrono::nanoseconds min() const { return min_; }
+	std::chrono::nanoseconds max() const { return max_; }
+	std::chrono::nanoseconds mean() const;
+	const std::array<uint32_t, kNumBins> &bins() const { return bins_; }
+
+	std::string toString() const;
+
+private:
+	std::array<uint32_t, kNumBins> bins_;
+	unsigned int count_;
+	std::chrono::nanoseconds total_;
+	std::chrono::nanoseconds min_;
+	std::chrono::nanoseconds max_;
+};
+
+class AlgorithmTimings
+{
+public:
+	enum Stage {
+		Prepare,
+		Process,
+		NumStages,
+	};
+
+	class Scope
+	{
+	public:
+		Scope(AlgorithmTimings *timings, unsigned int index, Stage stage)
+			: timings_(timings), index_(index), stage_(stage),
+			  start_(utils::clock::now())
+		{
+		}
+
+		~Scope()
+		{
+			timings_->record(index_, stage_, utils::clock::now() - start_);
+		}
+
+	private:
+		LIBCAMERA_DISABLE_COPY_AND_MOVE(Scope)
+
+		AlgorithmTimings *timings_;
+		unsigned int index_;
+		Stage stage_;
+		utils::time_point start_;
+	};
+
+	unsigned int add(const std::string &name);
+	void clear();
+
+	Scope measure(unsigned int index, Stage stage)
+	{
+		return { this, index, stage };
+	}
+
+	void record(unsigned int index, Stage stage,
+		    std::chrono::nanoseconds duration);
+
+	unsigned int size() const { return entries_.size(); }
+	const std::string &name(unsigned int index) const
+	{
+		return entries_[index].name;
+	}
+	const TimingHistogram &histogram(unsigned int index, Stage stage) const
+	{
+		return entries_[index].histograms[stage];
+	}
+
+	void report() const;
+	void reset();
+
+private:
+	struct Entry {
+		std::string name;
+		std::array<TimingHistogram, NumStages> histograms;
+	};
+
+	std::vector<Entry> entries_;
+};
+
+} /* namespace ipa */
+
+} /* namespace libcamera */
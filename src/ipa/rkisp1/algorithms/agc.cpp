@@ -246,6 +246,22 @@ double Agc::estimateLuminance(double gain) const
 	return ySum / expMeans_.size() / 255;
 }
 
+/**
+ * \brief Retrieve the luminance model of the current frame
+ *
+ * The model counts the AE cells of each mean value, and matches the
+ * estimateLuminance() implementation.
+ *
+ * \return The luminance model, or nullptr outside of process()
+ */
+const Agc::LuminanceModel *Agc::luminanceModel() const
+{
+	if (expMeans_.empty())
+		return nullptr;
+
+	return &luminanceModel_;
+}
+
 /**
  * \brief Process RkISP1 statistics, and run AGC operations
  * \param[in] context The shared IPA context
@@ -282,6 +298,12 @@ void Agc::process(IPAContext &context, [[maybe_unused]] const uint32_t frame,
 		       [](uint32_t x) { return x >> 4; });
 	expMeans_ = { params->ae.exp_mean, context.hw->numAeCells };
 
+	luminanceModel_.weights.assign(256, 0.0);
+	for (uint8_t expMean : expMeans_)
+		luminanceModel_.weights[expMean]++;
+	luminanceModel_.saturation = 255.0;
+	luminanceModel_.normalisation = expMeans_.size() * 255.0;
+
 	/*
 	 * The Agc algorithm needs to know the effective exposure value that was
 	 * applied to the sensor when the statistics were collected.
@@ -47,8 +47,10 @@ private:
 	void fillMetadata(IPAContext &context, IPAFrameContext &frameContext,
 			  ControlList &metadata);
 	double estimateLuminance(double gain) const override;
+	const LuminanceModel *luminanceModel() const override;
 
 	Span<const uint8_t> expMeans_;
+	LuminanceModel luminanceModel_;
 };
 
 } /* namespace ipa::rkisp1::algorithms */
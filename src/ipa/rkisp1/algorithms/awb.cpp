@@ -64,6 +64,8 @@ int Awb::configure(IPAContext &context,
 
 	context.configuration.awb.enabled = true;
 
+	gains_.reset();
+
 	return 0;
 }
 
@@ -120,13 +122,17 @@ void Awb::prepare(IPAContext &context, const uint32_t frame,
 		frameContext.awb.gains.blue = context.activeState.awb.gains.automatic.blue;
 	}
 
-	params->others.awb_gain_config.gain_green_b = 256 * frameContext.awb.gains.green;
-	params->others.awb_gain_config.gain_blue = 256 * frameContext.awb.gains.blue;
-	params->others.awb_gain_config.gain_red = 256 * frameContext.awb.gains.red;
-	params->others.awb_gain_config.gain_green_r = 256 * frameContext.awb.gains.green;
+	rkisp1_cif_isp_awb_gain_config gains = {};
+	gains.gain_green_b = 256 * frameContext.awb.gains.green;
+	gains.gain_blue = 256 * frameContext.awb.gains.blue;
+	gains.gain_red = 256 * frameContext.awb.gains.red;
+	gains.gain_green_r = 256 * frameContext.awb.gains.green;
 
-	/* Update the gains. */
-	params->module_cfg_update |= RKISP1_CIF_ISP_MODULE_AWB_GAIN;
+	/* Update the gains, only when they have changed. */
+	if (gains_.update(gains)) {
+		params->others.awb_gain_config = gains;
+		params->module_cfg_update |= RKISP1_CIF_ISP_MODULE_AWB_GAIN;
+	}
 
 	/* If we have already set the AWB measurement parameters, return. */
 	if (frame > 0)
@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <linux/rkisp1-config.h>
+
 #include "algorithm.h"
+#include "utils.h"
 
 namespace libcamera {
 
@@ -35,6 +38,8 @@ private:
 	uint32_t estimateCCT(double red, double green, double blue);
 
 	bool rgbMode_;
+
+	utils::ParamsBlockTracker<rkisp1_cif_isp_awb_gain_config> gains_;
 };
 
 } /* namespace ipa::rkisp1::algorithms */
@@ -84,7 +84,7 @@ void GammaOutCorrection::queueRequest(IPAContext &context, const uint32_t frame,
 		frameContext.goc.update = true;
 
 	const auto &gamma = controls.get(controls::Gamma);
-	if (gamma) {
+	if (gamma && *gamma != context.activeState.goc.gamma) {
 		context.activeState.goc.gamma = *gamma;
 		frameContext.goc.update = true;
 		LOG(RkISP1Gamma, Debug) << "Set gamma to " << *gamma;
@@ -90,7 +90,7 @@ static std::vector<uint16_t> parseTable(const YamlObject &tuningData,
 }
 
 LensShadingCorrection::LensShadingCorrection()
-	: lastCt_({ 0, 0 })
+	: nextInterpolated_(0), lastCt_({ 0, 0 })
 {
 }
 
@@ -181,6 +181,9 @@ int LensShadingCorrection::configure(IPAContext &context,
 		yGrad_[i] = std::round(32768 / ySizes_[i]);
 	}
 
+	/* Make sure the tables are programmed on the first frame. */
+	lastCt_ = { 0, 0 };
+
 	context.configuration.lsc.enabled = true;
 	return 0;
 }
@@ -211,7 +214,7 @@ void LensShadingCorrection::copyTable(rkisp1_cif_isp_lsc_config &config,
 /*
  * Interpolate LSC parameters based on color temperature value.
  */
-void LensShadingCorrection::interpolateTable(rkisp1_cif_isp_lsc_config &config,
+void LensShadingCorrection::interpolateTable(Components &set,
 					     const Components &set0,
 					     const Components &set1,
 					     const uint32_t ct)
@@ -219,27 +222,49 @@ void LensShadingCorrection::interpolateTable(rkisp1_cif_isp_lsc_config &config,
 	double coeff0 = (set1.ct - ct) / static_cast<double>(set1.ct - set0.ct);
 	double coeff1 = (ct - set0.ct) / static_cast<double>(set1.ct - set0.ct);
 
-	for (unsigned int i = 0; i < RKISP1_CIF_ISP_LSC_SAMPLES_MAX; ++i) {
-		for (unsigned int j = 0; j < RKISP1_CIF_ISP_LSC_SAMPLES_MAX; ++j) {
-			unsigned int sample = i * RKISP1_CIF_ISP_LSC_SAMPLES_MAX + j;
+	set.ct = ct;
+	set.r.resize(set0.r.size());
+	set.gr.resize(set0.gr.size());
+	set.gb.resize(set0.gb.size());
+	set.b.resize(set0.b.size());
+
+	for (unsigned int i = 0; i < set0.r.size(); ++i) {
+		set.r[i] = set0.r[i] * coeff0 + set1.r[i] * coeff1;
+		set.gr[i] = set0.gr[i] * coeff0 + set1.gr[i] * coeff1;
+		set.gb[i] = set0.gb[i] * coeff0 + set1.gb[i] * coeff1;
+		set.b[i] = set0.b[i] * coeff0 + set1.b[i] * coeff1;
+	}
+}
 
-			config.r_data_tbl[i][j] =
-				set0.r[sample] * coeff0 +
-				set1.r[sample] * coeff1;
+/*
+ * Retrieve the table interpolated for the color temperature ct, from the
+ * cache if available. The least recently interpolated table is replaced on
+ * cache misses, reusing its memory.
+ */
+const LensShadingCorrection::Components &
+LensShadingCorrection::interpolatedSet(const Components &set0,
+				       const Components &set1,
+				       const uint32_t ct)
+{
+	for (const Components &set : interpolated_) {
+		if (set.ct == ct)
+			return set;
+	}
 
-			config.gr_data_tbl[i][j] =
-				set0.gr[sample] * coeff0 +
-				set1.gr[sample] * coeff1;
+	if (interpolated_.size() < kMaxInterpolatedSets) {
+		interpolated_.emplace_back();
+		nextInterpolated_ = interpolated_.size() - 1;
+	}
 
-			config.gb_data_tbl[i][j] =
-				set0.gb[sample] * coeff0 +
-				set1.gb[sample] * coeff1;
+	Components &set = interpolated_[nextInterpolated_];
+	nextInterpolated_ = (nextInterpolated_ + 1) % kMaxInterpolatedSets;
 
-			config.b_data_tbl[i][j] =
-				set0.b[sample] * coeff0 +
-				set1.b[sample] * coeff1;
-		}
-	}
+	LOG(RkISP1Lsc, Debug)
+		<< "ct is " << ct << ", interpolating between "
+		<< set0.ct << " and " << set1.ct;
+	interpolateTable(set, set0, set1, ct);
+
+	return set;
 }
 
 /**
@@ -294,13 +319,20 @@ void LensShadingCorrection::prepare(IPAContext &context,
 	    (lastCt_.adjusted <= ct && ct <= lastCt_.original))
 		return;
 
-	setParameters(params);
+	/*
+	 * In all the cases below, the LSC is only reprogrammed if the selected
+	 * table differs from the one that was applied last.
+	 */
 
 	/*
 	 * The color temperature matches exactly one of the available LSC tables.
 	 */
 	if (sets_.count(ct)) {
-		copyTable(config, sets_[ct]);
+		if (ct != lastCt_.adjusted) {
+			setParameters(params);
+			copyTable(config, sets_[ct]);
+		}
+
 		lastCt_ = { ct, ct };
 		return;
 	}
@@ -318,21 +350,32 @@ void LensShadingCorrection::prepare(IPAContext &context,
 
 	if (diff0 < threshold || diff1 < threshold) {
 		const Components &set = diff0 < diff1 ? set0 : set1;
-		LOG(RkISP1Lsc, Debug) << "using LSC table for " << set.ct;
-		copyTable(config, set);
+		if (set.ct != lastCt_.adjusted) {
+			LOG(RkISP1Lsc, Debug) << "using LSC table for " << set.ct;
+			setParameters(params);
+			copyTable(config, set);
+		}
+
 		lastCt_ = { ct, set.ct };
 		return;
 	}
 
 	/*
 	 * ct is not within 10% of the difference between the neighbouring
-	 * color temperatures, so we need to interpolate.
+	 * color temperatures, so we need to interpolate. Quantise the color
+	 * temperature to limit the number of distinct interpolated tables,
+	 * which are then cached, and to avoid reprogramming the LSC for small
+	 * color temperature changes.
 	 */
-	LOG(RkISP1Lsc, Debug)
-		<< "ct is " << ct << ", interpolating between "
-		<< ct0 << " and " << ct1;
-	interpolateTable(config, set0, set1, ct);
-	lastCt_ = { ct, ct };
+	uint32_t quantisedCt = (ct + kCtQuantum / 2) / kCtQuantum * kCtQuantum;
+	quantisedCt = std::clamp(quantisedCt, ct0 + 1, ct1 - 1);
+
+	if (quantisedCt != lastCt_.adjusted) {
+		setParameters(params);
+		copyTable(config, interpolatedSet(set0, set1, quantisedCt));
+	}
+
+	lastCt_ = { ct, quantisedCt };
 }
 
 REGISTER_IPA_ALGORITHM(LensShadingCorrection, "LensShadingCorrection")
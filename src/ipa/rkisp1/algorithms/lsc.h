@@ -8,6 +8,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "algorithm.h"
 
@@ -38,11 +39,20 @@ private:
 
 	void setParameters(rkisp1_params_cfg *params);
 	void copyTable(rkisp1_cif_isp_lsc_config &config, const Components &set0);
-	void interpolateTable(rkisp1_cif_isp_lsc_config &config,
+	void interpolateTable(Components &set,
 			      const Components &set0, const Components &set1,
 			      const uint32_t ct);
+	const Components &interpolatedSet(const Components &set0,
+					  const Components &set1,
+					  const uint32_t ct);
+
+	/* Colour temperature step of the interpolated tables, in Kelvin */
+	static constexpr uint32_t kCtQuantum = 50;
+	static constexpr unsigned int kMaxInterpolatedSets = 8;
 
 	std::map<uint32_t, Components> sets_;
+	std::vector<Components> interpolated_;
+	unsigned int nextInterpolated_;
 	std::vector<double> xSize_;
 	std::vector<double> ySize_;
 	uint16_t xGrad_[RKISP1_CIF_ISP_LSC_SECTORS_TBL_SIZE];
@@ -16,6 +16,7 @@
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/control_ids.h>
 #include <libcamera/framebuffer.h>
@@ -169,7 +170,7 @@ int IPARkISP1::init(const IPASettings &settings, unsigned int hwRevision,
 		return ret;
 	}
 
-	std::unique_ptr<libcamera::YamlObject> data = YamlParser::parse(file);
+	std::shared_ptr<const libcamera::YamlObject> data = YamlParser::parseShared(file);
 	if (!data)
 		return -EINVAL;
 
@@ -205,6 +206,9 @@ int IPARkISP1::start()
 
 void IPARkISP1::stop()
 {
+	timings().report();
+	timings().reset();
+
 	context_.frameContexts.clear();
 }
 
@@ -251,6 +255,7 @@ int IPARkISP1::configure(const IPAConfigInfo &ipaConfig,
 		minExposure * context_.configuration.sensor.lineDuration;
 	context_.configuration.sensor.maxShutterSpeed =
 		maxExposure * context_.configuration.sensor.lineDuration;
+	camHelper_->setGainCodeLimits(minGain, maxGain);
 	context_.configuration.sensor.minAnalogueGain = camHelper_->gain(minGain);
 	context_.configuration.sensor.maxAnalogueGain = camHelper_->gain(maxGain);
 
@@ -330,8 +335,10 @@ void IPARkISP1::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
 	/* Prepare parameters buffer. */
 	memset(params, 0, sizeof(*params));
 
-	for (auto const &algo : algorithms())
+	for (auto const &[i, algo] : utils::enumerate(algorithms())) {
+		auto scope = timings().measure(i, AlgorithmTimings::Prepare);
 		algo->prepare(context_, frame, frameContext, params);
+	}
 
 	paramsBufferReady.emit(frame);
 }
@@ -357,10 +364,12 @@ void IPARkISP1::processStatsBuffer(const uint32_t frame, const uint32_t bufferId
 
 	ControlList metadata(controls::controls);
 
-	for (auto const &a : algorithms()) {
+	for (auto const &[i, a] : utils::enumerate(algorithms())) {
 		Algorithm *algo = static_cast<Algorithm *>(a.get());
 		if (algo->disabled_)
 			continue;
+
+		auto scope = timings().measure(i, AlgorithmTimings::Process);
 		algo->process(context_, frame, frameContext, stats, metadata);
 	}
 
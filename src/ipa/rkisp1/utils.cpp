@@ -37,6 +37,42 @@ namespace ipa::rkisp1::utils {
  * \return The converted value
  */
 
+/**
+ * \class ParamsBlockTracker
+ * \brief Track the last value written to a parameters buffer block
+ * \tparam T The parameters block type
+ *
+ * The ISP only reprograms the blocks whose update flag is set in the
+ * parameters buffer. Algorithms that compute a block for every frame use this
+ * class to skip writing the block and setting its update flag when the value
+ * hasn't changed since it was last written. Blocks are compared bytewise, the
+ * values passed to update() should thus be zero-initialised before being
+ * filled to avoid spurious differences in padding bytes.
+ *
+ * The tracker shall be reset when the ISP is configured, to ensure the first
+ * frame always programs the block.
+ */
+
+/**
+ * \fn ParamsBlockTracker::ParamsBlockTracker()
+ * \brief Construct a ParamsBlockTracker with no recorded value
+ */
+
+/**
+ * \fn ParamsBlockTracker::reset()
+ * \brief Forget the recorded value
+ *
+ * The next call to update() will report the block as changed.
+ */
+
+/**
+ * \fn ParamsBlockTracker::update()
+ * \brief Record a block value and check if it has changed
+ * \param[in] block The block value
+ * \return True if the block differs from the last recorded value and needs to
+ * be written to the parameters buffer, false otherwise
+ */
+
 } /* namespace ipa::rkisp1::utils */
 
 } /* namespace libcamera */
@@ -9,6 +9,7 @@
 
 #include <cmath>
 #include <limits>
+#include <string.h>
 #include <type_traits>
 
 namespace libcamera {
@@ -61,6 +62,34 @@ constexpr R fixedToFloatingPoint(T number)
 	return static_cast<R>(t) / static_cast<R>(1 << F);
 }
 
+template<typename T>
+class ParamsBlockTracker
+{
+public:
+	ParamsBlockTracker()
+		: valid_(false)
+	{
+	}
+
+	void reset() { valid_ = false; }
+
+	bool update(const T &block)
+	{
+		if (valid_ && !memcmp(&block, &last_, sizeof(block)))
+			return false;
+
+		last_ = block;
+		valid_ = true;
+		return true;
+	}
+
+private:
+	static_assert(std::is_trivially_copyable_v<T>);
+
+	T last_;
+	bool valid_;
+};
+
 } /* namespace ipa::rkisp1::utils */
 
 } /* namespace libcamera */
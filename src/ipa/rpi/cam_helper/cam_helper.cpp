@@ -215,18 +215,17 @@ unsigned int CamHelper::mistrustFramesModeSwitch() const
 void CamHelper::parseEmbeddedData(Span<const uint8_t> buffer,
 				  Metadata &metadata)
 {
-	MdParser::RegisterMap registers;
 	Metadata parsedMetadata;
 
 	if (buffer.empty())
 		return;
 
-	if (parser_->parse(buffer, registers) != MdParser::Status::OK) {
+	if (parser_->parse(buffer, registers_) != MdParser::Status::OK) {
 		LOG(IPARPI, Error) << "Embedded data buffer parsing failed";
 		return;
 	}
 
-	populateMetadata(registers, parsedMetadata);
+	populateMetadata(registers_, parsedMetadata);
 	metadata.merge(parsedMetadata);
 
 	/*
@@ -235,8 +234,8 @@ void CamHelper::parseEmbeddedData(Span<const uint8_t> buffer,
 	 * Fetch it first in case any other fields were set meaningfully.
 	 */
 	DeviceStatus deviceStatus, parsedDeviceStatus;
-	if (metadata.get("device.status", deviceStatus) ||
-	    parsedMetadata.get("device.status", parsedDeviceStatus)) {
+	if (metadata.get(MetadataTag::Device, deviceStatus) ||
+	    parsedMetadata.get(MetadataTag::Device, parsedDeviceStatus)) {
 		LOG(IPARPI, Error) << "DeviceStatus not found";
 		return;
 	}
@@ -250,7 +249,7 @@ void CamHelper::parseEmbeddedData(Span<const uint8_t> buffer,
 
 	LOG(IPARPI, Debug) << "Metadata updated - " << deviceStatus;
 
-	metadata.set("device.status", deviceStatus);
+	metadata.set(MetadataTag::Device, deviceStatus);
 }
 
 void CamHelper::populateMetadata([[maybe_unused]] const MdParser::RegisterMap &registers,
@@ -115,6 +115,9 @@ private:
 	 * in units of lines.
 	 */
 	unsigned int frameIntegrationDiff_;
+
+	/* Register values parsed from the embedded data, reused every frame. */
+	MdParser::RegisterMap registers_;
 };
 
 /*
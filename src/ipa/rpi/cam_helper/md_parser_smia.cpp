@@ -5,7 +5,10 @@
  * SMIA specification based embedded data parser
  */
 
+#include <algorithm>
+
 #include <libcamera/base/log.h>
+
 #include "md_parser.h"
 
 using namespace RPiController;
@@ -43,8 +46,8 @@ MdParser::Status MdParserSmia::parse(libcamera::Span<const uint8_t> buffer,
 		 */
 		ASSERT(bitsPerPixel_);
 
-		for (const auto &kv : offsets_)
-			offsets_[kv.first] = {};
+		for (auto &[reg, offset] : offsets_)
+			offset.reset();
 
 		ParseStatus ret = findRegs(buffer);
 		/*
@@ -59,14 +62,29 @@ MdParser::Status MdParserSmia::parse(libcamera::Span<const uint8_t> buffer,
 		reset_ = false;
 	}
 
-	/* Populate the register values requested. */
-	registers.clear();
+	/*
+	 * Populate the register values requested. Callers usually reuse the
+	 * same register map for every frame, so update the values in place
+	 * when the map already holds the requested registers, to avoid
+	 * reallocating the map on every frame.
+	 */
+	bool reuse = registers.size() == offsets_.size() &&
+		     std::equal(offsets_.begin(), offsets_.end(), registers.begin(),
+				[](const auto &a, const auto &b) { return a.first == b.first; });
+	if (!reuse)
+		registers.clear();
+
+	auto it = registers.begin();
 	for (const auto &[reg, offset] : offsets_) {
 		if (!offset) {
 			reset_ = true;
 			return NOTFOUND;
 		}
-		registers[reg] = buffer[offset.value()];
+
+		if (reuse)
+			(it++)->second = buffer[offset.value()];
+		else
+			registers.emplace_hint(registers.end(), reg, buffer[offset.value()]);
 	}
 
 	return OK;
@@ -139,7 +157,7 @@ MdParserSmia::ParseStatus MdParserSmia::findRegs(libcamera::Span<const uint8_t>
 				auto reg = offsets_.find(regNum);
 
 				if (reg != offsets_.end()) {
-					offsets_[regNum] = currentOffset - 1;
+					reg->second = currentOffset - 1;
 
 					if (++regsDone == offsets_.size())
 						return ParseOk;
@@ -33,6 +33,7 @@ namespace libcamera {
 
 using namespace std::literals::chrono_literals;
 using utils::Duration;
+using RPiController::MetadataTag;
 
 namespace {
 
@@ -104,6 +105,7 @@ namespace ipa::RPi {
 
 IpaBase::IpaBase()
 	: controller_(), frameLengths_(FrameLengthsQueueSize, 0s), statsMetadataOutput_(false),
+	  awbRegionsUsed_(false),
 	  stitchSwapBuffers_(false), frameCount_(0), mistrustCount_(0), lastRunTimestamp_(0),
 	  firstStart_(true), flickerState_({ 0, 0s })
 {
@@ -154,6 +156,14 @@ int32_t IpaBase::init(const IPASettings &settings, const InitParams &params, Ini
 
 	controller_.initialise();
 
+	/*
+	 * The AWB region statistics are the largest block to parse, skip them
+	 * when no algorithm needs them.
+	 */
+	awbRegionsUsed_ = controller_.getAlgorithm("awb") ||
+			  controller_.getAlgorithm("alsc") ||
+			  controller_.getAlgorithm("hdr");
+
 	/* Return the controls handled by the IPA */
 	ControlInfoMap::Map ctrlMap = ipaControls;
 	if (lensPresent_)
@@ -291,7 +301,7 @@ void IpaBase::start(const ControlList &controls, StartResult *result)
 	agcStatus.shutterTime = 0.0s;
 	agcStatus.analogueGain = 0.0;
 
-	metadata.get("agc.status", agcStatus);
+	metadata.get(MetadataTag::Agc, agcStatus);
 	if (agcStatus.shutterTime && agcStatus.analogueGain) {
 		ControlList ctrls(sensorCtrls_);
 		applyAGC(&agcStatus, ctrls);
@@ -351,6 +361,12 @@ void IpaBase::start(const ControlList &controls, StartResult *result)
 	platformStart(controls, result);
 }
 
+void IpaBase::stop()
+{
+	controller_.timings().report();
+	controller_.timings().reset();
+}
+
 void IpaBase::mapBuffers(const std::vector<IPABuffer> &buffers)
 {
 	for (const IPABuffer &buffer : buffers) {
@@ -409,8 +425,8 @@ void IpaBase::prepareIsp(const PrepareParams &params)
 	AgcStatus agcStatus;
 	bool hdrChange = false;
 	RPiController::Metadata &delayedMetadata = rpiMetadata_[params.delayContext];
-	if (!delayedMetadata.get<AgcStatus>("agc.status", agcStatus)) {
-		rpiMetadata.set("agc.delayed_status", agcStatus);
+	if (!delayedMetadata.get<AgcStatus>(MetadataTag::Agc, agcStatus)) {
+		rpiMetadata.set(MetadataTag::AgcDelayed, agcStatus);
 		hdrChange = agcStatus.hdr.mode != hdrStatus_.mode;
 		hdrStatus_ = agcStatus.hdr;
 	}
@@ -480,13 +496,13 @@ void IpaBase::processStats(const ProcessParams &params)
 		RPiController::StatisticsPtr statistics = platformProcessStats(it->second.planes()[0]);
 
 		/* reportMetadata() will pick this up and set the FocusFoM metadata */
-		rpiMetadata.set("focus.status", statistics->focusRegions);
+		rpiMetadata.set(MetadataTag::Focus, statistics->focusRegions);
 
 		helper_->process(statistics, rpiMetadata);
 		controller_.process(statistics, &rpiMetadata);
 
 		struct AgcStatus agcStatus;
-		if (rpiMetadata.get("agc.status", agcStatus) == 0) {
+		if (rpiMetadata.get(MetadataTag::Agc, agcStatus) == 0) {
 			ControlList ctrls(sensorCtrls_);
 			applyAGC(&agcStatus, ctrls);
 			setDelayedControls.emit(ctrls, ipaContext);
@@ -1280,7 +1296,7 @@ void IpaBase::fillDeviceStatus(const ControlList &sensorControls, unsigned int i
 
 	LOG(IPARPI, Debug) << "Metadata - " << deviceStatus;
 
-	rpiMetadata_[ipaContext].set("device.status", deviceStatus);
+	rpiMetadata_[ipaContext].set(MetadataTag::Device, deviceStatus);
 }
 
 void IpaBase::reportMetadata(unsigned int ipaContext)
@@ -1293,7 +1309,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 	 * processed can be extracted and placed into the libcamera metadata
 	 * buffer, where an application could query it.
 	 */
-	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>("device.status");
+	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>(MetadataTag::Device);
 	if (deviceStatus) {
 		libcameraMetadata_.set(controls::ExposureTime,
 				       deviceStatus->shutterSpeed.get<std::micro>());
@@ -1306,24 +1322,24 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 			libcameraMetadata_.set(controls::LensPosition, *deviceStatus->lensPosition);
 	}
 
-	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>("agc.prepare_status");
+	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>(MetadataTag::AgcPrepare);
 	if (agcPrepareStatus) {
 		libcameraMetadata_.set(controls::AeLocked, agcPrepareStatus->locked);
 		libcameraMetadata_.set(controls::DigitalGain, agcPrepareStatus->digitalGain);
 	}
 
-	LuxStatus *luxStatus = rpiMetadata.getLocked<LuxStatus>("lux.status");
+	LuxStatus *luxStatus = rpiMetadata.getLocked<LuxStatus>(MetadataTag::Lux);
 	if (luxStatus)
 		libcameraMetadata_.set(controls::Lux, luxStatus->lux);
 
-	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>("awb.status");
+	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>(MetadataTag::Awb);
 	if (awbStatus) {
 		libcameraMetadata_.set(controls::ColourGains, { static_cast<float>(awbStatus->gainR),
 								static_cast<float>(awbStatus->gainB) });
 		libcameraMetadata_.set(controls::ColourTemperature, awbStatus->temperatureK);
 	}
 
-	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>("black_level.status");
+	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>(MetadataTag::BlackLevel);
 	if (blackLevelStatus)
 		libcameraMetadata_.set(controls::SensorBlackLevels,
 				       { static_cast<int32_t>(blackLevelStatus->blackLevelR),
@@ -1332,7 +1348,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 					 static_cast<int32_t>(blackLevelStatus->blackLevelB) });
 
 	RPiController::FocusRegions *focusStatus =
-		rpiMetadata.getLocked<RPiController::FocusRegions>("focus.status");
+		rpiMetadata.getLocked<RPiController::FocusRegions>(MetadataTag::Focus);
 	if (focusStatus) {
 		/*
 		 * Calculate the average FoM over the central (symmetric) positions
@@ -1356,7 +1372,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 		libcameraMetadata_.set(controls::FocusFoM, focusFoM);
 	}
 
-	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>("ccm.status");
+	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>(MetadataTag::Ccm);
 	if (ccmStatus) {
 		float m[9];
 		for (unsigned int i = 0; i < 9; i++)
@@ -1364,7 +1380,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 		libcameraMetadata_.set(controls::ColourCorrectionMatrix, m);
 	}
 
-	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>("af.status");
+	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>(MetadataTag::Af);
 	if (afStatus) {
 		int32_t s, p;
 		switch (afStatus->state) {
@@ -1401,7 +1417,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 	 * delayed_status to be available, we use the HDR status that came out of the
 	 * switchMode call.
 	 */
-	const AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>("agc.delayed_status");
+	const AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>(MetadataTag::AgcDelayed);
 	const HdrStatus &hdrStatus = agcStatus ? agcStatus->hdr : hdrStatus_;
 	if (!hdrStatus.mode.empty() && hdrStatus.mode != "Off") {
 		int32_t hdrMode = controls::HdrModeOff;
@@ -40,7 +40,7 @@ public:
 			  ConfigResult *result) override;
 
 	void start(const ControlList &controls, StartResult *result) override;
-	void stop() override {}
+	void stop() override;
 
 	void mapBuffers(const std::vector<IPABuffer> &buffers) override;
 	void unmapBuffers(const std::vector<unsigned int> &ids) override;
@@ -70,6 +70,9 @@ protected:
 	ControlList libcameraMetadata_;
 	bool statsMetadataOutput_;
 
+	/* Whether any algorithm consumes the AWB region statistics. */
+	bool awbRegionsUsed_;
+
 	/* Remember the HDR status after a mode switch. */
 	HdrStatus hdrStatus_;
 
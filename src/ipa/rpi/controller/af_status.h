@@ -10,7 +10,7 @@
 
 /*
  * The AF algorithm should post the following structure into the image's
- * "af.status" metadata. lensSetting should control the lens.
+ * MetadataTag::Af metadata. lensSetting should control the lens.
  */
 
 enum class AfState {
@@ -14,9 +14,9 @@
 
 /*
  * The AGC algorithm process method should post an AgcStatus into the image
- * metadata under the tag "agc.status".
+ * metadata under the tag MetadataTag::Agc.
  * The AGC algorithm prepare method should post an AgcPrepareStatus instead
- * under "agc.prepare_status".
+ * under MetadataTag::AgcPrepare.
  */
 
 /*
@@ -32,6 +32,16 @@ void Algorithm::process([[maybe_unused]] StatisticsPtr &stats,
 {
 }
 
+unsigned int Algorithm::processPeriod() const
+{
+	return 1;
+}
+
+unsigned int Algorithm::processCost() const
+{
+	return 1;
+}
+
 /* For registering algorithms with the system: */
 
 namespace {
@@ -37,6 +37,14 @@ public:
 	virtual void switchMode(CameraMode const &cameraMode, Metadata *metadata);
 	virtual void prepare(Metadata *imageMetadata);
 	virtual void process(StatisticsPtr &stats, Metadata *imageMetadata);
+	/*
+	 * Scheduling hints for the controller: process() needs only be called
+	 * once every processPeriod() frames, and processCost() is the relative
+	 * cost of a call. The controller uses the costs to spread algorithms
+	 * running at a reduced rate across frames.
+	 */
+	virtual unsigned int processPeriod() const;
+	virtual unsigned int processCost() const;
 	Metadata &getGlobalMetadata() const
 	{
 		return controller_->getGlobalMetadata();
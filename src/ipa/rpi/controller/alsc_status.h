@@ -10,7 +10,7 @@
 
 /*
  * The ALSC algorithm should post the following structure into the image's
- * "alsc.status" metadata.
+ * MetadataTag::Alsc metadata.
  */
 
 struct AlscStatus {
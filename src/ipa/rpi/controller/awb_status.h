@@ -8,7 +8,7 @@
 
 /*
  * The AWB algorithm places its results into both the image and global metadata,
- * under the tag "awb.status".
+ * under the tag MetadataTag::Awb.
  */
 
 struct AwbStatus {
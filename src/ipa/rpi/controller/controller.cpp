@@ -5,7 +5,10 @@
  * ISP controller
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <limits>
+#include <numeric>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
@@ -75,8 +78,11 @@ static const std::map<std::string, Controller::HardwareConfig> HardwareConfigMap
 	},
 };
 
+/* Maximum number of frames over which process() calls are scheduled */
+static constexpr unsigned int MaxScheduleHorizon = 240;
+
 Controller::Controller()
-	: switchModeCalled_(false)
+	: processCount_(0), switchModeCalled_(false)
 {
 }
 
@@ -91,7 +97,7 @@ int Controller::read(char const *filename)
 		return -EINVAL;
 	}
 
-	std::unique_ptr<YamlObject> root = YamlParser::parse(file);
+	std::shared_ptr<const YamlObject> root = YamlParser::parseShared(file);
 	if (!root)
 		return -EINVAL;
 
@@ -146,14 +152,79 @@ int Controller::createAlgorithm(const std::string &name, const YamlObject &param
 	if (ret)
 		return ret;
 
+	/*
+	 * The rate and cost declared by the algorithm can be overridden in
+	 * the tuning file.
+	 */
+	Schedule schedule;
+	schedule.period = std::max(params["process_period"].get<unsigned int>(algo->processPeriod()), 1U);
+	schedule.cost = params["process_cost"].get<unsigned int>(algo->processCost());
+	schedule.phase = 0;
+
 	algorithms_.push_back(AlgorithmPtr(algo));
+	schedules_.push_back(schedule);
+	timings_.add(algo->name());
 	return 0;
 }
 
+/*
+ * Select the frame phase of the algorithms that don't run on every frame, to
+ * minimise the peak cost of the process() calls on any frame. Algorithms are
+ * placed greedily in decreasing order of cost, each in the phase that
+ * minimises the largest resulting per-frame cost.
+ */
+void Controller::scheduleAlgorithms()
+{
+	unsigned int horizon = 1;
+	for (const Schedule &schedule : schedules_)
+		horizon = std::min(std::lcm(horizon, schedule.period),
+				   MaxScheduleHorizon);
+
+	std::vector<unsigned int> order(schedules_.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+			 [&](unsigned int a, unsigned int b) {
+				 const Schedule &sa = schedules_[a], &sb = schedules_[b];
+				 if ((sa.period == 1) != (sb.period == 1))
+					 return sa.period == 1;
+				 return sa.cost > sb.cost;
+			 });
+
+	std::vector<unsigned int> load(horizon, 0);
+	for (unsigned int index : order) {
+		Schedule &schedule = schedules_[index];
+		unsigned int bestPeak = std::numeric_limits<unsigned int>::max();
+
+		schedule.phase = 0;
+		for (unsigned int phase = 0; phase < schedule.period; phase++) {
+			unsigned int peak = 0;
+			for (unsigned int f = phase; f < horizon; f += schedule.period)
+				peak = std::max(peak, load[f]);
+
+			if (peak < bestPeak) {
+				bestPeak = peak;
+				schedule.phase = phase;
+			}
+		}
+
+		for (unsigned int f = schedule.phase; f < horizon; f += schedule.period)
+			load[f] += schedule.cost;
+
+		if (schedule.period > 1)
+			LOG(RPiController, Debug)
+				<< "Algorithm " << algorithms_[index]->name()
+				<< " runs every " << schedule.period
+				<< " frames with phase " << schedule.phase;
+	}
+}
+
 void Controller::initialise()
 {
 	for (auto &algo : algorithms_)
 		algo->initialise();
+
+	scheduleAlgorithms();
+	processCount_ = 0;
 }
 
 void Controller::switchMode(CameraMode const &cameraMode, Metadata *metadata)
@@ -166,15 +237,24 @@ void Controller::switchMode(CameraMode const &cameraMode, Metadata *metadata)
 void Controller::prepare(Metadata *imageMetadata)
 {
 	assert(switchModeCalled_);
-	for (auto &algo : algorithms_)
-		algo->prepare(imageMetadata);
+	for (unsigned int i = 0; i < algorithms_.size(); i++) {
+		auto scope = timings_.measure(i, ipa::AlgorithmTimings::Prepare);
+		algorithms_[i]->prepare(imageMetadata);
+	}
 }
 
 void Controller::process(StatisticsPtr stats, Metadata *imageMetadata)
 {
 	assert(switchModeCalled_);
-	for (auto &algo : algorithms_)
-		algo->process(stats, imageMetadata);
+	for (unsigned int i = 0; i < algorithms_.size(); i++) {
+		const Schedule &schedule = schedules_[i];
+		if (processCount_ % schedule.period != schedule.phase)
+			continue;
+
+		auto scope = timings_.measure(i, ipa::AlgorithmTimings::Process);
+		algorithms_[i]->process(stats, imageMetadata);
+	}
+	processCount_++;
 }
 
 Metadata &Controller::getGlobalMetadata()
@@ -18,6 +18,8 @@
 #include <libcamera/base/utils.h>
 #include "libcamera/internal/yaml_parser.h"
 
+#include "libipa/timing.h"
+
 #include "camera_mode.h"
 #include "device_status.h"
 #include "metadata.h"
@@ -62,12 +64,24 @@ public:
 	Algorithm *getAlgorithm(std::string const &name) const;
 	const std::string &getTarget() const;
 	const HardwareConfig &getHardwareConfig() const;
+	libcamera::ipa::AlgorithmTimings &timings() { return timings_; }
 
 protected:
+	/* Scheduling of the process() calls of an algorithm */
+	struct Schedule {
+		unsigned int period;
+		unsigned int phase;
+		unsigned int cost;
+	};
+
 	int createAlgorithm(const std::string &name, const libcamera::YamlObject &params);
+	void scheduleAlgorithms();
 
 	Metadata globalMetadata_;
 	std::vector<AlgorithmPtr> algorithms_;
+	std::vector<Schedule> schedules_;
+	libcamera::ipa::AlgorithmTimings timings_;
+	unsigned int processCount_;
 	bool switchModeCalled_;
 
 private:
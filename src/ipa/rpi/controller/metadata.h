@@ -9,14 +9,48 @@
 /* A simple class for carrying arbitrary metadata, for example about an image. */
 
 #include <any>
-#include <map>
+#include <array>
+#include <bitset>
 #include <mutex>
-#include <string>
 
 #include <libcamera/base/thread_annotations.h>
 
 namespace RPiController {
 
+/*
+ * Metadata tags. Each tag is associated with a single type of data, stored in
+ * a fixed slot of the Metadata container, which avoids string lookups on the
+ * per-frame path. New tags must be added before Count.
+ */
+enum class MetadataTag : unsigned int {
+	Af,		/* AfStatus, "af.status" */
+	Agc,		/* AgcStatus, "agc.status" */
+	AgcDelayed,	/* AgcStatus, "agc.delayed_status" */
+	AgcPrepare,	/* AgcPrepareStatus, "agc.prepare_status" */
+	Alsc,		/* AlscStatus, "alsc.status" */
+	Awb,		/* AwbStatus, "awb.status" */
+	BlackLevel,	/* BlackLevelStatus, "black_level.status" */
+	Cac,		/* CacStatus, "cac.status" */
+	Ccm,		/* CcmStatus, "ccm.status" */
+	Cdn,		/* CdnStatus, "cdn.status" */
+	Contrast,	/* ContrastStatus, "contrast.status" */
+	Denoise,	/* DenoiseStatus, "denoise.status" */
+	Device,		/* DeviceStatus, "device.status" */
+	Dpc,		/* DpcStatus, "dpc.status" */
+	Focus,		/* FocusRegions, "focus.status" */
+	Geq,		/* GeqStatus, "geq.status" */
+	Lux,		/* LuxStatus, "lux.status" */
+	Noise,		/* NoiseStatus, "noise.status" */
+	Pdaf,		/* PdafRegions, "pdaf.regions" */
+	Saturation,	/* SaturationStatus, "saturation.status" */
+	Sdn,		/* SdnStatus, "sdn.status" */
+	Sharpen,	/* SharpenStatus, "sharpen.status" */
+	Stitch,		/* StitchStatus, "stitch.status" */
+	Tdn,		/* TdnStatus, "tdn.status" */
+	Tonemap,	/* TonemapStatus, "tonemap.status" */
+	Count,
+};
+
 class LIBCAMERA_TSA_CAPABILITY("mutex") Metadata
 {
 public:
@@ -25,59 +59,76 @@ public:
 	Metadata(Metadata const &other)
 	{
 		std::scoped_lock otherLock(other.mutex_);
-		data_ = other.data_;
+		copyFrom(other);
 	}
 
 	Metadata(Metadata &&other)
 	{
 		std::scoped_lock otherLock(other.mutex_);
-		data_ = std::move(other.data_);
-		other.data_.clear();
+		data_.swap(other.data_);
+		valid_ = other.valid_;
+		other.valid_.reset();
 	}
 
 	template<typename T>
-	void set(std::string const &tag, T const &value)
+	void set(MetadataTag tag, T const &value)
 	{
 		std::scoped_lock lock(mutex_);
-		data_[tag] = value;
+		setLocked(tag, value);
 	}
 
 	template<typename T>
-	int get(std::string const &tag, T &value) const
+	int get(MetadataTag tag, T &value) const
 	{
 		std::scoped_lock lock(mutex_);
-		auto it = data_.find(tag);
-		if (it == data_.end())
+		unsigned int index = static_cast<unsigned int>(tag);
+		if (!valid_[index])
 			return -1;
-		value = std::any_cast<T>(it->second);
+		value = std::any_cast<T const &>(data_[index]);
 		return 0;
 	}
 
 	void clear()
 	{
+		/*
+		 * Only invalidate the slots, their storage is reused by the
+		 * next set() of a value of the same type.
+		 */
 		std::scoped_lock lock(mutex_);
-		data_.clear();
+		valid_.reset();
 	}
 
 	Metadata &operator=(Metadata const &other)
 	{
 		std::scoped_lock lock(mutex_, other.mutex_);
-		data_ = other.data_;
+		copyFrom(other);
 		return *this;
 	}
 
 	Metadata &operator=(Metadata &&other)
 	{
 		std::scoped_lock lock(mutex_, other.mutex_);
-		data_ = std::move(other.data_);
-		other.data_.clear();
+		data_.swap(other.data_);
+		valid_ = other.valid_;
+		other.valid_.reset();
 		return *this;
 	}
 
 	void merge(Metadata &other)
 	{
 		std::scoped_lock lock(mutex_, other.mutex_);
-		data_.merge(other.data_);
+		/*
+		 * Move the items whose tag doesn't exist in this instance, the
+		 * other items are left in other.
+		 */
+		for (unsigned int i = 0; i < kNumTags; i++) {
+			if (!other.valid_[i] || valid_[i])
+				continue;
+
+			data_[i].swap(other.data_[i]);
+			valid_.set(i);
+			other.valid_.reset(i);
+		}
 	}
 
 	void mergeCopy(const Metadata &other)
@@ -87,27 +138,43 @@ public:
 		 * If the metadata key exists, ignore this item and copy only
 		 * unique key/value pairs.
 		 */
-		data_.insert(other.data_.begin(), other.data_.end());
+		for (unsigned int i = 0; i < kNumTags; i++) {
+			if (!other.valid_[i] || valid_[i])
+				continue;
+
+			data_[i] = other.data_[i];
+			valid_.set(i);
+		}
 	}
 
 	template<typename T>
-	T *getLocked(std::string const &tag)
+	T *getLocked(MetadataTag tag)
 	{
 		/*
 		 * This allows in-place access to the Metadata contents,
 		 * for which you should be holding the lock.
 		 */
-		auto it = data_.find(tag);
-		if (it == data_.end())
+		unsigned int index = static_cast<unsigned int>(tag);
+		if (!valid_[index])
 			return nullptr;
-		return std::any_cast<T>(&it->second);
+		return std::any_cast<T>(&data_[index]);
 	}
 
 	template<typename T>
-	void setLocked(std::string const &tag, T const &value)
+	void setLocked(MetadataTag tag, T const &value)
 	{
-		/* Use this only if you're holding the lock yourself. */
-		data_[tag] = value;
+		/*
+		 * Use this only if you're holding the lock yourself. Values are
+		 * assigned in place when the slot already holds a value of the
+		 * same type, to avoid a memory allocation.
+		 */
+		unsigned int index = static_cast<unsigned int>(tag);
+		T *slot = std::any_cast<T>(&data_[index]);
+		if (slot)
+			*slot = value;
+		else
+			data_[index] = value;
+		valid_.set(index);
 	}
 
 	/*
@@ -120,8 +187,21 @@ public:
 	void unlock() LIBCAMERA_TSA_RELEASE() { mutex_.unlock(); }
 
 private:
+	static constexpr unsigned int kNumTags =
+		static_cast<unsigned int>(MetadataTag::Count);
+
+	void copyFrom(Metadata const &other)
+	{
+		for (unsigned int i = 0; i < kNumTags; i++) {
+			if (other.valid_[i])
+				data_[i] = other.data_[i];
+		}
+		valid_ = other.valid_;
+	}
+
 	mutable std::mutex mutex_;
-	std::map<std::string, std::any> data_;
+	std::array<std::any, kNumTags> data_;
+	std::bitset<kNumTags> valid_;
 };
 
 } /* namespace RPiController */
@@ -51,7 +51,8 @@ Af::SpeedDependentParams::SpeedDependentParams()
 	  maxSlew(2.0),
 	  pdafFrames(20),
 	  dropoutFrames(6),
-	  stepFrames(4)
+	  stepFrames(4),
+	  settleFrames(0)
 {
 }
 
@@ -93,6 +94,9 @@ void Af::SpeedDependentParams::read(const libcamera::YamlObject &params)
 	readNumber<uint32_t>(pdafFrames, params, "pdaf_frames");
 	readNumber<uint32_t>(dropoutFrames, params, "dropout_frames");
 	readNumber<uint32_t>(stepFrames, params, "step_frames");
+
+	/* Optional, PDAF jumps are only enabled when the settle time is known. */
+	settleFrames = params["settle_frames"].get<uint32_t>(settleFrames);
 }
 
 int Af::CfgParams::read(const libcamera::YamlObject &params)
@@ -184,6 +188,7 @@ Af::Af(Controller *controller)
 	  skipCount_(0),
 	  stepCount_(0),
 	  dropCount_(0),
+	  settleCount_(0),
 	  scanMaxContrast_(0.0),
 	  scanMinContrast_(1.0e9),
 	  scanData_(),
@@ -407,6 +412,54 @@ void Af::doPDAF(double phase, double conf)
 	ftarget_ = fsmooth_ + phase;
 }
 
+void Af::doPDAFJump(double phase, double conf)
+{
+	const SpeedDependentParams &speed = cfg_.speeds[speed_];
+
+	/*
+	 * Wait for the lens to reach its target, moving at most maxSlew per
+	 * frame, and then for the PDAF data to reflect the new position.
+	 */
+	if (fsmooth_ != ftarget_)
+		return;
+
+	if (settleCount_ > 0) {
+		settleCount_--;
+		return;
+	}
+
+	double step = phase * speed.pdafGain;
+	if (std::abs(step) < speed.pdafSquelch) {
+		reportState_ = AfState::Focused;
+		scanState_ = ScanState::Idle;
+		return;
+	}
+
+	/*
+	 * Extrapolate the zero-phase position from the previous settled
+	 * position. Without a previous position, or if the extrapolation is
+	 * ill-conditioned, take a step with the loop gain.
+	 */
+	if (!earlyTerminationByPhase(phase))
+		ftarget_ = fsmooth_ + std::clamp(step, -speed.maxSlew, speed.maxSlew);
+
+	scanData_.emplace_back(ScanRecord{ fsmooth_, prevContrast_, phase, conf });
+
+	if (ftarget_ <= cfg_.ranges[range_].focusMin && fsmooth_ <= cfg_.ranges[range_].focusMin)
+		reportState_ = AfState::Failed;
+	else if (ftarget_ >= cfg_.ranges[range_].focusMax && fsmooth_ >= cfg_.ranges[range_].focusMax)
+		reportState_ = AfState::Failed;
+	else
+		reportState_ = AfState::Scanning;
+
+	if (reportState_ == AfState::Failed) {
+		scanState_ = ScanState::Idle;
+		return;
+	}
+
+	settleCount_ = speed.settleFrames;
+}
+
 bool Af::earlyTerminationByPhase(double phase)
 {
 	if (scanData_.size() > 0 &&
@@ -510,11 +563,20 @@ void Af::doAF(double contrast, double phase, double conf)
 		 * scan only after a number of frames with low PDAF confidence.
 		 */
 		if (conf > (dropCount_ ? 1.0 : 0.25) * cfg_.confEpsilon) {
-			doPDAF(phase, conf);
+			bool jump = mode_ != AfModeContinuous &&
+				    cfg_.speeds[speed_].settleFrames > 0;
+			if (jump)
+				doPDAFJump(phase, conf);
+			else
+				doPDAF(phase, conf);
 			if (stepCount_ > 0)
 				stepCount_--;
-			else if (mode_ != AfModeContinuous)
+			else if (mode_ != AfModeContinuous) {
+				/* A jump sequence that didn't lock by now failed. */
+				if (jump && scanState_ == ScanState::Pdaf)
+					reportState_ = AfState::Failed;
 				scanState_ = ScanState::Idle;
+			}
 			dropCount_ = 0;
 		} else if (++dropCount_ == cfg_.speeds[speed_].dropoutFrames)
 			startProgrammedScan();
@@ -583,6 +645,7 @@ void Af::startAF()
 		scanState_ = ScanState::Pdaf;
 		scanData_.clear();
 		dropCount_ = 0;
+		settleCount_ = 0;
 		reportState_ = AfState::Scanning;
 	} else
 		startProgrammedScan();
@@ -631,7 +694,7 @@ void Af::prepare(Metadata *imageMetadata)
 		double oldFs = fsmooth_;
 		ScanState oldSs = scanState_;
 		uint32_t oldSt = stepCount_;
-		if (imageMetadata->get("pdaf.regions", regions) == 0)
+		if (imageMetadata->get(MetadataTag::Pdaf, regions) == 0)
 			getPhase(regions, phase, conf);
 		doAF(prevContrast_, phase, conf);
 		updateLensPosition();
@@ -660,7 +723,7 @@ void Af::prepare(Metadata *imageMetadata)
 		status.state = reportState_;
 	status.lensSetting = initted_ ? std::optional<int>(cfg_.map.eval(fsmooth_))
 				      : std::nullopt;
-	imageMetadata->set("af.status", status);
+	imageMetadata->set(MetadataTag::Af, status);
 }
 
 void Af::process(StatisticsPtr &stats, [[maybe_unused]] Metadata *imageMetadata)
@@ -29,6 +29,13 @@
  * "nuisance" scans. During each interval where PDAF is not working, only
  * ONE scan will be performed; CAF cannot track objects using CDAF alone.
  *
+ * When the delay for a lens movement to be reflected in the PDAF data is
+ * known, triggered PDAF can instead jump the lens: after a first step given
+ * by the feedback loop, the zero-phase lens position is extrapolated from
+ * the phases measured at the two most recent settled lens positions, and
+ * the lens moves there directly. Each move waits for the lens to settle
+ * before using the phase again, so lock takes a few moves instead of the
+ * full sequence of damped feedback iterations.
  */
 
 namespace RPiController {
@@ -89,6 +96,7 @@ private:
 		uint32_t pdafFrames;		/* number of iterations when triggered */
 		uint32_t dropoutFrames;		/* number of non-PDAF frames to switch to CDAF */
 		uint32_t stepFrames;		/* frames to skip in between steps of a scan */
+		uint32_t settleFrames;		/* lens settle frames for PDAF jumps, 0 disables */
 
 		SpeedDependentParams();
 		void read(const libcamera::YamlObject &params);
@@ -130,6 +138,7 @@ private:
 	bool getPhase(PdafRegions const &regions, double &phase, double &conf);
 	double getContrast(const FocusRegions &focusStats);
 	void doPDAF(double phase, double conf);
+	void doPDAFJump(double phase, double conf);
 	bool earlyTerminationByPhase(double phase);
 	double findPeak(unsigned index) const;
 	void doScan(double contrast, double phase, double conf);
@@ -156,7 +165,7 @@ private:
 	bool initted_;
 	double ftarget_, fsmooth_;
 	double prevContrast_;
-	unsigned skipCount_, stepCount_, dropCount_;
+	unsigned skipCount_, stepCount_, dropCount_, settleCount_;
 	unsigned scanMaxIndex_;
 	double scanMaxContrast_, scanMinContrast_;
 	std::vector<ScanRecord> scanData_;
@@ -219,18 +219,18 @@ void Agc::switchMode(CameraMode const &cameraMode,
 		LOG(RPiAgc, Debug) << "switchMode for channel " << channelIndex;
 		channelData_[channelIndex].channel.switchMode(cameraMode, metadata);
 		if (channelIndex == activeChannels_[0])
-			metadata->get("agc.status", status);
+			metadata->get(MetadataTag::Agc, status);
 	}
 
 	status.channel = activeChannels_[0];
-	metadata->set("agc.status", status);
+	metadata->set(MetadataTag::Agc, status);
 	index_ = 0;
 }
 
 static void getDelayedChannelIndex(Metadata *metadata, const char *message, unsigned int &channelIndex)
 {
 	std::unique_lock<RPiController::Metadata> lock(*metadata);
-	AgcStatus *status = metadata->getLocked<AgcStatus>("agc.delayed_status");
+	AgcStatus *status = metadata->getLocked<AgcStatus>(MetadataTag::AgcDelayed);
 	if (status)
 		channelIndex = status->channel;
 	else {
@@ -243,7 +243,7 @@ static libcamera::utils::Duration
 setCurrentChannelIndexGetExposure(Metadata *metadata, const char *message, unsigned int channelIndex)
 {
 	std::unique_lock<RPiController::Metadata> lock(*metadata);
-	AgcStatus *status = metadata->getLocked<AgcStatus>("agc.status");
+	AgcStatus *status = metadata->getLocked<AgcStatus>(MetadataTag::Agc);
 	libcamera::utils::Duration dur = 0s;
 
 	if (status) {
@@ -299,7 +299,7 @@ void Agc::process(StatisticsPtr &stats, Metadata *imageMetadata)
 	 */
 	LOG(RPiAgc, Debug) << "Save DeviceStatus and stats for channel " << statsIndex;
 	DeviceStatus deviceStatus;
-	if (imageMetadata->get<DeviceStatus>("device.status", deviceStatus) == 0)
+	if (imageMetadata->get<DeviceStatus>(MetadataTag::Device, deviceStatus) == 0)
 		channelData_[statsIndex].deviceStatus = deviceStatus;
 	else
 		/* Every frame should have a DeviceStatus. */
@@ -267,7 +267,9 @@ AgcChannel::ExposureValues::ExposureValues()
 AgcChannel::AgcChannel()
 	: meteringMode_(nullptr), exposureMode_(nullptr), constraintMode_(nullptr),
 	  frameCount_(0), lockCount_(0),
-	  lastTargetExposure_(0s), ev_(1.0), flickerPeriod_(0s),
+	  lastTargetExposure_(0s), pendingMeteringMode_(nullptr),
+	  pendingExposureMode_(nullptr), pendingConstraintMode_(nullptr),
+	  ev_(1.0), flickerPeriod_(0s),
 	  maxShutter_(0s), fixedShutter_(0s), fixedAnalogueGain_(0.0)
 {
 	/* Set AWB default values in case early frames have no updates in metadata. */
@@ -309,6 +311,9 @@ int AgcChannel::read(const libcamera::YamlObject &params,
 	exposureMode_ = &config_.exposureModes[exposureModeName_];
 	constraintModeName_ = config_.defaultConstraintMode;
 	constraintMode_ = &config_.constraintModes[constraintModeName_];
+	status_.meteringMode = meteringModeName_;
+	status_.exposureMode = exposureModeName_;
+	status_.constraintMode = constraintModeName_;
 	/* Set up the "last shutter/gain" values, in case AGC starts "disabled". */
 	status_.shutterTime = config_.defaultExposureTime;
 	status_.analogueGain = config_.defaultAnalogueGain;
@@ -345,10 +350,9 @@ std::vector<double> const &AgcChannel::getWeights() const
 	 * In case someone calls setMeteringMode and then this before the
 	 * algorithm has run and updated the meteringMode_ pointer.
 	 */
-	auto it = config_.meteringModes.find(meteringModeName_);
-	if (it == config_.meteringModes.end())
-		return meteringMode_->weights;
-	return it->second.weights;
+	if (pendingMeteringMode_)
+		return pendingMeteringMode_->weights;
+	return meteringMode_->weights;
 }
 
 void AgcChannel::setEv(double ev)
@@ -380,19 +384,44 @@ void AgcChannel::setFixedAnalogueGain(double fixedAnalogueGain)
 	status_.analogueGain = limitGain(fixedAnalogueGain);
 }
 
+/*
+ * The mode names are resolved when they are set, so that the per-frame
+ * housekeeping only has to swap pointers.
+ */
 void AgcChannel::setMeteringMode(std::string const &meteringModeName)
 {
+	auto it = config_.meteringModes.find(meteringModeName);
+	if (it == config_.meteringModes.end()) {
+		LOG(RPiAgc, Warning) << "No metering mode " << meteringModeName;
+		return;
+	}
+
 	meteringModeName_ = meteringModeName;
+	pendingMeteringMode_ = &it->second;
 }
 
 void AgcChannel::setExposureMode(std::string const &exposureModeName)
 {
+	auto it = config_.exposureModes.find(exposureModeName);
+	if (it == config_.exposureModes.end()) {
+		LOG(RPiAgc, Warning) << "No exposure profile " << exposureModeName;
+		return;
+	}
+
 	exposureModeName_ = exposureModeName;
+	pendingExposureMode_ = &it->second;
 }
 
 void AgcChannel::setConstraintMode(std::string const &constraintModeName)
 {
+	auto it = config_.constraintModes.find(constraintModeName);
+	if (it == config_.constraintModes.end()) {
+		LOG(RPiAgc, Warning) << "No constraint list " << constraintModeName;
+		return;
+	}
+
 	constraintModeName_ = constraintModeName;
+	pendingConstraintMode_ = &it->second;
 }
 
 void AgcChannel::switchMode(CameraMode const &cameraMode,
@@ -470,7 +499,7 @@ void AgcChannel::prepare(Metadata *imageMetadata)
 	/* Fetch the AWB status now because AWB also sets it in the prepare method. */
 	fetchAwbStatus(imageMetadata);
 
-	if (!imageMetadata->get("agc.delayed_status", delayedStatus))
+	if (!imageMetadata->get(MetadataTag::AgcDelayed, delayedStatus))
 		totalExposureValue = delayedStatus.totalExposureValue;
 
 	prepareStatus.digitalGain = 1.0;
@@ -479,7 +508,7 @@ void AgcChannel::prepare(Metadata *imageMetadata)
 	if (status_.totalExposureValue) {
 		/* Process has run, so we have meaningful values. */
 		DeviceStatus deviceStatus;
-		if (imageMetadata->get("device.status", deviceStatus) == 0) {
+		if (imageMetadata->get(MetadataTag::Device, deviceStatus) == 0) {
 			Duration actualExposure = deviceStatus.shutterSpeed *
 						  deviceStatus.analogueGain;
 			if (actualExposure) {
@@ -499,7 +528,7 @@ void AgcChannel::prepare(Metadata *imageMetadata)
 			}
 		} else
 			LOG(RPiAgc, Warning) << "AgcChannel: no device metadata";
-		imageMetadata->set("agc.prepare_status", prepareStatus);
+		imageMetadata->set(MetadataTag::AgcPrepare, prepareStatus);
 	}
 }
 
@@ -595,35 +624,20 @@ void AgcChannel::housekeepConfig()
 	 * Make sure the "mode" pointers point to the up-to-date things, if
 	 * they've changed.
 	 */
-	if (meteringModeName_ != status_.meteringMode) {
-		auto it = config_.meteringModes.find(meteringModeName_);
-		if (it == config_.meteringModes.end()) {
-			LOG(RPiAgc, Warning) << "No metering mode " << meteringModeName_;
-			meteringModeName_ = status_.meteringMode;
-		} else {
-			meteringMode_ = &it->second;
-			status_.meteringMode = meteringModeName_;
-		}
+	if (pendingMeteringMode_) {
+		meteringMode_ = pendingMeteringMode_;
+		pendingMeteringMode_ = nullptr;
+		status_.meteringMode = meteringModeName_;
 	}
-	if (exposureModeName_ != status_.exposureMode) {
-		auto it = config_.exposureModes.find(exposureModeName_);
-		if (it == config_.exposureModes.end()) {
-			LOG(RPiAgc, Warning) << "No exposure profile " << exposureModeName_;
-			exposureModeName_ = status_.exposureMode;
-		} else {
-			exposureMode_ = &it->second;
-			status_.exposureMode = exposureModeName_;
-		}
+	if (pendingExposureMode_) {
+		exposureMode_ = pendingExposureMode_;
+		pendingExposureMode_ = nullptr;
+		status_.exposureMode = exposureModeName_;
 	}
-	if (constraintModeName_ != status_.constraintMode) {
-		auto it = config_.constraintModes.find(constraintModeName_);
-		if (it == config_.constraintModes.end()) {
-			LOG(RPiAgc, Warning) << "No constraint list " << constraintModeName_;
-			constraintModeName_ = status_.constraintMode;
-		} else {
-			constraintMode_ = &it->second;
-			status_.constraintMode = constraintModeName_;
-		}
+	if (pendingConstraintMode_) {
+		constraintMode_ = pendingConstraintMode_;
+		pendingConstraintMode_ = nullptr;
+		status_.constraintMode = constraintModeName_;
 	}
 	LOG(RPiAgc, Debug) << "exposureMode "
 			   << exposureModeName_ << " constraintMode "
@@ -641,7 +655,7 @@ void AgcChannel::fetchCurrentExposure(DeviceStatus const &deviceStatus)
 
 void AgcChannel::fetchAwbStatus(Metadata *imageMetadata)
 {
-	if (imageMetadata->get("awb.status", awb_) != 0)
+	if (imageMetadata->get(MetadataTag::Awb, awb_) != 0)
 		LOG(RPiAgc, Debug) << "No AWB status found";
 }
 
@@ -726,7 +740,7 @@ void AgcChannel::computeGain(StatisticsPtr &statistics, Metadata *imageMetadata,
 {
 	struct LuxStatus lux = {};
 	lux.lux = 400; /* default lux level to 400 in case no metadata found */
-	if (imageMetadata->get("lux.status", lux) != 0)
+	if (imageMetadata->get(MetadataTag::Lux, lux) != 0)
 		LOG(RPiAgc, Warning) << "No lux level found";
 	const Histogram &h = statistics->yHist;
 	double evGain = status_.ev * config_.baseEv;
@@ -984,7 +998,7 @@ void AgcChannel::writeAndFinish(Metadata *imageMetadata, bool desaturate)
 	 * Write to metadata as well, in case anyone wants to update the camera
 	 * immediately.
 	 */
-	imageMetadata->set("agc.status", status_);
+	imageMetadata->set(MetadataTag::Agc, status_);
 	LOG(RPiAgc, Debug) << "Output written, total exposure requested is "
 			   << filtered_.totalExposure;
 	LOG(RPiAgc, Debug) << "Camera exposure update: shutter time " << filtered_.shutter
@@ -144,6 +144,10 @@ private:
 	std::string meteringModeName_;
 	std::string exposureModeName_;
 	std::string constraintModeName_;
+	/* The modes resolved from the names above, applied on the next frame. */
+	AgcMeteringMode *pendingMeteringMode_;
+	AgcExposureMode *pendingExposureMode_;
+	AgcConstraintMode *pendingConstraintMode_;
 	double ev_;
 	libcamera::utils::Duration flickerPeriod_;
 	libcamera::utils::Duration maxShutter_;
@@ -12,6 +12,7 @@
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/span.h>
+#include <libcamera/base/thread_pool.h>
 
 #include "../awb_status.h"
 #include "alsc.h"
@@ -30,18 +31,12 @@ static const double InsufficientData = -1.0;
 Alsc::Alsc(Controller *controller)
 	: Algorithm(controller)
 {
-	asyncAbort_ = asyncStart_ = asyncStarted_ = asyncFinished_ = false;
-	asyncThread_ = std::thread(std::bind(&Alsc::asyncFunc, this));
+	asyncStarted_ = asyncFinished_ = false;
 }
 
 Alsc::~Alsc()
 {
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		asyncAbort_ = true;
-	}
-	asyncSignal_.notify_one();
-	asyncThread_.join();
+	waitForAysncThread();
 }
 
 char const *Alsc::name() const
@@ -88,13 +83,11 @@ static int readLut(Array2D<double> &lut, const libcamera::YamlObject &params)
 		return -EINVAL;
 	}
 
-	int num = 0;
-	for (const auto &p : params.asList()) {
-		auto value = p.get<double>();
-		if (!value)
-			return -EINVAL;
-		lut[num++] = *value;
-	}
+	auto values = params.getDoubleList();
+	if (!values)
+		return -EINVAL;
+
+	std::copy(values->begin(), values->end(), lut.begin());
 
 	return 0;
 }
@@ -126,14 +119,13 @@ static int readCalibrations(std::vector<AlscCalibration> &calibrations,
 				return -EINVAL;
 			}
 
-			int num = 0;
+			auto values = table.getDoubleList();
+			if (!values)
+				return -EINVAL;
+
 			calibration.table.resize(size);
-			for (const auto &elem : table.asList()) {
-				value = elem.get<double>();
-				if (!value)
-					return -EINVAL;
-				calibration.table[num++] = *value;
-			}
+			std::copy(values->begin(), values->end(),
+				  calibration.table.begin());
 
 			calibrations.push_back(std::move(calibration));
 			LOG(RPiAlsc, Debug)
@@ -194,7 +186,7 @@ static void getCalTable(double ct, std::vector<AlscCalibration> const &calibrati
 static void resampleCalTable(const Array2D<double> &calTableIn, CameraMode const &cameraMode,
 			     Array2D<double> &calTableOut);
 static void compensateLambdasForCal(const Array2D<double> &calTable,
-				    const Array2D<double> &oldLambdas,
+				    const Array2D<float> &oldLambdas,
 				    Array2D<double> &newLambdas);
 static void addLuminanceToTables(std::array<Array2D<double>, 3> &results,
 				 const Array2D<double> &lambdaR, double lambdaG,
@@ -229,6 +221,7 @@ void Alsc::initialise()
 		c.resize(config_.tableSize);
 	for (auto &m : tmpM_)
 		m.resize(XY);
+	tmpLambda_.resize(config_.tableSize);
 }
 
 void Alsc::waitForAysncThread()
@@ -328,7 +321,7 @@ double getCt(Metadata *metadata, double defaultCt)
 {
 	AwbStatus awbStatus;
 	awbStatus.temperatureK = defaultCt; /* in case nothing found */
-	if (metadata->get("awb.status", awbStatus) != 0)
+	if (metadata->get(MetadataTag::Awb, awbStatus) != 0)
 		LOG(RPiAlsc, Debug) << "no AWB results found, using "
 				    << awbStatus.temperatureK;
 	else
@@ -373,11 +366,7 @@ void Alsc::restartAsync(StatisticsPtr &stats, Metadata *imageMetadata)
 	copyStats(statistics_, stats, prevSyncResults_);
 	framePhase_ = 0;
 	asyncStarted_ = true;
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		asyncStart_ = true;
-	}
-	asyncSignal_.notify_one();
+	ThreadPool::instance()->submit([this]() { asyncFunc(); });
 }
 
 void Alsc::prepare(Metadata *imageMetadata)
@@ -408,12 +397,12 @@ void Alsc::prepare(Metadata *imageMetadata)
 	status.r = prevSyncResults_[0].data();
 	status.g = prevSyncResults_[1].data();
 	status.b = prevSyncResults_[2].data();
-	imageMetadata->set("alsc.status", status);
+	imageMetadata->set(MetadataTag::Alsc, status);
 	/*
 	 * Put the results in the global metadata as well. This will be used by
 	 * AWB to factor in the colour shading correction.
 	 */
-	getGlobalMetadata().set("alsc.status", status);
+	getGlobalMetadata().set(MetadataTag::Alsc, status);
 }
 
 void Alsc::process(StatisticsPtr &stats, Metadata *imageMetadata)
@@ -436,23 +425,15 @@ void Alsc::process(StatisticsPtr &stats, Metadata *imageMetadata)
 
 void Alsc::asyncFunc()
 {
-	while (true) {
-		{
-			std::unique_lock<std::mutex> lock(mutex_);
-			asyncSignal_.wait(lock, [&] {
-				return asyncStart_ || asyncAbort_;
-			});
-			asyncStart_ = false;
-			if (asyncAbort_)
-				break;
-		}
-		doAlsc();
-		{
-			std::lock_guard<std::mutex> lock(mutex_);
-			asyncFinished_ = true;
-		}
-		syncSignal_.notify_one();
-	}
+	doAlsc();
+
+	/*
+	 * Notify the synchronous thread with the mutex held, as the algorithm
+	 * may be destroyed as soon as the mutex is released.
+	 */
+	std::lock_guard<std::mutex> lock(mutex_);
+	asyncFinished_ = true;
+	syncSignal_.notify_one();
 }
 
 void getCalTable(double ct, std::vector<AlscCalibration> const &calibrations,
@@ -568,7 +549,7 @@ static void applyCalTable(const Array2D<double> &calTable, Array2D<double> &C)
 }
 
 void compensateLambdasForCal(const Array2D<double> &calTable,
-			     const Array2D<double> &oldLambdas,
+			     const Array2D<float> &oldLambdas,
 			     Array2D<double> &newLambdas)
 {
 	double minNewLambda = std::numeric_limits<double>::max();
@@ -609,7 +590,7 @@ static double computeWeight(double Ci, double Cj, double sigma)
 
 /* Compute all weights. */
 static void computeW(const Array2D<double> &C, double sigma,
-		     SparseArray<double> &W)
+		     SparseArray<float> &W)
 {
 	size_t XY = C.size();
 	size_t X = C.dimensions().width;
@@ -625,8 +606,8 @@ static void computeW(const Array2D<double> &C, double sigma,
 
 /* Compute M, the large but sparse matrix such that M * lambdas = 0. */
 static void constructM(const Array2D<double> &C,
-		       const SparseArray<double> &W,
-		       SparseArray<double> &M)
+		       const SparseArray<float> &W,
+		       SparseArray<float> &M)
 {
 	size_t XY = C.size();
 	size_t X = C.dimensions().width;
@@ -653,43 +634,44 @@ static void constructM(const Array2D<double> &C,
  * left/right neighbours are zero down the left/right edges, so we don't need
  * need to test the i value to exclude them.
  */
-static double computeLambdaBottom(int i, const SparseArray<double> &M,
-				  Array2D<double> &lambda)
+static float computeLambdaBottom(int i, const SparseArray<float> &M,
+				 const Array2D<float> &lambda)
 {
 	return M[i][1] * lambda[i + 1] + M[i][2] * lambda[i + lambda.dimensions().width] +
 	       M[i][3] * lambda[i - 1];
 }
-static double computeLambdaBottomStart(int i, const SparseArray<double> &M,
-				       Array2D<double> &lambda)
+static float computeLambdaBottomStart(int i, const SparseArray<float> &M,
+				      const Array2D<float> &lambda)
 {
 	return M[i][1] * lambda[i + 1] + M[i][2] * lambda[i + lambda.dimensions().width];
 }
-static double computeLambdaInterior(int i, const SparseArray<double> &M,
-				    Array2D<double> &lambda)
+static float computeLambdaInterior(int i, const SparseArray<float> &M,
+				   const Array2D<float> &lambda)
 {
 	return M[i][0] * lambda[i - lambda.dimensions().width] + M[i][1] * lambda[i + 1] +
 	       M[i][2] * lambda[i + lambda.dimensions().width] + M[i][3] * lambda[i - 1];
 }
-static double computeLambdaTop(int i, const SparseArray<double> &M,
-			       Array2D<double> &lambda)
+static float computeLambdaTop(int i, const SparseArray<float> &M,
+			      const Array2D<float> &lambda)
 {
 	return M[i][0] * lambda[i - lambda.dimensions().width] + M[i][1] * lambda[i + 1] +
 	       M[i][3] * lambda[i - 1];
 }
-static double computeLambdaTopEnd(int i, const SparseArray<double> &M,
-				  Array2D<double> &lambda)
+static float computeLambdaTopEnd(int i, const SparseArray<float> &M,
+				 const Array2D<float> &lambda)
 {
 	return M[i][0] * lambda[i - lambda.dimensions().width] + M[i][3] * lambda[i - 1];
 }
 
 /* Gauss-Seidel iteration with over-relaxation. */
-static double gaussSeidel2Sor(const SparseArray<double> &M, double omega,
-			      Array2D<double> &lambda, double lambdaBound)
+static float gaussSeidel2Sor(const SparseArray<float> &M, float omega,
+			     Array2D<float> &lambda, Array2D<float> &oldLambda,
+			     float lambdaBound)
 {
 	int XY = lambda.size();
 	int X = lambda.dimensions().width;
-	const double min = 1 - lambdaBound, max = 1 + lambdaBound;
-	Array2D<double> oldLambda = lambda;
+	const float min = 1 - lambdaBound, max = 1 + lambdaBound;
+	std::copy(lambda.begin(), lambda.end(), oldLambda.begin());
 	int i;
 	lambda[0] = computeLambdaBottomStart(0, M, lambda);
 	lambda[0] = std::clamp(lambda[0], min, max);
@@ -727,11 +709,18 @@ static double gaussSeidel2Sor(const SparseArray<double> &M, double omega,
 	}
 	lambda[0] = computeLambdaBottomStart(0, M, lambda);
 	lambda[0] = std::clamp(lambda[0], min, max);
-	double maxDiff = 0;
+	/*
+	 * Apply the over-relaxation and compute the largest absolute update.
+	 * The loop has no dependency between iterations and is vectorised by
+	 * the compiler.
+	 */
+	float *l = lambda.ptr();
+	const float *o = oldLambda.ptr();
+	float maxDiff = 0;
 	for (i = 0; i < XY; i++) {
-		lambda[i] = oldLambda[i] + (lambda[i] - oldLambda[i]) * omega;
-		if (fabs(lambda[i] - oldLambda[i]) > fabs(maxDiff))
-			maxDiff = lambda[i] - oldLambda[i];
+		float diff = (l[i] - o[i]) * omega;
+		l[i] = o[i] + diff;
+		maxDiff = std::max(maxDiff, std::abs(diff));
 	}
 	return maxDiff;
 }
@@ -745,24 +734,25 @@ static void normalise(Array2D<double> &results)
 }
 
 /* Rescale the values so that the average value is 1. */
-static void reaverage(Array2D<double> &data)
+static void reaverage(Array2D<float> &data)
 {
-	double sum = std::accumulate(data.begin(), data.end(), 0.0);
-	double ratio = 1 / (sum / data.size());
+	float sum = std::accumulate(data.begin(), data.end(), 0.0f);
+	float ratio = 1 / (sum / data.size());
 	std::for_each(data.begin(), data.end(),
-		      [ratio](double val) { return val * ratio; });
+		      [ratio](float val) { return val * ratio; });
 }
 
 static void runMatrixIterations(const Array2D<double> &C,
-				Array2D<double> &lambda,
-				const SparseArray<double> &W,
-				SparseArray<double> &M, double omega,
-				unsigned int nIter, double threshold, double lambdaBound)
+				Array2D<float> &lambda,
+				Array2D<float> &oldLambda,
+				const SparseArray<float> &W,
+				SparseArray<float> &M, float omega,
+				unsigned int nIter, float threshold, float lambdaBound)
 {
 	constructM(C, W, M);
-	double lastMaxDiff = std::numeric_limits<double>::max();
+	float lastMaxDiff = std::numeric_limits<float>::max();
 	for (unsigned int i = 0; i < nIter; i++) {
-		double maxDiff = fabs(gaussSeidel2Sor(M, omega, lambda, lambdaBound));
+		float maxDiff = gaussSeidel2Sor(M, omega, lambda, oldLambda, lambdaBound);
 		if (maxDiff < threshold) {
 			LOG(RPiAlsc, Debug)
 				<< "Stop after " << i + 1 << " iterations";
@@ -815,7 +805,7 @@ void Alsc::doAlsc()
 {
 	Array2D<double> &cr = tmpC_[0], &cb = tmpC_[1], &calTableR = tmpC_[2],
 			&calTableB = tmpC_[3], &calTableTmp = tmpC_[4];
-	SparseArray<double> &wr = tmpM_[0], &wb = tmpM_[1], &M = tmpM_[2];
+	SparseArray<float> &wr = tmpM_[0], &wb = tmpM_[1], &M = tmpM_[2];
 
 	/*
 	 * Calculate our R/B ("Cr"/"Cb") colour statistics, and assess which are
@@ -842,10 +832,10 @@ void Alsc::doAlsc()
 	computeW(cr, config_.sigmaCr, wr);
 	computeW(cb, config_.sigmaCb, wb);
 	/* Run Gauss-Seidel iterations over the resulting matrix, for R and B. */
-	runMatrixIterations(cr, lambdaR_, wr, M, config_.omega, config_.nIter,
-			    config_.threshold, config_.lambdaBound);
-	runMatrixIterations(cb, lambdaB_, wb, M, config_.omega, config_.nIter,
-			    config_.threshold, config_.lambdaBound);
+	runMatrixIterations(cr, lambdaR_, tmpLambda_, wr, M, config_.omega,
+			    config_.nIter, config_.threshold, config_.lambdaBound);
+	runMatrixIterations(cb, lambdaB_, tmpLambda_, wb, M, config_.omega,
+			    config_.nIter, config_.threshold, config_.lambdaBound);
 	/*
 	 * Fold the calibrated gains into our final lambda values. (Note that on
 	 * the next run, we re-start with the lambda values that don't have the
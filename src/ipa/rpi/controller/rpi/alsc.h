@@ -9,7 +9,6 @@
 #include <array>
 #include <mutex>
 #include <condition_variable>
-#include <thread>
 #include <vector>
 
 #include <libcamera/geometry.h>
@@ -122,19 +121,12 @@ private:
 	bool firstTime_;
 	CameraMode cameraMode_;
 	Array2D<double> luminanceTable_;
-	std::thread asyncThread_;
-	void asyncFunc(); /* asynchronous thread function */
+	void asyncFunc(); /* asynchronous task function, run by the thread pool */
 	std::mutex mutex_;
-	/* condvar for async thread to wait on */
-	std::condition_variable asyncSignal_;
 	/* condvar for synchronous thread to wait on */
 	std::condition_variable syncSignal_;
 	/* for sync thread to check  if async thread finished (requires mutex) */
 	bool asyncFinished_;
-	/* for async thread to check if it's been told to run (requires mutex) */
-	bool asyncStart_;
-	/* for async thread to check if it's been told to quit (requires mutex) */
-	bool asyncAbort_;
 
 	/*
 	 * The following are only for the synchronous thread to use:
@@ -163,12 +155,17 @@ private:
 	Array2D<double> asyncLambdaR_;
 	Array2D<double> asyncLambdaB_;
 	void doAlsc();
-	Array2D<double> lambdaR_;
-	Array2D<double> lambdaB_;
+	/*
+	 * The solver runs in single precision, which is plenty for lambdas
+	 * bounded close to 1 and halves the memory traffic of the iterations.
+	 */
+	Array2D<float> lambdaR_;
+	Array2D<float> lambdaB_;
 
 	/* Temporaries for the computations */
 	std::array<Array2D<double>, 5> tmpC_;
-	std::array<SparseArray<double>, 3> tmpM_;
+	std::array<SparseArray<float>, 3> tmpM_;
+	Array2D<float> tmpLambda_;
 };
 
 } /* namespace RPiController */
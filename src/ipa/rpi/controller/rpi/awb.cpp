@@ -6,9 +6,14 @@
  */
 
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <memory>
+#include <mutex>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/thread_pool.h>
 
 #include "../lux_status.h"
 
@@ -172,20 +177,20 @@ int AwbConfig::read(const libcamera::YamlObject &params)
 Awb::Awb(Controller *controller)
 	: AwbAlgorithm(controller)
 {
-	asyncAbort_ = asyncStart_ = asyncStarted_ = asyncFinished_ = false;
+	asyncStarted_ = asyncFinished_ = false;
 	mode_ = nullptr;
 	manualR_ = manualB_ = 0.0;
-	asyncThread_ = std::thread(std::bind(&Awb::asyncFunc, this));
 }
 
 Awb::~Awb()
 {
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		asyncAbort_ = true;
+	/* Wait for a calculation in progress to complete. */
+	if (asyncStarted_) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		syncSignal_.wait(lock, [&] {
+			return asyncFinished_;
+		});
 	}
-	asyncSignal_.notify_one();
-	asyncThread_.join();
 }
 
 char const *Awb::name() const
@@ -285,7 +290,7 @@ void Awb::switchMode([[maybe_unused]] CameraMode const &cameraMode,
 		     Metadata *metadata)
 {
 	/* Let other algorithms know the current white balance values. */
-	metadata->set("awb.status", prevSyncResults_);
+	metadata->set(MetadataTag::Awb, prevSyncResults_);
 }
 
 bool Awb::isAutoEnabled() const
@@ -322,11 +327,7 @@ void Awb::restartAsync(StatisticsPtr &stats, double lux)
 	size_t len = modeName_.copy(asyncResults_.mode,
 				    sizeof(asyncResults_.mode) - 1);
 	asyncResults_.mode[len] = '\0';
-	{
-		std::lock_guard<std::mutex> lock(mutex_);
-		asyncStart_ = true;
-	}
-	asyncSignal_.notify_one();
+	ThreadPool::instance()->submit([this]() { asyncFunc(); });
 }
 
 void Awb::prepare(Metadata *imageMetadata)
@@ -354,7 +355,7 @@ void Awb::prepare(Metadata *imageMetadata)
 				 (1.0 - speed) * prevSyncResults_.gainG;
 	prevSyncResults_.gainB = speed * syncResults_.gainB +
 				 (1.0 - speed) * prevSyncResults_.gainB;
-	imageMetadata->set("awb.status", prevSyncResults_);
+	imageMetadata->set(MetadataTag::Awb, prevSyncResults_);
 	LOG(RPiAwb, Debug)
 		<< "Using AWB gains r " << prevSyncResults_.gainR << " g "
 		<< prevSyncResults_.gainG << " b "
@@ -374,7 +375,7 @@ void Awb::process(StatisticsPtr &stats, Metadata *imageMetadata)
 		/* Update any settings and any image metadata that we need. */
 		struct LuxStatus luxStatus = {};
 		luxStatus.lux = 400; /* in case no metadata */
-		if (imageMetadata->get("lux.status", luxStatus) != 0)
+		if (imageMetadata->get(MetadataTag::Lux, luxStatus) != 0)
 			LOG(RPiAwb, Debug) << "No lux metadata found";
 		LOG(RPiAwb, Debug) << "Awb lux value is " << luxStatus.lux;
 
@@ -385,23 +386,15 @@ void Awb::process(StatisticsPtr &stats, Metadata *imageMetadata)
 
 void Awb::asyncFunc()
 {
-	while (true) {
-		{
-			std::unique_lock<std::mutex> lock(mutex_);
-			asyncSignal_.wait(lock, [&] {
-				return asyncStart_ || asyncAbort_;
-			});
-			asyncStart_ = false;
-			if (asyncAbort_)
-				break;
-		}
-		doAwb();
-		{
-			std::lock_guard<std::mutex> lock(mutex_);
-			asyncFinished_ = true;
-		}
-		syncSignal_.notify_one();
-	}
+	doAwb();
+
+	/*
+	 * Notify the synchronous thread with the mutex held, as the algorithm
+	 * may be destroyed as soon as the mutex is released.
+	 */
+	std::lock_guard<std::mutex> lock(mutex_);
+	asyncFinished_ = true;
+	syncSignal_.notify_one();
 }
 
 static void generateStats(std::vector<Awb::RGB> &zones,
@@ -420,7 +413,7 @@ static void generateStats(std::vector<Awb::RGB> &zones,
 			zone.R = region.val.rSum / region.counted;
 			zone.B = region.val.bSum / region.counted;
 			/* Factor in the ALSC applied colour shading correction if required. */
-			const AlscStatus *alscStatus = globalMetadata.getLocked<AlscStatus>("alsc.status");
+			const AlscStatus *alscStatus = globalMetadata.getLocked<AlscStatus>(MetadataTag::Alsc);
 			if (stats->colourStatsPos == Statistics::ColourStatsPos::PreLsc && alscStatus) {
 				zone.R *= alscStatus->r[i];
 				zone.G *= alscStatus->g[i];
@@ -450,22 +443,92 @@ void Awb::prepareStats()
 	}
 }
 
-double Awb::computeDelta2Sum(double gainR, double gainB)
+/*
+ * Run fn(i) for all i in [0, count) on the shared thread pool. Items are
+ * claimed one at a time by the calling thread and the pool workers, and the
+ * calling thread takes part in the work. This makes the function safe to call
+ * from a pool worker: if no other worker is available, the calling thread
+ * processes all items itself. Workers that start after all items have been
+ * claimed only touch the shared state, which outlives the function.
+ */
+template<typename Func>
+static void parallelFor(unsigned int count, Func fn)
+{
+	struct State {
+		std::atomic<unsigned int> next = 0;
+		unsigned int done = 0;
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::function<void(unsigned int)> fn;
+	};
+
+	ThreadPool *pool = ThreadPool::instance();
+	unsigned int helpers = count > 1 ? std::min(pool->workers(), count - 1) : 0;
+	if (!helpers) {
+		for (unsigned int i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	auto state = std::make_shared<State>();
+	state->fn = fn;
+
+	auto work = [state, count]() {
+		unsigned int processed = 0;
+		unsigned int i;
+		while ((i = state->next++) < count) {
+			state->fn(i);
+			processed++;
+		}
+
+		if (!processed)
+			return;
+
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->done += processed;
+		if (state->done == count)
+			state->cv.notify_one();
+	};
+
+	for (unsigned int i = 0; i < helpers; i++)
+		pool->submit(work, ThreadPool::Priority::High);
+
+	work();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cv.wait(lock, [&] { return state->done == count; });
+}
+
+double Awb::computeDelta2Sum(double gainR, double gainB) const
 {
 	/*
 	 * Compute the sum of the squared colour error (non-greyness) as it
-	 * appears in the log likelihood equation.
+	 * appears in the log likelihood equation. The zones are processed in
+	 * groups of four with independent partial sums, which lets the
+	 * compiler vectorise the loop.
 	 */
-	double delta2Sum = 0;
-	for (auto &z : zones_) {
-		double deltaR = gainR * z.R - 1 - config_.whitepointR;
-		double deltaB = gainB * z.B - 1 - config_.whitepointB;
-		double delta2 = deltaR * deltaR + deltaB * deltaB;
-		/* LOG(RPiAwb, Debug) << "deltaR " << deltaR << " deltaB " << deltaB << " delta2 " << delta2; */
-		delta2 = std::min(delta2, config_.deltaLimit);
-		delta2Sum += delta2;
+	const double *zoneR = zoneR_.data();
+	const double *zoneB = zoneB_.data();
+	const size_t numZones = zoneR_.size();
+	double sums[4] = {};
+	size_t i = 0;
+
+	auto delta2 = [&](size_t z) {
+		double deltaR = gainR * zoneR[z] - 1 - config_.whitepointR;
+		double deltaB = gainB * zoneB[z] - 1 - config_.whitepointB;
+		return std::min(deltaR * deltaR + deltaB * deltaB,
+				config_.deltaLimit);
+	};
+
+	for (; i + 4 <= numZones; i += 4) {
+		for (unsigned int j = 0; j < 4; j++)
+			sums[j] += delta2(i + j);
 	}
-	return delta2Sum;
+
+	for (; i < numZones; i++)
+		sums[0] += delta2(i);
+
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
 }
 
 ipa::Pwl Awb::interpolatePrior()
@@ -516,30 +579,35 @@ static double interpolateQuadatric(ipa::Pwl::Point const &a, ipa::Pwl::Point con
 double Awb::coarseSearch(ipa::Pwl const &prior)
 {
 	points_.clear(); /* assume doesn't deallocate memory */
-	size_t bestPoint = 0;
 	double t = mode_->ctLo;
-	int spanR = 0, spanB = 0;
-	/* Step down the CT curve evaluating log likelihood. */
+	/* Step down the CT curve to list the points to evaluate. */
 	while (true) {
-		double r = config_.ctR.eval(t, &spanR);
-		double b = config_.ctB.eval(t, &spanB);
-		double gainR = 1 / r, gainB = 1 / b;
-		double delta2Sum = computeDelta2Sum(gainR, gainB);
-		double priorLogLikelihood = prior.eval(prior.domain().clamp(t));
-		double finalLogLikelihood = delta2Sum - priorLogLikelihood;
-		LOG(RPiAwb, Debug)
-			<< "t: " << t << " gain R " << gainR << " gain B "
-			<< gainB << " delta2_sum " << delta2Sum
-			<< " prior " << priorLogLikelihood << " final "
-			<< finalLogLikelihood;
-		points_.push_back(ipa::Pwl::Point({ t, finalLogLikelihood }));
-		if (points_.back().y() < points_[bestPoint].y())
-			bestPoint = points_.size() - 1;
+		points_.push_back(ipa::Pwl::Point({ t, 0 }));
 		if (t == mode_->ctHi)
 			break;
 		/* for even steps along the r/b curve scale them by the current t */
 		t = std::min(t + t / 10 * config_.coarseStep, mode_->ctHi);
 	}
+
+	/* Evaluate the log likelihood of all points in parallel. */
+	parallelFor(points_.size(), [&](unsigned int i) {
+		double ct = points_[i].x();
+		double r = config_.ctR.eval(ct);
+		double b = config_.ctB.eval(ct);
+		double gainR = 1 / r, gainB = 1 / b;
+		double delta2Sum = computeDelta2Sum(gainR, gainB);
+		double priorLogLikelihood = prior.eval(prior.domain().clamp(ct));
+		points_[i][1] = delta2Sum - priorLogLikelihood;
+	});
+
+	size_t bestPoint = 0;
+	for (size_t i = 0; i < points_.size(); i++) {
+		LOG(RPiAwb, Debug)
+			<< "t: " << points_[i].x() << " final "
+			<< points_[i].y();
+		if (points_[i].y() < points_[bestPoint].y())
+			bestPoint = i;
+	}
 	t = points_[bestPoint].x();
 	LOG(RPiAwb, Debug) << "Coarse search found CT " << t;
 	/*
@@ -586,15 +654,23 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 	numDeltas = numDeltas < 3 ? 3 : (numDeltas > maxNumDeltas ? maxNumDeltas : numDeltas);
 	/*
 	 * Step down CT curve. March a bit further if the transverse range is
-	 * large.
+	 * large. The points along the curve are evaluated in parallel.
 	 */
 	nsteps += numDeltas;
-	for (int i = -nsteps; i <= nsteps; i++) {
+
+	struct Candidate {
+		double t, r, b;
+		double logLikelihood;
+	};
+	std::vector<Candidate> candidates(2 * nsteps + 1);
+
+	parallelFor(candidates.size(), [&](unsigned int idx) {
+		int i = static_cast<int>(idx) - nsteps;
 		double tTest = t + i * step;
 		double priorLogLikelihood =
 			prior.eval(prior.domain().clamp(tTest));
-		double rCurve = config_.ctR.eval(tTest, &spanR);
-		double bCurve = config_.ctB.eval(tTest, &spanB);
+		double rCurve = config_.ctR.eval(tTest);
+		double bCurve = config_.ctB.eval(tTest);
 		/* x will be distance off the curve, y the log likelihood there */
 		ipa::Pwl::Point points[maxNumDeltas];
 		int bestPoint = 0;
@@ -608,9 +684,6 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 			double gainR = 1 / rTest, gainB = 1 / bTest;
 			double delta2Sum = computeDelta2Sum(gainR, gainB);
 			points[j][1] = delta2Sum - priorLogLikelihood;
-			LOG(RPiAwb, Debug)
-				<< "At t " << tTest << " r " << rTest << " b "
-				<< bTest << ": " << points[j].y();
 			if (points[j].y() < points[bestPoint].y())
 				bestPoint = j;
 		}
@@ -626,15 +699,19 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 		double rTest = rbTest.x(), bTest = rbTest.y();
 		double gainR = 1 / rTest, gainB = 1 / bTest;
 		double delta2Sum = computeDelta2Sum(gainR, gainB);
-		double finalLogLikelihood = delta2Sum - priorLogLikelihood;
+		candidates[idx] = { tTest, rTest, bTest, delta2Sum - priorLogLikelihood };
+	});
+
+	/* Pick the best candidate, in the same order as a sequential search. */
+	for (const Candidate &candidate : candidates) {
 		LOG(RPiAwb, Debug)
 			<< "Finally "
-			<< tTest << " r " << rTest << " b " << bTest << ": "
-			<< finalLogLikelihood
-			<< (finalLogLikelihood < bestLogLikelihood ? " BEST" : "");
-		if (bestT == 0 || finalLogLikelihood < bestLogLikelihood)
-			bestLogLikelihood = finalLogLikelihood,
-			bestT = tTest, bestR = rTest, bestB = bTest;
+			<< candidate.t << " r " << candidate.r << " b " << candidate.b
+			<< ": " << candidate.logLikelihood
+			<< (candidate.logLikelihood < bestLogLikelihood ? " BEST" : "");
+		if (bestT == 0 || candidate.logLikelihood < bestLogLikelihood)
+			bestLogLikelihood = candidate.logLikelihood,
+			bestT = candidate.t, bestR = candidate.r, bestB = candidate.b;
 	}
 	t = bestT, r = bestR, b = bestB;
 	LOG(RPiAwb, Debug)
@@ -645,10 +722,15 @@ void Awb::awbBayes()
 {
 	/*
 	 * May as well divide out G to save computeDelta2Sum from doing it over
-	 * and over.
+	 * and over. Store the results in contiguous arrays for the search.
 	 */
-	for (auto &z : zones_)
-		z.R = z.R / (z.G + 1), z.B = z.B / (z.G + 1);
+	zoneR_.resize(zones_.size());
+	zoneB_.resize(zones_.size());
+	for (unsigned int i = 0; i < zones_.size(); i++) {
+		const RGB &z = zones_[i];
+		zoneR_[i] = z.R / (z.G + 1);
+		zoneB_[i] = z.B / (z.G + 1);
+	}
 	/*
 	 * Get the current prior, and scale according to how many zones are
 	 * valid... not entirely sure about this.
@@ -8,7 +8,6 @@
 
 #include <mutex>
 #include <condition_variable>
-#include <thread>
 
 #include <libcamera/geometry.h>
 
@@ -123,19 +122,12 @@ private:
 	bool isAutoEnabled() const;
 	/* configuration is read-only, and available to both threads */
 	AwbConfig config_;
-	std::thread asyncThread_;
-	void asyncFunc(); /* asynchronous thread function */
+	void asyncFunc(); /* asynchronous task function, run by the thread pool */
 	std::mutex mutex_;
-	/* condvar for async thread to wait on */
-	std::condition_variable asyncSignal_;
 	/* condvar for synchronous thread to wait on */
 	std::condition_variable syncSignal_;
 	/* for sync thread to check  if async thread finished (requires mutex) */
 	bool asyncFinished_;
-	/* for async thread to check if it's been told to run (requires mutex) */
-	bool asyncStart_;
-	/* for async thread to check if it's been told to quit (requires mutex) */
-	bool asyncAbort_;
 
 	/*
 	 * The following are only for the synchronous thread to use:
@@ -163,11 +155,14 @@ private:
 	void awbBayes();
 	void awbGrey();
 	void prepareStats();
-	double computeDelta2Sum(double gainR, double gainB);
+	double computeDelta2Sum(double gainR, double gainB) const;
 	libcamera::ipa::Pwl interpolatePrior();
 	double coarseSearch(libcamera::ipa::Pwl const &prior);
 	void fineSearch(double &t, double &r, double &b, libcamera::ipa::Pwl const &prior);
 	std::vector<RGB> zones_;
+	/* Zone R/G and B/G ratios, stored contiguously for the Bayesian search */
+	std::vector<double> zoneR_;
+	std::vector<double> zoneB_;
 	std::vector<libcamera::ipa::Pwl::Point> points_;
 	/* manual r setting */
 	double manualR_;
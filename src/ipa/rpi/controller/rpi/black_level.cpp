@@ -63,7 +63,7 @@ void BlackLevel::prepare(Metadata *imageMetadata)
 	status.blackLevelR = blackLevelR_;
 	status.blackLevelG = blackLevelG_;
 	status.blackLevelB = blackLevelB_;
-	imageMetadata->set("black_level.status", status);
+	imageMetadata->set(MetadataTag::BlackLevel, status);
 }
 
 /* Register algorithm with the system. */
@@ -96,7 +96,7 @@ int Cac::read(const libcamera::YamlObject &params)
 void Cac::prepare(Metadata *imageMetadata)
 {
 	if (config_.enabled)
-		imageMetadata->set("cac.status", cacStatus_);
+		imageMetadata->set(MetadataTag::Cac, cacStatus_);
 }
 
 // Register algorithm with the system.
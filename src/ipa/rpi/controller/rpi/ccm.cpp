@@ -29,35 +29,6 @@ LOG_DEFINE_CATEGORY(RPiCcm)
 
 #define NAME "rpi.ccm"
 
-Matrix::Matrix()
-{
-	memset(m, 0, sizeof(m));
-}
-Matrix::Matrix(double m0, double m1, double m2, double m3, double m4, double m5,
-	       double m6, double m7, double m8)
-{
-	m[0][0] = m0, m[0][1] = m1, m[0][2] = m2, m[1][0] = m3, m[1][1] = m4,
-	m[1][2] = m5, m[2][0] = m6, m[2][1] = m7, m[2][2] = m8;
-}
-int Matrix::read(const libcamera::YamlObject &params)
-{
-	double *ptr = (double *)m;
-
-	if (params.size() != 9) {
-		LOG(RPiCcm, Error) << "Wrong number of values in CCM";
-		return -EINVAL;
-	}
-
-	for (const auto &param : params.asList()) {
-		auto value = param.get<double>();
-		if (!value)
-			return -EINVAL;
-		*ptr++ = *value;
-	}
-
-	return 0;
-}
-
 Ccm::Ccm(Controller *controller)
 	: CcmAlgorithm(controller), saturation_(1.0) {}
 
@@ -83,7 +54,7 @@ int Ccm::read(const libcamera::YamlObject &params)
 
 		CtCcm ctCcm;
 		ctCcm.ct = *value;
-		ret = ctCcm.ccm.read(p["ccm"]);
+		ret = ctCcm.ccm.readYaml(p["ccm"]);
 		if (ret)
 			return ret;
 
@@ -114,7 +85,7 @@ void Ccm::initialise()
 }
 
 template<typename T>
-static bool getLocked(Metadata *metadata, std::string const &tag, T &value)
+static bool getLocked(Metadata *metadata, MetadataTag tag, T &value)
 {
 	T *ptr = metadata->getLocked<T>(tag);
 	if (ptr == nullptr)
@@ -123,7 +94,9 @@ static bool getLocked(Metadata *metadata, std::string const &tag, T &value)
 	return true;
 }
 
-Matrix calculateCcm(std::vector<CtCcm> const &ccms, double ct)
+using Matrix3x3 = ipa::Matrix<double, 3, 3>;
+
+Matrix3x3 calculateCcm(std::vector<CtCcm> const &ccms, double ct)
 {
 	if (ct <= ccms.front().ct)
 		return ccms.front().ccm;
@@ -135,17 +108,19 @@ Matrix calculateCcm(std::vector<CtCcm> const &ccms, double ct)
 			;
 		double lambda =
 			(ct - ccms[i - 1].ct) / (ccms[i].ct - ccms[i - 1].ct);
-		return lambda * ccms[i].ccm + (1.0 - lambda) * ccms[i - 1].ccm;
+		return ipa::lerp(ccms[i - 1].ccm, ccms[i].ccm, lambda);
 	}
 }
 
-Matrix applySaturation(Matrix const &ccm, double saturation)
+Matrix3x3 applySaturation(Matrix3x3 const &ccm, double saturation)
 {
-	Matrix RGB2Y(0.299, 0.587, 0.114, -0.169, -0.331, 0.500, 0.500, -0.419,
-		     -0.081);
-	Matrix Y2RGB(1.000, 0.000, 1.402, 1.000, -0.345, -0.714, 1.000, 1.771,
-		     0.000);
-	Matrix S(1, 0, 0, 0, saturation, 0, 0, 0, saturation);
+	static constexpr Matrix3x3 RGB2Y({ 0.299, 0.587, 0.114,
+					   -0.169, -0.331, 0.500,
+					   0.500, -0.419, -0.081 });
+	static constexpr Matrix3x3 Y2RGB({ 1.000, 0.000, 1.402,
+					   1.000, -0.345, -0.714,
+					   1.000, 1.771, 0.000 });
+	Matrix3x3 S({ 1, 0, 0, 0, saturation, 0, 0, 0, saturation });
 	return Y2RGB * S * RGB2Y * ccm;
 }
 
@@ -159,14 +134,14 @@ void Ccm::prepare(Metadata *imageMetadata)
 	{
 		/* grab mutex just once to get everything */
 		std::lock_guard<Metadata> lock(*imageMetadata);
-		awbOk = getLocked(imageMetadata, "awb.status", awb);
-		luxOk = getLocked(imageMetadata, "lux.status", lux);
+		awbOk = getLocked(imageMetadata, MetadataTag::Awb, awb);
+		luxOk = getLocked(imageMetadata, MetadataTag::Lux, lux);
 	}
 	if (!awbOk)
 		LOG(RPiCcm, Warning) << "no colour temperature found";
 	if (!luxOk)
 		LOG(RPiCcm, Warning) << "no lux value found";
-	Matrix ccm = calculateCcm(config_.ccms, awb.temperatureK);
+	Matrix3x3 ccm = calculateCcm(config_.ccms, awb.temperatureK);
 	double saturation = saturation_;
 	struct CcmStatus ccmStatus;
 	ccmStatus.saturation = saturation;
@@ -177,7 +152,7 @@ void Ccm::prepare(Metadata *imageMetadata)
 	for (int j = 0; j < 3; j++)
 		for (int i = 0; i < 3; i++)
 			ccmStatus.matrix[j * 3 + i] =
-				std::max(-8.0, std::min(7.9999, ccm.m[j][i]));
+				std::max(-8.0, std::min(7.9999, ccm[j][i]));
 	LOG(RPiCcm, Debug)
 		<< "colour temperature " << awb.temperatureK << "K";
 	LOG(RPiCcm, Debug)
@@ -187,7 +162,7 @@ void Ccm::prepare(Metadata *imageMetadata)
 		<< " " << ccmStatus.matrix[5] << "     "
 		<< ccmStatus.matrix[6] << " " << ccmStatus.matrix[7]
 		<< " " << ccmStatus.matrix[8];
-	imageMetadata->set("ccm.status", ccmStatus);
+	imageMetadata->set(MetadataTag::Ccm, ccmStatus);
 }
 
 /* Register algorithm with the system. */
@@ -4,9 +4,11 @@
  *
  * contrast (gamma) control algorithm
  */
+#include <algorithm>
 #include <stdint.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include "../contrast_status.h"
 #include "../histogram.h"
@@ -29,7 +31,8 @@ LOG_DEFINE_CATEGORY(RPiContrast)
 #define NAME "rpi.contrast"
 
 Contrast::Contrast(Controller *controller)
-	: ContrastAlgorithm(controller), brightness_(0.0), contrast_(1.0)
+	: ContrastAlgorithm(controller), brightness_(0.0), contrast_(1.0),
+	  stretchPoints_({}), gammaCurveValid_(false)
 {
 }
 
@@ -53,26 +56,36 @@ int Contrast::read(const libcamera::YamlObject &params)
 	config_.hiHistogram = params["hi_histogram"].get<double>(0.95);
 	config_.hiLevel = params["hi_level"].get<double>(0.95);
 	config_.hiMax = params["hi_max"].get<double>(2000);
+	// don't regenerate the curve until a point moves by more than this
+	config_.stretchHysteresis = params["stretch_hysteresis"].get<double>(64);
 	return config_.gammaCurve.readYaml(params["gamma_curve"]);
 }
 
 void Contrast::setBrightness(double brightness)
 {
+	if (brightness != brightness_)
+		gammaCurveValid_ = false;
 	brightness_ = brightness;
 }
 
 void Contrast::setContrast(double contrast)
 {
+	if (contrast != contrast_)
+		gammaCurveValid_ = false;
 	contrast_ = contrast;
 }
 
 void Contrast::enableCe(bool enable)
 {
+	if (enable != ceEnable_)
+		gammaCurveValid_ = false;
 	ceEnable_ = enable;
 }
 
 void Contrast::restoreCe()
 {
+	if (config_.ceEnable != ceEnable_)
+		gammaCurveValid_ = false;
 	ceEnable_ = config_.ceEnable;
 }
 
@@ -85,18 +98,23 @@ void Contrast::initialise()
 	status_.brightness = brightness_;
 	status_.contrast = contrast_;
 	status_.gammaCurve = config_.gammaCurve;
+	gammaCurveValid_ = false;
+}
+
+unsigned int Contrast::processCost() const
+{
+	/* Computing the gamma curve composes piecewise linear functions. */
+	return 4;
 }
 
 void Contrast::prepare(Metadata *imageMetadata)
 {
-	imageMetadata->set("contrast.status", status_);
+	imageMetadata->set(MetadataTag::Contrast, status_);
 }
 
-ipa::Pwl computeStretchCurve(Histogram const &histogram,
-			ContrastConfig const &config)
+std::array<double, 3> computeStretchPoints(Histogram const &histogram,
+					   ContrastConfig const &config)
 {
-	ipa::Pwl enhance;
-	enhance.append(0, 0);
 	/*
 	 * If the start of the histogram is rather empty, try to pull it down a
 	 * bit.
@@ -110,13 +128,11 @@ ipa::Pwl computeStretchCurve(Histogram const &histogram,
 			  std::min(65535.0, std::min(histLo, levelLo + config.loMax)));
 	LOG(RPiContrast, Debug)
 		<< "Final values " << histLo << " -> " << levelLo;
-	enhance.append(histLo, levelLo);
 	/*
 	 * Keep the mid-point (median) in the same place, though, to limit the
 	 * apparent amount of global brightness shift.
 	 */
 	double mid = histogram.quantile(0.5) * (65536 / histogram.bins());
-	enhance.append(mid, mid);
 
 	/*
 	 * If the top to the histogram is empty, try to pull the pixel values
@@ -131,7 +147,19 @@ ipa::Pwl computeStretchCurve(Histogram const &histogram,
 			  std::max(0.0, std::max(histHi, levelHi - config.hiMax)));
 	LOG(RPiContrast, Debug)
 		<< "Final values " << histHi << " -> " << levelHi;
-	enhance.append(histHi, levelHi);
+	return { histLo, mid, histHi };
+}
+
+ipa::Pwl computeStretchCurve(std::array<double, 3> const &points,
+			     ContrastConfig const &config)
+{
+	auto [histLo, mid, histHi] = points;
+
+	ipa::Pwl enhance;
+	enhance.append(0, 0);
+	enhance.append(histLo, config.loLevel * 65536);
+	enhance.append(mid, mid);
+	enhance.append(histHi, config.hiLevel * 65536);
 	enhance.append(65535, 65535);
 	return enhance;
 }
@@ -160,15 +188,32 @@ void Contrast::process(StatisticsPtr &stats,
 	 * ways: 1. Adjust the gamma curve so as to pull the start of the
 	 * histogram down, and possibly push the end up.
 	 */
+	bool stretch = ceEnable_ && (config_.loMax != 0 || config_.hiMax != 0);
+	std::array<double, 3> stretchPoints = {};
+	if (stretch)
+		stretchPoints = computeStretchPoints(histogram, config_);
+
+	/*
+	 * Composing the curves is costly, keep the current curve until the
+	 * stretch moves noticeably or the controls change.
+	 */
+	if (gammaCurveValid_ &&
+	    std::equal(stretchPoints.begin(), stretchPoints.end(),
+		       stretchPoints_.begin(), [&](double a, double b) {
+			       return utils::abs_diff(a, b) < config_.stretchHysteresis;
+		       }))
+		return;
+
+	stretchPoints_ = stretchPoints;
+	gammaCurveValid_ = true;
+
 	ipa::Pwl gammaCurve = config_.gammaCurve;
-	if (ceEnable_) {
-		if (config_.loMax != 0 || config_.hiMax != 0)
-			gammaCurve = computeStretchCurve(histogram, config_).compose(gammaCurve);
-		/*
-		 * We could apply other adjustments (e.g. partial equalisation)
-		 * based on the histogram...?
-		 */
-	}
+	if (stretch)
+		gammaCurve = computeStretchCurve(stretchPoints, config_).compose(gammaCurve);
+	/*
+	 * We could apply other adjustments (e.g. partial equalisation) based
+	 * on the histogram...?
+	 */
 	/*
 	 * 2. Finally apply any manually selected brightness/contrast
 	 * adjustment.
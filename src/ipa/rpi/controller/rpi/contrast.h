@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include <array>
 #include <mutex>
 
 #include <libipa/pwl.h>
@@ -27,6 +28,7 @@ struct ContrastConfig {
 	double hiHistogram;
 	double hiLevel;
 	double hiMax;
+	double stretchHysteresis;
 	libcamera::ipa::Pwl gammaCurve;
 };
 
@@ -43,6 +45,7 @@ public:
 	void initialise() override;
 	void prepare(Metadata *imageMetadata) override;
 	void process(StatisticsPtr &stats, Metadata *imageMetadata) override;
+	unsigned int processCost() const override;
 
 private:
 	ContrastConfig config_;
@@ -50,6 +53,10 @@ private:
 	double contrast_;
 	ContrastStatus status_;
 	double ceEnable_;
+
+	/* Histogram points of the stretch applied to status_.gammaCurve. */
+	std::array<double, 3> stretchPoints_;
+	bool gammaCurveValid_;
 };
 
 } /* namespace RPiController */
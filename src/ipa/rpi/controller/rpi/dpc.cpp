@@ -48,7 +48,7 @@ void Dpc::prepare(Metadata *imageMetadata)
 	/* Should we vary this with lux level or analogue gain? TBD. */
 	dpcStatus.strength = config_.strength;
 	LOG(RPiDpc, Debug) << "strength " << dpcStatus.strength;
-	imageMetadata->set("dpc.status", dpcStatus);
+	imageMetadata->set(MetadataTag::Dpc, dpcStatus);
 }
 
 /* Register algorithm with the system. */
@@ -7,6 +7,7 @@
 
 #include "hdr.h"
 
+#include <algorithm>
 #include <cmath>
 
 #include <libcamera/base/log.h>
@@ -23,6 +24,14 @@ LOG_DEFINE_CATEGORY(RPiHdr)
 
 #define NAME "rpi.hdr"
 
+/*
+ * Tolerance on the tonemap gain and power below which a converged tonemap is
+ * reused, and maximum distance (in 16-bit units) between the tonemap and its
+ * target for the tonemap to be considered converged.
+ */
+static constexpr double kTonemapInputTolerance = 1e-3;
+static constexpr double kTonemapConvergedDelta = 1.0;
+
 void HdrConfig::read(const libcamera::YamlObject &params, const std::string &modeName)
 {
 	name = modeName;
@@ -51,6 +60,9 @@ void HdrConfig::read(const libcamera::YamlObject &params, const std::string &mod
 		spatialGainCurve.append(1.0, 1.0);
 	}
 
+	/* The curve is evaluated for every AWB region on every frame. */
+	spatialGainCurve.bake(64);
+
 	diffusion = params["diffusion"].get<unsigned int>(3);
 	/* Clip to an arbitrary limit just to stop typos from killing the system! */
 	const unsigned int MAX_DIFFUSION = 15;
@@ -98,7 +110,8 @@ void HdrConfig::read(const libcamera::YamlObject &params, const std::string &mod
 }
 
 Hdr::Hdr(Controller *controller)
-	: HdrAlgorithm(controller)
+	: HdrAlgorithm(controller), tonemapConverged_(false), tonemapGain_(0),
+	  tonemapPower_(0)
 {
 	regions_ = controller->getHardwareConfig().awbRegions;
 	numRegions_ = regions_.width * regions_.height;
@@ -154,7 +167,7 @@ std::vector<unsigned int> Hdr::getChannels() const
 void Hdr::updateAgcStatus(Metadata *metadata)
 {
 	std::scoped_lock lock(*metadata);
-	AgcStatus *agcStatus = metadata->getLocked<AgcStatus>("agc.status");
+	AgcStatus *agcStatus = metadata->getLocked<AgcStatus>(MetadataTag::Agc);
 	if (agcStatus) {
 		HdrConfig &hdrConfig = config_[status_.mode];
 		auto it = hdrConfig.channelMap.find(agcStatus->channel);
@@ -177,7 +190,7 @@ void Hdr::switchMode([[maybe_unused]] CameraMode const &cameraMode, Metadata *me
 void Hdr::prepare(Metadata *imageMetadata)
 {
 	AgcStatus agcStatus;
-	if (!imageMetadata->get<AgcStatus>("agc.delayed_status", agcStatus))
+	if (!imageMetadata->get<AgcStatus>(MetadataTag::AgcDelayed, agcStatus))
 		delayedStatus_ = agcStatus.hdr;
 
 	auto it = config_.find(delayedStatus_.mode);
@@ -192,7 +205,7 @@ void Hdr::prepare(Metadata *imageMetadata)
 		return;
 
 	AlscStatus alscStatus{}; /* some compilers seem to require the braces */
-	if (imageMetadata->get<AlscStatus>("alsc.status", alscStatus)) {
+	if (imageMetadata->get<AlscStatus>(MetadataTag::Alsc, alscStatus)) {
 		LOG(RPiHdr, Warning) << "No ALSC status";
 		return;
 	}
@@ -204,7 +217,7 @@ void Hdr::prepare(Metadata *imageMetadata)
 		alscStatus.g[i] *= gains[i];
 		alscStatus.b[i] *= gains[i];
 	}
-	imageMetadata->set("alsc.status", alscStatus);
+	imageMetadata->set(MetadataTag::Alsc, alscStatus);
 }
 
 bool Hdr::updateTonemap([[maybe_unused]] StatisticsPtr &stats, HdrConfig &config)
@@ -213,6 +226,7 @@ bool Hdr::updateTonemap([[maybe_unused]] StatisticsPtr &stats, HdrConfig &config
 	if (delayedStatus_.mode != previousMode_) {
 		previousMode_ = delayedStatus_.mode;
 		tonemap_ = ipa::Pwl();
+		tonemapConverged_ = false;
 	}
 
 	/* No tonemapping. No need to output a tonemap.status. */
@@ -222,6 +236,7 @@ bool Hdr::updateTonemap([[maybe_unused]] StatisticsPtr &stats, HdrConfig &config
 	/* If an explicit tonemap was given, use it. */
 	if (!config.tonemap.empty()) {
 		tonemap_ = config.tonemap;
+		tonemapConverged_ = false;
 		return true;
 	}
 
@@ -274,20 +289,36 @@ bool Hdr::updateTonemap([[maybe_unused]] StatisticsPtr &stats, HdrConfig &config
 	}
 	double power = std::clamp(min_power, config.powerMin, config.powerMax);
 
+	/*
+	 * Once the tonemap has converged to its target, regenerating it for the
+	 * same gain and power would only reproduce the same curve.
+	 */
+	if (tonemapConverged_ &&
+	    std::abs(gain - tonemapGain_) < kTonemapInputTolerance &&
+	    std::abs(power - tonemapPower_) < kTonemapInputTolerance)
+		return true;
+
 	/* Generate the tonemap, including the contrast adjustment factors. */
 	libcamera::ipa::Pwl tonemap;
+	double maxDelta = 0;
 	tonemap.append(0, 0);
 	for (unsigned int i = 0; i <= 6; i++) {
 		double x = 1 << (i + 9); /* x loops from 512 to 32768 inclusive */
-		double y = pow(std::min(x * gain, 65535.0) / 65536.0, power) * 65536;
+		double target = pow(std::min(x * gain, 65535.0) / 65536.0, power) * 65536;
 		if (i < config.contrastAdjustments.size())
-			y *= config.contrastAdjustments[i];
+			target *= config.contrastAdjustments[i];
+		double y = target;
 		if (!tonemap_.empty())
 			y = y * config.speed + tonemap_.eval(x) * (1 - config.speed);
+		maxDelta = std::max(maxDelta, std::abs(y - target));
 		tonemap.append(x, y);
 	}
 	tonemap.append(65535, 65535);
-	tonemap_ = tonemap;
+	tonemap_ = std::move(tonemap);
+
+	tonemapConverged_ = maxDelta < kTonemapConvergedDelta;
+	tonemapGain_ = gain;
+	tonemapPower_ = power;
 
 	return true;
 }
@@ -369,7 +400,7 @@ void Hdr::process(StatisticsPtr &stats, Metadata *imageMetadata)
 	 * case delayedStatus_ should be right.
 	 */
 	AgcStatus agcStatus;
-	if (!imageMetadata->get<AgcStatus>("agc.delayed_status", agcStatus))
+	if (!imageMetadata->get<AgcStatus>(MetadataTag::AgcDelayed, agcStatus))
 		delayedStatus_ = agcStatus.hdr;
 
 	auto it = config_.find(delayedStatus_.mode);
@@ -394,7 +425,7 @@ void Hdr::process(StatisticsPtr &stats, Metadata *imageMetadata)
 		tonemapStatus.strength = config.strength;
 		tonemapStatus.tonemap = tonemap_;
 
-		imageMetadata->set("tonemap.status", tonemapStatus);
+		imageMetadata->set(MetadataTag::Tonemap, tonemapStatus);
 	}
 
 	if (config.stitchEnable) {
@@ -405,7 +436,7 @@ void Hdr::process(StatisticsPtr &stats, Metadata *imageMetadata)
 		stitchStatus.motionThreshold = config.motionThreshold;
 		stitchStatus.thresholdLo = config.thresholdLo;
 
-		imageMetadata->set("stitch.status", stitchStatus);
+		imageMetadata->set(MetadataTag::Stitch, stitchStatus);
 	}
 }
 
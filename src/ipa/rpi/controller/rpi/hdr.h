@@ -77,6 +77,9 @@ private:
 	HdrStatus delayedStatus_; /* track the delayed HDR mode and channel */
 	std::string previousMode_;
 	libcamera::ipa::Pwl tonemap_;
+	bool tonemapConverged_; /* tonemap_ has reached the curve for tonemapGain_/Power_ */
+	double tonemapGain_;
+	double tonemapPower_;
 	libcamera::Size regions_; /* stats regions */
 	unsigned int numRegions_; /* total number of stats regions */
 	std::vector<double> gains_[2];
@@ -52,7 +52,7 @@ void Sdn::prepare(Metadata *imageMetadata)
 {
 	struct NoiseStatus noiseStatus = {};
 	noiseStatus.noiseSlope = 3.0; /* in case no metadata */
-	if (imageMetadata->get("noise.status", noiseStatus) != 0)
+	if (imageMetadata->get(MetadataTag::Noise, noiseStatus) != 0)
 		LOG(RPiSdn, Warning) << "no noise profile found";
 	LOG(RPiSdn, Debug)
 		<< "Noise profile: constant " << noiseStatus.noiseConstant
@@ -62,7 +62,7 @@ void Sdn::prepare(Metadata *imageMetadata)
 	status.noiseSlope = noiseStatus.noiseSlope * deviation_;
 	status.strength = strength_;
 	status.mode = utils::to_underlying(mode_);
-	imageMetadata->set("denoise.status", status);
+	imageMetadata->set(MetadataTag::Denoise, status);
 	LOG(RPiSdn, Debug)
 		<< "programmed constant " << status.noiseConstant
 		<< " slope " << status.noiseSlope
@@ -81,7 +81,7 @@ void Sharpen::prepare(Metadata *imageMetadata)
 	status.limit = limit_ / modeFactor_ * userStrengthSqrt;
 	/* Finally, report any application-supplied parameters that were used. */
 	status.userStrength = userStrength_;
-	imageMetadata->set("sharpen.status", status);
+	imageMetadata->set(MetadataTag::Sharpen, status);
 }
 
 /* Register algorithm with the system. */
@@ -50,7 +50,7 @@ void Tonemap::prepare(Metadata *imageMetadata)
 	tonemapStatus.iirStrength = config_.iirStrength;
 	tonemapStatus.strength = config_.strength;
 	tonemapStatus.tonemap = config_.tonemap;
-	imageMetadata->set("tonemap.status", tonemapStatus);
+	imageMetadata->set(MetadataTag::Tonemap, tonemapStatus);
 }
 
 // Register algorithm with the system.
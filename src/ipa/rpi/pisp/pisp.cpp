@@ -78,6 +78,7 @@ int generateLut(const ipa::Pwl &pwl, uint32_t *lut, std::size_t lutSize,
 		return -EINVAL;
 
 	int lastY = 0;
+	int span = -1;
 	for (unsigned int i = 0; i < lutSize; i++) {
 		int x, y;
 		if (i < 32)
@@ -87,7 +88,7 @@ int generateLut(const ipa::Pwl &pwl, uint32_t *lut, std::size_t lutSize,
 		else
 			x = std::min(65535u, (i - 48) * 2048 + 32768);
 
-		y = pwl.eval(x);
+		y = pwl.eval(x, &span);
 		if (y < 0 || (i && y < lastY)) {
 			LOG(IPARPI, Error)
 				<< "Malformed PWL for Gamma, disabling!";
@@ -192,6 +193,7 @@ void resampleTable(double *dest, int destW, int destH, double const *src,
 
 using ::libpisp::BackEnd;
 using ::libpisp::FrontEnd;
+using RPiController::MetadataTag;
 
 namespace ipa::RPi {
 
@@ -340,8 +342,8 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 	global.rgb_enables &= ~(PISP_BE_RGB_ENABLE_GAMMA + PISP_BE_RGB_ENABLE_CCM +
 				PISP_BE_RGB_ENABLE_SHARPEN + PISP_BE_RGB_ENABLE_SAT_CONTROL);
 
-	NoiseStatus *noiseStatus = rpiMetadata.getLocked<NoiseStatus>("noise.status");
-	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>("agc.prepare_status");
+	NoiseStatus *noiseStatus = rpiMetadata.getLocked<NoiseStatus>(MetadataTag::Noise);
+	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>(MetadataTag::AgcPrepare);
 
 	{
 		/* All Frontend config goes first, we do not want to hold the FE lock for long! */
@@ -351,11 +353,11 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 			applyFocusStats(noiseStatus);
 
 		BlackLevelStatus *blackLevelStatus =
-			rpiMetadata.getLocked<BlackLevelStatus>("black_level.status");
+			rpiMetadata.getLocked<BlackLevelStatus>(MetadataTag::BlackLevel);
 		if (blackLevelStatus)
 			applyBlackLevel(blackLevelStatus, global);
 
-		AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>("awb.status");
+		AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>(MetadataTag::Awb);
 		if (awbStatus && agcPrepareStatus) {
 			/* Applies digital gain as well. */
 			applyWBG(awbStatus, agcPrepareStatus, global);
@@ -365,66 +367,66 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 		}
 	}
 
-	CacStatus *cacStatus = rpiMetadata.getLocked<CacStatus>("cac.status");
+	CacStatus *cacStatus = rpiMetadata.getLocked<CacStatus>(MetadataTag::Cac);
 	if (cacStatus)
 		applyCAC(cacStatus, global);
 
 	ContrastStatus *contrastStatus =
-		rpiMetadata.getLocked<ContrastStatus>("contrast.status");
+		rpiMetadata.getLocked<ContrastStatus>(MetadataTag::Contrast);
 	if (contrastStatus)
 		applyContrast(contrastStatus, global);
 
-	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>("ccm.status");
+	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>(MetadataTag::Ccm);
 	if (ccmStatus)
 		applyCCM(ccmStatus, global);
 
-	AlscStatus *alscStatus = rpiMetadata.getLocked<AlscStatus>("alsc.status");
+	AlscStatus *alscStatus = rpiMetadata.getLocked<AlscStatus>(MetadataTag::Alsc);
 	if (alscStatus)
 		applyLensShading(alscStatus, global);
 
-	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>("dpc.status");
+	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>(MetadataTag::Dpc);
 	if (dpcStatus)
 		applyDPC(dpcStatus, global);
 
-	SdnStatus *sdnStatus = rpiMetadata.getLocked<SdnStatus>("sdn.status");
+	SdnStatus *sdnStatus = rpiMetadata.getLocked<SdnStatus>(MetadataTag::Sdn);
 	if (sdnStatus)
 		applySdn(sdnStatus, global);
 
-	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>("device.status");
-	TdnStatus *tdnStatus = rpiMetadata.getLocked<TdnStatus>("tdn.status");
+	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>(MetadataTag::Device);
+	TdnStatus *tdnStatus = rpiMetadata.getLocked<TdnStatus>(MetadataTag::Tdn);
 	if (tdnStatus && deviceStatus)
 		applyTdn(tdnStatus, deviceStatus, global);
 
-	CdnStatus *cdnStatus = rpiMetadata.getLocked<CdnStatus>("cdn.status");
+	CdnStatus *cdnStatus = rpiMetadata.getLocked<CdnStatus>(MetadataTag::Cdn);
 	if (cdnStatus)
 		applyCdn(cdnStatus, global);
 
-	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>("geq.status");
+	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>(MetadataTag::Geq);
 	if (geqStatus)
 		applyGeq(geqStatus, global);
 
 	SaturationStatus *saturationStatus =
-		rpiMetadata.getLocked<SaturationStatus>("saturation.status");
+		rpiMetadata.getLocked<SaturationStatus>(MetadataTag::Saturation);
 	if (saturationStatus)
 		applySaturation(saturationStatus, global);
 
-	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>("sharpen.status");
+	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>(MetadataTag::Sharpen);
 	if (sharpenStatus)
 		applySharpen(sharpenStatus, global);
 
-	StitchStatus *stitchStatus = rpiMetadata.getLocked<StitchStatus>("stitch.status");
+	StitchStatus *stitchStatus = rpiMetadata.getLocked<StitchStatus>(MetadataTag::Stitch);
 	if (stitchStatus) {
 		/*
 		 * Note that it's the *delayed* AGC status that contains the HDR mode/channel
 		 * info that pertains to this frame!
 		 */
-		AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>("agc.delayed_status");
+		AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>(MetadataTag::AgcDelayed);
 		/* prepareIsp() will fetch this value. Maybe pass it back differently? */
 		stitchSwapBuffers_ = applyStitch(stitchStatus, deviceStatus, agcStatus, global);
 	} else
 		lastStitchHdrStatus_ = HdrStatus();
 
-	TonemapStatus *tonemapStatus = rpiMetadata.getLocked<TonemapStatus>("tonemap.status");
+	TonemapStatus *tonemapStatus = rpiMetadata.getLocked<TonemapStatus>(MetadataTag::Tonemap);
 	if (tonemapStatus)
 		applyTonemap(tonemapStatus, global);
 
@@ -434,7 +436,7 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 	lastExposure_ = deviceStatus->shutterSpeed * deviceStatus->analogueGain;
 
 	/* Lens control */
-	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>("af.status");
+	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>(MetadataTag::Af);
 	if (afStatus) {
 		ControlList lensctrls(lensCtrls_);
 		applyAF(afStatus, lensctrls);
@@ -458,12 +460,14 @@ RPiController::StatisticsPtr IpaPiSP::platformProcessStats(Span<uint8_t> mem)
 	statistics->yHist = RPiController::Histogram(stats->agc.histogram,
 						     PISP_AGC_STATS_NUM_BINS);
 
-	statistics->awbRegions.init({ PISP_AWB_STATS_SIZE, PISP_AWB_STATS_SIZE });
-	for (i = 0; i < statistics->awbRegions.numRegions(); i++)
-		statistics->awbRegions.set(i, { { stats->awb.zones[i].R_sum,
-						  stats->awb.zones[i].G_sum,
-						  stats->awb.zones[i].B_sum },
-						stats->awb.zones[i].counted, 0 });
+	if (awbRegionsUsed_) {
+		statistics->awbRegions.init({ PISP_AWB_STATS_SIZE, PISP_AWB_STATS_SIZE });
+		for (i = 0; i < statistics->awbRegions.numRegions(); i++)
+			statistics->awbRegions.set(i, { { stats->awb.zones[i].R_sum,
+							  stats->awb.zones[i].G_sum,
+							  stats->awb.zones[i].B_sum },
+							stats->awb.zones[i].counted, 0 });
+	}
 
 	/* AGC region sums only get collected on floating zones. */
 	statistics->agcRegions.init({ 0, 0 }, PISP_FLOATING_STATS_NUM_ZONES);
@@ -35,6 +35,8 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPARPI)
 
+using RPiController::MetadataTag;
+
 namespace ipa::RPi {
 
 class IpaVc4 final : public IpaBase
@@ -143,47 +145,47 @@ void IpaVc4::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 	/* Lock the metadata buffer to avoid constant locks/unlocks. */
 	std::unique_lock<RPiController::Metadata> lock(rpiMetadata);
 
-	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>("awb.status");
+	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>(MetadataTag::Awb);
 	if (awbStatus)
 		applyAWB(awbStatus, ctrls);
 
-	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>("ccm.status");
+	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>(MetadataTag::Ccm);
 	if (ccmStatus)
 		applyCCM(ccmStatus, ctrls);
 
-	AgcPrepareStatus *dgStatus = rpiMetadata.getLocked<AgcPrepareStatus>("agc.prepare_status");
+	AgcPrepareStatus *dgStatus = rpiMetadata.getLocked<AgcPrepareStatus>(MetadataTag::AgcPrepare);
 	if (dgStatus)
 		applyDG(dgStatus, ctrls);
 
-	AlscStatus *lsStatus = rpiMetadata.getLocked<AlscStatus>("alsc.status");
+	AlscStatus *lsStatus = rpiMetadata.getLocked<AlscStatus>(MetadataTag::Alsc);
 	if (lsStatus)
 		applyLS(lsStatus, ctrls);
 
-	ContrastStatus *contrastStatus = rpiMetadata.getLocked<ContrastStatus>("contrast.status");
+	ContrastStatus *contrastStatus = rpiMetadata.getLocked<ContrastStatus>(MetadataTag::Contrast);
 	if (contrastStatus)
 		applyGamma(contrastStatus, ctrls);
 
-	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>("black_level.status");
+	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>(MetadataTag::BlackLevel);
 	if (blackLevelStatus)
 		applyBlackLevel(blackLevelStatus, ctrls);
 
-	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>("geq.status");
+	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>(MetadataTag::Geq);
 	if (geqStatus)
 		applyGEQ(geqStatus, ctrls);
 
-	DenoiseStatus *denoiseStatus = rpiMetadata.getLocked<DenoiseStatus>("denoise.status");
+	DenoiseStatus *denoiseStatus = rpiMetadata.getLocked<DenoiseStatus>(MetadataTag::Denoise);
 	if (denoiseStatus)
 		applyDenoise(denoiseStatus, ctrls);
 
-	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>("sharpen.status");
+	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>(MetadataTag::Sharpen);
 	if (sharpenStatus)
 		applySharpen(sharpenStatus, ctrls);
 
-	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>("dpc.status");
+	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>(MetadataTag::Dpc);
 	if (dpcStatus)
 		applyDPC(dpcStatus, ctrls);
 
-	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>("af.status");
+	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>(MetadataTag::Af);
 	if (afStatus) {
 		ControlList lensctrls(lensCtrls_);
 		applyAF(afStatus, lensctrls);
@@ -212,13 +214,15 @@ RPiController::StatisticsPtr IpaVc4::platformProcessStats(Span<uint8_t> mem)
 	/* All region sums are based on a 16-bit normalised pipeline bit-depth. */
 	unsigned int scale = Statistics::NormalisationFactorPow2 - hw.pipelineWidth;
 
-	statistics->awbRegions.init(hw.awbRegions);
-	for (i = 0; i < statistics->awbRegions.numRegions(); i++)
-		statistics->awbRegions.set(i, { { stats->awb_stats[i].r_sum << scale,
-						  stats->awb_stats[i].g_sum << scale,
-						  stats->awb_stats[i].b_sum << scale },
-						stats->awb_stats[i].counted,
-						stats->awb_stats[i].notcounted });
+	if (awbRegionsUsed_) {
+		statistics->awbRegions.init(hw.awbRegions);
+		for (i = 0; i < statistics->awbRegions.numRegions(); i++)
+			statistics->awbRegions.set(i, { { stats->awb_stats[i].r_sum << scale,
+							  stats->awb_stats[i].g_sum << scale,
+							  stats->awb_stats[i].b_sum << scale },
+							stats->awb_stats[i].counted,
+							stats->awb_stats[i].notcounted });
+	}
 
 	RPiController::AgcAlgorithm *agc = dynamic_cast<RPiController::AgcAlgorithm *>(
 		controller_.getAlgorithm("agc"));
@@ -370,13 +374,14 @@ void IpaVc4::applyGamma(const struct ContrastStatus *contrastStatus, ControlList
 {
 	const unsigned int numGammaPoints = controller_.getHardwareConfig().numGammaPoints;
 	struct bcm2835_isp_gamma gamma;
+	int span = -1;
 
 	for (unsigned int i = 0; i < numGammaPoints - 1; i++) {
 		int x = i < 16 ? i * 1024
 			       : (i < 24 ? (i - 16) * 2048 + 16384
 					 : (i - 24) * 4096 + 32768);
 		gamma.x[i] = x;
-		gamma.y[i] = std::min<uint16_t>(65535, contrastStatus->gammaCurve.eval(x));
+		gamma.y[i] = std::min<uint16_t>(65535, contrastStatus->gammaCurve.eval(x, &span));
 	}
 
 	gamma.x[numGammaPoints - 1] = 65535;
@@ -5,16 +5,20 @@
  * Simple Software Image Processing Algorithm module
  */
 
+#include <algorithm>
 #include <cmath>
 #include <numeric>
+#include <optional>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <linux/v4l2-controls.h>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/shared_fd.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/control_ids.h>
 #include <libcamera/controls.h>
@@ -24,6 +28,7 @@
 #include <libcamera/ipa/soft_ipa_interface.h>
 
 #include "libcamera/internal/software_isp/debayer_params.h"
+#include "libcamera/internal/software_isp/swisp_shared_mem.h"
 #include "libcamera/internal/software_isp/swisp_stats.h"
 #include "libcamera/internal/yaml_parser.h"
 
@@ -54,6 +59,36 @@ static constexpr float kExposureOptimal = kExposureBinsCount / 2.0;
  */
 static constexpr float kExposureSatisfactory = 0.2;
 
+/*
+ * The mean of the histogram, normalised to the [0, 1] range above the black
+ * level, that corresponds to the optimal mean sample value.
+ */
+static constexpr double kExposureTargetMean =
+	(kExposureOptimal - 0.5) / kExposureBinsCount;
+
+/*
+ * The maximum exposure change factor applied in a single update. The
+ * brightness doesn't scale linearly with the exposure when the image is
+ * saturated, limit the change to avoid overshooting.
+ */
+static constexpr double kExposureMaxFactor = 4.0;
+
+/*
+ * The minimum change of the AWB gains, in 1/256 units, that causes the lookup
+ * tables to be regenerated.
+ */
+static constexpr int kGainUpdateThreshold = 2;
+
+/*
+ * Default parameters of the adaptive frame rate. The frame length is extended
+ * up to kFrameLengthFactor times its nominal value after kStaticFrames frames
+ * without motion, and motion is detected when the mean change of the relative
+ * zone luminances exceeds kMotionThreshold.
+ */
+static constexpr double kFrameLengthFactor = 4.0;
+static constexpr unsigned int kStaticFrames = 30;
+static constexpr double kMotionThreshold = 0.02;
+
 class IPASoftSimple : public ipa::soft::IPASoftInterface
 {
 public:
@@ -66,21 +101,31 @@ public:
 	~IPASoftSimple();
 
 	int init(const IPASettings &settings,
-		 const SharedFD &fdStats,
-		 const SharedFD &fdParams,
+		 const SharedFD &fdSharedMem,
 		 const ControlInfoMap &sensorInfoMap) override;
 	int configure(const ControlInfoMap &sensorInfoMap) override;
 
 	int start() override;
 	void stop() override;
 
-	void processStats(const ControlList &sensorControls) override;
+	void fillParamsBuffer(const uint32_t frame, const uint32_t bufferId) override;
+	void processStats(const uint32_t frame, const uint32_t bufferId,
+			  const ControlList &sensorControls) override;
 
 private:
-	void updateExposure(double exposureMSV);
-
+	int parseColorCorrection(const YamlObject &tuningData);
+	void updateColorCorrection(uint8_t blackLevel, unsigned int gainR,
+				   unsigned int gainB);
+	void updateLookupTables(uint8_t blackLevel, unsigned int gainR,
+				unsigned int gainB);
+	void updateExposure(double exposureMSV, double exposureMean);
+	int parseAdaptiveFrameRate(const YamlObject &tuningData);
+	void updateFrameRate(const SwIspStats &stats);
+
+	Span<uint8_t> sharedMem_;
 	DebayerParams *params_;
 	SwIspStats *stats_;
+	DebayerParams currentParams_;
 	std::unique_ptr<CameraSensorHelper> camHelper_;
 	ControlInfoMap sensorInfoMap_;
 	BlackLevel blackLevel_;
@@ -88,25 +133,39 @@ private:
 	static constexpr unsigned int kGammaLookupSize = 1024;
 	std::array<uint8_t, kGammaLookupSize> gammaTable_;
 	int lastBlackLevel_ = -1;
+	int lastGainR_ = -1;
+	int lastGainB_ = -1;
+
+	/* Colour correction matrix from the tuning file, in RGB row-major order */
+	bool colorCorrection_ = false;
+	std::array<double, 9> ccm_;
 
 	int32_t exposureMin_, exposureMax_;
 	int32_t exposure_;
 	double againMin_, againMax_, againMinStep_;
 	double again_;
 	unsigned int ignoreUpdates_;
+
+	/* Adaptive frame rate, enabled by the tuning file */
+	bool adaptiveFrameRate_ = false;
+	double frameLengthFactor_;
+	unsigned int staticFramesThreshold_;
+	double motionThreshold_;
+	int32_t vblankNominal_;
+	int32_t vblankStatic_;
+	int32_t vblank_;
+	unsigned int staticFrames_;
+	std::optional<std::array<double, SwIspStats::kGridWidth * SwIspStats::kGridHeight>> lastZones_;
 };
 
 IPASoftSimple::~IPASoftSimple()
 {
-	if (stats_)
-		munmap(stats_, sizeof(SwIspStats));
-	if (params_)
-		munmap(params_, sizeof(DebayerParams));
+	if (!sharedMem_.empty())
+		munmap(sharedMem_.data(), sharedMem_.size());
 }
 
 int IPASoftSimple::init(const IPASettings &settings,
-			const SharedFD &fdStats,
-			const SharedFD &fdParams,
+			const SharedFD &fdSharedMem,
 			const ControlInfoMap &sensorInfoMap)
 {
 	camHelper_ = CameraSensorHelperFactoryBase::create(settings.sensorModel);
@@ -137,37 +196,45 @@ int IPASoftSimple::init(const IPASettings &settings,
 	params_ = nullptr;
 	stats_ = nullptr;
 
-	if (!fdStats.isValid()) {
-		LOG(IPASoft, Error) << "Invalid Statistics handle";
+	if (!fdSharedMem.isValid()) {
+		LOG(IPASoft, Error) << "Invalid shared memory handle";
 		return -ENODEV;
 	}
 
-	if (!fdParams.isValid()) {
-		LOG(IPASoft, Error) << "Invalid Parameters handle";
-		return -ENODEV;
+	/*
+	 * The parameters and statistics rings are stored in a single shared
+	 * memory, whose size may have been rounded up to the huge page size.
+	 */
+	struct stat st;
+	if (fstat(fdSharedMem.get(), &st) < 0 ||
+	    static_cast<size_t>(st.st_size) < SwIspSharedMem::kSize) {
+		LOG(IPASoft, Error) << "Invalid shared memory size";
+		return -EINVAL;
 	}
 
-	{
-		void *mem = mmap(nullptr, sizeof(DebayerParams), PROT_WRITE,
-				 MAP_SHARED, fdParams.get(), 0);
-		if (mem == MAP_FAILED) {
-			LOG(IPASoft, Error) << "Unable to map Parameters";
-			return -errno;
-		}
-
-		params_ = static_cast<DebayerParams *>(mem);
+	void *mem = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fdSharedMem.get(), 0);
+	if (mem == MAP_FAILED) {
+		LOG(IPASoft, Error) << "Unable to map parameters and statistics";
+		return -errno;
 	}
 
-	{
-		void *mem = mmap(nullptr, sizeof(SwIspStats), PROT_READ,
-				 MAP_SHARED, fdStats.get(), 0);
-		if (mem == MAP_FAILED) {
-			LOG(IPASoft, Error) << "Unable to map Statistics";
-			return -errno;
-		}
+	sharedMem_ = { static_cast<uint8_t *>(mem), static_cast<size_t>(st.st_size) };
+	params_ = reinterpret_cast<DebayerParams *>(
+		sharedMem_.data() + SwIspSharedMem::offset<DebayerParamsRing>());
+	stats_ = reinterpret_cast<SwIspStats *>(
+		sharedMem_.data() + SwIspSharedMem::offset<SwIspStatsRing>());
 
-		stats_ = static_cast<SwIspStats *>(mem);
-	}
+	/* Start from the default parameters set by the Software ISP */
+	currentParams_ = params_[0];
+
+	int ret = parseColorCorrection(*data);
+	if (ret)
+		return ret;
+
+	ret = parseAdaptiveFrameRate(*data);
+	if (ret)
+		return ret;
 
 	/*
 	 * Check if the sensor driver supports the controls required by the
@@ -188,6 +255,165 @@ int IPASoftSimple::init(const IPASettings &settings,
 	return 0;
 }
 
+/*
+ * Parse the optional colour correction matrix and lens shading correction
+ * grids from the tuning data. Colour correction is enabled when any of them
+ * is present, the matrix defaulting to identity and the grids to unity gains.
+ */
+int IPASoftSimple::parseColorCorrection(const YamlObject &tuningData)
+{
+	ccm_ = { 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0 };
+
+	if (tuningData.contains("ccm")) {
+		std::optional<std::vector<double>> ccm =
+			tuningData["ccm"].getList<double>();
+		if (!ccm || ccm->size() != ccm_.size()) {
+			LOG(IPASoft, Error)
+				<< "Invalid 'ccm' in tuning file, expected "
+				<< ccm_.size() << " values";
+			return -EINVAL;
+		}
+
+		std::copy(ccm->begin(), ccm->end(), ccm_.begin());
+		colorCorrection_ = true;
+	}
+
+	if (tuningData.contains("lsc")) {
+		const YamlObject &lsc = tuningData["lsc"];
+		const std::array<std::pair<const char *, DebayerParams::LscGrid *>, 3> grids = { {
+			{ "red", &currentParams_.lscRed },
+			{ "green", &currentParams_.lscGreen },
+			{ "blue", &currentParams_.lscBlue },
+		} };
+
+		for (const auto &[name, grid] : grids) {
+			std::optional<std::vector<double>> gains =
+				lsc[name].getList<double>();
+			if (!gains || gains->size() != grid->size()) {
+				LOG(IPASoft, Error)
+					<< "Invalid 'lsc' " << name
+					<< " grid in tuning file, expected "
+					<< grid->size() << " values";
+				return -EINVAL;
+			}
+
+			for (unsigned int i = 0; i < grid->size(); i++)
+				(*grid)[i] = std::clamp((*gains)[i] * 256.0, 0.0,
+							static_cast<double>(UINT16_MAX));
+		}
+
+		colorCorrection_ = true;
+	}
+
+	currentParams_.colorCorrection = colorCorrection_;
+	if (!colorCorrection_)
+		return 0;
+
+	constexpr double gamma = 0.5;
+	for (unsigned int i = 0; i < DebayerParams::kGammaLookupSize; i++)
+		currentParams_.gamma[i] = UINT8_MAX *
+			std::pow(i / (DebayerParams::kGammaLookupSize - 1.0), gamma);
+
+	LOG(IPASoft, Debug) << "Colour correction enabled";
+
+	return 0;
+}
+
+/*
+ * Parse the optional adaptive frame rate parameters from the tuning data. The
+ * frame rate is lowered when the scene is static, to reduce the bandwidth and
+ * the processing load, and restored as soon as motion is detected.
+ */
+int IPASoftSimple::parseAdaptiveFrameRate(const YamlObject &tuningData)
+{
+	if (!tuningData.contains("adaptive-frame-rate"))
+		return 0;
+
+	const YamlObject &params = tuningData["adaptive-frame-rate"];
+
+	frameLengthFactor_ = params["frame-length-factor"].get<double>(kFrameLengthFactor);
+	staticFramesThreshold_ = params["static-frames"].get<uint32_t>(kStaticFrames);
+	motionThreshold_ = params["motion-threshold"].get<double>(kMotionThreshold);
+
+	if (frameLengthFactor_ < 1.0 || motionThreshold_ <= 0.0) {
+		LOG(IPASoft, Error) << "Invalid 'adaptive-frame-rate' in tuning file";
+		return -EINVAL;
+	}
+
+	adaptiveFrameRate_ = true;
+
+	LOG(IPASoft, Debug)
+		<< "Adaptive frame rate enabled, frame length factor "
+		<< frameLengthFactor_;
+
+	return 0;
+}
+
+/*
+ * With colour correction enabled, the lookup tables only subtract the black
+ * level, the white balance gains are folded into the colour correction matrix
+ * and the gamma curve is applied by the Software ISP last.
+ */
+void IPASoftSimple::updateColorCorrection(uint8_t blackLevel, unsigned int gainR,
+					  unsigned int gainB)
+{
+	const unsigned int gains[3] = { gainR, 256, gainB };
+
+	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+		const unsigned int value = i <= blackLevel ? 0
+			: (i - blackLevel) * UINT8_MAX / (UINT8_MAX - blackLevel);
+		currentParams_.red[i] = value;
+		currentParams_.green[i] = value;
+		currentParams_.blue[i] = value;
+	}
+
+	for (unsigned int i = 0; i < 3; i++) {
+		for (unsigned int j = 0; j < 3; j++) {
+			double coeff = std::round(ccm_[i * 3 + j] * gains[j]);
+			currentParams_.ccm[i * 3 + j] =
+				std::clamp<double>(coeff, INT16_MIN, INT16_MAX);
+		}
+	}
+}
+
+/*
+ * Without colour correction, the lookup tables apply the white balance gains
+ * and the gamma curve, the black level being subtracted by the gamma table.
+ */
+void IPASoftSimple::updateLookupTables(uint8_t blackLevel, unsigned int gainR,
+				       unsigned int gainB)
+{
+	/* Green gain and gamma values are fixed */
+	constexpr unsigned int gainG = 256;
+
+	/* Update the gamma table if needed */
+	if (blackLevel != lastBlackLevel_) {
+		constexpr float gamma = 0.5;
+		const unsigned int blackIndex = blackLevel * kGammaLookupSize / 256;
+		std::fill(gammaTable_.begin(), gammaTable_.begin() + blackIndex, 0);
+		const float divisor = kGammaLookupSize - blackIndex - 1.0;
+		for (unsigned int i = blackIndex; i < kGammaLookupSize; i++)
+			gammaTable_[i] = UINT8_MAX *
+					 std::pow((i - blackIndex) / divisor, gamma);
+	}
+
+	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+		constexpr unsigned int div =
+			DebayerParams::kRGBLookupSize * 256 / kGammaLookupSize;
+		unsigned int idx;
+
+		/* Apply gamma after gain! */
+		idx = std::min({ i * gainR / div, (kGammaLookupSize - 1) });
+		currentParams_.red[i] = gammaTable_[idx];
+
+		idx = std::min({ i * gainG / div, (kGammaLookupSize - 1) });
+		currentParams_.green[i] = gammaTable_[idx];
+
+		idx = std::min({ i * gainB / div, (kGammaLookupSize - 1) });
+		currentParams_.blue[i] = gammaTable_[idx];
+	}
+}
+
 int IPASoftSimple::configure(const ControlInfoMap &sensorInfoMap)
 {
 	sensorInfoMap_ = sensorInfoMap;
@@ -206,6 +432,7 @@ int IPASoftSimple::configure(const ControlInfoMap &sensorInfoMap)
 	int32_t againMax = gainInfo.max().get<int32_t>();
 
 	if (camHelper_) {
+		camHelper_->setGainCodeLimits(againMin, againMax);
 		againMin_ = camHelper_->gain(againMin);
 		againMax_ = camHelper_->gain(againMax);
 		againMinStep_ = (againMax_ - againMin_) / 100.0;
@@ -220,6 +447,7 @@ int IPASoftSimple::configure(const ControlInfoMap &sensorInfoMap)
 		 * the AGC algorithm (abrupt near one edge, and very small near the
 		 * other) we limit the range of the gain values used.
 		 */
+		againMin_ = againMin;
 		againMax_ = againMax;
 		if (!againMin) {
 			LOG(IPASoft, Warning)
@@ -233,11 +461,45 @@ int IPASoftSimple::configure(const ControlInfoMap &sensorInfoMap)
 			   << ", gain " << againMin_ << "-" << againMax_
 			   << " (" << againMinStep_ << ")";
 
+	if (adaptiveFrameRate_) {
+		auto vblankInfo = sensorInfoMap_.find(V4L2_CID_VBLANK);
+		if (vblankInfo == sensorInfoMap_.end()) {
+			LOG(IPASoft, Warning)
+				<< "Sensor has no vertical blanking control, "
+				<< "adaptive frame rate disabled";
+			adaptiveFrameRate_ = false;
+			return 0;
+		}
+
+		/*
+		 * The sensor frame length isn't known to the IPA. Approximate
+		 * it with the maximum exposure time, which most sensor drivers
+		 * limit to the frame length minus a small margin. The frame
+		 * length is only ever extended beyond its nominal value, which
+		 * keeps the exposure limits valid.
+		 */
+		const int32_t vblankMax = vblankInfo->second.max().get<int32_t>();
+		vblankNominal_ = vblankInfo->second.def().get<int32_t>();
+		vblankStatic_ = std::clamp<int64_t>(vblankNominal_ +
+						    std::lround((frameLengthFactor_ - 1.0) * exposureMax_),
+						    vblankNominal_, vblankMax);
+	}
+
 	return 0;
 }
 
 int IPASoftSimple::start()
 {
+	/*
+	 * The vertical blanking may have been left extended when the camera
+	 * was stopped, force it to be restored on the first frame.
+	 */
+	if (adaptiveFrameRate_) {
+		vblank_ = -1;
+		staticFrames_ = 0;
+		lastZones_.reset();
+	}
+
 	return 0;
 }
 
@@ -245,9 +507,30 @@ void IPASoftSimple::stop()
 {
 }
 
-void IPASoftSimple::processStats(const ControlList &sensorControls)
+void IPASoftSimple::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
+{
+	if (bufferId >= kDebayerParamsBufferCount) {
+		LOG(IPASoft, Error) << "Invalid parameters buffer " << bufferId;
+		return;
+	}
+
+	params_[bufferId] = currentParams_;
+
+	setIspParams.emit(frame, bufferId);
+}
+
+void IPASoftSimple::processStats([[maybe_unused]] const uint32_t frame,
+				 const uint32_t bufferId,
+				 const ControlList &sensorControls)
 {
-	SwIspStats::Histogram histogram = stats_->yHistogram;
+	if (bufferId >= kSwIspStatsBufferCount) {
+		LOG(IPASoft, Error) << "Invalid statistics buffer " << bufferId;
+		return;
+	}
+
+	const SwIspStats *stats = &stats_[bufferId];
+
+	SwIspStats::Histogram histogram = stats->yHistogram;
 	if (ignoreUpdates_ > 0)
 		blackLevel_.update(histogram);
 	const uint8_t blackLevel = blackLevel_.get();
@@ -260,9 +543,9 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 	const uint64_t nPixels = std::accumulate(
 		histogram.begin(), histogram.end(), 0);
 	const uint64_t offset = blackLevel * nPixels;
-	const uint64_t sumR = stats_->sumR_ - offset / 4;
-	const uint64_t sumG = stats_->sumG_ - offset / 2;
-	const uint64_t sumB = stats_->sumB_ - offset / 4;
+	const uint64_t sumR = stats->sumR_ - offset / 4;
+	const uint64_t sumG = stats->sumG_ - offset / 2;
+	const uint64_t sumB = stats->sumB_ - offset / 4;
 
 	/*
 	 * Calculate red and blue gains for AWB.
@@ -271,39 +554,33 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 	 */
 	const unsigned int gainR = sumR <= sumG / 4 ? 1024 : 256 * sumG / sumR;
 	const unsigned int gainB = sumB <= sumG / 4 ? 1024 : 256 * sumG / sumB;
-	/* Green gain and gamma values are fixed */
-	constexpr unsigned int gainG = 256;
-
-	/* Update the gamma table if needed */
-	if (blackLevel != lastBlackLevel_) {
-		constexpr float gamma = 0.5;
-		const unsigned int blackIndex = blackLevel * kGammaLookupSize / 256;
-		std::fill(gammaTable_.begin(), gammaTable_.begin() + blackIndex, 0);
-		const float divisor = kGammaLookupSize - blackIndex - 1.0;
-		for (unsigned int i = blackIndex; i < kGammaLookupSize; i++)
-			gammaTable_[i] = UINT8_MAX *
-					 std::pow((i - blackIndex) / divisor, gamma);
+	/*
+	 * Regenerate the lookup tables only when the black level or the gains
+	 * have changed noticeably, the gains estimated from consecutive frames
+	 * of a static scene vary slightly.
+	 */
+	const bool gainsChanged =
+		lastGainR_ < 0 ||
+		std::abs(static_cast<int>(gainR) - lastGainR_) > kGainUpdateThreshold ||
+		std::abs(static_cast<int>(gainB) - lastGainB_) > kGainUpdateThreshold;
+
+	if (blackLevel != lastBlackLevel_ || gainsChanged) {
+		if (colorCorrection_)
+			updateColorCorrection(blackLevel, gainR, gainB);
+		else
+			updateLookupTables(blackLevel, gainR, gainB);
 
 		lastBlackLevel_ = blackLevel;
+		lastGainR_ = gainR;
+		lastGainB_ = gainB;
 	}
 
-	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
-		constexpr unsigned int div =
-			DebayerParams::kRGBLookupSize * 256 / kGammaLookupSize;
-		unsigned int idx;
-
-		/* Apply gamma after gain! */
-		idx = std::min({ i * gainR / div, (kGammaLookupSize - 1) });
-		params_->red[i] = gammaTable_[idx];
-
-		idx = std::min({ i * gainG / div, (kGammaLookupSize - 1) });
-		params_->green[i] = gammaTable_[idx];
-
-		idx = std::min({ i * gainB / div, (kGammaLookupSize - 1) });
-		params_->blue[i] = gammaTable_[idx];
-	}
-
-	setIspParams.emit();
+	/*
+	 * The scene content is compared between consecutive frames, the frame
+	 * rate is thus updated on every frame, regardless of the AE delay.
+	 */
+	if (adaptiveFrameRate_)
+		updateFrameRate(*stats);
 
 	/* \todo Switch to the libipa/algorithm.h API someday. */
 
@@ -331,10 +608,14 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 	int exposureBins[kExposureBinsCount] = {};
 	unsigned int denom = 0;
 	unsigned int num = 0;
+	double weightedSum = 0.0;
 
 	for (unsigned int i = 0; i < histogramSize; i++) {
 		unsigned int idx = (i - (i / yHistValsPerBinMod)) / yHistValsPerBin;
-		exposureBins[idx] += stats_->yHistogram[blackLevelHistIdx + i];
+		uint32_t count = stats->yHistogram[blackLevelHistIdx + i];
+
+		exposureBins[idx] += count;
+		weightedSum += count * (i + 0.5);
 	}
 
 	for (unsigned int i = 0; i < kExposureBinsCount; i++) {
@@ -345,6 +626,12 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 
 	float exposureMSV = static_cast<float>(num) / denom;
 
+	/*
+	 * Compute the mean of the full histogram, normalised to the [0, 1]
+	 * range above the black level, to predict the exposure change.
+	 */
+	double exposureMean = denom ? weightedSum / denom / histogramSize : 0.0;
+
 	/* Sanity check */
 	if (!sensorControls.contains(V4L2_CID_EXPOSURE) ||
 	    !sensorControls.contains(V4L2_CID_ANALOGUE_GAIN)) {
@@ -356,7 +643,7 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 	int32_t again = sensorControls.get(V4L2_CID_ANALOGUE_GAIN).get<int32_t>();
 	again_ = camHelper_ ? camHelper_->gain(again) : again;
 
-	updateExposure(exposureMSV);
+	updateExposure(exposureMSV, exposureMean);
 
 	ControlList ctrls(sensorInfoMap_);
 
@@ -374,51 +661,84 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 			    << " black level " << static_cast<unsigned int>(blackLevel);
 }
 
-void IPASoftSimple::updateExposure(double exposureMSV)
+/*
+ * Predict the exposure and gain that bring the mean of the histogram to its
+ * target, assuming the brightness scales linearly with the total exposure.
+ * The exposure time is favoured over the gain to minimise noise. No update is
+ * performed when the mean sample value is within the hysteresis range of the
+ * optimal value, to avoid oscillations.
+ */
+void IPASoftSimple::updateExposure(double exposureMSV, double exposureMean)
 {
-	/*
-	 * kExpDenominator of 10 gives ~10% increment/decrement;
-	 * kExpDenominator of 5 - about ~20%
-	 */
-	static constexpr uint8_t kExpDenominator = 10;
-	static constexpr uint8_t kExpNumeratorUp = kExpDenominator + 1;
-	static constexpr uint8_t kExpNumeratorDown = kExpDenominator - 1;
+	if (exposureMSV >= kExposureOptimal - kExposureSatisfactory &&
+	    exposureMSV <= kExposureOptimal + kExposureSatisfactory)
+		return;
 
-	double next;
+	double factor = exposureMean > 0.0
+		      ? kExposureTargetMean / exposureMean
+		      : kExposureMaxFactor;
+	factor = std::clamp(factor, 1.0 / kExposureMaxFactor, kExposureMaxFactor);
 
-	if (exposureMSV < kExposureOptimal - kExposureSatisfactory) {
-		next = exposure_ * kExpNumeratorUp / kExpDenominator;
-		if (next - exposure_ < 1)
-			exposure_ += 1;
-		else
-			exposure_ = next;
-		if (exposure_ >= exposureMax_) {
-			next = again_ * kExpNumeratorUp / kExpDenominator;
-			if (next - again_ < againMinStep_)
-				again_ += againMinStep_;
-			else
-				again_ = next;
-		}
+	double totalExposure = exposure_ * again_ * factor;
+
+	exposure_ = std::clamp<int32_t>(std::lround(totalExposure / againMin_),
+					exposureMin_, exposureMax_);
+	again_ = std::clamp(totalExposure / exposure_, againMin_, againMax_);
+}
+
+/*
+ * Detect motion by comparing the luminance of the statistics zones with the
+ * previous frame. The zone luminances are normalised by the mean luminance of
+ * the frame, to ignore global brightness changes caused by the exposure
+ * updates. The vertical blanking is extended after staticFramesThreshold_
+ * frames without motion, and restored to its nominal value as soon as motion
+ * is detected.
+ */
+void IPASoftSimple::updateFrameRate(const SwIspStats &stats)
+{
+	std::array<double, SwIspStats::kGridWidth * SwIspStats::kGridHeight> zones;
+	double mean = 0.0;
+
+	for (unsigned int i = 0; i < zones.size(); i++) {
+		const SwIspStats::Zone &zone = stats.zones[i];
+		zones[i] = zone.count ? static_cast<double>(zone.sumG) / zone.count : 0.0;
+		mean += zones[i];
 	}
 
-	if (exposureMSV > kExposureOptimal + kExposureSatisfactory) {
-		if (exposure_ == exposureMax_ && again_ > againMin_) {
-			next = again_ * kExpNumeratorDown / kExpDenominator;
-			if (again_ - next < againMinStep_)
-				again_ -= againMinStep_;
-			else
-				again_ = next;
-		} else {
-			next = exposure_ * kExpNumeratorDown / kExpDenominator;
-			if (exposure_ - next < 1)
-				exposure_ -= 1;
-			else
-				exposure_ = next;
-		}
+	mean /= zones.size();
+	if (mean <= 0.0)
+		return;
+
+	double change = 0.0;
+	for (unsigned int i = 0; i < zones.size(); i++) {
+		zones[i] /= mean;
+		if (lastZones_)
+			change += std::abs(zones[i] - (*lastZones_)[i]);
 	}
 
-	exposure_ = std::clamp(exposure_, exposureMin_, exposureMax_);
-	again_ = std::clamp(again_, againMin_, againMax_);
+	change /= zones.size();
+	const bool motion = !lastZones_ || change > motionThreshold_;
+	lastZones_ = zones;
+
+	if (motion)
+		staticFrames_ = 0;
+	else if (staticFrames_ < staticFramesThreshold_)
+		staticFrames_++;
+
+	const int32_t vblank = staticFrames_ >= staticFramesThreshold_
+			     ? vblankStatic_ : vblankNominal_;
+	if (vblank == vblank_)
+		return;
+
+	vblank_ = vblank;
+
+	LOG(IPASoft, Debug)
+		<< (motion ? "Motion" : "Static scene") << " detected, vblank "
+		<< vblank_;
+
+	ControlList ctrls(sensorInfoMap_);
+	ctrls.set(V4L2_CID_VBLANK, vblank_);
+	setSensorControls.emit(ctrls);
 }
 
 } /* namespace ipa::soft */
@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Virtual camera Image Processing Algorithm module
+ */
+
+#include <libcamera/ipa/virtual_ipa_interface.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+
+#include <libcamera/ipa/ipa_interface.h>
+#include <libcamera/ipa/ipa_module_info.h>
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(IPAVirtual)
+
+/*
+ * The virtual camera has no scene to measure. Its brightness is modelled as
+ * proportional to the exposure time and gain, which is enough to run an AE
+ * loop that converges over a few frames, as a real one does.
+ */
+namespace {
+
+/* Mean luminance, normalized to [0, 1], per microsecond of exposure. */
+constexpr double kSceneBrightness = 2.5e-5;
+constexpr double kTargetLuminance = 0.5;
+
+/* Maximum relative error considered as converged. */
+constexpr double kLockTolerance = 0.02;
+
+/* Fraction of the error corrected at each frame. */
+constexpr double kSpeed = 0.5;
+
+} /* namespace */
+
+class IPAVirtual : public ipa::virt::IPAVirtualInterface
+{
+public:
+	int init(const IPASettings &settings,
+		 const ControlInfoMap &sensorControls) override;
+	int configure(const IPACameraSensorInfo &sensorInfo) override;
+
+	int start() override;
+	void stop() override;
+
+	void queueRequest(uint32_t frame, const ControlList &controls) override;
+	void processFrame(uint32_t frame, const ControlList &sensorControls) override;
+
+private:
+	int32_t minExposure_;
+	int32_t maxExposure_;
+	double minGain_;
+	double maxGain_;
+
+	bool aeEnabled_;
+	int32_t manualExposure_;
+	double manualGain_;
+};
+
+int IPAVirtual::init(const IPASettings &settings,
+		     const ControlInfoMap &sensorControls)
+{
+	LOG(IPAVirtual, Debug)
+		<< "Initializing virtual IPA for sensor " << settings.sensorModel;
+
+	auto exposure = sensorControls.find(&controls::ExposureTime);
+	auto gain = sensorControls.find(&controls::AnalogueGain);
+	if (exposure == sensorControls.end() || gain == sensorControls.end()) {
+		LOG(IPAVirtual, Error) << "Missing sensor controls";
+		return -EINVAL;
+	}
+
+	minExposure_ = exposure->second.min().get<int32_t>();
+	maxExposure_ = exposure->second.max().get<int32_t>();
+	minGain_ = gain->second.min().get<float>();
+	maxGain_ = gain->second.max().get<float>();
+
+	return 0;
+}
+
+int IPAVirtual::configure(const IPACameraSensorInfo &sensorInfo)
+{
+	if (!sensorInfo.pixelRate)
+		return -EINVAL;
+
+	/* Limit the exposure time to the frame duration. */
+	uint64_t frameDuration = static_cast<uint64_t>(sensorInfo.minLineLength) *
+				 sensorInfo.minFrameLength * 1000000 /
+				 sensorInfo.pixelRate;
+	maxExposure_ = std::clamp<int64_t>(frameDuration, minExposure_,
+					   maxExposure_);
+
+	LOG(IPAVirtual, Debug)
+		<< "Configured for " << sensorInfo.outputSize
+		<< ", exposure limits [" << minExposure_ << ", " << maxExposure_
+		<< "]";
+
+	return 0;
+}
+
+int IPAVirtual::start()
+{
+	aeEnabled_ = true;
+	manualExposure_ = minExposure_;
+	manualGain_ = minGain_;
+
+	return 0;
+}
+
+void IPAVirtual::stop()
+{
+}
+
+void IPAVirtual::queueRequest([[maybe_unused]] uint32_t frame,
+			      const ControlList &controls)
+{
+	const auto &aeEnable = controls.get(controls::AeEnable);
+	if (aeEnable)
+		aeEnabled_ = *aeEnable;
+
+	const auto &exposure = controls.get(controls::ExposureTime);
+	if (exposure)
+		manualExposure_ = std::clamp(*exposure, minExposure_, maxExposure_);
+
+	const auto &gain = controls.get(controls::AnalogueGain);
+	if (gain)
+		manualGain_ = std::clamp<double>(*gain, minGain_, maxGain_);
+}
+
+void IPAVirtual::processFrame(uint32_t frame, const ControlList &sensorControls)
+{
+	int32_t exposure = sensorControls.get(controls::ExposureTime).value_or(minExposure_);
+	double gain = sensorControls.get(controls::AnalogueGain).value_or(minGain_);
+	double luminance = std::min(exposure * gain * kSceneBrightness, 1.0);
+	bool locked = std::abs(luminance / kTargetLuminance - 1.0) < kLockTolerance;
+
+	if (aeEnabled_) {
+		double current = exposure * gain;
+		double target = luminance > 0 ? current * kTargetLuminance / luminance
+					      : maxExposure_ * maxGain_;
+		double total = current + (target - current) * kSpeed;
+
+		exposure = std::clamp<int32_t>(std::lround(total / minGain_),
+					       minExposure_, maxExposure_);
+		gain = std::clamp(total / exposure, minGain_, maxGain_);
+	} else {
+		exposure = manualExposure_;
+		gain = manualGain_;
+	}
+
+	ControlList ctrls(controls::controls);
+	ctrls.set(controls::ExposureTime, exposure);
+	ctrls.set(controls::AnalogueGain, static_cast<float>(gain));
+	setSensorControls.emit(frame, ctrls);
+
+	ControlList metadata(controls::controls);
+	metadata.set(controls::AeLocked, aeEnabled_ && locked);
+	metadata.set(controls::Lux, static_cast<float>(luminance * 400));
+	metadataReady.emit(frame, metadata);
+}
+
+/*
+ * External IPA module interface
+ */
+
+extern "C" {
+const struct IPAModuleInfo ipaModuleInfo = {
+	IPA_MODULE_API_VERSION,
+	0,
+	"virtual",
+	"virtual",
+};
+
+IPAInterface *ipaCreate()
+{
+	return new IPAVirtual();
+}
+}
+
+} /* namespace libcamera */
@@ -6,7 +6,12 @@
  */
 
 #include <libcamera/base/bound_method.h>
+
+#include <array>
+#include <new>
+
 #include <libcamera/base/message.h>
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
 #include <libcamera/base/semaphore.h>
 #include <libcamera/base/thread.h>
@@ -18,6 +23,113 @@
 
 namespace libcamera {
 
+namespace details {
+
+namespace {
+
+/*
+ * Cross-thread method invocations allocate their bound method, argument pack
+ * and message in the sender's thread, and free them in the receiver's thread.
+ * Recycle the blocks through free lists shared by all threads, one per block
+ * size, to avoid going through the heap for every invocation in steady state.
+ * The number of free blocks kept in each list is bounded to return memory to
+ * the heap after bursts.
+ */
+class BlockPool
+{
+public:
+	void *allocate(std::size_t size)
+	{
+		{
+			MutexLocker locker(mutex_);
+
+			if (free_) {
+				FreeBlock *block = free_;
+				free_ = block->next;
+				count_--;
+				return block;
+			}
+		}
+
+		return ::operator new(size);
+	}
+
+	void deallocate(void *ptr)
+	{
+		{
+			MutexLocker locker(mutex_);
+
+			if (count_ < kMaxFreeBlocks) {
+				FreeBlock *block = static_cast<FreeBlock *>(ptr);
+				block->next = free_;
+				free_ = block;
+				count_++;
+				return;
+			}
+		}
+
+		::operator delete(ptr);
+	}
+
+private:
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	static constexpr unsigned int kMaxFreeBlocks = 64;
+
+	Mutex mutex_;
+	FreeBlock *free_ LIBCAMERA_TSA_GUARDED_BY(mutex_) = nullptr;
+	unsigned int count_ LIBCAMERA_TSA_GUARDED_BY(mutex_) = 0;
+};
+
+constexpr std::array<std::size_t, 4> kBlockSizes = { 64, 128, 256, 512 };
+
+unsigned int blockSizeIndex(std::size_t size)
+{
+	unsigned int index = 0;
+
+	while (index < kBlockSizes.size() && size > kBlockSizes[index])
+		index++;
+
+	return index;
+}
+
+BlockPool &blockPool(unsigned int index)
+{
+	/*
+	 * The pools are never destroyed, as blocks may be released by objects
+	 * destroyed after the static objects of this file.
+	 */
+	static BlockPool *pools = new BlockPool[kBlockSizes.size()];
+
+	return pools[index];
+}
+
+} /* namespace */
+
+void *MemoryPool::allocate(std::size_t size)
+{
+	unsigned int index = blockSizeIndex(size);
+	if (index == kBlockSizes.size())
+		return ::operator new(size);
+
+	return blockPool(index).allocate(kBlockSizes[index]);
+}
+
+void MemoryPool::deallocate(void *ptr, std::size_t size) noexcept
+{
+	unsigned int index = blockSizeIndex(size);
+	if (index == kBlockSizes.size()) {
+		::operator delete(ptr);
+		return;
+	}
+
+	blockPool(index).deallocate(ptr);
+}
+
+} /* namespace details */
+
 /**
  * \enum ConnectionType
  * \brief Connection type for asynchronous communication
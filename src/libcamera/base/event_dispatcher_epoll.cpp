@@ -0,0 +1,380 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Epoll-based event dispatcher
+ */
+
+#include <libcamera/base/event_dispatcher_epoll.h>
+
+#include <array>
+#include <chrono>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libcamera/base/event_notifier.h>
+#include <libcamera/base/log.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+/**
+ * \file base/event_dispatcher_epoll.h
+ */
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(Event)
+
+namespace {
+
+/* Maximum number of events retrieved from the epoll instance at once */
+constexpr unsigned int kMaxEvents = 32;
+
+const char *notifierType(EventNotifier::Type type)
+{
+	if (type == EventNotifier::Read)
+		return "read";
+	if (type == EventNotifier::Write)
+		return "write";
+	if (type == EventNotifier::Exception)
+		return "exception";
+
+	return "";
+}
+
+} /* namespace */
+
+/**
+ * \class EventDispatcherEpoll
+ * \brief An epoll-based event dispatcher
+ *
+ * The event dispatcher keeps the file descriptors of all registered event
+ * notifiers in an epoll instance, and only updates it when notifiers are
+ * registered or unregistered. Timers are stored in a TimerQueue, and a timerfd
+ * is armed with the earliest deadline. The cost of waiting for events is thus
+ * independent of the number of registered notifiers and timers.
+ *
+ * This is the default event dispatcher. The EventDispatcherPoll can be selected
+ * instead by setting the LIBCAMERA_EVENT_DISPATCHER environment variable to
+ * "poll".
+ */
+
+EventDispatcherEpoll::EventDispatcherEpoll()
+	: processingEvents_(false)
+{
+	/*
+	 * Create the epoll instance, event fd and timer fd. Failures are fatal
+	 * as we can't implement an interruptible dispatcher without them.
+	 */
+	epollfd_ = UniqueFD(epoll_create1(EPOLL_CLOEXEC));
+	if (!epollfd_.isValid())
+		LOG(Event, Fatal) << "Unable to create epoll instance";
+
+	eventfd_ = UniqueFD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	if (!eventfd_.isValid())
+		LOG(Event, Fatal) << "Unable to create eventfd";
+
+	/*
+	 * The timer deadlines are expressed with utils::clock, which is
+	 * std::chrono::steady_clock, based on CLOCK_MONOTONIC.
+	 */
+	timerfd_ = UniqueFD(timerfd_create(CLOCK_MONOTONIC,
+					   TFD_CLOEXEC | TFD_NONBLOCK));
+	if (!timerfd_.isValid())
+		LOG(Event, Fatal) << "Unable to create timerfd";
+
+	for (int fd : { eventfd_.get(), timerfd_.get() }) {
+		struct epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = fd;
+
+		if (epoll_ctl(epollfd_.get(), EPOLL_CTL_ADD, fd, &event) < 0)
+			LOG(Event, Fatal)
+				<< "Unable to add fd " << fd
+				<< " to epoll instance: " << strerror(errno);
+	}
+}
+
+EventDispatcherEpoll::~EventDispatcherEpoll()
+{
+}
+
+void EventDispatcherEpoll::registerEventNotifier(EventNotifier *notifier)
+{
+	EventNotifierSetEpoll &set = notifiers_[notifier->fd()];
+	EventNotifier::Type type = notifier->type();
+
+	if (set.notifiers[type] && set.notifiers[type] != notifier) {
+		LOG(Event, Warning)
+			<< "Ignoring duplicate " << notifierType(type)
+			<< " notifier for fd " << notifier->fd();
+		return;
+	}
+
+	uint32_t oldEvents = set.events();
+	set.notifiers[type] = notifier;
+	updateNotifiers(notifier->fd(), oldEvents, set.events());
+}
+
+void EventDispatcherEpoll::unregisterEventNotifier(EventNotifier *notifier)
+{
+	auto iter = notifiers_.find(notifier->fd());
+	if (iter == notifiers_.end())
+		return;
+
+	EventNotifierSetEpoll &set = iter->second;
+	EventNotifier::Type type = notifier->type();
+
+	if (!set.notifiers[type])
+		return;
+
+	if (set.notifiers[type] != notifier) {
+		LOG(Event, Warning)
+			<< notifierType(type) << " notifier for fd "
+			<< notifier->fd() << " is not registered";
+		return;
+	}
+
+	uint32_t oldEvents = set.events();
+	set.notifiers[type] = nullptr;
+	updateNotifiers(notifier->fd(), oldEvents, set.events());
+
+	/*
+	 * Don't race with event processing if this function is called from an
+	 * event notifier. The notifiers_ entry will be erased by
+	 * processNotifiers().
+	 */
+	if (processingEvents_)
+		return;
+
+	if (!set.notifiers[0] && !set.notifiers[1] && !set.notifiers[2])
+		notifiers_.erase(iter);
+}
+
+void EventDispatcherEpoll::registerTimer(Timer *timer)
+{
+	timers_.insert(timer);
+}
+
+void EventDispatcherEpoll::unregisterTimer(Timer *timer)
+{
+	timers_.remove(timer);
+}
+
+void EventDispatcherEpoll::processEvents()
+{
+	std::array<struct epoll_event, kMaxEvents> events;
+	int ret;
+
+	Thread::current()->dispatchMessages();
+
+	armTimer();
+
+	/* Wait for events and process notifiers and timers. */
+	do {
+		ret = epoll_wait(epollfd_.get(), events.data(), events.size(), -1);
+	} while (ret == -1 && errno == EINTR);
+
+	if (ret < 0) {
+		ret = -errno;
+		LOG(Event, Warning) << "epoll_wait() failed with " << strerror(-ret);
+	}
+
+	for (int i = 0; i < ret; i++) {
+		const struct epoll_event &event = events[i];
+
+		if (event.data.fd == eventfd_.get())
+			processInterrupt();
+		else if (event.data.fd == timerfd_.get())
+			processTimerExpiry();
+		else
+			processNotifiers(event.data.fd, event.events);
+	}
+
+	processTimers();
+}
+
+void EventDispatcherEpoll::interrupt()
+{
+	uint64_t value = 1;
+	ssize_t ret = write(eventfd_.get(), &value, sizeof(value));
+	if (ret != sizeof(value)) {
+		if (ret < 0)
+			ret = -errno;
+		LOG(Event, Error)
+			<< "Failed to interrupt event dispatcher ("
+			<< ret << ")";
+	}
+}
+
+uint32_t EventDispatcherEpoll::EventNotifierSetEpoll::events() const
+{
+	uint32_t events = 0;
+
+	if (notifiers[EventNotifier::Read])
+		events |= EPOLLIN;
+	if (notifiers[EventNotifier::Write])
+		events |= EPOLLOUT;
+	if (notifiers[EventNotifier::Exception])
+		events |= EPOLLPRI;
+
+	return events;
+}
+
+void EventDispatcherEpoll::updateNotifiers(int fd, uint32_t oldEvents,
+					   uint32_t newEvents)
+{
+	if (oldEvents == newEvents)
+		return;
+
+	struct epoll_event event = {};
+	event.events = newEvents;
+	event.data.fd = fd;
+
+	int op = !oldEvents ? EPOLL_CTL_ADD
+	       : !newEvents ? EPOLL_CTL_DEL
+	       : EPOLL_CTL_MOD;
+
+	int ret = epoll_ctl(epollfd_.get(), op, fd, &event);
+
+	/*
+	 * Closing a file descriptor removes it from the epoll instance. If the
+	 * notifiers weren't unregistered before closing, the file descriptor
+	 * number may have been reused, and needs to be added again.
+	 */
+	if (ret < 0 && errno == ENOENT && op == EPOLL_CTL_MOD) {
+		op = EPOLL_CTL_ADD;
+		ret = epoll_ctl(epollfd_.get(), op, fd, &event);
+	}
+
+	if (ret == 0)
+		return;
+
+	/* Removing a file descriptor that has already been closed is fine. */
+	if (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT))
+		return;
+
+	LOG(Event, Error)
+		<< "Failed to update notifiers for fd " << fd << ": "
+		<< strerror(errno);
+}
+
+void EventDispatcherEpoll::armTimer()
+{
+	/* A default-constructed time point denotes a disarmed timerfd. */
+	utils::time_point deadline = !timers_.empty()
+				   ? timers_.deadline()
+				   : utils::time_point();
+	if (deadline == armedDeadline_)
+		return;
+
+	struct itimerspec spec = {};
+
+	if (!timers_.empty()) {
+		spec.it_value = utils::duration_to_timespec(deadline.time_since_epoch());
+
+		/* A zero value would disarm the timerfd. */
+		if (!spec.it_value.tv_sec && !spec.it_value.tv_nsec)
+			spec.it_value.tv_nsec = 1;
+
+		LOG(Event, Debug)
+			<< "next timer " << timers_.front()
+			<< " expires at " << utils::time_point_to_string(deadline);
+	}
+
+	if (timerfd_settime(timerfd_.get(), TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+		LOG(Event, Error)
+			<< "Failed to arm timerfd: " << strerror(errno);
+		return;
+	}
+
+	armedDeadline_ = deadline;
+}
+
+void EventDispatcherEpoll::processInterrupt()
+{
+	uint64_t value;
+	ssize_t ret = read(eventfd_.get(), &value, sizeof(value));
+	if (ret != sizeof(value)) {
+		if (ret < 0)
+			ret = -errno;
+		LOG(Event, Error)
+			<< "Failed to process interrupt (" << ret << ")";
+	}
+}
+
+void EventDispatcherEpoll::processTimerExpiry()
+{
+	uint64_t expirations;
+	ssize_t ret = read(timerfd_.get(), &expirations, sizeof(expirations));
+	if (ret != sizeof(expirations) && errno != EAGAIN) {
+		if (ret < 0)
+			ret = -errno;
+		LOG(Event, Error)
+			<< "Failed to process timer expiry (" << ret << ")";
+	}
+
+	/* The timerfd is disarmed once it expires. */
+	armedDeadline_ = utils::time_point();
+}
+
+void EventDispatcherEpoll::processNotifiers(int fd, uint32_t events)
+{
+	static const struct {
+		EventNotifier::Type type;
+		uint32_t events;
+	} types[] = {
+		{ EventNotifier::Read, EPOLLIN },
+		{ EventNotifier::Write, EPOLLOUT },
+		{ EventNotifier::Exception, EPOLLPRI },
+	};
+
+	/*
+	 * The notifiers may have been unregistered by a notifier processed
+	 * earlier in the same batch of events.
+	 */
+	auto iter = notifiers_.find(fd);
+	if (iter == notifiers_.end())
+		return;
+
+	EventNotifierSetEpoll &set = iter->second;
+
+	processingEvents_ = true;
+
+	for (const auto &type : types) {
+		EventNotifier *notifier = set.notifiers[type.type];
+
+		if (notifier && (events & type.events))
+			notifier->activated.emit();
+	}
+
+	processingEvents_ = false;
+
+	/* Erase the notifiers_ entry if it is now empty. */
+	if (!set.notifiers[0] && !set.notifiers[1] && !set.notifiers[2])
+		notifiers_.erase(iter);
+}
+
+void EventDispatcherEpoll::processTimers()
+{
+	utils::time_point now = utils::clock::now();
+
+	while (!timers_.empty()) {
+		if (timers_.deadline() > now)
+			break;
+
+		Timer *timer = timers_.front();
+		timers_.remove(timer);
+
+		timer->stop();
+		timer->timeout.emit();
+	}
+}
+
+} /* namespace libcamera */
@@ -113,31 +113,12 @@ void EventDispatcherPoll::unregisterEventNotifier(EventNotifier *notifier)
 
 void EventDispatcherPoll::registerTimer(Timer *timer)
 {
-	for (auto iter = timers_.begin(); iter != timers_.end(); ++iter) {
-		if ((*iter)->deadline() > timer->deadline()) {
-			timers_.insert(iter, timer);
-			return;
-		}
-	}
-
-	timers_.push_back(timer);
+	timers_.insert(timer);
 }
 
 void EventDispatcherPoll::unregisterTimer(Timer *timer)
 {
-	for (auto iter = timers_.begin(); iter != timers_.end(); ++iter) {
-		if (*iter == timer) {
-			timers_.erase(iter);
-			return;
-		}
-
-		/*
-		 * As the timers list is ordered, we can stop as soon as we go
-		 * past the deadline.
-		 */
-		if ((*iter)->deadline() > timer->deadline())
-			break;
-	}
+	timers_.remove(timer);
 }
 
 void EventDispatcherPoll::processEvents()
@@ -208,8 +189,8 @@ int EventDispatcherPoll::poll(std::vector<struct pollfd> *pollfds)
 	if (nextTimer) {
 		utils::time_point now = utils::clock::now();
 
-		if (nextTimer->deadline() > now)
-			timeout = utils::duration_to_timespec(nextTimer->deadline() - now);
+		if (timers_.deadline() > now)
+			timeout = utils::duration_to_timespec(timers_.deadline() - now);
 		else
 			timeout = { 0, 0 };
 
@@ -294,11 +275,11 @@ void EventDispatcherPoll::processTimers()
 	utils::time_point now = utils::clock::now();
 
 	while (!timers_.empty()) {
-		Timer *timer = timers_.front();
-		if (timer->deadline() > now)
+		if (timers_.deadline() > now)
 			break;
 
-		timers_.pop_front();
+		Timer *timer = timers_.front();
+		timers_.remove(timer);
 		timer->stop();
 		timer->timeout.emit();
 	}
@@ -8,15 +8,21 @@
 #include <libcamera/base/log.h>
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
+#include <thread>
 #include <time.h>
 #include <unordered_set>
+#include <vector>
 
 #include <libcamera/logging.h>
 
@@ -52,6 +58,10 @@
  * of the file. The file must be writable and is truncated if it exists. If any
  * error occurs when opening the file, the file is ignored and the log is output
  * to std::cerr.
+ *
+ * Writing log messages to the output is synchronous by default. Setting the
+ * LIBCAMERA_LOG_ASYNC environment variable moves the output I/O to a background
+ * thread, which avoids stalling the logging threads on slow log destinations.
  */
 
 /**
@@ -97,6 +107,8 @@ static const char *log_severity_name(LogSeverity severity)
 		return "UNKWN";
 }
 
+class AsyncLogWriter;
+
 /**
  * \brief Log output
  *
@@ -114,15 +126,435 @@ public:
 	void write(const LogMessage &msg);
 	void write(const std::string &msg);
 
+	void startAsync();
+	void flush();
+
 private:
+	friend class AsyncLogWriter;
+
+	void output(LogSeverity severity, const std::string &msg);
+	void writeDirect(LogSeverity severity, const std::string &msg);
 	void writeSyslog(LogSeverity severity, const std::string &msg);
 	void writeStream(const std::string &msg);
 
 	std::ostream *stream_;
 	LoggingTarget target_;
 	bool color_;
+
+	std::unique_ptr<AsyncLogWriter> async_;
 };
 
+/**
+ * \brief Asynchronous log writer
+ *
+ * The AsyncLogWriter moves the I/O of a LogOutput to a background thread. Each
+ * thread that logs messages owns a lock-free single-producer single-consumer
+ * ring buffer of bounded size, to which it copies the formatted messages. The
+ * writer thread drains the ring buffers in the order in which the messages
+ * have been logged, and writes them to the log output.
+ *
+ * Messages that don't fit in the ring buffer of the logging thread are
+ * dropped, and the number of dropped messages is reported in the log.
+ */
+class AsyncLogWriter
+{
+public:
+	AsyncLogWriter(LogOutput *output);
+	~AsyncLogWriter();
+
+	void write(LogSeverity severity, const std::string &msg);
+	void flush();
+
+private:
+	class Ring;
+	using RingList = std::vector<std::shared_ptr<Ring>>;
+
+	Ring *threadRing();
+	void wakeUp();
+
+	void run();
+	bool writeMessages(const RingList &rings);
+	static bool hasMessages(const RingList &rings);
+
+	static std::atomic<uint64_t> nextId_;
+
+	LogOutput *output_;
+	const uint64_t id_;
+
+	std::atomic<uint64_t> sequence_;
+	std::atomic<uint64_t> queued_;
+	std::atomic<uint64_t> written_;
+	std::atomic<unsigned int> dropped_;
+	std::atomic<bool> idle_;
+
+	Mutex mutex_;
+	ConditionVariable cv_;
+	RingList rings_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	bool ringsChanged_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	bool stop_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
+	std::string buffer_;
+	std::thread thread_;
+};
+
+/**
+ * \brief Ring buffer of log messages
+ *
+ * The ring buffer stores a header for each message followed by the message
+ * text. It is written by the logging thread that owns it and read by the
+ * writer thread only, and is synchronized through the head and tail indices.
+ */
+class AsyncLogWriter::Ring
+{
+public:
+	struct Header {
+		uint64_t sequence;
+		uint32_t size;
+		LogSeverity severity;
+	};
+
+	Ring()
+		: buffer_(std::make_unique<uint8_t[]>(kSize)), head_(0), tail_(0),
+		  orphaned_(false)
+	{
+	}
+
+	bool push(const Header &header, const char *data);
+	bool front(Header *header) const;
+	void pop(const Header &header, std::string *data);
+
+	bool empty() const
+	{
+		return head_.load(std::memory_order_acquire) ==
+		       tail_.load(std::memory_order_relaxed);
+	}
+
+	bool isOrphaned() const { return orphaned_.load(std::memory_order_acquire); }
+	void setOrphaned() { orphaned_.store(true, std::memory_order_release); }
+
+private:
+	static constexpr size_t kSize = 64 * 1024;
+
+	void copyIn(size_t pos, const void *data, size_t size);
+	void copyOut(size_t pos, void *data, size_t size) const;
+
+	std::unique_ptr<uint8_t[]> buffer_;
+	std::atomic<size_t> head_;
+	std::atomic<size_t> tail_;
+	std::atomic<bool> orphaned_;
+};
+
+/**
+ * \brief Copy a message to the ring buffer
+ * \param[in] header The message header
+ * \param[in] data The message text, of header.size bytes
+ *
+ * This function shall only be called by the thread that owns the ring buffer.
+ *
+ * \return True if the message has been copied, false if the ring buffer is full
+ */
+bool AsyncLogWriter::Ring::push(const Header &header, const char *data)
+{
+	size_t head = head_.load(std::memory_order_relaxed);
+	size_t tail = tail_.load(std::memory_order_acquire);
+	size_t size = sizeof(header) + header.size;
+
+	if (size > kSize - (head - tail))
+		return false;
+
+	copyIn(head, &header, sizeof(header));
+	copyIn(head + sizeof(header), data, header.size);
+
+	head_.store(head + size, std::memory_order_release);
+
+	return true;
+}
+
+/**
+ * \brief Retrieve the header of the oldest message in the ring buffer
+ * \param[out] header The message header
+ *
+ * This function shall only be called by the writer thread.
+ *
+ * \return True if a message is available, false if the ring buffer is empty
+ */
+bool AsyncLogWriter::Ring::front(Header *header) const
+{
+	size_t tail = tail_.load(std::memory_order_relaxed);
+	size_t head = head_.load(std::memory_order_acquire);
+
+	if (head == tail)
+		return false;
+
+	copyOut(tail, header, sizeof(*header));
+	return true;
+}
+
+/**
+ * \brief Remove the oldest message from the ring buffer
+ * \param[in] header The message header, as returned by front()
+ * \param[out] data The message text
+ *
+ * This function shall only be called by the writer thread.
+ */
+void AsyncLogWriter::Ring::pop(const Header &header, std::string *data)
+{
+	size_t tail = tail_.load(std::memory_order_relaxed);
+
+	data->resize(header.size);
+	copyOut(tail + sizeof(header), data->data(), header.size);
+
+	tail_.store(tail + sizeof(header) + header.size,
+		    std::memory_order_release);
+}
+
+void AsyncLogWriter::Ring::copyIn(size_t pos, const void *data, size_t size)
+{
+	const uint8_t *src = static_cast<const uint8_t *>(data);
+	size_t offset = pos % kSize;
+	size_t first = std::min(size, kSize - offset);
+
+	memcpy(buffer_.get() + offset, src, first);
+	memcpy(buffer_.get(), src + first, size - first);
+}
+
+void AsyncLogWriter::Ring::copyOut(size_t pos, void *data, size_t size) const
+{
+	uint8_t *dst = static_cast<uint8_t *>(data);
+	size_t offset = pos % kSize;
+	size_t first = std::min(size, kSize - offset);
+
+	memcpy(dst, buffer_.get() + offset, first);
+	memcpy(dst + first, buffer_.get(), size - first);
+}
+
+std::atomic<uint64_t> AsyncLogWriter::nextId_ = 1;
+
+/**
+ * \brief Construct an asynchronous writer for a log \a output
+ * \param[in] output The log output
+ */
+AsyncLogWriter::AsyncLogWriter(LogOutput *output)
+	: output_(output), id_(nextId_++), sequence_(0), queued_(0),
+	  written_(0), dropped_(0), idle_(false), ringsChanged_(false),
+	  stop_(false)
+{
+	thread_ = std::thread(&AsyncLogWriter::run, this);
+}
+
+/**
+ * \brief Write all queued messages and stop the writer thread
+ */
+AsyncLogWriter::~AsyncLogWriter()
+{
+	{
+		MutexLocker locker(mutex_);
+		stop_ = true;
+	}
+
+	cv_.notify_one();
+	thread_.join();
+}
+
+/**
+ * \brief Queue a message for writing
+ * \param[in] severity The message severity
+ * \param[in] msg The formatted message
+ */
+void AsyncLogWriter::write(LogSeverity severity, const std::string &msg)
+{
+	Ring *ring = threadRing();
+	Ring::Header header = {
+		sequence_.fetch_add(1, std::memory_order_relaxed),
+		static_cast<uint32_t>(msg.size()),
+		severity,
+	};
+
+	if (msg.size() > UINT32_MAX || !ring->push(header, msg.data())) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	queued_.fetch_add(1, std::memory_order_release);
+	wakeUp();
+}
+
+/**
+ * \brief Wait for all messages queued so far to be written
+ *
+ * The wait is bounded to one second, to avoid blocking forever if the writer
+ * thread is stuck on the log output.
+ */
+void AsyncLogWriter::flush()
+{
+	uint64_t queued = queued_.load(std::memory_order_acquire);
+
+	wakeUp();
+
+	for (unsigned int i = 0; i < 1000; i++) {
+		if (written_.load(std::memory_order_acquire) >= queued)
+			return;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+/**
+ * \brief Retrieve the ring buffer of the calling thread
+ *
+ * The ring buffer is created and registered with the writer the first time a
+ * thread logs a message. It is marked as orphaned when the thread exits, and
+ * released by the writer thread once drained.
+ *
+ * \return The ring buffer of the calling thread
+ */
+AsyncLogWriter::Ring *AsyncLogWriter::threadRing()
+{
+	struct ThreadRing {
+		~ThreadRing()
+		{
+			if (ring)
+				ring->setOrphaned();
+		}
+
+		uint64_t writer = 0;
+		std::shared_ptr<Ring> ring;
+	};
+
+	thread_local ThreadRing threadRing;
+
+	if (threadRing.writer == id_)
+		return threadRing.ring.get();
+
+	if (threadRing.ring)
+		threadRing.ring->setOrphaned();
+
+	threadRing.ring = std::make_shared<Ring>();
+	threadRing.writer = id_;
+
+	MutexLocker locker(mutex_);
+	rings_.push_back(threadRing.ring);
+	ringsChanged_ = true;
+
+	return threadRing.ring.get();
+}
+
+void AsyncLogWriter::wakeUp()
+{
+	if (!idle_.load())
+		return;
+
+	MutexLocker locker(mutex_);
+	cv_.notify_one();
+}
+
+void AsyncLogWriter::run()
+{
+	RingList rings;
+
+	while (true) {
+		{
+			MutexLocker locker(mutex_);
+
+			/* Release the ring buffers of exited threads. */
+			for (auto iter = rings_.begin(); iter != rings_.end();) {
+				if ((*iter)->isOrphaned() && (*iter)->empty()) {
+					iter = rings_.erase(iter);
+					ringsChanged_ = true;
+				} else {
+					++iter;
+				}
+			}
+
+			if (ringsChanged_) {
+				rings = rings_;
+				ringsChanged_ = false;
+			}
+		}
+
+		if (writeMessages(rings))
+			continue;
+
+		MutexLocker locker(mutex_);
+
+		if (stop_)
+			break;
+
+		/*
+		 * Check for messages after setting the idle flag, to avoid
+		 * missing the wake up of a thread that has queued a message
+		 * after the ring buffers have been drained.
+		 */
+		idle_.store(true);
+
+		cv_.wait_for(locker, std::chrono::milliseconds(100),
+			     [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+				     return stop_ || ringsChanged_ || hasMessages(rings);
+			     });
+
+		idle_.store(false);
+	}
+
+	/* Write the messages queued before stopping. */
+	writeMessages(rings);
+}
+
+/**
+ * \brief Write the queued messages to the log output
+ * \param[in] rings The ring buffers
+ *
+ * Messages are written in the order in which they have been queued, across all
+ * ring buffers.
+ *
+ * \return True if any message has been written, false otherwise
+ */
+bool AsyncLogWriter::writeMessages(const RingList &rings)
+{
+	bool written = false;
+
+	while (true) {
+		Ring *next = nullptr;
+		Ring::Header nextHeader;
+
+		for (const std::shared_ptr<Ring> &ring : rings) {
+			Ring::Header header;
+
+			if (!ring->front(&header))
+				continue;
+
+			if (!next || header.sequence < nextHeader.sequence) {
+				next = ring.get();
+				nextHeader = header;
+			}
+		}
+
+		if (!next)
+			break;
+
+		next->pop(nextHeader, &buffer_);
+		output_->writeDirect(nextHeader.severity, buffer_);
+		written_.fetch_add(1, std::memory_order_release);
+		written = true;
+	}
+
+	unsigned int dropped = dropped_.exchange(0, std::memory_order_relaxed);
+	if (dropped)
+		output_->writeDirect(LogWarning, std::to_string(dropped) +
+					   " log messages dropped\n");
+
+	return written;
+}
+
+bool AsyncLogWriter::hasMessages(const RingList &rings)
+{
+	for (const std::shared_ptr<Ring> &ring : rings) {
+		if (!ring->empty())
+			return true;
+	}
+
+	return false;
+}
+
 /**
  * \brief Construct a log output based on a file
  * \param[in] path Full path to log file
@@ -155,6 +587,9 @@ LogOutput::LogOutput()
 
 LogOutput::~LogOutput()
 {
+	/* Write the pending messages before closing the output. */
+	async_.reset();
+
 	switch (target_) {
 	case LoggingTargetFile:
 		delete stream_;
@@ -237,7 +672,7 @@ void LogOutput::write(const LogMessage &msg)
 		if (!msg.prefix().empty())
 			str += msg.prefix() + ": ";
 		str += msg.msg();
-		writeSyslog(severity, str);
+		output(severity, str);
 		break;
 	case LoggingTargetStream:
 	case LoggingTargetFile:
@@ -249,7 +684,7 @@ void LogOutput::write(const LogMessage &msg)
 		if (!msg.prefix().empty())
 			str += prefixColor + msg.prefix() + ": ";
 		str += resetColor + msg.msg();
-		writeStream(str);
+		output(severity, str);
 		break;
 	default:
 		break;
@@ -261,10 +696,48 @@ void LogOutput::write(const LogMessage &msg)
  * \param[in] str String to write
  */
 void LogOutput::write(const std::string &str)
+{
+	output(LogDebug, str);
+}
+
+/**
+ * \brief Write messages asynchronously
+ *
+ * Start a background thread that writes all subsequent messages to the log
+ * output.
+ */
+void LogOutput::startAsync()
+{
+	if (!async_)
+		async_ = std::make_unique<AsyncLogWriter>(this);
+}
+
+/**
+ * \brief Wait for all messages to be written to the log output
+ *
+ * When writing messages asynchronously, wait until all messages written so far
+ * have been written to the log output. Otherwise, this function performs no
+ * operation.
+ */
+void LogOutput::flush()
+{
+	if (async_)
+		async_->flush();
+}
+
+void LogOutput::output(LogSeverity severity, const std::string &str)
+{
+	if (async_)
+		async_->write(severity, str);
+	else
+		writeDirect(severity, str);
+}
+
+void LogOutput::writeDirect(LogSeverity severity, const std::string &str)
 {
 	switch (target_) {
 	case LoggingTargetSyslog:
-		writeSyslog(LogDebug, str);
+		writeSyslog(severity, str);
 		break;
 	case LoggingTargetStream:
 	case LoggingTargetFile:
@@ -309,6 +782,8 @@ public:
 private:
 	Logger();
 
+	void setOutput(std::shared_ptr<LogOutput> output);
+
 	void parseLogFile();
 	void parseLogLevels();
 	static LogSeverity parseLogLevel(const std::string &level);
@@ -323,6 +798,7 @@ private:
 	std::list<std::pair<std::string, LogSeverity>> levels_;
 
 	std::shared_ptr<LogOutput> output_;
+	bool async_;
 };
 
 bool Logger::destroyed_ = false;
@@ -470,6 +946,10 @@ void Logger::write(const LogMessage &msg)
 		return;
 
 	output->write(msg);
+
+	/* Make sure fatal messages reach the output before aborting. */
+	if (msg.severity() == LogFatal)
+		output->flush();
 }
 
 /**
@@ -488,11 +968,13 @@ void Logger::backtrace()
 	std::string backtrace = Backtrace().toString(2);
 	if (backtrace.empty()) {
 		output->write("Backtrace not available\n");
+		output->flush();
 		return;
 	}
 
 	output->write("Backtrace:\n");
 	output->write(backtrace);
+	output->flush();
 }
 
 /**
@@ -511,7 +993,7 @@ int Logger::logSetFile(const char *path, bool color)
 	if (!output->isValid())
 		return -EINVAL;
 
-	std::atomic_store(&output_, output);
+	setOutput(output);
 	return 0;
 }
 
@@ -528,7 +1010,7 @@ int Logger::logSetStream(std::ostream *stream, bool color)
 {
 	std::shared_ptr<LogOutput> output =
 		std::make_shared<LogOutput>(stream, color);
-	std::atomic_store(&output_, output);
+	setOutput(output);
 	return 0;
 }
 
@@ -544,7 +1026,7 @@ int Logger::logSetTarget(enum LoggingTarget target)
 {
 	switch (target) {
 	case LoggingTargetSyslog:
-		std::atomic_store(&output_, std::make_shared<LogOutput>());
+		setOutput(std::make_shared<LogOutput>());
 		break;
 	case LoggingTargetNone:
 		std::atomic_store(&output_, std::shared_ptr<LogOutput>());
@@ -577,6 +1059,21 @@ void Logger::logSetLevel(const char *category, const char *level)
 	}
 }
 
+/**
+ * \brief Set the log output
+ * \param[in] output The log output
+ *
+ * Messages are written asynchronously to the \a output if the
+ * LIBCAMERA_LOG_ASYNC environment variable is set.
+ */
+void Logger::setOutput(std::shared_ptr<LogOutput> output)
+{
+	if (async_)
+		output->startAsync();
+
+	std::atomic_store(&output_, output);
+}
+
 /**
  * \brief Construct a logger
  *
@@ -585,6 +1082,7 @@ void Logger::logSetLevel(const char *category, const char *level)
  * LIBCAMERA_LOG_NO_COLOR environment variable to disable coloring.
  */
 Logger::Logger()
+	: async_(utils::secure_getenv("LIBCAMERA_LOG_ASYNC") != nullptr)
 {
 	bool color = !utils::secure_getenv("LIBCAMERA_LOG_NO_COLOR");
 	logSetStream(&std::cerr, color);
@@ -1082,6 +1580,12 @@ LogMessage _log(const LogCategory *category, LogSeverity severity,
  * absent the default category is used. The  \a severity controls whether the
  * message is printed or discarded, depending on the log level for the category.
  *
+ * The log level is checked before constructing the message. When the message
+ * is discarded, the LOG() statement only costs a comparison, and the
+ * expressions streamed to it are not evaluated. Messages with a severity lower
+ * than the one selected by the log_min_severity build option are compiled out
+ * entirely.
+ *
  * If the severity is set to Fatal, execution is aborted and the program
  * terminates immediately after printing the message.
  *
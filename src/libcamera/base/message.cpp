@@ -59,7 +59,7 @@ std::atomic_uint Message::nextUserType_{ Message::UserMessage };
  * \param[in] type The message type
  */
 Message::Message(Message::Type type)
-	: type_(type)
+	: type_(type), receiver_(nullptr), next_(nullptr)
 {
 }
 
@@ -138,6 +138,32 @@ InvokeMessage::~InvokeMessage()
 		delete method_;
 }
 
+/**
+ * \brief Allocate memory for an InvokeMessage
+ * \param[in] size The allocation size
+ *
+ * Invoke messages are allocated for every queued or blocking method invocation
+ * across threads. They are allocated from a pool of recycled memory blocks
+ * shared with the bound methods and argument packs to avoid heap allocations
+ * in steady state.
+ *
+ * \return A pointer to the allocated memory
+ */
+void *InvokeMessage::operator new(std::size_t size)
+{
+	return details::MemoryPool::allocate(size);
+}
+
+/**
+ * \brief Free memory allocated for an InvokeMessage
+ * \param[in] ptr The memory to free
+ * \param[in] size The allocation size
+ */
+void InvokeMessage::operator delete(void *ptr, std::size_t size) noexcept
+{
+	details::MemoryPool::deallocate(ptr, size);
+}
+
 /**
  * \fn InvokeMessage::semaphore()
  * \brief Retrieve the message semaphore passed to the constructor
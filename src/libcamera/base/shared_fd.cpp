@@ -214,6 +214,17 @@ SharedFD &SharedFD::operator=(SharedFD &&other)
  * instance is invalid
  */
 
+/**
+ * \fn SharedFD::useCount()
+ * \brief Retrieve the number of SharedFD instances sharing the file descriptor
+ *
+ * The value is informative only when the caller can guarantee that no other
+ * thread creates or destroys references to the file descriptor concurrently.
+ *
+ * \return The number of SharedFD instances that share ownership of the file
+ * descriptor, or 0 if the SharedFD instance is invalid
+ */
+
 /**
  * \fn bool operator==(const SharedFD &lhs, const SharedFD &rhs)
  * \brief Compare the owned file descriptors of two SharedFD for equality
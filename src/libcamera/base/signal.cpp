@@ -7,6 +7,8 @@
 
 #include <libcamera/base/signal.h>
 
+#include <memory>
+
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
 
@@ -20,9 +22,8 @@ namespace libcamera {
 namespace {
 
 /*
- * Mutex to protect the SignalBase::slots_ and Object::signals_ lists. If lock
- * contention needs to be decreased, this could be replaced with locks in
- * Object and SignalBase, or with a mutex pool.
+ * Mutex to serialize modifications of the SignalBase::slots_ arrays and to
+ * protect the Object::signals_ lists. Emitting a signal doesn't take the lock.
  */
 Mutex signalsLock;
 
@@ -35,38 +36,62 @@ void SignalBase::connect(BoundMethodBase *slot)
 	Object *object = slot->object();
 	if (object)
 		object->connect(this);
-	slots_.push_back(slot);
+
+	auto slots = slots_ ? std::make_shared<SlotArray>(*slots_)
+			    : std::make_shared<SlotArray>();
+	slots->emplace_back(slot);
+
+	std::atomic_store(&slots_, std::shared_ptr<const SlotArray>(std::move(slots)));
 }
 
 void SignalBase::disconnect(Object *object)
 {
-	disconnect([object](SlotList::iterator &iter) {
-		return (*iter)->match(object);
+	disconnect([object](BoundMethodBase *slot) {
+		return slot->match(object);
 	});
 }
 
-void SignalBase::disconnect(std::function<bool(SlotList::iterator &)> match)
+void SignalBase::disconnect(std::function<bool(BoundMethodBase *)> match)
 {
 	MutexLocker locker(signalsLock);
 
-	for (auto iter = slots_.begin(); iter != slots_.end(); ) {
-		if (match(iter)) {
-			Object *object = (*iter)->object();
-			if (object)
-				object->disconnect(this);
+	if (!slots_)
+		return;
 
-			delete *iter;
-			iter = slots_.erase(iter);
-		} else {
-			++iter;
+	auto slots = std::make_shared<SlotArray>();
+	slots->reserve(slots_->size());
+
+	for (const std::shared_ptr<BoundMethodBase> &slot : *slots_) {
+		if (!match(slot.get())) {
+			slots->push_back(slot);
+			continue;
 		}
+
+		Object *object = slot->object();
+		if (object)
+			object->disconnect(this);
 	}
+
+	if (slots->size() == slots_->size())
+		return;
+
+	/*
+	 * The disconnected slots are deleted when the last reference to the
+	 * previous slots array is released, which may be by a concurrent or
+	 * in-progress emit() call.
+	 */
+	std::atomic_store(&slots_, slots->empty() ? nullptr
+			  : std::shared_ptr<const SlotArray>(std::move(slots)));
 }
 
-SignalBase::SlotList SignalBase::slots()
+/*
+ * Retrieve the connected slots. The slots array is replaced but never modified
+ * by connect() and disconnect(), it can thus be accessed without locking.
+ * Retrieving the slots doesn't allocate memory.
+ */
+std::shared_ptr<const SignalBase::SlotArray> SignalBase::slots() const
 {
-	MutexLocker locker(signalsLock);
-	return slots_;
+	return std::atomic_load(&slots_);
 }
 
 /**
@@ -198,6 +223,11 @@ SignalBase::SlotList SignalBase::slots()
  * of the arguments (when passed by pointer or reference), the modification is
  * thus visible to all subsequently called slots.
  *
+ * The slots called by an emission are the slots connected when the emission
+ * starts. Slots connected or disconnected in the meantime, including by the
+ * called slots themselves, only affect subsequent emissions. Emitting a signal
+ * doesn't take any lock or allocate memory for the slots.
+ *
  * This function is not \threadsafe, but thread-safety is guaranteed against
  * concurrent connect() and disconnect() calls.
  */
@@ -7,18 +7,28 @@
 
 #include <libcamera/base/thread.h>
 
+#include <algorithm>
 #include <atomic>
-#include <list>
+#include <errno.h>
+#include <optional>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/event_dispatcher_epoll.h>
 #include <libcamera/base/event_dispatcher_poll.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/message.h>
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
+#include <libcamera/base/utils.h>
 
 /**
  * \page thread Thread Support
@@ -115,14 +125,74 @@ class ThreadMain;
 
 /**
  * \brief A queue of posted messages
+ *
+ * Messages are posted to a lock-free stack, linked through Message::next_, to
+ * avoid locking and memory allocation when posting. The stack is moved to the
+ * list, in posting order, before accessing the list.
  */
 class MessageQueue
 {
 public:
+	~MessageQueue()
+	{
+		Message *msg = posted_.exchange(nullptr);
+		while (msg) {
+			Message *next = msg->next_;
+			delete msg;
+			msg = next;
+		}
+	}
+
+	/**
+	 * \brief Post a message, transferring its ownership to the queue
+	 * \param[in] msg The message
+	 *
+	 * \context This function is \threadsafe.
+	 *
+	 * \return True if no other posted message was waiting to be collected,
+	 * false otherwise
+	 */
+	bool post(Message *msg)
+	{
+		Message *head = posted_.load(std::memory_order_relaxed);
+
+		do {
+			msg->next_ = head;
+		} while (!posted_.compare_exchange_weak(head, msg,
+							std::memory_order_release,
+							std::memory_order_relaxed));
+
+		return !head;
+	}
+
+	/**
+	 * \brief Move the posted messages to the \ref list_
+	 *
+	 * This function shall be called with the \ref mutex_ held.
+	 */
+	void collect()
+	{
+		Message *msg = posted_.exchange(nullptr, std::memory_order_acquire);
+		if (!msg)
+			return;
+
+		/* The stack holds the most recently posted message first */
+		const size_t size = list_.size();
+		for (; msg; msg = msg->next_)
+			list_.emplace_back(msg);
+
+		std::reverse(list_.begin() + size, list_.end());
+	}
+
 	/**
 	 * \brief List of queued Message instances
+	 *
+	 * Entries are set to null when messages are dispatched or removed, and
+	 * erased by the outermost Thread::dispatchMessages() call. The storage
+	 * is reused, posting messages thus doesn't allocate memory in the
+	 * steady state.
 	 */
-	std::list<std::unique_ptr<Message>> list_;
+	std::vector<std::unique_ptr<Message>> list_;
 	/**
 	 * \brief Protects the \ref list_
 	 */
@@ -132,8 +202,162 @@ public:
 	 * calls
 	 */
 	unsigned int recursion_ = 0;
+
+private:
+	std::atomic<Message *> posted_{ nullptr };
 };
 
+namespace {
+
+struct ThreadScheduling {
+	Thread::SchedulingPolicy policy;
+	int priority;
+};
+
+int toCpuSet(const Span<const unsigned int> &cpus, cpu_set_t *cpuset)
+{
+	const unsigned int numCpus = std::thread::hardware_concurrency();
+
+	if (cpus.empty()) {
+		LOG(Thread, Error) << "Thread affinity requires at least one CPU";
+		return -EINVAL;
+	}
+
+	CPU_ZERO(cpuset);
+
+	for (unsigned int cpu : cpus) {
+		if (cpu >= CPU_SETSIZE || (numCpus && cpu >= numCpus)) {
+			LOG(Thread, Error)
+				<< "Invalid CPU " << cpu << " for thread affinity";
+			return -EINVAL;
+		}
+
+		CPU_SET(cpu, cpuset);
+	}
+
+	return 0;
+}
+
+int toThreadScheduling(Thread::SchedulingPolicy policy, int priority,
+		       ThreadScheduling *scheduling)
+{
+	int min;
+	int max;
+
+	switch (policy) {
+	case Thread::SchedulingPolicy::Normal:
+		min = -20;
+		max = 19;
+		break;
+	case Thread::SchedulingPolicy::Fifo:
+		min = sched_get_priority_min(SCHED_FIFO);
+		max = sched_get_priority_max(SCHED_FIFO);
+		break;
+	case Thread::SchedulingPolicy::RoundRobin:
+		min = sched_get_priority_min(SCHED_RR);
+		max = sched_get_priority_max(SCHED_RR);
+		break;
+	default:
+		LOG(Thread, Error) << "Invalid scheduling policy";
+		return -EINVAL;
+	}
+
+	if (priority < min || priority > max) {
+		LOG(Thread, Error)
+			<< "Invalid scheduling priority " << priority
+			<< ", valid range is [" << min << ", " << max << "]";
+		return -EINVAL;
+	}
+
+	scheduling->policy = policy;
+	scheduling->priority = priority;
+
+	return 0;
+}
+
+/*
+ * The default affinity and scheduling of the threads that don't set them
+ * explicitly, from the LIBCAMERA_THREAD_AFFINITY and LIBCAMERA_THREAD_SCHEDULING
+ * environment variables.
+ */
+struct ThreadDefaults {
+	ThreadDefaults();
+
+	std::optional<cpu_set_t> cpuset;
+	std::optional<ThreadScheduling> scheduling;
+};
+
+ThreadDefaults::ThreadDefaults()
+{
+	const char *affinity = utils::secure_getenv("LIBCAMERA_THREAD_AFFINITY");
+	if (affinity && *affinity) {
+		std::vector<unsigned int> cpus;
+		bool valid = true;
+
+		for (const std::string &cpu : utils::split(affinity, ",")) {
+			char *end;
+			unsigned long value = strtoul(cpu.c_str(), &end, 10);
+			if (cpu.empty() || *end != '\0') {
+				valid = false;
+				break;
+			}
+
+			cpus.push_back(value);
+		}
+
+		cpu_set_t set;
+		if (valid && !toCpuSet(cpus, &set))
+			cpuset = set;
+		else
+			LOG(Thread, Warning)
+				<< "Ignoring invalid thread affinity '"
+				<< affinity << "'";
+	}
+
+	const char *sched = utils::secure_getenv("LIBCAMERA_THREAD_SCHEDULING");
+	if (sched && *sched) {
+		static const std::pair<const char *, Thread::SchedulingPolicy> policies[] = {
+			{ "normal", Thread::SchedulingPolicy::Normal },
+			{ "fifo", Thread::SchedulingPolicy::Fifo },
+			{ "rr", Thread::SchedulingPolicy::RoundRobin },
+		};
+
+		const char *separator = strchr(sched, ':');
+		std::string name = separator ? std::string(sched, separator - sched)
+					     : std::string(sched);
+		bool valid = false;
+		ThreadScheduling value;
+
+		for (const auto &[policyName, policy] : policies) {
+			if (name != policyName)
+				continue;
+
+			char *end = nullptr;
+			long priority = separator ? strtol(separator + 1, &end, 10) : 0;
+			if (separator && (!separator[1] || *end != '\0'))
+				break;
+
+			valid = !toThreadScheduling(policy, priority, &value);
+			break;
+		}
+
+		if (valid)
+			scheduling = value;
+		else
+			LOG(Thread, Warning)
+				<< "Ignoring invalid thread scheduling '"
+				<< sched << "'";
+	}
+}
+
+const ThreadDefaults &threadDefaults()
+{
+	static const ThreadDefaults defaults;
+	return defaults;
+}
+
+} /* namespace */
+
 /**
  * \brief Thread-local internal data
  */
@@ -141,7 +365,7 @@ class ThreadData
 {
 public:
 	ThreadData()
-		: thread_(nullptr), running_(false), dispatcher_(nullptr)
+		: thread_(nullptr), running_(false), tid_(0), dispatcher_(nullptr)
 	{
 	}
 
@@ -151,10 +375,18 @@ private:
 	friend class Thread;
 	friend class ThreadMain;
 
+	int applyAffinity() LIBCAMERA_TSA_REQUIRES(mutex_);
+	int applyScheduling() LIBCAMERA_TSA_REQUIRES(mutex_);
+	void applyName(pthread_t thread) LIBCAMERA_TSA_REQUIRES(mutex_);
+
 	Thread *thread_;
 	bool running_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
 	pid_t tid_;
 
+	std::optional<cpu_set_t> cpuset_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::optional<ThreadScheduling> scheduling_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::string name_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
 	Mutex mutex_;
 
 	std::atomic<EventDispatcher *> dispatcher_;
@@ -206,6 +438,95 @@ ThreadData *ThreadData::current()
 	return data;
 }
 
+/**
+ * \brief Apply the CPU affinity to the thread
+ *
+ * The thread affinity set with Thread::setThreadAffinity() is applied if any,
+ * or the default affinity otherwise.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int ThreadData::applyAffinity()
+{
+	const std::optional<cpu_set_t> &cpuset = cpuset_ ? cpuset_
+						: threadDefaults().cpuset;
+	if (!cpuset)
+		return 0;
+
+	if (sched_setaffinity(tid_, sizeof(*cpuset), &*cpuset) < 0) {
+		int ret = -errno;
+		LOG(Thread, Error)
+			<< "Failed to set thread affinity: " << strerror(-ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Apply the name to the thread
+ * \param[in] thread The POSIX thread handle
+ *
+ * The name set with Thread::setThreadName() is applied if any. Failures are
+ * logged but otherwise ignored, as the name is only a debugging aid.
+ */
+void ThreadData::applyName(pthread_t thread)
+{
+	if (name_.empty())
+		return;
+
+	int ret = pthread_setname_np(thread, name_.c_str());
+	if (ret)
+		LOG(Thread, Warning)
+			<< "Failed to set thread name: " << strerror(ret);
+}
+
+/**
+ * \brief Apply the scheduling policy and priority to the thread
+ *
+ * The scheduling set with Thread::setSchedulingPolicy() is applied if any, or
+ * the default scheduling otherwise.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int ThreadData::applyScheduling()
+{
+	const std::optional<ThreadScheduling> &scheduling =
+		scheduling_ ? scheduling_ : threadDefaults().scheduling;
+	if (!scheduling)
+		return 0;
+
+	struct sched_param param = {};
+	int policy = SCHED_OTHER;
+	int ret;
+
+	switch (scheduling->policy) {
+	case Thread::SchedulingPolicy::Normal:
+		break;
+	case Thread::SchedulingPolicy::Fifo:
+		policy = SCHED_FIFO;
+		param.sched_priority = scheduling->priority;
+		break;
+	case Thread::SchedulingPolicy::RoundRobin:
+		policy = SCHED_RR;
+		param.sched_priority = scheduling->priority;
+		break;
+	}
+
+	ret = sched_setscheduler(tid_, policy, &param);
+	if (ret == 0 && policy == SCHED_OTHER)
+		ret = setpriority(PRIO_PROCESS, tid_, scheduling->priority);
+
+	if (ret < 0) {
+		ret = -errno;
+		LOG(Thread, Error)
+			<< "Failed to set thread scheduling: " << strerror(-ret);
+		return ret;
+	}
+
+	return 0;
+}
+
 /**
  * \class Thread
  * \brief A thread of execution
@@ -286,6 +607,7 @@ void Thread::start()
 		return;
 
 	data_->running_ = true;
+	data_->tid_ = 0;
 	data_->exitCode_ = -1;
 	data_->exit_.store(false, std::memory_order_relaxed);
 
@@ -314,7 +636,15 @@ void Thread::startThread()
 	 */
 	thread_local ThreadCleaner cleaner(this, &Thread::finishThread);
 
-	data_->tid_ = syscall(SYS_gettid);
+	{
+		MutexLocker locker(data_->mutex_);
+
+		data_->tid_ = syscall(SYS_gettid);
+		data_->applyAffinity();
+		data_->applyScheduling();
+		data_->applyName(pthread_self());
+	}
+
 	currentThreadData = data_;
 
 	run();
@@ -463,6 +793,121 @@ bool Thread::isRunning()
 	return data_->running_;
 }
 
+/**
+ * \enum Thread::SchedulingPolicy
+ * \brief The kernel scheduling policy of a thread
+ * \var Thread::SchedulingPolicy::Normal
+ * \brief The default time-sharing policy (SCHED_OTHER), with a nice value
+ * \var Thread::SchedulingPolicy::Fifo
+ * \brief The first in, first out real-time policy (SCHED_FIFO)
+ * \var Thread::SchedulingPolicy::RoundRobin
+ * \brief The round-robin real-time policy (SCHED_RR)
+ */
+
+/**
+ * \brief Set the CPU affinity of the thread
+ * \param[in] cpus The CPUs the thread is allowed to run on
+ *
+ * This function restricts the thread to run on the \a cpus. If the thread is
+ * running the affinity is applied immediately, otherwise it is applied when the
+ * thread starts. The affinity stays in effect when the thread is restarted.
+ *
+ * Threads that don't set their affinity explicitly use the affinity from the
+ * LIBCAMERA_THREAD_AFFINITY environment variable if set, or inherit the
+ * affinity of the thread that starts them otherwise.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL The \a cpus list is empty or contains an invalid CPU
+ */
+int Thread::setThreadAffinity(const Span<const unsigned int> &cpus)
+{
+	cpu_set_t cpuset;
+	int ret = toCpuSet(cpus, &cpuset);
+	if (ret)
+		return ret;
+
+	MutexLocker locker(data_->mutex_);
+
+	data_->cpuset_ = cpuset;
+
+	if (data_->running_ && data_->tid_)
+		return data_->applyAffinity();
+
+	return 0;
+}
+
+/**
+ * \brief Set the scheduling policy and priority of the thread
+ * \param[in] policy The scheduling policy
+ * \param[in] priority The scheduling priority
+ *
+ * This function sets the kernel scheduling \a policy of the thread. For the
+ * SchedulingPolicy::Normal policy, the \a priority is the nice value of the
+ * thread, between -20 (highest priority) and 19 (lowest priority). For the
+ * real-time policies, it is the static priority, between 1 (lowest priority)
+ * and 99 (highest priority) on Linux.
+ *
+ * If the thread is running the scheduling is applied immediately, otherwise it
+ * is applied when the thread starts. Increasing the priority or selecting a
+ * real-time policy usually requires the CAP_SYS_NICE capability or a suitable
+ * RLIMIT_RTPRIO resource limit.
+ *
+ * Threads that don't set their scheduling explicitly use the scheduling from
+ * the LIBCAMERA_THREAD_SCHEDULING environment variable if set, or inherit the
+ * scheduling of the thread that starts them otherwise.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL The \a policy or \a priority is invalid
+ * \retval -EPERM The caller isn't allowed to select the real-time \a policy
+ * \retval -EACCES The caller isn't allowed to increase the nice value
+ */
+int Thread::setSchedulingPolicy(SchedulingPolicy policy, int priority)
+{
+	ThreadScheduling scheduling;
+	int ret = toThreadScheduling(policy, priority, &scheduling);
+	if (ret)
+		return ret;
+
+	MutexLocker locker(data_->mutex_);
+
+	data_->scheduling_ = scheduling;
+
+	if (data_->running_ && data_->tid_)
+		return data_->applyScheduling();
+
+	return 0;
+}
+
+/**
+ * \brief Set the name of the thread
+ * \param[in] name The thread name
+ *
+ * This function names the thread in the kernel, making it identifiable in
+ * tools such as top, perf or gdb. This is useful to tell apart the threads of
+ * the multiple cameras that libcamera may operate concurrently. The kernel
+ * limits thread names to 15 characters, longer names are truncated.
+ *
+ * If the thread is running the name is applied immediately, otherwise it is
+ * applied when the thread starts. The name stays in effect when the thread is
+ * restarted. Threads that are not named explicitly inherit the name of the
+ * thread that starts them.
+ *
+ * \context This function is \threadsafe.
+ */
+void Thread::setThreadName(const std::string &name)
+{
+	MutexLocker locker(data_->mutex_);
+
+	data_->name_ = name.substr(0, 15);
+
+	if (data_->running_ && data_->tid_ && thread_.joinable())
+		data_->applyName(thread_.native_handle());
+}
+
 /**
  * \var Thread::finished
  * \brief Signal the end of thread execution
@@ -501,15 +946,27 @@ pid_t Thread::currentId()
  * This function retrieves the internal event dispatcher for the thread. The
  * returned event dispatcher is valid until the thread is destroyed.
  *
+ * The event dispatcher is an EventDispatcherEpoll by default, or an
+ * EventDispatcherPoll if the LIBCAMERA_EVENT_DISPATCHER environment variable is
+ * set to "poll".
+ *
  * \context This function is \threadsafe.
  *
  * \return Pointer to the event dispatcher
  */
 EventDispatcher *Thread::eventDispatcher()
 {
-	if (!data_->dispatcher_.load(std::memory_order_relaxed))
-		data_->dispatcher_.store(new EventDispatcherPoll(),
-					 std::memory_order_release);
+	if (!data_->dispatcher_.load(std::memory_order_relaxed)) {
+		const char *type = utils::secure_getenv("LIBCAMERA_EVENT_DISPATCHER");
+		EventDispatcher *dispatcher;
+
+		if (type && !strcmp(type, "poll"))
+			dispatcher = new EventDispatcherPoll();
+		else
+			dispatcher = new EventDispatcherEpoll();
+
+		data_->dispatcher_.store(dispatcher, std::memory_order_release);
+	}
 
 	return data_->dispatcher_.load(std::memory_order_relaxed);
 }
@@ -542,10 +999,17 @@ void Thread::postMessage(std::unique_ptr<Message> msg, Object *receiver)
 
 	ASSERT(data_ == receiver->thread()->data_);
 
-	MutexLocker locker(data_->messages_.mutex_);
-	data_->messages_.list_.push_back(std::move(msg));
 	receiver->pendingMessages_++;
-	locker.unlock();
+
+	/*
+	 * If messages posted earlier haven't been collected yet, the thread
+	 * has already been woken up and will collect this message along with
+	 * them. Skip the redundant wakeup, to post bursts of messages, such as
+	 * the per-frame calls to an IPA running in a thread, with a single
+	 * system call.
+	 */
+	if (!data_->messages_.post(msg.release()))
+		return;
 
 	EventDispatcher *dispatcher =
 		data_->dispatcher_.load(std::memory_order_acquire);
@@ -567,6 +1031,8 @@ void Thread::removeMessages(Object *receiver)
 	if (!receiver->pendingMessages_)
 		return;
 
+	data_->messages_.collect();
+
 	std::vector<std::unique_ptr<Message>> toDelete;
 	for (std::unique_ptr<Message> &msg : data_->messages_.list_) {
 		if (!msg)
@@ -614,9 +1080,20 @@ void Thread::dispatchMessages(Message::Type type)
 
 	MutexLocker locker(data_->messages_.mutex_);
 
-	std::list<std::unique_ptr<Message>> &messages = data_->messages_.list_;
+	std::vector<std::unique_ptr<Message>> &messages = data_->messages_.list_;
+
+	/*
+	 * Iterate by index, as messages posted while dispatching are appended
+	 * to the list, which may reallocate its storage.
+	 */
+	for (size_t i = 0; ; i++) {
+		if (i == messages.size()) {
+			data_->messages_.collect();
+			if (i == messages.size())
+				break;
+		}
 
-	for (std::unique_ptr<Message> &msg : messages) {
+		std::unique_ptr<Message> &msg = messages[i];
 		if (!msg)
 			continue;
 
@@ -645,14 +1122,9 @@ void Thread::dispatchMessages(Message::Type type)
 	 * can't do so during recursion, as it would invalidate the iterator of
 	 * the outer calls.
 	 */
-	if (!--data_->messages_.recursion_) {
-		for (auto iter = messages.begin(); iter != messages.end(); ) {
-			if (!*iter)
-				iter = messages.erase(iter);
-			else
-				++iter;
-		}
-	}
+	if (!--data_->messages_.recursion_)
+		messages.erase(std::remove(messages.begin(), messages.end(), nullptr),
+			       messages.end());
 }
 
 /**
@@ -678,6 +1150,9 @@ void Thread::moveObject(Object *object, ThreadData *currentData,
 	if (object->pendingMessages_) {
 		unsigned int movedMessages = 0;
 
+		currentData->messages_.collect();
+		targetData->messages_.collect();
+
 		for (std::unique_ptr<Message> &msg : currentData->messages_.list_) {
 			if (!msg)
 				continue;
@@ -0,0 +1,267 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Shared worker thread pool
+ */
+
+#include <libcamera/base/thread_pool.h>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <thread>
+
+#include <libcamera/base/thread.h>
+
+/**
+ * \file base/thread_pool.h
+ * \brief Shared worker thread pool
+ */
+
+namespace libcamera {
+
+namespace {
+
+constexpr unsigned int kNumPriorities = 3;
+
+} /* namespace */
+
+/**
+ * \brief A worker thread of a ThreadPool
+ *
+ * Each worker stores the tasks submitted to it in one queue per priority.
+ * Idle workers take tasks from the queues of the other workers.
+ */
+class ThreadPool::Worker : public Thread
+{
+public:
+	Worker(ThreadPool *pool, unsigned int index)
+		: pool_(pool), index_(index)
+	{
+	}
+
+	/**
+	 * \brief The pool the worker belongs to
+	 */
+	ThreadPool *const pool_;
+	/**
+	 * \brief The index of the worker in the pool
+	 */
+	const unsigned int index_;
+
+	/**
+	 * \brief Protects the \ref queues_
+	 */
+	Mutex mutex_;
+	/**
+	 * \brief The queued tasks, indexed by priority
+	 */
+	std::array<std::deque<Task>, kNumPriorities> queues_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
+
+protected:
+	void run() override
+	{
+		pool_->work(this);
+	}
+};
+
+/**
+ * \class ThreadPool
+ * \brief A pool of worker threads that run submitted tasks
+ *
+ * The ThreadPool runs short-lived tasks on a fixed set of worker threads, to
+ * avoid creating a thread for each component that needs to perform work
+ * asynchronously. Most such threads are idle most of the time, sharing a pool
+ * reduces the number of threads and context switches.
+ *
+ * Tasks are submitted with a priority. Workers run the tasks of the highest
+ * priority first, and tasks of the same priority in submission order. Each
+ * worker queues the tasks submitted to it separately, and idle workers take
+ * tasks from the queues of the other workers, to limit contention between the
+ * workers. Tasks submitted from a worker of the pool are queued to that worker,
+ * and run by another worker only if the submitting worker is busy.
+ *
+ * Tasks shall not block for long periods of time, as they would prevent other
+ * tasks from running. In particular, a task waiting for the completion of
+ * another task submitted to the same pool may deadlock if all workers are
+ * busy. Tasks that need to run an event loop, or to receive messages and
+ * signals, shall use a Thread instead.
+ *
+ * The workers are Thread instances, their CPU affinity and scheduling thus
+ * follow the defaults of all libcamera threads.
+ *
+ * A pool shared by all libcamera components is available through instance().
+ */
+
+/**
+ * \enum ThreadPool::Priority
+ * \brief The priority of a submitted task
+ * \var ThreadPool::Priority::High
+ * \brief The task runs before tasks of normal and low priorities
+ * \var ThreadPool::Priority::Normal
+ * \brief The default priority
+ * \var ThreadPool::Priority::Low
+ * \brief The task runs when no task of a higher priority is queued
+ */
+
+/**
+ * \typedef ThreadPool::Task
+ * \brief A function run by a worker thread
+ */
+
+/**
+ * \brief Create a thread pool
+ * \param[in] workers The number of worker threads
+ *
+ * Create a pool of \a workers threads, or of one thread per CPU if \a workers
+ * is 0. The worker threads are started immediately.
+ */
+ThreadPool::ThreadPool(unsigned int workers)
+	: nextWorker_(0), pending_(0), exit_(false)
+{
+	if (!workers)
+		workers = std::max(std::thread::hardware_concurrency(), 1U);
+
+	for (unsigned int i = 0; i < workers; i++)
+		workers_.push_back(std::make_unique<Worker>(this, i));
+
+	for (std::unique_ptr<Worker> &worker : workers_)
+		worker->start();
+}
+
+/**
+ * \brief Destroy the thread pool
+ *
+ * The worker threads run all the queued tasks, including tasks submitted while
+ * the pool is being destroyed, before stopping. The pool shall not be
+ * destroyed from one of its worker threads.
+ */
+ThreadPool::~ThreadPool()
+{
+	{
+		MutexLocker locker(mutex_);
+		exit_ = true;
+	}
+
+	cv_.notify_all();
+
+	for (std::unique_ptr<Worker> &worker : workers_)
+		worker->wait();
+}
+
+/**
+ * \brief Retrieve the thread pool shared by all libcamera components
+ *
+ * The shared pool is created on first use, with one worker thread per CPU.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The shared thread pool
+ */
+ThreadPool *ThreadPool::instance()
+{
+	static ThreadPool pool;
+	return &pool;
+}
+
+/**
+ * \fn ThreadPool::workers()
+ * \brief Retrieve the number of worker threads
+ * \return The number of worker threads
+ */
+
+/**
+ * \brief Submit a task to the pool
+ * \param[in] task The task
+ * \param[in] priority The task priority
+ *
+ * Queue the \a task to be run by a worker thread. The task may run before this
+ * function returns.
+ *
+ * \context This function is \threadsafe.
+ */
+void ThreadPool::submit(Task task, Priority priority)
+{
+	Worker *worker = dynamic_cast<Worker *>(Thread::current());
+	if (!worker || worker->pool_ != this)
+		worker = workers_[nextWorker_.fetch_add(1, std::memory_order_relaxed) %
+				  workers_.size()].get();
+
+	/*
+	 * Account for the task before queuing it, to guarantee that the
+	 * counter never underflows when a worker takes the task.
+	 */
+	{
+		MutexLocker locker(mutex_);
+		pending_.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		MutexLocker locker(worker->mutex_);
+		worker->queues_[static_cast<unsigned int>(priority)].push_back(std::move(task));
+	}
+
+	cv_.notify_one();
+}
+
+/**
+ * \brief Take the next task to run by a worker
+ * \param[in] worker The worker
+ * \param[out] task The task
+ *
+ * Look for the task of the highest priority in the queue of the \a worker
+ * first, and in the queues of the other workers then.
+ *
+ * \return True if a task has been taken, false otherwise
+ */
+bool ThreadPool::takeTask(Worker *worker, Task *task)
+{
+	const unsigned int count = workers_.size();
+
+	for (unsigned int priority = 0; priority < kNumPriorities; priority++) {
+		for (unsigned int i = 0; i < count; i++) {
+			Worker *victim = workers_[(worker->index_ + i) % count].get();
+			MutexLocker locker(victim->mutex_);
+
+			std::deque<Task> &queue = victim->queues_[priority];
+			if (queue.empty())
+				continue;
+
+			*task = std::move(queue.front());
+			queue.pop_front();
+			pending_.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * \brief Run tasks until the pool is destroyed
+ * \param[in] worker The worker running the tasks
+ */
+void ThreadPool::work(Worker *worker)
+{
+	while (true) {
+		Task task;
+
+		if (takeTask(worker, &task)) {
+			task();
+			continue;
+		}
+
+		MutexLocker locker(mutex_);
+
+		cv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return pending_.load(std::memory_order_relaxed) || exit_;
+		});
+
+		if (exit_ && !pending_.load(std::memory_order_relaxed))
+			return;
+	}
+}
+
+} /* namespace libcamera */
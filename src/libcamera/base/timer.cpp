@@ -53,7 +53,7 @@ LOG_DEFINE_CATEGORY(Timer)
  * \param[in] parent The parent Object
  */
 Timer::Timer(Object *parent)
-	: Object(parent), running_(false)
+	: Object(parent), running_(false), queueIndex_(kNotQueued)
 {
 }
 
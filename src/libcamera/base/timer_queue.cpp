@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Timer queue for event dispatchers
+ */
+
+#include <libcamera/base/timer_queue.h>
+
+#include <libcamera/base/timer.h>
+
+/**
+ * \file base/timer_queue.h
+ * \brief Timer queue for event dispatchers
+ */
+
+namespace libcamera {
+
+/**
+ * \class TimerQueue
+ * \brief A queue of timers sorted by deadline
+ *
+ * The TimerQueue stores the running timers of an event dispatcher in a binary
+ * min-heap ordered by deadline. The timer with the earliest deadline is
+ * retrieved in constant time, and timers are inserted and removed in
+ * logarithmic time. Each timer records its position in the heap, which avoids
+ * searching for it on removal.
+ *
+ * The deadline of each timer is copied when it is inserted, the queue is thus
+ * not affected by changes to the timer deadline until the timer is removed and
+ * inserted again.
+ *
+ * The queue doesn't allocate memory once its storage has grown to the maximum
+ * number of timers running concurrently.
+ */
+
+/**
+ * \fn TimerQueue::empty()
+ * \brief Check if the queue is empty
+ * \return True if the queue contains no timer, false otherwise
+ */
+
+/**
+ * \fn TimerQueue::front()
+ * \brief Retrieve the timer with the earliest deadline
+ *
+ * The queue shall not be empty.
+ *
+ * \return The timer with the earliest deadline
+ */
+
+/**
+ * \fn TimerQueue::deadline()
+ * \brief Retrieve the earliest deadline
+ *
+ * The queue shall not be empty.
+ *
+ * \return The deadline of the timer returned by front()
+ */
+
+/**
+ * \brief Insert a \a timer in the queue
+ * \param[in] timer The timer
+ *
+ * The timer is ordered according to its current deadline. If the timer is
+ * already queued, it is moved to the position corresponding to its current
+ * deadline.
+ */
+void TimerQueue::insert(Timer *timer)
+{
+	if (timer->queueIndex_ != Timer::kNotQueued)
+		remove(timer);
+
+	heap_.push_back({ timer->deadline(), timer });
+	timer->queueIndex_ = heap_.size() - 1;
+	siftUp(heap_.size() - 1);
+}
+
+/**
+ * \brief Remove a \a timer from the queue
+ * \param[in] timer The timer
+ *
+ * If the timer isn't queued, this function performs no operation.
+ */
+void TimerQueue::remove(Timer *timer)
+{
+	size_t index = timer->queueIndex_;
+	if (index == Timer::kNotQueued)
+		return;
+
+	timer->queueIndex_ = Timer::kNotQueued;
+
+	Entry last = heap_.back();
+	heap_.pop_back();
+
+	if (index == heap_.size())
+		return;
+
+	/*
+	 * Move the last entry to the freed position, and restore the heap
+	 * property in the direction it is violated, if any.
+	 */
+	place(index, last);
+
+	if (index > 0 && last.deadline < heap_[(index - 1) / 2].deadline)
+		siftUp(index);
+	else
+		siftDown(index);
+}
+
+void TimerQueue::place(size_t index, const Entry &entry)
+{
+	heap_[index] = entry;
+	entry.timer->queueIndex_ = index;
+}
+
+void TimerQueue::siftUp(size_t index)
+{
+	Entry entry = heap_[index];
+
+	while (index > 0) {
+		size_t parent = (index - 1) / 2;
+		if (!(entry.deadline < heap_[parent].deadline))
+			break;
+
+		place(index, heap_[parent]);
+		index = parent;
+	}
+
+	place(index, entry);
+}
+
+void TimerQueue::siftDown(size_t index)
+{
+	Entry entry = heap_[index];
+	const size_t size = heap_.size();
+
+	while (true) {
+		size_t child = index * 2 + 1;
+		if (child >= size)
+			break;
+
+		if (child + 1 < size &&
+		    heap_[child + 1].deadline < heap_[child].deadline)
+			child++;
+
+		if (!(heap_[child].deadline < entry.deadline))
+			break;
+
+		place(index, heap_[child]);
+		index = child;
+	}
+
+	place(index, entry);
+}
+
+} /* namespace libcamera */
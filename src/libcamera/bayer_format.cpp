@@ -7,16 +7,16 @@
 
 #include "libcamera/internal/bayer_format.h"
 
-#include <algorithm>
-#include <map>
 #include <sstream>
-#include <unordered_map>
+#include <tuple>
 
 #include <linux/media-bus-format.h>
 
 #include <libcamera/formats.h>
 #include <libcamera/transform.h>
 
+#include "libcamera/internal/sorted_table.h"
+
 /**
  * \file bayer_format.h
  * \brief Class to represent Bayer formats and manipulate them
@@ -69,33 +69,34 @@ namespace libcamera {
 
 namespace {
 
-/* Define a slightly arbitrary ordering so that we can use a std::map. */
-struct BayerFormatComparator {
-	constexpr bool operator()(const BayerFormat &lhs, const BayerFormat &rhs) const
-	{
-		if (lhs.bitDepth < rhs.bitDepth)
-			return true;
-		else if (lhs.bitDepth > rhs.bitDepth)
-			return false;
-
-		if (lhs.order < rhs.order)
-			return true;
-		else if (lhs.order > rhs.order)
-			return false;
-
-		if (lhs.packing < rhs.packing)
-			return true;
-		else
-			return false;
-	}
-};
-
 struct Formats {
 	PixelFormat pixelFormat;
 	V4L2PixelFormat v4l2Format;
 };
 
-const std::map<BayerFormat, Formats, BayerFormatComparator> bayerToFormat{
+struct BayerFormatEntry {
+	BayerFormat bayer;
+	Formats formats;
+};
+
+/* Define a slightly arbitrary ordering so that we can sort the table. */
+constexpr std::tuple<uint8_t, BayerFormat::Order, BayerFormat::Packing>
+bayerKey(const BayerFormatEntry &entry)
+{
+	return { entry.bayer.bitDepth, entry.bayer.order, entry.bayer.packing };
+}
+
+constexpr std::tuple<uint32_t, uint64_t> pixelFormatKey(const BayerFormatEntry &entry)
+{
+	return { entry.formats.pixelFormat.fourcc(), entry.formats.pixelFormat.modifier() };
+}
+
+constexpr uint32_t v4l2FormatKey(const BayerFormatEntry &entry)
+{
+	return entry.formats.v4l2Format.fourcc();
+}
+
+constexpr BayerFormatEntry bayerToFormatEntries[] = {
 	{ { BayerFormat::BGGR, 8, BayerFormat::Packing::None },
 		{ formats::SBGGR8, V4L2PixelFormat(V4L2_PIX_FMT_SBGGR8) } },
 	{ { BayerFormat::GBRG, 8, BayerFormat::Packing::None },
@@ -190,7 +191,28 @@ const std::map<BayerFormat, Formats, BayerFormatComparator> bayerToFormat{
 		{ formats::MONO_PISP_COMP1, V4L2PixelFormat(V4L2_PIX_FMT_PISP_COMP1_MONO) } },
 };
 
-const std::unordered_map<unsigned int, BayerFormat> mbusCodeToBayer{
+/*
+ * Sort the tables and index them at compile time, to avoid static
+ * initialization and look entries up with binary searches.
+ */
+constexpr auto bayerToFormat = utils::sortedTable(bayerToFormatEntries, bayerKey);
+static_assert(utils::sortedTableIsUnique(bayerToFormat, bayerKey),
+	      "Duplicated Bayer formats");
+
+constexpr auto bayerByPixelFormat = utils::sortedTableIndex(bayerToFormat, pixelFormatKey);
+constexpr auto bayerByV4L2Format = utils::sortedTableIndex(bayerToFormat, v4l2FormatKey);
+
+struct MbusCodeEntry {
+	unsigned int mbusCode;
+	BayerFormat bayer;
+};
+
+constexpr unsigned int mbusCodeKey(const MbusCodeEntry &entry)
+{
+	return entry.mbusCode;
+}
+
+constexpr MbusCodeEntry mbusCodeToBayerEntries[] = {
 	{ MEDIA_BUS_FMT_SBGGR8_1X8, { BayerFormat::BGGR, 8, BayerFormat::Packing::None } },
 	{ MEDIA_BUS_FMT_SGBRG8_1X8, { BayerFormat::GBRG, 8, BayerFormat::Packing::None } },
 	{ MEDIA_BUS_FMT_SGRBG8_1X8, { BayerFormat::GRBG, 8, BayerFormat::Packing::None } },
@@ -229,6 +251,10 @@ const std::unordered_map<unsigned int, BayerFormat> mbusCodeToBayer{
 	{ MEDIA_BUS_FMT_Y16_1X16, { BayerFormat::MONO, 16, BayerFormat::Packing::None } },
 };
 
+constexpr auto mbusCodeToBayer = utils::sortedTable(mbusCodeToBayerEntries, mbusCodeKey);
+static_assert(utils::sortedTableIsUnique(mbusCodeToBayer, mbusCodeKey),
+	      "Duplicated media bus codes");
+
 } /* namespace */
 
 /**
@@ -254,11 +280,12 @@ const BayerFormat &BayerFormat::fromMbusCode(unsigned int mbusCode)
 {
 	static BayerFormat empty;
 
-	const auto it = mbusCodeToBayer.find(mbusCode);
-	if (it == mbusCodeToBayer.end())
+	const MbusCodeEntry *entry =
+		utils::sortedTableFind(mbusCodeToBayer, mbusCode, mbusCodeKey);
+	if (!entry)
 		return empty;
 	else
-		return it->second;
+		return entry->bayer;
 }
 
 /**
@@ -338,9 +365,12 @@ std::ostream &operator<<(std::ostream &out, const BayerFormat &f)
  */
 V4L2PixelFormat BayerFormat::toV4L2PixelFormat() const
 {
-	const auto it = bayerToFormat.find(*this);
-	if (it != bayerToFormat.end())
-		return it->second.v4l2Format;
+	const BayerFormatEntry *entry =
+		utils::sortedTableFind(bayerToFormat,
+				       std::make_tuple(bitDepth, order, packing),
+				       bayerKey);
+	if (entry)
+		return entry->formats.v4l2Format;
 
 	return V4L2PixelFormat();
 }
@@ -352,12 +382,11 @@ V4L2PixelFormat BayerFormat::toV4L2PixelFormat() const
  */
 BayerFormat BayerFormat::fromV4L2PixelFormat(V4L2PixelFormat v4l2Format)
 {
-	auto it = std::find_if(bayerToFormat.begin(), bayerToFormat.end(),
-			       [v4l2Format](const auto &i) {
-				       return i.second.v4l2Format == v4l2Format;
-			       });
-	if (it != bayerToFormat.end())
-		return it->first;
+	const BayerFormatEntry *entry =
+		utils::sortedTableFind(bayerToFormat, bayerByV4L2Format,
+				       v4l2Format.fourcc(), v4l2FormatKey);
+	if (entry)
+		return entry->bayer;
 
 	return BayerFormat();
 }
@@ -368,9 +397,12 @@ BayerFormat BayerFormat::fromV4L2PixelFormat(V4L2PixelFormat v4l2Format)
  */
 PixelFormat BayerFormat::toPixelFormat() const
 {
-	const auto it = bayerToFormat.find(*this);
-	if (it != bayerToFormat.end())
-		return it->second.pixelFormat;
+	const BayerFormatEntry *entry =
+		utils::sortedTableFind(bayerToFormat,
+				       std::make_tuple(bitDepth, order, packing),
+				       bayerKey);
+	if (entry)
+		return entry->formats.pixelFormat;
 
 	return PixelFormat();
 }
@@ -381,12 +413,12 @@ PixelFormat BayerFormat::toPixelFormat() const
  */
 BayerFormat BayerFormat::fromPixelFormat(PixelFormat format)
 {
-	const auto it = std::find_if(bayerToFormat.begin(), bayerToFormat.end(),
-				     [format](const auto &i) {
-					     return i.second.pixelFormat == format;
-				     });
-	if (it != bayerToFormat.end())
-		return it->first;
+	const BayerFormatEntry *entry =
+		utils::sortedTableFind(bayerToFormat, bayerByPixelFormat,
+				       std::make_tuple(format.fourcc(), format.modifier()),
+				       pixelFormatKey);
+	if (entry)
+		return entry->bayer;
 
 	return BayerFormat();
 }
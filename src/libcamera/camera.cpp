@@ -9,18 +9,25 @@
 
 #include <array>
 #include <atomic>
+#include <errno.h>
 #include <iomanip>
+#include <limits>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/thread.h>
 
 #include <libcamera/color_space.h>
+#include <libcamera/framebuffer.h>
 #include <libcamera/framebuffer_allocator.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_controls.h"
+#include "libcamera/internal/camera_group.h"
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/request.h"
@@ -242,6 +249,167 @@ bool SensorConfiguration::isValid() const
 	return false;
 }
 
+/**
+ * \class CameraStatistics
+ * \brief Frame latency and drop statistics for a camera
+ *
+ * The CameraStatistics class reports how frames progress through the pipeline
+ * during a capture session. Latencies of the processing stages are measured
+ * from the time the sensor captured the frame, as reported by the
+ * controls::SensorTimestamp metadata, to the time the stage completes. All
+ * times are measured against the CLOCK_MONOTONIC clock.
+ *
+ * Not all pipeline handlers implement all processing stages. Stages that are
+ * not implemented report a zero count.
+ *
+ * The statistics are reset when the camera is started.
+ */
+
+/**
+ * \enum CameraStatistics::Stage
+ * \brief The frame processing stages
+ *
+ * \var CameraStatistics::StageDequeue
+ * \brief The frame has been dequeued from the capture device
+ * \var CameraStatistics::StageIpa
+ * \brief The IPA has produced the metadata for the frame
+ * \var CameraStatistics::StageIsp
+ * \brief The ISP has finished processing the frame
+ * \var CameraStatistics::StageComplete
+ * \brief The request for the frame has completed
+ */
+
+/**
+ * \var CameraStatistics::kNumStages
+ * \brief The number of frame processing stages
+ */
+
+/**
+ * \struct CameraStatistics::Latency
+ * \brief Latency statistics for a frame processing stage
+ *
+ * \var CameraStatistics::Latency::count
+ * \brief The number of latency samples
+ *
+ * \var CameraStatistics::Latency::min
+ * \brief The minimum latency, only valid when count is not zero
+ *
+ * \var CameraStatistics::Latency::max
+ * \brief The maximum latency
+ *
+ * \var CameraStatistics::Latency::total
+ * \brief The sum of all latency samples
+ */
+
+/**
+ * \brief Add a latency sample
+ * \param[in] latency The latency
+ */
+void CameraStatistics::Latency::add(std::chrono::nanoseconds latency)
+{
+	count++;
+	min = std::min(min, latency);
+	max = std::max(max, latency);
+	total += latency;
+}
+
+/**
+ * \brief Compute the average latency
+ * \return The average latency, or zero if no sample has been added
+ */
+std::chrono::nanoseconds CameraStatistics::Latency::average() const
+{
+	if (!count)
+		return std::chrono::nanoseconds::zero();
+
+	return total / count;
+}
+
+/**
+ * \var CameraStatistics::stages
+ * \brief The latency of each frame processing stage, indexed by Stage
+ */
+
+/**
+ * \var CameraStatistics::requestLatency
+ * \brief The latency from request queueing to the device to completion
+ */
+
+/**
+ * \var CameraStatistics::requestsCompleted
+ * \brief The number of requests that have completed successfully
+ */
+
+/**
+ * \var CameraStatistics::requestsCancelled
+ * \brief The number of requests that have been cancelled
+ */
+
+/**
+ * \var CameraStatistics::buffersFailed
+ * \brief The number of buffers that have completed with an error
+ */
+
+/**
+ * \var CameraStatistics::framesDropped
+ * \brief The number of frames dropped by the device
+ *
+ * Dropped frames are detected from gaps in the sequence numbers of the buffers
+ * completed for each stream.
+ */
+
+/**
+ * \class CameraMemoryUsage
+ * \brief Memory allocated for a camera, by purpose
+ *
+ * The CameraMemoryUsage class reports the amount of memory, in bytes, that
+ * libcamera has allocated for a camera. The memory is split by purpose, to
+ * distinguish the buffers allocated for the application, the buffers internal
+ * to the pipeline, and the memory shared with other components such as the
+ * IPA modules.
+ *
+ * Buffers allocated by applications outside of libcamera and imported in
+ * requests are not accounted for.
+ */
+
+/**
+ * \enum CameraMemoryUsage::Purpose
+ * \brief The purpose of a memory allocation
+ *
+ * \var CameraMemoryUsage::PurposeApplication
+ * \brief Buffers allocated for the application with a FrameBufferAllocator
+ * \var CameraMemoryUsage::PurposeInternal
+ * \brief Buffers allocated by the pipeline handler for internal use, such as
+ * intermediate buffers between the capture device and an ISP or converter
+ * \var CameraMemoryUsage::PurposeShared
+ * \brief Memory shared between the pipeline handler and other components,
+ * such as parameters and statistics buffers shared with the IPA
+ */
+
+/**
+ * \var CameraMemoryUsage::kNumPurposes
+ * \brief The number of memory allocation purposes
+ */
+
+/**
+ * \var CameraMemoryUsage::bytes
+ * \brief The amount of allocated memory in bytes, indexed by Purpose
+ */
+
+/**
+ * \brief Compute the total amount of allocated memory
+ * \return The amount of memory allocated for all purposes, in bytes
+ */
+uint64_t CameraMemoryUsage::total() const
+{
+	uint64_t total = 0;
+
+	for (uint64_t value : bytes)
+		total += value;
+
+	return total;
+}
+
 /**
  * \class CameraConfiguration
  * \brief Hold configuration for streams of the camera
@@ -576,8 +744,12 @@ CameraConfiguration::Status CameraConfiguration::validateColorSpaces(ColorSpaceF
  * \param[in] pipe The pipeline handler responsible for the camera device
  */
 Camera::Private::Private(PipelineHandler *pipe)
-	: requestSequence_(0), pipe_(pipe->shared_from_this()),
-	  disconnected_(false), state_(CameraAvailable)
+	: requestSequence_(0), maxQueuedRequests_(0), group_(nullptr),
+	  delayedControls_(nullptr), pipe_(pipe->shared_from_this()), disconnected_(false),
+	  state_(CameraAvailable),
+	  completionOrder_(Camera::CompletionOrder::InOrder),
+	  pendingRequests_(0), completionHead_(0),
+	  completionTail_(0), memoryBudget_(0)
 {
 }
 
@@ -599,6 +771,184 @@ Camera::Private::~Private()
  * \return The control validator associated with this camera
  */
 
+/**
+ * \brief Retrieve a snapshot of the camera statistics
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The camera statistics
+ */
+CameraStatistics Camera::Private::statistics() const
+{
+	MutexLocker locker(statisticsLock_);
+	return statistics_;
+}
+
+/**
+ * \brief Reset the camera statistics
+ */
+void Camera::Private::resetStatistics()
+{
+	MutexLocker locker(statisticsLock_);
+	statistics_ = {};
+	lastSequences_.clear();
+}
+
+/**
+ * \brief Record the latency of a frame processing stage
+ * \param[in] stage The frame processing stage
+ * \param[in] latency The latency from the sensor timestamp
+ */
+void Camera::Private::recordLatency(CameraStatistics::Stage stage,
+				    std::chrono::nanoseconds latency)
+{
+	MutexLocker locker(statisticsLock_);
+	statistics_.stages[stage].add(latency);
+}
+
+/**
+ * \brief Record the completion of a request
+ * \param[in] request The request
+ * \param[in] latency The latency from queueing to the device to completion
+ */
+void Camera::Private::recordRequest(const Request *request,
+				    std::chrono::nanoseconds latency)
+{
+	MutexLocker locker(statisticsLock_);
+
+	if (request->status() == Request::RequestCancelled) {
+		statistics_.requestsCancelled++;
+		return;
+	}
+
+	statistics_.requestsCompleted++;
+	statistics_.requestLatency.add(latency);
+}
+
+/**
+ * \brief Record the completion of a buffer
+ * \param[in] stream The stream the buffer belongs to
+ * \param[in] buffer The buffer
+ *
+ * Buffer errors are counted, and frame drops are detected from gaps in the
+ * sequence numbers of the successfully completed buffers of the \a stream.
+ */
+void Camera::Private::recordBuffer(const Stream *stream, const FrameBuffer *buffer)
+{
+	const FrameMetadata &metadata = buffer->metadata();
+
+	MutexLocker locker(statisticsLock_);
+
+	if (metadata.status == FrameMetadata::FrameError)
+		statistics_.buffersFailed++;
+
+	if (metadata.status != FrameMetadata::FrameSuccess)
+		return;
+
+	auto [it, inserted] = lastSequences_.try_emplace(stream, metadata.sequence);
+	if (inserted)
+		return;
+
+	uint32_t &last = it->second;
+	if (metadata.sequence > last + 1)
+		statistics_.framesDropped += metadata.sequence - last - 1;
+
+	last = metadata.sequence;
+}
+
+/**
+ * \brief Retrieve a snapshot of the camera memory usage
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The memory allocated for the camera
+ */
+CameraMemoryUsage Camera::Private::memoryUsage() const
+{
+	MutexLocker locker(memoryLock_);
+	return memoryUsage_;
+}
+
+/**
+ * \brief Retrieve the camera memory budget
+ *
+ * Pipeline handlers shall take the budget into account when selecting the
+ * number of buffers in CameraConfiguration::validate().
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The memory budget in bytes, or 0 if the memory usage is unlimited
+ */
+uint64_t Camera::Private::memoryBudget() const
+{
+	MutexLocker locker(memoryLock_);
+	return memoryBudget_;
+}
+
+/**
+ * \brief Account for memory allocated for the camera
+ * \param[in] purpose The purpose of the allocation
+ * \param[in] bytes The size of the allocation in bytes
+ *
+ * Pipeline handlers shall call this function for every buffer or shared memory
+ * allocation they perform for a camera, and release the charge with
+ * unchargeMemory() when freeing the memory. The charge is refused if it would
+ * make the memory usage exceed the memory budget, in which case the caller
+ * shall free the memory.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENOMEM The allocation would exceed the memory budget
+ */
+int Camera::Private::chargeMemory(CameraMemoryUsage::Purpose purpose,
+				  uint64_t bytes)
+{
+	MutexLocker locker(memoryLock_);
+
+	if (memoryBudget_ && memoryUsage_.total() + bytes > memoryBudget_)
+		return -ENOMEM;
+
+	memoryUsage_.bytes[purpose] += bytes;
+
+	return 0;
+}
+
+/**
+ * \brief Release the accounting of memory freed for the camera
+ * \param[in] purpose The purpose of the allocation
+ * \param[in] bytes The size of the allocation in bytes
+ *
+ * \context This function is \threadsafe.
+ */
+void Camera::Private::unchargeMemory(CameraMemoryUsage::Purpose purpose,
+				     uint64_t bytes)
+{
+	MutexLocker locker(memoryLock_);
+
+	uint64_t &usage = memoryUsage_.bytes[purpose];
+	ASSERT(usage >= bytes);
+	usage -= bytes;
+}
+
+/**
+ * \brief Compute the amount of memory used by buffers
+ * \param[in] buffers The buffers
+ *
+ * \return The sum of the length of all planes of the \a buffers, in bytes
+ */
+uint64_t Camera::Private::bufferMemory(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
+{
+	uint64_t bytes = 0;
+
+	for (const std::unique_ptr<FrameBuffer> &buffer : buffers) {
+		for (const FrameBuffer::Plane &plane : buffer->planes())
+			bytes += plane.length;
+	}
+
+	return bytes;
+}
+
 /**
  * \var Camera::Private::queuedRequests_
  * \brief The list of queued and not yet completed requests
@@ -642,6 +992,50 @@ Camera::Private::~Private()
  * over a single capture session.
  */
 
+/**
+ * \fn Camera::Private::completionOrder()
+ * \brief Retrieve the order in which requests are completed
+ * \return The request completion order
+ * \sa Camera::setCompletionOrder()
+ */
+
+/**
+ * \var Camera::Private::maxQueuedRequests_
+ * \brief The maximum number of requests the pipeline handler can process
+ * concurrently
+ *
+ * Pipeline handlers that can only process a limited number of requests at a
+ * time, for instance because they use a fixed number of internal buffers, shall
+ * set this value in their start() implementation. Requests queued by the
+ * application beyond this limit wait in the PipelineHandler until earlier
+ * requests complete, and the limit is reported to applications through
+ * Camera::availableRequestSlots().
+ *
+ * A value of 0, the default, means the number of requests is not limited. The
+ * value is reset to 0 when the camera is started.
+ */
+
+/**
+ * \var Camera::Private::group_
+ * \brief The CameraGroup the camera belongs to, if any
+ *
+ * The group is set and cleared by the CameraGroup class, while the camera is
+ * not running.
+ */
+
+/**
+ * \var Camera::Private::delayedControls_
+ * \brief The DelayedControls instance that applies the sensor controls
+ *
+ * Pipeline handlers that apply the sensor controls through the DelayedControls
+ * class shall set this pointer each time they create the DelayedControls
+ * instance. It allows the CameraGroup the camera belongs to, if any, to apply
+ * the sensor controls of its cameras in lockstep. Pipeline handlers that don't
+ * use the DelayedControls class leave the pointer to nullptr, their frames are
+ * then reported with their synchronisation error but their controls are not
+ * synchronised.
+ */
+
 static const char *const camera_state_names[] = {
 	"Available",
 	"Acquired",
@@ -655,6 +1049,10 @@ bool Camera::Private::isAcquired() const
 	return state_.load(std::memory_order_acquire) != CameraAvailable;
 }
 
+/**
+ * \brief Check if the camera is running
+ * \return True if the camera is running, false otherwise
+ */
 bool Camera::Private::isRunning() const
 {
 	return state_.load(std::memory_order_acquire) == CameraRunning;
@@ -702,6 +1100,80 @@ int Camera::Private::isAccessAllowed(State low, State high,
 	return -EACCES;
 }
 
+/**
+ * \brief Validate a request before queuing it to the camera
+ * \param[in] request The request to validate
+ *
+ * \return 0 if the request can be queued, or a negative error code otherwise
+ * \retval -EXDEV The request does not belong to this camera
+ * \retval -EINVAL The request is invalid
+ */
+int Camera::Private::validateRequest(const Request *request) const
+{
+	/* Requests can only be queued to the camera that created them. */
+	if (request->_d()->camera() != _o<Camera>()) {
+		LOG(Camera, Error) << "Request was not created by this camera";
+		return -EXDEV;
+	}
+
+	if (request->status() != Request::RequestPending) {
+		LOG(Camera, Error) << request->toString() << " is not valid";
+		return -EINVAL;
+	}
+
+	if (request->buffers().empty()) {
+		LOG(Camera, Error) << "Request contains no buffers";
+		return -EINVAL;
+	}
+
+	for (auto const &it : request->buffers()) {
+		const Stream *stream = it.first;
+
+		if (activeStreams_.find(stream) == activeStreams_.end()) {
+			LOG(Camera, Error) << "Invalid request";
+			return -EINVAL;
+		}
+	}
+
+	if (request->reprocessBuffer() &&
+	    !pipe_->supportsReprocessing(_o<Camera>())) {
+		LOG(Camera, Error) << "Camera doesn't support reprocessing";
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Push a completed request to the completion queue
+ * \param[in] request The completed request
+ *
+ * \return True if the request has been pushed to the completion queue, false
+ * if the completion queue is disabled or full
+ */
+bool Camera::Private::pushCompletedRequest(Request *request)
+{
+	if (!completionFd_.isValid())
+		return false;
+
+	unsigned int head = completionHead_.load(std::memory_order_relaxed);
+	unsigned int tail = completionTail_.load(std::memory_order_acquire);
+	if (head - tail == completionQueue_.size()) {
+		LOG(Camera, Warning) << "Completion queue full";
+		return false;
+	}
+
+	completionQueue_[head % completionQueue_.size()] = request;
+	completionHead_.store(head + 1, std::memory_order_release);
+
+	uint64_t value = 1;
+	ssize_t ret = write(completionFd_.get(), &value, sizeof(value));
+	if (ret != sizeof(value))
+		LOG(Camera, Error) << "Failed to signal request completion";
+
+	return true;
+}
+
 void Camera::Private::disconnect()
 {
 	/*
@@ -776,12 +1248,12 @@ void Camera::Private::setState(State state)
  *   Acquired -> Configured [label = "configure()"];
  *
  *   Configured -> Available [label = "release()"];
- *   Configured -> Configured [label = "configure(), createRequest()"];
+ *   Configured -> Configured [label = "configure(), createRequest(),\ncreateRequests()"];
  *   Configured -> Running [label = "start()"];
  *
  *   Running -> Stopping [label = "stop()"];
  *   Stopping -> Configured;
- *   Running -> Running [label = "createRequest(), queueRequest()"];
+ *   Running -> Running [label = "createRequest(), queueRequest(),\nqueueRequests()"];
  * }
  * \enddot
  *
@@ -812,6 +1284,15 @@ void Camera::Private::setState(State state)
  * to the Configured state.
  */
 
+/**
+ * \enum Camera::CompletionOrder
+ * \brief The order in which requests are completed
+ * \var Camera::CompletionOrder::InOrder
+ * Requests complete in the order they have been queued
+ * \var Camera::CompletionOrder::OutOfOrder
+ * Requests complete as soon as they have been processed
+ */
+
 /**
  * \brief Create a camera instance
  * \param[in] d Camera private data
@@ -874,6 +1355,25 @@ const std::string &Camera::id() const
 	return _d()->id_;
 }
 
+/**
+ * \var Camera::metadataAvailable
+ * \brief Signal emitted when metadata for a request is available
+ *
+ * The metadataAvailable signal notifies applications that metadata for a
+ * request queued to the camera is available before the request completes.
+ * Pipeline handlers emit it as soon as metadata items are known, which allows
+ * applications to process buffers as they complete, together with the
+ * metadata they need, without waiting for the whole request to complete.
+ *
+ * The signal carries the newly available metadata only. The ControlList
+ * reference is valid for the duration of the signal emission. All metadata
+ * reported through this signal is also available in the request metadata when
+ * the request completes.
+ *
+ * Pipeline handlers are not required to report metadata through this signal
+ * and may report it in the request only when the request completes.
+ */
+
 /**
  * \var Camera::bufferCompleted
  * \brief Signal emitted when a buffer for a request queued to the camera has
@@ -885,6 +1385,20 @@ const std::string &Camera::id() const
  * \brief Signal emitted when a request queued to the camera has completed
  */
 
+/**
+ * \var Camera::requestSlotsAvailable
+ * \brief Signal emitted when the camera can accept requests again
+ *
+ * This signal is emitted when a request completes while the number of requests
+ * queued to the camera had reached the limit of what the pipeline can process,
+ * as reported by availableRequestSlots(). Applications that pace request
+ * submission can use it to resume queuing requests. It is emitted after the
+ * completed request has been delivered.
+ *
+ * The signal is never emitted for cameras that don't limit the number of
+ * queued requests.
+ */
+
 /**
  * \var Camera::disconnected
  * \brief Signal emitted when the camera is disconnected from the system
@@ -908,6 +1422,11 @@ Camera::Camera(std::unique_ptr<Private> d, const std::string &id,
 
 Camera::~Camera()
 {
+	/*
+	 * Destroy the request pool while the camera is still valid, as
+	 * destroying requests may signal cancellation of their buffers.
+	 */
+	_d()->requestPool_.clear();
 }
 
 /**
@@ -1023,6 +1542,8 @@ int Camera::release()
 	if (d->isAcquired())
 		d->pipe_->release(this);
 
+	d->requestPool_.clear();
+
 	d->setState(Private::CameraAvailable);
 
 	return 0;
@@ -1072,6 +1593,22 @@ const std::set<Stream *> &Camera::streams() const
 	return _d()->streams_;
 }
 
+/**
+ * \brief Check if the camera supports reprocessing requests
+ *
+ * Reprocessing requests send a RAW frame captured previously back through the
+ * ISP instead of capturing a new frame. They are created by setting a
+ * reprocessing buffer with Request::setReprocessBuffer().
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return True if the camera supports reprocessing requests, false otherwise
+ */
+bool Camera::supportsReprocessing() const
+{
+	return _d()->pipe_->supportsReprocessing(this);
+}
+
 /**
  * \brief Generate a default camera configuration according to stream roles
  * \param[in] roles A list of stream roles
@@ -1187,6 +1724,11 @@ int Camera::configure(CameraConfiguration *config)
 	if (ret)
 		return ret;
 
+	/* The pipeline handler may have updated the controls. */
+	d->validator_->update();
+
+	d->requestPool_.clear();
+
 	d->activeStreams_.clear();
 	for (const StreamConfiguration &cfg : *config) {
 		Stream *stream = cfg.stream();
@@ -1206,6 +1748,51 @@ int Camera::configure(CameraConfiguration *config)
 	return 0;
 }
 
+/**
+ * \brief Register the buffers that will be used with a stream
+ * \param[in] stream The stream
+ * \param[in] buffers The buffers to register
+ *
+ * Applications that import externally allocated buffers, for instance from a
+ * video encoder, usually cycle through a fixed set of buffers. This function
+ * informs the camera of that set, which allows pipeline handlers to associate
+ * each buffer with a device buffer slot when the camera is started. Queuing a
+ * registered buffer is then guaranteed not to require remapping the buffer
+ * in the kernel, starting from the first request.
+ *
+ * Registration is an optimization hint. Buffers that are not registered can
+ * still be queued to the stream, and pipeline handlers that don't support
+ * registration return -ENOTSUP. The buffers stay registered until the camera
+ * is reconfigured or released, and registering a new set of buffers for the
+ * same stream replaces the previous set. The camera keeps references to the
+ * buffers' dmabuf file descriptors, the FrameBuffer instances themselves can be
+ * destroyed at any time.
+ *
+ * \context This function is \threadsafe. It may only be called when the camera
+ * is in the Configured state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not in a state where buffers can be registered
+ * \retval -EINVAL The stream is not part of the active configuration
+ * \retval -ENOTSUP The pipeline handler doesn't support buffer registration
+ */
+int Camera::registerFrameBuffers(Stream *stream, Span<FrameBuffer *const> buffers)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraConfigured);
+	if (ret < 0)
+		return ret;
+
+	if (d->activeStreams_.find(stream) == d->activeStreams_.end())
+		return -EINVAL;
+
+	return d->pipe_->invokeMethod(&PipelineHandler::registerFrameBuffers,
+				      ConnectionTypeBlocking, this, stream,
+				      buffers);
+}
+
 /**
  * \brief Create a request object for the camera
  * \param[in] cookie Opaque cookie for application use
@@ -1244,6 +1831,64 @@ std::unique_ptr<Request> Camera::createRequest(uint64_t cookie)
 	return request;
 }
 
+/**
+ * \brief Create a pool of requests owned by the camera
+ * \param[in] count The number of requests to create
+ * \param[out] requests The requests that have been created
+ *
+ * This function creates \a count requests for use with the camera and stores
+ * pointers to them in \a requests. The request cookies are set to the index of
+ * the request in the \a requests vector.
+ *
+ * Unlike requests created by createRequest(), the requests are owned by the
+ * camera. Their internal storage is sized for the streams configured on the
+ * camera, and is preserved when the requests are reused with
+ * Request::reuse(Request::ReuseBuffers). Applications that cycle through the
+ * pool this way can queue requests in the steady state without any memory
+ * allocation for the buffers tracking.
+ *
+ * The requests stay valid until the camera is reconfigured or released, or
+ * until this function is called again, in which case the previous pool is
+ * freed. Applications shall not use the requests after that point.
+ *
+ * \context This function shall be synchronized by the caller with other
+ * functions that affect the camera state. It may only be called when the camera
+ * is in the Configured state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not configured
+ * \retval -EINVAL The \a count is zero
+ */
+int Camera::createRequests(unsigned int count, std::vector<Request *> *requests)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraConfigured);
+	if (ret < 0)
+		return ret;
+
+	if (!count)
+		return -EINVAL;
+
+	d->requestPool_.clear();
+	d->requestPool_.reserve(count);
+	requests->clear();
+	requests->reserve(count);
+
+	for (unsigned int i = 0; i < count; ++i) {
+		std::unique_ptr<Request> request = std::make_unique<Request>(this, i);
+		request->_d()->reserve(d->activeStreams_.size());
+
+		d->pipe_->registerRequest(request.get());
+
+		requests->push_back(request.get());
+		d->requestPool_.push_back(std::move(request));
+	}
+
+	return 0;
+}
+
 /**
  * \brief Queue a request to the camera
  * \param[in] request The request to queue to the camera
@@ -1275,39 +1920,255 @@ int Camera::queueRequest(Request *request)
 	if (ret < 0)
 		return ret;
 
-	/* Requests can only be queued to the camera that created them. */
-	if (request->_d()->camera() != this) {
-		LOG(Camera, Error) << "Request was not created by this camera";
-		return -EXDEV;
-	}
-
-	if (request->status() != Request::RequestPending) {
-		LOG(Camera, Error) << request->toString() << " is not valid";
-		return -EINVAL;
-	}
-
 	/*
 	 * The camera state may change until the end of the function. No locking
 	 * is however needed as PipelineHandler::queueRequest() will handle
 	 * this.
 	 */
 
-	if (request->buffers().empty()) {
-		LOG(Camera, Error) << "Request contains no buffers";
-		return -EINVAL;
+	ret = d->validateRequest(request);
+	if (ret < 0)
+		return ret;
+
+	d->pendingRequests_.fetch_add(1, std::memory_order_relaxed);
+
+	d->pipe_->invokeMethod(&PipelineHandler::queueRequest,
+			       ConnectionTypeQueued, request);
+
+	return 0;
+}
+
+/**
+ * \brief Queue a batch of requests to the camera
+ * \param[in] requests The requests to queue to the camera
+ *
+ * This function queues all \a requests to the camera for capture, in the order
+ * they are stored in the span. It behaves as calling queueRequest() for each
+ * request, but validates the whole batch upfront and hands it over to the
+ * pipeline handler in a single message, which lowers the per-request overhead
+ * when applications queue multiple requests at once.
+ *
+ * The batch is queued atomically with respect to validation: if any request is
+ * invalid, none of the requests are queued and an error is returned.
+ *
+ * \context This function is \threadsafe. It may only be called when the camera
+ * is in the Running state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not running so requests can't be queued
+ * \retval -EXDEV A request does not belong to this camera
+ * \retval -EINVAL A request is invalid
+ */
+int Camera::queueRequests(Span<Request *const> requests)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraRunning);
+	if (ret < 0)
+		return ret;
+
+	if (requests.empty())
+		return 0;
+
+	for (Request *request : requests) {
+		ret = d->validateRequest(request);
+		if (ret < 0)
+			return ret;
 	}
 
-	for (auto const &it : request->buffers()) {
-		const Stream *stream = it.first;
+	d->pendingRequests_.fetch_add(requests.size(), std::memory_order_relaxed);
 
-		if (d->activeStreams_.find(stream) == d->activeStreams_.end()) {
-			LOG(Camera, Error) << "Invalid request";
-			return -EINVAL;
-		}
+	d->pipe_->invokeMethod(&PipelineHandler::queueRequests,
+			       ConnectionTypeQueued,
+			       std::vector<Request *>(requests.begin(),
+						      requests.end()));
+
+	return 0;
+}
+
+/**
+ * \brief Retrieve the number of requests the camera can accept
+ *
+ * Pipelines may only be able to process a limited number of requests
+ * concurrently. Requests queued beyond that limit are not rejected, but wait
+ * until earlier requests complete, which increases latency without improving
+ * throughput. This function returns how many more requests can be queued
+ * without exceeding the limit, to let applications pace request submission.
+ * The requestSlotsAvailable signal is emitted when a slot becomes available
+ * after the limit has been reached.
+ *
+ * The limit is set when the camera is started. If the camera doesn't limit
+ * the number of queued requests, this function returns
+ * std::numeric_limits<unsigned int>::max().
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The number of requests that can be queued to the camera
+ */
+unsigned int Camera::availableRequestSlots() const
+{
+	const Private *const d = _d();
+
+	if (!d->maxQueuedRequests_)
+		return std::numeric_limits<unsigned int>::max();
+
+	unsigned int pending = d->pendingRequests_.load(std::memory_order_relaxed);
+	return pending < d->maxQueuedRequests_ ? d->maxQueuedRequests_ - pending : 0;
+}
+
+/**
+ * \brief Deliver completed requests through a completion queue
+ * \param[in] size The maximum number of completed requests in the queue
+ *
+ * By default, request completion is notified to applications through the
+ * requestCompleted signal, emitted from the internal thread of the camera
+ * manager. Applications that process requests in their own event loop then
+ * need to move the notification to their thread, usually with a mutex and a
+ * wakeup mechanism.
+ *
+ * This function replaces the requestCompleted signal by a completion queue of
+ * \a size entries. Completed requests are pushed to the queue without locking,
+ * and an eventfd, available through completionFd(), is signalled for each
+ * request. Applications shall read the eventfd when it becomes readable, and
+ * then retrieve all completed requests with completedRequest() until it
+ * returns nullptr. Reading the eventfd before retrieving the requests
+ * guarantees no completion can be missed.
+ *
+ * The \a size shall be at least equal to the number of requests the
+ * application queues to the camera at any time. If the queue is full, the
+ * requestCompleted signal is emitted for the request instead. The
+ * bufferCompleted and metadataAvailable signals are emitted regardless of the
+ * completion queue.
+ *
+ * Setting \a size to 0 disables the completion queue and restores delivery
+ * through the requestCompleted signal. Requests that were completed but not
+ * retrieved are dropped when the completion queue is replaced or disabled.
+ *
+ * \context This function shall be synchronized by the caller with other
+ * functions that affect the camera state. It may only be called when the camera
+ * is in the Acquired or Configured state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not in a state where the completion queue
+ * can be set
+ */
+int Camera::setCompletionQueue(unsigned int size)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraAcquired,
+				     Private::CameraConfigured);
+	if (ret < 0)
+		return ret;
+
+	d->completionFd_.reset();
+	d->completionQueue_.clear();
+	d->completionHead_.store(0, std::memory_order_relaxed);
+	d->completionTail_.store(0, std::memory_order_relaxed);
+
+	if (!size)
+		return 0;
+
+	UniqueFD fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	if (!fd.isValid()) {
+		ret = -errno;
+		LOG(Camera, Error)
+			<< "Failed to create completion eventfd: "
+			<< strerror(-ret);
+		return ret;
 	}
 
-	d->pipe_->invokeMethod(&PipelineHandler::queueRequest,
-			       ConnectionTypeQueued, request);
+	/*
+	 * Round the size up to a power of two to keep the queue indices
+	 * consistent when the head and tail counters wrap around.
+	 */
+	unsigned int entries = 1;
+	while (entries < size)
+		entries <<= 1;
+
+	d->completionQueue_.resize(entries);
+	d->completionFd_ = std::move(fd);
+
+	return 0;
+}
+
+/**
+ * \brief Retrieve the file descriptor signalled when requests complete
+ *
+ * The file descriptor is an eventfd that becomes readable when completed
+ * requests are pushed to the completion queue. See setCompletionQueue() for
+ * the details of its usage.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The completion eventfd, or -1 if the completion queue is disabled
+ */
+int Camera::completionFd() const
+{
+	return _d()->completionFd_.get();
+}
+
+/**
+ * \brief Retrieve the next request from the completion queue
+ *
+ * Completed requests are returned in completion order. This function shall
+ * only be called from a single thread at a time.
+ *
+ * \return The next completed request, or nullptr if the completion queue is
+ * empty or disabled
+ */
+Request *Camera::completedRequest()
+{
+	Private *const d = _d();
+
+	unsigned int tail = d->completionTail_.load(std::memory_order_relaxed);
+	unsigned int head = d->completionHead_.load(std::memory_order_acquire);
+	if (tail == head)
+		return nullptr;
+
+	Request *request = d->completionQueue_[tail % d->completionQueue_.size()];
+	d->completionTail_.store(tail + 1, std::memory_order_release);
+
+	return request;
+}
+
+/**
+ * \brief Select the order in which requests are completed
+ * \param[in] order The request completion order
+ *
+ * By default, requests are completed in the order they have been queued. A
+ * request that has been processed is held back until all earlier requests
+ * complete. When requests take different paths through the pipeline, for
+ * instance when some of them capture a still image stream that requires
+ * additional processing, this delays all subsequent requests.
+ *
+ * Setting \a order to CompletionOrder::OutOfOrder completes requests as soon
+ * as they have been processed. Applications that need to restore the queuing
+ * order can use the Request::sequence() number. Buffers of a given stream are
+ * still completed in order. The order applies to all capture sessions until it
+ * is changed.
+ *
+ * \context This function shall be synchronized by the caller with other
+ * functions that affect the camera state. It may only be called when the camera
+ * is in the Acquired or Configured state as defined in \ref camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not in a state where the completion order
+ * can be set
+ */
+int Camera::setCompletionOrder(CompletionOrder order)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraAcquired,
+				     Private::CameraConfigured);
+	if (ret < 0)
+		return ret;
+
+	d->completionOrder_ = order;
 
 	return 0;
 }
@@ -1342,6 +2203,10 @@ int Camera::start(const ControlList *controls)
 
 	ASSERT(d->requestSequence_ == 0);
 
+	d->resetStatistics();
+	d->maxQueuedRequests_ = 0;
+	d->pendingRequests_.store(0, std::memory_order_relaxed);
+
 	ret = d->pipe_->invokeMethod(&PipelineHandler::start,
 				     ConnectionTypeBlocking, this, controls);
 	if (ret)
@@ -1391,11 +2256,100 @@ int Camera::stop()
 
 	ASSERT(!d->pipe_->hasPendingRequests(this));
 
+	if (d->group_)
+		d->group_->_d()->stop(this);
+
 	d->setState(Private::CameraConfigured);
 
 	return 0;
 }
 
+/**
+ * \brief Retrieve the camera statistics
+ *
+ * The statistics report the latency of the frame processing stages, the
+ * latency of requests, and the number of cancelled requests, failed buffers
+ * and dropped frames in the current or last capture session. They are reset
+ * when the camera is started.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return A snapshot of the camera statistics
+ */
+CameraStatistics Camera::statistics() const
+{
+	return _d()->statistics();
+}
+
+/**
+ * \brief Retrieve the camera memory usage
+ *
+ * The memory usage reports the memory currently allocated by libcamera for the
+ * camera, split by purpose. It includes the buffers allocated for the camera
+ * with a FrameBufferAllocator, and the internal and shared memory allocated by
+ * the pipeline handler.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return A snapshot of the camera memory usage
+ */
+CameraMemoryUsage Camera::memoryUsage() const
+{
+	return _d()->memoryUsage();
+}
+
+/**
+ * \brief Set the camera memory budget
+ * \param[in] budget The memory budget in bytes, 0 to lift the limit
+ *
+ * The memory budget limits the total amount of memory that libcamera allocates
+ * for the camera, as reported by memoryUsage(). Pipeline handlers take the
+ * budget into account when selecting the number of buffers in
+ * CameraConfiguration::validate(), reducing the StreamConfiguration
+ * bufferCount and the number of internal buffers as needed, and report the
+ * configuration as invalid if it can't fit in the budget. Allocations that
+ * would exceed the budget, including buffer allocation with a
+ * FrameBufferAllocator, fail with -ENOMEM.
+ *
+ * The budget applies to subsequent configurations and allocations, memory
+ * already allocated is not freed if it exceeds a new budget. The budget should
+ * thus be set before configuring the camera.
+ *
+ * \context This function is \threadsafe. It may only be called when the
+ * camera is in the Acquired or Configured state as defined in \ref
+ * camera_operation.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENODEV The camera has been disconnected from the system
+ * \retval -EACCES The camera is not in a state where the budget can be set
+ */
+int Camera::setMemoryBudget(uint64_t budget)
+{
+	Private *const d = _d();
+
+	int ret = d->isAccessAllowed(Private::CameraAcquired,
+				     Private::CameraConfigured);
+	if (ret < 0)
+		return ret;
+
+	MutexLocker locker(d->memoryLock_);
+	d->memoryBudget_ = budget;
+
+	return 0;
+}
+
+/**
+ * \brief Retrieve the camera memory budget
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The memory budget in bytes, or 0 if the memory usage is unlimited
+ */
+uint64_t Camera::memoryBudget() const
+{
+	return _d()->memoryBudget();
+}
+
 /**
  * \brief Handle request completion and notify application
  * \param[in] request The request that has completed
@@ -1410,7 +2364,14 @@ void Camera::requestComplete(Request *request)
 				  true))
 		LOG(Camera, Fatal) << "Trying to complete a request when stopped";
 
-	requestCompleted.emit(request);
+	Private *const d = _d();
+	unsigned int pending = d->pendingRequests_.fetch_sub(1, std::memory_order_relaxed);
+
+	if (!d->pushCompletedRequest(request))
+		requestCompleted.emit(request);
+
+	if (d->maxQueuedRequests_ && pending == d->maxQueuedRequests_)
+		requestSlotsAvailable.emit();
 }
 
 } /* namespace libcamera */
@@ -7,6 +7,8 @@
 
 #include "libcamera/internal/camera_controls.h"
 
+#include <algorithm>
+
 #include <libcamera/camera.h>
 #include <libcamera/controls.h>
 
@@ -23,6 +25,13 @@ namespace libcamera {
  *
  * This ControlValidator specialisation validates that controls exist in the
  * Camera associated with the validator.
+ *
+ * Controls are validated for every ControlList::set() call on request
+ * controls. To avoid a hash table lookup each time, the validator caches the
+ * set of supported control IDs in a bitmap indexed by control ID. The bitmap
+ * is built at construction time and must be rebuilt with update() when the
+ * camera controls change, which the Camera class does after every successful
+ * configuration.
  */
 
 /**
@@ -32,6 +41,7 @@ namespace libcamera {
 CameraControlValidator::CameraControlValidator(Camera *camera)
 	: camera_(camera)
 {
+	update();
 }
 
 const std::string &CameraControlValidator::name() const
@@ -45,9 +55,27 @@ const std::string &CameraControlValidator::name() const
  * \return True if the control is valid, false otherwise
  */
 bool CameraControlValidator::validate(unsigned int id) const
+{
+	return id < valid_.size() && valid_[id];
+}
+
+/**
+ * \brief Update the validator with the current camera controls
+ *
+ * This function rebuilds the cache of supported control IDs from the camera
+ * ControlInfoMap. It shall be called every time the camera controls change.
+ */
+void CameraControlValidator::update()
 {
 	const ControlInfoMap &controls = camera_->controls();
-	return controls.find(id) != controls.end();
+	unsigned int maxId = 0;
+
+	for (const auto &[id, info] : controls)
+		maxId = std::max(maxId, id->id());
+
+	valid_.assign(controls.empty() ? 0 : maxId + 1, false);
+	for (const auto &[id, info] : controls)
+		valid_[id->id()] = true;
 }
 
 } /* namespace libcamera */
@@ -0,0 +1,332 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Groups of frame-synchronised cameras
+ */
+
+#include "libcamera/internal/camera_group.h"
+
+#include <algorithm>
+#include <cmath>
+#include <errno.h>
+#include <limits>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/camera.h>
+
+#include "libcamera/internal/camera.h"
+#include "libcamera/internal/delayed_controls.h"
+
+/**
+ * \file libcamera/camera_group.h
+ * \brief Groups of frame-synchronised cameras
+ *
+ * \file libcamera/internal/camera_group.h
+ * \brief Camera group private data
+ */
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(Camera)
+
+/**
+ * \class CameraGroup
+ * \brief A group of cameras whose frames are synchronised
+ *
+ * Multi-camera systems, such as stereo rigs, synchronise the exposure of their
+ * sensors with an external trigger signal. Each Camera however queues requests
+ * and applies controls independently, and cameras started at different times
+ * number their frames differently. Without coordination, controls queued for
+ * the same request on two cameras can thus take effect on different triggers.
+ *
+ * The CameraGroup class coordinates the cameras it contains. It matches the
+ * frames captured by the cameras on a common timeline, based on their
+ * controls::SensorTimestamp, and reports the position of each frame on that
+ * timeline in the controls::draft::SyncFrame metadata. Frames that share the
+ * same controls::draft::SyncFrame value have been captured for the same
+ * trigger. The distance between the frame timestamp and the trigger, as
+ * estimated from the timeline, is reported in the controls::draft::SyncError
+ * metadata.
+ *
+ * For cameras whose pipeline handler applies sensor controls through the
+ * DelayedControls class, the group additionally aligns the control queues of
+ * the cameras when they synchronise on the timeline. From that point onwards,
+ * the controls of requests queued to all cameras in lockstep take effect on
+ * the same frame.
+ *
+ * The timeline is defined by the first camera of the group to produce frames,
+ * and assumes all cameras run at the same frame rate. The group doesn't
+ * control the trigger signal itself, which is the responsibility of the
+ * platform.
+ *
+ * Cameras can be added to and removed from a group only while they are not
+ * running. A camera can belong to a single group at a time, and the group
+ * shall not be destroyed while any of its cameras is running.
+ */
+
+/**
+ * \class CameraGroup::Private
+ * \brief Private data for the CameraGroup class
+ *
+ * The Private class tracks the timeline of the group. Its functions are called
+ * by the Camera and PipelineHandler classes when the cameras of the group
+ * complete requests and stop, and are thread-safe.
+ */
+
+/**
+ * \struct CameraGroup::Private::SyncInfo
+ * \brief Position of a frame on the group timeline
+ *
+ * \var CameraGroup::Private::SyncInfo::frame
+ * \brief The frame number on the group timeline
+ *
+ * \var CameraGroup::Private::SyncInfo::error
+ * \brief The distance between the frame timestamp and the timeline, in
+ * nanoseconds
+ */
+
+CameraGroup::Private::Private()
+	: reference_(nullptr), referenceTimestamp_(0), framePeriod_(0.0)
+{
+}
+
+/**
+ * \brief Position a frame on the group timeline
+ * \param[in] camera The camera that captured the frame
+ * \param[in] sequence The sequence number of the frame
+ * \param[in] timestamp The frame start timestamp, in nanoseconds
+ *
+ * The frames of the reference camera, the first camera of the group to
+ * produce frames, define the timeline and measure its frame period. The
+ * frames of the other cameras are matched to the closest frame on the
+ * timeline, which locks the offset between the frame sequence numbers of the
+ * camera and the timeline. The control queues of the cameras are aligned
+ * every time a camera locks.
+ *
+ * \return The position of the frame on the timeline, or std::nullopt if the
+ * timeline isn't known yet
+ */
+std::optional<CameraGroup::Private::SyncInfo>
+CameraGroup::Private::synchronise(Camera *camera, uint32_t sequence,
+				  uint64_t timestamp)
+{
+	MutexLocker locker(mutex_);
+
+	Member *m = member(camera);
+	if (!m)
+		return std::nullopt;
+
+	/* The first camera to produce frames defines the timeline. */
+	if (!reference_ && (m->offset || !referenceFrame_)) {
+		reference_ = camera;
+		if (!m->offset)
+			m->offset = 0;
+	}
+
+	if (camera == reference_) {
+		int64_t frame = sequence + *m->offset;
+
+		if (referenceFrame_ && frame > *referenceFrame_) {
+			double period = static_cast<int64_t>(timestamp - referenceTimestamp_)
+				      / static_cast<double>(frame - *referenceFrame_);
+			framePeriod_ = framePeriod_ ? (framePeriod_ * 7 + period) / 8
+						    : period;
+		}
+
+		referenceFrame_ = frame;
+		referenceTimestamp_ = timestamp;
+
+		return SyncInfo{ frame, 0 };
+	}
+
+	if (!framePeriod_)
+		return std::nullopt;
+
+	/* Match the frame to the closest frame on the timeline. */
+	int64_t delta = static_cast<int64_t>(timestamp - referenceTimestamp_);
+	int64_t frames = std::llround(delta / framePeriod_);
+	int64_t frame = *referenceFrame_ + frames;
+	int64_t error = delta - std::llround(frames * framePeriod_);
+
+	if (!m->offset || sequence + *m->offset != frame) {
+		if (m->offset)
+			LOG(Camera, Warning)
+				<< "Camera " << camera->id()
+				<< " lost synchronisation at frame " << sequence;
+
+		m->offset = frame - sequence;
+		align();
+	}
+
+	return SyncInfo{ frame, error };
+}
+
+/**
+ * \brief Notify the group that a camera has stopped
+ * \param[in] camera The camera
+ *
+ * The camera will lock on the timeline again when restarted. If the camera was
+ * the reference of the timeline, the next camera to produce a frame becomes the
+ * reference.
+ */
+void CameraGroup::Private::stop(Camera *camera)
+{
+	MutexLocker locker(mutex_);
+
+	Member *m = member(camera);
+	if (!m)
+		return;
+
+	m->offset.reset();
+
+	if (reference_ != camera)
+		return;
+
+	reference_ = nullptr;
+
+	/* Reset the timeline if no other camera is locked on it. */
+	if (std::none_of(members_.begin(), members_.end(),
+			 [](const Member &other) { return other.offset; })) {
+		referenceFrame_.reset();
+		referenceTimestamp_ = 0;
+		framePeriod_ = 0.0;
+	}
+}
+
+CameraGroup::Private::Member *CameraGroup::Private::member(Camera *camera)
+{
+	auto it = std::find_if(members_.begin(), members_.end(),
+			       [camera](const Member &m) {
+				       return m.camera.get() == camera;
+			       });
+	return it != members_.end() ? &*it : nullptr;
+}
+
+/*
+ * Align the control queues of the locked cameras, by delaying the next
+ * controls of each camera to the latest frame on the timeline the next
+ * controls of any camera will take effect for.
+ */
+void CameraGroup::Private::align()
+{
+	int64_t target = std::numeric_limits<int64_t>::min();
+
+	for (const Member &m : members_) {
+		DelayedControls *controls = m.camera->_d()->delayedControls_;
+		if (!m.offset || !controls)
+			continue;
+
+		target = std::max(target, controls->nextSequence() + *m.offset);
+	}
+
+	for (const Member &m : members_) {
+		DelayedControls *controls = m.camera->_d()->delayedControls_;
+		if (!m.offset || !controls)
+			continue;
+
+		int64_t sequence = target - *m.offset;
+		if (sequence > controls->nextSequence())
+			controls->skipTo(sequence);
+	}
+}
+
+/**
+ * \brief Construct an empty camera group
+ */
+CameraGroup::CameraGroup()
+	: Extensible(std::make_unique<CameraGroup::Private>())
+{
+}
+
+/**
+ * \brief Destroy the camera group, removing all its cameras
+ */
+CameraGroup::~CameraGroup()
+{
+	Private *const d = _d();
+
+	MutexLocker locker(d->mutex_);
+
+	for (const Private::Member &m : d->members_)
+		m.camera->_d()->group_ = nullptr;
+}
+
+/**
+ * \brief Add a camera to the group
+ * \param[in] camera The camera
+ *
+ * \context This function shall be called while the \a camera is not running.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EBUSY The camera is running or belongs to a group already
+ */
+int CameraGroup::addCamera(std::shared_ptr<Camera> camera)
+{
+	Private *const d = _d();
+	Camera::Private *data = camera->_d();
+
+	if (data->group_ || data->isRunning())
+		return -EBUSY;
+
+	MutexLocker locker(d->mutex_);
+
+	data->group_ = this;
+	d->members_.push_back({ std::move(camera), std::nullopt });
+
+	return 0;
+}
+
+/**
+ * \brief Remove a camera from the group
+ * \param[in] camera The camera
+ *
+ * \context This function shall be called while the \a camera is not running.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENOENT The camera doesn't belong to the group
+ * \retval -EBUSY The camera is running
+ */
+int CameraGroup::removeCamera(Camera *camera)
+{
+	Private *const d = _d();
+
+	if (camera->_d()->group_ != this)
+		return -ENOENT;
+
+	if (camera->_d()->isRunning())
+		return -EBUSY;
+
+	d->stop(camera);
+
+	MutexLocker locker(d->mutex_);
+
+	camera->_d()->group_ = nullptr;
+	d->members_.erase(std::remove_if(d->members_.begin(), d->members_.end(),
+					 [camera](const Private::Member &m) {
+						 return m.camera.get() == camera;
+					 }),
+			  d->members_.end());
+
+	return 0;
+}
+
+/**
+ * \brief Retrieve the cameras of the group
+ * \return The cameras of the group, in the order they have been added
+ */
+std::vector<std::shared_ptr<Camera>> CameraGroup::cameras() const
+{
+	const Private *const d = _d();
+
+	MutexLocker locker(d->mutex_);
+
+	std::vector<std::shared_ptr<Camera>> cameras;
+	for (const Private::Member &m : d->members_)
+		cameras.push_back(m.camera);
+
+	return cameras;
+}
+
+} /* namespace libcamera */
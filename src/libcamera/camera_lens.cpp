@@ -7,8 +7,13 @@
 
 #include "libcamera/internal/camera_lens.h"
 
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+
 #include <libcamera/base/utils.h>
 
+#include "libcamera/internal/camera_lens_properties.h"
 #include "libcamera/internal/v4l2_subdevice.h"
 
 /**
@@ -27,8 +32,25 @@ LOG_DEFINE_CATEGORY(CameraLens)
  * The CameraLens class eases handling of lens for pipeline handlers by
  * hiding the details of the V4L2 subdevice kernel API and caching lens
  * information.
+ *
+ * Lens movements are not instantaneous. The CameraLens keeps track of the time
+ * at which the lens settles after each call to setFocusPosition(), based on
+ * the settle times of the lens model stored in the CameraLensProperties
+ * database. Pipeline handlers use isMoving() to report, for each frame,
+ * whether the lens was moving during its exposure, which lets auto-focus
+ * algorithms use frames as soon as the lens has settled.
  */
 
+namespace {
+
+using namespace std::literals::chrono_literals;
+
+/* Conservative settle times for lens models missing from the database. */
+constexpr utils::Duration kDefaultMinSettleTime = 10ms;
+constexpr utils::Duration kDefaultMaxSettleTime = 30ms;
+
+} /* namespace */
+
 /**
  * \brief Construct a CameraLens
  * \param[in] entity The media entity backing the camera lens controller
@@ -36,7 +58,8 @@ LOG_DEFINE_CATEGORY(CameraLens)
  * Once constructed the instance must be initialized with init().
  */
 CameraLens::CameraLens(const MediaEntity *entity)
-	: entity_(entity)
+	: entity_(entity), staticProps_(nullptr), minPosition_(0),
+	  maxPosition_(0), settled_(0)
 {
 }
 
@@ -73,6 +96,13 @@ int CameraLens::init()
 		return ret;
 
 	model_ = subdev_->model();
+	staticProps_ = CameraLensProperties::get(model_);
+
+	const ControlInfo &focusInfo =
+		subdev_->controls().at(V4L2_CID_FOCUS_ABSOLUTE);
+	minPosition_ = focusInfo.min().get<int32_t>();
+	maxPosition_ = focusInfo.max().get<int32_t>();
+
 	return 0;
 }
 
@@ -81,6 +111,8 @@ int CameraLens::init()
  * \param[in] position The focal point of the lens
  *
  * This function sets the value of focal point of the lens as in \a position.
+ * The lens is considered as moving from the time this function is called until
+ * it settles at the new position, see isMoving().
  *
  * \return 0 on success or -EINVAL otherwise
  */
@@ -92,9 +124,54 @@ int CameraLens::setFocusPosition(int32_t position)
 	if (subdev_->setControls(&lensCtrls))
 		return -EINVAL;
 
+	if (position == position_)
+		return 0;
+
+	auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		utils::clock::now().time_since_epoch());
+	auto settle = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		settleTime(position));
+	settled_ = std::max<uint64_t>(settled_, (now + settle).count());
+	position_ = position;
+
 	return 0;
 }
 
+/**
+ * \fn CameraLens::isMoving()
+ * \brief Check if the lens was moving at a given time
+ * \param[in] timestamp The time to check, in nanoseconds
+ *
+ * The \a timestamp shall be measured against the CLOCK_MONOTONIC clock, as is
+ * the case for V4L2 buffer timestamps. Pipeline handlers pass the frame
+ * timestamp to find out if the lens may have moved during the frame exposure.
+ * All frames captured before the lens settles, including the ones that started
+ * before the movement, are considered as affected by the movement.
+ *
+ * \todo Account for the exposure time and rolling shutter readout
+ *
+ * \return True if the lens had not settled at time \a timestamp, false
+ * otherwise
+ */
+
+utils::Duration CameraLens::settleTime(int32_t position) const
+{
+	utils::Duration minSettleTime = staticProps_ ? staticProps_->minSettleTime
+						     : kDefaultMinSettleTime;
+	utils::Duration maxSettleTime = staticProps_ ? staticProps_->maxSettleTime
+						     : kDefaultMaxSettleTime;
+
+	/* Consider the first movement as spanning the whole range. */
+	int32_t range = maxPosition_ - minPosition_;
+	if (!position_ || range <= 0)
+		return maxSettleTime;
+
+	double distance = std::min(1.0, std::abs(position - *position_) /
+					       static_cast<double>(range));
+
+	return minSettleTime + (maxSettleTime - minSettleTime) * distance;
+}
+
 int CameraLens::validateLensDriver()
 {
 	int ret = 0;
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Database of camera lens properties
+ */
+
+#include "libcamera/internal/camera_lens_properties.h"
+
+#include <map>
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file camera_lens_properties.h
+ * \brief Database of camera lens properties
+ *
+ * The database of camera lens properties collects static information about
+ * lens controllers that is not possible to retrieve from the device at run
+ * time, such as the time the lens takes to settle after a movement.
+ *
+ * The database is indexed using the lens model, as reported by
+ * CameraLens::model(), and for each supported lens it contains a list of
+ * properties.
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(CameraLensProperties)
+
+using namespace std::literals::chrono_literals;
+
+/**
+ * \struct CameraLensProperties
+ * \brief Database of camera lens properties
+ *
+ * \var CameraLensProperties::minSettleTime
+ * \brief The time the lens takes to settle after the smallest movement
+ *
+ * \var CameraLensProperties::maxSettleTime
+ * \brief The time the lens takes to settle after a movement across the whole
+ * focus range
+ *
+ * The settle time of a movement is interpolated linearly between
+ * minSettleTime and maxSettleTime based on the distance travelled by the lens.
+ * The values include the ringing of the voice coil motors, with the default
+ * drive mode of the controller.
+ */
+
+/**
+ * \brief Retrieve the properties associated with a lens
+ * \param lens The lens model name as reported by CameraLens::model()
+ * \return A pointer to the CameraLensProperties instance associated with a
+ * lens or nullptr if the lens is not supported
+ */
+const CameraLensProperties *CameraLensProperties::get(const std::string &lens)
+{
+	static const std::map<std::string, const CameraLensProperties> lensProps = {
+		{ "ad5820", {
+			.minSettleTime = 4ms,
+			.maxSettleTime = 20ms,
+		} },
+		{ "ak7375", {
+			.minSettleTime = 3ms,
+			.maxSettleTime = 12ms,
+		} },
+		{ "dw9714", {
+			.minSettleTime = 4ms,
+			.maxSettleTime = 16ms,
+		} },
+		{ "dw9719", {
+			.minSettleTime = 3ms,
+			.maxSettleTime = 12ms,
+		} },
+		{ "dw9807", {
+			.minSettleTime = 3ms,
+			.maxSettleTime = 12ms,
+		} },
+	};
+
+	const auto it = lensProps.find(lens);
+	if (it == lensProps.end()) {
+		LOG(CameraLensProperties, Warning)
+			<< "No static properties available for '" << lens << "'";
+		LOG(CameraLensProperties, Warning)
+			<< "Please consider updating the camera lens properties database";
+		return nullptr;
+	}
+
+	return &it->second;
+}
+
+} /* namespace libcamera */
@@ -37,12 +37,15 @@ LOG_DEFINE_CATEGORY(Camera)
 CameraManager::Private::Private()
 	: initialized_(false)
 {
+	setThreadName("CameraManager");
 }
 
-int CameraManager::Private::start()
+int CameraManager::Private::start(const std::vector<std::string> &pipelines)
 {
 	int status;
 
+	pipelines_ = pipelines;
+
 	/* Start the thread and wait for initialization to complete. */
 	Thread::start();
 
@@ -111,17 +114,19 @@ void CameraManager::Private::createPipelineHandlers()
 		 * When a list of preferred pipelines is defined, iterate
 		 * through the ordered list to match the enumerated devices.
 		 */
-		for (const auto &pipeName : utils::split(pipesList, ",")) {
-			const PipelineHandlerFactoryBase *factory;
-			factory = PipelineHandlerFactoryBase::getFactoryByName(pipeName);
-			if (!factory)
-				continue;
-
-			LOG(Camera, Debug)
-				<< "Found listed pipeline handler '"
-				<< pipeName << "'";
-			pipelineFactoryMatch(factory);
-		}
+		for (const auto &pipeName : utils::split(pipesList, ","))
+			pipelineFactoryMatch(pipeName);
+
+		return;
+	}
+
+	/*
+	 * When the application has selected pipeline handlers, match them
+	 * only, in the order they have been specified.
+	 */
+	if (!pipelines_.empty()) {
+		for (const std::string &pipeName : pipelines_)
+			pipelineFactoryMatch(pipeName);
 
 		return;
 	}
@@ -142,6 +147,17 @@ void CameraManager::Private::createPipelineHandlers()
 	}
 }
 
+void CameraManager::Private::pipelineFactoryMatch(const std::string &name)
+{
+	const PipelineHandlerFactoryBase *factory =
+		PipelineHandlerFactoryBase::getFactoryByName(name);
+	if (!factory)
+		return;
+
+	LOG(Camera, Debug) << "Found listed pipeline handler '" << name << "'";
+	pipelineFactoryMatch(factory);
+}
+
 void CameraManager::Private::pipelineFactoryMatch(const PipelineHandlerFactoryBase *factory)
 {
 	CameraManager *const o = LIBCAMERA_O_PTR();
@@ -309,10 +325,34 @@ CameraManager::~CameraManager()
  * \return 0 on success or a negative error code otherwise
  */
 int CameraManager::start()
+{
+	return start({});
+}
+
+/**
+ * \brief Start the camera manager with a subset of the pipeline handlers
+ * \param[in] pipelines The names of the pipeline handlers to use
+ *
+ * Start the camera manager as with start(), but only match the pipeline
+ * handlers named in \a pipelines against the devices in the system, in the
+ * order they are listed. The names are the ones passed to the
+ * REGISTER_PIPELINE_HANDLER() macro, and unknown names are ignored.
+ * Applications that know which cameras they will use can skip the matching of
+ * the other pipeline handlers, as well as the creation of their cameras and
+ * IPA modules, which speeds up starting the camera manager and reduces its
+ * memory usage. Devices hotplugged later are also only matched against the
+ * listed pipeline handlers. An empty list selects all pipeline handlers.
+ *
+ * The LIBCAMERA_PIPELINES_MATCH_LIST environment variable, when set, takes
+ * precedence over \a pipelines.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int CameraManager::start(const std::vector<std::string> &pipelines)
 {
 	LOG(Camera, Info) << "libcamera " << version_;
 
-	int ret = _d()->start();
+	int ret = _d()->start(pipelines);
 	if (ret)
 		LOG(Camera, Error) << "Failed to start camera manager: "
 				   << strerror(-ret);
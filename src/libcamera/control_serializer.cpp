@@ -83,6 +83,17 @@ LOG_DEFINE_CATEGORY(Serializer)
  * that time. A reset of the serializer invalidates all ControlList and
  * ControlInfoMap that have been previously deserialized. The caller shall thus
  * proceed with care to avoid stale references.
+ *
+ * Reconfiguring an IPA usually transfers the same ControlInfoMap contents
+ * again. To avoid serializing and deserializing them repeatedly, the
+ * serializer retains the ControlInfoMap instances used since the previous
+ * reset through the next reset. When a ControlInfoMap is serialized, its
+ * contents are compared to the retained ControlInfoMap instances, using a hash
+ * of the serialized data. If an identical ControlInfoMap is found, only a
+ * reference to its handle is serialized, and the deserializer returns the
+ * retained ControlInfoMap. ControlInfoMap instances that haven't been used
+ * between two resets are dropped. Both serializers at the ends of the IPC
+ * boundary shall thus be reset at the same point in the message flow.
  */
 
 /**
@@ -122,24 +133,44 @@ ControlSerializer::ControlSerializer(Role role)
 	 * engineered, but for the time being it avoids collisions on the handle
 	 * value when using IPC.
 	 */
-	serialSeed_ = role == Role::Proxy ? 1 : 2;
-	serial_ = serialSeed_;
+	serial_ = role == Role::Proxy ? 1 : 2;
 }
 
 /**
  * \brief Reset the serializer
  *
  * Reset the internal state of the serializer. This invalidates all the
- * ControlList and ControlInfoMap that have been previously deserialized.
+ * ControlList and ControlInfoMap that have been previously deserialized, with
+ * the exception of the ControlInfoMap instances retained across resets.
+ *
+ * The ControlInfoMap instances serialized or deserialized since the previous
+ * reset are retained, and the other ones are dropped. Handles are not reused
+ * after a reset, to keep referencing the retained ControlInfoMap instances.
  */
 void ControlSerializer::reset()
 {
-	serial_ = serialSeed_;
-
 	infoMapHandles_.clear();
-	infoMaps_.clear();
-	controlIds_.clear();
-	controlIdMaps_.clear();
+
+	for (auto iter = serializedInfoMaps_.begin(); iter != serializedInfoMaps_.end();) {
+		if (!iter->second.used) {
+			iter = serializedInfoMaps_.erase(iter);
+			continue;
+		}
+
+		iter->second.used = false;
+		++iter;
+	}
+
+	for (auto iter = infoMaps_.begin(); iter != infoMaps_.end();) {
+		if (!iter->second.used) {
+			iter = infoMaps_.erase(iter);
+			continue;
+		}
+
+		iter->second.used = false;
+		infoMapHandles_[&iter->second.infoMap] = iter->first;
+		++iter;
+	}
 }
 
 size_t ControlSerializer::binarySize(const ControlValue &value)
@@ -224,10 +255,22 @@ void ControlSerializer::store(const ControlInfo &info, ByteStreamBuffer &buffer)
 int ControlSerializer::serialize(const ControlInfoMap &infoMap,
 				 ByteStreamBuffer &buffer)
 {
-	if (isCached(infoMap)) {
+	/* Prepare the packet header. */
+	struct ipa_controls_header hdr = {};
+	hdr.version = IPA_CONTROLS_FORMAT_VERSION;
+
+	auto iter = infoMapHandles_.find(&infoMap);
+	if (iter != infoMapHandles_.end()) {
 		LOG(Serializer, Debug)
-			<< "Skipping already serialized ControlInfoMap";
-		return 0;
+			<< "Referencing already serialized ControlInfoMap";
+
+		hdr.handle = iter->second;
+		hdr.size = sizeof(hdr);
+		hdr.data_offset = sizeof(hdr);
+		hdr.flags = IPA_CONTROLS_FLAG_CACHED;
+
+		buffer.write(&hdr);
+		return buffer.overflow() ? -ENOSPC : 0;
 	}
 
 	/* Compute entries and data required sizes. */
@@ -246,38 +289,22 @@ int ControlSerializer::serialize(const ControlInfoMap &infoMap,
 	else
 		idMapType = IPA_CONTROL_ID_MAP_V4L2;
 
-	/* Prepare the packet header. */
-	struct ipa_controls_header hdr;
-	hdr.version = IPA_CONTROLS_FORMAT_VERSION;
-	hdr.handle = serial_;
-	hdr.entries = infoMap.size();
-	hdr.size = sizeof(hdr) + entriesSize + valuesSize;
-	hdr.data_offset = sizeof(hdr) + entriesSize;
-	hdr.id_map_type = idMapType;
-
-	buffer.write(&hdr);
-
 	/*
-	 * Increment the handle for the ControlInfoMap by 2 to keep the handles
-	 * numerical space partitioned between instances initialized for a
-	 * different role.
+	 * Serialize all entries in a separate buffer, to compare them with the
+	 * retained ControlInfoMap instances.
 	 *
-	 * \sa ControlSerializer::Role
-	 */
-	serial_ += 2;
-
-	/*
-	 * Serialize all entries.
 	 * \todo Serialize the control name too
 	 */
-	ByteStreamBuffer entries = buffer.carveOut(entriesSize);
-	ByteStreamBuffer values = buffer.carveOut(valuesSize);
+	std::vector<uint8_t> data(entriesSize + valuesSize);
+	ByteStreamBuffer dataBuffer(data.data(), data.size());
+	ByteStreamBuffer entries = dataBuffer.carveOut(entriesSize);
+	ByteStreamBuffer values = dataBuffer.carveOut(valuesSize);
 
 	for (const auto &ctrl : infoMap) {
 		const ControlId *id = ctrl.first;
 		const ControlInfo &info = ctrl.second;
 
-		struct ipa_control_info_entry entry;
+		struct ipa_control_info_entry entry = {};
 		entry.id = id->id();
 		entry.type = id->type();
 		entry.offset = values.offset();
@@ -286,14 +313,68 @@ int ControlSerializer::serialize(const ControlInfoMap &infoMap,
 		store(info, values);
 	}
 
+	/* 64-bit FNV-1a hash of the id map type and serialized entries. */
+	uint64_t hash = 0xcbf29ce484222325ULL ^ idMapType;
+	for (uint8_t byte : data) {
+		hash ^= byte;
+		hash *= 0x100000001b3ULL;
+	}
+
+	auto cached = std::find_if(serializedInfoMaps_.begin(), serializedInfoMaps_.end(),
+				   [&](const decltype(serializedInfoMaps_)::value_type &entry) {
+					   const SerializedInfoMap &map = entry.second;
+					   return map.hash == hash &&
+						  map.idMapType == idMapType &&
+						  map.data == data;
+				   });
+	if (cached != serializedInfoMaps_.end()) {
+		LOG(Serializer, Debug)
+			<< "Referencing retained ControlInfoMap " << cached->first;
+
+		hdr.handle = cached->first;
+		hdr.size = sizeof(hdr);
+		hdr.data_offset = sizeof(hdr);
+		hdr.id_map_type = idMapType;
+		hdr.flags = IPA_CONTROLS_FLAG_CACHED;
+
+		buffer.write(&hdr);
+		if (buffer.overflow())
+			return -ENOSPC;
+
+		cached->second.used = true;
+		infoMapHandles_[&infoMap] = hdr.handle;
+
+		return 0;
+	}
+
+	hdr.handle = serial_;
+	hdr.entries = infoMap.size();
+	hdr.size = sizeof(hdr) + entriesSize + valuesSize;
+	hdr.data_offset = sizeof(hdr) + entriesSize;
+	hdr.id_map_type = idMapType;
+
+	buffer.write(&hdr);
+	buffer.write(Span<const uint8_t>(data));
+
 	if (buffer.overflow())
 		return -ENOSPC;
 
+	/*
+	 * Increment the handle for the ControlInfoMap by 2 to keep the handles
+	 * numerical space partitioned between instances initialized for a
+	 * different role.
+	 *
+	 * \sa ControlSerializer::Role
+	 */
+	serial_ += 2;
+
 	/*
 	 * Store the map to handle association, to be used to serialize and
-	 * deserialize control lists.
+	 * deserialize control lists, and retain the serialized data to
+	 * reference identical maps after a reset.
 	 */
 	infoMapHandles_[&infoMap] = hdr.handle;
+	serializedInfoMaps_[hdr.handle] = { hash, idMapType, std::move(data), true };
 
 	return 0;
 }
@@ -346,7 +427,7 @@ int ControlSerializer::serialize(const ControlList &list,
 		valuesSize += binarySize(ctrl.second);
 
 	/* Prepare the packet header. */
-	struct ipa_controls_header hdr;
+	struct ipa_controls_header hdr = {};
 	hdr.version = IPA_CONTROLS_FORMAT_VERSION;
 	hdr.handle = infoMapHandle;
 	hdr.entries = list.size();
@@ -432,16 +513,24 @@ ControlInfoMap ControlSerializer::deserialize<ControlInfoMap>(ByteStreamBuffer &
 		return {};
 	}
 
+	if (hdr->version != IPA_CONTROLS_FORMAT_VERSION) {
+		LOG(Serializer, Error)
+			<< "Unsupported controls format version "
+			<< hdr->version;
+		return {};
+	}
+
 	auto iter = infoMaps_.find(hdr->handle);
 	if (iter != infoMaps_.end()) {
 		LOG(Serializer, Debug) << "Use cached ControlInfoMap";
-		return iter->second;
+		iter->second.used = true;
+		return iter->second.infoMap;
 	}
 
-	if (hdr->version != IPA_CONTROLS_FORMAT_VERSION) {
+	if (hdr->flags & IPA_CONTROLS_FLAG_CACHED) {
 		LOG(Serializer, Error)
-			<< "Unsupported controls format version "
-			<< hdr->version;
+			<< "Can't deserialize ControlInfoMap: unknown handle "
+			<< hdr->handle;
 		return {};
 	}
 
@@ -453,7 +542,8 @@ ControlInfoMap ControlSerializer::deserialize<ControlInfoMap>(ByteStreamBuffer &
 	 * when deserializing individual ControlInfoMap entries.
 	 */
 	const ControlIdMap *idMap = nullptr;
-	ControlIdMap *localIdMap = nullptr;
+	std::unique_ptr<ControlIdMap> localIdMap;
+	std::vector<std::unique_ptr<ControlId>> controlIds;
 	switch (hdr->id_map_type) {
 	case IPA_CONTROL_ID_MAP_CONTROLS:
 		idMap = &controls::controls;
@@ -462,9 +552,8 @@ ControlInfoMap ControlSerializer::deserialize<ControlInfoMap>(ByteStreamBuffer &
 		idMap = &properties::properties;
 		break;
 	case IPA_CONTROL_ID_MAP_V4L2:
-		controlIdMaps_.emplace_back(std::make_unique<ControlIdMap>());
-		localIdMap = controlIdMaps_.back().get();
-		idMap = localIdMap;
+		localIdMap = std::make_unique<ControlIdMap>();
+		idMap = localIdMap.get();
 		break;
 	default:
 		LOG(Serializer, Error)
@@ -497,9 +586,9 @@ ControlInfoMap ControlSerializer::deserialize<ControlInfoMap>(ByteStreamBuffer &
 			 * \todo Find a way to preserve the control name for
 			 * debugging purpose.
 			 */
-			controlIds_.emplace_back(std::make_unique<ControlId>(entry->id,
-									     "", type));
-			(*localIdMap)[entry->id] = controlIds_.back().get();
+			controlIds.emplace_back(std::make_unique<ControlId>(entry->id,
+									    "", type));
+			(*localIdMap)[entry->id] = controlIds.back().get();
 		}
 
 		const ControlId *controlId = idMap->at(entry->id);
@@ -517,14 +606,17 @@ ControlInfoMap ControlSerializer::deserialize<ControlInfoMap>(ByteStreamBuffer &
 	}
 
 	/*
-	 * Create the ControlInfoMap in the cache, and store the map to handle
-	 * association.
+	 * Create the ControlInfoMap in the cache, along with the ControlId
+	 * instances it references, and store the map to handle association.
 	 */
-	infoMaps_[hdr->handle] = ControlInfoMap(std::move(ctrls), *idMap);
-	ControlInfoMap &map = infoMaps_[hdr->handle];
-	infoMapHandles_[&map] = hdr->handle;
-
-	return map;
+	DeserializedInfoMap &cached = infoMaps_[hdr->handle];
+	cached.infoMap = ControlInfoMap(std::move(ctrls), *idMap);
+	cached.idMap = std::move(localIdMap);
+	cached.controlIds = std::move(controlIds);
+	cached.used = true;
+	infoMapHandles_[&cached.infoMap] = hdr->handle;
+
+	return cached.infoMap;
 }
 
 /**
@@ -635,8 +727,9 @@ ControlList ControlSerializer::deserialize<ControlList>(ByteStreamBuffer &buffer
  * \brief Check if a ControlInfoMap is cached
  * \param[in] infoMap The ControlInfoMap to check
  *
- * The ControlSerializer caches all ControlInfoMaps that it has (de)serialized.
- * This function checks if \a infoMap is in the cache.
+ * The ControlSerializer caches all ControlInfoMaps that it has (de)serialized
+ * since the last reset, as well as the deserialized ControlInfoMaps retained
+ * across the reset. This function checks if \a infoMap is in the cache.
  *
  * \return True if \a infoMap is in the cache or false otherwise
  */
@@ -7,6 +7,7 @@
 
 #include <libcamera/controls.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -87,10 +88,19 @@ static constexpr size_t ControlValueSize[] = {
 /**
  * \class ControlValue
  * \brief Abstract type representing the value of a control
+ *
+ * Values of up to 56 bytes are stored inline in the ControlValue instance,
+ * larger values in memory allocated dynamically. This covers scalar values as
+ * well as the arrays commonly used by controls, such as colour gains, colour
+ * correction matrices, frame duration limits or a few rectangles, which can
+ * thus be set on every request without any memory allocation. A side effect
+ * is that the data referenced by the Span returned by get() for such a value
+ * is part of the ControlValue instance, and is invalidated when the instance
+ * is moved or destroyed.
  */
 
 /** \todo Revisit the ControlValue layout when stabilizing the ABI */
-static_assert(sizeof(ControlValue) == 16, "Invalid size of ControlValue class");
+static_assert(sizeof(ControlValue) == 64, "Invalid size of ControlValue class");
 
 /**
  * \brief Construct an empty ControlValue.
@@ -150,6 +160,50 @@ ControlValue &ControlValue::operator=(const ControlValue &other)
 	return *this;
 }
 
+/**
+ * \brief Construct a ControlValue by moving the content of \a other
+ * \param[in] other The ControlValue to move content from
+ *
+ * The storage of \a other is transferred without copying the data. The
+ * ControlValue \a other is left empty, as if default-constructed.
+ */
+ControlValue::ControlValue(ControlValue &&other) noexcept
+	: type_(other.type_), isArray_(other.isArray_),
+	  numElements_(other.numElements_)
+{
+	memcpy(value_, other.value_, sizeof(value_));
+
+	other.type_ = ControlTypeNone;
+	other.numElements_ = 0;
+}
+
+/**
+ * \brief Replace the content of the ControlValue with the content of \a other
+ * \param[in] other The ControlValue to move content from
+ *
+ * The storage of \a other is transferred without copying the data. The
+ * ControlValue \a other is left empty, as if default-constructed.
+ *
+ * \return The ControlValue with its content replaced with the one of \a other
+ */
+ControlValue &ControlValue::operator=(ControlValue &&other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	release();
+
+	type_ = other.type_;
+	isArray_ = other.isArray_;
+	numElements_ = other.numElements_;
+	memcpy(value_, other.value_, sizeof(value_));
+
+	other.type_ = ControlTypeNone;
+	other.numElements_ = 0;
+
+	return *this;
+}
+
 /**
  * \fn ControlValue::type()
  * \brief Retrieve the data type of the value
@@ -188,7 +242,7 @@ Span<const uint8_t> ControlValue::data() const
 	std::size_t size = numElements_ * ControlValueSize[type_];
 	const uint8_t *data = size > sizeof(value_)
 			    ? reinterpret_cast<const uint8_t *>(storage_)
-			    : reinterpret_cast<const uint8_t *>(&value_);
+			    : value_;
 	return { data, size };
 }
 
@@ -815,6 +869,15 @@ ControlInfoMap::const_iterator ControlInfoMap::find(unsigned int id) const
  * Control lists are constructed with a map of all the controls supported by
  * their object, and an optional ControlValidator to further validate the
  * controls.
+ *
+ * Controls are stored in a contiguous array sorted by numerical ID, and are
+ * iterated in that order. Lists typically hold a few tens of controls at most,
+ * for which a binary search in a contiguous array is faster than a hash table
+ * lookup. Clearing a list doesn't release its storage, which can thus be
+ * reused without any memory allocation when the list is filled again, as for
+ * the controls and metadata of a reused Request. As with std::vector, adding a
+ * control to the list invalidates all references and iterators to the controls
+ * it contains.
  */
 
 /**
@@ -852,6 +915,7 @@ ControlList::ControlList(const ControlInfoMap &infoMap,
 			 const ControlValidator *validator)
 	: validator_(validator), idmap_(&infoMap.idmap()), infoMap_(&infoMap)
 {
+	controls_.reserve(infoMap.size());
 }
 
 /**
@@ -932,8 +996,8 @@ ControlList::ControlList(const ControlInfoMap &infoMap,
  * Only control lists created from the same ControlIdMap or ControlInfoMap may
  * be merged. Attempting to do otherwise results in undefined behaviour.
  *
- * \todo Reimplement or implement an overloaded version which internally uses
- * std::unordered_map::merge() and accepts a non-const argument.
+ * \todo Reimplement or implement an overloaded version which merges the sorted
+ * control arrays in a single pass and accepts a non-const argument.
  */
 void ControlList::merge(const ControlList &source, MergePolicy policy)
 {
@@ -969,7 +1033,7 @@ void ControlList::merge(const ControlList &source, MergePolicy policy)
  */
 bool ControlList::contains(unsigned int id) const
 {
-	return controls_.find(id) != controls_.end();
+	return lookup(id) != nullptr;
 }
 
 /**
@@ -1038,12 +1102,29 @@ const ControlValue &ControlList::get(unsigned int id) const
  * object that the list refers to.
  */
 void ControlList::set(unsigned int id, const ControlValue &value)
+{
+	/*
+	 * The value may be stored in this list, and adding the control would
+	 * then invalidate it. Copy it before looking up the control.
+	 */
+	set(id, ControlValue(value));
+}
+
+/**
+ * \brief Set the value of control \a id to \a value
+ * \param[in] id The control ID
+ * \param[in] value The control value
+ *
+ * This function behaves as set(unsigned int id, const ControlValue &value),
+ * but moves the \a value into the list instead of copying it.
+ */
+void ControlList::set(unsigned int id, ControlValue &&value)
 {
 	ControlValue *val = find(id);
 	if (!val)
 		return;
 
-	*val = value;
+	*val = std::move(value);
 }
 
 /**
@@ -1064,17 +1145,34 @@ void ControlList::set(unsigned int id, const ControlValue &value)
  * nullptr is returned in that case.
  */
 
+ControlList::ControlListMap::const_iterator ControlList::lowerBound(unsigned int id) const
+{
+	return std::lower_bound(controls_.begin(), controls_.end(), id,
+				[](const auto &entry, unsigned int key) {
+					return entry.first < key;
+				});
+}
+
+const ControlValue *ControlList::lookup(unsigned int id) const
+{
+	const auto iter = lowerBound(id);
+	if (iter == controls_.end() || iter->first != id)
+		return nullptr;
+
+	return &iter->second;
+}
+
 const ControlValue *ControlList::find(unsigned int id) const
 {
-	const auto iter = controls_.find(id);
-	if (iter == controls_.end()) {
+	const ControlValue *val = lookup(id);
+	if (!val) {
 		LOG(Controls, Error)
 			<< "Control " << utils::hex(id) << " not found";
 
 		return nullptr;
 	}
 
-	return &iter->second;
+	return val;
 }
 
 ControlValue *ControlList::find(unsigned int id)
@@ -1086,7 +1184,11 @@ ControlValue *ControlList::find(unsigned int id)
 		return nullptr;
 	}
 
-	return &controls_[id];
+	auto iter = controls_.begin() + (lowerBound(id) - controls_.cbegin());
+	if (iter == controls_.end() || iter->first != id)
+		iter = controls_.emplace(iter, id, ControlValue{});
+
+	return &iter->second;
 }
 
 } /* namespace libcamera */
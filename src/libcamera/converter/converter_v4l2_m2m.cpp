@@ -20,6 +20,7 @@
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/media_device.h"
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
 /**
@@ -144,6 +145,8 @@ void V4L2M2MConverter::Stream::stop()
 
 int V4L2M2MConverter::Stream::queueBuffers(FrameBuffer *input, FrameBuffer *output)
 {
+	LIBCAMERA_TRACEPOINT(converter_queue, index_, input, output);
+
 	int ret = m2m_->output()->queueBuffer(input);
 	if (ret < 0)
 		return ret;
@@ -174,6 +177,8 @@ void V4L2M2MConverter::Stream::outputBufferReady(FrameBuffer *buffer)
 
 void V4L2M2MConverter::Stream::captureBufferReady(FrameBuffer *buffer)
 {
+	LIBCAMERA_TRACEPOINT(converter_complete, index_, buffer);
+
 	converter_->outputBufferReady.emit(buffer);
 }
 
@@ -447,6 +452,9 @@ int V4L2M2MConverter::queueBuffers(FrameBuffer *input,
 static std::initializer_list<std::string> compatibles = {
 	"mtk-mdp",
 	"pxp",
+	"mxc-jpeg",
+	"mtk-jpeg",
+	"s5p-jpeg",
 };
 
 REGISTER_CONVERTER("v4l2_m2m", V4L2M2MConverter, compatibles)
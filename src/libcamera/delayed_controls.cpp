@@ -11,6 +11,7 @@
 
 #include <libcamera/controls.h>
 
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/v4l2_device.h"
 
 /**
@@ -36,6 +37,18 @@ LOG_DEFINE_CATEGORY(DelayedControls)
  * control depth the controls are guaranteed to take effect for the correct
  * request. The control depth is determined by the control with the greatest
  * delay.
+ *
+ * Controls pushed to the queue take effect maxDelay() frames after the frame
+ * they are queued for. The nextSequence() function reports the sequence number
+ * of the frame the next pushed controls will take effect for, which allows
+ * scheduling control changes ahead of time. The number of frames that can be
+ * queued ahead, and the history of controls that can be read back with get(),
+ * are limited by the queue depth specified at construction time.
+ *
+ * Each set of pushed controls can be associated with a cookie, an opaque value
+ * that is returned by get() along with the controls in effect for a frame.
+ * Pipeline handlers can use cookies to track the context the controls have
+ * been computed in, for instance an IPA frame context.
  */
 
 /**
@@ -57,11 +70,17 @@ LOG_DEFINE_CATEGORY(DelayedControls)
  * blanking bounds.
  */
 
+/**
+ * \var DelayedControls::kDefaultDepth
+ * \brief The default depth of the control queue, in frames
+ */
+
 /**
  * \brief Construct a DelayedControls instance
  * \param[in] device The V4L2 device the controls have to be applied to
  * \param[in] controlParams Map of the numerical V4L2 control ids to their
  * associated control parameters.
+ * \param[in] depth The depth of the control queue, in frames
  *
  * The control parameters comprise of delays (in frames) and a priority write
  * flag. If this flag is set, the relevant control is written separately from,
@@ -70,10 +89,16 @@ LOG_DEFINE_CATEGORY(DelayedControls)
  * Only controls specified in \a controlParams are handled. If it's desired to
  * mix delayed controls and controls that take effect immediately the immediate
  * controls must be listed in the \a controlParams map with a delay value of 0.
+ *
+ * The \a depth sets the number of frames stored in the control queue. It
+ * shall cover the number of frames the pipeline handler queues controls ahead
+ * of the sensor, plus the largest control delay. Values smaller than the
+ * largest control delay are adjusted.
  */
 DelayedControls::DelayedControls(V4L2Device *device,
-				 const std::unordered_map<uint32_t, ControlParams> &controlParams)
-	: device_(device), maxDelay_(0)
+				 const std::unordered_map<uint32_t, ControlParams> &controlParams,
+				 unsigned int depth)
+	: device_(device), maxDelay_(0), depth_(depth)
 {
 	const ControlInfoMap &controls = device_->controls();
 
@@ -104,20 +129,81 @@ DelayedControls::DelayedControls(V4L2Device *device,
 		maxDelay_ = std::max(maxDelay_, controlParams_[id].delay);
 	}
 
+	if (depth_ <= maxDelay_) {
+		LOG(DelayedControls, Warning)
+			<< "Queue depth " << depth_
+			<< " too small for a delay of " << maxDelay_
+			<< ", adjusting to " << maxDelay_ + 1;
+		depth_ = maxDelay_ + 1;
+	}
+
 	reset();
 }
 
+/**
+ * \fn DelayedControls::depth()
+ * \brief Retrieve the depth of the control queue
+ * \return The number of frames stored in the control queue
+ */
+
+/**
+ * \fn DelayedControls::maxDelay()
+ * \brief Retrieve the largest control delay
+ * \return The delay, in frames, of the control that takes effect last
+ */
+
+/**
+ * \fn DelayedControls::nextSequence()
+ * \brief Retrieve the frame the next pushed controls will take effect for
+ *
+ * Controls pushed with push() take effect for the frame with the returned
+ * sequence number. Callers can use this to schedule control changes, such as
+ * exposure time updates, for a specific frame ahead of time.
+ *
+ * \return The sequence number of the frame the next pushed controls will take
+ * effect for
+ */
+
+/**
+ * \brief Delay the next pushed controls to a later frame
+ * \param[in] sequence The sequence number of the frame
+ *
+ * Queue no-op entries, as is done when the queue runs empty, until the next
+ * controls pushed with push() take effect for the frame with the given
+ * \a sequence number. This is used to apply controls in lockstep across
+ * multiple cameras whose frame sequence numbers are offset. The function has
+ * no effect if nextSequence() is already equal to or larger than \a sequence.
+ * The number of skipped frames is limited by the queue depth.
+ */
+void DelayedControls::skipTo(uint32_t sequence)
+{
+	uint32_t limit = writeCount_ + depth_ - 1 + maxDelay_;
+	if (sequence > limit) {
+		LOG(DelayedControls, Warning)
+			<< "Can't skip to frame " << sequence
+			<< ", limiting to " << limit;
+		sequence = limit;
+	}
+
+	while (nextSequence() < sequence)
+		push({}, cookies_[queueCount_ - 1]);
+}
+
 /**
  * \brief Reset state machine
+ * \param[in] cookie Cookie associated with the controls read from the device
  *
  * Resets the state machine to a starting position based on control values
  * retrieved from the device.
  */
-void DelayedControls::reset()
+void DelayedControls::reset(unsigned int cookie)
 {
 	queueCount_ = 1;
 	writeCount_ = 0;
 
+	cookies_ = RingBuffer<unsigned int>(depth_);
+	cookies_[0] = cookie;
+
 	/* Retrieve control as reported by the device. */
 	std::vector<uint32_t> ids;
 	for (auto const &param : controlParams_)
@@ -127,6 +213,9 @@ void DelayedControls::reset()
 
 	/* Seed the control queue with the controls reported by the device. */
 	values_.clear();
+	for (auto const &param : controlParams_)
+		values_.emplace(param.first, RingBuffer<Info>(depth_));
+
 	for (const auto &ctrl : controls) {
 		const ControlId *id = device_->controls().idmap().at(ctrl.first);
 		/*
@@ -140,14 +229,19 @@ void DelayedControls::reset()
 /**
  * \brief Push a set of controls on the queue
  * \param[in] controls List of controls to add to the device queue
+ * \param[in] cookie Cookie associated with the controls
  *
  * Push a set of controls to the control queue. This increases the control queue
  * depth by one.
  *
  * \returns true if \a controls are accepted, or false otherwise
  */
-bool DelayedControls::push(const ControlList &controls)
+bool DelayedControls::push(const ControlList &controls, unsigned int cookie)
 {
+	if (queueCount_ >= writeCount_ + depth_ - 1)
+		LOG(DelayedControls, Warning)
+			<< "Queue overflow, controls not yet applied are overwritten";
+
 	/* Copy state from previous frame. */
 	for (auto &ctrl : values_) {
 		Info &info = ctrl.second[queueCount_];
@@ -180,6 +274,10 @@ bool DelayedControls::push(const ControlList &controls)
 			<< " at index " << queueCount_;
 	}
 
+	LIBCAMERA_TRACEPOINT(delayed_controls_push, device_->deviceNode().c_str(),
+			     queueCount_, cookie, controls.size());
+
+	cookies_[queueCount_] = cookie;
 	queueCount_++;
 
 	return true;
@@ -188,22 +286,26 @@ bool DelayedControls::push(const ControlList &controls)
 /**
  * \brief Read back controls in effect at a sequence number
  * \param[in] sequence The sequence number to get controls for
+ * \param[out] cookie The cookie associated with the controls, optional
  *
  * Read back what controls where in effect at a specific sequence number. The
- * history is a ring buffer of 16 entries where new and old values coexist. It's
- * the callers responsibility to not read too old sequence numbers that have been
- * pushed out of the history.
+ * history is a ring buffer of depth() entries where new and old values coexist.
+ * It's the callers responsibility to not read too old sequence numbers that
+ * have been pushed out of the history.
  *
  * Historic values are evicted by pushing new values onto the queue using
  * push(). The max history from the current sequence number that yields valid
- * values are thus 16 minus number of controls pushed.
+ * values are thus depth() minus number of controls pushed.
  *
  * \return The controls at \a sequence number
  */
-ControlList DelayedControls::get(uint32_t sequence)
+ControlList DelayedControls::get(uint32_t sequence, unsigned int *cookie)
 {
 	unsigned int index = std::max<int>(0, sequence - maxDelay_);
 
+	if (cookie)
+		*cookie = cookies_[index];
+
 	ControlList out(device_->controls());
 	for (const auto &ctrl : values_) {
 		const ControlId *id = ctrl.first;
@@ -276,10 +378,18 @@ void DelayedControls::applyControls(uint32_t sequence)
 	while (writeCount_ > queueCount_) {
 		LOG(DelayedControls, Debug)
 			<< "Queue is empty, auto queue no-op.";
-		push({});
+		push({}, cookies_[queueCount_ - 1]);
 	}
 
-	device_->setControls(&out);
+	LIBCAMERA_TRACEPOINT(delayed_controls_apply, device_->deviceNode().c_str(),
+			     sequence, out.size());
+
+	/*
+	 * Write the controls along with any control queued to the device by
+	 * other components for this frame.
+	 */
+	device_->queueControls(out);
+	device_->flushControls();
 }
 
 } /* namespace libcamera */
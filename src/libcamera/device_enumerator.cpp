@@ -10,6 +10,8 @@
 #include <string.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_pool.h>
 
 #include "libcamera/internal/device_enumerator_sysfs.h"
 #include "libcamera/internal/device_enumerator_udev.h"
@@ -234,6 +236,51 @@ std::unique_ptr<MediaDevice> DeviceEnumerator::createDevice(const std::string &d
 	return media;
 }
 
+/**
+ * \brief Create multiple media device instances concurrently
+ * \param[in] deviceNodes Paths to the media devices to create
+ *
+ * Create a media device for each entry of \a deviceNodes as createDevice()
+ * does. Populating a media device requires multiple ioctls, whose latency adds
+ * up on systems with many media devices. The devices are thus created
+ * concurrently on the workers of the shared ThreadPool, and this function
+ * waits for all of them to be created before returning.
+ *
+ * \return A vector of the created media devices, in the order of
+ * \a deviceNodes, with a nullptr entry for each device that failed to be
+ * created
+ */
+std::vector<std::unique_ptr<MediaDevice>>
+DeviceEnumerator::createDevices(const std::vector<std::string> &deviceNodes)
+{
+	std::vector<std::unique_ptr<MediaDevice>> devices(deviceNodes.size());
+
+	if (devices.size() <= 1) {
+		for (unsigned int i = 0; i < devices.size(); i++)
+			devices[i] = createDevice(deviceNodes[i]);
+		return devices;
+	}
+
+	Mutex mutex;
+	ConditionVariable cv;
+	unsigned int pending = devices.size();
+
+	for (unsigned int i = 0; i < devices.size(); i++) {
+		ThreadPool::instance()->submit([&, i]() {
+			devices[i] = createDevice(deviceNodes[i]);
+
+			MutexLocker locker(mutex);
+			pending--;
+			cv.notify_one();
+		});
+	}
+
+	MutexLocker locker(mutex);
+	cv.wait(locker, [&]() { return !pending; });
+
+	return devices;
+}
+
 /**
 * \var DeviceEnumerator::devicesAdded
 * \brief Notify of new media devices being found
@@ -252,6 +299,10 @@ std::unique_ptr<MediaDevice> DeviceEnumerator::createDevice(const std::string &d
  * pipeline handlers. \a media shall be created with createDevice() first.
  * This function shall be called after all members of the entities of the
  * media graph have been confirmed to be initialized.
+ *
+ * The devicesAdded signal is not emitted by this function. Device enumerators
+ * that support hotplug shall emit it once they have added a batch of devices,
+ * to let pipeline handlers match all of them in a single pass.
  */
 void DeviceEnumerator::addDevice(std::unique_ptr<MediaDevice> media)
 {
@@ -259,9 +310,6 @@ void DeviceEnumerator::addDevice(std::unique_ptr<MediaDevice> media)
 		<< "Added device " << media->deviceNode() << ": " << media->driver();
 
 	devices_.push_back(std::move(media));
-
-	/* \todo To batch multiple additions, emit with a small delay here. */
-	devicesAdded.emit();
 }
 
 /**
@@ -11,11 +11,13 @@
 #include <fcntl.h>
 #include <fstream>
 #include <stdlib.h>
+#include <string>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/log.h>
 
@@ -32,6 +34,7 @@ int DeviceEnumeratorSysfs::init()
 
 int DeviceEnumeratorSysfs::enumerate()
 {
+	std::vector<std::string> devnodes;
 	struct dirent *ent;
 	DIR *dir;
 
@@ -73,7 +76,12 @@ int DeviceEnumeratorSysfs::enumerate()
 			continue;
 		}
 
-		std::unique_ptr<MediaDevice> media = createDevice(devnode);
+		devnodes.push_back(devnode);
+	}
+
+	closedir(dir);
+
+	for (std::unique_ptr<MediaDevice> &media : createDevices(devnodes)) {
 		if (!media)
 			continue;
 
@@ -88,8 +96,6 @@ int DeviceEnumeratorSysfs::enumerate()
 		addDevice(std::move(media));
 	}
 
-	closedir(dir);
-
 	return 0;
 }
 
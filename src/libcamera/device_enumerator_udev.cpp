@@ -8,15 +8,18 @@
 #include "libcamera/internal/device_enumerator_udev.h"
 
 #include <algorithm>
+#include <chrono>
 #include <fcntl.h>
 #include <libudev.h>
 #include <list>
 #include <map>
+#include <string>
 #include <string.h>
 #include <string_view>
 #include <sys/ioctl.h>
 #include <sys/sysmacros.h>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/event_notifier.h>
 #include <libcamera/base/log.h>
@@ -27,9 +30,21 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(DeviceEnumerator)
 
+namespace {
+
+/*
+ * Time to wait after a hotplug event before processing it. Plugging a device
+ * generates udev events for its media device and all its video and sub-device
+ * nodes in a quick burst, which are coalesced and handled in one go.
+ */
+constexpr std::chrono::milliseconds kHotplugDelay{ 50 };
+
+} /* namespace */
+
 DeviceEnumeratorUdev::DeviceEnumeratorUdev()
-	: udev_(nullptr), monitor_(nullptr), notifier_(nullptr)
+	: udev_(nullptr), monitor_(nullptr), notifier_(nullptr), added_(false)
 {
+	hotplugTimer_.timeout.connect(this, &DeviceEnumeratorUdev::hotplugNotify);
 }
 
 DeviceEnumeratorUdev::~DeviceEnumeratorUdev()
@@ -82,32 +97,7 @@ int DeviceEnumeratorUdev::addUdevDevice(struct udev_device *dev)
 		if (!media)
 			return -ENODEV;
 
-		DependencyMap deps;
-		int ret = populateMediaDevice(media.get(), &deps);
-		if (ret < 0) {
-			LOG(DeviceEnumerator, Warning)
-				<< "Failed to populate media device "
-				<< media->deviceNode()
-				<< " (" << media->driver() << "), skipping";
-			return ret;
-		}
-
-		if (!deps.empty()) {
-			LOG(DeviceEnumerator, Debug)
-				<< "Defer media device " << media->deviceNode()
-				<< " due to " << deps.size()
-				<< " missing dependencies";
-
-			pending_.emplace_back(std::move(media), std::move(deps));
-			MediaDeviceDeps *mediaDeps = &pending_.back();
-			for (const auto &dep : mediaDeps->deps_)
-				devMap_[dep.first] = mediaDeps;
-
-			return 0;
-		}
-
-		addDevice(std::move(media));
-		return 0;
+		return addMediaDevice(std::move(media));
 	}
 
 	if (!strcmp(subsystem, "video4linux")) {
@@ -118,10 +108,43 @@ int DeviceEnumeratorUdev::addUdevDevice(struct udev_device *dev)
 	return -ENODEV;
 }
 
+int DeviceEnumeratorUdev::addMediaDevice(std::unique_ptr<MediaDevice> media)
+{
+	DependencyMap deps;
+
+	int ret = populateMediaDevice(media.get(), &deps);
+	if (ret < 0) {
+		LOG(DeviceEnumerator, Warning)
+			<< "Failed to populate media device "
+			<< media->deviceNode()
+			<< " (" << media->driver() << "), skipping";
+		return ret;
+	}
+
+	if (!deps.empty()) {
+		LOG(DeviceEnumerator, Debug)
+			<< "Defer media device " << media->deviceNode()
+			<< " due to " << deps.size()
+			<< " missing dependencies";
+
+		pending_.emplace_back(std::move(media), std::move(deps));
+		MediaDeviceDeps *mediaDeps = &pending_.back();
+		for (const auto &dep : mediaDeps->deps_)
+			devMap_[dep.first] = mediaDeps;
+
+		return 0;
+	}
+
+	addDevice(std::move(media));
+	added_ = true;
+	return 0;
+}
+
 int DeviceEnumeratorUdev::enumerate()
 {
 	struct udev_enumerate *udev_enum = nullptr;
 	struct udev_list_entry *ents, *ent;
+	std::vector<std::string> devnodes;
 	int ret;
 
 	udev_enum = udev_enumerate_new(udev_);
@@ -170,7 +193,14 @@ int DeviceEnumeratorUdev::enumerate()
 			continue;
 		}
 
-		if (addUdevDevice(dev) < 0)
+		/*
+		 * Defer the creation of media devices to populate them
+		 * concurrently below.
+		 */
+		const char *subsystem = udev_device_get_subsystem(dev);
+		if (subsystem && !strcmp(subsystem, "media"))
+			devnodes.push_back(devnode);
+		else if (addUdevDevice(dev) < 0)
 			LOG(DeviceEnumerator, Warning)
 				<< "Failed to add device for '"
 				<< syspath << "', skipping";
@@ -183,6 +213,19 @@ done:
 	if (ret < 0)
 		return ret;
 
+	for (std::unique_ptr<MediaDevice> &media : createDevices(devnodes)) {
+		if (!media)
+			continue;
+
+		addMediaDevice(std::move(media));
+	}
+
+	/*
+	 * Devices found during enumeration are matched by the caller, only
+	 * notify devices added by hotplug.
+	 */
+	added_ = false;
+
 	ret = udev_monitor_enable_receiving(monitor_);
 	if (ret < 0)
 		return ret;
@@ -324,6 +367,7 @@ int DeviceEnumeratorUdev::addV4L2Device(dev_t devnum)
 			<< deps->media_->deviceNode() << " found";
 		addDevice(std::move(deps->media_));
 		pending_.remove(*deps);
+		added_ = true;
 	}
 
 	return 0;
@@ -331,22 +375,78 @@ int DeviceEnumeratorUdev::addV4L2Device(dev_t devnum)
 
 void DeviceEnumeratorUdev::udevNotify()
 {
-	struct udev_device *dev = udev_monitor_receive_device(monitor_);
-	std::string_view action(udev_device_get_action(dev));
-	std::string_view deviceNode(udev_device_get_devnode(dev));
+	/*
+	 * Drain all the events queued on the monitor. Additions are deferred to
+	 * hotplugNotify() to process them in a batch, removals are handled
+	 * immediately to disconnect the cameras as soon as possible.
+	 */
+	while (struct udev_device *dev = udev_monitor_receive_device(monitor_)) {
+		std::string_view action(udev_device_get_action(dev));
+		const char *devnode = udev_device_get_devnode(dev);
+		const char *subsystem = udev_device_get_subsystem(dev);
+		std::string deviceNode(devnode ? devnode : "");
 
-	LOG(DeviceEnumerator, Debug)
-		<< action << " device " << deviceNode;
+		LOG(DeviceEnumerator, Debug)
+			<< action << " device " << deviceNode;
 
-	if (action == "add") {
-		addUdevDevice(dev);
-	} else if (action == "remove") {
-		const char *subsystem = udev_device_get_subsystem(dev);
-		if (subsystem && !strcmp(subsystem, "media"))
-			removeDevice(std::string(deviceNode));
+		if (!subsystem) {
+			udev_device_unref(dev);
+			continue;
+		}
+
+		if (action == "add") {
+			if (!strcmp(subsystem, "media"))
+				hotplugMedia_.push_back(deviceNode);
+			else if (!strcmp(subsystem, "video4linux"))
+				hotplugV4L2_.push_back(udev_device_get_devnum(dev));
+		} else if (action == "remove" && !strcmp(subsystem, "media")) {
+			/*
+			 * A media device removed before its addition has been
+			 * processed only needs to be dropped from the queue.
+			 */
+			auto it = std::find(hotplugMedia_.begin(),
+					    hotplugMedia_.end(), deviceNode);
+			if (it != hotplugMedia_.end())
+				hotplugMedia_.erase(it);
+			else
+				removeDevice(deviceNode);
+		}
+
+		udev_device_unref(dev);
+	}
+
+	if ((!hotplugMedia_.empty() || !hotplugV4L2_.empty()) &&
+	    !hotplugTimer_.isRunning())
+		hotplugTimer_.start(kHotplugDelay);
+}
+
+void DeviceEnumeratorUdev::hotplugNotify()
+{
+	std::vector<std::string> devnodes = std::move(hotplugMedia_);
+	std::vector<dev_t> devnums = std::move(hotplugV4L2_);
+	hotplugMedia_.clear();
+	hotplugV4L2_.clear();
+
+	/*
+	 * Populate the media devices concurrently first, the V4L2 devices then
+	 * resolve their dependencies, or become orphans for media devices that
+	 * haven't been plugged yet.
+	 */
+	for (std::unique_ptr<MediaDevice> &media : createDevices(devnodes)) {
+		if (!media)
+			continue;
+
+		addMediaDevice(std::move(media));
 	}
 
-	udev_device_unref(dev);
+	for (dev_t devnum : devnums)
+		addV4L2Device(devnum);
+
+	/* Match all the complete media devices with pipeline handlers at once. */
+	if (added_) {
+		added_ = false;
+		devicesAdded.emit();
+	}
 }
 
 } /* namespace libcamera */
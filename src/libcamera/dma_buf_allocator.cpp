@@ -8,8 +8,11 @@
 
 #include "libcamera/internal/dma_buf_allocator.h"
 
+#include <algorithm>
 #include <array>
+#include <errno.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -60,6 +63,17 @@ LOG_DEFINE_CATEGORY(DmaBufAllocator)
  * Different providers may provide dma-buffers with different properties for
  * the underlying memory. Which providers are acceptable is specified through
  * the type argument passed to the DmaBufAllocator() constructor.
+ *
+ * In addition to one-off allocations with alloc(), the DmaBufAllocator manages
+ * a pool of recycled dma-buffers through acquire(). Pooled buffers are rounded
+ * up to a size class, and are returned to the pool automatically when all
+ * references to them have been released. Users that repeatedly allocate
+ * buffers of similar sizes, for instance on every camera configuration, can
+ * then reuse existing dma-buffers instead of allocating new memory. The pool
+ * can be pre-warmed with reserve() and emptied of unused buffers with trim().
+ *
+ * The pool is not thread-safe, all calls to acquire(), reserve() and trim()
+ * shall be made from the same thread.
  */
 
 /**
@@ -71,6 +85,14 @@ LOG_DEFINE_CATEGORY(DmaBufAllocator)
  * \brief Allocate from the system dma-heap, using the page allocator
  * \var DmaBufAllocator::UDmaBuf
  * \brief Allocate using a memfd + /dev/udmabuf
+ * \var DmaBufAllocator::HugePages
+ * \brief Back udmabuf allocations with huge pages when available
+ *
+ * The HugePages flag doesn't select a provider. It reduces TLB pressure when
+ * the CPU accesses large buffers allocated from the udmabuf provider, and
+ * falls back to regular pages when no huge pages are available. It is ignored
+ * for the dma-heap providers, as the CMA heap already provides physically
+ * contiguous memory.
  */
 
 /**
@@ -92,6 +114,7 @@ LOG_DEFINE_CATEGORY(DmaBufAllocator)
  * requested types can work on the system, which provider is used is undefined.
  */
 DmaBufAllocator::DmaBufAllocator(DmaBufAllocatorFlags type)
+	: hugePages_(type & DmaBufAllocatorFlag::HugePages)
 {
 	for (const auto &info : providerInfos) {
 		if (!(type & info.type))
@@ -127,6 +150,17 @@ DmaBufAllocator::~DmaBufAllocator() = default;
  * \return True if the DmaBufAllocator is valid, false otherwise
  */
 
+/**
+ * \fn DmaBufAllocator::type()
+ * \brief Retrieve the type of the dma-buf provider in use
+ *
+ * The type reports the backing memory of the allocated buffers. Buffers
+ * allocated from the CmaHeap provider are physically contiguous.
+ *
+ * \return The dma-buf provider type, undefined if the DmaBufAllocator is
+ * invalid
+ */
+
 /* uClibc doesn't provide the file sealing API. */
 #ifndef __DOXYGEN__
 #if not HAVE_FILE_SEALS
@@ -135,12 +169,62 @@ DmaBufAllocator::~DmaBufAllocator() = default;
 #endif
 #endif
 
-UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB		0x0004U
+#endif
+
+/*
+ * Create a memfd backed by huge pages, with its size rounded up to the huge
+ * page size and the memory allocated upfront. Failures are expected on systems
+ * without huge pages available and are thus not reported as errors.
+ */
+UniqueFD DmaBufAllocator::createHugeMemFd(const char *name, std::size_t *size)
 {
-	/* Size must be a multiple of the page size. Round it up. */
-	std::size_t pageMask = sysconf(_SC_PAGESIZE) - 1;
-	size = (size + pageMask) & ~pageMask;
+	unsigned int flags = MFD_HUGETLB | MFD_ALLOW_SEALING | MFD_CLOEXEC;
 
+#if HAVE_MEMFD_CREATE
+	int ret = memfd_create(name, flags);
+#else
+	int ret = syscall(SYS_memfd_create, name, flags);
+#endif
+	if (ret < 0) {
+		LOG(DmaBufAllocator, Debug)
+			<< "Failed to create huge pages memfd for " << name
+			<< ": " << strerror(errno);
+		return {};
+	}
+
+	UniqueFD memfd(ret);
+
+	/* The block size of hugetlbfs files is the huge page size. */
+	struct stat st;
+	ret = fstat(memfd.get(), &st);
+	if (ret < 0)
+		return {};
+
+	std::size_t hugeMask = st.st_blksize - 1;
+	std::size_t hugeSize = (*size + hugeMask) & ~hugeMask;
+
+	/*
+	 * Allocate the huge pages now instead of when udmabuf pins them, to
+	 * fall back to regular pages if the huge pages pool is exhausted.
+	 */
+	ret = fallocate(memfd.get(), 0, 0, hugeSize);
+	if (ret < 0) {
+		LOG(DmaBufAllocator, Debug)
+			<< "Failed to allocate " << hugeSize
+			<< " bytes of huge pages for " << name
+			<< ": " << strerror(errno);
+		return {};
+	}
+
+	*size = hugeSize;
+
+	return memfd;
+}
+
+UniqueFD DmaBufAllocator::createMemFd(const char *name, std::size_t size)
+{
 #if HAVE_MEMFD_CREATE
 	int ret = memfd_create(name, MFD_ALLOW_SEALING | MFD_CLOEXEC);
 #else
@@ -165,8 +249,31 @@ UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
 		return {};
 	}
 
+	return memfd;
+}
+
+UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
+{
+	/* Size must be a multiple of the page size. Round it up. */
+	std::size_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+	size = (size + pageMask) & ~pageMask;
+
+	UniqueFD memfd;
+	bool hugePages = false;
+
+	if (hugePages_) {
+		memfd = createHugeMemFd(name, &size);
+		hugePages = memfd.isValid();
+	}
+
+	if (!memfd.isValid()) {
+		memfd = createMemFd(name, size);
+		if (!memfd.isValid())
+			return {};
+	}
+
 	/* udmabuf dma-buffers *must* have the F_SEAL_SHRINK seal. */
-	ret = fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK);
+	int ret = fcntl(memfd.get(), F_ADD_SEALS, F_SEAL_SHRINK);
 	if (ret < 0) {
 		ret = errno;
 		LOG(DmaBufAllocator, Error)
@@ -183,6 +290,17 @@ UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
 	create.size = size;
 
 	ret = ::ioctl(providerHandle_.get(), UDMABUF_CREATE, &create);
+	if (ret < 0 && hugePages) {
+		/*
+		 * Older kernels can't create udmabufs from hugetlbfs memfds.
+		 * Stop trying and fall back to regular pages.
+		 */
+		LOG(DmaBufAllocator, Warning)
+			<< "udmabuf doesn't support huge pages, disabling them";
+		hugePages_ = false;
+		return allocFromUDmaBuf(name, size);
+	}
+
 	if (ret < 0) {
 		ret = errno;
 		LOG(DmaBufAllocator, Error)
@@ -191,6 +309,10 @@ UniqueFD DmaBufAllocator::allocFromUDmaBuf(const char *name, std::size_t size)
 		return {};
 	}
 
+	LOG(DmaBufAllocator, Debug)
+		<< "Allocated " << size << " bytes for " << name << " from "
+		<< (hugePages ? "huge pages" : "regular pages");
+
 	/* The underlying memfd is kept as as a reference in the kernel. */
 	return UniqueFD(ret);
 }
@@ -243,4 +365,211 @@ UniqueFD DmaBufAllocator::alloc(const char *name, std::size_t size)
 		return allocFromHeap(name, size);
 }
 
+/**
+ * \brief Compute the pool size class of a buffer size
+ * \param[in] size The buffer size
+ *
+ * Sizes are rounded up to the page size, and then to one eighth of the largest
+ * power of two they contain. This bounds the memory overhead of size classes
+ * to 12.5% while allowing buffers of slightly different sizes to be recycled.
+ *
+ * \return The size class for \a size
+ */
+std::size_t DmaBufAllocator::sizeClass(std::size_t size) const
+{
+	std::size_t pageSize = sysconf(_SC_PAGESIZE);
+	size = (size + pageSize - 1) / pageSize * pageSize;
+
+	std::size_t granule = pageSize;
+	while (granule * 16 <= size)
+		granule *= 2;
+
+	return (size + granule - 1) / granule * granule;
+}
+
+/**
+ * \brief Acquire a dma-buf from the DmaBufAllocator pool
+ * \param [in] name The name to set for the buffer
+ * \param [in] size The minimum size of the buffer
+ *
+ * Acquire a dma-buf with read/write access and at least \a size bytes. If the
+ * pool contains an unused buffer of the same size class, it is renamed to \a
+ * name and returned. Otherwise a new buffer is allocated and added to the
+ * pool.
+ *
+ * The buffer is returned to the pool when all references to the returned
+ * SharedFD, and to any copy of it, have been released. Duplicating the file
+ * descriptor with SharedFD::dup() bypasses this tracking and shall be avoided.
+ *
+ * If the allocation fails, return an invalid SharedFD.
+ *
+ * \return The SharedFD of the acquired buffer
+ */
+SharedFD DmaBufAllocator::acquire(const char *name, std::size_t size)
+{
+	if (!name)
+		return SharedFD();
+
+	size = sizeClass(size);
+
+	for (PoolEntry &entry : pool_) {
+		if (entry.size != size || entry.fd.useCount() != 1)
+			continue;
+
+		int ret = ::ioctl(entry.fd.get(), DMA_BUF_SET_NAME, name);
+		if (ret < 0)
+			LOG(DmaBufAllocator, Debug)
+				<< "Failed to rename recycled dma-buf to " << name;
+
+		return entry.fd;
+	}
+
+	SharedFD fd(alloc(name, size));
+	if (!fd.isValid())
+		return SharedFD();
+
+	pool_.push_back({ size, fd });
+
+	return fd;
+}
+
+/**
+ * \brief Pre-allocate buffers in the DmaBufAllocator pool
+ * \param [in] size The minimum size of the buffers
+ * \param [in] count The number of buffers
+ *
+ * Ensure the pool contains at least \a count buffers of the size class of \a
+ * size, allocating the missing buffers. This allows moving the cost of the
+ * allocation out of time-critical paths. Buffers already acquired count
+ * towards \a count.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int DmaBufAllocator::reserve(std::size_t size, unsigned int count)
+{
+	size = sizeClass(size);
+
+	unsigned int available = 0;
+	for (const PoolEntry &entry : pool_) {
+		if (entry.size == size)
+			available++;
+	}
+
+	for (; available < count; ++available) {
+		SharedFD fd(alloc("libcamera-pool", size));
+		if (!fd.isValid())
+			return -ENOMEM;
+
+		pool_.push_back({ size, std::move(fd) });
+	}
+
+	return 0;
+}
+
+/**
+ * \brief Free the unused buffers from the DmaBufAllocator pool
+ *
+ * Buffers that are currently acquired stay in the pool and will be recycled
+ * when released.
+ */
+void DmaBufAllocator::trim()
+{
+	auto last = std::remove_if(pool_.begin(), pool_.end(),
+				   [](const PoolEntry &entry) {
+					   return entry.fd.useCount() == 1;
+				   });
+	pool_.erase(last, pool_.end());
+}
+
+/**
+ * \class DmaSyncer
+ * \brief Helper class for dma-buf's synchronization
+ *
+ * This class wraps a userspace dma-buf's synchronization process with an
+ * object's lifetime.
+ *
+ * It's used when the user needs to access a dma-buf with CPU, mostly mapped
+ * with MappedFrameBuffer, so that the buffer is synchronized between CPU and
+ * ISP.
+ */
+
+/**
+ * \enum DmaSyncer::SyncType
+ * \brief Read and/or write access via the CPU map
+ * \var DmaSyncer::Read
+ * \brief Indicates that the mapped dma-buf will be read by the client via the
+ * CPU map
+ * \var DmaSyncer::Write
+ * \brief Indicates that the mapped dma-buf will be written by the client via
+ * the CPU map
+ * \var DmaSyncer::ReadWrite
+ * \brief Indicates that the mapped dma-buf will be read and written by the
+ * client via the CPU map
+ */
+
+/**
+ * \brief Construct a DmaSyncer with a dma-buf's fd and the access type
+ * \param[in] fd The dma-buf's file descriptor to synchronize
+ * \param[in] type Read and/or write access via the CPU map
+ */
+DmaSyncer::DmaSyncer(SharedFD fd, SyncType type)
+	: fd_(fd)
+{
+	switch (type) {
+	case SyncType::Read:
+		flags_ = DMA_BUF_SYNC_READ;
+		break;
+	case SyncType::Write:
+		flags_ = DMA_BUF_SYNC_WRITE;
+		break;
+	case SyncType::ReadWrite:
+		flags_ = DMA_BUF_SYNC_RW;
+		break;
+	}
+
+	sync(DMA_BUF_SYNC_START);
+}
+
+/**
+ * \fn DmaSyncer::DmaSyncer(DmaSyncer &&other);
+ * \param[in] other The other instance
+ * \brief Enable move on class DmaSyncer
+ */
+
+/**
+ * \fn DmaSyncer::operator=(DmaSyncer &&other);
+ * \param[in] other The other instance
+ * \brief Enable move on class DmaSyncer
+ */
+
+DmaSyncer::~DmaSyncer()
+{
+	/*
+	 * Don't sync if the object has been moved, as the fd is then held by
+	 * the new instance.
+	 */
+	if (fd_.isValid())
+		sync(DMA_BUF_SYNC_END);
+}
+
+void DmaSyncer::sync(uint64_t step)
+{
+	struct dma_buf_sync sync = {
+		.flags = flags_ | step
+	};
+
+	int ret;
+	do {
+		ret = ioctl(fd_.get(), DMA_BUF_IOCTL_SYNC, &sync);
+	} while (ret && (errno == EINTR || errno == EAGAIN));
+
+	if (ret) {
+		ret = errno;
+		LOG(DmaBufAllocator, Error)
+			<< "Unable to sync dma fd: " << fd_.get()
+			<< ", err: " << strerror(ret)
+			<< ", flags: " << sync.flags;
+	}
+}
+
 } /* namespace libcamera */
@@ -42,6 +42,10 @@ namespace libcamera {
  * be implemented by extending or subclassing this class and implementing
  * opportune handling in the core library.
  *
+ * Fences can also be exported by libcamera to signal the completion of frame
+ * buffers, see Request::exportFence(). Those output fences are backed by an
+ * eventfd, and are signalled by reporting read events as well.
+ *
  * \internal
  *
  * The Fence class is a thin abstraction around a UniqueFD which simply allows
@@ -9,12 +9,16 @@
 
 #include <algorithm>
 #include <errno.h>
+#include <string_view>
+#include <tuple>
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/utils.h>
 
 #include <libcamera/formats.h>
 
+#include "libcamera/internal/sorted_table.h"
+
 /**
  * \file internal/formats.h
  * \brief Types and helper functions to handle libcamera image formats
@@ -44,7 +48,7 @@ LOG_DEFINE_CATEGORY(Formats)
  *
  * Multiple V4L2 formats may exist for one PixelFormat, as V4L2 defines
  * separate 4CCs for contiguous and non-contiguous versions of the same image
- * format.
+ * format. Unused entries at the end of the array are invalid.
  *
  * \var PixelFormatInfo::bitsPerPixel
  * \brief The average number of bits per pixel
@@ -146,11 +150,21 @@ LOG_DEFINE_CATEGORY(Formats)
 
 namespace {
 
-const PixelFormatInfo pixelFormatInfoInvalid{};
+constexpr PixelFormatInfo pixelFormatInfoInvalid{};
+
+constexpr std::tuple<uint32_t, uint64_t> formatKey(const PixelFormatInfo &info)
+{
+	return { info.format.fourcc(), info.format.modifier() };
+}
+
+constexpr std::string_view nameKey(const PixelFormatInfo &info)
+{
+	return info.name;
+}
 
-const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
+constexpr PixelFormatInfo pixelFormatInfoEntries[] = {
 	/* RGB formats. */
-	{ formats::RGB565, {
+	{
 		.name = "RGB565",
 		.format = formats::RGB565,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_RGB565), },
@@ -159,8 +173,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::RGB565_BE, {
+	},
+	{
 		.name = "RGB565_BE",
 		.format = formats::RGB565_BE,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_RGB565X), },
@@ -169,8 +183,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::BGR888, {
+	},
+	{
 		.name = "BGR888",
 		.format = formats::BGR888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_RGB24), },
@@ -179,8 +193,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::RGB888, {
+	},
+	{
 		.name = "RGB888",
 		.format = formats::RGB888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_BGR24), },
@@ -189,8 +203,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::XRGB8888, {
+	},
+	{
 		.name = "XRGB8888",
 		.format = formats::XRGB8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_XBGR32), },
@@ -199,8 +213,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::XBGR8888, {
+	},
+	{
 		.name = "XBGR8888",
 		.format = formats::XBGR8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_RGBX32), },
@@ -209,8 +223,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::RGBX8888, {
+	},
+	{
 		.name = "RGBX8888",
 		.format = formats::RGBX8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_BGRX32), },
@@ -219,8 +233,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::BGRX8888, {
+	},
+	{
 		.name = "BGRX8888",
 		.format = formats::BGRX8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_XRGB32), },
@@ -229,8 +243,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::ABGR8888, {
+	},
+	{
 		.name = "ABGR8888",
 		.format = formats::ABGR8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_RGBA32), },
@@ -239,8 +253,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::ARGB8888, {
+	},
+	{
 		.name = "ARGB8888",
 		.format = formats::ARGB8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_ABGR32), },
@@ -249,8 +263,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::BGRA8888, {
+	},
+	{
 		.name = "BGRA8888",
 		.format = formats::BGRA8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_ARGB32), },
@@ -259,8 +273,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::RGBA8888, {
+	},
+	{
 		.name = "RGBA8888",
 		.format = formats::RGBA8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_BGRA32), },
@@ -269,8 +283,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::BGR161616, {
+	},
+	{
 		.name = "BGR161616",
 		.format = formats::BGR161616,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_RGB48), },
@@ -279,8 +293,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::RGB161616, {
+	},
+	{
 		.name = "RGB161616",
 		.format = formats::RGB161616,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_BGR48), },
@@ -289,10 +303,10 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
+	},
 
 	/* YUV packed formats. */
-	{ formats::YUYV, {
+	{
 		.name = "YUYV",
 		.format = formats::YUYV,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YUYV), },
@@ -301,8 +315,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::YVYU, {
+	},
+	{
 		.name = "YVYU",
 		.format = formats::YVYU,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YVYU), },
@@ -311,8 +325,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::UYVY, {
+	},
+	{
 		.name = "UYVY",
 		.format = formats::UYVY,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_UYVY), },
@@ -321,8 +335,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::VYUY, {
+	},
+	{
 		.name = "VYUY",
 		.format = formats::VYUY,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_VYUY), },
@@ -331,8 +345,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::AVUY8888, {
+	},
+	{
 		.name = "AVUY8888",
 		.format = formats::AVUY8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YUVA32), },
@@ -341,8 +355,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::XVUY8888, {
+	},
+	{
 		.name = "XVUY8888",
 		.format = formats::XVUY8888,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YUVX32), },
@@ -351,10 +365,10 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
+	},
 
 	/* YUV planar formats. */
-	{ formats::NV12, {
+	{
 		.name = "NV12",
 		.format = formats::NV12,
 		.v4l2Formats = {
@@ -366,8 +380,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 2, 2 }, { 0, 0 } }},
-	} },
-	{ formats::NV21, {
+	},
+	{
 		.name = "NV21",
 		.format = formats::NV21,
 		.v4l2Formats = {
@@ -379,8 +393,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 2, 2 }, { 0, 0 } }},
-	} },
-	{ formats::NV16, {
+	},
+	{
 		.name = "NV16",
 		.format = formats::NV16,
 		.v4l2Formats = {
@@ -392,8 +406,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 2, 1 }, { 0, 0 } }},
-	} },
-	{ formats::NV61, {
+	},
+	{
 		.name = "NV61",
 		.format = formats::NV61,
 		.v4l2Formats = {
@@ -405,8 +419,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 2, 1 }, { 0, 0 } }},
-	} },
-	{ formats::NV24, {
+	},
+	{
 		.name = "NV24",
 		.format = formats::NV24,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_NV24), },
@@ -415,8 +429,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 2, 1 }, { 0, 0 } }},
-	} },
-	{ formats::NV42, {
+	},
+	{
 		.name = "NV42",
 		.format = formats::NV42,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_NV42), },
@@ -425,8 +439,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 2, 1 }, { 0, 0 } }},
-	} },
-	{ formats::YUV420, {
+	},
+	{
 		.name = "YUV420",
 		.format = formats::YUV420,
 		.v4l2Formats = {
@@ -438,8 +452,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 1, 2 }, { 1, 2 } }},
-	} },
-	{ formats::YVU420, {
+	},
+	{
 		.name = "YVU420",
 		.format = formats::YVU420,
 		.v4l2Formats = {
@@ -451,8 +465,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 1, 2 }, { 1, 2 } }},
-	} },
-	{ formats::YUV422, {
+	},
+	{
 		.name = "YUV422",
 		.format = formats::YUV422,
 		.v4l2Formats = {
@@ -464,8 +478,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 1, 1 }, { 1, 1 } }},
-	} },
-	{ formats::YVU422, {
+	},
+	{
 		.name = "YVU422",
 		.format = formats::YVU422,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YVU422M), },
@@ -474,8 +488,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 1, 1 }, { 1, 1 } }},
-	} },
-	{ formats::YUV444, {
+	},
+	{
 		.name = "YUV444",
 		.format = formats::YUV444,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YUV444M), },
@@ -484,8 +498,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 1, 1 }, { 1, 1 } }},
-	} },
-	{ formats::YVU444, {
+	},
+	{
 		.name = "YVU444",
 		.format = formats::YVU444,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_YVU444M), },
@@ -494,10 +508,10 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 1, 1 }, { 1, 1 } }},
-	} },
+	},
 
 	/* Greyscale formats. */
-	{ formats::R8, {
+	{
 		.name = "R8",
 		.format = formats::R8,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_GREY), },
@@ -506,8 +520,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::R10, {
+	},
+	{
 		.name = "R10",
 		.format = formats::R10,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_Y10), },
@@ -516,8 +530,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::R10_CSI2P, {
+	},
+	{
 		.name = "R10_CSI2P",
 		.format = formats::R10_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_Y10P), },
@@ -526,8 +540,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 5, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::R12, {
+	},
+	{
 		.name = "R12",
 		.format = formats::R12,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_Y12), },
@@ -536,8 +550,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::R16, {
+	},
+	{
 		.name = "R16",
 		.format = formats::R16,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_Y16), },
@@ -546,8 +560,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::MONO_PISP_COMP1, {
+	},
+	{
 		.name = "MONO_PISP_COMP1",
 		.format = formats::MONO_PISP_COMP1,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_PISP_COMP1_MONO), },
@@ -556,10 +570,10 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
+	},
 
 	/* Bayer formats. */
-	{ formats::SBGGR8, {
+	{
 		.name = "SBGGR8",
 		.format = formats::SBGGR8,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR8), },
@@ -568,8 +582,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG8, {
+	},
+	{
 		.name = "SGBRG8",
 		.format = formats::SGBRG8,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG8), },
@@ -578,8 +592,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG8, {
+	},
+	{
 		.name = "SGRBG8",
 		.format = formats::SGRBG8,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG8), },
@@ -588,8 +602,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB8, {
+	},
+	{
 		.name = "SRGGB8",
 		.format = formats::SRGGB8,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB8), },
@@ -598,8 +612,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR10, {
+	},
+	{
 		.name = "SBGGR10",
 		.format = formats::SBGGR10,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR10), },
@@ -608,8 +622,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG10, {
+	},
+	{
 		.name = "SGBRG10",
 		.format = formats::SGBRG10,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG10), },
@@ -618,8 +632,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG10, {
+	},
+	{
 		.name = "SGRBG10",
 		.format = formats::SGRBG10,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG10), },
@@ -628,8 +642,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB10, {
+	},
+	{
 		.name = "SRGGB10",
 		.format = formats::SRGGB10,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB10), },
@@ -638,8 +652,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR10_CSI2P, {
+	},
+	{
 		.name = "SBGGR10_CSI2P",
 		.format = formats::SBGGR10_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR10P), },
@@ -648,8 +662,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 5, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG10_CSI2P, {
+	},
+	{
 		.name = "SGBRG10_CSI2P",
 		.format = formats::SGBRG10_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG10P), },
@@ -658,8 +672,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 5, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG10_CSI2P, {
+	},
+	{
 		.name = "SGRBG10_CSI2P",
 		.format = formats::SGRBG10_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG10P), },
@@ -668,8 +682,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 5, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB10_CSI2P, {
+	},
+	{
 		.name = "SRGGB10_CSI2P",
 		.format = formats::SRGGB10_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB10P), },
@@ -678,8 +692,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 5, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR12, {
+	},
+	{
 		.name = "SBGGR12",
 		.format = formats::SBGGR12,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR12), },
@@ -688,8 +702,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG12, {
+	},
+	{
 		.name = "SGBRG12",
 		.format = formats::SGBRG12,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG12), },
@@ -698,8 +712,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG12, {
+	},
+	{
 		.name = "SGRBG12",
 		.format = formats::SGRBG12,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG12), },
@@ -708,8 +722,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB12, {
+	},
+	{
 		.name = "SRGGB12",
 		.format = formats::SRGGB12,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB12), },
@@ -718,8 +732,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR12_CSI2P, {
+	},
+	{
 		.name = "SBGGR12_CSI2P",
 		.format = formats::SBGGR12_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR12P), },
@@ -728,8 +742,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG12_CSI2P, {
+	},
+	{
 		.name = "SGBRG12_CSI2P",
 		.format = formats::SGBRG12_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG12P), },
@@ -738,8 +752,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG12_CSI2P, {
+	},
+	{
 		.name = "SGRBG12_CSI2P",
 		.format = formats::SGRBG12_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG12P), },
@@ -748,8 +762,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB12_CSI2P, {
+	},
+	{
 		.name = "SRGGB12_CSI2P",
 		.format = formats::SRGGB12_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB12P), },
@@ -758,8 +772,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 3, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR14, {
+	},
+	{
 		.name = "SBGGR14",
 		.format = formats::SBGGR14,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR14), },
@@ -768,8 +782,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG14, {
+	},
+	{
 		.name = "SGBRG14",
 		.format = formats::SGBRG14,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG14), },
@@ -778,8 +792,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG14, {
+	},
+	{
 		.name = "SGRBG14",
 		.format = formats::SGRBG14,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG14), },
@@ -788,8 +802,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB14, {
+	},
+	{
 		.name = "SRGGB14",
 		.format = formats::SRGGB14,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB14), },
@@ -798,8 +812,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR14_CSI2P, {
+	},
+	{
 		.name = "SBGGR14_CSI2P",
 		.format = formats::SBGGR14_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR14P), },
@@ -808,8 +822,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 7, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG14_CSI2P, {
+	},
+	{
 		.name = "SGBRG14_CSI2P",
 		.format = formats::SGBRG14_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG14P), },
@@ -818,8 +832,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 7, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG14_CSI2P, {
+	},
+	{
 		.name = "SGRBG14_CSI2P",
 		.format = formats::SGRBG14_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG14P), },
@@ -828,8 +842,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 7, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB14_CSI2P, {
+	},
+	{
 		.name = "SRGGB14_CSI2P",
 		.format = formats::SRGGB14_CSI2P,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB14P), },
@@ -838,8 +852,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 4,
 		.planes = {{ { 7, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR16, {
+	},
+	{
 		.name = "SBGGR16",
 		.format = formats::SBGGR16,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SBGGR16), },
@@ -848,8 +862,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG16, {
+	},
+	{
 		.name = "SGBRG16",
 		.format = formats::SGBRG16,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGBRG16), },
@@ -858,8 +872,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG16, {
+	},
+	{
 		.name = "SGRBG16",
 		.format = formats::SGRBG16,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SGRBG16), },
@@ -868,8 +882,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB16, {
+	},
+	{
 		.name = "SRGGB16",
 		.format = formats::SRGGB16,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_SRGGB16), },
@@ -878,8 +892,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 4, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SBGGR10_IPU3, {
+	},
+	{
 		.name = "SBGGR10_IPU3",
 		.format = formats::SBGGR10_IPU3,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_IPU3_SBGGR10), },
@@ -889,8 +903,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		/* \todo remember to double this in the ipu3 pipeline handler */
 		.pixelsPerGroup = 25,
 		.planes = {{ { 32, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGBRG10_IPU3, {
+	},
+	{
 		.name = "SGBRG10_IPU3",
 		.format = formats::SGBRG10_IPU3,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_IPU3_SGBRG10), },
@@ -899,8 +913,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 25,
 		.planes = {{ { 32, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SGRBG10_IPU3, {
+	},
+	{
 		.name = "SGRBG10_IPU3",
 		.format = formats::SGRBG10_IPU3,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_IPU3_SGRBG10), },
@@ -909,8 +923,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 25,
 		.planes = {{ { 32, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::SRGGB10_IPU3, {
+	},
+	{
 		.name = "SRGGB10_IPU3",
 		.format = formats::SRGGB10_IPU3,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_IPU3_SRGGB10), },
@@ -919,8 +933,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 25,
 		.planes = {{ { 32, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::BGGR_PISP_COMP1, {
+	},
+	{
 		.name = "BGGR_PISP_COMP1",
 		.format = formats::BGGR_PISP_COMP1,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_PISP_COMP1_BGGR), },
@@ -929,8 +943,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::GBRG_PISP_COMP1, {
+	},
+	{
 		.name = "GBRG_PISP_COMP1",
 		.format = formats::GBRG_PISP_COMP1,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_PISP_COMP1_GBRG), },
@@ -939,8 +953,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::GRBG_PISP_COMP1, {
+	},
+	{
 		.name = "GRBG_PISP_COMP1",
 		.format = formats::GRBG_PISP_COMP1,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_PISP_COMP1_GRBG), },
@@ -949,8 +963,8 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
-	{ formats::RGGB_PISP_COMP1, {
+	},
+	{
 		.name = "RGGB_PISP_COMP1",
 		.format = formats::RGGB_PISP_COMP1,
 		.v4l2Formats = { V4L2PixelFormat(V4L2_PIX_FMT_PISP_COMP1_RGGB), },
@@ -959,9 +973,9 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = true,
 		.pixelsPerGroup = 2,
 		.planes = {{ { 2, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
+	},
 	/* Compressed formats. */
-	{ formats::MJPEG, {
+	{
 		.name = "MJPEG",
 		.format = formats::MJPEG,
 		.v4l2Formats = {
@@ -973,9 +987,19 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
 		.packed = false,
 		.pixelsPerGroup = 1,
 		.planes = {{ { 1, 1 }, { 0, 0 }, { 0, 0 } }},
-	} },
+	},
 };
 
+/*
+ * Sort the table by format for binary search, and index it by name. Both are
+ * computed at compile time and don't require static initialization.
+ */
+constexpr auto pixelFormatInfo = utils::sortedTable(pixelFormatInfoEntries, formatKey);
+static_assert(utils::sortedTableIsUnique(pixelFormatInfo, formatKey),
+	      "Duplicated pixel formats");
+
+constexpr auto pixelFormatInfoByName = utils::sortedTableIndex(pixelFormatInfo, nameKey);
+
 } /* namespace */
 
 /**
@@ -992,15 +1016,18 @@ const std::map<PixelFormat, PixelFormatInfo> pixelFormatInfo{
  */
 const PixelFormatInfo &PixelFormatInfo::info(const PixelFormat &format)
 {
-	const auto iter = pixelFormatInfo.find(format);
-	if (iter == pixelFormatInfo.end()) {
+	const PixelFormatInfo *info =
+		utils::sortedTableFind(pixelFormatInfo,
+				       std::make_tuple(format.fourcc(), format.modifier()),
+				       formatKey);
+	if (!info) {
 		LOG(Formats, Warning)
 			<< "Unsupported pixel format "
 			<< utils::hex(format.fourcc());
 		return pixelFormatInfoInvalid;
 	}
 
-	return iter->second;
+	return *info;
 }
 
 /**
@@ -1015,11 +1042,14 @@ const PixelFormatInfo &PixelFormatInfo::info(const V4L2PixelFormat &format)
 	if (!pixelFormat.isValid())
 		return pixelFormatInfoInvalid;
 
-	const auto iter = pixelFormatInfo.find(pixelFormat);
-	if (iter == pixelFormatInfo.end())
+	const PixelFormatInfo *info =
+		utils::sortedTableFind(pixelFormatInfo,
+				       std::make_tuple(pixelFormat.fourcc(), pixelFormat.modifier()),
+				       formatKey);
+	if (!info)
 		return pixelFormatInfoInvalid;
 
-	return iter->second;
+	return *info;
 }
 
 /**
@@ -1030,12 +1060,13 @@ const PixelFormatInfo &PixelFormatInfo::info(const V4L2PixelFormat &format)
  */
 const PixelFormatInfo &PixelFormatInfo::info(const std::string &name)
 {
-	for (const auto &info : pixelFormatInfo) {
-		if (info.second.name == name)
-			return info.second;
-	}
+	const PixelFormatInfo *info =
+		utils::sortedTableFind(pixelFormatInfo, pixelFormatInfoByName,
+				       std::string_view(name), nameKey);
+	if (!info)
+		return pixelFormatInfoInvalid;
 
-	return pixelFormatInfoInvalid;
+	return *info;
 }
 
 /**
@@ -0,0 +1,660 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Share frame buffers with other processes
+ */
+
+#include "libcamera/internal/frame_broker.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <libcamera/base/event_notifier.h>
+#include <libcamera/base/log.h>
+
+#include "libcamera/internal/ipc_unixsocket.h"
+
+/**
+ * \file frame_broker.h
+ * \brief Share frame buffers with other processes
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(FrameBroker)
+
+namespace {
+
+/*
+ * The messages exchanged between the broker and its consumers. Frame messages
+ * are followed by one FramePlane per plane, and carry the dmabuf file
+ * descriptors the first time a buffer is shared with a consumer only.
+ */
+enum BrokerMessageType : uint32_t {
+	BrokerMessageFrame = 0,
+	BrokerMessageRemove = 1,
+	BrokerMessageRelease = 2,
+};
+
+struct BrokerMessage {
+	uint32_t type;
+	uint32_t id;
+};
+
+struct FrameMessage {
+	BrokerMessage header;
+	uint32_t sequence;
+	uint32_t numPlanes;
+	uint64_t timestamp;
+};
+
+struct FramePlane {
+	uint32_t fd;
+	uint32_t offset;
+	uint32_t length;
+	uint32_t bytesused;
+};
+
+constexpr unsigned int kMaxPlanes = 8;
+
+constexpr unsigned int kListenBacklog = 8;
+
+int socketAddress(const std::string &path, struct sockaddr_un *addr)
+{
+	if (path.empty() || path.size() >= sizeof(addr->sun_path))
+		return -ENAMETOOLONG;
+
+	*addr = {};
+	addr->sun_family = AF_UNIX;
+	memcpy(addr->sun_path, path.c_str(), path.size());
+
+	return 0;
+}
+
+template<typename T>
+void append(std::vector<uint8_t> &data, const T &value)
+{
+	const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&value);
+	data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+} /* namespace */
+
+/**
+ * \class FrameBroker
+ * \brief Share completed frame buffers with consumer processes
+ *
+ * A Camera can only be acquired by a single process. When several processes,
+ * such as an encoder, an analysis service and a preview client, need the
+ * frames of the same stream, the process that owns the camera can share the
+ * completed buffers with the other processes through a FrameBroker instead of
+ * copying the frames.
+ *
+ * The broker listens for consumers on a Unix socket bound to a file system
+ * path. Each published buffer is sent to all connected consumers, with its
+ * dmabuf file descriptors passed the first time the buffer is shared with a
+ * consumer only, and is then referenced by all the consumers it has been sent
+ * to. Consumers release the buffer when they are done with it, and the
+ * bufferReleased signal is emitted when the last reference is dropped, at
+ * which point the buffer can be queued to the camera again. Consumers that
+ * disconnect release all their references.
+ *
+ * Consumers are read-only by contract: the dmabuf file descriptors are the
+ * ones of the producer, and consumers shall only map them for reading.
+ *
+ * The listening socket and the consumer connections are monitored by the event
+ * loop of the thread the broker is created in.
+ */
+
+FrameBroker::FrameBroker()
+	: nextId_(0)
+{
+}
+
+FrameBroker::~FrameBroker()
+{
+	close();
+}
+
+/**
+ * \brief Listen for consumers on a Unix socket
+ * \param[in] path The file system path to bind the socket to
+ *
+ * The \a path shall not exist. It is removed when the broker is closed.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EBUSY The broker is already listening
+ * \retval -ENAMETOOLONG The \a path is empty or too long
+ */
+int FrameBroker::listen(const std::string &path)
+{
+	if (fd_.isValid())
+		return -EBUSY;
+
+	struct sockaddr_un addr;
+	int ret = socketAddress(path, &addr);
+	if (ret)
+		return ret;
+
+	UniqueFD fd(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+	if (!fd.isValid()) {
+		ret = -errno;
+		LOG(FrameBroker, Error)
+			<< "Failed to create socket: " << strerror(-ret);
+		return ret;
+	}
+
+	if (::bind(fd.get(), reinterpret_cast<struct sockaddr *>(&addr),
+		   sizeof(addr)) < 0 ||
+	    ::listen(fd.get(), kListenBacklog) < 0) {
+		ret = -errno;
+		LOG(FrameBroker, Error)
+			<< "Failed to listen on " << path << ": " << strerror(-ret);
+		return ret;
+	}
+
+	fd_ = std::move(fd);
+	path_ = path;
+
+	notifier_ = std::make_unique<EventNotifier>(fd_.get(), EventNotifier::Read);
+	notifier_->activated.connect(this, &FrameBroker::accept);
+
+	return 0;
+}
+
+/**
+ * \brief Stop listening and disconnect all consumers
+ *
+ * The references held by the consumers are dropped, and the bufferReleased
+ * signal is emitted for all the buffers they held.
+ */
+void FrameBroker::close()
+{
+	for (std::unique_ptr<Consumer> &consumer : consumers_)
+		disconnect(consumer.get());
+
+	consumers_.clear();
+
+	if (fd_.isValid()) {
+		notifier_.reset();
+		fd_.reset();
+		unlink(path_.c_str());
+		path_.clear();
+	}
+}
+
+/**
+ * \brief Retrieve the number of connected consumers
+ * \return The number of connected consumers
+ */
+unsigned int FrameBroker::consumers() const
+{
+	return std::count_if(consumers_.begin(), consumers_.end(),
+			     [](const std::unique_ptr<Consumer> &consumer) {
+				     return consumer->socket->isBound();
+			     });
+}
+
+/**
+ * \brief Share a completed buffer with all connected consumers
+ * \param[in] buffer The buffer
+ *
+ * The buffer metadata is sent along with the buffer. Consumers that fail to
+ * receive the buffer, for instance because they don't keep up with the frame
+ * rate, are disconnected.
+ *
+ * When the function returns a positive value, the buffer is referenced by the
+ * consumers and shall not be reused until the bufferReleased signal is emitted
+ * for it.
+ *
+ * \return The number of consumers the buffer has been shared with, or a
+ * negative error code otherwise
+ * \retval -EBUSY The buffer is still referenced by consumers
+ * \retval -EINVAL The buffer has too many planes
+ */
+int FrameBroker::publish(FrameBuffer *buffer)
+{
+	const std::vector<FrameBuffer::Plane> &planes = buffer->planes();
+	if (planes.size() > kMaxPlanes)
+		return -EINVAL;
+
+	/* Drop the consumers disconnected since the last call. */
+	consumers_.erase(std::remove_if(consumers_.begin(), consumers_.end(),
+					[](const std::unique_ptr<Consumer> &consumer) {
+						return !consumer->socket->isBound();
+					}),
+			 consumers_.end());
+
+	if (consumers_.empty())
+		return 0;
+
+	auto [idIt, created] = ids_.try_emplace(buffer, nextId_);
+	if (created) {
+		buffers_[nextId_] = { buffer, 0 };
+		nextId_++;
+	}
+
+	const uint32_t id = idIt->second;
+	Buffer &entry = buffers_[id];
+	if (entry.refs)
+		return -EBUSY;
+
+	/*
+	 * Build the message once with the file descriptors, for the consumers
+	 * that don't know the buffer yet, and once without. Planes commonly
+	 * share the same dmabuf, pass each file descriptor once only.
+	 */
+	const FrameMetadata &metadata = buffer->metadata();
+	IPCUnixSocket::Payload message;
+	std::vector<int32_t> fds;
+
+	FrameMessage frame = {};
+	frame.header = { BrokerMessageFrame, id };
+	frame.sequence = metadata.sequence;
+	frame.numPlanes = planes.size();
+	frame.timestamp = metadata.timestamp;
+	append(message.data, frame);
+
+	for (unsigned int i = 0; i < planes.size(); i++) {
+		const FrameBuffer::Plane &plane = planes[i];
+		auto fdIt = std::find(fds.begin(), fds.end(), plane.fd.get());
+		if (fdIt == fds.end())
+			fdIt = fds.insert(fds.end(), plane.fd.get());
+
+		FramePlane info;
+		info.fd = fdIt - fds.begin();
+		info.offset = plane.offset;
+		info.length = plane.length;
+		info.bytesused = i < metadata.planes().size()
+			       ? metadata.planes()[i].bytesused : 0;
+		append(message.data, info);
+	}
+
+	std::vector<Consumer *> failed;
+
+	for (std::unique_ptr<Consumer> &consumer : consumers_) {
+		const bool known = consumer->known.count(id);
+
+		message.fds = known ? std::vector<int32_t>{} : fds;
+
+		int ret = consumer->socket->send(message);
+		if (ret < 0) {
+			LOG(FrameBroker, Warning)
+				<< "Failed to send frame, disconnecting consumer";
+			failed.push_back(consumer.get());
+			continue;
+		}
+
+		consumer->known.insert(id);
+		consumer->held.insert(id);
+		entry.refs++;
+	}
+
+	for (Consumer *consumer : failed)
+		disconnect(consumer);
+
+	return entry.refs;
+}
+
+/**
+ * \brief Tell consumers that a buffer is about to be freed
+ * \param[in] buffer The buffer
+ *
+ * Consumers close the file descriptors of the buffer. This function shall be
+ * called before freeing buffers that have been published.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENOENT The buffer has never been published
+ * \retval -EBUSY The buffer is still referenced by consumers
+ */
+int FrameBroker::removeBuffer(FrameBuffer *buffer)
+{
+	auto idIt = ids_.find(buffer);
+	if (idIt == ids_.end())
+		return -ENOENT;
+
+	const uint32_t id = idIt->second;
+	if (buffers_[id].refs)
+		return -EBUSY;
+
+	IPCUnixSocket::Payload message;
+	append(message.data, BrokerMessage{ BrokerMessageRemove, id });
+
+	for (std::unique_ptr<Consumer> &consumer : consumers_) {
+		if (!consumer->known.erase(id) || !consumer->socket->isBound())
+			continue;
+
+		consumer->socket->send(message);
+	}
+
+	buffers_.erase(id);
+	ids_.erase(idIt);
+
+	return 0;
+}
+
+/**
+ * \var FrameBroker::bufferReleased
+ * \brief A Signal emitted when a published buffer isn't referenced by any
+ * consumer anymore
+ */
+
+void FrameBroker::accept()
+{
+	UniqueFD fd(accept4(fd_.get(), nullptr, nullptr,
+			    SOCK_NONBLOCK | SOCK_CLOEXEC));
+	if (!fd.isValid()) {
+		int ret = errno;
+		if (ret != EAGAIN)
+			LOG(FrameBroker, Error)
+				<< "Failed to accept consumer: " << strerror(ret);
+		return;
+	}
+
+	auto consumer = std::make_unique<Consumer>();
+	consumer->socket = std::make_unique<IPCUnixSocket>();
+
+	Consumer *c = consumer.get();
+	consumer->socket->readyRead.connect(this, [this, c]() { receive(c); });
+	consumer->socket->disconnected.connect(this, [this, c]() { disconnect(c); });
+
+	if (consumer->socket->bind(std::move(fd)) < 0)
+		return;
+
+	consumers_.push_back(std::move(consumer));
+
+	LOG(FrameBroker, Debug) << "Consumer connected";
+}
+
+void FrameBroker::receive(Consumer *consumer)
+{
+	IPCUnixSocket::Payload payload;
+	if (consumer->socket->receive(&payload))
+		return;
+
+	/* Consumers have no reason to send file descriptors, close them. */
+	for (int32_t fd : payload.fds)
+		::close(fd);
+
+	BrokerMessage message;
+	if (payload.data.size() != sizeof(message)) {
+		LOG(FrameBroker, Warning) << "Invalid message from consumer";
+		disconnect(consumer);
+		return;
+	}
+
+	memcpy(&message, payload.data.data(), sizeof(message));
+
+	auto it = consumer->held.find(message.id);
+	if (message.type != BrokerMessageRelease || it == consumer->held.end()) {
+		LOG(FrameBroker, Warning)
+			<< "Invalid release of buffer " << message.id;
+		return;
+	}
+
+	consumer->held.erase(it);
+	unref(message.id);
+}
+
+/*
+ * Close the connection and drop the references of a consumer. The consumer is
+ * destroyed later, as this function may be called from the signal handlers of
+ * its socket.
+ */
+void FrameBroker::disconnect(Consumer *consumer)
+{
+	if (!consumer->socket->isBound())
+		return;
+
+	consumer->socket->close();
+
+	std::multiset<uint32_t> held = std::move(consumer->held);
+	consumer->held.clear();
+	consumer->known.clear();
+
+	for (uint32_t id : held)
+		unref(id);
+
+	LOG(FrameBroker, Debug) << "Consumer disconnected";
+}
+
+void FrameBroker::unref(uint32_t id)
+{
+	auto it = buffers_.find(id);
+	if (it == buffers_.end() || !it->second.refs)
+		return;
+
+	if (--it->second.refs == 0)
+		bufferReleased.emit(it->second.buffer);
+}
+
+/**
+ * \class FrameBrokerClient
+ * \brief Receive frame buffers shared by a FrameBroker
+ *
+ * The FrameBrokerClient class connects to a FrameBroker and emits the
+ * frameReady signal for every buffer published by the broker. The buffer
+ * planes reference the dmabuf file descriptors received from the broker, which
+ * the client caches for the lifetime of the buffers. Every frame shall be
+ * released with release() once processed, to let the broker reuse the buffer.
+ * Consumers that hold frames for too long stall the producer.
+ *
+ * The connection is monitored by the event loop of the thread the client is
+ * created in.
+ */
+
+/**
+ * \struct FrameBrokerClient::Frame
+ * \brief A frame shared by the broker
+ *
+ * \var FrameBrokerClient::Frame::id
+ * \brief The identifier of the buffer, to be passed to release()
+ *
+ * \var FrameBrokerClient::Frame::sequence
+ * \brief The frame sequence number
+ *
+ * \var FrameBrokerClient::Frame::timestamp
+ * \brief The frame timestamp, in nanoseconds
+ *
+ * \var FrameBrokerClient::Frame::planes
+ * \brief The buffer planes
+ *
+ * \var FrameBrokerClient::Frame::bytesused
+ * \brief The number of bytes used in each plane
+ */
+
+FrameBrokerClient::FrameBrokerClient()
+{
+}
+
+FrameBrokerClient::~FrameBrokerClient()
+{
+	close();
+}
+
+/**
+ * \brief Connect to a broker
+ * \param[in] path The file system path the broker listens on
+ * \return 0 on success or a negative error code otherwise
+ */
+int FrameBrokerClient::connect(const std::string &path)
+{
+	if (isConnected())
+		return -EBUSY;
+
+	struct sockaddr_un addr;
+	int ret = socketAddress(path, &addr);
+	if (ret)
+		return ret;
+
+	UniqueFD fd(socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+	if (!fd.isValid()) {
+		ret = -errno;
+		LOG(FrameBroker, Error)
+			<< "Failed to create socket: " << strerror(-ret);
+		return ret;
+	}
+
+	if (::connect(fd.get(), reinterpret_cast<struct sockaddr *>(&addr),
+		      sizeof(addr)) < 0) {
+		ret = -errno;
+		LOG(FrameBroker, Error)
+			<< "Failed to connect to " << path << ": " << strerror(-ret);
+		return ret;
+	}
+
+	socket_ = std::make_unique<IPCUnixSocket>();
+	socket_->readyRead.connect(this, &FrameBrokerClient::receive);
+	socket_->disconnected.connect(this, &FrameBrokerClient::remoteClosed);
+
+	return socket_->bind(std::move(fd));
+}
+
+/**
+ * \brief Disconnect from the broker
+ *
+ * All the frames held by the client are released.
+ */
+void FrameBrokerClient::close()
+{
+	if (socket_)
+		socket_->close();
+
+	buffers_.clear();
+}
+
+/**
+ * \brief Check if the client is connected to a broker
+ * \return True if the client is connected, false otherwise
+ */
+bool FrameBrokerClient::isConnected() const
+{
+	return socket_ && socket_->isBound();
+}
+
+/**
+ * \brief Release a frame
+ * \param[in] id The frame buffer identifier
+ * \return 0 on success or a negative error code otherwise
+ */
+int FrameBrokerClient::release(uint32_t id)
+{
+	if (!isConnected())
+		return -ENOTCONN;
+
+	IPCUnixSocket::Payload message;
+	append(message.data, BrokerMessage{ BrokerMessageRelease, id });
+
+	return socket_->send(message);
+}
+
+/**
+ * \var FrameBrokerClient::frameReady
+ * \brief A Signal emitted when a frame has been received from the broker
+ *
+ * The frame shall be released with release() once processed.
+ */
+
+/**
+ * \var FrameBrokerClient::disconnected
+ * \brief A Signal emitted when the broker has closed the connection
+ */
+
+void FrameBrokerClient::receive()
+{
+	IPCUnixSocket::Payload payload;
+	if (socket_->receive(&payload))
+		return;
+
+	/* Take ownership of the file descriptors first, to never leak them. */
+	std::vector<SharedFD> fds;
+	for (int32_t fd : payload.fds)
+		fds.emplace_back(UniqueFD(fd));
+
+	const std::vector<uint8_t> &data = payload.data;
+	BrokerMessage message;
+	if (data.size() < sizeof(message)) {
+		LOG(FrameBroker, Error) << "Invalid message from broker";
+		return;
+	}
+
+	memcpy(&message, data.data(), sizeof(message));
+
+	if (message.type == BrokerMessageRemove) {
+		buffers_.erase(message.id);
+		return;
+	}
+
+	FrameMessage header;
+	if (message.type != BrokerMessageFrame || data.size() < sizeof(header)) {
+		LOG(FrameBroker, Error) << "Invalid message from broker";
+		return;
+	}
+
+	memcpy(&header, data.data(), sizeof(header));
+
+	if (header.numPlanes > kMaxPlanes ||
+	    data.size() != sizeof(header) + header.numPlanes * sizeof(FramePlane)) {
+		LOG(FrameBroker, Error) << "Invalid frame from broker";
+		return;
+	}
+
+	Frame frame;
+	frame.id = message.id;
+	frame.sequence = header.sequence;
+	frame.timestamp = header.timestamp;
+
+	/*
+	 * The file descriptors are only received the first time a buffer is
+	 * shared, use the cached planes otherwise.
+	 */
+	auto cached = buffers_.find(message.id);
+	if (fds.empty() && cached == buffers_.end()) {
+		LOG(FrameBroker, Error) << "Unknown buffer " << message.id;
+		return;
+	}
+
+	for (unsigned int i = 0; i < header.numPlanes; i++) {
+		FramePlane info;
+		memcpy(&info, data.data() + sizeof(header) + i * sizeof(info),
+		       sizeof(info));
+
+		FrameBuffer::Plane plane;
+		if (!fds.empty()) {
+			if (info.fd >= fds.size()) {
+				LOG(FrameBroker, Error) << "Invalid frame from broker";
+				return;
+			}
+			plane.fd = fds[info.fd];
+		} else {
+			if (i >= cached->second.size()) {
+				LOG(FrameBroker, Error) << "Invalid frame from broker";
+				return;
+			}
+			plane.fd = cached->second[i].fd;
+		}
+
+		plane.offset = info.offset;
+		plane.length = info.length;
+
+		frame.planes.push_back(std::move(plane));
+		frame.bytesused.push_back(info.bytesused);
+	}
+
+	buffers_[message.id] = frame.planes;
+
+	frameReady.emit(frame);
+}
+
+void FrameBrokerClient::remoteClosed()
+{
+	close();
+	disconnected.emit();
+}
+
+} /* namespace libcamera */
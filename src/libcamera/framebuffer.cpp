@@ -8,7 +8,9 @@
 #include <libcamera/framebuffer.h>
 #include "libcamera/internal/framebuffer.h"
 
+#include <stdint.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/shared_fd.h>
@@ -193,6 +195,36 @@ FrameBuffer::Private::~Private()
  * fence and handle it opportunely before using the buffer again.
  */
 
+/**
+ * \fn FrameBuffer::Private::setOutputFence()
+ * \brief Set the output fence to signal when the buffer completes
+ * \param[in] fd The eventfd of the output fence
+ *
+ * The intended caller is the Request::exportFence() function.
+ *
+ * \sa signalOutputFence()
+ */
+
+/**
+ * \brief Signal and release the output fence of the buffer
+ *
+ * This function signals the output fence exported for the buffer, if any, and
+ * releases it. It is called by the core when the buffer completes, regardless
+ * of the completion status, to ensure waiters are never blocked forever.
+ */
+void FrameBuffer::Private::signalOutputFence()
+{
+	if (!outputFence_.isValid())
+		return;
+
+	uint64_t value = 1;
+	ssize_t ret = write(outputFence_.get(), &value, sizeof(value));
+	if (ret != sizeof(value))
+		LOG(Buffer, Error) << "Failed to signal output fence";
+
+	outputFence_.reset();
+}
+
 /**
  * \fn FrameBuffer::Private::cancel()
  * \brief Marks the buffer as cancelled
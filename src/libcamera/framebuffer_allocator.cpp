@@ -15,6 +15,7 @@
 #include <libcamera/framebuffer.h>
 #include <libcamera/stream.h>
 
+#include "libcamera/internal/camera.h"
 #include "libcamera/internal/pipeline_handler.h"
 
 /**
@@ -52,6 +53,10 @@ LOG_DEFINE_CATEGORY(Allocator)
  *
  * Usage of the FrameBufferAllocator is optional, if all buffers for a camera
  * are provided externally applications shall not use this class.
+ *
+ * The memory of allocated buffers is accounted for in the camera memory usage,
+ * and is subject to the camera memory budget. \sa Camera::memoryUsage(),
+ * Camera::setMemoryBudget()
  */
 
 /**
@@ -63,7 +68,12 @@ FrameBufferAllocator::FrameBufferAllocator(std::shared_ptr<Camera> camera)
 {
 }
 
-FrameBufferAllocator::~FrameBufferAllocator() = default;
+FrameBufferAllocator::~FrameBufferAllocator()
+{
+	for (const auto &[stream, buffers] : buffers_)
+		camera_->_d()->unchargeMemory(CameraMemoryUsage::PurposeApplication,
+					      Camera::Private::bufferMemory(buffers));
+}
 
 /**
  * \brief Allocate buffers for a configured stream
@@ -82,6 +92,7 @@ FrameBufferAllocator::~FrameBufferAllocator() = default;
  * \retval -EINVAL The \a stream does not belong to the camera or the stream is
  * not part of the active camera configuration
  * \retval -EBUSY Buffers are already allocated for the \a stream
+ * \retval -ENOMEM The buffers would exceed the camera memory budget
  */
 int FrameBufferAllocator::allocate(Stream *stream)
 {
@@ -98,8 +109,21 @@ int FrameBufferAllocator::allocate(Stream *stream)
 			<< "Stream is not part of " << camera_->id()
 			<< " active configuration";
 
-	if (ret < 0)
+	if (ret < 0) {
+		buffers_.erase(it);
+		return ret;
+	}
+
+	uint64_t bytes = Camera::Private::bufferMemory(it->second);
+	if (camera_->_d()->chargeMemory(CameraMemoryUsage::PurposeApplication,
+					bytes) < 0) {
+		LOG(Allocator, Error)
+			<< "Allocating " << bytes << " bytes for stream exceeds "
+			<< camera_->id() << " memory budget of "
+			<< camera_->memoryBudget() << " bytes";
 		buffers_.erase(it);
+		return -ENOMEM;
+	}
 
 	return ret;
 }
@@ -122,6 +146,8 @@ int FrameBufferAllocator::free(Stream *stream)
 	if (iter == buffers_.end())
 		return -EINVAL;
 
+	camera_->_d()->unchargeMemory(CameraMemoryUsage::PurposeApplication,
+				      Camera::Private::bufferMemory(iter->second));
 	buffers_.erase(iter);
 
 	return 0;
@@ -129,6 +129,11 @@
  * As for the ControlList packet, empty spaces may be present between the end of
  * the entries array and the data section, and after the data section. They
  * shall be ignored when parsing the packet.
+ *
+ * A ControlInfoMap that has already been transferred may be referenced instead
+ * of being serialized again. The reference is a ControlInfoMap packet that has
+ * the IPA_CONTROLS_FLAG_CACHED flag set and only contains the packet header,
+ * with the handle of the previously transferred ControlInfoMap.
  */
 
 namespace libcamera {
@@ -138,6 +143,12 @@ namespace libcamera {
  * \brief The current control serialization format version
  */
 
+/**
+ * \def IPA_CONTROLS_FLAG_CACHED
+ * \brief The ControlInfoMap packet references a previously transferred
+ * ControlInfoMap
+ */
+
 /**
  * \var ipa_controls_id_map_type
  * \brief Enumerates the different control id map types
@@ -182,6 +193,8 @@ namespace libcamera {
  * Offset in bytes from the beginning of the packet of the data section start
  * \var ipa_controls_header::id_map_type
  * The id map type as defined by the ipa_controls_id_map_type enumeration
+ * \var ipa_controls_header::flags
+ * Packet flags (IPA_CONTROLS_FLAG_*)
  * \var ipa_controls_header::reserved
  * Reserved for future extensions
  */
@@ -27,6 +27,9 @@ LOG_DEFINE_CATEGORY(IPADataSerializer)
  * Static template class that provides functions for serializing and
  * deserializing IPA data.
  *
+ * Objects are deserialized in place from the byte and fd vectors, through the
+ * iterator versions of the deserialize() functions.
+ *
  * \todo Switch to Span instead of byte and fd vector
  *
  * \todo Harden the vector and map deserializer
@@ -48,6 +51,21 @@ namespace {
  * generated IPA proxies.
  */
 
+/**
+ * \fn template<typename T> void writePOD(std::vector<uint8_t> &vec, size_t pos, T val)
+ * \brief Write POD at a given position in byte vector, in little-endian order
+ * \tparam T Type of POD to write
+ * \param[in] vec Byte vector to write to
+ * \param[in] pos Index in \a vec to write to
+ * \param[in] val Value to write
+ *
+ * This function is meant to be used by the IPA data serializer, and the
+ * generated IPA proxies, to fill sizes in space reserved before serializing
+ * the data they describe.
+ *
+ * The \a vec shall be large enough to store \a val at index \a pos.
+ */
+
 /**
  * \fn template<typename T> T readPOD(std::vector<uint8_t>::iterator it, size_t pos,
  * 				      std::vector<uint8_t>::iterator end)
@@ -102,6 +120,32 @@ namespace {
  * of \a data
  */
 
+/**
+ * \fn template<typename T> IPADataSerializer<T>::serialize(
+ * 	const T &data,
+ * 	std::vector<uint8_t> *dataVec,
+ * 	std::vector<SharedFD> *fdsVec,
+ * 	ControlSerializer *cs = nullptr)
+ * \brief Serialize an object at the end of a byte vector and fd vector
+ * \tparam T Type of object to serialize
+ * \param[in] data Object to serialize
+ * \param[inout] dataVec Byte vector to append the serialized data to
+ * \param[inout] fdsVec Fd vector to append the serialized fds to
+ * \param[in] cs ControlSerializer
+ *
+ * This version of serialize() appends the serialized form of \a data to the
+ * \a dataVec and \a fdsVec, without allocating intermediate vectors for \a
+ * data or its members. Serializing multiple objects, or the same object
+ * repeatedly, in vectors that are cleared and reused between messages thus
+ * avoids memory allocations once the vectors have grown to the needed size.
+ *
+ * The serialized form is identical to the one returned by the other
+ * serialize() function.
+ *
+ * \a cs is only necessary if the object type \a T or its members contain
+ * ControlList or ControlInfoMap.
+ */
+
 /**
  * \fn template<typename T> IPADataSerializer<T>::deserialize(
  * 	const std::vector<uint8_t> &data,
@@ -189,6 +233,15 @@ namespace {
 #define DEFINE_POD_SERIALIZER(type)					\
 									\
 template<>								\
+void IPADataSerializer<type>::serialize(const type &data,		\
+					std::vector<uint8_t> *dataVec,	\
+					[[maybe_unused]] std::vector<SharedFD> *fdsVec, \
+					[[maybe_unused]] ControlSerializer *cs) \
+{									\
+	appendPOD<type>(*dataVec, data);				\
+}									\
+									\
+template<>								\
 std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>		\
 IPADataSerializer<type>::serialize(const type &data,			\
 				  [[maybe_unused]] ControlSerializer *cs) \
@@ -197,7 +250,7 @@ IPADataSerializer<type>::serialize(const type &data,			\
 	dataVec.reserve(sizeof(type));					\
 	appendPOD<type>(dataVec, data);					\
 									\
-	return { dataVec, {} };						\
+	return { std::move(dataVec), {} };				\
 }									\
 									\
 template<>								\
@@ -258,6 +311,16 @@ IPADataSerializer<std::string>::serialize(const std::string &data,
 	return { { data.cbegin(), data.end() }, {} };
 }
 
+template<>
+void
+IPADataSerializer<std::string>::serialize(const std::string &data,
+					  std::vector<uint8_t> *dataVec,
+					  [[maybe_unused]] std::vector<SharedFD> *fdsVec,
+					  [[maybe_unused]] ControlSerializer *cs)
+{
+	dataVec->insert(dataVec->end(), data.cbegin(), data.cend());
+}
+
 template<>
 std::string
 IPADataSerializer<std::string>::deserialize(const std::vector<uint8_t> &data,
@@ -307,51 +370,73 @@ IPADataSerializer<std::string>::deserialize(std::vector<uint8_t>::const_iterator
  * be used. The serialized ControlInfoMap will have zero length.
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
-IPADataSerializer<ControlList>::serialize(const ControlList &data, ControlSerializer *cs)
+void
+IPADataSerializer<ControlList>::serialize(const ControlList &data,
+					  std::vector<uint8_t> *dataVec,
+					  [[maybe_unused]] std::vector<SharedFD> *fdsVec,
+					  ControlSerializer *cs)
 {
 	if (!cs)
 		LOG(IPADataSerializer, Fatal)
 			<< "ControlSerializer not provided for serialization of ControlList";
 
-	size_t size;
-	std::vector<uint8_t> infoData;
-	int ret;
-
 	/*
 	 * \todo Revisit this opportunistic serialization of the
 	 * ControlInfoMap, as it could be fragile
 	 */
-	if (data.infoMap() && !cs->isCached(*data.infoMap())) {
-		size = cs->binarySize(*data.infoMap());
-		infoData.resize(size);
-		ByteStreamBuffer buffer(infoData.data(), infoData.size());
-		ret = cs->serialize(*data.infoMap(), buffer);
+	const ControlInfoMap *infoMap = data.infoMap();
+	if (infoMap && cs->isCached(*infoMap))
+		infoMap = nullptr;
+
+	/*
+	 * Serialize the sizes, the ControlInfoMap and the ControlList directly
+	 * in the output vector to avoid intermediate copies. The ControlInfoMap
+	 * may be serialized as a reference to a cached map, smaller than its
+	 * binary size, update the size and the vector size accordingly.
+	 */
+	uint32_t infoDataSize = infoMap ? cs->binarySize(*infoMap) : 0;
+	uint32_t listDataSize = cs->binarySize(data);
+
+	const size_t offset = dataVec->size();
+	dataVec->resize(offset + 8 + infoDataSize + listDataSize);
+	ByteStreamBuffer buffer(dataVec->data() + offset, dataVec->size() - offset);
+	int ret;
 
+	buffer.write(&infoDataSize);
+	buffer.write(&listDataSize);
+
+	if (infoMap) {
+		ret = cs->serialize(*infoMap, buffer);
 		if (ret < 0 || buffer.overflow()) {
 			LOG(IPADataSerializer, Error) << "Failed to serialize ControlList's ControlInfoMap";
-			return { {}, {} };
+			dataVec->resize(offset);
+			return;
 		}
+
+		infoDataSize = buffer.offset() - 8;
 	}
 
-	size = cs->binarySize(data);
-	std::vector<uint8_t> listData(size);
-	ByteStreamBuffer buffer(listData.data(), listData.size());
 	ret = cs->serialize(data, buffer);
-
 	if (ret < 0 || buffer.overflow()) {
 		LOG(IPADataSerializer, Error) << "Failed to serialize ControlList";
-		return { {}, {} };
+		dataVec->resize(offset);
+		return;
 	}
 
+	writePOD<uint32_t>(*dataVec, offset, infoDataSize);
+	dataVec->resize(offset + buffer.offset());
+}
+
+template<>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<ControlList>::serialize(const ControlList &data, ControlSerializer *cs)
+{
 	std::vector<uint8_t> dataVec;
-	dataVec.reserve(8 + infoData.size() + listData.size());
-	appendPOD<uint32_t>(dataVec, infoData.size());
-	appendPOD<uint32_t>(dataVec, listData.size());
-	dataVec.insert(dataVec.end(), infoData.begin(), infoData.end());
-	dataVec.insert(dataVec.end(), listData.begin(), listData.end());
+	std::vector<SharedFD> fdsVec;
+
+	serialize(data, &dataVec, &fdsVec, cs);
 
-	return { dataVec, {} };
+	return { std::move(dataVec), {} };
 }
 
 template<>
@@ -431,29 +516,46 @@ IPADataSerializer<ControlList>::deserialize(std::vector<uint8_t>::const_iterator
  * X bytes - Serialized ControlInfoMap (using ControlSerializer)
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+void
 IPADataSerializer<ControlInfoMap>::serialize(const ControlInfoMap &map,
+					     std::vector<uint8_t> *dataVec,
+					     [[maybe_unused]] std::vector<SharedFD> *fdsVec,
 					     ControlSerializer *cs)
 {
 	if (!cs)
 		LOG(IPADataSerializer, Fatal)
 			<< "ControlSerializer not provided for serialization of ControlInfoMap";
 
-	size_t size = cs->binarySize(map);
-	std::vector<uint8_t> infoData(size);
-	ByteStreamBuffer buffer(infoData.data(), infoData.size());
-	int ret = cs->serialize(map, buffer);
+	uint32_t infoDataSize = cs->binarySize(map);
+	const size_t offset = dataVec->size();
+	dataVec->resize(offset + 4 + infoDataSize);
+	ByteStreamBuffer buffer(dataVec->data() + offset, dataVec->size() - offset);
+
+	buffer.write(&infoDataSize);
 
+	int ret = cs->serialize(map, buffer);
 	if (ret < 0 || buffer.overflow()) {
 		LOG(IPADataSerializer, Error) << "Failed to serialize ControlInfoMap";
-		return { {}, {} };
+		dataVec->resize(offset);
+		return;
 	}
 
+	/* The map may have been serialized as a reference to a cached map. */
+	writePOD<uint32_t>(*dataVec, offset, buffer.offset() - 4);
+	dataVec->resize(offset + buffer.offset());
+}
+
+template<>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<ControlInfoMap>::serialize(const ControlInfoMap &map,
+					     ControlSerializer *cs)
+{
 	std::vector<uint8_t> dataVec;
-	appendPOD<uint32_t>(dataVec, infoData.size());
-	dataVec.insert(dataVec.end(), infoData.begin(), infoData.end());
+	std::vector<SharedFD> fdsVec;
+
+	serialize(map, &dataVec, &fdsVec, cs);
 
-	return { dataVec, {} };
+	return { std::move(dataVec), {} };
 }
 
 template<>
@@ -521,24 +623,32 @@ IPADataSerializer<ControlInfoMap>::deserialize(std::vector<uint8_t>::const_itera
  * and it will be recursively consumed as necessary.
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
-IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
-				       [[maybe_unused]] ControlSerializer *cs)
+void IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
+					    std::vector<uint8_t> *dataVec,
+					    std::vector<SharedFD> *fdsVec,
+					    [[maybe_unused]] ControlSerializer *cs)
 {
-	std::vector<uint8_t> dataVec;
-	std::vector<SharedFD> fdVec;
-
 	/*
 	 * Store as uint32_t to prepare for conversion from validity flag
 	 * to index, and for alignment.
 	 */
-	appendPOD<uint32_t>(dataVec, data.isValid());
+	appendPOD<uint32_t>(*dataVec, data.isValid());
 
 	if (data.isValid())
-		fdVec.push_back(data);
+		fdsVec->push_back(data);
+}
 
+template<>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
+				       [[maybe_unused]] ControlSerializer *cs)
+{
+	std::vector<uint8_t> dataVec;
+	std::vector<SharedFD> fdVec;
+
+	serialize(data, &dataVec, &fdVec);
 
-	return { dataVec, fdVec };
+	return { std::move(dataVec), std::move(fdVec) };
 }
 
 template<>
@@ -572,6 +682,19 @@ SharedFD IPADataSerializer<SharedFD>::deserialize(const std::vector<uint8_t> &da
  * 4 bytes - uint32_t Offset
  * 4 bytes - uint32_t Length
  */
+template<>
+void
+IPADataSerializer<FrameBuffer::Plane>::serialize(const FrameBuffer::Plane &data,
+						 std::vector<uint8_t> *dataVec,
+						 std::vector<SharedFD> *fdsVec,
+						 [[maybe_unused]] ControlSerializer *cs)
+{
+	IPADataSerializer<SharedFD>::serialize(data.fd, dataVec, fdsVec);
+
+	appendPOD<uint32_t>(*dataVec, data.offset);
+	appendPOD<uint32_t>(*dataVec, data.length);
+}
+
 template<>
 std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
 IPADataSerializer<FrameBuffer::Plane>::serialize(const FrameBuffer::Plane &data,
@@ -580,17 +703,9 @@ IPADataSerializer<FrameBuffer::Plane>::serialize(const FrameBuffer::Plane &data,
 	std::vector<uint8_t> dataVec;
 	std::vector<SharedFD> fdsVec;
 
-	std::vector<uint8_t> fdBuf;
-	std::vector<SharedFD> fdFds;
-	std::tie(fdBuf, fdFds) =
-		IPADataSerializer<SharedFD>::serialize(data.fd);
-	dataVec.insert(dataVec.end(), fdBuf.begin(), fdBuf.end());
-	fdsVec.insert(fdsVec.end(), fdFds.begin(), fdFds.end());
-
-	appendPOD<uint32_t>(dataVec, data.offset);
-	appendPOD<uint32_t>(dataVec, data.length);
+	serialize(data, &dataVec, &fdsVec);
 
-	return { dataVec, fdsVec };
+	return { std::move(dataVec), std::move(fdsVec) };
 }
 
 template<>
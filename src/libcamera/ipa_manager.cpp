@@ -9,7 +9,9 @@
 
 #include <algorithm>
 #include <dirent.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <libcamera/base/file.h>
@@ -18,6 +20,7 @@
 
 #include "libcamera/internal/ipa_module.h"
 #include "libcamera/internal/ipa_proxy.h"
+#include "libcamera/internal/ipc_pipe_unixsocket.h"
 #include "libcamera/internal/pipeline_handler.h"
 
 /**
@@ -39,6 +42,11 @@ LOG_DEFINE_CATEGORY(IPAManager)
  * view of the IPA contexts to pipeline handlers regardless of whether the
  * modules are isolated or loaded in the same process.
  *
+ * The directories containing IPA modules are scanned when the manager is
+ * constructed, but the modules are only opened and parsed when a pipeline
+ * handler requests an IPA context. Startup time is thus not affected by the
+ * number of installed modules.
+ *
  * Module isolation is based on the module licence. Open-source modules are
  * loaded without isolation, while closed-source module are forcefully isolated.
  * The isolation mechanism ensures that no code from a closed-source module is
@@ -97,6 +105,9 @@ LOG_DEFINE_CATEGORY(IPAManager)
 
 IPAManager *IPAManager::self_ = nullptr;
 
+/* Maximum number of spare proxy workers per isolated IPA module */
+static constexpr unsigned long kMaxWorkerPoolSize = 4;
+
 /**
  * \brief Construct an IPAManager instance
  *
@@ -104,6 +115,7 @@ IPAManager *IPAManager::self_ = nullptr;
  * CameraManager.
  */
 IPAManager::IPAManager()
+	: probedPaths_(0), workerPoolSize_(0)
 {
 	if (self_)
 		LOG(IPAManager, Fatal)
@@ -114,6 +126,15 @@ IPAManager::IPAManager()
 		LOG(IPAManager, Warning) << "Public key not valid";
 #endif
 
+	const char *poolSize = utils::secure_getenv("LIBCAMERA_IPA_PROXY_POOL");
+	if (poolSize) {
+		workerPoolSize_ = std::min(strtoul(poolSize, nullptr, 10),
+					   kMaxWorkerPoolSize);
+		LOG(IPAManager, Debug)
+			<< "Keeping " << workerPoolSize_
+			<< " spare proxy workers per isolated IPA module";
+	}
+
 	unsigned int ipaCount = 0;
 
 	/* User-specified paths take precedence. */
@@ -159,6 +180,8 @@ IPAManager::IPAManager()
 
 IPAManager::~IPAManager()
 {
+	workerPool_.clear();
+
 	for (IPAModule *module : modules_)
 		delete module;
 
@@ -213,17 +236,18 @@ void IPAManager::parseDir(const char *libDir, unsigned int maxDepth,
 }
 
 /**
- * \brief Load IPA modules from a directory
+ * \brief Add IPA module candidates from a directory
  * \param[in] libDir The directory to search for IPA modules
  * \param[in] maxDepth The maximum depth of sub-directories to search
  *
- * This function tries to create an IPAModule instance for every shared object
- * found in \a libDir, and skips invalid IPA modules.
+ * This function records every shared object found in \a libDir as an IPA
+ * module candidate. The candidates are not opened at this point, they are
+ * probed on demand by module() when a pipeline handler requests an IPA.
  *
  * Sub-directories are searched up to a depth of \a maxDepth. A \a maxDepth
  * value of 0 only searches the directory specified in \a libDir.
  *
- * \return Number of modules loaded by this call
+ * \return Number of candidates added by this call
  */
 unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
 {
@@ -234,21 +258,9 @@ unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
 	/* Ensure a stable ordering of modules. */
 	std::sort(files.begin(), files.end());
 
-	unsigned int count = 0;
-	for (const std::string &file : files) {
-		IPAModule *ipaModule = new IPAModule(file);
-		if (!ipaModule->isValid()) {
-			delete ipaModule;
-			continue;
-		}
-
-		LOG(IPAManager, Debug) << "Loaded IPA module '" << file << "'";
-
-		modules_.push_back(ipaModule);
-		count++;
-	}
+	modulePaths_.insert(modulePaths_.end(), files.begin(), files.end());
 
-	return count;
+	return files.size();
 }
 
 /**
@@ -256,6 +268,13 @@ unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
  * \param[in] pipe The pipeline handler
  * \param[in] minVersion Minimum acceptable version of IPA module
  * \param[in] maxVersion Maximum acceptable version of IPA module
+ *
+ * The modules that have already been probed are searched first. If none of
+ * them matches, the remaining candidates are probed in order of precedence
+ * until a match is found. Each candidate is probed at most once, and invalid
+ * candidates are skipped.
+ *
+ * \return The IPA module, or nullptr if no matching module is found
  */
 IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
 			      uint32_t maxVersion)
@@ -265,6 +284,23 @@ IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
 			return module;
 	}
 
+	while (probedPaths_ < modulePaths_.size()) {
+		const std::string &file = modulePaths_[probedPaths_++];
+
+		IPAModule *ipaModule = new IPAModule(file);
+		if (!ipaModule->isValid()) {
+			delete ipaModule;
+			continue;
+		}
+
+		LOG(IPAManager, Debug) << "Loaded IPA module '" << file << "'";
+
+		modules_.push_back(ipaModule);
+
+		if (ipaModule->match(pipe, minVersion, maxVersion))
+			return ipaModule;
+	}
+
 	return nullptr;
 }
 
@@ -279,6 +315,64 @@ IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
  * found or if the IPA proxy fails to initialize
  */
 
+/**
+ * \brief Create an IPC pipe to a proxy worker for an isolated IPA module
+ * \param[in] ipam The IPA module
+ * \param[in] workerPath The path to the proxy worker executable
+ *
+ * Starting a proxy worker process and loading the IPA module in it adds
+ * latency to the creation of isolated IPA proxies. When the
+ * LIBCAMERA_IPA_PROXY_POOL environment variable is set, the manager keeps that
+ * number of spare proxy workers running for each isolated IPA module that has
+ * been used. This function then returns a spare worker if one is available, and
+ * starts a replacement to be used by the next call. Spare workers that have
+ * terminated are discarded.
+ *
+ * Workers are not reused after the proxy that used them is destroyed, as they
+ * hold the state of the IPA module instance they have been used for.
+ *
+ * \return The IPC pipe, which may not be connected if the proxy worker failed
+ * to start
+ */
+std::unique_ptr<IPCPipeUnixSocket>
+IPAManager::createPipe(const IPAModule *ipam, const std::string &workerPath)
+{
+	if (!self_ || !self_->workerPoolSize_)
+		return std::make_unique<IPCPipeUnixSocket>(ipam->path().c_str(),
+							   workerPath.c_str());
+
+	auto &pool = self_->workerPool_[{ ipam->path(), workerPath }];
+
+	pool.erase(std::remove_if(pool.begin(), pool.end(),
+				  [](const std::unique_ptr<IPCPipeUnixSocket> &pipe) {
+					  return !pipe->isConnected();
+				  }),
+		   pool.end());
+
+	std::unique_ptr<IPCPipeUnixSocket> pipe;
+	if (!pool.empty()) {
+		LOG(IPAManager, Debug)
+			<< "Using a spare proxy worker for " << ipam->path();
+
+		pipe = std::move(pool.front());
+		pool.erase(pool.begin());
+	} else {
+		pipe = std::make_unique<IPCPipeUnixSocket>(ipam->path().c_str(),
+							   workerPath.c_str());
+	}
+
+	while (pool.size() < self_->workerPoolSize_) {
+		auto spare = std::make_unique<IPCPipeUnixSocket>(ipam->path().c_str(),
+								 workerPath.c_str());
+		if (!spare->isConnected())
+			break;
+
+		pool.push_back(std::move(spare));
+	}
+
+	return pipe;
+}
+
 #if HAVE_IPA_PUBKEY
 /**
  * \fn IPAManager::pubKey()
@@ -303,6 +397,23 @@ bool IPAManager::isSignatureValid([[maybe_unused]] IPAModule *ipa) const
 		return false;
 	}
 
+	/*
+	 * Verifying the signature requires hashing the whole module. Cache
+	 * the result, and invalidate it when the module file is modified.
+	 */
+	struct stat st;
+	if (stat(ipa->path().c_str(), &st) < 0)
+		return false;
+
+	int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000
+		      + st.st_mtim.tv_nsec;
+	int64_t size = st.st_size;
+
+	auto iter = signatures_.find(ipa->path());
+	if (iter != signatures_.end() && iter->second.mtime == mtime &&
+	    iter->second.size == size)
+		return iter->second.valid;
+
 	File file{ ipa->path() };
 	if (!file.open(File::OpenModeFlag::ReadOnly))
 		return false;
@@ -317,6 +428,8 @@ bool IPAManager::isSignatureValid([[maybe_unused]] IPAModule *ipa) const
 		<< "IPA module " << ipa->path() << " signature is "
 		<< (valid ? "valid" : "not valid");
 
+	signatures_[ipa->path()] = { mtime, size, valid };
+
 	return valid;
 #else
 	return false;
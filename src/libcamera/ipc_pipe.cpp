@@ -118,6 +118,102 @@ IPCUnixSocket::Payload IPCMessage::payload() const
 	return payload;
 }
 
+namespace {
+
+/*
+ * The header of each message in a batch, followed by the message data. The
+ * file descriptors of all messages are concatenated in the batch message.
+ */
+struct IPCBatchEntry {
+	IPCMessage::Header header;
+	uint32_t dataSize;
+	uint32_t numFds;
+};
+
+} /* namespace */
+
+/**
+ * \brief Combine multiple messages in a single batch message
+ * \param[in] header The header of the batch message
+ * \param[in] messages The messages to combine
+ *
+ * Batching allows sending multiple messages with a single IPC transaction. The
+ * receiver splits the batch message with unbatch().
+ *
+ * \return The batch message
+ */
+IPCMessage IPCMessage::batch(const Header &header,
+			     const std::vector<IPCMessage> &messages)
+{
+	IPCMessage batch(header);
+
+	size_t dataSize = 0;
+	size_t numFds = 0;
+	for (const IPCMessage &msg : messages) {
+		dataSize += sizeof(IPCBatchEntry) + msg.data_.size();
+		numFds += msg.fds_.size();
+	}
+
+	batch.data_.reserve(dataSize);
+	batch.fds_.reserve(numFds);
+
+	for (const IPCMessage &msg : messages) {
+		const IPCBatchEntry entry = {
+			msg.header_,
+			static_cast<uint32_t>(msg.data_.size()),
+			static_cast<uint32_t>(msg.fds_.size()),
+		};
+		const uint8_t *ptr = reinterpret_cast<const uint8_t *>(&entry);
+
+		batch.data_.insert(batch.data_.end(), ptr, ptr + sizeof(entry));
+		batch.data_.insert(batch.data_.end(), msg.data_.begin(), msg.data_.end());
+		batch.fds_.insert(batch.fds_.end(), msg.fds_.begin(), msg.fds_.end());
+	}
+
+	return batch;
+}
+
+/**
+ * \brief Split a batch message into the messages it combines
+ * \param[out] messages The messages combined in the batch
+ *
+ * The messages are appended to \a messages in the order they have been
+ * combined by batch().
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL The batch message is malformed
+ */
+int IPCMessage::unbatch(std::vector<IPCMessage> *messages) const
+{
+	size_t offset = 0;
+	size_t fdOffset = 0;
+
+	while (offset < data_.size()) {
+		IPCBatchEntry entry;
+
+		if (data_.size() - offset < sizeof(entry))
+			return -EINVAL;
+
+		memcpy(&entry, data_.data() + offset, sizeof(entry));
+		offset += sizeof(entry);
+
+		if (data_.size() - offset < entry.dataSize ||
+		    fds_.size() - fdOffset < entry.numFds)
+			return -EINVAL;
+
+		IPCMessage &msg = messages->emplace_back(entry.header);
+		msg.data_.assign(data_.begin() + offset,
+				 data_.begin() + offset + entry.dataSize);
+		msg.fds_.assign(fds_.begin() + fdOffset,
+				fds_.begin() + fdOffset + entry.numFds);
+
+		offset += entry.dataSize;
+		fdOffset += entry.numFds;
+	}
+
+	return 0;
+}
+
 /**
  * \fn IPCMessage::header()
  * \brief Returns a reference to the header
@@ -43,6 +43,7 @@ IPCPipeUnixSocket::IPCPipeUnixSocket(const char *ipaModulePath,
 	fds.push_back(fd.get());
 
 	proc_ = std::make_unique<Process>();
+	proc_->finished.connect(this, &IPCPipeUnixSocket::workerFinished);
 	int ret = proc_->start(ipaProxyWorkerPath, args, fds);
 	if (ret) {
 		LOG(IPCPipe, Error)
@@ -50,6 +51,15 @@ IPCPipeUnixSocket::IPCPipeUnixSocket(const char *ipaModulePath,
 		return;
 	}
 
+	/*
+	 * Transport the messages that don't carry file descriptors through
+	 * shared memory, to avoid the socket overhead on every call.
+	 */
+	ret = socket_->enableSharedMemory();
+	if (ret)
+		LOG(IPCPipe, Warning)
+			<< "Shared memory IPC unavailable, using socket only";
+
 	connected_ = true;
 }
 
@@ -112,6 +122,16 @@ void IPCPipeUnixSocket::readyRead()
 	recv.emit(ipcMessage);
 }
 
+void IPCPipeUnixSocket::workerFinished(enum Process::ExitStatus exitStatus,
+				       int exitCode)
+{
+	LOG(IPCPipe, Debug)
+		<< "Proxy worker process exited with status " << exitStatus
+		<< " and code " << exitCode;
+
+	connected_ = false;
+}
+
 int IPCPipeUnixSocket::call(const IPCUnixSocket::Payload &message,
 			    IPCUnixSocket::Payload *response, uint32_t cookie)
 {
@@ -7,10 +7,18 @@
 
 #include "libcamera/internal/ipc_unixsocket.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <deque>
+#include <fcntl.h>
 #include <poll.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <libcamera/base/event_notifier.h>
@@ -25,6 +33,208 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(IPCUnixSocket)
 
+namespace {
+
+/* Types of the messages sent over the socket */
+enum SocketMessageType : uint8_t {
+	SocketMessagePayload = 0,
+	SocketMessageRingSetup = 1,
+	SocketMessageRingAck = 2,
+};
+
+/* Types of the records stored in the rings */
+enum RingRecordType : uint32_t {
+	RingRecordPayload = 0,
+	RingRecordSocket = 1,
+};
+
+struct RingRecord {
+	uint32_t type;
+	uint32_t size;
+};
+
+/*
+ * The indices of a ring, free-running modulo 2^32. The head is written by the
+ * producer only, and the tail by the consumer only. They are stored in
+ * separate cache lines to avoid false sharing.
+ */
+struct RingControl {
+	alignas(64) std::atomic<uint32_t> head;
+	alignas(64) std::atomic<uint32_t> tail;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+	      "Ring indices must be lock-free to be shared between processes");
+
+/* The data size of each ring, a power of two */
+constexpr uint32_t kRingSize = 64 * 1024;
+
+constexpr size_t kRingBlockSize = sizeof(RingControl) + kRingSize;
+
+/* The size of the shared memory, holding one ring for each direction */
+constexpr size_t kSharedMemorySize = 2 * kRingBlockSize;
+
+constexpr uint32_t ringRecordSize(uint32_t size)
+{
+	return sizeof(RingRecord) + ((size + 7) & ~7U);
+}
+
+/* Copy \a size bytes to the \a ring data at index \a pos, wrapping around */
+void copyToRing(uint8_t *ring, uint32_t pos, const void *src, uint32_t size)
+{
+	const uint32_t offset = pos & (kRingSize - 1);
+	const uint32_t first = std::min(size, kRingSize - offset);
+
+	memcpy(ring + offset, src, first);
+	memcpy(ring, static_cast<const uint8_t *>(src) + first, size - first);
+}
+
+/* Copy \a size bytes from the \a ring data at index \a pos, wrapping around */
+void copyFromRing(void *dst, const uint8_t *ring, uint32_t pos, uint32_t size)
+{
+	const uint32_t offset = pos & (kRingSize - 1);
+	const uint32_t first = std::min(size, kRingSize - offset);
+
+	memcpy(dst, ring + offset, first);
+	memcpy(static_cast<uint8_t *>(dst) + first, ring, size - first);
+}
+
+} /* namespace */
+
+/*
+ * \class IPCUnixSocket::Ring
+ * \brief Shared memory rings for the two directions of an IPC channel
+ *
+ * Each ring is a single-producer single-consumer queue of records. The
+ * producer keeps the authoritative copy of the head index, and the consumer
+ * of the tail index, and both validate the indices written by the other side,
+ * as the other side may not be trusted.
+ */
+class IPCUnixSocket::Ring
+{
+public:
+	Ring(void *mem, UniqueFD txDoorbell, UniqueFD rxDoorbell, bool creator)
+		: mem_(mem), txDoorbell_(std::move(txDoorbell)),
+		  rxDoorbell_(std::move(rxDoorbell)), txHead_(0), rxTail_(0),
+		  sending_(false)
+	{
+		uint8_t *blocks[2] = {
+			static_cast<uint8_t *>(mem),
+			static_cast<uint8_t *>(mem) + kRingBlockSize,
+		};
+
+		if (creator)
+			std::swap(blocks[0], blocks[1]);
+
+		rxControl_ = reinterpret_cast<RingControl *>(blocks[0]);
+		rxData_ = blocks[0] + sizeof(RingControl);
+		txControl_ = reinterpret_cast<RingControl *>(blocks[1]);
+		txData_ = blocks[1] + sizeof(RingControl);
+	}
+
+	~Ring()
+	{
+		munmap(mem_, kSharedMemorySize);
+	}
+
+	bool canWrite(uint32_t size) const;
+	bool write(uint32_t type, const void *data, uint32_t size);
+	int read(uint32_t *type, std::vector<uint8_t> *data);
+	void ring();
+
+	void *mem_;
+
+	RingControl *txControl_;
+	uint8_t *txData_;
+	RingControl *rxControl_;
+	uint8_t *rxData_;
+
+	UniqueFD txDoorbell_;
+	UniqueFD rxDoorbell_;
+	std::unique_ptr<EventNotifier> rxNotifier_;
+
+	uint32_t txHead_;
+	uint32_t rxTail_;
+
+	bool sending_;
+	std::deque<Payload> received_;
+};
+
+/* Check if the transmit ring has enough free space for a record of \a size */
+bool IPCUnixSocket::Ring::canWrite(uint32_t size) const
+{
+	const uint32_t tail = txControl_->tail.load(std::memory_order_acquire);
+	const uint32_t used = txHead_ - tail;
+
+	return size <= kRingSize && used <= kRingSize &&
+	       ringRecordSize(size) <= kRingSize - used;
+}
+
+/*
+ * Write a record to the transmit ring. Return false if the ring doesn't have
+ * enough free space for the record.
+ */
+bool IPCUnixSocket::Ring::write(uint32_t type, const void *data, uint32_t size)
+{
+	if (!canWrite(size))
+		return false;
+
+	const RingRecord record = { type, size };
+	copyToRing(txData_, txHead_, &record, sizeof(record));
+	if (size)
+		copyToRing(txData_, txHead_ + sizeof(record), data, size);
+
+	txHead_ += ringRecordSize(size);
+	txControl_->head.store(txHead_, std::memory_order_release);
+
+	return true;
+}
+
+/*
+ * Read a record from the receive ring. Return -EAGAIN if the ring is empty,
+ * and -EPROTO if its content is invalid.
+ */
+int IPCUnixSocket::Ring::read(uint32_t *type, std::vector<uint8_t> *data)
+{
+	const uint32_t head = rxControl_->head.load(std::memory_order_acquire);
+	const uint32_t available = head - rxTail_;
+
+	if (!available)
+		return -EAGAIN;
+
+	if (available > kRingSize || available < sizeof(RingRecord))
+		return -EPROTO;
+
+	RingRecord record;
+	copyFromRing(&record, rxData_, rxTail_, sizeof(record));
+
+	if (record.size > kRingSize || ringRecordSize(record.size) > available)
+		return -EPROTO;
+
+	data->resize(record.size);
+	if (record.size)
+		copyFromRing(data->data(), rxData_, rxTail_ + sizeof(record),
+			     record.size);
+
+	rxTail_ += ringRecordSize(record.size);
+	rxControl_->tail.store(rxTail_, std::memory_order_release);
+
+	*type = record.type;
+
+	return 0;
+}
+
+/* Notify the other side that records have been written to the transmit ring */
+void IPCUnixSocket::Ring::ring()
+{
+	uint64_t value = 1;
+	if (::write(txDoorbell_.get(), &value, sizeof(value)) < 0) {
+		int ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to ring doorbell: " << strerror(-ret);
+	}
+}
+
 /**
  * \struct IPCUnixSocket::Payload
  * \brief Container for an IPC payload
@@ -65,6 +275,15 @@ LOG_DEFINE_CATEGORY(IPCUnixSocket)
  * it to the other side by passing the file descriptor to bind(). At that point
  * the channel is operation and communication is bidirectional and symmmetrical.
  *
+ * The side that created the channel can additionally switch it to a shared
+ * memory transport with enableSharedMemory(). Payloads are then copied to ring
+ * buffers in memory shared by the two processes, and the receiver is notified
+ * through an eventfd, avoiding the socket system calls and copies through the
+ * kernel. Payloads that carry file descriptors, and payloads that don't fit in
+ * the ring buffer, are still transported over the socket. Payload ordering is
+ * guaranteed across both transports. The switch is transparent to the users of
+ * the two sides of the channel.
+ *
  * \context This class is \threadbound.
  */
 
@@ -148,6 +367,8 @@ void IPCUnixSocket::close()
 	delete notifier_;
 	notifier_ = nullptr;
 
+	ring_.reset();
+
 	fd_.reset();
 	headerReceived_ = false;
 }
@@ -161,6 +382,117 @@ bool IPCUnixSocket::isBound() const
 	return fd_.isValid();
 }
 
+/**
+ * \brief Switch the IPC channel to the shared memory transport
+ *
+ * This function creates the shared memory ring buffers and the eventfd
+ * notifiers, and passes them to the remote side of the channel. It shall only
+ * be called on the side that created the channel with create(), and the remote
+ * side shall use the IPCUnixSocket class to bind to the channel. Payloads sent
+ * after this function returns successfully are transported through the shared
+ * memory. Payloads received from the remote side switch to the shared memory
+ * when the remote side has processed the request.
+ *
+ * If this function fails, the IPC channel keeps operating over the socket.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int IPCUnixSocket::enableSharedMemory()
+{
+	int ret;
+
+	if (!isBound())
+		return -ENOTCONN;
+
+	if (ring_)
+		return -EBUSY;
+
+#if HAVE_MEMFD_CREATE
+	UniqueFD memfd(memfd_create("libcamera-ipc", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+#else
+	UniqueFD memfd(syscall(SYS_memfd_create, "libcamera-ipc",
+			       MFD_CLOEXEC | MFD_ALLOW_SEALING));
+#endif
+	if (!memfd.isValid()) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to create shared memory: " << strerror(-ret);
+		return ret;
+	}
+
+	/*
+	 * Seal the memory size to prevent the remote side from truncating it,
+	 * which would cause accesses to the mapping to fail with SIGBUS.
+	 */
+	if (ftruncate(memfd.get(), kSharedMemorySize) < 0 ||
+	    fcntl(memfd.get(), F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to size shared memory: " << strerror(-ret);
+		return ret;
+	}
+
+	void *mem = mmap(nullptr, kSharedMemorySize, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, memfd.get(), 0);
+	if (mem == MAP_FAILED) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to map shared memory: " << strerror(-ret);
+		return ret;
+	}
+
+	new (mem) RingControl{};
+	new (static_cast<uint8_t *>(mem) + kRingBlockSize) RingControl{};
+
+	std::array<UniqueFD, 2> doorbells{
+		UniqueFD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+		UniqueFD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+	};
+	if (!doorbells[0].isValid() || !doorbells[1].isValid()) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to create eventfd: " << strerror(-ret);
+		munmap(mem, kSharedMemorySize);
+		return ret;
+	}
+
+	/*
+	 * Pass the memory and the doorbells to the remote side, which uses
+	 * them in the opposite directions.
+	 */
+	const uint32_t size = kRingSize;
+	const int32_t fds[3] = {
+		memfd.get(), doorbells[0].get(), doorbells[1].get(),
+	};
+
+	Header hdr = {};
+	hdr.data = sizeof(size);
+	hdr.fds = std::size(fds);
+	hdr.type = SocketMessageRingSetup;
+
+	ret = ::send(fd_.get(), &hdr, sizeof(hdr), 0);
+	if (ret < 0) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to send: " << strerror(-ret);
+		munmap(mem, kSharedMemorySize);
+		return ret;
+	}
+
+	ret = sendData(&size, sizeof(size), fds, std::size(fds));
+	if (ret < 0) {
+		munmap(mem, kSharedMemorySize);
+		return ret;
+	}
+
+	ring_ = std::make_unique<Ring>(mem, std::move(doorbells[0]),
+				       std::move(doorbells[1]), true);
+	ring_->sending_ = true;
+
+	return 0;
+}
+
 /**
  * \brief Send a message payload
  * \param[in] payload Message payload to send
@@ -173,19 +505,56 @@ bool IPCUnixSocket::isBound() const
  */
 int IPCUnixSocket::send(const Payload &payload)
 {
-	int ret;
-
 	if (!isBound())
 		return -ENOTCONN;
 
+	if (payload.data.empty() && payload.fds.empty())
+		return -EINVAL;
+
+	if (ring_ && ring_->sending_)
+		return sendRing(payload);
+
+	return sendSocket(payload);
+}
+
+int IPCUnixSocket::sendRing(const Payload &payload)
+{
+	if (payload.fds.empty() && payload.data.size() <= kRingSize &&
+	    ring_->write(RingRecordPayload, payload.data.data(),
+			 payload.data.size())) {
+		ring_->ring();
+		return 0;
+	}
+
+	/*
+	 * Send the payload over the socket, and queue a record to the ring to
+	 * tell the remote side to receive it from the socket, which preserves
+	 * ordering. The record must be queued after the payload is sent, make
+	 * sure the ring has room for it first.
+	 */
+	if (!ring_->canWrite(0)) {
+		LOG(IPCUnixSocket, Error) << "Shared memory ring full";
+		return -ENOBUFS;
+	}
+
+	int ret = sendSocket(payload);
+	if (ret)
+		return ret;
+
+	ring_->write(RingRecordSocket, nullptr, 0);
+	ring_->ring();
+
+	return 0;
+}
+
+int IPCUnixSocket::sendSocket(const Payload &payload)
+{
 	Header hdr = {};
 	hdr.data = payload.data.size();
 	hdr.fds = payload.fds.size();
+	hdr.type = SocketMessagePayload;
 
-	if (!hdr.data && !hdr.fds)
-		return -EINVAL;
-
-	ret = ::send(fd_.get(), &hdr, sizeof(hdr), 0);
+	int ret = ::send(fd_.get(), &hdr, sizeof(hdr), 0);
 	if (ret < 0) {
 		ret = -errno;
 		LOG(IPCUnixSocket, Error)
@@ -218,6 +587,15 @@ int IPCUnixSocket::receive(Payload *payload)
 	if (!isBound())
 		return -ENOTCONN;
 
+	if (ring_ && ring_->rxNotifier_) {
+		if (ring_->received_.empty())
+			return -EAGAIN;
+
+		*payload = std::move(ring_->received_.front());
+		ring_->received_.pop_front();
+		return 0;
+	}
+
 	if (!headerReceived_)
 		return -EAGAIN;
 
@@ -240,6 +618,41 @@ int IPCUnixSocket::receive(Payload *payload)
  * \brief A Signal emitted when a message is ready to be read
  */
 
+/**
+ * \var IPCUnixSocket::disconnected
+ * \brief A Signal emitted when the remote side has closed the channel
+ *
+ * The signal is only emitted for channels bound to connection-oriented
+ * sockets, such as SOCK_SEQPACKET sockets accepted from a listening socket.
+ * The channel stays bound, and shall be closed with close().
+ */
+
+/*
+ * Receive a payload from the socket when told to by the ring. The payload has
+ * been sent before the ring record, it is thus available immediately.
+ */
+int IPCUnixSocket::receiveSocket(Payload *payload)
+{
+	Header hdr;
+
+	int ret = ::recv(fd_.get(), &hdr, sizeof(hdr), 0);
+	if (ret < 0) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to receive header: " << strerror(-ret);
+		return ret;
+	}
+
+	if (hdr.type != SocketMessagePayload)
+		return -EPROTO;
+
+	payload->data.resize(hdr.data);
+	payload->fds.resize(hdr.fds);
+
+	return recvData(payload->data.data(), hdr.data,
+			payload->fds.data(), hdr.fds);
+}
+
 int IPCUnixSocket::sendData(const void *buffer, size_t length,
 			    const int32_t *fds, unsigned int num)
 {
@@ -328,6 +741,27 @@ void IPCUnixSocket::dataNotifier()
 			return;
 		}
 
+		/*
+		 * Headers are never empty, a zero-length read indicates that
+		 * the remote side of a connection-oriented socket has closed
+		 * the channel.
+		 */
+		if (ret == 0) {
+			notifier_->setEnabled(false);
+			disconnected.emit();
+			return;
+		}
+
+		/*
+		 * The remote side has switched to the shared memory for the
+		 * payloads it sends, all the following payloads will be
+		 * announced through the ring.
+		 */
+		if (header_.type == SocketMessageRingAck) {
+			startRingReception();
+			return;
+		}
+
 		headerReceived_ = true;
 	}
 
@@ -344,8 +778,146 @@ void IPCUnixSocket::dataNotifier()
 	if (!(fds.revents & POLLIN))
 		return;
 
+	if (header_.type == SocketMessageRingSetup) {
+		Payload setup;
+		setup.data.resize(header_.data);
+		setup.fds.resize(header_.fds);
+
+		ret = recvData(setup.data.data(), header_.data,
+			       setup.fds.data(), header_.fds);
+		headerReceived_ = false;
+		if (ret < 0)
+			return;
+
+		ret = attachRing(setup);
+		if (ret < 0)
+			LOG(IPCUnixSocket, Error)
+				<< "Failed to attach shared memory: "
+				<< strerror(-ret);
+		return;
+	}
+
 	notifier_->setEnabled(false);
 	readyRead.emit();
 }
 
+/*
+ * Attach to the shared memory rings created by the remote side with
+ * enableSharedMemory(), and acknowledge the switch.
+ */
+int IPCUnixSocket::attachRing(Payload &setup)
+{
+	std::vector<UniqueFD> fds;
+	for (int32_t fd : setup.fds)
+		fds.emplace_back(fd);
+
+	if (ring_)
+		return -EBUSY;
+
+	if (fds.size() != 3 || setup.data.size() != sizeof(uint32_t))
+		return -EPROTO;
+
+	uint32_t size;
+	memcpy(&size, setup.data.data(), sizeof(size));
+	if (size != kRingSize)
+		return -EPROTO;
+
+	/*
+	 * Make sure the memory can't be truncated by the remote side, which
+	 * would cause accesses to the mapping to fail with SIGBUS.
+	 */
+	struct stat st;
+	int seals = fcntl(fds[0].get(), F_GET_SEALS);
+	if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_GROW)) !=
+			 (F_SEAL_SHRINK | F_SEAL_GROW) ||
+	    fstat(fds[0].get(), &st) < 0 ||
+	    static_cast<size_t>(st.st_size) != kSharedMemorySize)
+		return -EPROTO;
+
+	void *mem = mmap(nullptr, kSharedMemorySize, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fds[0].get(), 0);
+	if (mem == MAP_FAILED)
+		return -errno;
+
+	ring_ = std::make_unique<Ring>(mem, std::move(fds[2]), std::move(fds[1]),
+				       false);
+
+	startRingReception();
+
+	Header hdr = {};
+	hdr.type = SocketMessageRingAck;
+
+	int ret = ::send(fd_.get(), &hdr, sizeof(hdr), 0);
+	if (ret < 0) {
+		ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to send: " << strerror(-ret);
+		return ret;
+	}
+
+	ring_->sending_ = true;
+
+	return 0;
+}
+
+/*
+ * Stop receiving payloads from the socket, and start receiving them through
+ * the ring.
+ */
+void IPCUnixSocket::startRingReception()
+{
+	if (!ring_ || ring_->rxNotifier_)
+		return;
+
+	notifier_->setEnabled(false);
+
+	ring_->rxNotifier_ = std::make_unique<EventNotifier>(ring_->rxDoorbell_.get(),
+							     EventNotifier::Read);
+	ring_->rxNotifier_->activated.connect(this, &IPCUnixSocket::ringNotifier);
+
+	LOG(IPCUnixSocket, Debug) << "Receiving through shared memory";
+}
+
+void IPCUnixSocket::ringNotifier()
+{
+	uint64_t value;
+	if (::read(ring_->rxDoorbell_.get(), &value, sizeof(value)) < 0 &&
+	    errno != EAGAIN) {
+		int ret = -errno;
+		LOG(IPCUnixSocket, Error)
+			<< "Failed to read doorbell: " << strerror(-ret);
+		return;
+	}
+
+	unsigned int count = 0;
+
+	while (true) {
+		Payload payload;
+		uint32_t type;
+
+		int ret = ring_->read(&type, &payload.data);
+		if (ret == -EAGAIN)
+			break;
+
+		if (ret == 0 && type == RingRecordSocket)
+			ret = receiveSocket(&payload);
+		else if (ret == 0 && type != RingRecordPayload)
+			ret = -EPROTO;
+
+		if (ret < 0) {
+			LOG(IPCUnixSocket, Error)
+				<< "Invalid shared memory ring content";
+			ring_->rxNotifier_->setEnabled(false);
+			break;
+		}
+
+		ring_->received_.push_back(std::move(payload));
+		count++;
+	}
+
+	/* The readyRead handlers may close the channel, destroying the ring. */
+	for (; count && ring_ && !ring_->received_.empty(); count--)
+		readyRead.emit();
+}
+
 } /* namespace libcamera */
@@ -0,0 +1,156 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2020, Google Inc.
+ *
+ * Per-frame ISP buffers tracking
+ */
+
+#include "libcamera/internal/isp_frames.h"
+
+/**
+ * \file isp_frames.h
+ * \brief Tracking of the ISP buffers associated with frames
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(IspFrames)
+
+/**
+ * \struct IspFrameInfo
+ * \brief Tracking information for a frame processed by an ISP
+ *
+ * Pipeline handlers derive from this structure to store additional
+ * pipeline-specific information for each frame.
+ *
+ * \var IspFrameInfo::frame
+ * \brief The frame number
+ *
+ * \var IspFrameInfo::request
+ * \brief The request the frame is processed for
+ *
+ * \var IspFrameInfo::paramBuffer
+ * \brief The ISP parameters buffer for the frame, or nullptr if none
+ *
+ * \var IspFrameInfo::statBuffer
+ * \brief The ISP statistics buffer for the frame, or nullptr if none
+ *
+ * \var IspFrameInfo::paramDequeued
+ * \brief True when the parameters buffer has been consumed by the ISP
+ *
+ * \var IspFrameInfo::metadataProcessed
+ * \brief True when the metadata for the frame has been produced
+ */
+
+/**
+ * \class IspFrames
+ * \brief Track the ISP parameters and statistics buffers used by frames
+ * \tparam Info The pipeline-specific frame information type, derived from
+ * IspFrameInfo
+ * \tparam Capacity The maximum number of frames in flight
+ *
+ * The IspFrames class manages the pool of parameters and statistics buffers
+ * shared by the frames processed by an ISP, and stores the tracking
+ * information for each frame in flight in a fixed-size ring indexed by frame
+ * number. Creating and completing frames doesn't allocate memory.
+ *
+ * Frames whose tracking information can't be created, either because no
+ * parameters or statistics buffer is available or because the ring slot for
+ * the frame number is still used by an earlier frame, are counted as
+ * underruns. The pipeline handler is expected to retry when the
+ * bufferAvailable signal is emitted.
+ */
+
+/**
+ * \fn IspFrames::IspFrames()
+ * \brief Construct an empty IspFrames instance
+ */
+
+/**
+ * \fn IspFrames::init()
+ * \brief Initialise the pool of parameters and statistics buffers
+ * \param[in] paramBuffers The parameters buffers
+ * \param[in] statBuffers The statistics buffers
+ *
+ * All frames in flight are dropped and the underrun counter is reset.
+ */
+
+/**
+ * \fn IspFrames::clear()
+ * \brief Drop all frames in flight and release the buffers pool
+ */
+
+/**
+ * \fn IspFrames::create()
+ * \brief Create the tracking information for a frame
+ * \param[in] frame The frame number
+ * \param[in] request The request the frame is processed for
+ * \param[in] useBuffers Whether the frame uses parameters and statistics
+ * buffers
+ *
+ * When \a useBuffers is true, a parameters and a statistics buffer are taken
+ * from the pool and associated with the \a request.
+ *
+ * \return The frame tracking information, or nullptr on underrun
+ */
+
+/**
+ * \fn IspFrames::remove()
+ * \brief Remove the tracking information for a frame
+ * \param[in] info The frame tracking information
+ *
+ * The parameters and statistics buffers of the frame are returned to the pool.
+ */
+
+/**
+ * \fn IspFrames::tryComplete()
+ * \brief Complete a frame if all its processing is done
+ * \param[in] info The frame tracking information
+ *
+ * A frame is complete when all the buffers of its request have completed, its
+ * metadata has been processed and its parameters buffer, if any, has been
+ * dequeued. Completed frames are removed and the bufferAvailable signal is
+ * emitted.
+ *
+ * \return True if the frame has been completed, false otherwise
+ */
+
+/**
+ * \fn IspFrames::find(unsigned int frame)
+ * \brief Find the tracking information for a frame
+ * \param[in] frame The frame number
+ * \return The frame tracking information, or nullptr if not found
+ */
+
+/**
+ * \fn IspFrames::find(const Request *request)
+ * \brief Find the tracking information for a request
+ * \param[in] request The request
+ * \return The frame tracking information, or nullptr if not found
+ */
+
+/**
+ * \fn IspFrames::find(const FrameBuffer *buffer)
+ * \brief Find the tracking information for a buffer
+ * \param[in] buffer The buffer
+ *
+ * The lookup is based on the request associated with the \a buffer, and thus
+ * applies to the request buffers, to the parameters and statistics buffers,
+ * and to any internal buffer associated with the request.
+ *
+ * \return The frame tracking information, or nullptr if not found
+ */
+
+/**
+ * \fn IspFrames::underruns()
+ * \brief Retrieve the number of underruns since the last initialisation
+ * \return The number of frames whose tracking information couldn't be created
+ */
+
+/**
+ * \var IspFrames::bufferAvailable
+ * \brief Signal emitted when a frame completes and its buffers become
+ * available
+ */
+
+} /* namespace libcamera */
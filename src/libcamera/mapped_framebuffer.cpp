@@ -240,4 +240,100 @@ MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
 	}
 }
 
+/**
+ * \class MappedFrameBufferCache
+ * \brief Cache of CPU mappings of frame buffers
+ *
+ * Mapping a FrameBuffer is costly, especially for large buffers. Users that
+ * access the same set of buffers repeatedly from the CPU, typically when
+ * processing frames in software, can use a MappedFrameBufferCache to map each
+ * buffer on first use only and retrieve the existing mapping afterwards.
+ *
+ * Mappings are identified by the FrameBuffer pointer. As a FrameBuffer may be
+ * destroyed and a new one allocated at the same address, the cache also tracks
+ * the file descriptor of the first plane and invalidates the mapping when it
+ * changes. The cache keeps a reference to the file descriptor, the mappings
+ * hold the memory of the buffers until the cache is cleared with clear() or
+ * destroyed. Users should call clear() when the set of buffers changes, for
+ * instance when stopping streaming.
+ *
+ * As CPU mappings of dma-buf memory are not coherent with device accesses,
+ * accesses through a cached mapping shall be bracketed with dma-buf
+ * synchronization. The map() function optionally creates the DmaSyncer
+ * instances to do so.
+ */
+
+/**
+ * \brief Retrieve the CPU mapping of a frame buffer
+ * \param[in] buffer The frame buffer
+ * \param[in] flags The mapping protection flags
+ * \param[out] syncers Vector to store dma-buf synchronization objects
+ *
+ * Return the cached mapping for \a buffer, creating it if the buffer hasn't
+ * been mapped yet or if the cached mapping doesn't include all the \a flags.
+ *
+ * If \a syncers is not null, a DmaSyncer is appended for each distinct dma-buf
+ * of the buffer, with a synchronization type matching \a flags. The CPU access
+ * is synchronized with device accesses for the lifetime of the syncers, callers
+ * shall destroy them when they are done accessing the buffer memory.
+ *
+ * \return The mapping of \a buffer, or nullptr if the buffer can't be mapped
+ */
+MappedFrameBuffer *MappedFrameBufferCache::map(const FrameBuffer *buffer,
+					       MappedFrameBuffer::MapFlags flags,
+					       std::vector<DmaSyncer> *syncers)
+{
+	const SharedFD &fd = buffer->planes()[0].fd;
+	MappedFrameBuffer *mapped = nullptr;
+
+	auto it = mappings_.find(buffer);
+	if (it != mappings_.end()) {
+		Entry &entry = it->second;
+		if (entry.fd == fd && (entry.flags & flags) == flags)
+			mapped = entry.mapping.get();
+		else
+			mappings_.erase(it);
+	}
+
+	if (!mapped) {
+		auto mapping = std::make_unique<MappedFrameBuffer>(buffer, flags);
+		if (!mapping->isValid())
+			return nullptr;
+
+		mapped = mapping.get();
+		mappings_[buffer] = { fd, flags, std::move(mapping) };
+	}
+
+	if (!syncers)
+		return mapped;
+
+	DmaSyncer::SyncType type;
+	if (flags == MappedFrameBuffer::MapFlag::ReadWrite)
+		type = DmaSyncer::SyncType::ReadWrite;
+	else if (flags & MappedFrameBuffer::MapFlag::Write)
+		type = DmaSyncer::SyncType::Write;
+	else
+		type = DmaSyncer::SyncType::Read;
+
+	const std::vector<FrameBuffer::Plane> &planes = buffer->planes();
+	for (auto plane = planes.begin(); plane != planes.end(); ++plane) {
+		auto first = std::find_if(planes.begin(), plane,
+					  [&](const FrameBuffer::Plane &p) {
+						  return p.fd == plane->fd;
+					  });
+		if (first == plane)
+			syncers->emplace_back(plane->fd, type);
+	}
+
+	return mapped;
+}
+
+/**
+ * \brief Unmap and remove all buffers from the cache
+ */
+void MappedFrameBufferCache::clear()
+{
+	mappings_.clear();
+}
+
 } /* namespace libcamera */
@@ -14,10 +14,12 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 #include <linux/media.h>
 
+#include <libcamera/base/event_notifier.h>
 #include <libcamera/base/log.h>
 
 /**
@@ -147,6 +149,13 @@ bool MediaDevice::lock()
 	if (lockf(fd_.get(), F_TLOCK, 0))
 		return false;
 
+	/*
+	 * Links may have been reconfigured by other users while the device
+	 * was unlocked. Refresh their state, as MediaLink::setEnabled() skips
+	 * links whose cached state matches the requested state.
+	 */
+	updateLinks();
+
 	return true;
 }
 
@@ -453,6 +462,63 @@ int MediaDevice::disableLinks()
 	return 0;
 }
 
+/**
+ * \brief Allocate media requests
+ * \param[in] count Number of requests to allocate
+ * \param[out] requests Vector to store the allocated requests
+ *
+ * This function allocates \a count media requests from the media device and
+ * stores them in the \a requests vector. The media device shall be acquired
+ * with acquire() before requests can be allocated. The allocated requests can
+ * outlive the media device file descriptor, they are freed when the
+ * MediaRequest instances are destroyed.
+ *
+ * Media requests are only supported by drivers that implement the Media
+ * Request API. This function returns -ENOTTY for other drivers, which
+ * pipeline handlers can use to fall back to per-device controls.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENOTTY The media device doesn't support requests
+ */
+int MediaDevice::allocateRequests(unsigned int count,
+				  std::vector<std::unique_ptr<MediaRequest>> *requests)
+{
+	if (!fd_.isValid()) {
+		LOG(MediaDevice, Error)
+			<< "Can't allocate requests on a closed media device";
+		return -EBADF;
+	}
+
+	requests->clear();
+	requests->reserve(count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		int fd;
+
+		int ret = ioctl(fd_.get(), MEDIA_IOC_REQUEST_ALLOC, &fd);
+		if (ret < 0) {
+			ret = -errno;
+
+			/* Lack of request support is expected, not an error. */
+			if (ret == -ENOTTY)
+				LOG(MediaDevice, Debug)
+					<< "Media requests not supported";
+			else
+				LOG(MediaDevice, Error)
+					<< "Failed to allocate request: "
+					<< strerror(-ret);
+
+			requests->clear();
+			return ret;
+		}
+
+		requests->push_back(std::unique_ptr<MediaRequest>(
+			new MediaRequest(UniqueFD(fd))));
+	}
+
+	return 0;
+}
+
 /**
  * \var MediaDevice::disconnected
  * \brief Signal emitted when the media device is disconnected from the system
@@ -507,6 +573,41 @@ void MediaDevice::close()
 	fd_.reset();
 }
 
+/**
+ * \brief Update the cached state of all data links from the kernel
+ * \return 0 on success or a negative error code otherwise
+ */
+int MediaDevice::updateLinks()
+{
+	struct media_v2_topology topology = {};
+	std::vector<struct media_v2_link> links;
+
+	/* Retrieve the number of links first, and then the links. */
+	for (unsigned int i = 0; i < 2; i++) {
+		links.resize(topology.num_links);
+		topology.ptr_links = reinterpret_cast<uintptr_t>(links.data());
+
+		if (ioctl(fd_.get(), MEDIA_IOC_G_TOPOLOGY, &topology) < 0) {
+			int ret = -errno;
+			LOG(MediaDevice, Warning)
+				<< "Failed to update links: " << strerror(-ret);
+			return ret;
+		}
+	}
+
+	for (const struct media_v2_link &mediaLink : links) {
+		if ((mediaLink.flags & MEDIA_LNK_FL_LINK_TYPE) !=
+		    MEDIA_LNK_FL_DATA_LINK)
+			continue;
+
+		MediaLink *link = dynamic_cast<MediaLink *>(object(mediaLink.id));
+		if (link)
+			link->flags_ = mediaLink.flags;
+	}
+
+	return 0;
+}
+
 /**
  * \var MediaDevice::objects_
  * \brief Global map of media objects (entities, pads, links) keyed by their
@@ -836,4 +937,106 @@ int MediaDevice::setupLink(const MediaLink *link, unsigned int flags)
 	return 0;
 }
 
+/**
+ * \class MediaRequest
+ * \brief A Media Controller request
+ *
+ * The MediaRequest class wraps a request allocated from a media device through
+ * the kernel Media Request API. A request groups V4L2 controls and buffers for
+ * multiple devices of the media graph, which the driver then applies
+ * atomically when processing the request. Compared to setting controls on
+ * each device separately, this guarantees that all the parameters of a frame
+ * are applied to that frame, without having to account for the delays of the
+ * individual controls.
+ *
+ * Requests are allocated with MediaDevice::allocateRequests(). Controls and
+ * buffers are bound to a request by passing it to V4L2Device::setControls()
+ * and V4L2VideoDevice::queueBuffer(). The request is then queued to the driver
+ * with queue(), and the completed signal is emitted once the driver has
+ * completed it. A completed request shall be reinitialised with reinit()
+ * before it can be reused.
+ */
+
+/**
+ * \brief Construct a MediaRequest
+ * \param[in] fd The request file descriptor
+ */
+MediaRequest::MediaRequest(UniqueFD fd)
+	: fd_(std::move(fd))
+{
+	notifier_ = std::make_unique<EventNotifier>(fd_.get(),
+						    EventNotifier::Exception);
+	notifier_->setEnabled(false);
+	notifier_->activated.connect(this, &MediaRequest::requestReady);
+}
+
+MediaRequest::~MediaRequest() = default;
+
+/**
+ * \fn MediaRequest::fd()
+ * \brief Retrieve the request file descriptor
+ * \return The request file descriptor
+ */
+
+/**
+ * \brief Queue the request to the driver
+ *
+ * Queue the request with all the controls and buffers bound to it. The request
+ * shall contain at least one buffer. The completed signal is emitted when the
+ * driver has completed the request.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int MediaRequest::queue()
+{
+	if (::ioctl(fd_.get(), MEDIA_REQUEST_IOC_QUEUE) < 0) {
+		int ret = -errno;
+		LOG(MediaDevice, Error)
+			<< "Failed to queue request: " << strerror(-ret);
+		return ret;
+	}
+
+	notifier_->setEnabled(true);
+
+	return 0;
+}
+
+/**
+ * \brief Reinitialise the request for reuse
+ *
+ * Clear all the controls and buffers bound to the request, to prepare it for
+ * reuse. The request shall not be queued.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int MediaRequest::reinit()
+{
+	notifier_->setEnabled(false);
+
+	if (::ioctl(fd_.get(), MEDIA_REQUEST_IOC_REINIT) < 0) {
+		int ret = -errno;
+		LOG(MediaDevice, Error)
+			<< "Failed to reinitialise request: " << strerror(-ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * \var MediaRequest::completed
+ * \brief Signal emitted when the driver has completed the request
+ */
+
+/**
+ * \brief Slot to handle the request completion event
+ */
+void MediaRequest::requestReady()
+{
+	/* The request stays ready until it gets reinitialised. */
+	notifier_->setEnabled(false);
+
+	completed.emit(this);
+}
+
 } /* namespace libcamera */
@@ -117,6 +117,10 @@ LOG_DECLARE_CATEGORY(MediaDevice)
  * Enabling a link establishes a data connection between two pads, while
  * disabling it interrupts that connection.
  *
+ * The link state is cached, and refreshed from the kernel when the media
+ * device is locked. Setting a link to its current state is a no-op and doesn't
+ * access the device.
+ *
  * \return 0 on success or a negative error code otherwise
  */
 int MediaLink::setEnabled(bool enable)
@@ -124,6 +128,9 @@ int MediaLink::setEnabled(bool enable)
 	unsigned int flags = (flags_ & ~MEDIA_LNK_FL_ENABLED)
 			   | (enable ? MEDIA_LNK_FL_ENABLED : 0);
 
+	if (flags == flags_)
+		return 0;
+
 	int ret = dev_->setupLink(this, flags);
 	if (ret)
 		return ret;
@@ -6,6 +6,7 @@
  */
 
 #include <algorithm>
+#include <fstream>
 #include <map>
 #include <memory>
 #include <set>
@@ -30,11 +31,30 @@
 #include "libcamera/internal/v4l2_videodevice.h"
 
 #include "linux/media-bus-format.h"
+#include "linux/v4l2-controls.h"
 
 namespace libcamera {
 
 LOG_DEFINE_CATEGORY(ISI)
 
+namespace {
+
+/*
+ * Memory write bandwidth budget shared by all ISI channels, in bytes per
+ * second, indexed by the compatible string of the ISI DT node.
+ *
+ * Neither the DT nor the ISI driver describe the memory bandwidth available to
+ * the ISI, and the budget only matters on SoCs where the channels can be shared
+ * by multiple cameras. The i.MX8MP budget covers two concurrent 1920x1080
+ * streams at 60fps in 32-bit formats (2 x 1920 x 1080 x 60 x 4 bytes). SoCs
+ * not listed here skip bandwidth accounting.
+ */
+const std::map<std::string, uint64_t> isiMaxBandwidth = {
+	{ "fsl,imx8mp-isi", 1000000000 },
+};
+
+} /* namespace */
+
 class PipelineHandlerISI;
 
 class ISICameraData : public Camera::Private
@@ -70,6 +90,10 @@ public:
 
 	std::vector<Stream *> enabledStreams_;
 
+	/* The ISI channel assigned to each stream, indexed by stream. */
+	std::vector<unsigned int> channels_;
+	uint64_t bandwidth_ = 0;
+
 	unsigned int xbarSink_;
 };
 
@@ -77,7 +101,7 @@ class ISICameraConfiguration : public CameraConfiguration
 {
 public:
 	ISICameraConfiguration(ISICameraData *data)
-		: data_(data)
+		: data_(data), pipe_(data->pipe())
 	{
 	}
 
@@ -86,14 +110,20 @@ public:
 	static const std::map<PixelFormat, unsigned int> formatsMap_;
 
 	V4L2SubdeviceFormat sensorFormat_;
+	uint64_t bandwidth_ = 0;
 
 private:
 	CameraConfiguration::Status
 	validateRaw(std::set<Stream *> &availableStreams, const Size &maxResolution);
 	CameraConfiguration::Status
 	validateYuv(std::set<Stream *> &availableStreams, const Size &maxResolution);
+	CameraConfiguration::Status validateBandwidth();
+
+	uint64_t streamBandwidth(const StreamConfiguration &cfg,
+				 uint64_t pixelRate) const;
 
 	const ISICameraData *data_;
+	const PipelineHandlerISI *pipe_;
 };
 
 class PipelineHandlerISI : public PipelineHandler
@@ -112,8 +142,21 @@ public:
 
 	int start(Camera *camera, const ControlList *controls) override;
 
+	/*
+	 * Each ISI channel has a line buffer of 2048 pixels, wider images
+	 * require chaining two consecutive channels.
+	 */
+	static constexpr unsigned int kLineBufferWidth = 2048;
+
+	uint64_t maxBandwidth() const { return maxBandwidth_; }
+
+	unsigned int freeChannels(const ISICameraData *data) const;
+	bool canChainChannels(const ISICameraData *data) const;
+	uint64_t freeBandwidth(const ISICameraData *data) const;
+
 protected:
 	void stopDevice(Camera *camera) override;
+	void releaseDevice(Camera *camera) override;
 
 	int queueRequestDevice(Camera *camera, Request *request) override;
 
@@ -137,12 +180,23 @@ private:
 						     const Size &size);
 	StreamConfiguration generateRawConfiguration(Camera *camera);
 
+	int reserveChannels(ISICameraData *data,
+			    const ISICameraConfiguration &config);
+	void releaseChannels(ISICameraData *data);
+	bool isPrimaryChannel(unsigned int channel) const;
+
+	uint64_t lookupMaxBandwidth() const;
+
 	void bufferReady(FrameBuffer *buffer);
 
 	MediaDevice *isiDev_;
+	uint64_t maxBandwidth_ = 0;
 
 	std::unique_ptr<V4L2Subdevice> crossbar_;
 	std::vector<Pipe> pipes_;
+
+	/* The camera each ISI channel is reserved by, if any. */
+	std::vector<const ISICameraData *> channelOwners_;
 };
 
 /* -----------------------------------------------------------------------------
@@ -500,15 +554,26 @@ CameraConfiguration::Status ISICameraConfiguration::validate()
 	if (config_.empty())
 		return Invalid;
 
-	/* Cap the number of streams to the number of available ISI pipes. */
-	if (config_.size() > availableStreams.size()) {
-		config_.resize(availableStreams.size());
+	/*
+	 * Cap the number of streams to the number of ISI pipes not reserved by
+	 * other cameras.
+	 */
+	unsigned int maxStreams = std::min<unsigned int>(availableStreams.size(),
+							 pipe_->freeChannels(data_));
+	if (!maxStreams) {
+		LOG(ISI, Error) << "No ISI channel available";
+		return Invalid;
+	}
+
+	if (config_.size() > maxStreams) {
+		config_.resize(maxStreams);
 		status = Adjusted;
 	}
 
 	/*
-	 * If more than a single stream is requested, the maximum allowed input
-	 * image width is 2048. Cap the maximum image size accordingly.
+	 * If more than a single stream is requested, or if no two consecutive
+	 * channels can be chained, the maximum allowed input image width is
+	 * the line buffer width. Cap the maximum image size accordingly.
 	 *
 	 * \todo The (size > 1) check only applies to i.MX8MP which has 2 ISI
 	 * channels. SoCs with more channels than the i.MX8MP are capable of
@@ -518,8 +583,9 @@ CameraConfiguration::Status ISICameraConfiguration::validate()
 	 */
 	CameraSensor *sensor = data_->sensor_.get();
 	Size maxResolution = sensor->resolution();
-	if (config_.size() > 1)
-		maxResolution.width = std::min(2048U, maxResolution.width);
+	if (config_.size() > 1 || !pipe_->canChainChannels(data_))
+		maxResolution.width = std::min(PipelineHandlerISI::kLineBufferWidth,
+					       maxResolution.width);
 
 	/* Validate streams according to the format of the first one. */
 	const PixelFormatInfo info = PixelFormatInfo::info(config_[0].pixelFormat);
@@ -600,6 +666,85 @@ CameraConfiguration::Status ISICameraConfiguration::validate()
 
 	LOG(ISI, Debug) << "Selected sensor format: " << sensorFormat_;
 
+	validationStatus = validateBandwidth();
+	if (validationStatus == Invalid)
+		return Invalid;
+
+	if (validationStatus == Adjusted)
+		status = Adjusted;
+
+	return status;
+}
+
+/*
+ * Estimate the memory bandwidth consumed by a stream. The ISI writes frames at
+ * the rate they are received from the sensor, which is bounded by the sensor
+ * pixel rate, scaled by the ratio between the stream and sensor sizes.
+ */
+uint64_t ISICameraConfiguration::streamBandwidth(const StreamConfiguration &cfg,
+						 uint64_t pixelRate) const
+{
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+	uint64_t sensorArea = static_cast<uint64_t>(sensorFormat_.size.width) *
+			      sensorFormat_.size.height;
+	uint64_t streamArea = static_cast<uint64_t>(cfg.size.width) *
+			      cfg.size.height;
+
+	return pixelRate * streamArea * info.bitsPerPixel / 8 / sensorArea;
+}
+
+/*
+ * Make sure the streams fit in the memory bandwidth not consumed by other
+ * cameras, dropping the last streams if they don't.
+ */
+CameraConfiguration::Status ISICameraConfiguration::validateBandwidth()
+{
+	Status status = Valid;
+
+	bandwidth_ = 0;
+
+	if (!pipe_->maxBandwidth()) {
+		LOG(ISI, Debug)
+			<< "ISI bandwidth unknown, skip bandwidth accounting";
+		return status;
+	}
+
+	const ControlInfoMap &controls = data_->sensor_->controls();
+	const auto it = controls.find(V4L2_CID_PIXEL_RATE);
+	if (it == controls.end()) {
+		LOG(ISI, Debug)
+			<< "Sensor pixel rate unknown, skip bandwidth accounting";
+		return status;
+	}
+
+	uint64_t pixelRate = it->second.max().get<int64_t>();
+	uint64_t available = pipe_->freeBandwidth(data_);
+
+	while (true) {
+		bandwidth_ = 0;
+		for (const StreamConfiguration &cfg : config_)
+			bandwidth_ += streamBandwidth(cfg, pixelRate);
+
+		if (bandwidth_ <= available)
+			break;
+
+		if (config_.size() == 1) {
+			LOG(ISI, Error)
+				<< "Stream bandwidth " << bandwidth_
+				<< " B/s exceeds the available " << available
+				<< " B/s";
+			return Invalid;
+		}
+
+		LOG(ISI, Debug)
+			<< "Stream " << config_.size() - 1
+			<< " dropped to fit the available bandwidth";
+		config_.pop_back();
+		status = Adjusted;
+	}
+
+	LOG(ISI, Debug) << "Estimated bandwidth: " << bandwidth_ << " B/s";
+
 	return status;
 }
 
@@ -612,6 +757,120 @@ PipelineHandlerISI::PipelineHandlerISI(CameraManager *manager)
 {
 }
 
+/* Count the ISI channels that are free or already reserved by \a data. */
+unsigned int PipelineHandlerISI::freeChannels(const ISICameraData *data) const
+{
+	return std::count_if(channelOwners_.begin(), channelOwners_.end(),
+			     [data](const ISICameraData *owner) {
+				     return !owner || owner == data;
+			     });
+}
+
+/* Check if two consecutive ISI channels are available to \a data. */
+bool PipelineHandlerISI::canChainChannels(const ISICameraData *data) const
+{
+	for (unsigned int i = 0; i + 1 < channelOwners_.size(); ++i) {
+		const ISICameraData *owner = channelOwners_[i];
+		const ISICameraData *next = channelOwners_[i + 1];
+
+		if ((!owner || owner == data) && (!next || next == data))
+			return true;
+	}
+
+	return false;
+}
+
+/* Compute the memory bandwidth not consumed by cameras other than \a data. */
+uint64_t PipelineHandlerISI::freeBandwidth(const ISICameraData *data) const
+{
+	std::set<const ISICameraData *> owners(channelOwners_.begin(),
+					       channelOwners_.end());
+	uint64_t used = 0;
+
+	for (const ISICameraData *owner : owners) {
+		if (owner && owner != data)
+			used += owner->bandwidth_;
+	}
+
+	return used < maxBandwidth_ ? maxBandwidth_ - used : 0;
+}
+
+/* Look up the ISI bandwidth budget from the compatible string of its DT node. */
+uint64_t PipelineHandlerISI::lookupMaxBandwidth() const
+{
+	std::ifstream file(crossbar_->devicePath() + "/of_node/compatible");
+	std::string compatible;
+
+	/* The property holds a list of NUL-separated strings. */
+	while (std::getline(file, compatible, '\0')) {
+		const auto it = isiMaxBandwidth.find(compatible);
+		if (it != isiMaxBandwidth.end())
+			return it->second;
+	}
+
+	return 0;
+}
+
+/*
+ * Reserve one ISI channel for each stream of the configuration, or two
+ * consecutive channels for a single stream wider than the line buffer.
+ */
+int PipelineHandlerISI::reserveChannels(ISICameraData *data,
+					const ISICameraConfiguration &config)
+{
+	bool chained = config.sensorFormat_.size.width > kLineBufferWidth;
+	unsigned int needed = chained ? 2 : 1;
+
+	releaseChannels(data);
+
+	data->channels_.assign(data->streams_.size(), pipes_.size());
+
+	for (const StreamConfiguration &cfg : config) {
+		unsigned int channel = 0;
+		for (; channel + needed <= channelOwners_.size(); ++channel) {
+			auto begin = channelOwners_.begin() + channel;
+			if (std::all_of(begin, begin + needed,
+					[](const ISICameraData *owner) {
+						return !owner;
+					}))
+				break;
+		}
+
+		if (channel + needed > channelOwners_.size()) {
+			releaseChannels(data);
+			return -EBUSY;
+		}
+
+		std::fill_n(channelOwners_.begin() + channel, needed, data);
+		data->channels_[data->pipeIndex(cfg.stream())] = channel;
+	}
+
+	data->bandwidth_ = config.bandwidth_;
+
+	return 0;
+}
+
+void PipelineHandlerISI::releaseChannels(ISICameraData *data)
+{
+	std::replace(channelOwners_.begin(), channelOwners_.end(),
+		     static_cast<const ISICameraData *>(data),
+		     static_cast<const ISICameraData *>(nullptr));
+
+	data->channels_.clear();
+	data->bandwidth_ = 0;
+}
+
+/* Check if \a channel is the first channel assigned to a stream. */
+bool PipelineHandlerISI::isPrimaryChannel(unsigned int channel) const
+{
+	const ISICameraData *owner = channelOwners_[channel];
+	if (!owner)
+		return false;
+
+	return std::find(owner->channels_.begin(), owner->channels_.end(),
+			 channel) != owner->channels_.end();
+}
+
 /*
  * Generate a StreamConfiguration for YUV/RGB use case.
  *
@@ -816,24 +1075,32 @@ int PipelineHandlerISI::configure(Camera *camera, CameraConfiguration *c)
 	const MediaPad *sensorSrc = data->sensor_->entity()->getPadByIndex(0);
 	sensorSrc->links()[0]->setEnabled(true);
 
+	/* Reserve the ISI channels the configuration has been validated for. */
+	int ret = reserveChannels(data, *camConfig);
+	if (ret) {
+		LOG(ISI, Error) << "ISI channels reserved by other cameras";
+		return ret;
+	}
+
 	/*
-	 * Reset the crossbar switch routing and enable one route for each
-	 * requested stream configuration.
-	 *
-	 * \todo Handle concurrent usage of multiple cameras by adjusting the
-	 * routing table instead of resetting it.
+	 * Program the crossbar switch routing with one route for each stream
+	 * of all the cameras holding ISI channels, to preserve the routes of
+	 * the other cameras.
 	 */
 	V4L2Subdevice::Routing routing = {};
 	unsigned int xbarFirstSource = crossbar_->entity()->pads().size() / 2 + 1;
 
-	for (const auto &[idx, config] : utils::enumerate(*c)) {
-		uint32_t sourcePad = xbarFirstSource + idx;
-		routing.emplace_back(V4L2Subdevice::Stream{ data->xbarSink_, 0 },
+	for (const auto &[channel, owner] : utils::enumerate(channelOwners_)) {
+		if (!isPrimaryChannel(channel))
+			continue;
+
+		uint32_t sourcePad = xbarFirstSource + channel;
+		routing.emplace_back(V4L2Subdevice::Stream{ owner->xbarSink_, 0 },
 				     V4L2Subdevice::Stream{ sourcePad, 0 },
 				     V4L2_SUBDEV_ROUTE_FL_ACTIVE);
 	}
 
-	int ret = crossbar_->setRouting(&routing, V4L2Subdevice::ActiveFormat);
+	ret = crossbar_->setRouting(&routing, V4L2Subdevice::ActiveFormat);
 	if (ret)
 		return ret;
 
@@ -950,6 +1217,11 @@ void PipelineHandlerISI::stopDevice(Camera *camera)
 	}
 }
 
+void PipelineHandlerISI::releaseDevice(Camera *camera)
+{
+	releaseChannels(cameraData(camera));
+}
+
 int PipelineHandlerISI::queueRequestDevice(Camera *camera, Request *request)
 {
 	for (auto &[stream, buffer] : request->buffers()) {
@@ -986,6 +1258,8 @@ bool PipelineHandlerISI::match(DeviceEnumerator *enumerator)
 	if (ret)
 		return false;
 
+	maxBandwidth_ = lookupMaxBandwidth();
+
 	for (unsigned int i = 0; ; ++i) {
 		std::string entityName = "mxc_isi." + std::to_string(i);
 		std::unique_ptr<V4L2Subdevice> isi =
@@ -1017,6 +1291,8 @@ bool PipelineHandlerISI::match(DeviceEnumerator *enumerator)
 		return false;
 	}
 
+	channelOwners_.resize(pipes_.size());
+
 	/*
 	 * Loop over all the crossbar switch sink pads to find connected CSI-2
 	 * receivers and camera sensors.
@@ -1090,9 +1366,13 @@ PipelineHandlerISI::Pipe *PipelineHandlerISI::pipeFromStream(Camera *camera,
 	ISICameraData *data = cameraData(camera);
 	unsigned int pipeIndex = data->pipeIndex(stream);
 
-	ASSERT(pipeIndex < pipes_.size());
+	ASSERT(pipeIndex < data->channels_.size());
 
-	return &pipes_[pipeIndex];
+	unsigned int channel = data->channels_[pipeIndex];
+
+	ASSERT(channel < pipes_.size());
+
+	return &pipes_[channel];
 }
 
 void PipelineHandlerISI::bufferReady(FrameBuffer *buffer)
@@ -1105,6 +1385,10 @@ void PipelineHandlerISI::bufferReady(FrameBuffer *buffer)
 		metadata.set(controls::SensorTimestamp,
 			     buffer->metadata().timestamp);
 
+	if (buffer->metadata().status == FrameMetadata::FrameSuccess)
+		recordLatency(request, CameraStatistics::StageDequeue,
+			      buffer->metadata().timestamp);
+
 	completeBuffer(request, buffer);
 	if (request->hasPendingBuffers())
 		return;
@@ -622,6 +622,53 @@ error:
 	return ret;
 }
 
+/**
+ * \brief Prepare all the ImgU video devices to import buffers
+ *
+ * This is used when the ImgU processes frames alongside another ImgU instance
+ * for the same camera, and operates on the parameters and statistics buffers
+ * allocated by the other instance instead of allocating its own.
+ */
+int ImgUDevice::importBuffers(unsigned int bufferCount)
+{
+	int ret = input_->importBuffers(bufferCount);
+	if (ret) {
+		LOG(IPU3, Error) << "Failed to import ImgU input buffers";
+		return ret;
+	}
+
+	ret = param_->importBuffers(bufferCount);
+	if (ret < 0) {
+		LOG(IPU3, Error) << "Failed to import ImgU param buffers";
+		goto error;
+	}
+
+	ret = stat_->importBuffers(bufferCount);
+	if (ret < 0) {
+		LOG(IPU3, Error) << "Failed to import ImgU stat buffers";
+		goto error;
+	}
+
+	ret = output_->importBuffers(bufferCount);
+	if (ret < 0) {
+		LOG(IPU3, Error) << "Failed to import ImgU output buffers";
+		goto error;
+	}
+
+	ret = viewfinder_->importBuffers(bufferCount);
+	if (ret < 0) {
+		LOG(IPU3, Error) << "Failed to import ImgU viewfinder buffers";
+		goto error;
+	}
+
+	return 0;
+
+error:
+	freeBuffers();
+
+	return ret;
+}
+
 /**
  * \brief Release buffers for all the ImgU video devices
  */
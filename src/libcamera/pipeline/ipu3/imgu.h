@@ -85,6 +85,7 @@ public:
 	}
 
 	int allocateBuffers(unsigned int bufferCount);
+	int importBuffers(unsigned int bufferCount);
 	void freeBuffers();
 
 	int start();
@@ -32,11 +32,11 @@
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/isp_frames.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 
 #include "cio2.h"
-#include "frames.h"
 #include "imgu.h"
 
 namespace libcamera {
@@ -47,6 +47,12 @@ static const ControlInfoMap::Map IPU3Controls = {
 	{ &controls::draft::PipelineDepth, ControlInfo(2, 3) },
 };
 
+struct IPU3FrameInfo : public IspFrameInfo {
+	FrameBuffer *rawBuffer;
+	ControlList effectiveSensorControls;
+	bool reprocess;
+};
+
 class IPU3CameraData : public Camera::Private
 {
 public:
@@ -56,6 +62,15 @@ public:
 	}
 
 	int loadIPA();
+	void connectImgU(ImgUDevice *imgu);
+
+	std::vector<ImgUDevice *> imgus() const
+	{
+		if (dualImgu_)
+			return { imgu_, secondaryImgu_ };
+
+		return { imgu_ };
+	}
 
 	void imguOutputBufferReady(FrameBuffer *buffer);
 	void cio2BufferReady(FrameBuffer *buffer);
@@ -68,6 +83,14 @@ public:
 	CIO2Device cio2_;
 	ImgUDevice *imgu_;
 
+	/*
+	 * The ImgU not assigned to any other camera, if any, and whether
+	 * frames are distributed between the two ImgUs.
+	 */
+	ImgUDevice *secondaryImgu_ = nullptr;
+	bool dualImgu_ = false;
+	unsigned int nextImgu_ = 0;
+
 	Stream outStream_;
 	Stream vfStream_;
 	Stream rawStream_;
@@ -75,7 +98,7 @@ public:
 	Rectangle cropRegion_;
 
 	std::unique_ptr<DelayedControls> delayedCtrls_;
-	IPU3Frames frameInfos_;
+	IspFrames<IPU3FrameInfo> frameInfos_;
 
 	std::unique_ptr<ipa::ipu3::IPAProxyIPU3> ipa_;
 
@@ -127,6 +150,12 @@ public:
 	static constexpr unsigned int V4L2_CID_IPU3_PIPE_MODE = 0x009819c1;
 	static constexpr Size kViewfinderSize{ 1280, 720 };
 
+	/*
+	 * Smallest output area for which frames are processed alternatively by
+	 * the two ImgUs, when both are available, to increase throughput.
+	 */
+	static constexpr Size kDualImgUMinSize{ 1920, 1080 };
+
 	enum IPU3PipeModes {
 		IPU3PipeModeVideo = 0,
 		IPU3PipeModeStillCapture = 1,
@@ -141,6 +170,8 @@ public:
 	int exportFrameBuffers(Camera *camera, Stream *stream,
 			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
 
+	bool supportsReprocessing(const Camera *camera) const override;
+
 	int start(Camera *camera, const ControlList *controls) override;
 	void stopDevice(Camera *camera) override;
 
@@ -485,7 +516,6 @@ int PipelineHandlerIPU3::configure(Camera *camera, CameraConfiguration *c)
 	Stream *outStream = &data->outStream_;
 	Stream *vfStream = &data->vfStream_;
 	CIO2Device *cio2 = &data->cio2_;
-	ImgUDevice *imgu = data->imgu_;
 	V4L2DeviceFormat outputFormat;
 	int ret;
 
@@ -520,6 +550,16 @@ int PipelineHandlerIPU3::configure(Camera *camera, CameraConfiguration *c)
 	if (ret)
 		return ret;
 
+	/*
+	 * Distribute the frames between the two ImgUs for large outputs if
+	 * the second one isn't used by another camera. Both ImgUs are then
+	 * configured identically and process every other frame.
+	 */
+	ImgUDevice::PipeConfig imguConfig = config->imguConfig();
+	data->dualImgu_ = data->secondaryImgu_ && !imguConfig.isNull() &&
+			  imguConfig.gdc.width * imguConfig.gdc.height >=
+				  kDualImgUMinSize.width * kDualImgUMinSize.height;
+
 	/*
 	 * \todo Enable links selectively based on the requested streams.
 	 * As of now, enable all links unconditionally.
@@ -527,9 +567,11 @@ int PipelineHandlerIPU3::configure(Camera *camera, CameraConfiguration *c)
 	 * stream which is for raw capture, in which case no buffers will
 	 * ever be queued to the ImgU.
 	 */
-	ret = data->imgu_->enableLinks(true);
-	if (ret)
-		return ret;
+	for (ImgUDevice *imgu : data->imgus()) {
+		ret = imgu->enableLinks(true);
+		if (ret)
+			return ret;
+	}
 
 	/*
 	 * Pass the requested stream size to the CIO2 unit and get back the
@@ -555,62 +597,68 @@ int PipelineHandlerIPU3::configure(Camera *camera, CameraConfiguration *c)
 	 * stream has been requested: return here to skip the ImgU configuration
 	 * part.
 	 */
-	ImgUDevice::PipeConfig imguConfig = config->imguConfig();
 	if (imguConfig.isNull())
 		return 0;
 
-	ret = imgu->configure(imguConfig, &cio2Format);
-	if (ret)
-		return ret;
-
-	/* Apply the format to the configured streams output devices. */
-	StreamConfiguration *mainCfg = nullptr;
-	StreamConfiguration *vfCfg = nullptr;
+	for (ImgUDevice *imgu : data->imgus()) {
+		V4L2DeviceFormat inputFormat = cio2Format;
+		ret = imgu->configure(imguConfig, &inputFormat);
+		if (ret)
+			return ret;
 
-	for (unsigned int i = 0; i < config->size(); ++i) {
-		StreamConfiguration &cfg = (*config)[i];
-		Stream *stream = cfg.stream();
+		/* Apply the format to the configured streams output devices. */
+		StreamConfiguration *mainCfg = nullptr;
+		StreamConfiguration *vfCfg = nullptr;
+
+		for (unsigned int i = 0; i < config->size(); ++i) {
+			StreamConfiguration &cfg = (*config)[i];
+			Stream *stream = cfg.stream();
+
+			if (stream == outStream) {
+				mainCfg = &cfg;
+				ret = imgu->configureOutput(cfg, &outputFormat);
+				if (ret)
+					return ret;
+			} else if (stream == vfStream) {
+				vfCfg = &cfg;
+				ret = imgu->configureViewfinder(cfg, &outputFormat);
+				if (ret)
+					return ret;
+			}
+		}
 
-		if (stream == outStream) {
-			mainCfg = &cfg;
-			ret = imgu->configureOutput(cfg, &outputFormat);
-			if (ret)
-				return ret;
-		} else if (stream == vfStream) {
-			vfCfg = &cfg;
-			ret = imgu->configureViewfinder(cfg, &outputFormat);
+		/*
+		 * As we need to set format also on the non-active streams, use
+		 * the configuration of the active one for that purpose (there
+		 * should be at least one active stream in the configuration
+		 * request).
+		 */
+		if (!vfCfg) {
+			ret = imgu->configureViewfinder(*mainCfg, &outputFormat);
 			if (ret)
 				return ret;
 		}
-	}
 
-	/*
-	 * As we need to set format also on the non-active streams, use
-	 * the configuration of the active one for that purpose (there should
-	 * be at least one active stream in the configuration request).
-	 */
-	if (!vfCfg) {
-		ret = imgu->configureViewfinder(*mainCfg, &outputFormat);
-		if (ret)
+		/* Apply the "pipe_mode" control to the ImgU subdevice. */
+		ControlList ctrls(imgu->imgu_->controls());
+		/*
+		 * Set the ImgU pipe mode to 'Video' unconditionally to have
+		 * statistics generated.
+		 *
+		 * \todo Figure out what the 'Still Capture' mode is meant for,
+		 * and use it accordingly.
+		 */
+		ctrls.set(V4L2_CID_IPU3_PIPE_MODE,
+			  static_cast<int32_t>(IPU3PipeModeVideo));
+		ret = imgu->imgu_->setControls(&ctrls);
+		if (ret) {
+			LOG(IPU3, Error) << "Unable to set pipe_mode control";
 			return ret;
+		}
 	}
 
-	/* Apply the "pipe_mode" control to the ImgU subdevice. */
-	ControlList ctrls(imgu->imgu_->controls());
-	/*
-	 * Set the ImgU pipe mode to 'Video' unconditionally to have statistics
-	 * generated.
-	 *
-	 * \todo Figure out what the 'Still Capture' mode is meant for, and use
-	 * it accordingly.
-	 */
-	ctrls.set(V4L2_CID_IPU3_PIPE_MODE,
-		  static_cast<int32_t>(IPU3PipeModeVideo));
-	ret = imgu->imgu_->setControls(&ctrls);
-	if (ret) {
-		LOG(IPU3, Error) << "Unable to set pipe_mode control";
-		return ret;
-	}
+	if (data->dualImgu_)
+		LOG(IPU3, Debug) << "Processing frames on both ImgUs";
 
 	ipa::ipu3::IPAConfigInfo configInfo;
 	configInfo.sensorControls = data->cio2_.sensor()->controls();
@@ -674,6 +722,21 @@ int PipelineHandlerIPU3::allocateBuffers(Camera *camera)
 	if (ret < 0)
 		return ret;
 
+	/* Each request in flight uses a parameters and statistics buffer. */
+	data->maxQueuedRequests_ = bufferCount;
+
+	/*
+	 * The secondary ImgU operates on the parameters and statistics
+	 * buffers of the primary one, any of them can be used for any frame.
+	 */
+	if (data->dualImgu_) {
+		ret = data->secondaryImgu_->importBuffers(bufferCount);
+		if (ret < 0) {
+			imgu->freeBuffers();
+			return ret;
+		}
+	}
+
 	/* Map buffers to the IPA. */
 	unsigned int ipaBufferId = 1;
 
@@ -709,7 +772,8 @@ int PipelineHandlerIPU3::freeBuffers(Camera *camera)
 	data->ipa_->unmapBuffers(ids);
 	ipaBuffers_.clear();
 
-	data->imgu_->freeBuffers();
+	for (ImgUDevice *imgu : data->imgus())
+		imgu->freeBuffers();
 
 	return 0;
 }
@@ -718,7 +782,6 @@ int PipelineHandlerIPU3::start(Camera *camera, [[maybe_unused]] const ControlLis
 {
 	IPU3CameraData *data = cameraData(camera);
 	CIO2Device *cio2 = &data->cio2_;
-	ImgUDevice *imgu = data->imgu_;
 	int ret;
 
 	/* Disable test pattern mode on the sensor, if any. */
@@ -746,14 +809,19 @@ int PipelineHandlerIPU3::start(Camera *camera, [[maybe_unused]] const ControlLis
 	if (ret)
 		goto error;
 
-	ret = imgu->start();
-	if (ret)
-		goto error;
+	data->nextImgu_ = 0;
+
+	for (ImgUDevice *imgu : data->imgus()) {
+		ret = imgu->start();
+		if (ret)
+			goto error;
+	}
 
 	return 0;
 
 error:
-	imgu->stop();
+	for (ImgUDevice *imgu : data->imgus())
+		imgu->stop();
 	cio2->stop();
 	data->ipa_->stop();
 	freeBuffers(camera);
@@ -771,7 +839,8 @@ void PipelineHandlerIPU3::stopDevice(Camera *camera)
 
 	data->ipa_->stop();
 
-	ret |= data->imgu_->stop();
+	for (ImgUDevice *imgu : data->imgus())
+		ret |= imgu->stop();
 	ret |= data->cio2_.stop();
 	if (ret)
 		LOG(IPU3, Warning) << "Failed to stop camera " << camera->id();
@@ -802,10 +871,32 @@ void IPU3CameraData::queuePendingRequests()
 	while (!pendingRequests_.empty()) {
 		Request *request = pendingRequests_.front();
 
-		IPU3Frames::Info *info = frameInfos_.create(request);
+		IPU3FrameInfo *info = frameInfos_.create(request->sequence(), request);
 		if (!info)
 			break;
 
+		/*
+		 * Reprocessing requests feed the RAW buffer provided by the
+		 * application to the ImgU directly, bypassing the CIO2. The
+		 * sensor timestamp of the original frame is reported to let
+		 * applications match the processed output with the RAW frame.
+		 */
+		FrameBuffer *reprocessBuffer = request->reprocessBuffer();
+		if (reprocessBuffer) {
+			info->rawBuffer = reprocessBuffer;
+			info->reprocess = true;
+
+			request->metadata().set(controls::SensorTimestamp,
+						reprocessBuffer->metadata().timestamp);
+
+			ipa_->queueRequest(info->frame, request->controls());
+			ipa_->fillParamsBuffer(info->frame, info->paramBuffer->cookie());
+
+			pendingRequests_.pop();
+			processingRequests_.push(request);
+			continue;
+		}
+
 		/*
 		 * Queue a buffer on the CIO2, using the raw stream buffer
 		 * provided in the request, if any, or a CIO2 internal buffer
@@ -825,17 +916,36 @@ void IPU3CameraData::queuePendingRequests()
 
 		info->rawBuffer = rawBuffer;
 
-		ipa_->queueRequest(info->id, request->controls());
+		ipa_->queueRequest(info->frame, request->controls());
 
 		pendingRequests_.pop();
 		processingRequests_.push(request);
 	}
 }
 
+/*
+ * The ImgU reads its input frames from memory, RAW frames captured from the
+ * CIO2 can thus be sent to it again.
+ */
+bool PipelineHandlerIPU3::supportsReprocessing([[maybe_unused]] const Camera *camera) const
+{
+	return true;
+}
+
 int PipelineHandlerIPU3::queueRequestDevice(Camera *camera, Request *request)
 {
 	IPU3CameraData *data = cameraData(camera);
 
+	/*
+	 * Reprocessing requests read the RAW frame from memory and can't
+	 * capture a new one at the same time.
+	 */
+	if (request->reprocessBuffer() && request->findBuffer(&data->rawStream_)) {
+		LOG(IPU3, Error)
+			<< "Reprocessing requests can't capture the raw stream";
+		return -EINVAL;
+	}
+
 	data->pendingRequests_.push(request);
 	data->queuePendingRequests();
 
@@ -1051,6 +1161,7 @@ int PipelineHandlerIPU3::registerCameras()
 	 * image sensor is connected to it and the sensor can produce images
 	 * in a compatible format.
 	 */
+	IPU3CameraData *firstCamera = nullptr;
 	unsigned int numCameras = 0;
 	for (unsigned int id = 0; id < 4 && numCameras < 2; ++id) {
 		std::unique_ptr<IPU3CameraData> data =
@@ -1090,6 +1201,7 @@ int PipelineHandlerIPU3::registerCameras()
 		data->delayedCtrls_ =
 			std::make_unique<DelayedControls>(cio2->sensor()->device(),
 							  params);
+		data->delayedControls_ = data->delayedCtrls_.get();
 		data->cio2_.frameStart().connect(data.get(),
 						 &IPU3CameraData::frameStart);
 
@@ -1120,16 +1232,10 @@ int PipelineHandlerIPU3::registerCameras()
 					&IPU3CameraData::cio2BufferReady);
 		data->cio2_.bufferAvailable.connect(
 			data.get(), &IPU3CameraData::queuePendingRequests);
-		data->imgu_->input_->bufferReady.connect(&data->cio2_,
-					&CIO2Device::tryReturnBuffer);
-		data->imgu_->output_->bufferReady.connect(data.get(),
-					&IPU3CameraData::imguOutputBufferReady);
-		data->imgu_->viewfinder_->bufferReady.connect(data.get(),
-					&IPU3CameraData::imguOutputBufferReady);
-		data->imgu_->param_->bufferReady.connect(data.get(),
-					&IPU3CameraData::paramBufferReady);
-		data->imgu_->stat_->bufferReady.connect(data.get(),
-					&IPU3CameraData::statBufferReady);
+		data->connectImgU(data->imgu_);
+
+		if (!numCameras)
+			firstCamera = data.get();
 
 		/* Create and register the Camera instance. */
 		const std::string &cameraId = cio2->sensor()->id();
@@ -1146,9 +1252,24 @@ int PipelineHandlerIPU3::registerCameras()
 		numCameras++;
 	}
 
+	/* Let a single camera use the second ImgU to increase throughput. */
+	if (numCameras == 1) {
+		firstCamera->secondaryImgu_ = &imgu1_;
+		firstCamera->connectImgU(&imgu1_);
+	}
+
 	return numCameras ? 0 : -ENODEV;
 }
 
+void IPU3CameraData::connectImgU(ImgUDevice *imgu)
+{
+	imgu->input_->bufferReady.connect(&cio2_, &CIO2Device::tryReturnBuffer);
+	imgu->output_->bufferReady.connect(this, &IPU3CameraData::imguOutputBufferReady);
+	imgu->viewfinder_->bufferReady.connect(this, &IPU3CameraData::imguOutputBufferReady);
+	imgu->param_->bufferReady.connect(this, &IPU3CameraData::paramBufferReady);
+	imgu->stat_->bufferReady.connect(this, &IPU3CameraData::statBufferReady);
+}
+
 int IPU3CameraData::loadIPA()
 {
 	ipa_ = IPAManager::createIPA<ipa::ipu3::IPAProxyIPU3>(pipe(), 1, 1);
@@ -1220,37 +1341,49 @@ void IPU3CameraData::setSensorControls([[maybe_unused]] unsigned int id,
 
 void IPU3CameraData::paramsBufferReady(unsigned int id)
 {
-	IPU3Frames::Info *info = frameInfos_.find(id);
+	IPU3FrameInfo *info = frameInfos_.find(id);
 	if (!info)
 		return;
 
+	/* Alternate between the ImgUs when both are in use. */
+	ImgUDevice *imgu = imgu_;
+	if (dualImgu_) {
+		imgu = nextImgu_ ? secondaryImgu_ : imgu_;
+		nextImgu_ ^= 1;
+	}
+
 	/* Queue all buffers from the request aimed for the ImgU. */
 	for (auto it : info->request->buffers()) {
 		const Stream *stream = it.first;
 		FrameBuffer *outbuffer = it.second;
 
 		if (stream == &outStream_)
-			imgu_->output_->queueBuffer(outbuffer);
+			imgu->output_->queueBuffer(outbuffer);
 		else if (stream == &vfStream_)
-			imgu_->viewfinder_->queueBuffer(outbuffer);
+			imgu->viewfinder_->queueBuffer(outbuffer);
 	}
 
 	info->paramBuffer->_d()->metadata().planes()[0].bytesused =
 		sizeof(struct ipu3_uapi_params);
-	imgu_->param_->queueBuffer(info->paramBuffer);
-	imgu_->stat_->queueBuffer(info->statBuffer);
-	imgu_->input_->queueBuffer(info->rawBuffer);
+	imgu->param_->queueBuffer(info->paramBuffer);
+	imgu->stat_->queueBuffer(info->statBuffer);
+	imgu->input_->queueBuffer(info->rawBuffer);
 }
 
 void IPU3CameraData::metadataReady(unsigned int id, const ControlList &metadata)
 {
-	IPU3Frames::Info *info = frameInfos_.find(id);
+	IPU3FrameInfo *info = frameInfos_.find(id);
 	if (!info)
 		return;
 
 	Request *request = info->request;
 	request->metadata().merge(metadata);
 
+	const auto sensorTimestamp = request->metadata().get(controls::SensorTimestamp);
+	if (sensorTimestamp)
+		pipe()->recordLatency(request, CameraStatistics::StageIpa,
+				      *sensorTimestamp);
+
 	info->metadataProcessed = true;
 	if (frameInfos_.tryComplete(info))
 		pipe()->completeRequest(request);
@@ -1268,12 +1401,17 @@ void IPU3CameraData::metadataReady(unsigned int id, const ControlList &metadata)
  */
 void IPU3CameraData::imguOutputBufferReady(FrameBuffer *buffer)
 {
-	IPU3Frames::Info *info = frameInfos_.find(buffer);
+	IPU3FrameInfo *info = frameInfos_.find(buffer);
 	if (!info)
 		return;
 
 	Request *request = info->request;
 
+	const auto sensorTimestamp = request->metadata().get(controls::SensorTimestamp);
+	if (sensorTimestamp)
+		pipe()->recordLatency(request, CameraStatistics::StageIsp,
+				      *sensorTimestamp);
+
 	pipe()->completeBuffer(request, buffer);
 
 	request->metadata().set(controls::draft::PipelineDepth, 3);
@@ -1296,7 +1434,7 @@ void IPU3CameraData::imguOutputBufferReady(FrameBuffer *buffer)
  */
 void IPU3CameraData::cio2BufferReady(FrameBuffer *buffer)
 {
-	IPU3Frames::Info *info = frameInfos_.find(buffer);
+	IPU3FrameInfo *info = frameInfos_.find(buffer);
 	if (!info)
 		return;
 
@@ -1324,17 +1462,20 @@ void IPU3CameraData::cio2BufferReady(FrameBuffer *buffer)
 	request->metadata().set(controls::SensorTimestamp,
 				buffer->metadata().timestamp);
 
+	pipe()->recordLatency(request, CameraStatistics::StageDequeue,
+			      buffer->metadata().timestamp);
+
 	info->effectiveSensorControls = delayedCtrls_->get(buffer->metadata().sequence);
 
 	if (request->findBuffer(&rawStream_))
 		pipe()->completeBuffer(request, buffer);
 
-	ipa_->fillParamsBuffer(info->id, info->paramBuffer->cookie());
+	ipa_->fillParamsBuffer(info->frame, info->paramBuffer->cookie());
 }
 
 void IPU3CameraData::paramBufferReady(FrameBuffer *buffer)
 {
-	IPU3Frames::Info *info = frameInfos_.find(buffer);
+	IPU3FrameInfo *info = frameInfos_.find(buffer);
 	if (!info)
 		return;
 
@@ -1354,7 +1495,7 @@ void IPU3CameraData::paramBufferReady(FrameBuffer *buffer)
 
 void IPU3CameraData::statBufferReady(FrameBuffer *buffer)
 {
-	IPU3Frames::Info *info = frameInfos_.find(buffer);
+	IPU3FrameInfo *info = frameInfos_.find(buffer);
 	if (!info)
 		return;
 
@@ -1373,8 +1514,36 @@ void IPU3CameraData::statBufferReady(FrameBuffer *buffer)
 		return;
 	}
 
-	ipa_->processStatsBuffer(info->id, request->metadata().get(controls::SensorTimestamp).value_or(0),
-				 info->statBuffer->cookie(), info->effectiveSensorControls);
+	/*
+	 * Statistics of reprocessed frames don't reflect the current scene and
+	 * must not be fed to the algorithms.
+	 */
+	if (info->reprocess) {
+		info->metadataProcessed = true;
+		if (frameInfos_.tryComplete(info))
+			pipe()->completeRequest(request);
+
+		return;
+	}
+
+	int64_t timestamp = request->metadata().get(controls::SensorTimestamp).value_or(0);
+
+	/*
+	 * Report the lens state when the statistics are ready, after the lens
+	 * movements requested from the statistics of the previous frames have
+	 * been applied.
+	 */
+	bool lensMoving = false;
+	CameraLens *focusLens = cio2_.sensor()->focusLens();
+	if (focusLens) {
+		lensMoving = focusLens->isMoving(timestamp);
+		request->metadata().set(controls::draft::LensState,
+					lensMoving ? controls::draft::LensStateMoving
+						   : controls::draft::LensStateStationary);
+	}
+
+	ipa_->processStatsBuffer(info->frame, timestamp, info->statBuffer->cookie(),
+				 info->effectiveSensorControls, lensMoving);
 }
 
 /*
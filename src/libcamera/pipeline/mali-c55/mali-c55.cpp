@@ -103,16 +103,21 @@ public:
 	PixelFormat adjustRawFormat(const PixelFormat &pixFmt) const;
 	Size adjustRawSizes(const PixelFormat &pixFmt, const Size &rawSize) const;
 
+	bool memoryInput() const { return !!input_; }
+
 	std::unique_ptr<CameraSensor> sensor_;
 
 	MediaEntity *entity_;
 	std::unique_ptr<V4L2Subdevice> csi_;
 	std::unique_ptr<V4L2Subdevice> sd_;
+	std::unique_ptr<V4L2VideoDevice> input_;
 	Stream frStream_;
 	Stream dsStream_;
+	Stream inputStream_;
 
 private:
 	void initTPGData();
+	int initMemoryInput();
 
 	std::string id_;
 	std::vector<unsigned int> tpgCodes_;
@@ -124,6 +129,10 @@ int MaliC55CameraData::init()
 {
 	int ret;
 
+	/* Memory input cameras read RAW frames from a video output device. */
+	if (entity_->function() == MEDIA_ENT_F_IO_V4L)
+		return initMemoryInput();
+
 	sd_ = std::make_unique<V4L2Subdevice>(entity_);
 	ret = sd_->open();
 	if (ret) {
@@ -177,6 +186,46 @@ void MaliC55CameraData::initTPGData()
 	tpgResolution_ = tpgSizes_.back();
 }
 
+/*
+ * Frames fed from memory have no fixed size, report the RAW formats supported
+ * by both the input device and the ISP, and use the size currently set on the
+ * input device as the default resolution.
+ */
+int MaliC55CameraData::initMemoryInput()
+{
+	input_ = std::make_unique<V4L2VideoDevice>(entity_);
+	int ret = input_->open();
+	if (ret) {
+		LOG(MaliC55, Error) << "Failed to open memory input device";
+		return ret;
+	}
+
+	for (const auto &[v4l2Format, ranges] : input_->formats()) {
+		PixelFormat pixFmt = v4l2Format.toPixelFormat(false);
+		auto it = maliC55FmtToCode.find(pixFmt);
+		if (it == maliC55FmtToCode.end() || !isFormatRaw(pixFmt))
+			continue;
+
+		tpgCodes_.push_back(it->second);
+	}
+
+	if (tpgCodes_.empty()) {
+		LOG(MaliC55, Error) << "Memory input supports no RAW format";
+		return -EINVAL;
+	}
+
+	std::sort(tpgCodes_.begin(), tpgCodes_.end());
+
+	V4L2DeviceFormat format;
+	ret = input_->getFormat(&format);
+	if (ret)
+		return ret;
+
+	tpgResolution_ = std::clamp(format.size, kMaliC55MinSize, kMaliC55MaxSize);
+
+	return 0;
+}
+
 const std::vector<unsigned int> MaliC55CameraData::mbusCodes() const
 {
 	if (sensor_)
@@ -190,6 +239,14 @@ const std::vector<Size> MaliC55CameraData::sizes(unsigned int mbusCode) const
 	if (sensor_)
 		return sensor_->sizes(mbusCode);
 
+	if (input_) {
+		if (std::find(tpgCodes_.begin(), tpgCodes_.end(), mbusCode) ==
+		    tpgCodes_.end())
+			return {};
+
+		return { kMaliC55MaxSize };
+	}
+
 	V4L2Subdevice::Formats formats = sd_->formats(0);
 	if (formats.empty())
 		return {};
@@ -275,6 +332,13 @@ Size MaliC55CameraData::adjustRawSizes(const PixelFormat &rawFmt, const Size &ra
 	/* Check if the size is natively supported. */
 	unsigned int rawCode = it->second;
 	const auto rawSizes = sizes(rawCode);
+	if (rawSizes.empty())
+		return {};
+
+	/* Frames fed from memory can have any size the ISP supports. */
+	if (input_)
+		return std::clamp(rawSize, kMaliC55MinSize, kMaliC55MaxSize);
+
 	auto sizeIt = std::find(rawSizes.begin(), rawSizes.end(), rawSize);
 	if (sizeIt != rawSizes.end())
 		return rawSize;
@@ -321,9 +385,16 @@ CameraConfiguration::Status MaliC55CameraConfiguration::validate()
 	if (config_.empty())
 		return Invalid;
 
-	/* Only 2 streams available. */
-	if (config_.size() > kMaxStreams) {
-		config_.resize(kMaxStreams);
+	/*
+	 * Only 2 output streams available, memory input cameras take an
+	 * additional input stream.
+	 */
+	unsigned int maxStreams = kMaxStreams;
+	if (data_->memoryInput())
+		maxStreams++;
+
+	if (config_.size() > maxStreams) {
+		config_.resize(maxStreams);
 		status = Adjusted;
 	}
 
@@ -342,6 +413,17 @@ CameraConfiguration::Status MaliC55CameraConfiguration::validate()
 		rawConfig = &config;
 	}
 
+	/*
+	 * For memory input cameras the RAW stream carries the frames fed to
+	 * the ISP, it is thus mandatory and doesn't consume the FR pipe. At
+	 * least one processed stream is needed to capture the ISP output.
+	 */
+	if (data_->memoryInput() && (!rawConfig || config_.size() < 2)) {
+		LOG(MaliC55, Error)
+			<< "Memory input requires a RAW input and a processed stream";
+		return Invalid;
+	}
+
 	Size maxSize = kMaliC55MaxSize;
 	if (rawConfig) {
 		/*
@@ -368,8 +450,12 @@ CameraConfiguration::Status MaliC55CameraConfiguration::validate()
 
 		maxSize = rawSize;
 
-		rawConfig->setStream(const_cast<Stream *>(&data_->frStream_));
-		frPipeAvailable = false;
+		if (data_->memoryInput()) {
+			rawConfig->setStream(const_cast<Stream *>(&data_->inputStream_));
+		} else {
+			rawConfig->setStream(const_cast<Stream *>(&data_->frStream_));
+			frPipeAvailable = false;
+		}
 	}
 
 	/* Adjust processed streams. */
@@ -519,6 +605,7 @@ private:
 				const std::string &name);
 	bool registerTPGCamera(MediaLink *link);
 	bool registerSensorCamera(MediaLink *link);
+	bool registerMemoryInputCamera(MediaLink *link);
 
 	MediaDevice *media_;
 	std::unique_ptr<V4L2Subdevice> isp_;
@@ -545,15 +632,22 @@ PipelineHandlerMaliC55::generateConfiguration(Camera *camera,
 	if (roles.empty())
 		return config;
 
-	/* Check if one stream is RAW to reserve the FR pipe for it. */
-	if (std::find(roles.begin(), roles.end(), StreamRole::Raw) != roles.end())
+	/*
+	 * Check if one stream is RAW to reserve the FR pipe for it. On memory
+	 * input cameras the RAW stream is the ISP input and needs no pipe.
+	 */
+	if (!data->memoryInput() &&
+	    std::find(roles.begin(), roles.end(), StreamRole::Raw) != roles.end())
 		frPipeAvailable = false;
 
 	for (const StreamRole &role : roles) {
 		struct MaliC55Pipe *pipe;
+		bool input = role == StreamRole::Raw && data->memoryInput();
 
 		/* Assign pipe for this role. */
-		if (role == StreamRole::Raw) {
+		if (input) {
+			pipe = nullptr;
+		} else if (role == StreamRole::Raw) {
 			pipe = &pipes_[MaliC55FR];
 		} else {
 			if (frPipeAvailable) {
@@ -601,6 +695,13 @@ PipelineHandlerMaliC55::generateConfiguration(Camera *camera,
 			PixelFormat pixFmt = maliFormat.first;
 			bool isRaw = isFormatRaw(pixFmt);
 
+			/* The memory input only accepts RAW formats. */
+			if (input) {
+				if (isRaw && !data->sizes(maliFormat.second).empty())
+					formats[pixFmt] = { { kMaliC55MinSize, kMaliC55MaxSize } };
+				continue;
+			}
+
 			/* RAW formats are only supported on the FR pipe. */
 			if (pipe != &pipes_[MaliC55FR] && isRaw)
 				continue;
@@ -752,9 +853,11 @@ int PipelineHandlerMaliC55::configure(Camera *camera,
 	MaliC55CameraConfiguration *maliConfig =
 		static_cast<MaliC55CameraConfiguration *>(config);
 	V4L2SubdeviceFormat subdevFormat = maliConfig->sensorFormat_;
-	ret = data->sd_->getFormat(0, &subdevFormat);
-	if (ret)
-		return ret;
+	if (!data->memoryInput()) {
+		ret = data->sd_->getFormat(0, &subdevFormat);
+		if (ret)
+			return ret;
+	}
 
 	if (data->csi_) {
 		ret = data->csi_->setFormat(0, &subdevFormat);
@@ -793,6 +896,19 @@ int PipelineHandlerMaliC55::configure(Camera *camera,
 	 */
 	for (const StreamConfiguration &streamConfig : *config) {
 		Stream *stream = streamConfig.stream();
+
+		if (stream == &data->inputStream_) {
+			V4L2DeviceFormat inputFormat;
+			inputFormat.fourcc = data->input_->toV4L2PixelFormat(streamConfig.pixelFormat);
+			inputFormat.size = streamConfig.size;
+
+			ret = data->input_->setFormat(&inputFormat);
+			if (ret)
+				return ret;
+
+			continue;
+		}
+
 		MaliC55Pipe *pipe = pipeFromStream(data, stream);
 
 		if (isFormatRaw(streamConfig.pixelFormat))
@@ -822,14 +938,21 @@ int PipelineHandlerMaliC55::configure(Camera *camera,
 int PipelineHandlerMaliC55::exportFrameBuffers(Camera *camera, Stream *stream,
 					       std::vector<std::unique_ptr<FrameBuffer>> *buffers)
 {
-	MaliC55Pipe *pipe = pipeFromStream(cameraData(camera), stream);
+	MaliC55CameraData *data = cameraData(camera);
 	unsigned int count = stream->configuration().bufferCount;
 
+	if (stream == &data->inputStream_)
+		return data->input_->exportBuffers(count, buffers);
+
+	MaliC55Pipe *pipe = pipeFromStream(data, stream);
+
 	return pipe->cap->exportBuffers(count, buffers);
 }
 
-int PipelineHandlerMaliC55::start([[maybe_unused]] Camera *camera, [[maybe_unused]] const ControlList *controls)
+int PipelineHandlerMaliC55::start(Camera *camera, [[maybe_unused]] const ControlList *controls)
 {
+	MaliC55CameraData *data = cameraData(camera);
+
 	for (MaliC55Pipe &pipe : pipes_) {
 		if (!pipe.stream)
 			continue;
@@ -849,11 +972,37 @@ int PipelineHandlerMaliC55::start([[maybe_unused]] Camera *camera, [[maybe_unuse
 		}
 	}
 
+	/*
+	 * Start the memory input last, the ISP processes frames as soon as
+	 * they're queued, without being paced by a sensor.
+	 */
+	if (data->memoryInput()) {
+		unsigned int count = data->inputStream_.configuration().bufferCount;
+		int ret = data->input_->importBuffers(count);
+		if (ret) {
+			LOG(MaliC55, Error) << "Failed to import input buffers";
+			return ret;
+		}
+
+		ret = data->input_->streamOn();
+		if (ret) {
+			LOG(MaliC55, Error) << "Failed to start memory input";
+			return ret;
+		}
+	}
+
 	return 0;
 }
 
-void PipelineHandlerMaliC55::stopDevice([[maybe_unused]] Camera *camera)
+void PipelineHandlerMaliC55::stopDevice(Camera *camera)
 {
+	MaliC55CameraData *data = cameraData(camera);
+
+	if (data->memoryInput()) {
+		data->input_->streamOff();
+		data->input_->releaseBuffers();
+	}
+
 	for (MaliC55Pipe &pipe : pipes_) {
 		if (!pipe.stream)
 			continue;
@@ -865,17 +1014,36 @@ void PipelineHandlerMaliC55::stopDevice([[maybe_unused]] Camera *camera)
 
 int PipelineHandlerMaliC55::queueRequestDevice(Camera *camera, Request *request)
 {
+	MaliC55CameraData *data = cameraData(camera);
+	FrameBuffer *inputBuffer = nullptr;
 	int ret;
 
 	for (auto &[stream, buffer] : request->buffers()) {
-		MaliC55Pipe *pipe = pipeFromStream(cameraData(camera), stream);
+		if (stream == &data->inputStream_) {
+			inputBuffer = buffer;
+			continue;
+		}
+
+		MaliC55Pipe *pipe = pipeFromStream(data, stream);
 
 		ret = pipe->cap->queueBuffer(buffer);
 		if (ret)
 			return ret;
 	}
 
-	return 0;
+	if (!data->memoryInput())
+		return 0;
+
+	/*
+	 * Queue the input buffer after the capture buffers to ensure the ISP
+	 * output for the frame lands in the buffers of the same request.
+	 */
+	if (!inputBuffer) {
+		LOG(MaliC55, Error) << "Memory input requests need an input buffer";
+		return -EINVAL;
+	}
+
+	return data->input_->queueBuffer(inputBuffer);
 }
 
 void PipelineHandlerMaliC55::bufferReady(FrameBuffer *buffer)
@@ -896,6 +1064,8 @@ void PipelineHandlerMaliC55::registerMaliCamera(std::unique_ptr<MaliC55CameraDat
 	std::set<Stream *> streams{ &data->frStream_ };
 	if (dsFitted_)
 		streams.insert(&data->dsStream_);
+	if (data->memoryInput())
+		streams.insert(&data->inputStream_);
 
 	std::shared_ptr<Camera> camera = Camera::create(std::move(data),
 							name, streams);
@@ -961,6 +1131,26 @@ bool PipelineHandlerMaliC55::registerSensorCamera(MediaLink *ispLink)
 	return true;
 }
 
+/*
+ * Register a Camera for a video output device connected to the ISP, used to
+ * process RAW frames from memory.
+ */
+bool PipelineHandlerMaliC55::registerMemoryInputCamera(MediaLink *link)
+{
+	MediaEntity *entity = link->source()->entity();
+
+	std::unique_ptr<MaliC55CameraData> data =
+		std::make_unique<MaliC55CameraData>(this, entity);
+	if (data->init())
+		return false;
+
+	data->input_->bufferReady.connect(this, &PipelineHandlerMaliC55::bufferReady);
+
+	registerMaliCamera(std::move(data), entity->name());
+
+	return true;
+}
+
 bool PipelineHandlerMaliC55::match(DeviceEnumerator *enumerator)
 {
 	const MediaPad *ispSink;
@@ -1025,8 +1215,9 @@ bool PipelineHandlerMaliC55::match(DeviceEnumerator *enumerator)
 	 * MEDIA_ENT_F_VID_IF_BRIDGE - A CSI-2 receiver
 	 * MEDIA_ENT_F_IO_V4L - An input device
 	 *
-	 * The last one will be unsupported for now. The TPG is relatively easy,
-	 * we just register a Camera for it. If we have a CSI-2 receiver we need
+	 * The TPG is relatively easy, we just register a Camera for it. An
+	 * input device gets a memory input Camera whose RAW stream is fed to
+	 * the ISP. If we have a CSI-2 receiver we need
 	 * to check its sink pad and register Cameras for anything connected to
 	 * it (probably...there are some complex situations in which that might
 	 * not be true but let's pretend they don't exist until we come across
@@ -1050,7 +1241,10 @@ bool PipelineHandlerMaliC55::match(DeviceEnumerator *enumerator)
 
 			break;
 		case MEDIA_ENT_F_IO_V4L:
-			LOG(MaliC55, Warning) << "Memory input not yet supported";
+			registered = registerMemoryInputCamera(link);
+			if (!registered)
+				return registered;
+
 			break;
 		default:
 			LOG(MaliC55, Error) << "Unsupported entity function";
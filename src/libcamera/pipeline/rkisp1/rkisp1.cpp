@@ -37,6 +37,7 @@
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/isp_frames.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/v4l2_subdevice.h"
@@ -48,39 +49,25 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(RkISP1)
 
+namespace {
+
+/*
+ * Parameters and statistics buffers are released only once the IPA has
+ * processed the statistics, after the frame buffers complete. Allocate more of
+ * them than frame buffers to absorb IPA latency, and grow the margin for the
+ * next capture session, up to a limit, when requests had to wait for them.
+ */
+constexpr unsigned int kIspBufferMargin = 2;
+constexpr unsigned int kMaxIspBuffers = 16;
+
+} /* namespace */
+
 class PipelineHandlerRkISP1;
 class RkISP1CameraData;
 
-struct RkISP1FrameInfo {
-	unsigned int frame;
-	Request *request;
-
-	FrameBuffer *paramBuffer;
-	FrameBuffer *statBuffer;
+struct RkISP1FrameInfo : public IspFrameInfo {
 	FrameBuffer *mainPathBuffer;
 	FrameBuffer *selfPathBuffer;
-
-	bool paramDequeued;
-	bool metadataProcessed;
-};
-
-class RkISP1Frames
-{
-public:
-	RkISP1Frames(PipelineHandler *pipe);
-
-	RkISP1FrameInfo *create(const RkISP1CameraData *data, Request *request,
-				bool isRaw);
-	int destroy(unsigned int frame);
-	void clear();
-
-	RkISP1FrameInfo *find(unsigned int frame);
-	RkISP1FrameInfo *find(FrameBuffer *buffer);
-	RkISP1FrameInfo *find(Request *request);
-
-private:
-	PipelineHandlerRkISP1 *pipe_;
-	std::map<unsigned int, RkISP1FrameInfo *> frameInfo_;
 };
 
 class RkISP1CameraData : public Camera::Private
@@ -88,21 +75,30 @@ class RkISP1CameraData : public Camera::Private
 public:
 	RkISP1CameraData(PipelineHandler *pipe, RkISP1MainPath *mainPath,
 			 RkISP1SelfPath *selfPath)
-		: Camera::Private(pipe), frame_(0), frameInfo_(pipe),
-		  mainPath_(mainPath), selfPath_(selfPath)
+		: Camera::Private(pipe), frame_(0),
+		  ispBufferMargin_(kIspBufferMargin), mainPath_(mainPath),
+		  selfPath_(selfPath)
 	{
+		frameInfo_.bufferAvailable.connect(this, &RkISP1CameraData::queuePendingRequests);
 	}
 
 	PipelineHandlerRkISP1 *pipe();
 	int loadIPA(unsigned int hwRevision);
 
+	void queuePendingRequests();
+	void cancelPendingRequests();
+
 	Stream mainPathStream_;
 	Stream selfPathStream_;
 	std::unique_ptr<CameraSensor> sensor_;
 	std::unique_ptr<DelayedControls> delayedCtrls_;
 	unsigned int frame_;
 	std::vector<IPABuffer> ipaBuffers_;
-	RkISP1Frames frameInfo_;
+	IspFrames<RkISP1FrameInfo> frameInfo_;
+	unsigned int ispBufferMargin_;
+
+	/* Requests waiting for parameters and statistics buffers. */
+	std::queue<Request *> pendingRequests_;
 
 	RkISP1MainPath *mainPath_;
 	RkISP1SelfPath *selfPath_;
@@ -170,7 +166,6 @@ private:
 	}
 
 	friend RkISP1CameraData;
-	friend RkISP1Frames;
 
 	int initLinks(Camera *camera, const CameraSensor *sensor,
 		      const RkISP1CameraConfiguration &config);
@@ -198,137 +193,12 @@ private:
 
 	std::vector<std::unique_ptr<FrameBuffer>> paramBuffers_;
 	std::vector<std::unique_ptr<FrameBuffer>> statBuffers_;
-	std::queue<FrameBuffer *> availableParamBuffers_;
-	std::queue<FrameBuffer *> availableStatBuffers_;
 
 	Camera *activeCamera_;
 
 	const MediaPad *ispSink_;
 };
 
-RkISP1Frames::RkISP1Frames(PipelineHandler *pipe)
-	: pipe_(static_cast<PipelineHandlerRkISP1 *>(pipe))
-{
-}
-
-RkISP1FrameInfo *RkISP1Frames::create(const RkISP1CameraData *data, Request *request,
-				      bool isRaw)
-{
-	unsigned int frame = data->frame_;
-
-	FrameBuffer *paramBuffer = nullptr;
-	FrameBuffer *statBuffer = nullptr;
-
-	if (!isRaw) {
-		if (pipe_->availableParamBuffers_.empty()) {
-			LOG(RkISP1, Error) << "Parameters buffer underrun";
-			return nullptr;
-		}
-
-		if (pipe_->availableStatBuffers_.empty()) {
-			LOG(RkISP1, Error) << "Statistic buffer underrun";
-			return nullptr;
-		}
-
-		paramBuffer = pipe_->availableParamBuffers_.front();
-		pipe_->availableParamBuffers_.pop();
-
-		statBuffer = pipe_->availableStatBuffers_.front();
-		pipe_->availableStatBuffers_.pop();
-	}
-
-	FrameBuffer *mainPathBuffer = request->findBuffer(&data->mainPathStream_);
-	FrameBuffer *selfPathBuffer = request->findBuffer(&data->selfPathStream_);
-
-	RkISP1FrameInfo *info = new RkISP1FrameInfo;
-
-	info->frame = frame;
-	info->request = request;
-	info->paramBuffer = paramBuffer;
-	info->mainPathBuffer = mainPathBuffer;
-	info->selfPathBuffer = selfPathBuffer;
-	info->statBuffer = statBuffer;
-	info->paramDequeued = false;
-	info->metadataProcessed = false;
-
-	frameInfo_[frame] = info;
-
-	return info;
-}
-
-int RkISP1Frames::destroy(unsigned int frame)
-{
-	RkISP1FrameInfo *info = find(frame);
-	if (!info)
-		return -ENOENT;
-
-	pipe_->availableParamBuffers_.push(info->paramBuffer);
-	pipe_->availableStatBuffers_.push(info->statBuffer);
-
-	frameInfo_.erase(info->frame);
-
-	delete info;
-
-	return 0;
-}
-
-void RkISP1Frames::clear()
-{
-	for (const auto &entry : frameInfo_) {
-		RkISP1FrameInfo *info = entry.second;
-
-		pipe_->availableParamBuffers_.push(info->paramBuffer);
-		pipe_->availableStatBuffers_.push(info->statBuffer);
-
-		delete info;
-	}
-
-	frameInfo_.clear();
-}
-
-RkISP1FrameInfo *RkISP1Frames::find(unsigned int frame)
-{
-	auto itInfo = frameInfo_.find(frame);
-
-	if (itInfo != frameInfo_.end())
-		return itInfo->second;
-
-	LOG(RkISP1, Fatal) << "Can't locate info from frame";
-
-	return nullptr;
-}
-
-RkISP1FrameInfo *RkISP1Frames::find(FrameBuffer *buffer)
-{
-	for (auto &itInfo : frameInfo_) {
-		RkISP1FrameInfo *info = itInfo.second;
-
-		if (info->paramBuffer == buffer ||
-		    info->statBuffer == buffer ||
-		    info->mainPathBuffer == buffer ||
-		    info->selfPathBuffer == buffer)
-			return info;
-	}
-
-	LOG(RkISP1, Fatal) << "Can't locate info from buffer";
-
-	return nullptr;
-}
-
-RkISP1FrameInfo *RkISP1Frames::find(Request *request)
-{
-	for (auto &itInfo : frameInfo_) {
-		RkISP1FrameInfo *info = itInfo.second;
-
-		if (info->request == request)
-			return info;
-	}
-
-	LOG(RkISP1, Fatal) << "Can't locate info from request";
-
-	return nullptr;
-}
-
 PipelineHandlerRkISP1 *RkISP1CameraData::pipe()
 {
 	return static_cast<PipelineHandlerRkISP1 *>(Camera::Private::pipe());
@@ -404,15 +274,68 @@ void RkISP1CameraData::setSensorControls([[maybe_unused]] unsigned int frame,
 	delayedCtrls_->push(sensorControls);
 }
 
+void RkISP1CameraData::queuePendingRequests()
+{
+	PipelineHandlerRkISP1 *pipe = RkISP1CameraData::pipe();
+
+	while (!pendingRequests_.empty()) {
+		Request *request = pendingRequests_.front();
+
+		RkISP1FrameInfo *info = frameInfo_.create(frame_, request, !pipe->isRaw_);
+		if (!info)
+			break;
+
+		pendingRequests_.pop();
+
+		info->mainPathBuffer = request->findBuffer(&mainPathStream_);
+		info->selfPathBuffer = request->findBuffer(&selfPathStream_);
+
+		ipa_->queueRequest(frame_, request->controls());
+		if (pipe->isRaw_) {
+			if (info->mainPathBuffer)
+				mainPath_->queueBuffer(info->mainPathBuffer);
+
+			if (selfPath_ && info->selfPathBuffer)
+				selfPath_->queueBuffer(info->selfPathBuffer);
+		} else {
+			ipa_->fillParamsBuffer(frame_, info->paramBuffer->cookie());
+		}
+
+		frame_++;
+	}
+}
+
+void RkISP1CameraData::cancelPendingRequests()
+{
+	while (!pendingRequests_.empty()) {
+		Request *request = pendingRequests_.front();
+
+		for (auto it : request->buffers()) {
+			FrameBuffer *buffer = it.second;
+			buffer->_d()->cancel();
+			pipe()->completeBuffer(request, buffer);
+		}
+
+		pipe()->completeRequest(request);
+		pendingRequests_.pop();
+	}
+}
+
 void RkISP1CameraData::metadataReady(unsigned int frame, const ControlList &metadata)
 {
 	RkISP1FrameInfo *info = frameInfo_.find(frame);
 	if (!info)
 		return;
 
-	info->request->metadata().merge(metadata);
+	pipe()->metadataAvailable(info->request, metadata);
 	info->metadataProcessed = true;
 
+	const auto sensorTimestamp =
+		info->request->metadata().get(controls::SensorTimestamp);
+	if (sensorTimestamp)
+		pipe()->recordLatency(info->request, CameraStatistics::StageIpa,
+				      *sensorTimestamp);
+
 	pipe()->tryCompleteRequest(info);
 }
 
@@ -487,8 +410,10 @@ CameraConfiguration::Status RkISP1CameraConfiguration::validate()
 		status = Adjusted;
 
 	/*
-	 * Simultaneous capture of raw and processed streams isn't possible. If
-	 * there is any raw stream, cap the number of streams to one.
+	 * Simultaneous capture of raw and processed streams isn't possible, as
+	 * the main and self paths are both fed from the ISP source pad, whose
+	 * format selects between raw bypass and processed YUV for the whole
+	 * ISP. If there is any raw stream, cap the number of streams to one.
 	 */
 	if (config_.size() > 1) {
 		for (const auto &cfg : config_) {
@@ -666,7 +591,8 @@ PipelineHandlerRkISP1::generateConfiguration(Camera *camera,
 		case StreamRole::Raw:
 			if (roles.size() > 1) {
 				LOG(RkISP1, Error)
-					<< "Can't capture both raw and processed streams";
+					<< "Can't capture both raw and processed streams, "
+					<< "the ISP is either bypassed or processing";
 				return nullptr;
 			}
 
@@ -852,33 +778,41 @@ int PipelineHandlerRkISP1::allocateBuffers(Camera *camera)
 		data->mainPathStream_.configuration().bufferCount,
 		data->selfPathStream_.configuration().bufferCount,
 	});
+	unsigned int ispCount = std::min(maxCount + data->ispBufferMargin_,
+					 std::max(maxCount, kMaxIspBuffers));
 
 	if (!isRaw_) {
-		ret = param_->allocateBuffers(maxCount, &paramBuffers_);
+		ret = param_->allocateBuffers(ispCount, &paramBuffers_);
 		if (ret < 0)
 			goto error;
 
-		ret = stat_->allocateBuffers(maxCount, &statBuffers_);
+		ret = stat_->allocateBuffers(ispCount, &statBuffers_);
 		if (ret < 0)
 			goto error;
+
+		LOG(RkISP1, Debug)
+			<< "Using " << ispCount << " parameters and statistics buffers";
+
+		/* Each request in flight uses a parameters and statistics buffer. */
+		data->maxQueuedRequests_ = ispCount;
 	}
 
 	for (std::unique_ptr<FrameBuffer> &buffer : paramBuffers_) {
 		buffer->setCookie(ipaBufferId++);
 		data->ipaBuffers_.emplace_back(buffer->cookie(),
 					       buffer->planes());
-		availableParamBuffers_.push(buffer.get());
 	}
 
 	for (std::unique_ptr<FrameBuffer> &buffer : statBuffers_) {
 		buffer->setCookie(ipaBufferId++);
 		data->ipaBuffers_.emplace_back(buffer->cookie(),
 					       buffer->planes());
-		availableStatBuffers_.push(buffer.get());
 	}
 
 	data->ipa_->mapBuffers(data->ipaBuffers_);
 
+	data->frameInfo_.init(paramBuffers_, statBuffers_);
+
 	return 0;
 
 error:
@@ -892,11 +826,7 @@ int PipelineHandlerRkISP1::freeBuffers(Camera *camera)
 {
 	RkISP1CameraData *data = cameraData(camera);
 
-	while (!availableStatBuffers_.empty())
-		availableStatBuffers_.pop();
-
-	while (!availableParamBuffers_.empty())
-		availableParamBuffers_.pop();
+	data->frameInfo_.clear();
 
 	paramBuffers_.clear();
 	statBuffers_.clear();
@@ -994,6 +924,8 @@ void PipelineHandlerRkISP1::stopDevice(Camera *camera)
 
 	isp_->setFrameStartEnabled(false);
 
+	data->cancelPendingRequests();
+
 	data->ipa_->stop();
 
 	if (hasSelfPath_)
@@ -1012,6 +944,17 @@ void PipelineHandlerRkISP1::stopDevice(Camera *camera)
 				<< "Failed to stop parameters for " << camera->id();
 	}
 
+	/* Report underruns and use more ISP buffers for the next session. */
+	unsigned int underruns = data->frameInfo_.underruns();
+	if (underruns && !isRaw_) {
+		data->ispBufferMargin_ = std::min(data->ispBufferMargin_ + kIspBufferMargin,
+						  kMaxIspBuffers);
+		LOG(RkISP1, Info)
+			<< underruns << " ISP buffer underruns for " << camera->id()
+			<< ", increasing the buffer margin to "
+			<< data->ispBufferMargin_;
+	}
+
 	ASSERT(data->queuedRequests_.empty());
 	data->frameInfo_.clear();
 
@@ -1024,23 +967,12 @@ int PipelineHandlerRkISP1::queueRequestDevice(Camera *camera, Request *request)
 {
 	RkISP1CameraData *data = cameraData(camera);
 
-	RkISP1FrameInfo *info = data->frameInfo_.create(data, request, isRaw_);
-	if (!info)
-		return -ENOENT;
-
-	data->ipa_->queueRequest(data->frame_, request->controls());
-	if (isRaw_) {
-		if (info->mainPathBuffer)
-			data->mainPath_->queueBuffer(info->mainPathBuffer);
-
-		if (data->selfPath_ && info->selfPathBuffer)
-			data->selfPath_->queueBuffer(info->selfPathBuffer);
-	} else {
-		data->ipa_->fillParamsBuffer(data->frame_,
-					     info->paramBuffer->cookie());
-	}
-
-	data->frame_++;
+	/*
+	 * Queue the request to the IPA and the hardware right away if ISP
+	 * buffers are available, or when they get released otherwise.
+	 */
+	data->pendingRequests_.push(request);
+	data->queuePendingRequests();
 
 	return 0;
 }
@@ -1130,6 +1062,7 @@ int PipelineHandlerRkISP1::createCamera(MediaEntity *sensor)
 	data->delayedCtrls_ =
 		std::make_unique<DelayedControls>(data->sensor_->device(),
 						  params);
+	data->delayedControls_ = data->delayedCtrls_.get();
 	isp_->frameStart.connect(data->delayedCtrls_.get(),
 				 &DelayedControls::applyControls);
 
@@ -1237,17 +1170,9 @@ void PipelineHandlerRkISP1::tryCompleteRequest(RkISP1FrameInfo *info)
 	RkISP1CameraData *data = cameraData(activeCamera_);
 	Request *request = info->request;
 
-	if (request->hasPendingBuffers())
-		return;
-
-	if (!info->metadataProcessed)
+	if (!data->frameInfo_.tryComplete(info))
 		return;
 
-	if (!isRaw_ && !info->paramDequeued)
-		return;
-
-	data->frameInfo_.destroy(info->frame);
-
 	completeRequest(request);
 }
 
@@ -1270,8 +1195,12 @@ void PipelineHandlerRkISP1::bufferReady(FrameBuffer *buffer)
 		 * \todo The sensor timestamp should be better estimated by connecting
 		 * to the V4L2Device::frameStart signal.
 		 */
-		request->metadata().set(controls::SensorTimestamp,
-					metadata.timestamp);
+		ControlList timestamp(controls::controls);
+		timestamp.set(controls::SensorTimestamp, metadata.timestamp);
+		metadataAvailable(request, timestamp);
+
+		recordLatency(request, CameraStatistics::StageIsp,
+			      metadata.timestamp);
 
 		if (isRaw_) {
 			const ControlList &ctrls =
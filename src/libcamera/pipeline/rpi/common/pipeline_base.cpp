@@ -7,6 +7,7 @@
 
 #include "pipeline_base.h"
 
+#include <array>
 #include <chrono>
 
 #include <linux/media-bus-format.h>
@@ -504,8 +505,12 @@ int PipelineHandlerBase::configure(Camera *camera, CameraConfiguration *config)
 	CameraData *data = cameraData(camera);
 	int ret;
 
-	/* Start by freeing all buffers and reset the stream states. */
-	data->freeBuffers();
+	/*
+	 * Start by freeing all buffers and reset the stream states. Internal
+	 * buffers are kept aside to be reused by streams whose format doesn't
+	 * change, which speeds up switching between configurations.
+	 */
+	data->freeBuffers(true);
 	for (auto const stream : data->streams_)
 		stream->clearFlags(StreamFlag::External);
 
@@ -761,7 +766,7 @@ int PipelineHandlerBase::queueRequestDevice(Camera *camera, Request *request)
 	}
 
 	/* Push the request to the back of the queue. */
-	data->requestQueue_.push(request);
+	data->requestQueue_.push_back(request);
 	data->handleState();
 
 	return 0;
@@ -803,13 +808,14 @@ int PipelineHandlerBase::registerCamera(std::unique_ptr<RPi::CameraData> &camera
 	 * Setup our delayed control writer with the sensor default
 	 * gain and exposure delays. Mark VBLANK for priority write.
 	 */
-	std::unordered_map<uint32_t, RPi::DelayedControls::ControlParams> params = {
+	std::unordered_map<uint32_t, DelayedControls::ControlParams> params = {
 		{ V4L2_CID_ANALOGUE_GAIN, { result.sensorConfig.gainDelay, false } },
 		{ V4L2_CID_EXPOSURE, { result.sensorConfig.exposureDelay, false } },
 		{ V4L2_CID_HBLANK, { result.sensorConfig.hblankDelay, false } },
 		{ V4L2_CID_VBLANK, { result.sensorConfig.vblankDelay, true } }
 	};
-	data->delayedCtrls_ = std::make_unique<RPi::DelayedControls>(data->sensor_->device(), params);
+	data->delayedCtrls_ = std::make_unique<DelayedControls>(data->sensor_->device(), params);
+	data->delayedControls_ = data->delayedCtrls_.get();
 	data->sensorMetadata_ = result.sensorConfig.sensorMetadata;
 
 	/* Register initial controls that the Raspberry Pi IPA can handle. */
@@ -964,7 +970,7 @@ V4L2SubdeviceFormat CameraData::findBestFormat(const Size &req, unsigned int bit
 	return bestFormat;
 }
 
-void CameraData::freeBuffers()
+void CameraData::freeBuffers(bool recycle)
 {
 	if (ipa_) {
 		/*
@@ -977,8 +983,12 @@ void CameraData::freeBuffers()
 		bufferIds_.clear();
 	}
 
-	for (auto const stream : streams_)
-		stream->releaseBuffers();
+	for (auto const stream : streams_) {
+		if (recycle)
+			stream->recycleBuffers();
+		else
+			stream->releaseBuffers();
+	}
 
 	platformFreeBuffers();
 
@@ -1103,7 +1113,12 @@ int CameraData::loadPipelineConfiguration()
 
 	LOG(RPI, Info) << "Using configuration file '" << filename << "'";
 
-	std::unique_ptr<YamlObject> root = YamlParser::parse(file);
+	/* Skip the sections of the file that the pipeline handler doesn't use. */
+	static const std::array<std::string, 3> keys = {
+		"version", "target", "pipeline_handler",
+	};
+
+	std::unique_ptr<YamlObject> root = YamlParser::parse(file, keys);
 	if (!root) {
 		LOG(RPI, Warning) << "Failed to parse configuration file, using defaults";
 		return 0;
@@ -1220,7 +1235,7 @@ void CameraData::metadataReady(const ControlList &metadata)
 
 	/* Add to the Request metadata buffer what the IPA has provided. */
 	/* Last thing to do is to fill up the request metadata. */
-	Request *request = requestQueue_.front();
+	Request *request = ipaRequest();
 	request->metadata().merge(metadata);
 
 	/*
@@ -1239,7 +1254,11 @@ void CameraData::metadataReady(const ControlList &metadata)
 		};
 		ctrls.set(V4L2_CID_NOTIFY_GAINS, Span<const int32_t>{ gains });
 
-		sensor_->setControls(&ctrls);
+		/*
+		 * The gains are informative, write them with the delayed
+		 * controls at the next frame start to save an ioctl.
+		 */
+		sensor_->device()->queueControls(ctrls);
 	}
 }
 
@@ -1381,7 +1400,7 @@ void CameraData::clearIncompleteRequests()
 		}
 
 		pipe()->completeRequest(request);
-		requestQueue_.pop();
+		requestQueue_.pop_front();
 	}
 }
 
@@ -1457,7 +1476,7 @@ void CameraData::checkRequestCompleted()
 				<< request->sequence();
 
 		pipe()->completeRequest(request);
-		requestQueue_.pop();
+		requestQueue_.pop_front();
 		requestCompleted = true;
 	}
 
@@ -1480,8 +1499,15 @@ void CameraData::checkRequestCompleted()
 
 void CameraData::fillRequestMetadata(const ControlList &bufferControls, Request *request)
 {
-	request->metadata().set(controls::SensorTimestamp,
-				bufferControls.get(controls::SensorTimestamp).value_or(0));
+	int64_t timestamp = bufferControls.get(controls::SensorTimestamp).value_or(0);
+	request->metadata().set(controls::SensorTimestamp, timestamp);
+
+	CameraLens *lens = sensor_->focusLens();
+	if (lens)
+		request->metadata().set(controls::draft::LensState,
+					lens->isMoving(timestamp)
+						? controls::draft::LensStateMoving
+						: controls::draft::LensStateStationary);
 
 	request->metadata().set(controls::ScalerCrop, scalerCrop_);
 }
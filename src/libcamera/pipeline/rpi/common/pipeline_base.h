@@ -5,10 +5,10 @@
  * Pipeline handler base class for Raspberry Pi devices
  */
 
+#include <deque>
 #include <map>
 #include <memory>
 #include <optional>
-#include <queue>
 #include <string>
 #include <unordered_set>
 #include <utility>
@@ -20,6 +20,7 @@
 #include "libcamera/internal/bayer_format.h"
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_sensor.h"
+#include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/media_object.h"
@@ -30,7 +31,6 @@
 #include <libcamera/ipa/raspberrypi_ipa_interface.h>
 #include <libcamera/ipa/raspberrypi_ipa_proxy.h>
 
-#include "delayed_controls.h"
 #include "rpi_stream.h"
 
 using namespace std::chrono_literals;
@@ -65,7 +65,7 @@ public:
 	double scoreFormat(double desired, double actual) const;
 	V4L2SubdeviceFormat findBestFormat(const Size &req, unsigned int bitDepth) const;
 
-	void freeBuffers();
+	void freeBuffers(bool recycle = false);
 	virtual void platformFreeBuffers() = 0;
 
 	void enumerateVideoDevices(MediaLink *link, const std::string &frontend);
@@ -129,7 +129,16 @@ public:
 		return state_ != State::Stopped && state_ != State::Error;
 	}
 
-	std::queue<Request *> requestQueue_;
+	std::deque<Request *> requestQueue_;
+
+	/*
+	 * Return the request the IPA is currently preparing, which the metadata
+	 * reported by the IPA belongs to.
+	 */
+	virtual Request *ipaRequest() const
+	{
+		return requestQueue_.front();
+	}
 
 	/* For handling digital zoom. */
 	IPACameraSensorInfo sensorInfo_;
@@ -7,6 +7,7 @@
 #include "rpi_stream.h"
 
 #include <algorithm>
+#include <iterator>
 #include <tuple>
 #include <utility>
 
@@ -23,6 +24,24 @@ namespace RPi {
 
 const BufferObject Stream::errorBufferObject{ nullptr, false };
 
+namespace {
+
+bool formatMatches(const V4L2DeviceFormat &a, const V4L2DeviceFormat &b)
+{
+	if (a.fourcc != b.fourcc || a.size != b.size || a.planesCount != b.planesCount)
+		return false;
+
+	for (unsigned int i = 0; i < a.planesCount; i++) {
+		if (a.planes[i].size != b.planes[i].size ||
+		    a.planes[i].bpl != b.planes[i].bpl)
+			return false;
+	}
+
+	return true;
+}
+
+} /* namespace */
+
 void Stream::setFlags(StreamFlags flags)
 {
 	/* We don't want dynamic mmapping. */
@@ -111,11 +130,36 @@ int Stream::prepareBuffers(unsigned int count)
 	int ret;
 
 	if (!(flags_ & StreamFlag::ImportOnly)) {
-		/* Export some frame buffers for internal use. */
-		ret = dev_->exportBuffers(count, &internalBuffers_);
+		V4L2DeviceFormat format;
+		ret = dev_->getFormat(&format);
 		if (ret < 0)
 			return ret;
 
+		/*
+		 * Internal buffers kept by recycleBuffers() can be reused if
+		 * the device format hasn't changed. Otherwise drop them all.
+		 */
+		if (!internalBuffers_.empty() && !formatMatches(format, internalFormat_)) {
+			LOG(RPISTREAM, Debug) << "Dropping " << internalBuffers_.size()
+					      << " recycled buffers for stream " << name_;
+			internalBuffers_.clear();
+		}
+
+		internalFormat_ = format;
+
+		/* Export more frame buffers for internal use, or trim the excess. */
+		if (internalBuffers_.size() < count) {
+			std::vector<std::unique_ptr<FrameBuffer>> buffers;
+			ret = dev_->exportBuffers(count - internalBuffers_.size(), &buffers);
+			if (ret < 0)
+				return ret;
+
+			std::move(buffers.begin(), buffers.end(),
+				  std::back_inserter(internalBuffers_));
+		} else {
+			internalBuffers_.resize(count);
+		}
+
 		/* Add these exported buffers to the internal/external buffer list. */
 		setExportedBuffers(&internalBuffers_);
 		resetBuffers();
@@ -247,6 +291,20 @@ void Stream::releaseBuffers()
 	clearBuffers();
 }
 
+void Stream::recycleBuffers()
+{
+	/*
+	 * Release the device buffers and forget about all buffers known to the
+	 * stream, but keep the internal buffers around for prepareBuffers() to
+	 * reuse them if the stream is reconfigured with the same format.
+	 */
+	std::vector<std::unique_ptr<FrameBuffer>> internalBuffers = std::move(internalBuffers_);
+
+	releaseBuffers();
+
+	internalBuffers_ = std::move(internalBuffers);
+}
+
 void Stream::bufferEmplace(unsigned int id, FrameBuffer *buffer)
 {
 	if (flags_ & StreamFlag::RequiresMmap)
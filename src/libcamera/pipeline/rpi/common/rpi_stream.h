@@ -129,6 +129,7 @@ public:
 
 	int queueAllBuffers();
 	void releaseBuffers();
+	void recycleBuffers();
 
 	/* For error handling. */
 	static const BufferObject errorBufferObject;
@@ -177,6 +178,9 @@ private:
 	 * as the stream needs to maintain ownership of these buffers.
 	 */
 	std::vector<std::unique_ptr<FrameBuffer>> internalBuffers_;
+
+	/* Device format the internal buffers have been exported with. */
+	V4L2DeviceFormat internalFormat_;
 };
 
 /*
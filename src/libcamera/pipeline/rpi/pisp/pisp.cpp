@@ -10,6 +10,7 @@
 #include <memory>
 #include <mutex>
 #include <numeric>
+#include <optional>
 #include <queue>
 #include <set>
 #include <sstream>
@@ -22,7 +23,10 @@
 #include <linux/v4l2-controls.h>
 #include <linux/videodev2.h>
 
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/shared_fd.h>
+#include <libcamera/base/thread_pool.h>
+#include <libcamera/base/utils.h>
 #include <libcamera/formats.h>
 
 #include "libcamera/internal/device_enumerator.h"
@@ -392,176 +396,94 @@ void do16BitEndianSwap([[maybe_unused]] void *mem, [[maybe_unused]] unsigned int
 #endif
 }
 
-void downscaleInterleaved3(void *mem, unsigned int height, unsigned int src_width,
-			   unsigned int stride)
-{
-	std::vector<uint8_t> incache(3 * src_width);
-	unsigned int dst_width = src_width / 2;
-	std::vector<uint8_t> outcache(3 * dst_width);
-
-	memcpy(incache.data(), mem, 3 * src_width);
-	for (unsigned int j = 0; j < height; j++) {
-		uint8_t *ptr = (uint8_t *)mem + j * stride;
-
-		uint8_t *src = incache.data(), *dst = outcache.data();
-		for (unsigned int i = 0; i < dst_width; i++, src += 6, dst += 3) {
-			dst[0] = ((int)src[0] + (int)src[3] + 1) >> 1;
-			dst[1] = ((int)src[1] + (int)src[4] + 1) >> 1;
-			dst[2] = ((int)src[2] + (int)src[5] + 1) >> 1;
-		}
+/*
+ * A lane describes the samples of one component in a line, as a byte offset
+ * from the start of the line and a pitch in bytes between consecutive samples.
+ * Downscaling a lane only reads and writes bytes of that lane, and writes
+ * output sample i before reading input samples above i * factor. Lanes can
+ * thus be downscaled in place, one after the other, without line buffers.
+ */
+struct DownscaleLane {
+	unsigned int offset;
+	unsigned int pitch;
+	unsigned int samples;
+};
 
-		if (j < height - 1)
-			memcpy(incache.data(), ptr + stride, 3 * src_width);
-		memcpy(ptr, outcache.data(), 3 * dst_width);
-	}
-}
+struct DownscalePlane {
+	uint8_t *mem;
+	unsigned int height;
+	unsigned int stride;
+	std::vector<DownscaleLane> lanes;
+};
 
-void downscaleInterleaved4(void *mem, unsigned int height, unsigned int src_width,
-			   unsigned int stride)
+void downscaleLane(uint8_t *line, const DownscaleLane &lane, unsigned int factor,
+		   unsigned int shift)
 {
-	std::vector<uint8_t> incache(4 * src_width);
-	unsigned int dst_width = src_width / 2;
-	std::vector<uint8_t> outcache(4 * dst_width);
+	uint8_t *dst = line + lane.offset;
+	const uint8_t *src = dst;
+	const unsigned int pitch = lane.pitch;
+	const unsigned int round = factor / 2;
 
-	memcpy(incache.data(), mem, 4 * src_width);
-	for (unsigned int j = 0; j < height; j++) {
-		uint8_t *ptr = (uint8_t *)mem + j * stride;
-
-		uint8_t *src = incache.data(), *dst = outcache.data();
-		for (unsigned int i = 0; i < dst_width; i++, src += 8, dst += 4) {
-			dst[0] = ((int)src[0] + (int)src[4] + 1) >> 1;
-			dst[1] = ((int)src[1] + (int)src[5] + 1) >> 1;
-			dst[2] = ((int)src[2] + (int)src[6] + 1) >> 1;
-			dst[3] = ((int)src[3] + (int)src[7] + 1) >> 1;
-		}
-
-		if (j < height - 1)
-			memcpy(incache.data(), ptr + stride, 4 * src_width);
-		memcpy(ptr, outcache.data(), 4 * dst_width);
+	for (unsigned int i = 0; i < lane.samples; i++, dst += pitch) {
+		unsigned int sum = 0;
+		for (unsigned int k = 0; k < factor; k++, src += pitch)
+			sum += *src;
+		*dst = (sum + round) >> shift;
 	}
 }
 
-void downscalePlaneInternal(void *mem, unsigned int height, unsigned int src_width,
-			    unsigned int stride, std::vector<uint8_t> &incache,
-			    std::vector<uint8_t> &outcache)
+void downscaleLines(const DownscalePlane &plane, unsigned int first,
+		    unsigned int last, unsigned int factor)
 {
-	unsigned int dst_width = src_width / 2;
-	memcpy(incache.data(), mem, src_width);
-	for (unsigned int j = 0; j < height; j++) {
-		uint8_t *ptr = (uint8_t *)mem + j * stride;
-
-		uint8_t *src = incache.data(), *dst = outcache.data();
-		for (unsigned int i = 0; i < dst_width; i++, src += 2, dst++)
-			*dst = ((int)src[0] + (int)src[1] + 1) >> 1;
+	const unsigned int shift = __builtin_ctz(factor);
 
-		if (j < height - 1)
-			memcpy(incache.data(), ptr + stride, src_width);
-		memcpy(ptr, outcache.data(), dst_width);
+	for (unsigned int j = first; j < last; j++) {
+		uint8_t *line = plane.mem + j * plane.stride;
+		for (const DownscaleLane &lane : plane.lanes)
+			downscaleLane(line, lane, factor, shift);
 	}
 }
 
-void downscalePlanar420(void *memY, void *memU, void *memV, unsigned int height,
-			unsigned int src_width, unsigned int stride)
-{
-	std::vector<uint8_t> incache(src_width);
-	std::vector<uint8_t> outcache(src_width / 2);
-
-	downscalePlaneInternal(memY, height, src_width, stride, incache, outcache);
-	downscalePlaneInternal(memU, height / 2, src_width / 2, stride / 2, incache, outcache);
-	downscalePlaneInternal(memV, height / 2, src_width / 2, stride / 2, incache, outcache);
-}
-
-void downscalePlanar422(void *memY, void *memU, void *memV,
-			unsigned int height, unsigned int src_width, unsigned int stride)
+/*
+ * Downscale all planes horizontally by the power of two factor, in a single
+ * pass. The lines are split in bands processed concurrently by the shared
+ * thread pool, to minimise the time the pipeline handler thread is blocked.
+ */
+void downscalePlanes(const std::vector<DownscalePlane> &planes, unsigned int factor)
 {
-	std::vector<uint8_t> incache(src_width);
-	std::vector<uint8_t> outcache(src_width / 2);
+	static constexpr unsigned int kMinBandHeight = 32;
 
-	downscalePlaneInternal(memY, height, src_width, stride, incache, outcache);
-	downscalePlaneInternal(memU, height, src_width / 2, stride / 2, incache, outcache);
-	downscalePlaneInternal(memV, height, src_width / 2, stride / 2, incache, outcache);
-}
+	ThreadPool *pool = ThreadPool::instance();
+	unsigned int bands = std::max(pool->workers(), 1u);
 
-void downscaleInterleavedYuyv(void *mem, unsigned int height, unsigned int src_width,
-			      unsigned int stride)
-{
-	std::vector<uint8_t> incache(2 * src_width);
-	unsigned int dst_width = src_width / 2;
-	std::vector<uint8_t> outcache(2 * dst_width);
+	Mutex mutex;
+	ConditionVariable cv;
+	unsigned int pending = 0;
 
-	memcpy(incache.data(), mem, 2 * src_width);
-	for (unsigned int j = 0; j < height; j++) {
-		uint8_t *ptr = (uint8_t *)mem + j * stride;
-
-		uint8_t *src = incache.data(), *dst = outcache.data();
-		for (unsigned int i = 0; i < dst_width; i++, src += 8, dst += 4) {
-			dst[0] = ((int)src[0] + (int)src[2] + 1) >> 1;
-			dst[1] = ((int)src[1] + (int)src[5] + 1) >> 1;
-			dst[2] = ((int)src[4] + (int)src[6] + 1) >> 1;
-			dst[3] = ((int)src[3] + (int)src[7] + 1) >> 1;
-		}
+	for (const DownscalePlane &plane : planes) {
+		unsigned int bandHeight = std::max(utils::alignUp(plane.height, bands) / bands,
+						   kMinBandHeight);
 
-		if (j < height - 1)
-			memcpy(incache.data(), ptr + stride, 4 * src_width);
-		memcpy(ptr, outcache.data(), 2 * dst_width);
-	}
-}
+		for (unsigned int first = 0; first < plane.height; first += bandHeight) {
+			unsigned int last = std::min(first + bandHeight, plane.height);
 
-void downscaleInterleavedUyvy(void *mem, unsigned int height, unsigned int src_width,
-			      unsigned int stride)
-{
-	std::vector<uint8_t> incache(2 * src_width);
-	unsigned int dst_width = src_width / 2;
-	std::vector<uint8_t> outcache(2 * dst_width);
+			{
+				MutexLocker locker(mutex);
+				pending++;
+			}
 
-	memcpy(incache.data(), mem, 2 * src_width);
-	for (unsigned int j = 0; j < height; j++) {
-		uint8_t *ptr = (uint8_t *)mem + j * stride;
+			pool->submit([&, first, last]() {
+				downscaleLines(plane, first, last, factor);
 
-		uint8_t *src = incache.data(), *dst = outcache.data();
-		for (unsigned int i = 0; i < dst_width; i++, src += 8, dst += 4) {
-			dst[0] = ((int)src[0] + (int)src[4] + 1) >> 1;
-			dst[1] = ((int)src[1] + (int)src[3] + 1) >> 1;
-			dst[2] = ((int)src[2] + (int)src[6] + 1) >> 1;
-			dst[3] = ((int)src[5] + (int)src[7] + 1) >> 1;
+				MutexLocker locker(mutex);
+				pending--;
+				cv.notify_one();
+			}, ThreadPool::Priority::High);
 		}
-
-		if (j < height - 1)
-			memcpy(incache.data(), ptr + stride, 4 * src_width);
-		memcpy(ptr, outcache.data(), 2 * dst_width);
 	}
-}
-
-void downscaleInterleaved2Internal(void *mem, unsigned int height, unsigned int src_width,
-				   unsigned int stride, std::vector<uint8_t> &incache,
-				   std::vector<uint8_t> &outcache)
-{
-	unsigned int dst_width = src_width / 2;
-	memcpy(incache.data(), mem, 2 * src_width);
-	for (unsigned int j = 0; j < height; j++) {
-		uint8_t *ptr = (uint8_t *)mem + j * stride;
 
-		uint8_t *src = incache.data(), *dst = outcache.data();
-		for (unsigned int i = 0; i < dst_width; i++, src += 4, dst += 2) {
-			dst[0] = ((int)src[0] + (int)src[2] + 1) >> 1;
-			dst[1] = ((int)src[1] + (int)src[3] + 1) >> 1;
-		}
-
-		if (j < height - 1)
-			memcpy(incache.data(), ptr + stride, 2 * src_width);
-		memcpy(ptr, outcache.data(), 2 * dst_width);
-	}
-}
-
-void downscaleSemiPlanar420(void *memY, void *memUV, unsigned int height,
-			    unsigned int src_width, unsigned int stride)
-{
-	std::vector<uint8_t> incache(src_width);
-	std::vector<uint8_t> outcache(src_width / 2);
-
-	downscalePlaneInternal(memY, height, src_width, stride, incache, outcache);
-	downscaleInterleaved2Internal(memUV, height / 2, src_width / 2, stride,
-				      incache, outcache);
+	MutexLocker locker(mutex);
+	cv.wait(locker, [&]() { return !pending; });
 }
 
 void downscaleStreamBuffer(RPi::Stream *stream, int index)
@@ -575,64 +497,72 @@ void downscaleStreamBuffer(RPi::Stream *stream, int index)
 	unsigned int height = stream->configuration().size.height;
 	const PixelFormat &pixFormat = stream->configuration().pixelFormat;
 	const RPi::BufferObject &b = stream->getBuffer(index);
-	void *mem = b.mapped->planes()[0].data();
 	ASSERT(b.mapped);
+	uint8_t *mem = b.mapped->planes()[0].data();
 
-	/* Do repeated downscale-by-2 in place until we're done. */
-	for (; downscale > 1; downscale >>= 1) {
-		unsigned int src_width = downscale * dst_width;
+	auto interleaved = [&](unsigned int bpp) {
+		std::vector<DownscaleLane> lanes;
+		for (unsigned int c = 0; c < bpp; c++)
+			lanes.push_back({ c, bpp, dst_width });
+		return lanes;
+	};
 
-		if (pixFormat == formats::RGB888 || pixFormat == formats::BGR888) {
-			downscaleInterleaved3(mem, height, src_width, stride);
-		} else if (pixFormat == formats::XRGB8888 || pixFormat == formats::XBGR8888) {
-			/* On some devices these may actually be 24bpp at this point. */
-			if (stream->getFlags() & StreamFlag::Needs32bitConv)
-				downscaleInterleaved3(mem, height, src_width, stride);
-			else
-				downscaleInterleaved4(mem, height, src_width, stride);
-		} else if (pixFormat == formats::YUV420 || pixFormat == formats::YVU420) {
-			/* These may look like either single or multi-planar buffers. */
-			void *mem1;
-			void *mem2;
-			if (b.mapped->planes().size() == 3) {
-				mem1 = b.mapped->planes()[1].data();
-				mem2 = b.mapped->planes()[2].data();
-			} else {
-				unsigned int ySize = height * stride;
-				mem1 = static_cast<uint8_t *>(mem) + ySize;
-				mem2 = static_cast<uint8_t *>(mem1) + ySize / 4;
-			}
-			downscalePlanar420(mem, mem1, mem2, height, src_width, stride);
-		} else if (pixFormat == formats::YUV422 || pixFormat == formats::YVU422) {
-			/* These may look like either single or multi-planar buffers. */
-			void *mem1;
-			void *mem2;
-			if (b.mapped->planes().size() == 3) {
-				mem1 = b.mapped->planes()[1].data();
-				mem2 = b.mapped->planes()[2].data();
-			} else {
-				unsigned int ySize = height * stride;
-				mem1 = static_cast<uint8_t *>(mem) + ySize;
-				mem2 = static_cast<uint8_t *>(mem1) + ySize / 2;
-			}
-			downscalePlanar422(mem, mem1, mem2, height, src_width, stride);
-		} else if (pixFormat == formats::YUYV || pixFormat == formats::YVYU) {
-			downscaleInterleavedYuyv(mem, height, src_width, stride);
-		} else if (pixFormat == formats::UYVY || pixFormat == formats::VYUY) {
-			downscaleInterleavedUyvy(mem, height, src_width, stride);
-		} else if (pixFormat == formats::NV12 || pixFormat == formats::NV21) {
-			/* These may look like either single or multi-planar buffers. */
-			void *mem1;
-			if (b.mapped->planes().size() == 2)
-				mem1 = b.mapped->planes()[1].data();
-			else
-				mem1 = static_cast<uint8_t *>(mem) + height * stride;
-			downscaleSemiPlanar420(mem, mem1, height, src_width, stride);
+	std::vector<DownscalePlane> planes;
+
+	if (pixFormat == formats::RGB888 || pixFormat == formats::BGR888) {
+		planes.push_back({ mem, height, stride, interleaved(3) });
+	} else if (pixFormat == formats::XRGB8888 || pixFormat == formats::XBGR8888) {
+		/* On some devices these may actually be 24bpp at this point. */
+		unsigned int bpp = stream->getFlags() & StreamFlag::Needs32bitConv ? 3 : 4;
+		planes.push_back({ mem, height, stride, interleaved(bpp) });
+	} else if (pixFormat == formats::YUV420 || pixFormat == formats::YVU420 ||
+		   pixFormat == formats::YUV422 || pixFormat == formats::YVU422) {
+		bool is420 = pixFormat == formats::YUV420 || pixFormat == formats::YVU420;
+		unsigned int chromaHeight = is420 ? height / 2 : height;
+
+		/* These may look like either single or multi-planar buffers. */
+		uint8_t *mem1;
+		uint8_t *mem2;
+		if (b.mapped->planes().size() == 3) {
+			mem1 = b.mapped->planes()[1].data();
+			mem2 = b.mapped->planes()[2].data();
 		} else {
-			LOG(RPI, Error) << "Sw downscale unsupported for " << pixFormat;
-			ASSERT(0);
+			unsigned int ySize = height * stride;
+			mem1 = mem + ySize;
+			mem2 = mem1 + (is420 ? ySize / 4 : ySize / 2);
 		}
+
+		planes.push_back({ mem, height, stride, { { 0, 1, dst_width } } });
+		planes.push_back({ mem1, chromaHeight, stride / 2, { { 0, 1, dst_width / 2 } } });
+		planes.push_back({ mem2, chromaHeight, stride / 2, { { 0, 1, dst_width / 2 } } });
+	} else if (pixFormat == formats::YUYV || pixFormat == formats::YVYU) {
+		planes.push_back({ mem, height, stride,
+				   { { 0, 2, dst_width },
+				     { 1, 4, dst_width / 2 },
+				     { 3, 4, dst_width / 2 } } });
+	} else if (pixFormat == formats::UYVY || pixFormat == formats::VYUY) {
+		planes.push_back({ mem, height, stride,
+				   { { 1, 2, dst_width },
+				     { 0, 4, dst_width / 2 },
+				     { 2, 4, dst_width / 2 } } });
+	} else if (pixFormat == formats::NV12 || pixFormat == formats::NV21) {
+		/* These may look like either single or multi-planar buffers. */
+		uint8_t *mem1;
+		if (b.mapped->planes().size() == 2)
+			mem1 = b.mapped->planes()[1].data();
+		else
+			mem1 = mem + height * stride;
+
+		planes.push_back({ mem, height, stride, { { 0, 1, dst_width } } });
+		planes.push_back({ mem1, height / 2, stride,
+				   { { 0, 2, dst_width / 2 },
+				     { 1, 2, dst_width / 2 } } });
+	} else {
+		LOG(RPI, Error) << "Sw downscale unsupported for " << pixFormat;
+		ASSERT(0);
 	}
+
+	downscalePlanes(planes, downscale);
 }
 
 /* Return largest width of any of these streams (or of the camera input). */
@@ -688,7 +618,7 @@ class PiSPCameraData final : public RPi::CameraData
 {
 public:
 	PiSPCameraData(PipelineHandler *pipe, const libpisp::PiSPVariant &variant)
-		: RPi::CameraData(pipe), pispVariant_(variant)
+		: RPi::CameraData(pipe), pispVariant_(variant), lookaheadRequest_(nullptr)
 	{
 		/* Initialise internal libpisp logging. */
 		::libpisp::logging_init();
@@ -794,7 +724,13 @@ private:
 	void prepareCfe();
 	void prepareBe(uint32_t bufferId, bool stitchSwapBuffers);
 
+	Request *ipaRequest() const override
+	{
+		return lookaheadRequest_ ? lookaheadRequest_ : requestQueue_.front();
+	}
+
 	void tryRunPipeline() override;
+	void runIpa(Request *request);
 
 	struct CfeJob {
 		ControlList sensorControls;
@@ -804,6 +740,21 @@ private:
 
 	std::queue<CfeJob> cfeJobQueue_;
 
+	/*
+	 * While the Backend processes the frame of the request at the front of
+	 * the queue, the IPA is allowed to prepare the Backend configuration
+	 * of the next request. The lookahead request is the request being
+	 * prepared, and the lookahead Backend job is set when the IPA has
+	 * completed and the job waits for the Backend to become available.
+	 */
+	struct BeJob {
+		uint32_t bayerId;
+		bool stitchSwapBuffers;
+	};
+
+	Request *lookaheadRequest_;
+	std::optional<BeJob> lookaheadBeJob_;
+
 	bool cfeJobComplete() const
 	{
 		if (cfeJobQueue_.empty())
@@ -1622,6 +1573,8 @@ void PiSPCameraData::platformStart()
 	stitchInputIndex_ = 0;
 
 	cfeJobQueue_ = {};
+	lookaheadRequest_ = nullptr;
+	lookaheadBeJob_.reset();
 
 	for (unsigned int i = 0; i < config_.numCfeConfigQueue; i++)
 		prepareCfe();
@@ -1633,6 +1586,8 @@ void PiSPCameraData::platformStart()
 void PiSPCameraData::platformStop()
 {
 	cfeJobQueue_ = {};
+	lookaheadRequest_ = nullptr;
+	lookaheadBeJob_.reset();
 }
 
 void PiSPCameraData::platformFreeBuffers()
@@ -1692,7 +1647,9 @@ void PiSPCameraData::cfeBufferDequeue(FrameBuffer *buffer)
 		 * Lookup the sensor controls used for this frame sequence from
 		 * DelayedControl and queue them along with the frame buffer.
 		 */
-		auto [ctrl, delayContext] = delayedCtrls_->get(buffer->metadata().sequence);
+		unsigned int delayContext;
+		ControlList ctrl = delayedCtrls_->get(buffer->metadata().sequence,
+						      &delayContext);
 		/*
 		 * Add the frame timestamp to the ControlList for the IPA to use
 		 * as it does not receive the FrameBuffer object.
@@ -1820,6 +1777,20 @@ void PiSPCameraData::prepareIspComplete(const ipa::RPi::BufferIds &buffers, bool
 		handleStreamBuffer(buffer, &cfe_[Cfe::Embedded]);
 	}
 
+	if (lookaheadRequest_) {
+		/*
+		 * The IPA has prepared the next request ahead of time. If the
+		 * Backend is still busy with the current request, hold the job
+		 * until the current request completes.
+		 */
+		if (state_ != State::Idle) {
+			lookaheadBeJob_ = BeJob{ bayerId, stitchSwapBuffers };
+			return;
+		}
+
+		lookaheadRequest_ = nullptr;
+	}
+
 	if (!beEnabled_) {
 		/*
 		 * If there is no need to run the Backend, just signal that the
@@ -2233,14 +2204,49 @@ void PiSPCameraData::prepareBe(uint32_t bufferId, bool stitchSwapBuffers)
 
 void PiSPCameraData::tryRunPipeline()
 {
+	if (state_ == State::Idle && lookaheadRequest_) {
+		/* Wait for the IPA to complete the lookahead request. */
+		if (!lookaheadBeJob_)
+			return;
+
+		/*
+		 * The request prepared ahead of time is now at the front of the
+		 * queue, hand its job to the Backend.
+		 */
+		BeJob beJob = *lookaheadBeJob_;
+		lookaheadRequest_ = nullptr;
+		lookaheadBeJob_.reset();
+
+		prepareBe(beJob.bayerId, beJob.stitchSwapBuffers);
+		state_ = State::IpaComplete;
+	}
+
 	/* If any of our request or buffer queues are empty, we cannot proceed. */
-	if (state_ != State::Idle || requestQueue_.empty() || !cfeJobComplete())
+	if (requestQueue_.empty() || !cfeJobComplete())
 		return;
 
-	CfeJob &job = cfeJobQueue_.front();
+	if (state_ == State::Idle) {
+		runIpa(requestQueue_.front());
+		return;
+	}
+
+	/*
+	 * While the Backend processes the current request, let the IPA
+	 * prepare the next one. This is only possible once the IPA has
+	 * completed the current request, and is skipped while dropping frames
+	 * as the current request is then reused for the next frame.
+	 */
+	if (state_ != State::IpaComplete || lookaheadRequest_ || !beEnabled_ ||
+	    dropFrameCount_ || requestQueue_.size() < 2)
+		return;
+
+	lookaheadRequest_ = requestQueue_[1];
+	runIpa(lookaheadRequest_);
+}
 
-	/* Take the first request from the queue and action the IPA. */
-	Request *request = requestQueue_.front();
+void PiSPCameraData::runIpa(Request *request)
+{
+	CfeJob &job = cfeJobQueue_.front();
 
 	/* See if a new ScalerCrop value needs to be applied. */
 	applyScalerCrop(request->controls());
@@ -2254,7 +2260,8 @@ void PiSPCameraData::tryRunPipeline()
 	fillRequestMetadata(job.sensorControls, request);
 
 	/* Set our state to say the pipeline is active. */
-	state_ = State::Busy;
+	if (request == requestQueue_.front())
+		state_ = State::Busy;
 
 	unsigned int bayerId = cfe_[Cfe::Output0].getBufferId(job.buffers[&cfe_[Cfe::Output0]]);
 	unsigned int statsId = cfe_[Cfe::Stats].getBufferId(job.buffers[&cfe_[Cfe::Stats]]);
@@ -2269,7 +2276,7 @@ void PiSPCameraData::tryRunPipeline()
 	params.buffers.bayer = RPi::MaskBayerData | bayerId;
 	params.buffers.stats = RPi::MaskStats | statsId;
 	params.buffers.embedded = 0;
-	params.ipaContext = requestQueue_.front()->sequence();
+	params.ipaContext = request->sequence();
 	params.delayContext = job.delayContext;
 	params.sensorControls = std::move(job.sensorControls);
 	params.requestControls = request->controls();
@@ -11,8 +11,10 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <set>
+#include <stdlib.h>
 #include <string.h>
 #include <string>
 #include <unordered_map>
@@ -22,9 +24,12 @@
 #include <linux/media-bus-format.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/control_ids.h>
+#include <libcamera/property_ids.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
@@ -32,9 +37,12 @@
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/converter.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/formats.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/software_isp/software_isp.h"
+#include "libcamera/internal/software_isp/swisp_shared_mem.h"
+#include "libcamera/internal/v4l2_dequeue_poller.h"
 #include "libcamera/internal/v4l2_subdevice.h"
 #include "libcamera/internal/v4l2_videodevice.h"
 
@@ -223,6 +231,8 @@ public:
 			 V4L2Subdevice::Whence whence,
 			 Transform transform = Transform::Identity);
 	void bufferReady(FrameBuffer *buffer);
+	void setupScalerCrop(const Size &captureSize);
+	void applyScalerCrop(const ControlList &controls);
 
 	unsigned int streamIndex(const Stream *stream) const
 	{
@@ -277,12 +287,51 @@ public:
 	std::map<PixelFormat, std::vector<const Configuration *>> formats_;
 
 	std::vector<std::unique_ptr<FrameBuffer>> conversionBuffers_;
+	unsigned int numInternalBuffers_;
 	std::queue<std::map<unsigned int, FrameBuffer *>> conversionQueue_;
 	bool useConversion_;
 
 	std::unique_ptr<Converter> converter_;
 	std::unique_ptr<SoftwareIsp> swIsp_;
 
+	/*
+	 * Digital zoom by the Software ISP. The ScalerCrop maximum is null
+	 * when zooming is not supported, ispCrop_ is in captured pixels.
+	 */
+	Rectangle scalerCropMaximum_;
+	Size captureSize_;
+	Rectangle ispCrop_;
+	Rectangle scalerCrop_;
+
+	/*
+	 * Memoised results of SimpleCameraConfiguration::validate(), indexed by
+	 * the requested orientation and stream formats and sizes. Validation
+	 * only depends on those parameters and on static pipeline data.
+	 */
+	struct ValidatedStream {
+		PixelFormat pixelFormat;
+		Size size;
+		unsigned int stride;
+		unsigned int frameSize;
+		unsigned int bufferCount;
+	};
+
+	struct ValidationResult {
+		CameraConfiguration::Status status;
+		Orientation orientation;
+		Transform combinedTransform;
+		const Configuration *pipeConfig;
+		bool needConversion;
+		std::vector<ValidatedStream> streams;
+	};
+
+	using ValidationKey =
+		std::pair<Orientation, std::vector<std::pair<PixelFormat, Size>>>;
+
+	Mutex validationCacheLock_;
+	std::map<ValidationKey, ValidationResult> validationCache_
+		LIBCAMERA_TSA_GUARDED_BY(validationCacheLock_);
+
 private:
 	void tryPipeline(unsigned int code, const Size &size);
 	static std::vector<const MediaPad *> routedSourcePads(MediaPad *sink);
@@ -290,7 +339,7 @@ private:
 	void conversionInputDone(FrameBuffer *buffer);
 	void conversionOutputDone(FrameBuffer *buffer);
 
-	void ispStatsReady();
+	void ispStatsReady(uint32_t frame, uint32_t bufferId);
 	void setSensorControls(const ControlList &sensorControls);
 };
 
@@ -308,8 +357,16 @@ public:
 
 	bool needConversion() const { return needConversion_; }
 	const Transform &combinedTransform() const { return combinedTransform_; }
+	unsigned int internalBufferCount() const { return internalBufferCount_; }
 
 private:
+	static constexpr unsigned int kMaxValidationCacheSize = 32;
+	static constexpr unsigned int kMinBufferCount = 2;
+
+	Status validateUncached();
+	Status applyMemoryBudget(Status status,
+				 const std::vector<unsigned int> &requestedCounts);
+
 	/*
 	 * The SimpleCameraData instance is guaranteed to be valid as long as
 	 * the corresponding Camera instance is valid. In order to borrow a
@@ -321,6 +378,7 @@ private:
 	const SimpleCameraData::Configuration *pipeConfig_;
 	bool needConversion_;
 	Transform combinedTransform_;
+	unsigned int internalBufferCount_;
 };
 
 class SimplePipelineHandler : public PipelineHandler
@@ -344,12 +402,16 @@ public:
 	V4L2Subdevice *subdev(const MediaEntity *entity);
 	MediaDevice *converter() { return converter_; }
 	bool swIspEnabled() const { return swIspEnabled_; }
+	unsigned int numInternalBuffers() const { return numInternalBuffers_; }
+
+	static constexpr unsigned int kDefaultInternalBuffers = 3;
+	static constexpr unsigned int kMinInternalBuffers = 2;
+	static constexpr unsigned int kMaxInternalBuffers = 16;
 
 protected:
 	int queueRequestDevice(Camera *camera, Request *request) override;
 
 private:
-	static constexpr unsigned int kNumInternalBuffers = 3;
 
 	struct EntityData {
 		std::unique_ptr<V4L2VideoDevice> video;
@@ -369,10 +431,13 @@ private:
 	void releasePipeline(SimpleCameraData *data);
 
 	MediaDevice *media_;
+	std::unique_ptr<V4L2DequeuePoller> dequeuePoller_;
 	std::map<const MediaEntity *, EntityData> entities_;
 
 	MediaDevice *converter_;
 	bool swIspEnabled_;
+	unsigned int numInternalBuffers_;
+	std::optional<int> dequeuePriority_;
 };
 
 /* -----------------------------------------------------------------------------
@@ -382,7 +447,7 @@ private:
 SimpleCameraData::SimpleCameraData(SimplePipelineHandler *pipe,
 				   unsigned int numStreams,
 				   MediaEntity *sensor)
-	: Camera::Private(pipe), streams_(numStreams)
+	: Camera::Private(pipe), streams_(numStreams), numInternalBuffers_(0)
 {
 	int ret;
 
@@ -550,6 +615,10 @@ int SimpleCameraData::init()
 			swIsp_->outputBufferReady.connect(this, &SimpleCameraData::conversionOutputDone);
 			swIsp_->ispStatsReady.connect(this, &SimpleCameraData::ispStatsReady);
 			swIsp_->setSensorControls.connect(this, &SimpleCameraData::setSensorControls);
+
+			/* Account for the memory shared with the IPA. */
+			chargeMemory(CameraMemoryUsage::PurposeShared,
+				     SwIspSharedMem::kSize);
 		}
 	}
 
@@ -845,9 +914,19 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 		}
 	}
 
-	if (request)
-		request->metadata().set(controls::SensorTimestamp,
-					buffer->metadata().timestamp);
+	ControlList metadata(controls::controls);
+
+	if (request) {
+		metadata.set(controls::SensorTimestamp,
+			     buffer->metadata().timestamp);
+		pipe->recordLatency(request, CameraStatistics::StageDequeue,
+				    buffer->metadata().timestamp);
+
+		if (!scalerCropMaximum_.isNull()) {
+			applyScalerCrop(request->controls());
+			metadata.set(controls::ScalerCrop, scalerCrop_);
+		}
+	}
 
 	/*
 	 * Queue the captured and the request buffer to the converter or Software
@@ -863,17 +942,77 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 		if (converter_)
 			converter_->queueBuffers(buffer, conversionQueue_.front());
 		else
-			swIsp_->queueBuffers(buffer, conversionQueue_.front());
+			swIsp_->queueBuffers(request->sequence(), buffer,
+					     conversionQueue_.front(), ispCrop_);
 
 		conversionQueue_.pop();
+
+		/*
+		 * Report the metadata only once the frame has been handed for
+		 * conversion, as the application may handle the signal
+		 * synchronously in this thread and delay the conversion.
+		 */
+		if (request)
+			pipe->metadataAvailable(request, metadata);
 		return;
 	}
 
 	/* Otherwise simply complete the request. */
+	pipe->metadataAvailable(request, metadata);
 	pipe->completeBuffer(request, buffer);
 	pipe->completeRequest(request);
 }
 
+/*
+ * Expose the digital zoom implemented by the Software ISP. The ScalerCrop
+ * rectangle is relative to the pixel array of the sensor, and maps to the
+ * captured frames through the analogue crop of the sensor.
+ */
+void SimpleCameraData::setupScalerCrop(const Size &captureSize)
+{
+	IPACameraSensorInfo sensorInfo;
+
+	if (sensor_->sensorInfo(&sensorInfo)) {
+		LOG(SimplePipeline, Warning)
+			<< "Sensor information unavailable, digital zoom disabled";
+		return;
+	}
+
+	scalerCropMaximum_ = sensorInfo.analogCrop;
+	captureSize_ = captureSize;
+	ispCrop_ = Rectangle(captureSize_);
+	scalerCrop_ = scalerCropMaximum_;
+
+	const Rectangle minCrop =
+		Rectangle(swIsp_->minCropSize())
+			.scaledBy(scalerCropMaximum_.size(), captureSize_);
+
+	controlInfo_ = ControlInfoMap({ { &controls::ScalerCrop,
+					  ControlInfo(minCrop, scalerCropMaximum_,
+						      scalerCropMaximum_) } },
+				      controls::controls);
+	properties_.set(properties::ScalerCropMaximum, scalerCropMaximum_);
+}
+
+void SimpleCameraData::applyScalerCrop(const ControlList &controls)
+{
+	const auto &scalerCrop = controls.get(controls::ScalerCrop);
+	if (!scalerCrop)
+		return;
+
+	Rectangle crop = scalerCrop->translatedBy(-scalerCropMaximum_.topLeft());
+	crop.scaleBy(captureSize_, scalerCropMaximum_.size());
+
+	/* The Software ISP further adjusts the crop to its own limits */
+	ispCrop_ = crop.size()
+			   .expandedTo({ 1, 1 })
+			   .centeredTo(crop.center())
+			   .enclosedIn(Rectangle(captureSize_));
+
+	scalerCrop_ = ispCrop_.scaledBy(scalerCropMaximum_.size(), captureSize_)
+			      .translatedBy(scalerCropMaximum_.topLeft());
+}
+
 void SimpleCameraData::conversionInputDone(FrameBuffer *buffer)
 {
 	/* Queue the input buffer back for capture. */
@@ -886,14 +1025,28 @@ void SimpleCameraData::conversionOutputDone(FrameBuffer *buffer)
 
 	/* Complete the buffer and the request. */
 	Request *request = buffer->request();
+
+	if (swIsp_) {
+		const SoftwareIsp::Metrics metrics = swIsp_->metrics();
+		ControlList &metadata = request->metadata();
+
+		metadata.set(controls::softisp::ProcessingTime,
+			     metrics.lastProcessingTime.get<std::micro>());
+		metadata.set(controls::softisp::ProcessingTimeAverage,
+			     metrics.averageProcessingTime.get<std::micro>());
+		metadata.set(controls::softisp::QueueDepth, metrics.queueDepth);
+		metadata.set(controls::softisp::DroppedFrames, metrics.droppedFrames);
+	}
+
 	if (pipe->completeBuffer(request, buffer))
 		pipe->completeRequest(request);
 }
 
-void SimpleCameraData::ispStatsReady()
+void SimpleCameraData::ispStatsReady(uint32_t frame, uint32_t bufferId)
 {
 	/* \todo Use the DelayedControls class */
-	swIsp_->processStats(sensor_->getControls({ V4L2_CID_ANALOGUE_GAIN,
+	swIsp_->processStats(frame, bufferId,
+			     sensor_->getControls({ V4L2_CID_ANALOGUE_GAIN,
 						    V4L2_CID_EXPOSURE }));
 }
 
@@ -947,7 +1100,7 @@ std::vector<const MediaPad *> SimpleCameraData::routedSourcePads(MediaPad *sink)
 SimpleCameraConfiguration::SimpleCameraConfiguration(Camera *camera,
 						     SimpleCameraData *data)
 	: CameraConfiguration(), camera_(camera->shared_from_this()),
-	  data_(data), pipeConfig_(nullptr)
+	  data_(data), pipeConfig_(nullptr), internalBufferCount_(0)
 {
 }
 
@@ -980,12 +1133,80 @@ static Size adjustSize(const Size &requestedSize, const SizeRange &supportedSize
 
 CameraConfiguration::Status SimpleCameraConfiguration::validate()
 {
-	const CameraSensor *sensor = data_->sensor_.get();
-	Status status = Valid;
-
 	if (config_.empty())
 		return Invalid;
 
+	/*
+	 * Applications may validate identical configurations repeatedly, for
+	 * instance during format negotiation. Look up the result of previous
+	 * validations to avoid the format searches and V4L2 ioctls.
+	 */
+	SimpleCameraData::ValidationKey key;
+	std::vector<unsigned int> requestedCounts;
+	key.first = orientation;
+	for (const StreamConfiguration &cfg : config_) {
+		key.second.emplace_back(cfg.pixelFormat, cfg.size);
+		requestedCounts.push_back(cfg.bufferCount);
+	}
+
+	{
+		MutexLocker locker(data_->validationCacheLock_);
+
+		auto it = data_->validationCache_.find(key);
+		if (it != data_->validationCache_.end()) {
+			const SimpleCameraData::ValidationResult &result = it->second;
+
+			orientation = result.orientation;
+			combinedTransform_ = result.combinedTransform;
+			pipeConfig_ = result.pipeConfig;
+			needConversion_ = result.needConversion;
+
+			config_.resize(result.streams.size());
+			for (unsigned int i = 0; i < config_.size(); ++i) {
+				StreamConfiguration &cfg = config_[i];
+				const SimpleCameraData::ValidatedStream &stream =
+					result.streams[i];
+
+				cfg.pixelFormat = stream.pixelFormat;
+				cfg.size = stream.size;
+				cfg.stride = stream.stride;
+				cfg.frameSize = stream.frameSize;
+				cfg.bufferCount = stream.bufferCount;
+			}
+
+			return applyMemoryBudget(result.status, requestedCounts);
+		}
+	}
+
+	Status status = validateUncached();
+	if (status == Invalid)
+		return status;
+
+	SimpleCameraData::ValidationResult result{
+		status, orientation, combinedTransform_, pipeConfig_,
+		needConversion_, {}
+	};
+
+	for (const StreamConfiguration &cfg : config_)
+		result.streams.push_back({ cfg.pixelFormat, cfg.size, cfg.stride,
+					   cfg.frameSize, cfg.bufferCount });
+
+	MutexLocker locker(data_->validationCacheLock_);
+
+	if (data_->validationCache_.size() >= kMaxValidationCacheSize)
+		data_->validationCache_.clear();
+
+	data_->validationCache_.emplace(std::move(key), std::move(result));
+	locker.unlock();
+
+	return applyMemoryBudget(status, requestedCounts);
+}
+
+CameraConfiguration::Status SimpleCameraConfiguration::validateUncached()
+{
+	const CameraSensor *sensor = data_->sensor_.get();
+	Status status = Valid;
+
 	Orientation requestedOrientation = orientation;
 	combinedTransform_ = sensor->computeTransform(&orientation);
 	if (orientation != requestedOrientation)
@@ -1144,13 +1365,137 @@ CameraConfiguration::Status SimpleCameraConfiguration::validate()
 	return status;
 }
 
+/*
+ * Fit the buffers in the camera memory budget. The budget depends on the
+ * camera state, the result isn't cached.
+ */
+CameraConfiguration::Status
+SimpleCameraConfiguration::applyMemoryBudget(Status status,
+					     const std::vector<unsigned int> &requestedCounts)
+{
+	internalBufferCount_ = needConversion_
+			     ? data_->pipe()->numInternalBuffers() : 0;
+
+	uint64_t budget = data_->memoryBudget();
+	if (!budget)
+		return status;
+
+	/*
+	 * Shared memory is allocated when the camera is created and can't be
+	 * reduced, only buffers are subject to adjustment.
+	 */
+	CameraMemoryUsage usage = data_->memoryUsage();
+	uint64_t shared = usage.bytes[CameraMemoryUsage::PurposeShared];
+	uint64_t available = budget > shared ? budget - shared : 0;
+
+	uint64_t internalSize = 0;
+	if (needConversion_) {
+		const PixelFormatInfo &info =
+			PixelFormatInfo::info(pipeConfig_->captureFormat);
+		internalSize = info.frameSize(pipeConfig_->captureSize);
+	}
+
+	auto required = [&]() {
+		uint64_t bytes = internalSize * internalBufferCount_;
+		for (const StreamConfiguration &cfg : config_)
+			bytes += static_cast<uint64_t>(cfg.frameSize) * cfg.bufferCount;
+		return bytes;
+	};
+
+	/*
+	 * Trade throughput for memory, reducing the internal buffers first as
+	 * they are invisible to the application, and then the buffers of all
+	 * streams in turn.
+	 */
+	while (required() > available &&
+	       internalBufferCount_ > SimplePipelineHandler::kMinInternalBuffers)
+		internalBufferCount_--;
+
+	bool reduced = true;
+	while (required() > available && reduced) {
+		reduced = false;
+
+		for (StreamConfiguration &cfg : config_) {
+			if (cfg.bufferCount <= kMinBufferCount ||
+			    required() <= available)
+				continue;
+
+			cfg.bufferCount--;
+			reduced = true;
+		}
+	}
+
+	if (required() > available) {
+		LOG(SimplePipeline, Error)
+			<< "Configuration requires " << required()
+			<< " bytes, exceeding the memory budget of " << budget
+			<< " bytes";
+		return Invalid;
+	}
+
+	for (unsigned int i = 0; i < config_.size(); ++i) {
+		if (i < requestedCounts.size() &&
+		    config_[i].bufferCount < requestedCounts[i]) {
+			LOG(SimplePipeline, Debug)
+				<< "Reducing buffer count of stream " << i
+				<< " to " << config_[i].bufferCount
+				<< " to fit the memory budget";
+			status = Adjusted;
+		}
+	}
+
+	if (internalBufferCount_ < data_->pipe()->numInternalBuffers())
+		LOG(SimplePipeline, Debug)
+			<< "Reducing internal buffer count to "
+			<< internalBufferCount_ << " to fit the memory budget";
+
+	return status;
+}
+
 /* -----------------------------------------------------------------------------
  * Pipeline Handler
  */
 
 SimplePipelineHandler::SimplePipelineHandler(CameraManager *manager)
-	: PipelineHandler(manager), converter_(nullptr)
+	: PipelineHandler(manager), converter_(nullptr),
+	  numInternalBuffers_(kDefaultInternalBuffers)
 {
+	/*
+	 * The number of internal buffers bounds the number of frames that can
+	 * be in flight between the capture device and the converter or the
+	 * Software ISP. Allow overriding it to trade memory for throughput.
+	 */
+	const char *buffers = utils::secure_getenv("LIBCAMERA_SIMPLE_CONVERSION_BUFFERS");
+	if (buffers) {
+		char *end;
+		unsigned long value = strtoul(buffers, &end, 10);
+		if (*buffers == '\0' || *end != '\0' ||
+		    value < kMinInternalBuffers || value > kMaxInternalBuffers)
+			LOG(SimplePipeline, Warning)
+				<< "Invalid LIBCAMERA_SIMPLE_CONVERSION_BUFFERS value '"
+				<< buffers << "', using " << kDefaultInternalBuffers
+				<< " buffers";
+		else
+			numInternalBuffers_ = value;
+	}
+
+	/*
+	 * Optionally dequeue buffers from the video nodes in a dedicated
+	 * thread, to keep the dequeue latency low when the pipeline handler
+	 * thread is busy. The value sets the SCHED_FIFO priority of the thread,
+	 * 0 keeps the default scheduling.
+	 */
+	const char *dequeue = utils::secure_getenv("LIBCAMERA_SIMPLE_DEQUEUE_THREAD");
+	if (dequeue) {
+		char *end;
+		unsigned long value = strtoul(dequeue, &end, 10);
+		if (*dequeue == '\0' || *end != '\0' || value > 99)
+			LOG(SimplePipeline, Warning)
+				<< "Invalid LIBCAMERA_SIMPLE_DEQUEUE_THREAD value '"
+				<< dequeue << "', dequeuing in the pipeline handler thread";
+		else
+			dequeuePriority_ = value;
+	}
 }
 
 std::unique_ptr<CameraConfiguration>
@@ -1266,6 +1611,8 @@ int SimplePipelineHandler::configure(Camera *camera, CameraConfiguration *c)
 	/* Configure the converter if needed. */
 	std::vector<std::reference_wrapper<StreamConfiguration>> outputCfgs;
 	data->useConversion_ = config->needConversion();
+	data->scalerCropMaximum_ = {};
+	data->controlInfo_ = {};
 
 	for (unsigned int i = 0; i < config->size(); ++i) {
 		StreamConfiguration &cfg = config->at(i);
@@ -1283,12 +1630,20 @@ int SimplePipelineHandler::configure(Camera *camera, CameraConfiguration *c)
 	inputCfg.pixelFormat = pipeConfig->captureFormat;
 	inputCfg.size = pipeConfig->captureSize;
 	inputCfg.stride = captureFormat.planes[0].bpl;
-	inputCfg.bufferCount = kNumInternalBuffers;
+	inputCfg.bufferCount = config->internalBufferCount();
+	data->numInternalBuffers_ = inputCfg.bufferCount;
 
-	return data->converter_
-		       ? data->converter_->configure(inputCfg, outputCfgs)
-		       : data->swIsp_->configure(inputCfg, outputCfgs,
-						 data->sensor_->controls());
+	if (data->converter_)
+		return data->converter_->configure(inputCfg, outputCfgs);
+
+	ret = data->swIsp_->configure(inputCfg, outputCfgs,
+				      data->sensor_->controls());
+	if (ret)
+		return ret;
+
+	data->setupScalerCrop(inputCfg.size);
+
+	return 0;
 }
 
 int SimplePipelineHandler::exportFrameBuffers(Camera *camera, Stream *stream,
@@ -1327,11 +1682,20 @@ int SimplePipelineHandler::start(Camera *camera, [[maybe_unused]] const ControlL
 
 	if (data->useConversion_) {
 		/*
-		 * When using the converter allocate a fixed number of internal
-		 * buffers.
+		 * When using the converter allocate the configured number of
+		 * internal buffers.
 		 */
-		ret = video->allocateBuffers(kNumInternalBuffers,
+		ret = video->allocateBuffers(data->numInternalBuffers_,
 					     &data->conversionBuffers_);
+		if (ret >= 0 &&
+		    data->chargeMemory(CameraMemoryUsage::PurposeInternal,
+				       Camera::Private::bufferMemory(data->conversionBuffers_)) < 0) {
+			LOG(SimplePipeline, Error)
+				<< "Internal buffers exceed the memory budget";
+			data->conversionBuffers_.clear();
+			video->releaseBuffers();
+			ret = -ENOMEM;
+		}
 	} else {
 		/* Otherwise, prepare for using buffers from the only stream. */
 		Stream *stream = &data->streams_[0];
@@ -1388,9 +1752,17 @@ void SimplePipelineHandler::stopDevice(Camera *camera)
 
 	video->bufferReady.disconnect(data, &SimpleCameraData::bufferReady);
 
+	data->unchargeMemory(CameraMemoryUsage::PurposeInternal,
+			     Camera::Private::bufferMemory(data->conversionBuffers_));
 	data->conversionBuffers_.clear();
 
 	releasePipeline(data);
+
+	for (const SimpleCameraData::Entity &entity : data->entities_) {
+		V4L2Subdevice *sd = subdev(entity.entity);
+		if (sd)
+			sd->invalidateStateCache();
+	}
 }
 
 int SimplePipelineHandler::queueRequestDevice(Camera *camera, Request *request)
@@ -1580,6 +1952,10 @@ bool SimplePipelineHandler::match(DeviceEnumerator *enumerator)
 	if (entities.empty())
 		return false;
 
+	if (dequeuePriority_)
+		dequeuePoller_ = std::make_unique<V4L2DequeuePoller>("simple:dqbuf",
+								     *dequeuePriority_);
+
 	/*
 	 * Insert all entities in the global entities list. Create and open
 	 * V4L2VideoDevice and V4L2Subdevice instances for the corresponding
@@ -1600,6 +1976,9 @@ bool SimplePipelineHandler::match(DeviceEnumerator *enumerator)
 					<< ": " << strerror(-ret);
 				return false;
 			}
+
+			if (dequeuePoller_)
+				video->setDequeuePoller(dequeuePoller_.get());
 			break;
 
 		case MediaEntity::Type::V4L2Subdevice:
@@ -1628,6 +2007,15 @@ bool SimplePipelineHandler::match(DeviceEnumerator *enumerator)
 				}
 			}
 
+			/*
+			 * Camera sensors are also controlled through the
+			 * CameraSensor class, which uses a separate
+			 * V4L2Subdevice instance. Only cache the state of the
+			 * subdevices fully controlled by the pipeline handler.
+			 */
+			if (entity->function() != MEDIA_ENT_F_CAM_SENSOR)
+				subdev->enableStateCache(true);
+
 			break;
 
 		default:
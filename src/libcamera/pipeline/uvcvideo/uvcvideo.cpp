@@ -6,11 +6,17 @@
  */
 
 #include <algorithm>
+#include <deque>
 #include <fstream>
 #include <iomanip>
 #include <math.h>
 #include <memory>
+#include <optional>
+#include <set>
+#include <string.h>
+#include <time.h>
 #include <tuple>
+#include <vector>
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/utils.h>
@@ -18,12 +24,17 @@
 #include <libcamera/camera.h>
 #include <libcamera/control_ids.h>
 #include <libcamera/controls.h>
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
 #include <libcamera/property_ids.h>
 #include <libcamera/request.h>
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/camera.h"
+#include "libcamera/internal/converter.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/sysfs.h"
@@ -33,6 +44,40 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(UVC)
 
+/*
+ * Recover the capture time of frames from the UVC payload headers.
+ *
+ * The device reports the presentation time (PTS) of each frame, sampled on its
+ * own clock at the start of exposure, and source clock references (SCR) that
+ * pair a device clock sample (STC) with the USB frame number (SOF) it was taken
+ * at. The UVC driver records the host time and USB frame number at which each
+ * payload header was received.
+ *
+ * Back-dating the host time by the number of USB frames elapsed since the SCR
+ * was sampled gives the host time of each STC sample. A linear fit over a
+ * sliding window of samples maps the device clock to the host clock, averaging
+ * the USB transfer jitter, and converts the PTS to a host timestamp.
+ */
+class UVCClock
+{
+public:
+	void reset();
+	void addSample(uint32_t stc, uint16_t deviceSof, uint64_t hostTime,
+		       uint16_t hostSof);
+	std::optional<uint64_t> hostTime(uint32_t pts) const;
+
+private:
+	static constexpr unsigned int kMaxSamples = 32;
+
+	struct Sample {
+		uint64_t stc;
+		uint64_t hostTime;
+	};
+
+	std::deque<Sample> samples_;
+	uint32_t lastStc_ = 0;
+};
+
 class UVCCameraData : public Camera::Private
 {
 public:
@@ -41,21 +86,79 @@ public:
 	{
 	}
 
-	int init(MediaDevice *media);
+	int init(MediaDevice *media, MediaDevice *decoder);
 	void addControl(uint32_t cid, const ControlInfo &v4l2info,
 			ControlInfoMap::Map *ctrls);
 	void bufferReady(FrameBuffer *buffer);
 
+	int startMetadata(unsigned int count);
+	void stopMetadata();
+
+	int startDecoder(unsigned int count);
+	void stopDecoder();
+
+	bool isDecoded(const PixelFormat &pixelFormat) const
+	{
+		return decodedFormats_.count(pixelFormat);
+	}
+
 	const std::string &id() const { return id_; }
 
 	std::unique_ptr<V4L2VideoDevice> video_;
 	Stream stream_;
 	std::map<PixelFormat, std::vector<SizeRange>> formats_;
 
+	/*
+	 * The JPEG decoder, if available, and the pixel formats it produces
+	 * from the MJPEG stream that the camera doesn't support natively.
+	 */
+	std::unique_ptr<Converter> decoder_;
+	std::set<PixelFormat> decodedFormats_;
+	bool decoding_ = false;
+
+	/* Request buffers waiting for a captured frame to be decoded into. */
+	std::deque<FrameBuffer *> decodeQueue_;
+
+	/* Copies of the buffers registered by the application. */
+	std::vector<std::unique_ptr<FrameBuffer>> registeredBuffers_;
+
+	/* The UVC metadata video node, if supported by the device. */
+	std::unique_ptr<V4L2VideoDevice> metadata_;
+
 private:
+	static constexpr unsigned int kMaxPendingTimestamps = 4;
+
 	bool generateId();
+	int initMetadata(MediaEntity *entity);
+	void initDecoder(MediaDevice *media);
+	void metadataBufferReady(FrameBuffer *buffer);
+	std::optional<uint64_t> parseMetadata(const FrameBuffer *buffer);
+	void completeFrame(FrameBuffer *buffer, std::optional<uint64_t> timestamp);
+	void decodeFrame(FrameBuffer *buffer, std::optional<uint64_t> timestamp);
+	void decodeInputDone(FrameBuffer *buffer);
+	void decodeOutputDone(FrameBuffer *buffer);
+	ControlList frameMetadata(const FrameBuffer *buffer,
+				  std::optional<uint64_t> timestamp);
 
 	std::string id_;
+
+	/* MJPEG buffers captured from the camera and fed to the decoder. */
+	std::vector<std::unique_ptr<FrameBuffer>> decodeBuffers_;
+
+	std::vector<std::unique_ptr<FrameBuffer>> metadataBuffers_;
+	MappedFrameBufferCache metadataMappings_;
+	UVCClock clock_;
+
+	/*
+	 * Video buffers waiting for their metadata, and timestamps computed
+	 * from metadata buffers waiting for their video buffer, matched by
+	 * sequence number.
+	 */
+	std::deque<FrameBuffer *> pendingBuffers_;
+	std::deque<std::pair<uint32_t, std::optional<uint64_t>>> pendingTimestamps_;
+
+	std::optional<uint64_t> lastTimestamp_;
+	uint32_t lastSequence_ = 0;
 };
 
 class UVCCameraConfiguration : public CameraConfiguration
@@ -80,9 +183,12 @@ public:
 
 	int exportFrameBuffers(Camera *camera, Stream *stream,
 			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
+	int registerFrameBuffers(Camera *camera, Stream *stream,
+				 Span<FrameBuffer *const> buffers) override;
 
 	int start(Camera *camera, const ControlList *controls) override;
 	void stopDevice(Camera *camera) override;
+	void releaseDevice(Camera *camera) override;
 
 	int queueRequestDevice(Camera *camera, Request *request) override;
 
@@ -97,6 +203,8 @@ private:
 	{
 		return static_cast<UVCCameraData *>(camera->_d());
 	}
+
+	MediaDevice *decoder_;
 };
 
 UVCCameraConfiguration::UVCCameraConfiguration(UVCCameraData *data)
@@ -154,16 +262,27 @@ CameraConfiguration::Status UVCCameraConfiguration::validate()
 
 	cfg.bufferCount = 4;
 
+	/* Decoded formats are captured as MJPEG at the same size. */
+	bool decoded = data_->isDecoded(cfg.pixelFormat);
+
 	V4L2DeviceFormat format;
-	format.fourcc = data_->video_->toV4L2PixelFormat(cfg.pixelFormat);
+	format.fourcc = data_->video_->toV4L2PixelFormat(decoded ? formats::MJPEG
+								 : cfg.pixelFormat);
 	format.size = cfg.size;
 
 	int ret = data_->video_->tryFormat(&format);
 	if (ret)
 		return Invalid;
 
-	cfg.stride = format.planes[0].bpl;
-	cfg.frameSize = format.planes[0].size;
+	if (decoded) {
+		std::tie(cfg.stride, cfg.frameSize) =
+			data_->decoder_->strideAndFrameSize(cfg.pixelFormat, cfg.size);
+		if (!cfg.frameSize)
+			return Invalid;
+	} else {
+		cfg.stride = format.planes[0].bpl;
+		cfg.frameSize = format.planes[0].size;
+	}
 
 	if (cfg.colorSpace != format.colorSpace) {
 		cfg.colorSpace = format.colorSpace;
@@ -174,7 +293,7 @@ CameraConfiguration::Status UVCCameraConfiguration::validate()
 }
 
 PipelineHandlerUVC::PipelineHandlerUVC(CameraManager *manager)
-	: PipelineHandler(manager)
+	: PipelineHandler(manager), decoder_(nullptr)
 {
 }
 
@@ -192,7 +311,13 @@ PipelineHandlerUVC::generateConfiguration(Camera *camera,
 	StreamFormats formats(data->formats_);
 	StreamConfiguration cfg(formats);
 
-	cfg.pixelFormat = formats.pixelformats().front();
+	/* Default to a format captured natively, decoding has a cost. */
+	const std::vector<PixelFormat> pixelFormats = formats.pixelformats();
+	auto native = std::find_if(pixelFormats.begin(), pixelFormats.end(),
+				   [&](const PixelFormat &pixelFormat) {
+					   return !data->isDecoded(pixelFormat);
+				   });
+	cfg.pixelFormat = native != pixelFormats.end() ? *native : pixelFormats.front();
 	cfg.size = formats.sizes(cfg.pixelFormat).back();
 	cfg.bufferCount = 4;
 
@@ -209,8 +334,11 @@ int PipelineHandlerUVC::configure(Camera *camera, CameraConfiguration *config)
 	StreamConfiguration &cfg = config->at(0);
 	int ret;
 
+	data->decoding_ = data->isDecoded(cfg.pixelFormat);
+	PixelFormat captureFormat = data->decoding_ ? formats::MJPEG : cfg.pixelFormat;
+
 	V4L2DeviceFormat format;
-	format.fourcc = data->video_->toV4L2PixelFormat(cfg.pixelFormat);
+	format.fourcc = data->video_->toV4L2PixelFormat(captureFormat);
 	format.size = cfg.size;
 
 	ret = data->video_->setFormat(&format);
@@ -218,11 +346,28 @@ int PipelineHandlerUVC::configure(Camera *camera, CameraConfiguration *config)
 		return ret;
 
 	if (format.size != cfg.size ||
-	    format.fourcc != data->video_->toV4L2PixelFormat(cfg.pixelFormat))
+	    format.fourcc != data->video_->toV4L2PixelFormat(captureFormat))
 		return -EINVAL;
 
+	if (data->decoding_) {
+		StreamConfiguration inputCfg;
+		inputCfg.pixelFormat = captureFormat;
+		inputCfg.size = format.size;
+		inputCfg.stride = format.planes[0].bpl;
+		inputCfg.frameSize = format.planes[0].size;
+		inputCfg.bufferCount = cfg.bufferCount;
+
+		ret = data->decoder_->configure(inputCfg, { cfg });
+		if (ret < 0) {
+			LOG(UVC, Error) << "Failed to configure the JPEG decoder";
+			return ret;
+		}
+	}
+
 	cfg.setStream(&data->stream_);
 
+	data->registeredBuffers_.clear();
+
 	return 0;
 }
 
@@ -232,20 +377,69 @@ int PipelineHandlerUVC::exportFrameBuffers(Camera *camera, Stream *stream,
 	UVCCameraData *data = cameraData(camera);
 	unsigned int count = stream->configuration().bufferCount;
 
+	if (data->decoding_)
+		return data->decoder_->exportBuffers(0, count, buffers);
+
 	return data->video_->exportBuffers(count, buffers);
 }
 
+int PipelineHandlerUVC::registerFrameBuffers(Camera *camera,
+					     [[maybe_unused]] Stream *stream,
+					     Span<FrameBuffer *const> buffers)
+{
+	UVCCameraData *data = cameraData(camera);
+
+	/*
+	 * Keep copies of the buffers, sharing their dmabufs, as the application
+	 * may destroy the registered FrameBuffer instances at any time.
+	 */
+	data->registeredBuffers_.clear();
+	for (const FrameBuffer *buffer : buffers)
+		data->registeredBuffers_.push_back(std::make_unique<FrameBuffer>(buffer->planes()));
+
+	return 0;
+}
+
 int PipelineHandlerUVC::start(Camera *camera, [[maybe_unused]] const ControlList *controls)
 {
 	UVCCameraData *data = cameraData(camera);
 	unsigned int count = data->stream_.configuration().bufferCount;
+	int ret;
 
-	int ret = data->video_->importBuffers(count);
-	if (ret < 0)
-		return ret;
+	if (data->decoding_) {
+		/*
+		 * Application buffers are the decoder outputs, capture to
+		 * internal buffers.
+		 */
+		ret = data->startDecoder(count);
+		if (ret < 0)
+			return ret;
+	} else {
+		std::vector<const FrameBuffer *> buffers;
+
+		for (const std::unique_ptr<FrameBuffer> &buffer : data->registeredBuffers_)
+			buffers.push_back(buffer.get());
+
+		count = std::max<unsigned int>(count, buffers.size());
+
+		ret = data->video_->importBuffers(count, buffers);
+		if (ret < 0)
+			return ret;
+	}
+
+	/*
+	 * The metadata only improves the timestamps, carry on without it if
+	 * it can't be captured.
+	 */
+	if (data->metadata_ && data->startMetadata(count) < 0)
+		LOG(UVC, Warning)
+			<< "Failed to start metadata capture, using buffer timestamps";
 
 	ret = data->video_->streamOn();
 	if (ret < 0) {
+		data->stopMetadata();
+		if (data->decoding_)
+			data->stopDecoder();
 		data->video_->releaseBuffers();
 		return ret;
 	}
@@ -257,9 +451,18 @@ void PipelineHandlerUVC::stopDevice(Camera *camera)
 {
 	UVCCameraData *data = cameraData(camera);
 	data->video_->streamOff();
+	data->stopMetadata();
+	if (data->decoding_)
+		data->stopDecoder();
 	data->video_->releaseBuffers();
 }
 
+void PipelineHandlerUVC::releaseDevice(Camera *camera)
+{
+	UVCCameraData *data = cameraData(camera);
+	data->registeredBuffers_.clear();
+}
+
 int PipelineHandlerUVC::processControl(ControlList *controls, unsigned int id,
 				       const ControlValue &value)
 {
@@ -377,6 +580,12 @@ int PipelineHandlerUVC::queueRequestDevice(Camera *camera, Request *request)
 	if (ret < 0)
 		return ret;
 
+	/* The buffer is filled by the decoder from the next captured frame. */
+	if (data->decoding_) {
+		data->decodeQueue_.push_back(buffer);
+		return 0;
+	}
+
 	ret = data->video_->queueBuffer(buffer);
 	if (ret < 0)
 		return ret;
@@ -393,9 +602,21 @@ bool PipelineHandlerUVC::match(DeviceEnumerator *enumerator)
 	if (!media)
 		return false;
 
+	/*
+	 * Acquire a hardware JPEG decoder, if any, to offer uncompressed
+	 * formats at the resolutions the camera only supports in MJPEG. Each
+	 * camera uses its own context on the shared memory-to-memory device.
+	 */
+	for (const char *driver : { "mxc-jpeg", "mtk-jpeg", "s5p-jpeg" }) {
+		if (decoder_)
+			break;
+
+		decoder_ = acquireMediaDevice(enumerator, DeviceMatch(driver));
+	}
+
 	std::unique_ptr<UVCCameraData> data = std::make_unique<UVCCameraData>(this);
 
-	if (data->init(media))
+	if (data->init(media, decoder_))
 		return false;
 
 	/* Create and register the camera. */
@@ -411,7 +632,7 @@ bool PipelineHandlerUVC::match(DeviceEnumerator *enumerator)
 	return true;
 }
 
-int UVCCameraData::init(MediaDevice *media)
+int UVCCameraData::init(MediaDevice *media, MediaDevice *decoder)
 {
 	int ret;
 
@@ -434,6 +655,20 @@ int UVCCameraData::init(MediaDevice *media)
 
 	video_->bufferReady.connect(this, &UVCCameraData::bufferReady);
 
+	/*
+	 * Recent UVC drivers expose the payload headers through a second
+	 * metadata video node, use it to compute precise timestamps.
+	 */
+	auto metadata = std::find_if(entities.begin(), entities.end(),
+				     [](MediaEntity *e) {
+					     return e->type() == MediaEntity::Type::V4L2VideoDevice &&
+						    !(e->flags() & MEDIA_ENT_FL_DEFAULT);
+				     });
+	if (metadata != entities.end() && initMetadata(*metadata) < 0) {
+		LOG(UVC, Debug) << "UVC metadata not available";
+		metadata_.reset();
+	}
+
 	/* Generate the camera ID. */
 	if (!generateId()) {
 		LOG(UVC, Error) << "Failed to generate camera ID";
@@ -466,6 +701,9 @@ int UVCCameraData::init(MediaDevice *media)
 		return -EINVAL;
 	}
 
+	if (decoder && formats_.count(formats::MJPEG))
+		initDecoder(decoder);
+
 	/* Populate the camera properties. */
 	properties_.set(properties::Model, utils::toAscii(media->model()));
 
@@ -697,18 +935,461 @@ void UVCCameraData::addControl(uint32_t cid, const ControlInfo &v4l2Info,
 	ctrls->emplace(id, info);
 }
 
+int UVCCameraData::initMetadata(MediaEntity *entity)
+{
+	metadata_ = std::make_unique<V4L2VideoDevice>(entity);
+	int ret = metadata_->open();
+	if (ret)
+		return ret;
+
+	if (!metadata_->caps().isMetaCapture())
+		return -ENODEV;
+
+	V4L2DeviceFormat format;
+	format.fourcc = V4L2PixelFormat(V4L2_META_FMT_UVC);
+	ret = metadata_->setFormat(&format);
+	if (ret)
+		return ret;
+
+	if (format.fourcc != V4L2PixelFormat(V4L2_META_FMT_UVC))
+		return -EINVAL;
+
+	metadata_->bufferReady.connect(this, &UVCCameraData::metadataBufferReady);
+
+	return 0;
+}
+
+void UVCCameraData::initDecoder(MediaDevice *media)
+{
+	decoder_ = ConverterFactoryBase::create(media);
+	if (!decoder_ || !decoder_->isValid()) {
+		LOG(UVC, Warning)
+			<< "Failed to create the JPEG decoder, disabling decoding";
+		decoder_.reset();
+		return;
+	}
+
+	/*
+	 * Offer the decoder output formats at the MJPEG sizes, unless the
+	 * camera supports them natively.
+	 */
+	const std::vector<SizeRange> sizes = formats_[formats::MJPEG];
+
+	for (const PixelFormat &pixelFormat : decoder_->formats(formats::MJPEG)) {
+		if (formats_.count(pixelFormat))
+			continue;
+
+		formats_[pixelFormat] = sizes;
+		decodedFormats_.insert(pixelFormat);
+	}
+
+	if (decodedFormats_.empty()) {
+		decoder_.reset();
+		return;
+	}
+
+	decoder_->inputBufferReady.connect(this, &UVCCameraData::decodeInputDone);
+	decoder_->outputBufferReady.connect(this, &UVCCameraData::decodeOutputDone);
+
+	LOG(UVC, Debug)
+		<< "Decoding MJPEG with " << decoder_->deviceNode();
+}
+
+int UVCCameraData::startDecoder(unsigned int count)
+{
+	int ret = video_->allocateBuffers(count, &decodeBuffers_);
+	if (ret < 0)
+		return ret;
+
+	ret = decoder_->start();
+	if (ret < 0) {
+		decodeBuffers_.clear();
+		video_->releaseBuffers();
+		return ret;
+	}
+
+	for (const std::unique_ptr<FrameBuffer> &buffer : decodeBuffers_) {
+		ret = video_->queueBuffer(buffer.get());
+		if (ret < 0) {
+			stopDecoder();
+			video_->releaseBuffers();
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+void UVCCameraData::stopDecoder()
+{
+	decoder_->stop();
+
+	/* Cancel the requests that no frame has been captured for. */
+	while (!decodeQueue_.empty()) {
+		FrameBuffer *buffer = decodeQueue_.front();
+		Request *request = buffer->request();
+
+		buffer->_d()->cancel();
+		pipe()->completeBuffer(request, buffer);
+		pipe()->completeRequest(request);
+
+		decodeQueue_.pop_front();
+	}
+
+	decodeBuffers_.clear();
+}
+
+int UVCCameraData::startMetadata(unsigned int count)
+{
+	clock_.reset();
+	lastTimestamp_.reset();
+
+	int ret = metadata_->allocateBuffers(count, &metadataBuffers_);
+	if (ret < 0)
+		return ret;
+
+	for (const std::unique_ptr<FrameBuffer> &buffer : metadataBuffers_) {
+		if (!metadataMappings_.map(buffer.get(), MappedFrameBuffer::MapFlag::Read)) {
+			stopMetadata();
+			return -ENOMEM;
+		}
+
+		ret = metadata_->queueBuffer(buffer.get());
+		if (ret < 0) {
+			stopMetadata();
+			return ret;
+		}
+	}
+
+	ret = metadata_->streamOn();
+	if (ret < 0) {
+		stopMetadata();
+		return ret;
+	}
+
+	return 0;
+}
+
+void UVCCameraData::stopMetadata()
+{
+	if (metadataBuffers_.empty())
+		return;
+
+	metadata_->streamOff();
+
+	/* Complete the frames that were still waiting for their metadata. */
+	while (!pendingBuffers_.empty()) {
+		completeFrame(pendingBuffers_.front(), std::nullopt);
+		pendingBuffers_.pop_front();
+	}
+	pendingTimestamps_.clear();
+
+	metadataMappings_.clear();
+	metadataBuffers_.clear();
+	metadata_->releaseBuffers();
+}
+
 void UVCCameraData::bufferReady(FrameBuffer *buffer)
 {
+	/*
+	 * Frames are completed in order. Any earlier frame still waiting for
+	 * its metadata won't get it anymore, complete it first.
+	 */
+	while (!pendingBuffers_.empty()) {
+		completeFrame(pendingBuffers_.front(), std::nullopt);
+		pendingBuffers_.pop_front();
+	}
+
+	if (metadataBuffers_.empty() ||
+	    buffer->metadata().status != FrameMetadata::FrameSuccess) {
+		completeFrame(buffer, std::nullopt);
+		return;
+	}
+
+	uint32_t sequence = buffer->metadata().sequence;
+
+	while (!pendingTimestamps_.empty() &&
+	       pendingTimestamps_.front().first < sequence)
+		pendingTimestamps_.pop_front();
+
+	if (!pendingTimestamps_.empty() &&
+	    pendingTimestamps_.front().first == sequence) {
+		completeFrame(buffer, pendingTimestamps_.front().second);
+		pendingTimestamps_.pop_front();
+		return;
+	}
+
+	pendingBuffers_.push_back(buffer);
+}
+
+void UVCCameraData::metadataBufferReady(FrameBuffer *buffer)
+{
+	const FrameMetadata &metadata = buffer->metadata();
+
+	if (metadata.status == FrameMetadata::FrameCancelled)
+		return;
+
+	std::optional<uint64_t> timestamp;
+	if (metadata.status == FrameMetadata::FrameSuccess)
+		timestamp = parseMetadata(buffer);
+
+	uint32_t sequence = metadata.sequence;
+	metadata_->queueBuffer(buffer);
+
+	while (!pendingBuffers_.empty()) {
+		FrameBuffer *pending = pendingBuffers_.front();
+		uint32_t pendingSequence = pending->metadata().sequence;
+
+		if (pendingSequence > sequence)
+			break;
+
+		completeFrame(pending, pendingSequence == sequence
+				       ? timestamp : std::nullopt);
+		pendingBuffers_.pop_front();
+
+		if (pendingSequence == sequence)
+			return;
+	}
+
+	pendingTimestamps_.emplace_back(sequence, timestamp);
+	if (pendingTimestamps_.size() > kMaxPendingTimestamps)
+		pendingTimestamps_.pop_front();
+}
+
+/*
+ * Metadata buffers contain one block per UVC payload header, made of the host
+ * timestamp and USB frame number at reception followed by the payload header
+ * without its first two bytes. See struct uvc_meta_buf in linux/uvcvideo.h.
+ */
+std::optional<uint64_t> UVCCameraData::parseMetadata(const FrameBuffer *buffer)
+{
+	static constexpr uint8_t kUvcStreamPts = 1 << 2;
+	static constexpr uint8_t kUvcStreamScr = 1 << 3;
+	static constexpr size_t kBlockHeaderSize = 12;
+
+	MappedFrameBuffer *mapped =
+		metadataMappings_.map(buffer, MappedFrameBuffer::MapFlag::Read);
+	if (!mapped)
+		return std::nullopt;
+
+	const uint8_t *data = mapped->planes()[0].data();
+	size_t size = std::min<size_t>(buffer->metadata().planes()[0].bytesused,
+				       mapped->planes()[0].size());
+	std::optional<uint32_t> pts;
+
+	for (size_t offset = 0; offset + kBlockHeaderSize <= size;) {
+		const uint8_t *block = data + offset;
+		uint64_t hostTime;
+		uint16_t hostSof;
+
+		memcpy(&hostTime, block, sizeof(hostTime));
+		memcpy(&hostSof, block + 8, sizeof(hostSof));
+		uint8_t length = block[10];
+		uint8_t flags = block[11];
+
+		if (length < 2 || offset + kBlockHeaderSize + length - 2 > size)
+			break;
+
+		const uint8_t *header = block + kBlockHeaderSize;
+		unsigned int headerSize = length - 2;
+
+		if (flags & kUvcStreamPts && headerSize >= 4) {
+			if (!pts) {
+				uint32_t value;
+				memcpy(&value, header, sizeof(value));
+				pts = value;
+			}
+
+			header += 4;
+			headerSize -= 4;
+		}
+
+		if (flags & kUvcStreamScr && headerSize >= 6) {
+			uint32_t stc;
+			uint16_t deviceSof;
+
+			memcpy(&stc, header, sizeof(stc));
+			memcpy(&deviceSof, header + 4, sizeof(deviceSof));
+			clock_.addSample(stc, deviceSof, hostTime, hostSof);
+		}
+
+		offset += kBlockHeaderSize + length - 2;
+	}
+
+	if (!pts)
+		return std::nullopt;
+
+	return clock_.hostTime(*pts);
+}
+
+void UVCCameraData::completeFrame(FrameBuffer *buffer, std::optional<uint64_t> timestamp)
+{
+	if (decoding_) {
+		decodeFrame(buffer, timestamp);
+		return;
+	}
+
 	Request *request = buffer->request();
 
-	/* \todo Use the UVC metadata to calculate a more precise timestamp */
-	request->metadata().set(controls::SensorTimestamp,
-				buffer->metadata().timestamp);
+	if (buffer->metadata().status == FrameMetadata::FrameSuccess)
+		pipe()->recordLatency(request, CameraStatistics::StageDequeue,
+				      buffer->metadata().timestamp);
+
+	pipe()->metadataAvailable(request, frameMetadata(buffer, timestamp));
+
+	pipe()->completeBuffer(request, buffer);
+	pipe()->completeRequest(request);
+}
+
+void UVCCameraData::decodeFrame(FrameBuffer *buffer, std::optional<uint64_t> timestamp)
+{
+	if (buffer->metadata().status == FrameMetadata::FrameCancelled)
+		return;
+
+	/* Drop the frame if it is corrupted or if no request is waiting. */
+	if (buffer->metadata().status != FrameMetadata::FrameSuccess ||
+	    decodeQueue_.empty()) {
+		video_->queueBuffer(buffer);
+		return;
+	}
+
+	FrameBuffer *output = decodeQueue_.front();
+	Request *request = output->request();
+	decodeQueue_.pop_front();
+
+	pipe()->metadataAvailable(request, frameMetadata(buffer, timestamp));
+
+	int ret = decoder_->queueBuffers(buffer, { { 0, output } });
+	if (ret < 0) {
+		LOG(UVC, Error) << "Failed to queue frame to the JPEG decoder";
+
+		video_->queueBuffer(buffer);
+
+		output->_d()->cancel();
+		pipe()->completeBuffer(request, output);
+		pipe()->completeRequest(request);
+	}
+}
+
+void UVCCameraData::decodeInputDone(FrameBuffer *buffer)
+{
+	if (buffer->metadata().status == FrameMetadata::FrameCancelled)
+		return;
+
+	video_->queueBuffer(buffer);
+}
+
+void UVCCameraData::decodeOutputDone(FrameBuffer *buffer)
+{
+	Request *request = buffer->request();
 
 	pipe()->completeBuffer(request, buffer);
 	pipe()->completeRequest(request);
 }
 
+ControlList UVCCameraData::frameMetadata(const FrameBuffer *buffer,
+					 std::optional<uint64_t> timestamp)
+{
+	uint32_t sequence = buffer->metadata().sequence;
+
+	ControlList metadata(controls::controls);
+	metadata.set(controls::SensorTimestamp,
+		     timestamp.value_or(buffer->metadata().timestamp));
+
+	if (timestamp) {
+		/* Average over dropped frames to report the frame duration. */
+		if (lastTimestamp_ && *timestamp > *lastTimestamp_ &&
+		    sequence > lastSequence_)
+			metadata.set(controls::FrameDuration,
+				     static_cast<int64_t>((*timestamp - *lastTimestamp_) /
+							  (sequence - lastSequence_) / 1000));
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t latency = now.tv_sec * 1000000000LL + now.tv_nsec - *timestamp;
+		LOG(UVC, Debug)
+			<< "Frame " << sequence << " latency " << latency / 1000 << "us";
+
+		lastTimestamp_ = timestamp;
+		lastSequence_ = sequence;
+	}
+
+	return metadata;
+}
+
+void UVCClock::reset()
+{
+	samples_.clear();
+}
+
+void UVCClock::addSample(uint32_t stc, uint16_t deviceSof, uint64_t hostTime,
+			 uint16_t hostSof)
+{
+	/* Extend the 32-bit device clock to 64 bits. */
+	uint64_t stc64 = samples_.empty()
+		       ? stc : samples_.back().stc + static_cast<uint32_t>(stc - lastStc_);
+
+	/* USB frame numbers are 11-bit counters incremented every millisecond. */
+	unsigned int elapsedFrames = (hostSof - deviceSof) & 0x7ff;
+	uint64_t elapsed = elapsedFrames * 1000000ULL;
+	if (elapsed > hostTime)
+		return;
+
+	/* Skip the SCR repeated in all the payloads of a frame. */
+	if (!samples_.empty() && samples_.back().stc == stc64)
+		return;
+
+	samples_.push_back({ stc64, hostTime - elapsed });
+	lastStc_ = stc;
+	if (samples_.size() > kMaxSamples)
+		samples_.pop_front();
+}
+
+std::optional<uint64_t> UVCClock::hostTime(uint32_t pts) const
+{
+	if (samples_.size() < 2)
+		return std::nullopt;
+
+	/* Least squares fit of the host time against the device clock. */
+	const Sample &first = samples_.front();
+	double meanX = 0.0;
+	double meanY = 0.0;
+
+	for (const Sample &sample : samples_) {
+		meanX += static_cast<double>(sample.stc - first.stc);
+		meanY += static_cast<double>(sample.hostTime) -
+			 static_cast<double>(first.hostTime);
+	}
+
+	meanX /= samples_.size();
+	meanY /= samples_.size();
+
+	double sxx = 0.0;
+	double sxy = 0.0;
+
+	for (const Sample &sample : samples_) {
+		double x = static_cast<double>(sample.stc - first.stc) - meanX;
+		double y = static_cast<double>(sample.hostTime) -
+			   static_cast<double>(first.hostTime) - meanY;
+		sxx += x * x;
+		sxy += x * y;
+	}
+
+	if (sxx <= 0.0 || sxy <= 0.0)
+		return std::nullopt;
+
+	/* The PTS precedes the last STC sample by less than half a wrap. */
+	int64_t pts64 = static_cast<int64_t>(samples_.back().stc) +
+			static_cast<int32_t>(pts - lastStc_);
+	double x = static_cast<double>(pts64 - static_cast<int64_t>(first.stc)) - meanX;
+	double time = static_cast<double>(first.hostTime) + meanY + sxy / sxx * x;
+
+	if (time <= 0.0)
+		return std::nullopt;
+
+	return static_cast<uint64_t>(time);
+}
+
 REGISTER_PIPELINE_HANDLER(PipelineHandlerUVC, "uvcvideo")
 
 } /* namespace libcamera */
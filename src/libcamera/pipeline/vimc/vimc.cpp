@@ -612,9 +612,12 @@ void VimcCameraData::bufferReady(FrameBuffer *buffer)
 		return;
 	}
 
-	/* Record the sensor's timestamp in the request metadata. */
-	request->metadata().set(controls::SensorTimestamp,
-				buffer->metadata().timestamp);
+	/* Report the sensor's timestamp in the request metadata. */
+	ControlList metadata(controls::controls);
+	metadata.set(controls::SensorTimestamp, buffer->metadata().timestamp);
+	pipe->metadataAvailable(request, metadata);
+	pipe->recordLatency(request, CameraStatistics::StageDequeue,
+			    buffer->metadata().timestamp);
 
 	pipe->completeBuffer(request, buffer);
 	pipe->completeRequest(request);
@@ -0,0 +1,714 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Pipeline handler for virtual cameras
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <queue>
+#include <set>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+#include <libcamera/base/file.h>
+#include <libcamera/base/log.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+#include <libcamera/formats.h>
+#include <libcamera/property_ids.h>
+#include <libcamera/request.h>
+#include <libcamera/stream.h>
+
+#include <libcamera/ipa/ipa_interface.h>
+#include <libcamera/ipa/ipa_module_info.h>
+#include <libcamera/ipa/virtual_ipa_interface.h>
+#include <libcamera/ipa/virtual_ipa_proxy.h>
+
+#include "libcamera/internal/camera.h"
+#include "libcamera/internal/dma_buf_allocator.h"
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+#include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/yaml_parser.h"
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(Virtual)
+
+using namespace std::chrono_literals;
+
+namespace {
+
+static const std::array<PixelFormat, 2> kPixelFormats = {
+	formats::NV12,
+	formats::XRGB8888,
+};
+
+static constexpr Size kMinSize{ 32, 32 };
+static constexpr Size kMaxSize{ 8192, 8192 };
+
+/* Nominal frame rate used for exposure limits in free-running mode. */
+static constexpr unsigned int kNominalFrameRate = 30;
+
+static constexpr unsigned int kBufferCount = 4;
+
+} /* namespace */
+
+class VirtualCameraData : public Camera::Private
+{
+public:
+	struct Config {
+		std::string id;
+		Size size;
+		unsigned int frameRate;
+		unsigned int controlDelay;
+		bool testPattern;
+	};
+
+	VirtualCameraData(PipelineHandler *pipe, const Config &config)
+		: Camera::Private(pipe), config_(config)
+	{
+	}
+
+	int init();
+
+	void scheduleFrame();
+	void frameStart();
+	void fillTestPattern(FrameBuffer *buffer);
+	void cancelRequests();
+
+	void setSensorControls(unsigned int frame, const ControlList &sensorControls);
+	void metadataReady(unsigned int frame, const ControlList &metadata);
+
+	const Config config_;
+	Stream stream_;
+
+	std::unique_ptr<ipa::virt::IPAProxyVirtual> ipa_;
+
+	ControlInfoMap sensorControlInfo_;
+	IPACameraSensorInfo sensorInfo_;
+
+	Timer timer_;
+	std::chrono::steady_clock::duration frameInterval_;
+	std::chrono::steady_clock::time_point nextFrame_;
+	uint64_t lastTimestamp_;
+	uint32_t sequence_;
+
+	/* Requests waiting for a frame, and frames waiting for the IPA. */
+	std::queue<Request *> queuedRequests_;
+	std::queue<std::pair<uint32_t, Request *>> processingRequests_;
+
+	/*
+	 * Emulate the sensor control delays: controls written by the IPA take
+	 * effect config_.controlDelay frames later, as with DelayedControls.
+	 */
+	std::deque<std::pair<uint32_t, ControlList>> pendingSensorControls_;
+	ControlList sensorControls_;
+
+	std::set<const FrameBuffer *> patternBuffers_;
+};
+
+class VirtualCameraConfiguration : public CameraConfiguration
+{
+public:
+	VirtualCameraConfiguration(VirtualCameraData *data);
+
+	Status validate() override;
+
+private:
+	VirtualCameraData *data_;
+};
+
+class PipelineHandlerVirtual : public PipelineHandler
+{
+public:
+	PipelineHandlerVirtual(CameraManager *manager);
+
+	std::unique_ptr<CameraConfiguration> generateConfiguration(Camera *camera,
+								   Span<const StreamRole> roles) override;
+	int configure(Camera *camera, CameraConfiguration *config) override;
+
+	int exportFrameBuffers(Camera *camera, Stream *stream,
+			       std::vector<std::unique_ptr<FrameBuffer>> *buffers) override;
+
+	int start(Camera *camera, const ControlList *controls) override;
+	void stopDevice(Camera *camera) override;
+
+	int queueRequestDevice(Camera *camera, Request *request) override;
+
+	bool match(DeviceEnumerator *enumerator) override;
+
+private:
+	int parseConfiguration(std::vector<VirtualCameraData::Config> *configs);
+
+	VirtualCameraData *cameraData(Camera *camera)
+	{
+		return static_cast<VirtualCameraData *>(camera->_d());
+	}
+
+	/* Cameras are only created once, as they don't depend on devices. */
+	static bool created_;
+
+	DmaBufAllocator dmaBufAllocator_;
+};
+
+bool PipelineHandlerVirtual::created_ = false;
+
+VirtualCameraConfiguration::VirtualCameraConfiguration(VirtualCameraData *data)
+	: CameraConfiguration(), data_(data)
+{
+}
+
+CameraConfiguration::Status VirtualCameraConfiguration::validate()
+{
+	Status status = Valid;
+
+	if (config_.empty())
+		return Invalid;
+
+	if (orientation != Orientation::Rotate0) {
+		orientation = Orientation::Rotate0;
+		status = Adjusted;
+	}
+
+	/* Cap the number of entries to the available streams. */
+	if (config_.size() > 1) {
+		config_.resize(1);
+		status = Adjusted;
+	}
+
+	StreamConfiguration &cfg = config_[0];
+
+	/* Adjust the pixel format. */
+	if (std::find(kPixelFormats.begin(), kPixelFormats.end(),
+		      cfg.pixelFormat) == kPixelFormats.end()) {
+		LOG(Virtual, Debug) << "Adjusting format to NV12";
+		cfg.pixelFormat = formats::NV12;
+		status = Adjusted;
+	}
+
+	/* The test pattern generator only produces the configured size. */
+	if (cfg.size != data_->config_.size) {
+		LOG(Virtual, Debug)
+			<< "Adjusting size to " << data_->config_.size;
+		cfg.size = data_->config_.size;
+		status = Adjusted;
+	}
+
+	if (cfg.bufferCount < 1) {
+		cfg.bufferCount = kBufferCount;
+		status = Adjusted;
+	}
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+	cfg.stride = info.stride(cfg.size.width, 0, 1);
+	cfg.frameSize = info.frameSize(cfg.size, 1);
+
+	return status;
+}
+
+PipelineHandlerVirtual::PipelineHandlerVirtual(CameraManager *manager)
+	: PipelineHandler(manager),
+	  dmaBufAllocator_(DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap |
+			   DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
+			   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf)
+{
+}
+
+std::unique_ptr<CameraConfiguration>
+PipelineHandlerVirtual::generateConfiguration(Camera *camera,
+					      Span<const StreamRole> roles)
+{
+	VirtualCameraData *data = cameraData(camera);
+	std::unique_ptr<CameraConfiguration> config =
+		std::make_unique<VirtualCameraConfiguration>(data);
+
+	if (roles.empty())
+		return config;
+
+	std::map<PixelFormat, std::vector<SizeRange>> formats;
+	for (const PixelFormat &pixelFormat : kPixelFormats)
+		formats[pixelFormat] = { SizeRange(data->config_.size) };
+
+	StreamConfiguration cfg(formats);
+
+	cfg.pixelFormat = formats::NV12;
+	cfg.size = data->config_.size;
+	cfg.bufferCount = kBufferCount;
+
+	config->addConfiguration(cfg);
+
+	config->validate();
+
+	return config;
+}
+
+int PipelineHandlerVirtual::configure(Camera *camera, CameraConfiguration *config)
+{
+	VirtualCameraData *data = cameraData(camera);
+	StreamConfiguration &cfg = config->at(0);
+
+	cfg.setStream(&data->stream_);
+
+	data->sensorInfo_.outputSize = cfg.size;
+
+	return data->ipa_->configure(data->sensorInfo_);
+}
+
+int PipelineHandlerVirtual::exportFrameBuffers([[maybe_unused]] Camera *camera,
+					       Stream *stream,
+					       std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	if (!dmaBufAllocator_.isValid())
+		return -ENODEV;
+
+	const StreamConfiguration &cfg = stream->configuration();
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+	unsigned int count = cfg.bufferCount;
+
+	for (unsigned int i = 0; i < count; i++) {
+		std::string name = "virtual-frame-" + std::to_string(i);
+		SharedFD fd(dmaBufAllocator_.alloc(name.c_str(), cfg.frameSize));
+		if (!fd.isValid())
+			return -ENOMEM;
+
+		/* All planes are stored contiguously in a single dmabuf. */
+		std::vector<FrameBuffer::Plane> planes(info.numPlanes());
+		unsigned int offset = 0;
+
+		for (auto [j, plane] : utils::enumerate(planes)) {
+			plane.fd = fd;
+			plane.offset = offset;
+			plane.length = info.planeSize(cfg.size, j);
+			offset += plane.length;
+		}
+
+		buffers->emplace_back(std::make_unique<FrameBuffer>(planes));
+	}
+
+	return count;
+}
+
+int PipelineHandlerVirtual::start(Camera *camera, [[maybe_unused]] const ControlList *controls)
+{
+	VirtualCameraData *data = cameraData(camera);
+
+	int ret = data->ipa_->start();
+	if (ret)
+		return ret;
+
+	data->sequence_ = 0;
+	data->lastTimestamp_ = 0;
+	data->pendingSensorControls_.clear();
+
+	data->sensorControls_ = ControlList(controls::controls);
+	for (const auto &[id, info] : data->sensorControlInfo_)
+		data->sensorControls_.set(id->id(), info.def());
+
+	data->nextFrame_ = std::chrono::steady_clock::now();
+	if (data->config_.frameRate)
+		data->timer_.start(data->nextFrame_);
+
+	return 0;
+}
+
+void PipelineHandlerVirtual::stopDevice(Camera *camera)
+{
+	VirtualCameraData *data = cameraData(camera);
+
+	data->timer_.stop();
+	data->ipa_->stop();
+	data->cancelRequests();
+	data->patternBuffers_.clear();
+}
+
+int PipelineHandlerVirtual::queueRequestDevice(Camera *camera, Request *request)
+{
+	VirtualCameraData *data = cameraData(camera);
+	FrameBuffer *buffer = request->findBuffer(&data->stream_);
+	if (!buffer) {
+		LOG(Virtual, Error)
+			<< "Attempt to queue request with invalid stream";
+
+		return -ENOENT;
+	}
+
+	data->ipa_->queueRequest(request->sequence(), request->controls());
+	data->queuedRequests_.push(request);
+
+	/* In free-running mode, produce a frame as soon as possible. */
+	if (!data->config_.frameRate && !data->timer_.isRunning())
+		data->scheduleFrame();
+
+	return 0;
+}
+
+int PipelineHandlerVirtual::parseConfiguration(std::vector<VirtualCameraData::Config> *configs)
+{
+	const char *path = utils::secure_getenv("LIBCAMERA_VIRTUAL_CONFIG_FILE");
+	if (!path || *path == '\0')
+		return -ENOENT;
+
+	File file(path);
+	if (!file.open(File::OpenModeFlag::ReadOnly)) {
+		LOG(Virtual, Error)
+			<< "Failed to open configuration file '" << path << "'";
+		return -ENOENT;
+	}
+
+	std::unique_ptr<YamlObject> root = YamlParser::parse(file);
+	if (!root) {
+		LOG(Virtual, Error) << "Failed to parse configuration file";
+		return -EINVAL;
+	}
+
+	const YamlObject &cameras = (*root)["cameras"];
+	if (!cameras.isList()) {
+		LOG(Virtual, Error) << "Configuration file has no cameras list";
+		return -EINVAL;
+	}
+
+	for (const auto &entry : cameras.asList()) {
+		VirtualCameraData::Config config;
+
+		config.id = entry["id"].get<std::string>("Virtual" +
+							 std::to_string(configs->size()));
+		config.size = entry["size"].get<Size>(Size(1920, 1080));
+		config.frameRate = entry["frame_rate"].get<unsigned int>(30);
+		config.controlDelay = entry["control_delay"].get<unsigned int>(2);
+		config.testPattern = entry["test_pattern"].get<bool>(true);
+
+		if (config.size.width < kMinSize.width ||
+		    config.size.height < kMinSize.height ||
+		    config.size.width > kMaxSize.width ||
+		    config.size.height > kMaxSize.height ||
+		    config.size.width % 2 || config.size.height % 2) {
+			LOG(Virtual, Error)
+				<< "Invalid size " << config.size
+				<< " for camera '" << config.id << "'";
+			return -EINVAL;
+		}
+
+		configs->push_back(std::move(config));
+	}
+
+	return 0;
+}
+
+bool PipelineHandlerVirtual::match([[maybe_unused]] DeviceEnumerator *enumerator)
+{
+	if (created_)
+		return false;
+
+	created_ = true;
+
+	std::vector<VirtualCameraData::Config> configs;
+	if (parseConfiguration(&configs) < 0)
+		return false;
+
+	unsigned int registered = 0;
+
+	for (const VirtualCameraData::Config &config : configs) {
+		std::unique_ptr<VirtualCameraData> data =
+			std::make_unique<VirtualCameraData>(this, config);
+
+		if (data->init())
+			continue;
+
+		data->ipa_ = IPAManager::createIPA<ipa::virt::IPAProxyVirtual>(this, 0, 0);
+		if (!data->ipa_) {
+			LOG(Virtual, Error) << "no matching IPA found";
+			return false;
+		}
+
+		data->ipa_->setSensorControls.connect(data.get(),
+						      &VirtualCameraData::setSensorControls);
+		data->ipa_->metadataReady.connect(data.get(),
+						  &VirtualCameraData::metadataReady);
+
+		int ret = data->ipa_->init(IPASettings{ "", config.id },
+					   data->sensorControlInfo_);
+		if (ret) {
+			LOG(Virtual, Error) << "Failed to initialize the IPA";
+			continue;
+		}
+
+		/* Create and register the camera. */
+		std::set<Stream *> streams{ &data->stream_ };
+		std::shared_ptr<Camera> camera =
+			Camera::create(std::move(data), config.id, streams);
+		registerCamera(std::move(camera));
+
+		registered++;
+	}
+
+	return registered > 0;
+}
+
+int VirtualCameraData::init()
+{
+	unsigned int frameRate = config_.frameRate ? config_.frameRate
+						   : kNominalFrameRate;
+
+	frameInterval_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::nanoseconds(1000000000 / frameRate));
+
+	timer_.timeout.connect(this, &VirtualCameraData::frameStart);
+
+	/*
+	 * Describe the virtual sensor with a line length equal to the width,
+	 * and a pixel rate matching the frame rate.
+	 */
+	sensorInfo_.model = "virtual";
+	sensorInfo_.bitsPerPixel = 12;
+	sensorInfo_.activeAreaSize = config_.size;
+	sensorInfo_.analogCrop = Rectangle(config_.size);
+	sensorInfo_.outputSize = config_.size;
+	sensorInfo_.minLineLength = config_.size.width;
+	sensorInfo_.maxLineLength = config_.size.width;
+	sensorInfo_.minFrameLength = config_.size.height;
+	sensorInfo_.maxFrameLength = config_.size.height;
+	sensorInfo_.pixelRate = static_cast<uint64_t>(config_.size.width) *
+				config_.size.height * frameRate;
+
+	int32_t frameDuration = 1000000 / frameRate;
+
+	sensorControlInfo_ = ControlInfoMap({
+		{ &controls::ExposureTime, ControlInfo(1, 1000000, frameDuration / 2) },
+		{ &controls::AnalogueGain, ControlInfo(1.0f, 16.0f, 1.0f) },
+	}, controls::controls);
+
+	/* Initialise the supported controls. */
+	controlInfo_ = ControlInfoMap({
+		{ &controls::AeEnable, ControlInfo(false, true, true) },
+		{ &controls::ExposureTime, ControlInfo(1, frameDuration, frameDuration / 2) },
+		{ &controls::AnalogueGain, ControlInfo(1.0f, 16.0f, 1.0f) },
+	}, controls::controls);
+
+	/* Initialize the camera properties. */
+	properties_.set(properties::Location, properties::CameraLocationExternal);
+	properties_.set(properties::Model, "Virtual");
+	properties_.set(properties::PixelArraySize, config_.size);
+	properties_.set(properties::PixelArrayActiveAreas, { Rectangle(config_.size) });
+
+	return 0;
+}
+
+void VirtualCameraData::scheduleFrame()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	if (config_.frameRate) {
+		/* Skip the frames that were missed if we're running late. */
+		nextFrame_ += frameInterval_;
+		if (nextFrame_ < now)
+			nextFrame_ = now;
+	} else {
+		nextFrame_ = now;
+	}
+
+	timer_.start(nextFrame_);
+}
+
+void VirtualCameraData::frameStart()
+{
+	PipelineHandlerVirtual *pipe =
+		static_cast<PipelineHandlerVirtual *>(this->pipe());
+
+	uint32_t sequence = sequence_++;
+	uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t frameDuration = lastTimestamp_ ? (timestamp - lastTimestamp_) / 1000 : 0;
+	lastTimestamp_ = timestamp;
+
+	/* Apply the sensor controls that take effect at this frame. */
+	while (!pendingSensorControls_.empty() &&
+	       pendingSensorControls_.front().first <= sequence) {
+		sensorControls_.merge(pendingSensorControls_.front().second,
+				      ControlList::MergePolicy::OverwriteExisting);
+		pendingSensorControls_.pop_front();
+	}
+
+	/* The sensor keeps streaming when no request is queued. */
+	if (config_.frameRate)
+		scheduleFrame();
+
+	if (queuedRequests_.empty()) {
+		LOG(Virtual, Debug) << "No request for frame " << sequence;
+		return;
+	}
+
+	Request *request = queuedRequests_.front();
+	queuedRequests_.pop();
+
+	if (!config_.frameRate && !queuedRequests_.empty())
+		scheduleFrame();
+
+	FrameBuffer *buffer = request->findBuffer(&stream_);
+
+	if (config_.testPattern)
+		fillTestPattern(buffer);
+
+	FrameMetadata &frameMetadata = buffer->_d()->metadata();
+	frameMetadata.status = FrameMetadata::FrameSuccess;
+	frameMetadata.sequence = sequence;
+	frameMetadata.timestamp = timestamp;
+	Span<FrameMetadata::Plane> planes = frameMetadata.planes();
+	for (unsigned int i = 0; i < planes.size(); ++i)
+		planes[i].bytesused = buffer->planes()[i].length;
+
+	ControlList metadata(controls::controls);
+	metadata.set(controls::SensorTimestamp, timestamp);
+	metadata.set(controls::ExposureTime,
+		     sensorControls_.get(controls::ExposureTime).value_or(0));
+	metadata.set(controls::AnalogueGain,
+		     sensorControls_.get(controls::AnalogueGain).value_or(1.0f));
+	if (frameDuration)
+		metadata.set(controls::FrameDuration, frameDuration);
+
+	pipe->metadataAvailable(request, metadata);
+	pipe->recordLatency(request, CameraStatistics::StageDequeue, timestamp);
+	pipe->completeBuffer(request, buffer);
+
+	/* Complete the request when the IPA has processed the frame. */
+	processingRequests_.emplace(sequence, request);
+	ipa_->processFrame(sequence, sensorControls_);
+}
+
+void VirtualCameraData::fillTestPattern(FrameBuffer *buffer)
+{
+	/*
+	 * The pattern is static, generate it once per buffer to keep the cost
+	 * of high frame rates low.
+	 */
+	if (!patternBuffers_.insert(buffer).second)
+		return;
+
+	/* White, yellow, cyan, green, magenta, red, blue and black bars. */
+	static constexpr std::array<std::array<uint8_t, 3>, 8> kColours = { {
+		{ 255, 255, 255 }, { 255, 255, 0 }, { 0, 255, 255 }, { 0, 255, 0 },
+		{ 255, 0, 255 }, { 255, 0, 0 }, { 0, 0, 255 }, { 0, 0, 0 },
+	} };
+
+	MappedFrameBuffer mapped(buffer, MappedFrameBuffer::MapFlag::Write);
+	if (!mapped.isValid()) {
+		LOG(Virtual, Error) << "Failed to map buffer";
+		return;
+	}
+
+	const StreamConfiguration &cfg = stream_.configuration();
+	const PixelFormatInfo &info = PixelFormatInfo::info(cfg.pixelFormat);
+	const Size &size = cfg.size;
+	unsigned int barWidth = std::max<unsigned int>(size.width / kColours.size(), 1);
+
+	if (cfg.pixelFormat == formats::XRGB8888) {
+		uint8_t *line = mapped.planes()[0].data();
+		unsigned int stride = info.stride(size.width, 0);
+
+		for (unsigned int x = 0; x < size.width; ++x) {
+			const auto &rgb = kColours[std::min<size_t>(x / barWidth, kColours.size() - 1)];
+			line[x * 4 + 0] = rgb[2];
+			line[x * 4 + 1] = rgb[1];
+			line[x * 4 + 2] = rgb[0];
+			line[x * 4 + 3] = 0xff;
+		}
+
+		for (unsigned int y = 1; y < size.height; ++y)
+			memcpy(line + y * stride, line, size.width * 4);
+
+		return;
+	}
+
+	/* NV12, using BT.601 limited range coefficients. */
+	uint8_t *yPlane = mapped.planes()[0].data();
+	uint8_t *uvPlane = mapped.planes()[1].data();
+	unsigned int yStride = info.stride(size.width, 0);
+	unsigned int uvStride = info.stride(size.width, 1);
+
+	for (unsigned int x = 0; x < size.width; ++x) {
+		const auto &rgb = kColours[std::min<size_t>(x / barWidth, kColours.size() - 1)];
+		int r = rgb[0], g = rgb[1], b = rgb[2];
+
+		yPlane[x] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+		if (x % 2 == 0) {
+			uvPlane[x] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+			uvPlane[x + 1] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+		}
+	}
+
+	for (unsigned int y = 1; y < size.height; ++y)
+		memcpy(yPlane + y * yStride, yPlane, size.width);
+	for (unsigned int y = 1; y < size.height / 2; ++y)
+		memcpy(uvPlane + y * uvStride, uvPlane, size.width);
+}
+
+void VirtualCameraData::cancelRequests()
+{
+	PipelineHandlerVirtual *pipe =
+		static_cast<PipelineHandlerVirtual *>(this->pipe());
+
+	/* The buffers of requests waiting for the IPA are already complete. */
+	while (!processingRequests_.empty()) {
+		pipe->completeRequest(processingRequests_.front().second);
+		processingRequests_.pop();
+	}
+
+	while (!queuedRequests_.empty()) {
+		Request *request = queuedRequests_.front();
+		queuedRequests_.pop();
+
+		for (auto it : request->buffers()) {
+			FrameBuffer *buffer = it.second;
+			buffer->_d()->cancel();
+			pipe->completeBuffer(request, buffer);
+		}
+
+		pipe->completeRequest(request);
+	}
+}
+
+void VirtualCameraData::setSensorControls(unsigned int frame,
+					  const ControlList &sensorControls)
+{
+	/*
+	 * The controls computed for a frame are written during the next frame,
+	 * and take effect after the sensor control delay.
+	 */
+	pendingSensorControls_.emplace_back(frame + 1 + config_.controlDelay,
+					    sensorControls);
+}
+
+void VirtualCameraData::metadataReady(unsigned int frame, const ControlList &metadata)
+{
+	/* Ignore late events for frames cancelled when stopping. */
+	if (processingRequests_.empty() || processingRequests_.front().first != frame)
+		return;
+
+	PipelineHandlerVirtual *pipe =
+		static_cast<PipelineHandlerVirtual *>(this->pipe());
+	Request *request = processingRequests_.front().second;
+	processingRequests_.pop();
+
+	pipe->metadataAvailable(request, metadata);
+
+	int64_t timestamp = request->metadata().get(controls::SensorTimestamp).value_or(0);
+	pipe->recordLatency(request, CameraStatistics::StageIpa, timestamp);
+
+	pipe->completeRequest(request);
+}
+
+REGISTER_PIPELINE_HANDLER(PipelineHandlerVirtual, "virtual")
+
+} /* namespace libcamera */
@@ -7,6 +7,7 @@
 
 #include "libcamera/internal/pipeline_handler.h"
 
+#include <algorithm>
 #include <chrono>
 #include <sys/stat.h>
 #include <sys/sysmacros.h>
@@ -16,10 +17,12 @@
 #include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
+#include <libcamera/control_ids.h>
 #include <libcamera/framebuffer.h>
 #include <libcamera/property_ids.h>
 
 #include "libcamera/internal/camera.h"
+#include "libcamera/internal/camera_group.h"
 #include "libcamera/internal/camera_manager.h"
 #include "libcamera/internal/device_enumerator.h"
 #include "libcamera/internal/framebuffer.h"
@@ -301,6 +304,58 @@ void PipelineHandler::unlockMediaDevices()
  * otherwise
  */
 
+/**
+ * \brief Register the buffers that will be used with \a stream
+ * \param[in] camera The camera
+ * \param[in] stream The stream to register buffers for
+ * \param[in] buffers The buffers to register
+ *
+ * This function informs the pipeline handler of the set of buffers that the
+ * application will queue to \a stream. Pipeline handlers that support
+ * registration shall associate each registered buffer with a device buffer
+ * slot when the camera is started, to avoid buffer cache misses.
+ *
+ * Pipeline handlers shall not keep references to the \a buffers after this
+ * function returns, as the application may destroy them at any time. They may
+ * copy the buffers' planes instead. The registration shall be kept until the
+ * camera is reconfigured or released.
+ *
+ * The only intended caller is Camera::registerFrameBuffers(). The default
+ * implementation doesn't support registration.
+ *
+ * \context This function is called from the CameraManager thread.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -ENOTSUP The pipeline handler doesn't support buffer registration
+ */
+int PipelineHandler::registerFrameBuffers([[maybe_unused]] Camera *camera,
+					  [[maybe_unused]] Stream *stream,
+					  [[maybe_unused]] Span<FrameBuffer *const> buffers)
+{
+	return -ENOTSUP;
+}
+
+/**
+ * \brief Check if a camera supports reprocessing requests
+ * \param[in] camera The camera
+ *
+ * Pipeline handlers that can send RAW frames from memory through their ISP
+ * shall override this function and return true. They shall then handle
+ * requests carrying a Request::reprocessBuffer() by processing that buffer
+ * instead of capturing a new frame from the sensor, and report the
+ * controls::SensorTimestamp of the reprocessed frame in the request metadata.
+ *
+ * The default implementation doesn't support reprocessing.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return True if \a camera supports reprocessing requests, false otherwise
+ */
+bool PipelineHandler::supportsReprocessing([[maybe_unused]] const Camera *camera) const
+{
+	return false;
+}
+
 /**
  * \fn PipelineHandler::start()
  * \brief Start capturing from a group of streams
@@ -328,18 +383,32 @@ void PipelineHandler::unlockMediaDevices()
  */
 void PipelineHandler::stop(Camera *camera)
 {
-	/* Stop the pipeline handler and let the queued requests complete. */
-	stopDevice(camera);
+	/*
+	 * Cancel the waiting requests first, as completing the queued requests
+	 * would otherwise queue them to the device while it is being stopped.
+	 * The cancelled requests are added to the queued requests list, and
+	 * complete in order after the requests queued to the device.
+	 */
+	std::queue<Request *> waitingRequests;
 
-	/* Cancel and signal as complete all waiting requests. */
 	while (!waitingRequests_.empty()) {
 		Request *request = waitingRequests_.front();
 		waitingRequests_.pop();
 
+		if (request->_d()->camera() != camera) {
+			waitingRequests.push(request);
+			continue;
+		}
+
 		request->_d()->cancel();
-		completeRequest(request);
+		doQueueRequest(request);
 	}
 
+	waitingRequests_ = std::move(waitingRequests);
+
+	/* Stop the pipeline handler and let the queued requests complete. */
+	stopDevice(camera);
+
 	/* Make sure no requests are pending. */
 	Camera::Private *data = camera->_d();
 	ASSERT(data->queuedRequests_.empty());
@@ -404,6 +473,13 @@ void PipelineHandler::registerRequest(Request *request)
  * If a Request fails during the preparation phase or if the pipeline handler
  * fails in queuing the request to the hardware the request is cancelled.
  *
+ * Pipeline handlers that can only process a limited number of requests
+ * concurrently, for instance because of a fixed number of internal buffers,
+ * shall set Camera::Private::maxQueuedRequests_ when starting the camera.
+ * Prepared requests beyond that limit are kept waiting, and are queued to the
+ * pipeline handler as earlier requests complete, instead of failing in
+ * queueRequestDevice() because of resource underruns.
+ *
  * Keeping track of queued requests ensures automatic completion of all requests
  * when the pipeline handler is stopped with stop(). Request completion shall be
  * signalled by the pipeline handler using the completeRequest() function.
@@ -419,6 +495,25 @@ void PipelineHandler::queueRequest(Request *request)
 	request->_d()->prepare(300ms);
 }
 
+/**
+ * \brief Queue a batch of requests
+ * \param[in] requests The requests to queue
+ *
+ * This function queues all \a requests to the pipeline handler in order, as if
+ * queueRequest() was called for each of them. It is the counterpart of
+ * Camera::queueRequests() and allows a batch of requests to cross the thread
+ * boundary in a single message.
+ *
+ * \context This function is called from the CameraManager thread.
+ */
+void PipelineHandler::queueRequests(const std::vector<Request *> &requests)
+{
+	LIBCAMERA_TRACEPOINT(request_queue_batch, requests.size());
+
+	for (Request *request : requests)
+		queueRequest(request);
+}
+
 /**
  * \brief Queue one requests to the device
  */
@@ -431,6 +526,7 @@ void PipelineHandler::doQueueRequest(Request *request)
 	data->queuedRequests_.push_back(request);
 
 	request->_d()->sequence_ = data->requestSequence_++;
+	request->_d()->queuedTime_ = utils::clock::now();
 
 	if (request->_d()->cancelled_) {
 		completeRequest(request);
@@ -448,7 +544,8 @@ void PipelineHandler::doQueueRequest(Request *request)
  * \brief Queue prepared requests to the device
  *
  * Iterate the list of waiting requests and queue them to the device one
- * by one if they have been prepared.
+ * by one if they have been prepared, as long as the number of requests queued
+ * to the camera doesn't exceed Camera::Private::maxQueuedRequests_.
  */
 void PipelineHandler::doQueueRequests()
 {
@@ -457,8 +554,21 @@ void PipelineHandler::doQueueRequests()
 		if (!request->_d()->prepared_)
 			break;
 
-		doQueueRequest(request);
+		/* Hold the request back until the pipeline can accept it. */
+		Camera::Private *data = request->_d()->camera()->_d();
+		if (data->maxQueuedRequests_ &&
+		    data->queuedRequests_.size() >= data->maxQueuedRequests_)
+			break;
+
+		/*
+		 * Dequeue the request first, as queuing it may complete
+		 * requests and recursively call this function.
+		 */
 		waitingRequests_.pop();
+		doQueueRequest(request);
+
+		LIBCAMERA_TRACEPOINT(request_queue_depth, waitingRequests_.size(),
+				     data->queuedRequests_.size());
 	}
 }
 
@@ -479,6 +589,30 @@ void PipelineHandler::doQueueRequests()
  * \return 0 on success or a negative error code otherwise
  */
 
+/**
+ * \brief Signal the availability of metadata for a request
+ * \param[in] request The request the metadata belongs to
+ * \param[in] metadata The available metadata
+ *
+ * This function shall be called by pipeline handlers to report metadata for
+ * the \a request as soon as it is available, instead of only storing it in the
+ * request metadata. The \a metadata is merged into the request metadata, and
+ * the Camera::metadataAvailable signal is emitted to notify applications.
+ *
+ * Pipeline handlers should report metadata relevant to a buffer before
+ * completing the buffer with completeBuffer(), to let applications consume
+ * the buffer immediately.
+ *
+ * \context This function shall be called from the CameraManager thread.
+ */
+void PipelineHandler::metadataAvailable(Request *request, const ControlList &metadata)
+{
+	request->metadata().merge(metadata);
+
+	Camera *camera = request->_d()->camera();
+	camera->metadataAvailable.emit(request, metadata);
+}
+
 /**
  * \brief Complete a buffer for a request
  * \param[in] request The request the buffer belongs to
@@ -499,6 +633,20 @@ void PipelineHandler::doQueueRequests()
 bool PipelineHandler::completeBuffer(Request *request, FrameBuffer *buffer)
 {
 	Camera *camera = request->_d()->camera();
+
+	for (const auto &[stream, buf] : request->buffers()) {
+		if (buf == buffer) {
+			camera->_d()->recordBuffer(stream, buffer);
+			break;
+		}
+	}
+
+	/*
+	 * Signal the output fence before notifying the application, as slots
+	 * connected to bufferCompleted may wait on the fence.
+	 */
+	buffer->_d()->signalOutputFence();
+
 	camera->bufferCompleted.emit(request, buffer);
 	return request->_d()->completeBuffer(buffer);
 }
@@ -513,7 +661,9 @@ bool PipelineHandler::completeBuffer(Request *request, FrameBuffer *buffer)
  *
  * This function ensures that requests will be returned to the application in
  * submission order, the pipeline handler may call it on any complete request
- * without any ordering constraint.
+ * without any ordering constraint. If the application has selected
+ * Camera::CompletionOrder::OutOfOrder, the request is returned immediately. Requests held back because the camera had
+ * reached its maximum number of queued requests are then queued to the device.
  *
  * \context This function shall be called from the CameraManager thread.
  */
@@ -525,15 +675,82 @@ void PipelineHandler::completeRequest(Request *request)
 
 	Camera::Private *data = camera->_d();
 
-	while (!data->queuedRequests_.empty()) {
-		Request *req = data->queuedRequests_.front();
-		if (req->status() == Request::RequestPending)
-			break;
+	utils::time_point now = utils::clock::now();
+	data->recordRequest(request, now - request->_d()->queuedTime_);
+
+	const auto sensorTimestamp = request->metadata().get(controls::SensorTimestamp);
+	if (sensorTimestamp && request->status() == Request::RequestComplete) {
+		recordLatency(request, CameraStatistics::StageComplete,
+			      *sensorTimestamp);
+
+		if (data->group_ && !request->buffers().empty()) {
+			const FrameBuffer *buffer = request->buffers().begin()->second;
+			auto sync = data->group_->_d()->synchronise(camera,
+								    buffer->metadata().sequence,
+								    *sensorTimestamp);
+			if (sync) {
+				request->metadata().set(controls::draft::SyncFrame, sync->frame);
+				request->metadata().set(controls::draft::SyncError, sync->error);
+			}
+		}
+	}
+
+	if (data->completionOrder() == Camera::CompletionOrder::OutOfOrder) {
+		auto it = std::find(data->queuedRequests_.begin(),
+				    data->queuedRequests_.end(), request);
+		ASSERT(it != data->queuedRequests_.end());
+		ASSERT(!request->hasPendingBuffers());
 
-		ASSERT(!req->hasPendingBuffers());
-		data->queuedRequests_.pop_front();
-		camera->requestComplete(req);
+		data->queuedRequests_.erase(it);
+		camera->requestComplete(request);
+	} else {
+		while (!data->queuedRequests_.empty()) {
+			Request *req = data->queuedRequests_.front();
+			if (req->status() == Request::RequestPending)
+				break;
+
+			ASSERT(!req->hasPendingBuffers());
+			data->queuedRequests_.pop_front();
+			camera->requestComplete(req);
+		}
 	}
+
+	/* Queue the requests held back by the pipeline capacity. */
+	if (data->maxQueuedRequests_ && !waitingRequests_.empty())
+		doQueueRequests();
+}
+
+/**
+ * \brief Record the latency of a frame processing stage
+ * \param[in] request The request the frame belongs to
+ * \param[in] stage The frame processing stage that has completed
+ * \param[in] timestamp The sensor timestamp of the frame, in nanoseconds
+ *
+ * Pipeline handlers shall call this function when a frame reaches the end of
+ * a processing \a stage, to record the latency from the sensor \a timestamp in
+ * the camera statistics. The timestamp shall be measured against the
+ * CLOCK_MONOTONIC clock, as is the case for V4L2 buffer timestamps.
+ *
+ * The CameraStatistics::StageComplete stage is recorded by completeRequest()
+ * for requests that carry the controls::SensorTimestamp metadata.
+ *
+ * \context This function shall be called from the CameraManager thread.
+ */
+void PipelineHandler::recordLatency(Request *request,
+				    CameraStatistics::Stage stage,
+				    uint64_t timestamp)
+{
+	if (!timestamp)
+		return;
+
+	auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		utils::clock::now().time_since_epoch());
+	std::chrono::nanoseconds latency = now - std::chrono::nanoseconds(timestamp);
+	if (latency.count() < 0)
+		return;
+
+	Camera *camera = request->_d()->camera();
+	camera->_d()->recordLatency(stage, latency);
 }
 
 /**
@@ -605,9 +822,14 @@ void PipelineHandler::registerCamera(std::shared_ptr<Camera> camera)
 {
 	cameras_.push_back(camera);
 
-	if (mediaDevices_.empty())
-		LOG(Pipeline, Fatal)
-			<< "Registering camera with no media devices!";
+	if (mediaDevices_.empty()) {
+		/*
+		 * Virtual cameras have no media device, and thus no system
+		 * devices to report.
+		 */
+		manager_->_d()->addCamera(std::move(camera));
+		return;
+	}
 
 	/*
 	 * Walk the entity list and map the devnums of all capture video nodes
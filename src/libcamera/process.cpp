@@ -12,9 +12,12 @@
 #include <fcntl.h>
 #include <iostream>
 #include <list>
+#include <memory>
+#include <sched.h>
 #include <signal.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -220,20 +223,135 @@ Process::~Process()
 	/* \todo wait for child process to exit */
 }
 
+namespace {
+
+#ifndef __NR_close_range
+#define __NR_close_range	436
+#endif
+
+/* Size of the stack of the child until it calls execve() */
+constexpr size_t kChildStackSize = 64 * 1024;
+
+struct ChildArgs {
+	const char *path;
+	char *const *argv;
+	char *const *envp;
+	/* Sorted file descriptors to keep open */
+	const int *fds;
+	size_t numFds;
+	const sigset_t *sigmask;
+	/* Set by the child if it fails to execute */
+	int error;
+};
+
+/*
+ * Close all file descriptors in the [first, last] range by iterating over
+ * /proc/self/fd, for kernels that don't support close_range(). Only raw system
+ * calls are used, as the child shares the memory of the parent.
+ */
+void closeFdsFallback(unsigned int first, unsigned int last)
+{
+	int dfd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dfd < 0)
+		return;
+
+	alignas(8) char buffer[1024];
+	long size;
+
+	while ((size = syscall(SYS_getdents64, dfd, buffer, sizeof(buffer))) > 0) {
+		for (long offset = 0; offset < size;) {
+			/* The glibc dirent64 matches the kernel linux_dirent64. */
+			const struct dirent64 *ent =
+				reinterpret_cast<const struct dirent64 *>(buffer + offset);
+
+			offset += ent->d_reclen;
+
+			unsigned int fd = 0;
+			const char *c = ent->d_name;
+			for (; *c >= '0' && *c <= '9'; ++c)
+				fd = fd * 10 + *c - '0';
+			if (*c || c == ent->d_name)
+				continue;
+
+			if (fd >= first && fd <= last && static_cast<int>(fd) != dfd)
+				close(fd);
+		}
+	}
+
+	close(dfd);
+}
+
+void closeFds(unsigned int first, unsigned int last)
+{
+	if (first > last)
+		return;
+
+	if (syscall(__NR_close_range, first, last, 0) < 0)
+		closeFdsFallback(first, last);
+}
+
+/*
+ * Entry point of the child process. As the child runs in the memory of the
+ * parent until it calls execve(), it must not modify any state of the parent
+ * and may only call async-signal-safe functions.
+ */
+int childMain(void *data)
+{
+	ChildArgs *args = static_cast<ChildArgs *>(data);
+
+	/*
+	 * Reset the signal handlers installed by the parent, which may not
+	 * expect to run in the child, before unblocking signals.
+	 */
+	for (int sig = 1; sig < NSIG; ++sig) {
+		struct sigaction sa;
+		if (sigaction(sig, nullptr, &sa) ||
+		    sa.sa_handler == SIG_IGN || sa.sa_handler == SIG_DFL)
+			continue;
+
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = SIG_DFL;
+		sigaction(sig, &sa, nullptr);
+	}
+
+	sigprocmask(SIG_SETMASK, args->sigmask, nullptr);
+
+	unsigned int first = 0;
+	for (size_t i = 0; i < args->numFds; ++i) {
+		unsigned int fd = args->fds[i];
+		if (fd > first)
+			closeFds(first, fd - 1);
+		first = std::max(first, fd + 1);
+	}
+	closeFds(first, ~0U);
+
+	execve(args->path, args->argv, args->envp);
+
+	args->error = errno;
+	_exit(EXIT_FAILURE);
+}
+
+} /* namespace */
+
 /**
- * \brief Fork and exec a process, and close fds
+ * \brief Spawn a process, and close fds
  * \param[in] path Path to executable
  * \param[in] args Arguments to pass to executable (optional)
  * \param[in] fds Vector of file descriptors to keep open (optional)
  *
- * Fork a process, and exec the executable specified by path. Prior to
- * exec'ing, but after forking, all file descriptors except for those
+ * Spawn a process in new user and network namespaces, and exec the executable
+ * specified by path. Prior to exec'ing, all file descriptors except for those
  * specified in fds will be closed.
  *
+ * The child is created with clone() sharing the memory of the parent until it
+ * execs, instead of with fork(). Its creation time thus doesn't depend on the
+ * memory size of the parent, and a failure to exec the executable is reported
+ * synchronously.
+ *
  * All indexes of args will be incremented by 1 before being fed to exec(),
  * so args[0] should not need to be equal to path.
  *
- * \return Zero on successful fork, exec, and closing the file descriptors,
+ * \return Zero on successful spawn, exec, and closing the file descriptors,
  * or a negative error code otherwise
  */
 int Process::start(const std::string &path,
@@ -245,77 +363,73 @@ int Process::start(const std::string &path,
 	if (running_)
 		return 0;
 
-	int childPid = fork();
-	if (childPid == -1) {
-		ret = -errno;
-		LOG(Process, Error) << "Failed to fork: " << strerror(-ret);
-		return ret;
-	} else if (childPid) {
-		pid_ = childPid;
-		ProcessManager::instance()->registerProcess(this);
-
-		running_ = true;
-
-		return 0;
-	} else {
-		if (isolate())
-			_exit(EXIT_FAILURE);
-
-		closeAllFdsExcept(fds);
-
-		const char *file = utils::secure_getenv("LIBCAMERA_LOG_FILE");
-		if (file && strcmp(file, "syslog"))
-			unsetenv("LIBCAMERA_LOG_FILE");
-
-		const char **argv = new const char *[args.size() + 2];
-		unsigned int len = args.size();
-		argv[0] = path.c_str();
-		for (unsigned int i = 0; i < len; i++)
-			argv[i+1] = args[i].c_str();
-		argv[len+1] = nullptr;
-
-		execv(path.c_str(), (char **)argv);
-
-		exit(EXIT_FAILURE);
+	/*
+	 * Prepare everything the child needs before spawning it, as it can't
+	 * allocate memory.
+	 */
+	std::vector<char *> argv;
+	argv.reserve(args.size() + 2);
+	argv.push_back(const_cast<char *>(path.c_str()));
+	for (const std::string &arg : args)
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	const char *file = utils::secure_getenv("LIBCAMERA_LOG_FILE");
+	bool dropLogFile = file && strcmp(file, "syslog");
+
+	std::vector<char *> envp;
+	for (char **env = environ; *env; ++env) {
+		if (dropLogFile && !strncmp(*env, "LIBCAMERA_LOG_FILE=", 19))
+			continue;
+		envp.push_back(*env);
 	}
-}
+	envp.push_back(nullptr);
 
-void Process::closeAllFdsExcept(const std::vector<int> &fds)
-{
-	std::vector<int> v(fds);
-	sort(v.begin(), v.end());
+	std::vector<int> sortedFds(fds);
+	std::sort(sortedFds.begin(), sortedFds.end());
 
-	DIR *dir = opendir("/proc/self/fd");
-	if (!dir)
-		return;
+	std::unique_ptr<uint8_t[]> stack = std::make_unique<uint8_t[]>(kChildStackSize);
 
-	int dfd = dirfd(dir);
+	sigset_t allSignals;
+	sigset_t oldMask;
+	sigfillset(&allSignals);
+	pthread_sigmask(SIG_SETMASK, &allSignals, &oldMask);
 
-	struct dirent *ent;
-	while ((ent = readdir(dir)) != nullptr) {
-		char *endp;
-		int fd = strtoul(ent->d_name, &endp, 10);
-		if (*endp)
-			continue;
+	ChildArgs childArgs = {
+		path.c_str(), argv.data(), envp.data(),
+		sortedFds.data(), sortedFds.size(), &oldMask, 0,
+	};
 
-		if (fd >= 0 && fd != dfd &&
-		    !std::binary_search(v.begin(), v.end(), fd))
-			close(fd);
+	/*
+	 * The parent is suspended until the child execs or exits. The new user
+	 * and network namespaces isolate the child.
+	 */
+	int childPid = clone(childMain, stack.get() + kChildStackSize,
+			     CLONE_VM | CLONE_VFORK | CLONE_NEWUSER |
+			     CLONE_NEWNET | SIGCHLD,
+			     &childArgs);
+	if (childPid == -1) {
+		ret = -errno;
+		pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
+		LOG(Process, Error) << "Failed to spawn: " << strerror(-ret);
+		return ret;
 	}
 
-	closedir(dir);
-}
+	pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
 
-int Process::isolate()
-{
-	int ret = unshare(CLONE_NEWUSER | CLONE_NEWNET);
-	if (ret) {
-		ret = -errno;
-		LOG(Process, Error) << "Failed to unshare execution context: "
-				    << strerror(-ret);
+	if (childArgs.error) {
+		ret = -childArgs.error;
+		LOG(Process, Error)
+			<< "Failed to execute " << path << ": " << strerror(-ret);
+		waitpid(childPid, nullptr, 0);
 		return ret;
 	}
 
+	pid_ = childPid;
+	ProcessManager::instance()->registerProcess(this);
+
+	running_ = true;
+
 	return 0;
 }
 
@@ -0,0 +1,189 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Unpacking of packed RAW pixel data
+ */
+
+#include "libcamera/internal/raw_unpack.h"
+
+#include <algorithm>
+#include <errno.h>
+
+/**
+ * \file raw_unpack.h
+ * \brief Unpacking of packed RAW pixel data
+ *
+ * Sensors and CSI-2 receivers commonly store RAW pixels in packed formats to
+ * save memory bandwidth. The functions in this file unpack lines of those
+ * formats to 16-bit values, one per pixel, in host byte order. The values are
+ * right-aligned, and can optionally be shifted left for instance to scale them
+ * to the 16-bit range.
+ */
+
+namespace libcamera {
+
+namespace raw {
+
+/**
+ * \brief Unpack a line of CSI-2 packed 10-bit pixels
+ * \param[in] src The packed pixels
+ * \param[out] dst The unpacked pixels
+ * \param[in] pixels The number of pixels to unpack
+ * \param[in] shift The number of bits to shift the unpacked values left by
+ *
+ * CSI-2 packed 10-bit pixels are stored in groups of 4 pixels in 5 bytes, the
+ * first 4 bytes holding the 8 most significant bits of each pixel and the
+ * last byte the 2 least significant bits of the 4 pixels. The \a src buffer
+ * shall hold complete groups, while \a pixels doesn't need to be a multiple of
+ * 4.
+ */
+void unpack10P(const uint8_t *src, uint16_t *dst, unsigned int pixels,
+	       unsigned int shift)
+{
+	unsigned int x;
+
+	for (x = 0; x + 4 <= pixels; x += 4, src += 5, dst += 4) {
+		const unsigned int lsb = src[4];
+
+		dst[0] = ((src[0] << 2) | (lsb & 0x03)) << shift;
+		dst[1] = ((src[1] << 2) | ((lsb >> 2) & 0x03)) << shift;
+		dst[2] = ((src[2] << 2) | ((lsb >> 4) & 0x03)) << shift;
+		dst[3] = ((src[3] << 2) | (lsb >> 6)) << shift;
+	}
+
+	for (unsigned int i = 0; x < pixels; x++, i++)
+		dst[i] = ((src[i] << 2) | ((src[4] >> (i * 2)) & 0x03)) << shift;
+}
+
+/**
+ * \brief Unpack a line of CSI-2 packed 12-bit pixels
+ * \param[in] src The packed pixels
+ * \param[out] dst The unpacked pixels
+ * \param[in] pixels The number of pixels to unpack
+ * \param[in] shift The number of bits to shift the unpacked values left by
+ *
+ * CSI-2 packed 12-bit pixels are stored in groups of 2 pixels in 3 bytes, the
+ * first 2 bytes holding the 8 most significant bits of each pixel and the
+ * last byte the 4 least significant bits of the 2 pixels. The \a src buffer
+ * shall hold complete groups, while \a pixels doesn't need to be even.
+ */
+void unpack12P(const uint8_t *src, uint16_t *dst, unsigned int pixels,
+	       unsigned int shift)
+{
+	unsigned int x;
+
+	for (x = 0; x + 2 <= pixels; x += 2, src += 3, dst += 2) {
+		const unsigned int lsb = src[2];
+
+		dst[0] = ((src[0] << 4) | (lsb & 0x0f)) << shift;
+		dst[1] = ((src[1] << 4) | (lsb >> 4)) << shift;
+	}
+
+	if (x < pixels)
+		dst[0] = ((src[0] << 4) | (src[2] & 0x0f)) << shift;
+}
+
+/**
+ * \brief Unpack a line of IPU3 packed 10-bit pixels
+ * \param[in] src The packed pixels
+ * \param[out] dst The unpacked pixels
+ * \param[in] pixels The number of pixels to unpack
+ * \param[in] shift The number of bits to shift the unpacked values left by
+ *
+ * IPU3 packed 10-bit pixels are stored in blocks of 25 pixels in 32 bytes, as
+ * a little-endian stream of 10-bit values followed by 6 bits of padding. The
+ * \a src buffer shall hold complete blocks, while \a pixels doesn't need to be
+ * a multiple of 25.
+ */
+void unpackIPU3(const uint8_t *src, uint16_t *dst, unsigned int pixels,
+		unsigned int shift)
+{
+	for (unsigned int x = 0; x < pixels; x += 25, src += 32) {
+		const unsigned int count = std::min(pixels - x, 25U);
+
+		for (unsigned int i = 0; i < count; i++) {
+			const unsigned int bit = i * 10;
+			const unsigned int value = src[bit / 8] | (src[bit / 8 + 1] << 8);
+
+			*dst++ = ((value >> (bit % 8)) & 0x3ff) << shift;
+		}
+	}
+}
+
+/**
+ * \brief Unpack a line of RAW pixels
+ * \param[in] format The format of the pixels
+ * \param[in] src The pixels
+ * \param[out] dst The unpacked pixels
+ * \param[in] pixels The number of pixels to unpack
+ * \param[in] shift The number of bits to shift the unpacked values left by
+ *
+ * Unpack \a pixels pixels in the given \a format, dispatching to the
+ * implementation of the format packing. Unpacked formats are converted to
+ * 16-bit values as well, which lets callers handle all RAW formats the same
+ * way.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL The format isn't supported
+ */
+int unpackLine(const BayerFormat &format, const uint8_t *src, uint16_t *dst,
+	       unsigned int pixels, unsigned int shift)
+{
+	switch (format.packing) {
+	case BayerFormat::Packing::CSI2:
+		if (format.bitDepth == 10) {
+			unpack10P(src, dst, pixels, shift);
+			return 0;
+		}
+
+		if (format.bitDepth == 12) {
+			unpack12P(src, dst, pixels, shift);
+			return 0;
+		}
+
+		return -EINVAL;
+
+	case BayerFormat::Packing::IPU3:
+		if (format.bitDepth != 10)
+			return -EINVAL;
+
+		unpackIPU3(src, dst, pixels, shift);
+		return 0;
+
+	case BayerFormat::Packing::None:
+		if (format.bitDepth == 8) {
+			for (unsigned int x = 0; x < pixels; x++)
+				dst[x] = src[x] << shift;
+			return 0;
+		}
+
+		if (format.bitDepth > 16)
+			return -EINVAL;
+
+		for (unsigned int x = 0; x < pixels; x++) {
+			uint16_t value;
+			memcpy(&value, src + x * 2, sizeof(value));
+			dst[x] = value << shift;
+		}
+		return 0;
+
+	default:
+		return -EINVAL;
+	}
+}
+
+/**
+ * \fn unpackMsb10P()
+ * \brief Extract the 8 most significant bits of CSI-2 packed 10-bit pixels
+ * \param[in] src The packed pixels
+ * \param[out] dst The 8 most significant bits of the pixels
+ * \param[in] pixels The number of pixels, a multiple of 4
+ *
+ * This function is meant for processing that works on 8-bit values, and skips
+ * the least significant bits altogether.
+ */
+
+} /* namespace raw */
+
+} /* namespace libcamera */
@@ -7,8 +7,15 @@
 
 #include "libcamera/internal/request.h"
 
+#include <algorithm>
+#include <array>
+#include <errno.h>
 #include <map>
 #include <sstream>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include <libcamera/base/log.h>
 
@@ -92,10 +99,12 @@ bool Request::Private::completeBuffer(FrameBuffer *buffer)
 {
 	LIBCAMERA_TRACEPOINT(request_complete_buffer, this, buffer);
 
-	int ret = pending_.erase(buffer);
-	ASSERT(ret == 1);
+	auto it = std::find(pending_.begin(), pending_.end(), buffer);
+	ASSERT(it != pending_.end());
+	pending_.erase(it);
 
 	buffer->_d()->setRequest(nullptr);
+	buffer->_d()->signalOutputFence();
 
 	if (buffer->metadata().status == FrameMetadata::FrameCancelled)
 		cancelled_ = true;
@@ -130,13 +139,13 @@ void Request::Private::doCancelRequest()
 
 	for (FrameBuffer *buffer : pending_) {
 		buffer->_d()->cancel();
+		buffer->_d()->signalOutputFence();
 		camera_->bufferCompleted.emit(request, buffer);
 	}
 
 	cancelled_ = true;
 	pending_.clear();
-	notifiers_.clear();
-	timer_.reset();
+	unwatchFences();
 }
 
 /**
@@ -168,9 +177,23 @@ void Request::Private::reset()
 	sequence_ = 0;
 	cancelled_ = false;
 	prepared_ = false;
+	reprocessBuffer_ = nullptr;
 	pending_.clear();
-	notifiers_.clear();
-	timer_.reset();
+	unwatchFences();
+}
+
+/**
+ * \brief Reserve storage for the request buffers
+ * \param[in] numBuffers The number of buffers the request is expected to hold
+ *
+ * Pre-allocate the internal storage used to track \a numBuffers pending
+ * buffers. The storage is preserved by reset(), which allows requests that are
+ * reused with the same buffers to be queued without any memory allocation.
+ */
+void Request::Private::reserve(unsigned int numBuffers)
+{
+	pending_.reserve(numBuffers);
+	fenced_.reserve(numBuffers);
 }
 
 /*
@@ -215,24 +238,18 @@ void Request::Private::emitPrepareCompleted()
  */
 void Request::Private::prepare(std::chrono::milliseconds timeout)
 {
-	/* Create and connect one notifier for each synchronization fence. */
 	for (FrameBuffer *buffer : pending_) {
-		const Fence *fence = buffer->_d()->fence();
-		if (!fence)
-			continue;
-
-		std::unique_ptr<EventNotifier> notifier =
-			std::make_unique<EventNotifier>(fence->fd().get(),
-							EventNotifier::Read);
-
-		notifier->activated.connect(this, [this, buffer] {
-							notifierActivated(buffer);
-					    });
+		if (buffer->_d()->fence())
+			fenced_.push_back(buffer);
+	}
 
-		notifiers_[buffer] = std::move(notifier);
+	if (fenced_.empty()) {
+		emitPrepareCompleted();
+		return;
 	}
 
-	if (notifiers_.empty()) {
+	if (!watchFences()) {
+		cancel();
 		emitPrepareCompleted();
 		return;
 	}
@@ -263,35 +280,105 @@ void Request::Private::prepare(std::chrono::milliseconds timeout)
  * if they have failed preparing.
  */
 
-void Request::Private::notifierActivated(FrameBuffer *buffer)
+/*
+ * Wait for all the fences of the request through a single epoll instance,
+ * monitored by one event notifier, instead of registering one notifier per
+ * fence with the event dispatcher. The epoll instance is created on first use
+ * and kept for the lifetime of the request.
+ */
+bool Request::Private::watchFences()
+{
+	if (!fenceWaitFd_.isValid()) {
+		int fd = epoll_create1(EPOLL_CLOEXEC);
+		if (fd < 0) {
+			int ret = errno;
+			LOG(Request, Error)
+				<< "Failed to create fence wait queue: "
+				<< strerror(ret);
+			return false;
+		}
+
+		fenceWaitFd_ = UniqueFD(fd);
+	}
+
+	for (FrameBuffer *buffer : fenced_) {
+		struct epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.ptr = buffer;
+
+		int ret = epoll_ctl(fenceWaitFd_.get(), EPOLL_CTL_ADD,
+				    buffer->_d()->fence()->fd().get(), &event);
+		if (ret < 0) {
+			ret = errno;
+			LOG(Request, Error)
+				<< "Failed to wait on fence: " << strerror(ret);
+			return false;
+		}
+	}
+
+	fenceNotifier_ = std::make_unique<EventNotifier>(fenceWaitFd_.get(),
+							 EventNotifier::Read);
+	fenceNotifier_->activated.connect(this, &Request::Private::fencesActivated);
+
+	return true;
+}
+
+void Request::Private::unwatchFences()
+{
+	for (FrameBuffer *buffer : fenced_) {
+		const Fence *fence = buffer->_d()->fence();
+		if (fence)
+			epoll_ctl(fenceWaitFd_.get(), EPOLL_CTL_DEL,
+				  fence->fd().get(), nullptr);
+	}
+
+	fenced_.clear();
+	fenceNotifier_.reset();
+	timer_.reset();
+}
+
+void Request::Private::fencesActivated()
 {
-	/* Close the fence if successfully signalled. */
-	ASSERT(buffer);
-	buffer->releaseFence();
+	std::array<struct epoll_event, 8> events;
 
-	/* Remove the entry from the map and check if other fences are pending. */
-	auto it = notifiers_.find(buffer);
-	ASSERT(it != notifiers_.end());
-	notifiers_.erase(it);
+	int ret = epoll_wait(fenceWaitFd_.get(), events.data(), events.size(), 0);
+	if (ret <= 0)
+		return;
 
 	Request *request = _o<Request>();
-	LOG(Request, Debug)
-		<< "Request " << request->cookie() << " buffer " << buffer
-		<< " fence signalled";
 
-	if (!notifiers_.empty())
+	for (int i = 0; i < ret; ++i) {
+		FrameBuffer *buffer = static_cast<FrameBuffer *>(events[i].data.ptr);
+
+		/* Stop watching and close the fence as it has been signalled. */
+		epoll_ctl(fenceWaitFd_.get(), EPOLL_CTL_DEL,
+			  buffer->_d()->fence()->fd().get(), nullptr);
+		buffer->releaseFence();
+
+		auto it = std::find(fenced_.begin(), fenced_.end(), buffer);
+		ASSERT(it != fenced_.end());
+		fenced_.erase(it);
+
+		LOG(Request, Debug)
+			<< "Request " << request->cookie() << " buffer " << buffer
+			<< " fence signalled";
+	}
+
+	if (!fenced_.empty())
 		return;
 
-	/* All fences completed, delete the timer and emit the prepared signal. */
-	timer_.reset();
+	/*
+	 * All fences completed, delete the notifier and the timer and emit the
+	 * prepared signal.
+	 */
+	unwatchFences();
 	emitPrepareCompleted();
 }
 
 void Request::Private::timeout()
 {
 	/* A timeout can only happen if there are fences not yet signalled. */
-	ASSERT(!notifiers_.empty());
-	notifiers_.clear();
+	ASSERT(!fenced_.empty());
 
 	Request *request = _o<Request>();
 	LOG(Request, Debug) << "Request prepare timeout: " << request->cookie();
@@ -389,7 +476,7 @@ void Request::reuse(ReuseFlag flags)
 		for (auto pair : bufferMap_) {
 			FrameBuffer *buffer = pair.second;
 			buffer->_d()->setRequest(this);
-			_d()->pending_.insert(buffer);
+			_d()->pending_.push_back(buffer);
 		}
 	} else {
 		bufferMap_.clear();
@@ -474,7 +561,7 @@ int Request::addBuffer(const Stream *stream, FrameBuffer *buffer,
 	}
 
 	buffer->_d()->setRequest(this);
-	_d()->pending_.insert(buffer);
+	_d()->pending_.push_back(buffer);
 	bufferMap_[stream] = buffer;
 
 	/*
@@ -492,6 +579,62 @@ int Request::addBuffer(const Stream *stream, FrameBuffer *buffer,
 	return 0;
 }
 
+/**
+ * \brief Export an output fence for the buffer of a stream
+ * \param[in] stream The stream whose buffer the fence is exported for
+ *
+ * Create an output fence that is signalled when the buffer associated with
+ * \a stream in this request completes. The fence is signalled from the
+ * pipeline handler thread as soon as the buffer is completed, before the
+ * bufferCompleted and requestCompleted signals are emitted. Consumers can thus
+ * wait on the fence directly, typically from a dedicated thread or in their
+ * own event loop, without being scheduled by the thread that handles the
+ * camera signals.
+ *
+ * The fence is backed by an eventfd that becomes readable once signalled. It
+ * is signalled regardless of the buffer completion status, which shall be
+ * checked through the buffer metadata once the fence has been signalled.
+ *
+ * This function shall be called after adding the buffer to the request with
+ * addBuffer(), and before queuing the request. A new fence needs to be
+ * exported every time the request is queued. Exporting a new fence for a
+ * buffer replaces the previous one, which will then never be signalled.
+ *
+ * \note The fence is not a kernel sync_file, as V4L2 doesn't support output
+ * fences. It can't be imported by graphics APIs as a sync_file.
+ *
+ * \return The output fence, or nullptr if \a stream has no buffer in the
+ * request or the fence can't be created
+ */
+std::unique_ptr<Fence> Request::exportFence(const Stream *stream)
+{
+	FrameBuffer *buffer = findBuffer(stream);
+	if (!buffer) {
+		LOG(Request, Error) << "No buffer for stream";
+		return nullptr;
+	}
+
+	UniqueFD fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	if (!fd.isValid()) {
+		int ret = errno;
+		LOG(Request, Error)
+			<< "Failed to create output fence: " << strerror(ret);
+		return nullptr;
+	}
+
+	UniqueFD fenceFd(dup(fd.get()));
+	if (!fenceFd.isValid()) {
+		int ret = errno;
+		LOG(Request, Error)
+			<< "Failed to duplicate output fence: " << strerror(ret);
+		return nullptr;
+	}
+
+	buffer->_d()->setOutputFence(std::move(fd));
+
+	return std::make_unique<Fence>(std::move(fenceFd));
+}
+
 /**
  * \var Request::bufferMap_
  * \brief Mapping of streams to buffers for this request
@@ -516,6 +659,52 @@ FrameBuffer *Request::findBuffer(const Stream *stream) const
 	return it->second;
 }
 
+/**
+ * \brief Turn the request into a reprocessing request
+ * \param[in] buffer The RAW frame buffer to reprocess
+ *
+ * Reprocessing requests don't capture a new frame from the sensor. They
+ * instead send a previously captured RAW frame \a buffer through the ISP to
+ * produce the processed streams of the request. This allows, for instance,
+ * zero shutter lag still capture from a ring of RAW frames captured while
+ * streaming a preview.
+ *
+ * The \a buffer shall have been captured from the RAW stream of the camera in
+ * the current configuration, and its metadata shall still be valid. The request
+ * shall not contain a buffer for the RAW stream. The \a buffer is only read,
+ * it is not completed with the request and stays owned by the application,
+ * which shall not modify it until the request completes.
+ *
+ * Reprocessing requests are only supported by cameras for which
+ * Camera::supportsReprocessing() returns true.
+ *
+ * The reprocessing buffer is cleared when the request is reused.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL The buffer is nullptr
+ */
+int Request::setReprocessBuffer(FrameBuffer *buffer)
+{
+	if (!buffer) {
+		LOG(Request, Error) << "Invalid reprocessing buffer";
+		return -EINVAL;
+	}
+
+	_d()->reprocessBuffer_ = buffer;
+
+	return 0;
+}
+
+/**
+ * \brief Retrieve the RAW frame buffer reprocessed by the request
+ * \return The RAW frame buffer to reprocess, or nullptr if the request is not a
+ * reprocessing request
+ */
+FrameBuffer *Request::reprocessBuffer() const
+{
+	return _d()->reprocessBuffer_;
+}
+
 /**
  * \fn Request::metadata()
  * \brief Retrieve the request's metadata
@@ -537,6 +726,10 @@ FrameBuffer *Request::findBuffer(const Stream *stream) const
  * of any images in the stream. The sequence number is stored as an unsigned
  * integer and will wrap when overflowed.
  *
+ * When the camera completes requests out of order, as selected by
+ * Camera::setCompletionOrder(), applications can use the sequence number to
+ * restore the queuing order.
+ *
  * \return The request sequence number
  */
 uint32_t Request::sequence() const
@@ -9,16 +9,25 @@
 #include "libcamera/internal/media_device.h"
 
 #include <algorithm>
+#include <ctype.h>
 #include <float.h>
+#include <fstream>
 #include <iomanip>
 #include <limits.h>
+#include <map>
 #include <math.h>
+#include <sstream>
+#include <stdio.h>
 #include <string.h>
+#include <sys/utsname.h>
+#include <unistd.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/orientation.h>
 #include <libcamera/property_ids.h>
 
+#include <libcamera/base/file.h>
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/bayer_format.h"
@@ -26,6 +35,7 @@
 #include "libcamera/internal/camera_sensor_properties.h"
 #include "libcamera/internal/formats.h"
 #include "libcamera/internal/sysfs.h"
+#include "libcamera/internal/yaml_parser.h"
 
 /**
  * \file camera_sensor.h
@@ -36,6 +46,178 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(CameraSensor)
 
+namespace {
+
+/*
+ * The sensor formats cache stores the media bus codes and sizes enumerated
+ * from a sensor in one file per sensor entity. The cache key identifies the
+ * kernel and the media device, the cached formats are discarded when any of
+ * them changes.
+ */
+std::string formatsCacheKey(const MediaEntity *entity)
+{
+	const MediaDevice *media = entity->device();
+	struct utsname uts;
+	std::stringstream key;
+
+	if (uname(&uts) == 0)
+		key << uts.release;
+
+	key << "/" << media->driver() << "/" << media->model()
+	    << "/" << utils::hex(media->version())
+	    << "/" << utils::hex(media->hwRevision())
+	    << "/" << entity->name();
+
+	return key.str();
+}
+
+/*
+ * The in-memory formats cache stores the formats of all sensors initialized in
+ * the process, to avoid enumerating them again when cameras are recreated, for
+ * instance when the camera manager is restarted.
+ */
+struct FormatsMemoryCache {
+	Mutex mutex;
+	std::map<std::string, V4L2Subdevice::Formats> formats LIBCAMERA_TSA_GUARDED_BY(mutex);
+};
+
+FormatsMemoryCache &formatsMemoryCache()
+{
+	static FormatsMemoryCache cache;
+	return cache;
+}
+
+bool lookupFormatsMemoryCache(const std::string &key,
+			      V4L2Subdevice::Formats *formats)
+{
+	FormatsMemoryCache &cache = formatsMemoryCache();
+	MutexLocker locker(cache.mutex);
+
+	auto it = cache.formats.find(key);
+	if (it == cache.formats.end())
+		return false;
+
+	*formats = it->second;
+	return true;
+}
+
+void storeFormatsMemoryCache(const std::string &key,
+			     const V4L2Subdevice::Formats &formats)
+{
+	FormatsMemoryCache &cache = formatsMemoryCache();
+	MutexLocker locker(cache.mutex);
+
+	cache.formats[key] = formats;
+}
+
+std::string formatsCachePath(const MediaEntity *entity)
+{
+	const char *dir = utils::secure_getenv("LIBCAMERA_SENSOR_CACHE_DIR");
+	if (!dir || !*dir)
+		return {};
+
+	std::string name = entity->name();
+	std::replace_if(name.begin(), name.end(),
+			[](char c) { return !isalnum(c); }, '_');
+
+	return std::string(dir) + "/" + name + ".yaml";
+}
+
+bool readFormatsCache(const std::string &path, const std::string &key,
+		      V4L2Subdevice::Formats *formats)
+{
+	File file(path);
+	if (!file.open(File::OpenModeFlag::ReadOnly))
+		return false;
+
+	std::unique_ptr<YamlObject> root = YamlParser::parse(file);
+	if (!root || !root->isDictionary())
+		return false;
+
+	if ((*root)["key"].get<std::string>() != key)
+		return false;
+
+	V4L2Subdevice::Formats cached;
+
+	for (const YamlObject &entry : (*root)["formats"].asList()) {
+		std::optional<uint32_t> code = entry["code"].get<uint32_t>();
+		if (!code)
+			return false;
+
+		std::vector<SizeRange> ranges;
+
+		for (const YamlObject &range : entry["sizes"].asList()) {
+			std::optional<std::vector<uint32_t>> values =
+				range.getList<uint32_t>();
+			if (!values || values->size() != 6)
+				return false;
+
+			const std::vector<uint32_t> &v = *values;
+			ranges.emplace_back(Size(v[0], v[1]), Size(v[2], v[3]),
+					    v[4], v[5]);
+		}
+
+		if (ranges.empty())
+			return false;
+
+		cached[*code] = std::move(ranges);
+	}
+
+	if (cached.empty())
+		return false;
+
+	*formats = std::move(cached);
+	return true;
+}
+
+void writeFormatsCache(const std::string &path, const std::string &key,
+		       const V4L2Subdevice::Formats &formats)
+{
+	/*
+	 * Write to a temporary file and rename it, to never expose a partial
+	 * cache to concurrent processes.
+	 */
+	const std::string tmpPath = path + "." + std::to_string(getpid());
+
+	std::ofstream out(tmpPath);
+	if (!out) {
+		LOG(CameraSensor, Debug)
+			<< "Unable to create sensor formats cache " << path;
+		return;
+	}
+
+	std::string escapedKey;
+	for (char c : key) {
+		if (c == '"' || c == '\\')
+			escapedKey += '\\';
+		escapedKey += c;
+	}
+
+	out << "key: \"" << escapedKey << "\"\n";
+	out << "formats:\n";
+
+	for (const auto &[code, ranges] : formats) {
+		out << "  - code: " << code << "\n";
+		out << "    sizes:\n";
+
+		for (const SizeRange &range : ranges)
+			out << "      - [ " << range.min.width << ", "
+			    << range.min.height << ", " << range.max.width
+			    << ", " << range.max.height << ", " << range.hStep
+			    << ", " << range.vStep << " ]\n";
+	}
+
+	out.close();
+
+	if (!out || rename(tmpPath.c_str(), path.c_str())) {
+		LOG(CameraSensor, Debug)
+			<< "Unable to write sensor formats cache " << path;
+		unlink(tmpPath.c_str());
+	}
+}
+
+} /* namespace */
+
 /**
  * \class CameraSensor
  * \brief A camera sensor based on V4L2 subdevices
@@ -121,8 +303,32 @@ int CameraSensor::init()
 		ctrls.set(V4L2_CID_VFLIP, 0);
 	subdev_->setControls(&ctrls);
 
-	/* Enumerate, sort and cache media bus codes and sizes. */
-	formats_ = subdev_->formats(pad_);
+	/*
+	 * Enumerate, sort and cache media bus codes and sizes. Enumerating all
+	 * sizes of all media bus codes can take a significant amount of time,
+	 * the result is stored in an in-memory cache for the lifetime of the
+	 * process, and optionally in an on-disk cache to speed up
+	 * initialization in subsequent processes.
+	 */
+	const std::string cachePath = formatsCachePath(entity_);
+	const std::string cacheKey = formatsCacheKey(entity_);
+
+	if (lookupFormatsMemoryCache(cacheKey, &formats_)) {
+		LOG(CameraSensor, Debug) << "Using formats cached in memory";
+	} else {
+		if (!cachePath.empty() && readFormatsCache(cachePath, cacheKey, &formats_)) {
+			LOG(CameraSensor, Debug)
+				<< "Using cached formats from " << cachePath;
+		} else {
+			formats_ = subdev_->formats(pad_);
+			if (!cachePath.empty() && !formats_.empty())
+				writeFormatsCache(cachePath, cacheKey, formats_);
+		}
+
+		if (!formats_.empty())
+			storeFormatsMemoryCache(cacheKey, formats_);
+	}
+
 	if (formats_.empty()) {
 		LOG(CameraSensor, Error) << "No image format found";
 		return -EINVAL;
@@ -199,7 +405,12 @@ int CameraSensor::init()
 			return ret;
 	}
 
-	return applyTestPatternMode(controls::draft::TestPatternModeEnum::TestPatternModeOff);
+	/*
+	 * The test pattern mode is reset to off when the format is first set,
+	 * to avoid a control write for sensors that are enumerated but never
+	 * used.
+	 */
+	return 0;
 }
 
 int CameraSensor::generateId()
@@ -320,12 +531,10 @@ int CameraSensor::validateSensorDriver()
 		err = -EINVAL;
 	}
 
-	ret = subdev_->getSelection(pad_, V4L2_SEL_TGT_CROP, &rect);
-	if (ret) {
-		LOG(CameraSensor, Warning)
-			<< "Failed to retrieve the sensor crop rectangle";
-		err = -EINVAL;
-	}
+	/*
+	 * The crop rectangle depends on the sensor configuration and is read
+	 * when needed by sensorInfo(), there's no need to probe it here.
+	 */
 
 	if (err) {
 		LOG(CameraSensor, Warning)
@@ -768,6 +977,13 @@ V4L2SubdeviceFormat CameraSensor::getFormat(const std::vector<unsigned int> &mbu
  */
 int CameraSensor::setFormat(V4L2SubdeviceFormat *format, Transform transform)
 {
+	/* Disable the test pattern the first time the sensor is configured. */
+	if (!testPatternMode_) {
+		int ret = applyTestPatternMode(controls::draft::TestPatternModeEnum::TestPatternModeOff);
+		if (ret)
+			return ret;
+	}
+
 	/* Configure flips if the sensor supports that. */
 	if (supportFlips_) {
 		ControlList flipCtrls(subdev_->controls());
@@ -928,12 +1144,13 @@ int CameraSensor::sensorInfo(IPACameraSensorInfo *info) const
 
 	/*
 	 * \todo Support for retreiving the crop rectangle is scheduled to
-	 * become mandatory. For the time being use the default value if it has
-	 * been initialized at sensor driver validation time.
+	 * become mandatory. For the time being default to the active area.
 	 */
 	int ret = subdev_->getSelection(pad_, V4L2_SEL_TGT_CROP, &info->analogCrop);
 	if (ret) {
 		info->analogCrop = activeArea_;
+		LOG(CameraSensor, Warning)
+			<< "Failed to retrieve the sensor crop rectangle, the sensor kernel driver needs to be fixed";
 		LOG(CameraSensor, Warning)
 			<< "The analogue crop rectangle has been defaulted to the active area size";
 	}
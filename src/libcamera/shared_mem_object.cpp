@@ -10,9 +10,11 @@
 
 #include "libcamera/internal/shared_mem_object.h"
 
+#include <fcntl.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -40,49 +42,125 @@ namespace libcamera {
  * function. It can be shared with other processes across IPC boundaries, which
  * can then map the memory with mmap().
  *
+ * The size of the backing file is sealed, preventing other processes with
+ * access to the file descriptor from shrinking it, which would cause accesses
+ * to the mapped memory to raise a SIGBUS signal.
+ *
  * A single memfd is created for every SharedMem. If there is a need to allocate
  * a large number of objects in shared memory, these objects should be grouped
  * together and use the shared memory allocated by a single SharedMem object if
- * possible. This will help to minimize the number of created memfd's.
+ * possible, for instance with the SharedMemObjects class. This will help to
+ * minimize the number of created memfd's and memory mappings.
  */
 
 SharedMem::SharedMem() = default;
 
+/**
+ * \enum SharedMem::Backing
+ * \brief The type of memory backing the shared memory
+ * \var SharedMem::Backing::Pages
+ * \brief The shared memory is backed by regular pages
+ * \var SharedMem::Backing::HugePages
+ * \brief The shared memory is backed by huge pages
+ */
+
 /**
  * \brief Construct a SharedMem with memory of the given \a size
  * \param[in] name Name of the SharedMem
  * \param[in] size Size of the shared memory to allocate and map
+ * \param[in] backing The requested memory backing
  *
  * The \a name is used for debugging purpose only. Multiple SharedMem instances
  * can have the same name.
+ *
+ * Large memory buffers accessed by the CPU can be backed by huge pages to
+ * reduce TLB pressure, by setting \a backing to Backing::HugePages. The size
+ * of the allocation is then rounded up to the huge page size, and mem() covers
+ * the whole allocation. If huge pages are not available, the memory is backed
+ * by regular pages, with a hint to the kernel to use transparent huge pages if
+ * enabled for shared memory. The backing actually used is reported by
+ * backing().
  */
-SharedMem::SharedMem(const std::string &name, std::size_t size)
+SharedMem::SharedMem(const std::string &name, std::size_t size, Backing backing)
 {
+	if (backing == Backing::HugePages &&
+	    allocate(name, size, Backing::HugePages))
+		return;
+
+	if (!allocate(name, size, Backing::Pages))
+		return;
+
+	if (backing == Backing::HugePages)
+		madvise(mem_.data(), mem_.size_bytes(), MADV_HUGEPAGE);
+}
+
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING	0x0002U
+#endif
+
+#ifndef MFD_HUGETLB
+#define MFD_HUGETLB		0x0004U
+#endif
+
+/* uClibc doesn't provide the file sealing API. */
+#ifndef __DOXYGEN__
+#if not HAVE_FILE_SEALS
+#define F_ADD_SEALS		1033
+#define F_SEAL_SEAL		0x0001
+#define F_SEAL_SHRINK		0x0002
+#define F_SEAL_GROW		0x0004
+#endif
+#endif
+
+bool SharedMem::allocate(const std::string &name, std::size_t size,
+			 Backing backing)
+{
+	unsigned int flags = MFD_CLOEXEC | MFD_ALLOW_SEALING;
+	if (backing == Backing::HugePages)
+		flags |= MFD_HUGETLB;
+
 #if HAVE_MEMFD_CREATE
-	int fd = memfd_create(name.c_str(), MFD_CLOEXEC);
+	int fd = memfd_create(name.c_str(), flags);
 #else
-	int fd = syscall(SYS_memfd_create, name.c_str(), MFD_CLOEXEC);
+	int fd = syscall(SYS_memfd_create, name.c_str(), flags);
 #endif
 	if (fd < 0)
-		return;
+		return false;
 
 	fd_ = SharedFD(std::move(fd));
 	if (!fd_.isValid())
-		return;
+		return false;
+
+	if (backing == Backing::HugePages) {
+		/* The block size of hugetlbfs files is the huge page size. */
+		struct stat st;
+		if (fstat(fd_.get(), &st) < 0) {
+			fd_ = SharedFD();
+			return false;
+		}
 
-	if (ftruncate(fd_.get(), size) < 0) {
+		std::size_t hugeMask = st.st_blksize - 1;
+		size = (size + hugeMask) & ~hugeMask;
+	}
+
+	if (ftruncate(fd_.get(), size) < 0 ||
+	    fcntl(fd_.get(), F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
 		fd_ = SharedFD();
-		return;
+		return false;
 	}
 
 	void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
 			 fd_.get(), 0);
 	if (mem == MAP_FAILED) {
 		fd_ = SharedFD();
-		return;
+		return false;
 	}
 
 	mem_ = { static_cast<uint8_t *>(mem), size };
+	backing_ = backing;
+
+	return true;
 }
 
 /**
@@ -93,6 +171,7 @@ SharedMem::SharedMem(SharedMem &&rhs)
 {
 	this->fd_ = std::move(rhs.fd_);
 	this->mem_ = rhs.mem_;
+	this->backing_ = rhs.backing_;
 	rhs.mem_ = {};
 }
 
@@ -117,11 +196,17 @@ SharedMem::~SharedMem()
 /**
  * \brief Move assignment operator for SharedMem
  * \param[in] rhs The object to move
+ *
+ * The memory mapping of this instance, if any, is invalidated.
  */
 SharedMem &SharedMem::operator=(SharedMem &&rhs)
 {
+	if (!mem_.empty())
+		munmap(mem_.data(), mem_.size_bytes());
+
 	this->fd_ = std::move(rhs.fd_);
 	this->mem_ = rhs.mem_;
+	this->backing_ = rhs.backing_;
 	rhs.mem_ = {};
 	return *this;
 }
@@ -138,6 +223,12 @@ SharedMem &SharedMem::operator=(SharedMem &&rhs)
  * \return The memory buffer, or an empty Span if allocation failed
  */
 
+/**
+ * \fn SharedMem::backing() const
+ * \brief Retrieve the type of memory backing the shared memory
+ * \return The memory backing, only meaningful if the allocation succeeded
+ */
+
 /**
  * \fn SharedMem::operator bool()
  * \brief Check if the shared memory allocation succeeded
@@ -170,7 +261,8 @@ SharedMem &SharedMem::operator=(SharedMem &&rhs)
  *
  * A new anonymous file is created for every SharedMemObject instance. If there
  * is a need to share a large number of small objects, these objects should be
- * grouped into a single larger object to limit the number of file descriptors.
+ * grouped into a single larger object, or allocated together with the
+ * SharedMemObjects class, to limit the number of file descriptors.
  *
  * To share the object with other processes, see the SharedMem documentation.
  */
@@ -239,4 +331,86 @@ SharedMem &SharedMem::operator=(SharedMem &&rhs)
  * \copydoc SharedMemObject::operator*
  */
 
+/**
+ * \class SharedMemObjects
+ * \brief Helper class to allocate multiple objects in a single shareable memory
+ * \tparam Ts The object types
+ *
+ * The SharedMemObjects class is a specialization of the SharedMem class that
+ * constructs one object of each of the types \a Ts in a single shareable memory
+ * allocation. Compared to one SharedMemObject per object, it uses a single
+ * file descriptor and a single memory mapping in each process, which also
+ * reduces the TLB footprint of objects accessed together, such as the rings of
+ * parameters and statistics buffers exchanged with IPA modules.
+ *
+ * The objects are value-initialized when the SharedMemObjects is constructed,
+ * and destroyed with it. They are laid out in the order of the \a Ts types, at
+ * offsets aligned to a cache line to avoid false sharing between objects
+ * written by different processes. The layout only depends on the types, other
+ * processes can locate the objects in their own mapping of the file descriptor
+ * with offset(). As the types identify the objects, they must be distinct.
+ *
+ * The same restrictions on the object types as for SharedMemObject apply.
+ */
+
+/**
+ * \var SharedMemObjects::kSize
+ * \brief The size of the shared memory needed to store all the objects
+ */
+
+/**
+ * \fn SharedMemObjects::SharedMemObjects(const std::string &name, Backing backing)
+ * \brief Construct a SharedMemObjects
+ * \param[in] name Name of the SharedMemObjects
+ * \param[in] backing The requested memory backing
+ *
+ * The \a name is used for debugging purpose only. Multiple SharedMem instances
+ * can have the same name. See SharedMem::SharedMem() for a description of the
+ * \a backing.
+ */
+
+/**
+ * \fn SharedMemObjects::SharedMemObjects(SharedMemObjects<Ts...> &&rhs)
+ * \brief Move constructor for SharedMemObjects
+ * \param[in] rhs The object to move
+ */
+
+/**
+ * \fn SharedMemObjects::~SharedMemObjects()
+ * \brief Destroy the SharedMemObjects instance
+ *
+ * Destroying a SharedMemObjects calls the destructors of all the stored
+ * objects. See SharedMemObject::~SharedMemObject() for the synchronization
+ * requirements with other users of the shared objects.
+ */
+
+/**
+ * \fn SharedMemObjects::operator=(SharedMemObjects<Ts...> &&rhs)
+ * \brief Move assignment operator for SharedMemObjects
+ * \param[in] rhs The SharedMemObjects object to take the data from
+ *
+ * The objects previously stored in this instance are destroyed. Moving a
+ * SharedMemObjects does not affect the objects stored in \a rhs.
+ */
+
+/**
+ * \fn SharedMemObjects::offset()
+ * \brief Retrieve the offset of an object in the shared memory
+ * \tparam T The object type
+ * \return The offset of the object of type \a T in bytes from the start of the
+ * shared memory
+ */
+
+/**
+ * \fn T &SharedMemObjects::get()
+ * \brief Retrieve a stored object
+ * \tparam T The object type
+ * \return Reference to the stored object of type \a T
+ */
+
+/**
+ * \fn const T &SharedMemObjects::get() const
+ * \copydoc SharedMemObjects::get()
+ */
+
 } /* namespace libcamera */
@@ -23,11 +23,42 @@ namespace libcamera {
  * \brief Size of a color lookup table
  */
 
+/**
+ * \var DebayerParams::kGammaLookupSize
+ * \brief Size of the gamma lookup table applied after colour correction
+ */
+
+/**
+ * \var DebayerParams::kLscGridWidth
+ * \brief Number of horizontal points of the lens shading correction grids
+ */
+
+/**
+ * \var DebayerParams::kLscGridHeight
+ * \brief Number of vertical points of the lens shading correction grids
+ */
+
 /**
  * \typedef DebayerParams::ColorLookupTable
  * \brief Type of the lookup tables for red, green, blue values
  */
 
+/**
+ * \typedef DebayerParams::GammaLookupTable
+ * \brief Type of the gamma lookup table
+ */
+
+/**
+ * \typedef DebayerParams::LscGrid
+ * \brief Type of the lens shading correction gain grids
+ *
+ * The grid stores kLscGridWidth x kLscGridHeight gains in raster order, in
+ * 8.8 fixed point format (256 = 1.0). The points of the grid are evenly
+ * spread over the output image, the first and last points of each row and
+ * column lying on the image edges. The gain of each pixel is bilinearly
+ * interpolated from the 4 surrounding points.
+ */
+
 /**
  * \var DebayerParams::red
  * \brief Lookup table for red color, mapping input values to output values
@@ -43,6 +74,63 @@ namespace libcamera {
  * \brief Lookup table for blue color, mapping input values to output values
  */
 
+/**
+ * \var DebayerParams::colorCorrection
+ * \brief Enable lens shading correction and the colour correction matrix
+ *
+ * When disabled, the red, green and blue lookup tables map the debayered
+ * values to the output values directly, and the other colour correction
+ * parameters are ignored.
+ *
+ * When enabled, the lookup tables must produce linear values. Each pixel is
+ * then multiplied by the lens shading correction gains, transformed by the
+ * colour correction matrix and mapped to the output value by the gamma
+ * table. This is performed in fixed point on each line right after it has
+ * been debayered, while the line is still in the CPU cache.
+ */
+
+/**
+ * \var DebayerParams::lscRed
+ * \brief Lens shading correction gains for the red channel
+ */
+
+/**
+ * \var DebayerParams::lscGreen
+ * \brief Lens shading correction gains for the green channel
+ */
+
+/**
+ * \var DebayerParams::lscBlue
+ * \brief Lens shading correction gains for the blue channel
+ */
+
+/**
+ * \var DebayerParams::ccm
+ * \brief Colour correction matrix
+ *
+ * The 3x3 matrix applied to the (red, green, blue) vector of each pixel,
+ * stored in row-major order in 8.8 signed fixed point format (256 = 1.0).
+ * White balance gains are expected to be folded into the matrix.
+ */
+
+/**
+ * \var DebayerParams::gamma
+ * \brief Gamma lookup table applied after colour correction
+ *
+ * The table is indexed by the colour corrected linear values scaled to
+ * kGammaLookupSize, and gives the output values.
+ */
+
+/**
+ * \var kDebayerParamsBufferCount
+ * \brief Number of parameters buffers shared between the Software ISP and the IPA
+ *
+ * The IPA fills the parameters of each frame in a buffer of a ring selected by
+ * the frame number. The ring must be deeper than the number of frames in
+ * flight in the Software ISP, to ensure a buffer is not overwritten before the
+ * debayering of the frame it has been filled for has started.
+ */
+
 /**
  * \class Debayer
  * \brief Base debayering class
@@ -94,14 +182,20 @@ Debayer::~Debayer()
  */
 
 /**
- * \fn void Debayer::process(FrameBuffer *input, FrameBuffer *output, DebayerParams params)
+ * \fn void Debayer::process(uint32_t frame, FrameBuffer *input, FrameBuffer *output, const DebayerParams *params, const Rectangle &crop)
  * \brief Process the bayer data into the requested format.
+ * \param[in] frame The frame number.
  * \param[in] input The input buffer.
  * \param[in] output The output buffer.
  * \param[in] params The parameters to be used in debayering.
+ * \param[in] crop The part of the input to scale to the output, in input pixels.
+ *
+ * The parameters are stored in the buffer filled by the IPA for the frame,
+ * which is not modified until the next use of the buffer for a later frame.
+ * They are read once at the start of processing.
  *
- * \note DebayerParams is passed by value deliberately so that a copy is passed
- * when this is run in another thread by invokeMethod().
+ * The crop rectangle implements digital zoom. It is adjusted to the supported
+ * limits, and a null rectangle selects the largest field of view.
  */
 
 /**
@@ -11,14 +11,26 @@
 
 #include "debayer_cpu.h"
 
+#include <algorithm>
+#include <limits.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include <libcamera/base/utils.h>
 
 #include <libcamera/formats.h>
+#include <libcamera/transform.h>
 
 #include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/dma_buf_allocator.h"
+#include "libcamera/internal/formats.h"
 #include "libcamera/internal/framebuffer.h"
-#include "libcamera/internal/mapped_framebuffer.h"
+#include "libcamera/internal/raw_unpack.h"
+#include "libcamera/internal/tracepoints.h"
 
 namespace libcamera {
 
@@ -34,7 +46,7 @@ namespace libcamera {
  * \param[in] stats Pointer to the stats object to use
  */
 DebayerCpu::DebayerCpu(std::unique_ptr<SwStatsCpu> stats)
-	: stats_(std::move(stats))
+	: stats_(std::move(stats)), colorCorrection_(false), processedFrames_(0)
 {
 	/*
 	 * Reading from uncached buffers may be very slow.
@@ -46,18 +58,49 @@ DebayerCpu::DebayerCpu(std::unique_ptr<SwStatsCpu> stats)
 	 */
 	enableInputMemcpy_ = true;
 
+	/* The vectorized functions can be disabled to compare performance */
+	simd_ = simdSupported();
+	const char *simd = utils::secure_getenv("LIBCAMERA_SOFTISP_SIMD");
+	if (simd && !strcmp(simd, "0"))
+		simd_ = false;
+
+	/*
+	 * Frames can be split in horizontal stripes debayered concurrently in
+	 * separate threads. Default to a single stripe processed in the thread
+	 * calling process().
+	 */
+	threads_ = 1;
+	const char *threads = utils::secure_getenv("LIBCAMERA_SOFTISP_THREADS");
+	if (threads) {
+		char *end;
+		unsigned long value = strtoul(threads, &end, 10);
+		if (*threads == '\0' || *end != '\0' || value == 0)
+			LOG(Debayer, Warning)
+				<< "Invalid LIBCAMERA_SOFTISP_THREADS value '"
+				<< threads << "', using a single thread";
+		else
+			threads_ = std::min<unsigned long>(value, kMaxStripes);
+	}
+
 	/* Initialize color lookup tables */
 	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++)
 		red_[i] = green_[i] = blue_[i] = i;
-
-	for (unsigned int i = 0; i < kMaxLineBuffers; i++)
-		lineBuffers_[i] = nullptr;
 }
 
 DebayerCpu::~DebayerCpu()
 {
-	for (unsigned int i = 0; i < kMaxLineBuffers; i++)
-		free(lineBuffers_[i]);
+	freeStripes();
+}
+
+/*
+ * Debayer one stripe of a frame in the thread of the worker and signal its
+ * completion to the thread waiting in DebayerCpu::process().
+ */
+void DebayerCpu::StripeWorker::process(DebayerCpu *debayer, Stripe *stripe,
+				       const uint8_t *src, uint8_t *dst)
+{
+	debayer->processStripe(*stripe, src, dst);
+	debayer->stripesDone_.release();
 }
 
 #define DECLARE_SRC_POINTERS(pixel_t)                            \
@@ -113,7 +156,7 @@ void DebayerCpu::debayer8_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint8_t)
 
-	for (int x = 0; x < (int)window_.width;) {
+	for (int x = 0; x < (int)debayerWidth_;) {
 		BGGR_BGR888(1, 1, 1)
 		GBRG_BGR888(1, 1, 1)
 	}
@@ -123,7 +166,7 @@ void DebayerCpu::debayer8_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint8_t)
 
-	for (int x = 0; x < (int)window_.width;) {
+	for (int x = 0; x < (int)debayerWidth_;) {
 		GRBG_BGR888(1, 1, 1)
 		RGGB_BGR888(1, 1, 1)
 	}
@@ -133,7 +176,7 @@ void DebayerCpu::debayer10_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
 
-	for (int x = 0; x < (int)window_.width;) {
+	for (int x = 0; x < (int)debayerWidth_;) {
 		/* divide values by 4 for 10 -> 8 bpp value */
 		BGGR_BGR888(1, 1, 4)
 		GBRG_BGR888(1, 1, 4)
@@ -144,7 +187,7 @@ void DebayerCpu::debayer10_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
 
-	for (int x = 0; x < (int)window_.width;) {
+	for (int x = 0; x < (int)debayerWidth_;) {
 		/* divide values by 4 for 10 -> 8 bpp value */
 		GRBG_BGR888(1, 1, 4)
 		RGGB_BGR888(1, 1, 4)
@@ -155,7 +198,7 @@ void DebayerCpu::debayer12_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
 
-	for (int x = 0; x < (int)window_.width;) {
+	for (int x = 0; x < (int)debayerWidth_;) {
 		/* divide values by 16 for 12 -> 8 bpp value */
 		BGGR_BGR888(1, 1, 16)
 		GBRG_BGR888(1, 1, 16)
@@ -166,7 +209,7 @@ void DebayerCpu::debayer12_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
 
-	for (int x = 0; x < (int)window_.width;) {
+	for (int x = 0; x < (int)debayerWidth_;) {
 		/* divide values by 16 for 12 -> 8 bpp value */
 		GRBG_BGR888(1, 1, 16)
 		RGGB_BGR888(1, 1, 16)
@@ -175,7 +218,7 @@ void DebayerCpu::debayer12_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 
 void DebayerCpu::debayer10P_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
-	const int widthInBytes = window_.width * 5 / 4;
+	const int widthInBytes = debayerWidth_ * 5 / 4;
 	const uint8_t *prev = src[0];
 	const uint8_t *curr = src[1];
 	const uint8_t *next = src[2];
@@ -200,7 +243,7 @@ void DebayerCpu::debayer10P_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 
 void DebayerCpu::debayer10P_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
-	const int widthInBytes = window_.width * 5 / 4;
+	const int widthInBytes = debayerWidth_ * 5 / 4;
 	const uint8_t *prev = src[0];
 	const uint8_t *curr = src[1];
 	const uint8_t *next = src[2];
@@ -220,7 +263,7 @@ void DebayerCpu::debayer10P_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 
 void DebayerCpu::debayer10P_GBGB_BGR888(uint8_t *dst, const uint8_t *src[])
 {
-	const int widthInBytes = window_.width * 5 / 4;
+	const int widthInBytes = debayerWidth_ * 5 / 4;
 	const uint8_t *prev = src[0];
 	const uint8_t *curr = src[1];
 	const uint8_t *next = src[2];
@@ -240,7 +283,7 @@ void DebayerCpu::debayer10P_GBGB_BGR888(uint8_t *dst, const uint8_t *src[])
 
 void DebayerCpu::debayer10P_RGRG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
-	const int widthInBytes = window_.width * 5 / 4;
+	const int widthInBytes = debayerWidth_ * 5 / 4;
 	const uint8_t *prev = src[0];
 	const uint8_t *curr = src[1];
 	const uint8_t *next = src[2];
@@ -258,6 +301,533 @@ void DebayerCpu::debayer10P_RGRG_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
+/*
+ * YUV conversion
+ *
+ * The lines debayered to BGR888 are converted to YCbCr with the BT.601 full
+ * range encoding, matching the sYCC colour space. The coefficients are scaled
+ * by 256, the chroma of each pair (YUYV) or 2x2 block (NV12) of pixels is
+ * computed from the sum of their RGB values.
+ */
+static inline uint8_t rgbToY(unsigned int r, unsigned int g, unsigned int b)
+{
+	return (77 * r + 150 * g + 29 * b + 128) >> 8;
+}
+
+/* Compute Cb from the sum of (1 << shift) pixels */
+static inline uint8_t rgbToCb(int r, int g, int b, unsigned int shift)
+{
+	int cb = ((-43 * r - 85 * g + 128 * b) >> shift) + 128 * 256 + 128;
+	return std::min(cb >> 8, 255);
+}
+
+static inline uint8_t rgbToCr(int r, int g, int b, unsigned int shift)
+{
+	int cr = ((128 * r - 107 * g - 21 * b) >> shift) + 128 * 256 + 128;
+	return std::min(cr >> 8, 255);
+}
+
+void DebayerCpu::convertYUYV(const Stripe &stripe, uint8_t *dst,
+			     [[maybe_unused]] unsigned int y)
+{
+	const unsigned int width = window_.width / binning_;
+
+	for (unsigned int i = 0; i < 2; i++) {
+		const uint8_t *bgr = stripe.bgrLines[i];
+		uint8_t *out = dst + i * outputConfig_.stride;
+
+		for (unsigned int x = 0; x < width; x += 2) {
+			const unsigned int b = bgr[0] + bgr[3];
+			const unsigned int g = bgr[1] + bgr[4];
+			const unsigned int r = bgr[2] + bgr[5];
+
+			out[0] = rgbToY(bgr[2], bgr[1], bgr[0]);
+			out[1] = rgbToCb(r, g, b, 1);
+			out[2] = rgbToY(bgr[5], bgr[4], bgr[3]);
+			out[3] = rgbToCr(r, g, b, 1);
+
+			bgr += 6;
+			out += 4;
+		}
+	}
+}
+
+void DebayerCpu::convertNV12(const Stripe &stripe, uint8_t *dst, unsigned int y)
+{
+	const unsigned int stride = outputConfig_.stride;
+	const unsigned int width = window_.width / binning_;
+	const unsigned int height = window_.height / binning_;
+	const uint8_t *bgr0 = stripe.bgrLines[0];
+	const uint8_t *bgr1 = stripe.bgrLines[1];
+	/* The CbCr plane follows the height lines of the Y plane */
+	uint8_t *uv = dst + (height - y / 2) * stride;
+	uint8_t *y0 = dst;
+	uint8_t *y1 = dst + stride;
+
+	for (unsigned int x = 0; x < width; x += 2) {
+		const unsigned int b = bgr0[0] + bgr0[3] + bgr1[0] + bgr1[3];
+		const unsigned int g = bgr0[1] + bgr0[4] + bgr1[1] + bgr1[4];
+		const unsigned int r = bgr0[2] + bgr0[5] + bgr1[2] + bgr1[5];
+
+		y0[0] = rgbToY(bgr0[2], bgr0[1], bgr0[0]);
+		y0[1] = rgbToY(bgr0[5], bgr0[4], bgr0[3]);
+		y1[0] = rgbToY(bgr1[2], bgr1[1], bgr1[0]);
+		y1[1] = rgbToY(bgr1[5], bgr1[4], bgr1[3]);
+		uv[0] = rgbToCb(r, g, b, 2);
+		uv[1] = rgbToCr(r, g, b, 2);
+
+		bgr0 += 6;
+		bgr1 += 6;
+		y0 += 2;
+		y1 += 2;
+		uv += 2;
+	}
+}
+
+/*
+ * Colour correction
+ *
+ * Lens shading correction and the colour correction matrix are applied to
+ * each debayered line while it is still in the CPU cache, before the gamma
+ * table. The lookup tables then produce linear values, which are scaled to
+ * the 10-bit range of the gamma table by the lens shading gains to limit the
+ * quantization of the dark areas.
+ */
+void DebayerCpu::setColorCorrection(const DebayerParams *params)
+{
+	/*
+	 * The debayered pixels are stored in blue, green, red order, or in red,
+	 * green, blue order when the red and blue gains are swapped. Map the
+	 * memory order to the red, green, blue order of the parameters.
+	 */
+	static constexpr unsigned int kBGR[3] = { 2, 1, 0 };
+	static constexpr unsigned int kRGB[3] = { 0, 1, 2 };
+	const unsigned int *colors = swapRedBlueGains_ ? kRGB : kBGR;
+	const DebayerParams::LscGrid *grids[3] = {
+		&params->lscRed, &params->lscGreen, &params->lscBlue,
+	};
+
+	for (unsigned int i = 0; i < 3; i++) {
+		lsc_[i] = *grids[colors[i]];
+		for (unsigned int j = 0; j < 3; j++)
+			ccm_[i][j] = params->ccm[colors[i] * 3 + colors[j]];
+	}
+
+	gamma_ = params->gamma;
+}
+
+/*
+ * Correct the line of index y in the output image. src and dst may point to
+ * the same line buffer.
+ */
+void DebayerCpu::correctLine(const uint8_t *src, uint8_t *dst, unsigned int y)
+{
+	constexpr unsigned int gridWidth = DebayerParams::kLscGridWidth;
+	constexpr unsigned int gridHeight = DebayerParams::kLscGridHeight;
+	constexpr int gammaMax = DebayerParams::kGammaLookupSize - 1;
+	const unsigned int width = window_.width / binning_;
+	const unsigned int height = window_.height / binning_;
+
+	/* Interpolate the gains of the grid rows surrounding the line */
+	const unsigned int pos = y * (gridHeight - 1) * 256 / std::max(height - 1, 1U);
+	const unsigned int row = std::min(pos / 256, gridHeight - 2);
+	const unsigned int frac = pos - row * 256;
+	/* Duplicate the last column to interpolate the last pixel of the line */
+	int32_t gains[3][gridWidth + 1];
+
+	for (unsigned int c = 0; c < 3; c++) {
+		const uint16_t *grid = lsc_[c].data() + row * gridWidth;
+
+		for (unsigned int i = 0; i < gridWidth; i++)
+			gains[c][i] = (grid[i] * (256 - frac) +
+				       grid[i + gridWidth] * frac) >> 8;
+		gains[c][gridWidth] = gains[c][gridWidth - 1];
+	}
+
+	/* Position of the pixels in the grid, in 16.16 fixed point */
+	const unsigned int step = ((gridWidth - 1) << 16) / std::max(width - 1, 1U);
+	unsigned int gridX = 0;
+
+	for (unsigned int x = 0; x < width; x++, gridX += step) {
+		const unsigned int col = gridX >> 16;
+		const int32_t weight = (gridX >> 8) & 0xff;
+		int32_t v[3];
+
+		/* Scale the 8-bit values to 10 bits, gains are 8.8 */
+		for (unsigned int c = 0; c < 3; c++) {
+			const int32_t *g = &gains[c][col];
+			const int32_t gain = g[0] + (((g[1] - g[0]) * weight) >> 8);
+
+			v[c] = (src[c] * gain) >> 6;
+		}
+
+		for (unsigned int c = 0; c < 3; c++) {
+			int32_t out = (ccm_[c][0] * v[0] + ccm_[c][1] * v[1] +
+				       ccm_[c][2] * v[2]) >> 8;
+			dst[c] = gamma_[std::clamp(out, 0, gammaMax)];
+		}
+
+		src += 3;
+		dst += 3;
+	}
+}
+
+/*
+ * Binning
+ *
+ * When downscaling, each output pixel is computed from a block of scale x
+ * scale input pixels by averaging the values of each colour, which needs no
+ * interpolation. The Bayer pattern is accessed directly through the
+ * indices set by setBinningFunction().
+ */
+namespace {
+
+template<typename T>
+struct BinLoader {
+	static unsigned int get(const uint8_t *line, unsigned int x)
+	{
+		return reinterpret_cast<const T *>(line)[x];
+	}
+};
+
+/* Return the 8 most significant bits of CSI-2 packed 10-bit pixels */
+struct BinLoader10P {
+	static unsigned int get(const uint8_t *line, unsigned int x)
+	{
+		return line[x / 4 * 5 + x % 4];
+	}
+};
+
+} /* namespace */
+
+template<typename Loader, unsigned int scale>
+void DebayerCpu::debayerBinned_BGR888(uint8_t *dst, const uint8_t *src[])
+{
+	/* Number of 2x2 blocks of the Bayer pattern in each output pixel */
+	constexpr unsigned int blocksShift = scale == 4 ? 2 : 0;
+	const unsigned int width = window_.width / scale;
+	const unsigned int shift = binShift_ + blocksShift;
+
+	for (unsigned int x = 0; x < width; x++) {
+		unsigned int sums[4] = {};
+
+		for (unsigned int y = 0; y < scale; y += 2) {
+			const uint8_t *line0 = src[y];
+			const uint8_t *line1 = src[y + 1];
+
+			for (unsigned int i = x * scale; i < (x + 1) * scale; i += 2) {
+				sums[0] += Loader::get(line0, i);
+				sums[1] += Loader::get(line0, i + 1);
+				sums[2] += Loader::get(line1, i);
+				sums[3] += Loader::get(line1, i + 1);
+			}
+		}
+
+		*dst++ = blue_[sums[binIndices_[0]] >> shift];
+		*dst++ = green_[(sums[binIndices_[1]] + sums[binIndices_[2]]) >> (shift + 1)];
+		*dst++ = red_[sums[binIndices_[3]] >> shift];
+	}
+}
+
+/*
+ * Vectorized debayering
+ *
+ * The vectorized implementations rely on the compiler's generic vector
+ * extensions, which are lowered to the baseline SIMD instruction set of the
+ * architecture (SSE2 on x86-64, NEON on arm64 and on arm when enabled at
+ * compile time). All interpolations are computed for every lane on 16-bit
+ * integers, and the per-lane result is then selected depending on the colour
+ * of the pixel. This matches the integer arithmetic of the scalar
+ * implementation exactly, which is kept as a fallback.
+ *
+ * The colour lookup tables are then applied with table lookup instructions
+ * on arm64, and with scalar lookups on other architectures. As the scalar
+ * lookups dominate the processing time, the CSI-2 packed formats, which need
+ * their MSBs to be extracted first, are only vectorized on arm64.
+ */
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && \
+	(defined(__x86_64__) || defined(__aarch64__) || defined(__ARM_NEON))
+#define DEBAYER_CPU_HAVE_SIMD 1
+#if defined(__aarch64__)
+#define DEBAYER_CPU_HAVE_SIMD_LOOKUP 1
+#endif
+#endif
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_convertvector)
+#define DEBAYER_CPU_HAVE_CONVERTVECTOR 1
+#endif
+#endif
+
+namespace {
+
+/* Number of pixels processed in one go by the vectorized functions */
+constexpr unsigned int kSimdLanes = 16;
+
+#if DEBAYER_CPU_HAVE_SIMD
+
+using SimdVec = uint16_t __attribute__((vector_size(kSimdLanes * sizeof(uint16_t))));
+using SimdVec8 = uint8_t __attribute__((vector_size(kSimdLanes)));
+
+template<typename T>
+[[gnu::always_inline]] inline SimdVec simdLoad(const T *src)
+{
+	if constexpr (sizeof(T) == sizeof(uint16_t)) {
+		SimdVec v;
+		memcpy(&v, src, sizeof(v));
+		return v;
+	} else {
+		SimdVec8 v8;
+		memcpy(&v8, src, sizeof(v8));
+#if DEBAYER_CPU_HAVE_CONVERTVECTOR
+		return __builtin_convertvector(v8, SimdVec);
+#else
+		SimdVec v;
+		for (unsigned int i = 0; i < kSimdLanes; i++)
+			v[i] = v8[i];
+		return v;
+#endif
+	}
+}
+
+#if DEBAYER_CPU_HAVE_SIMD_LOOKUP
+
+struct SimdLookupTable {
+	SimdLookupTable(const DebayerParams::ColorLookupTable &table)
+	{
+		for (unsigned int i = 0; i < 4; i++) {
+			const uint8_t *data = table.data() + i * 64;
+			quarters[i] = { { vld1q_u8(data), vld1q_u8(data + 16),
+					  vld1q_u8(data + 32), vld1q_u8(data + 48) } };
+		}
+	}
+
+	uint8x16x4_t quarters[4];
+};
+
+/*
+ * Look up 16 indices in a 256 entries table. vqtbx4q_u8() leaves the lanes
+ * with an index out of the 64 entries range untouched, the subtractions wrap
+ * around for the indices that have been looked up already.
+ */
+[[gnu::always_inline]] inline uint8x16_t
+simdLookup(const SimdLookupTable &table, const SimdVec &index)
+{
+	uint16x8_t lo, hi;
+	memcpy(&lo, &index, sizeof(lo));
+	memcpy(&hi, reinterpret_cast<const uint8_t *>(&index) + sizeof(lo), sizeof(hi));
+	const uint8x16_t idx = vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+
+	uint8x16_t value = vqtbl4q_u8(table.quarters[0], idx);
+	value = vqtbx4q_u8(value, table.quarters[1], vsubq_u8(idx, vdupq_n_u8(64)));
+	value = vqtbx4q_u8(value, table.quarters[2], vsubq_u8(idx, vdupq_n_u8(128)));
+	value = vqtbx4q_u8(value, table.quarters[3], vsubq_u8(idx, vdupq_n_u8(192)));
+
+	return value;
+}
+
+#endif /* DEBAYER_CPU_HAVE_SIMD_LOOKUP */
+
+/* A block of kSimdLanes pixels of a line and their left and right neighbours */
+struct SimdLine {
+	SimdVec l;
+	SimdVec c;
+	SimdVec r;
+};
+
+/* Load blocks of the previous, current and next lines of unpacked data */
+template<typename T>
+struct SimdLoader {
+	[[gnu::always_inline]] void load(unsigned int x, SimdLine lines[3]) const
+	{
+		for (unsigned int i = 0; i < 3; i++)
+			lines[i] = { simdLoad(src[i] + x - 1), simdLoad(src[i] + x),
+				     simdLoad(src[i] + x + 1) };
+	}
+
+	const T *src[3];
+};
+
+/*
+ * Load blocks of the previous, current and next lines of CSI-2 packed 10-bit
+ * data, keeping the 8 MSBs of the pixels. x must be a multiple of 4, the
+ * pixel on the left is then the last one of the previous 5 bytes group.
+ */
+struct SimdLoader10P {
+	[[gnu::always_inline]] void load(unsigned int x, SimdLine lines[3]) const
+	{
+		for (unsigned int i = 0; i < 3; i++) {
+			const uint8_t *in = src[i] + x / 4 * 5;
+			uint8_t msb[kSimdLanes + 2];
+
+			msb[0] = in[-2];
+			raw::unpackMsb10P(in, &msb[1], kSimdLanes);
+			msb[kSimdLanes + 1] = in[kSimdLanes / 4 * 5];
+
+			lines[i] = { simdLoad(msb), simdLoad(msb + 1),
+				     simdLoad(msb + 2) };
+		}
+	}
+
+	const uint8_t *src[3];
+};
+
+/*
+ * Debayer one line of width pixels in blocks of kSimdLanes pixels. A partial
+ * last block is handled by moving it back to overlap with the previous one,
+ * width must thus be an even number not smaller than kSimdLanes.
+ *
+ * With grLine set to false, the line is a BGBG line, otherwise it is a GRGR
+ * line. With oddPhase set the line starts with the second pixel of the
+ * pattern (GBGB or RGRG).
+ */
+template<unsigned int div, bool grLine, bool oddPhase, typename Loader>
+[[gnu::always_inline]] inline void
+debayerLineSimd(uint8_t *dst, const Loader &loader,
+		unsigned int width, const DebayerParams::ColorLookupTable &red,
+		const DebayerParams::ColorLookupTable &green,
+		const DebayerParams::ColorLookupTable &blue)
+{
+	/*
+	 * Divisions by powers of two of unsigned values are shifts, spell them
+	 * out as not all compilers lower vector divisions to vector shifts.
+	 */
+	static_assert(div && !(div & (div - 1)), "div must be a power of two");
+	constexpr unsigned int divShift = __builtin_ctz(div);
+
+	/* Lanes holding the first pixel of the BG or GR pair */
+	SimdVec firstMask;
+	for (unsigned int i = 0; i < kSimdLanes; i++)
+		firstMask[i] = (i & 1) == oddPhase ? 0xffff : 0;
+
+#if DEBAYER_CPU_HAVE_SIMD_LOOKUP
+	const SimdLookupTable redTable(red);
+	const SimdLookupTable greenTable(green);
+	const SimdLookupTable blueTable(blue);
+#endif
+
+	for (unsigned int x = 0; x < width; x += kSimdLanes) {
+		if (x + kSimdLanes > width)
+			x = width - kSimdLanes;
+
+		SimdLine lines[3];
+		loader.load(x, lines);
+
+		const SimdVec &p = lines[0].c;
+		const SimdVec &pl = lines[0].l;
+		const SimdVec &pr = lines[0].r;
+		const SimdVec &c = lines[1].c;
+		const SimdVec &cl = lines[1].l;
+		const SimdVec &cr = lines[1].r;
+		const SimdVec &n = lines[2].c;
+		const SimdVec &nl = lines[2].l;
+		const SimdVec &nr = lines[2].r;
+
+		const SimdVec cross = (p + cl + cr + n) >> (divShift + 2);
+		const SimdVec diag = (pl + pr + nl + nr) >> (divShift + 2);
+		const SimdVec hor = (cl + cr) >> (divShift + 1);
+		const SimdVec ver = (p + n) >> (divShift + 1);
+		const SimdVec cen = c >> divShift;
+
+		SimdVec b, g, r;
+		if (!grLine) {
+			/* B pixels first, then G pixels */
+			b = (cen & firstMask) | (hor & ~firstMask);
+			g = (cross & firstMask) | (cen & ~firstMask);
+			r = (diag & firstMask) | (ver & ~firstMask);
+		} else {
+			/* G pixels first, then R pixels */
+			b = (ver & firstMask) | (diag & ~firstMask);
+			g = (cen & firstMask) | (cross & ~firstMask);
+			r = (hor & firstMask) | (cen & ~firstMask);
+		}
+
+#if DEBAYER_CPU_HAVE_SIMD_LOOKUP
+		const uint8x16x3_t bgr = { { simdLookup(blueTable, b),
+					     simdLookup(greenTable, g),
+					     simdLookup(redTable, r) } };
+		vst3q_u8(dst + x * 3, bgr);
+#else
+		uint16_t bIdx[kSimdLanes], gIdx[kSimdLanes], rIdx[kSimdLanes];
+		memcpy(bIdx, &b, sizeof(bIdx));
+		memcpy(gIdx, &g, sizeof(gIdx));
+		memcpy(rIdx, &r, sizeof(rIdx));
+
+		uint8_t *out = dst + x * 3;
+		for (unsigned int i = 0; i < kSimdLanes; i++) {
+			*out++ = blue[bIdx[i]];
+			*out++ = green[gIdx[i]];
+			*out++ = red[rIdx[i]];
+		}
+#endif
+	}
+}
+
+#endif /* DEBAYER_CPU_HAVE_SIMD */
+
+} /* namespace */
+
+#if DEBAYER_CPU_HAVE_SIMD
+
+template<typename T, unsigned int div, bool grLine>
+void DebayerCpu::debayerSimd_BGR888(uint8_t *dst, const uint8_t *src[])
+{
+	DECLARE_SRC_POINTERS(T)
+
+	const SimdLoader<T> loader{ { prev, curr, next } };
+	debayerLineSimd<div, grLine, false>(dst, loader, debayerWidth_,
+					    red_, green_, blue_);
+}
+
+#endif /* DEBAYER_CPU_HAVE_SIMD */
+
+#if DEBAYER_CPU_HAVE_SIMD_LOOKUP
+
+template<bool grLine, bool oddPhase>
+void DebayerCpu::debayer10PSimd_BGR888(uint8_t *dst, const uint8_t *src[])
+{
+	const SimdLoader10P loader{ { src[0], src[1], src[2] } };
+	debayerLineSimd<1, grLine, oddPhase>(dst, loader, debayerWidth_,
+					     red_, green_, blue_);
+}
+
+#endif /* DEBAYER_CPU_HAVE_SIMD_LOOKUP */
+
+/*
+ * Check whether the vectorized implementation can be used on this CPU. The
+ * implementation relies on the baseline SIMD instruction set of the
+ * architecture only, there is thus no need for further feature detection.
+ */
+bool DebayerCpu::simdSupported()
+{
+#if DEBAYER_CPU_HAVE_SIMD
+	return true;
+#else
+	return false;
+#endif
+}
+
+template<typename T, unsigned int div, bool grLine>
+DebayerCpu::debayerFn DebayerCpu::simdFunction()
+{
+#if DEBAYER_CPU_HAVE_SIMD
+	return &DebayerCpu::debayerSimd_BGR888<T, div, grLine>;
+#else
+	return nullptr;
+#endif
+}
+
+template<bool grLine, bool oddPhase>
+DebayerCpu::debayerFn DebayerCpu::simdFunction10P()
+{
+#if DEBAYER_CPU_HAVE_SIMD_LOOKUP
+	return &DebayerCpu::debayer10PSimd_BGR888<grLine, oddPhase>;
+#else
+	return nullptr;
+#endif
+}
+
 static bool isStandardBayerOrder(BayerFormat::Order order)
 {
 	return order == BayerFormat::BGGR || order == BayerFormat::GBRG ||
@@ -280,7 +850,8 @@ int DebayerCpu::getInputConfig(PixelFormat inputFormat, DebayerInputConfig &conf
 		config.bpp = (bayerFormat.bitDepth + 7) & ~7;
 		config.patternSize.width = 2;
 		config.patternSize.height = 2;
-		config.outputFormats = std::vector<PixelFormat>({ formats::RGB888, formats::BGR888 });
+		config.outputFormats = std::vector<PixelFormat>({ formats::RGB888, formats::BGR888,
+								  formats::NV12, formats::YUYV });
 		return 0;
 	}
 
@@ -290,7 +861,8 @@ int DebayerCpu::getInputConfig(PixelFormat inputFormat, DebayerInputConfig &conf
 		config.bpp = 10;
 		config.patternSize.width = 4; /* 5 bytes per *4* pixels */
 		config.patternSize.height = 2;
-		config.outputFormats = std::vector<PixelFormat>({ formats::RGB888, formats::BGR888 });
+		config.outputFormats = std::vector<PixelFormat>({ formats::RGB888, formats::BGR888,
+								  formats::NV12, formats::YUYV });
 		return 0;
 	}
 
@@ -306,6 +878,16 @@ int DebayerCpu::getOutputConfig(PixelFormat outputFormat, DebayerOutputConfig &c
 		return 0;
 	}
 
+	if (outputFormat == formats::YUYV) {
+		config.bpp = 16;
+		return 0;
+	}
+
+	if (outputFormat == formats::NV12) {
+		config.bpp = 12;
+		return 0;
+	}
+
 	LOG(Debayer, Info)
 		<< "Unsupported output format " << outputFormat.toString();
 	return -EINVAL;
@@ -344,6 +926,10 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 
 	xShift_ = 0;
 	swapRedBlueGains_ = false;
+	convert_ = nullptr;
+
+	/* The vectorized functions need a line of at least kSimdLanes pixels */
+	const bool simd = simd_ && window_.width >= kSimdLanes;
 
 	auto invalidFmt = []() -> int {
 		LOG(Debayer, Error) << "Unsupported input output format combination";
@@ -353,6 +939,13 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 	switch (outputFormat) {
 	case formats::RGB888:
 		break;
+	case formats::YUYV:
+		/* Debayer to BGR888 line buffers and convert the lines */
+		convert_ = &DebayerCpu::convertYUYV;
+		break;
+	case formats::NV12:
+		convert_ = &DebayerCpu::convertNV12;
+		break;
 	case formats::BGR888:
 		/* Swap R and B in bayer order to generate BGR888 instead of RGB888 */
 		swapRedBlueGains_ = true;
@@ -383,16 +976,22 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 	    isStandardBayerOrder(bayerFormat.order)) {
 		switch (bayerFormat.bitDepth) {
 		case 8:
-			debayer0_ = &DebayerCpu::debayer8_BGBG_BGR888;
-			debayer1_ = &DebayerCpu::debayer8_GRGR_BGR888;
+			debayer0_ = simd ? simdFunction<uint8_t, 1, false>()
+					 : &DebayerCpu::debayer8_BGBG_BGR888;
+			debayer1_ = simd ? simdFunction<uint8_t, 1, true>()
+					 : &DebayerCpu::debayer8_GRGR_BGR888;
 			break;
 		case 10:
-			debayer0_ = &DebayerCpu::debayer10_BGBG_BGR888;
-			debayer1_ = &DebayerCpu::debayer10_GRGR_BGR888;
+			debayer0_ = simd ? simdFunction<uint16_t, 4, false>()
+					 : &DebayerCpu::debayer10_BGBG_BGR888;
+			debayer1_ = simd ? simdFunction<uint16_t, 4, true>()
+					 : &DebayerCpu::debayer10_GRGR_BGR888;
 			break;
 		case 12:
-			debayer0_ = &DebayerCpu::debayer12_BGBG_BGR888;
-			debayer1_ = &DebayerCpu::debayer12_GRGR_BGR888;
+			debayer0_ = simd ? simdFunction<uint16_t, 16, false>()
+					 : &DebayerCpu::debayer12_BGBG_BGR888;
+			debayer1_ = simd ? simdFunction<uint16_t, 16, true>()
+					 : &DebayerCpu::debayer12_GRGR_BGR888;
 			break;
 		}
 		setupStandardBayerOrder(bayerFormat.order);
@@ -401,22 +1000,34 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 
 	if (bayerFormat.bitDepth == 10 &&
 	    bayerFormat.packing == BayerFormat::Packing::CSI2) {
+		debayerFn bgbg = &DebayerCpu::debayer10P_BGBG_BGR888;
+		debayerFn grgr = &DebayerCpu::debayer10P_GRGR_BGR888;
+		debayerFn gbgb = &DebayerCpu::debayer10P_GBGB_BGR888;
+		debayerFn rgrg = &DebayerCpu::debayer10P_RGRG_BGR888;
+
+		if (simd && simdFunction10P<false, false>()) {
+			bgbg = simdFunction10P<false, false>();
+			grgr = simdFunction10P<true, false>();
+			gbgb = simdFunction10P<false, true>();
+			rgrg = simdFunction10P<true, true>();
+		}
+
 		switch (bayerFormat.order) {
 		case BayerFormat::BGGR:
-			debayer0_ = &DebayerCpu::debayer10P_BGBG_BGR888;
-			debayer1_ = &DebayerCpu::debayer10P_GRGR_BGR888;
+			debayer0_ = bgbg;
+			debayer1_ = grgr;
 			return 0;
 		case BayerFormat::GBRG:
-			debayer0_ = &DebayerCpu::debayer10P_GBGB_BGR888;
-			debayer1_ = &DebayerCpu::debayer10P_RGRG_BGR888;
+			debayer0_ = gbgb;
+			debayer1_ = rgrg;
 			return 0;
 		case BayerFormat::GRBG:
-			debayer0_ = &DebayerCpu::debayer10P_GRGR_BGR888;
-			debayer1_ = &DebayerCpu::debayer10P_BGBG_BGR888;
+			debayer0_ = grgr;
+			debayer1_ = bgbg;
 			return 0;
 		case BayerFormat::RGGB:
-			debayer0_ = &DebayerCpu::debayer10P_RGRG_BGR888;
-			debayer1_ = &DebayerCpu::debayer10P_GBGB_BGR888;
+			debayer0_ = rgrg;
+			debayer1_ = gbgb;
 			return 0;
 		default:
 			break;
@@ -426,6 +1037,56 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 	return invalidFmt();
 }
 
+void DebayerCpu::setBinningFunction(PixelFormat inputFormat)
+{
+	BayerFormat bayerFormat = BayerFormat::fromPixelFormat(inputFormat);
+
+	/* Swap R and B in bayer order to generate BGR888, as for debayering */
+	if (swapRedBlueGains_)
+		bayerFormat = bayerFormat.transform(Transform::Rot180);
+
+	static constexpr unsigned int indices[][4] = {
+		{ 0, 1, 2, 3 }, /* BGGR */
+		{ 1, 0, 3, 2 }, /* GBRG */
+		{ 2, 0, 3, 1 }, /* GRBG */
+		{ 3, 1, 2, 0 }, /* RGGB */
+	};
+
+	switch (bayerFormat.order) {
+	case BayerFormat::BGGR:
+		std::copy_n(indices[0], 4, binIndices_);
+		break;
+	case BayerFormat::GBRG:
+		std::copy_n(indices[1], 4, binIndices_);
+		break;
+	case BayerFormat::GRBG:
+		std::copy_n(indices[2], 4, binIndices_);
+		break;
+	case BayerFormat::RGGB:
+	default:
+		std::copy_n(indices[3], 4, binIndices_);
+		break;
+	}
+
+	if (bayerFormat.packing == BayerFormat::Packing::CSI2) {
+		/* Only use the 8 most significant bits of the pixels */
+		binShift_ = 0;
+		debayerBinned_ = binning_ == 2
+			? &DebayerCpu::debayerBinned_BGR888<BinLoader10P, 2>
+			: &DebayerCpu::debayerBinned_BGR888<BinLoader10P, 4>;
+	} else if (bayerFormat.bitDepth == 8) {
+		binShift_ = 0;
+		debayerBinned_ = binning_ == 2
+			? &DebayerCpu::debayerBinned_BGR888<BinLoader<uint8_t>, 2>
+			: &DebayerCpu::debayerBinned_BGR888<BinLoader<uint8_t>, 4>;
+	} else {
+		binShift_ = bayerFormat.bitDepth - 8;
+		debayerBinned_ = binning_ == 2
+			? &DebayerCpu::debayerBinned_BGR888<BinLoader<uint16_t>, 2>
+			: &DebayerCpu::debayerBinned_BGR888<BinLoader<uint16_t>, 4>;
+	}
+}
+
 int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 			  const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs)
 {
@@ -466,15 +1127,52 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 		return -EINVAL;
 	}
 
-	if (setDebayerFunctions(inputCfg.pixelFormat, outputCfg.pixelFormat) != 0)
-		return -EINVAL;
+	/*
+	 * Downscale by binning when the input is large enough for it, to
+	 * preserve the field of view and reduce the processing cost.
+	 * Otherwise crop the center of the input.
+	 */
+	binning_ = 1;
+	for (unsigned int scale = kMaxBinning; scale > 1; scale /= 2) {
+		if (outputCfg.size.width * scale <= outSizeRange.max.width &&
+		    outputCfg.size.height * scale <= outSizeRange.max.height) {
+			binning_ = scale;
+			break;
+		}
+	}
 
-	window_.x = ((inputCfg.size.width - outputCfg.size.width) / 2) &
+	window_.width = outputCfg.size.width * binning_;
+	window_.height = outputCfg.size.height * binning_;
+	window_.x = ((inputCfg.size.width - window_.width) / 2) &
 		    ~(inputConfig_.patternSize.width - 1);
-	window_.y = ((inputCfg.size.height - outputCfg.size.height) / 2) &
+	window_.y = ((inputCfg.size.height - window_.height) / 2) &
 		    ~(inputConfig_.patternSize.height - 1);
-	window_.width = outputCfg.size.width;
-	window_.height = outputCfg.size.height;
+
+	if (setDebayerFunctions(inputCfg.pixelFormat, outputCfg.pixelFormat) != 0)
+		return -EINVAL;
+
+	if (binning_ > 1) {
+		setBinningFunction(inputCfg.pixelFormat);
+		LOG(Debayer, Debug) << "Downscaling by " << binning_ << " with binning";
+	}
+
+	/*
+	 * Limit the digital zoom to kMaxZoom, and keep the crop wide enough
+	 * for the vectorized functions. Zooming is only implemented for Bayer
+	 * patterns repeating every 2 lines.
+	 */
+	const Size &patternSize = inputConfig_.patternSize;
+	if (patternSize.height == 2)
+		minCropSize_ = Size(std::max(window_.width / kMaxZoom, 2 * kSimdLanes),
+				    window_.height / kMaxZoom)
+				       .alignedUpTo(patternSize.width, patternSize.height)
+				       .boundedTo(window_.size());
+	else
+		minCropSize_ = window_.size();
+
+	crop_ = window_;
+	zoom_ = false;
+	debayerWidth_ = window_.width;
 
 	/* Don't pass x,y since process() already adjusts src before passing it */
 	stats_->setWindow(Rectangle(window_.size()));
@@ -483,17 +1181,14 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 	lineBufferPadding_ = inputConfig_.patternSize.width * inputConfig_.bpp / 8;
 	lineBufferLength_ = window_.width * inputConfig_.bpp / 8 +
 			    2 * lineBufferPadding_;
-	for (unsigned int i = 0;
-	     i < (inputConfig_.patternSize.height + 1) && enableInputMemcpy_;
-	     i++) {
-		free(lineBuffers_[i]);
-		lineBuffers_[i] = (uint8_t *)malloc(lineBufferLength_);
-		if (!lineBuffers_[i])
-			return -ENOMEM;
-	}
 
-	measuredFrames_ = 0;
-	frameProcessTime_ = 0;
+	int ret = setupStripes(threads_);
+	if (ret)
+		return ret;
+
+	MutexLocker locker(timingMutex_);
+	frameTimes_.fill({});
+	processedFrames_ = 0;
 
 	return 0;
 }
@@ -531,12 +1226,101 @@ DebayerCpu::strideAndFrameSize(const PixelFormat &outputFormat, const Size &size
 		return std::make_tuple(0, 0);
 
 	/* round up to multiple of 8 for 64 bits alignment */
-	unsigned int stride = (size.width * config.bpp / 8 + 7) & ~7;
+	const PixelFormatInfo &info = PixelFormatInfo::info(outputFormat);
+	unsigned int stride = info.stride(size.width, 0, 8);
 
-	return std::make_tuple(stride, stride * size.height);
+	return std::make_tuple(stride, info.frameSize(size, 8));
 }
 
-void DebayerCpu::setupInputMemcpy(const uint8_t *linePointers[])
+/*
+ * Split the window in count horizontal stripes and create the workers that
+ * debayer all stripes but the first one. The number of stripes is limited by
+ * the window height, as stripes start on a multiple of twice the pattern
+ * height. This keeps the lines sampled by the statistics identical to the
+ * ones sampled when processing the whole window in a single stripe.
+ */
+int DebayerCpu::setupStripes(unsigned int count)
+{
+	const unsigned int patternHeight = inputConfig_.patternSize.height;
+	/* Binning processes lines of YUV output formats in pairs */
+	const unsigned int align = 2 * std::max(patternHeight, binning_);
+	const unsigned int blocks = std::max(window_.height / align, 1U);
+
+	freeStripes();
+
+	count = std::clamp(count, 1U, blocks);
+	stripes_.resize(count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		Stripe &stripe = stripes_[i];
+
+		stripe.index = i;
+		stripe.yStart = blocks * i / count * align;
+		stripe.yEnd = i + 1 < count ? blocks * (i + 1) / count * align
+					    : window_.height;
+		stripe.lineBufferIndex = 0;
+
+		for (unsigned int j = 0; j < kMaxLineBuffers; j++)
+			stripe.lineBuffers[j] = nullptr;
+
+		for (unsigned int j = 0; j < 2; j++) {
+			stripe.bgrLines[j] = (uint8_t *)malloc(window_.width / binning_ * 3);
+			if (!stripe.bgrLines[j])
+				return -ENOMEM;
+		}
+
+		stripe.zoomLine = (uint8_t *)malloc(window_.width * 3);
+		if (!stripe.zoomLine)
+			return -ENOMEM;
+
+		for (unsigned int j = 0; j < (patternHeight + 1) && enableInputMemcpy_; j++) {
+			stripe.lineBuffers[j] = (uint8_t *)malloc(lineBufferLength_);
+			if (!stripe.lineBuffers[j])
+				return -ENOMEM;
+		}
+	}
+
+	for (unsigned int i = 1; i < count; i++) {
+		std::unique_ptr<Thread> thread = std::make_unique<Thread>();
+		std::unique_ptr<StripeWorker> worker = std::make_unique<StripeWorker>();
+
+		worker->moveToThread(thread.get());
+		thread->start();
+
+		stripeThreads_.push_back(std::move(thread));
+		stripeWorkers_.push_back(std::move(worker));
+	}
+
+	stats_->setStripeCount(count);
+
+	if (count > 1)
+		LOG(Debayer, Debug) << "Processing frames in " << count << " stripes";
+
+	return 0;
+}
+
+void DebayerCpu::freeStripes()
+{
+	for (std::unique_ptr<Thread> &thread : stripeThreads_) {
+		thread->exit();
+		thread->wait();
+	}
+
+	stripeWorkers_.clear();
+	stripeThreads_.clear();
+
+	for (Stripe &stripe : stripes_) {
+		for (unsigned int i = 0; i < kMaxLineBuffers; i++)
+			free(stripe.lineBuffers[i]);
+		for (unsigned int i = 0; i < 2; i++)
+			free(stripe.bgrLines[i]);
+		free(stripe.zoomLine);
+	}
+
+	stripes_.clear();
+}
+
+void DebayerCpu::setupInputMemcpy(Stripe &stripe, const uint8_t *linePointers[])
 {
 	const unsigned int patternHeight = inputConfig_.patternSize.height;
 
@@ -544,13 +1328,13 @@ void DebayerCpu::setupInputMemcpy(const uint8_t *linePointers[])
 		return;
 
 	for (unsigned int i = 0; i < patternHeight; i++) {
-		memcpy(lineBuffers_[i], linePointers[i + 1] - lineBufferPadding_,
+		memcpy(stripe.lineBuffers[i], linePointers[i + 1] - lineBufferPadding_,
 		       lineBufferLength_);
-		linePointers[i + 1] = lineBuffers_[i] + lineBufferPadding_;
+		linePointers[i + 1] = stripe.lineBuffers[i] + lineBufferPadding_;
 	}
 
-	/* Point lineBufferIndex_ to first unused lineBuffer */
-	lineBufferIndex_ = patternHeight;
+	/* Point lineBufferIndex to first unused lineBuffer */
+	stripe.lineBufferIndex = patternHeight;
 }
 
 void DebayerCpu::shiftLinePointers(const uint8_t *linePointers[], const uint8_t *src)
@@ -564,86 +1348,175 @@ void DebayerCpu::shiftLinePointers(const uint8_t *linePointers[], const uint8_t
 				      (patternHeight / 2) * (int)inputConfig_.stride;
 }
 
-void DebayerCpu::memcpyNextLine(const uint8_t *linePointers[])
+void DebayerCpu::memcpyNextLine(Stripe &stripe, const uint8_t *linePointers[])
 {
 	const unsigned int patternHeight = inputConfig_.patternSize.height;
 
 	if (!enableInputMemcpy_)
 		return;
 
-	memcpy(lineBuffers_[lineBufferIndex_], linePointers[patternHeight] - lineBufferPadding_,
-	       lineBufferLength_);
-	linePointers[patternHeight] = lineBuffers_[lineBufferIndex_] + lineBufferPadding_;
+	memcpy(stripe.lineBuffers[stripe.lineBufferIndex],
+	       linePointers[patternHeight] - lineBufferPadding_, lineBufferLength_);
+	linePointers[patternHeight] = stripe.lineBuffers[stripe.lineBufferIndex] +
+				      lineBufferPadding_;
 
-	lineBufferIndex_ = (lineBufferIndex_ + 1) % (patternHeight + 1);
+	stripe.lineBufferIndex = (stripe.lineBufferIndex + 1) % (patternHeight + 1);
 }
 
-void DebayerCpu::process2(const uint8_t *src, uint8_t *dst)
+/*
+ * Get the pointers to the lines rows[] of the input when zooming, src pointing
+ * to the left edge of the crop in the first line of the input. The lines are
+ * copied to the line buffers of the stripe, unless already copied for the
+ * previous output lines.
+ */
+void DebayerCpu::zoomLinePointers(Stripe &stripe, const uint8_t *src,
+				  const unsigned int rows[3], const uint8_t *linePointers[])
 {
-	unsigned int yEnd = window_.y + window_.height;
+	const unsigned int length = crop_.width * inputConfig_.bpp / 8 +
+				    2 * lineBufferPadding_;
+
+	for (unsigned int i = 0; i < 3; i++)
+		linePointers[i] = src + rows[i] * inputConfig_.stride;
+
+	if (!enableInputMemcpy_)
+		return;
+
+	for (unsigned int i = 0; i < 3; i++) {
+		auto inRows = [&](unsigned int row) {
+			return std::find(rows, rows + 3, row) != rows + 3;
+		};
+
+		unsigned int *begin = stripe.lineBufferRows;
+		unsigned int *end = begin + 3;
+		unsigned int *held = std::find(begin, end, rows[i]);
+
+		if (held == end) {
+			/* Reuse a line buffer not holding any of the lines */
+			held = std::find_if_not(begin, end, inRows);
+			memcpy(stripe.lineBuffers[held - begin],
+			       linePointers[i] - lineBufferPadding_, length);
+			*held = rows[i];
+		}
+
+		linePointers[i] = stripe.lineBuffers[held - begin] + lineBufferPadding_;
+	}
+}
+
+/*
+ * Get the destination of a line of a pair. For YUV output formats and when
+ * colour correction is enabled the lines are debayered to BGR888 line
+ * buffers, corrected and converted by convertLines() once both lines of the
+ * pair have been debayered.
+ */
+uint8_t *DebayerCpu::outputLine(Stripe &stripe, uint8_t *dst, unsigned int line)
+{
+	if (convert_ || colorCorrection_)
+		return stripe.bgrLines[line];
+
+	return dst + line * outputConfig_.stride;
+}
+
+void DebayerCpu::convertLines(Stripe &stripe, uint8_t *dst, unsigned int y)
+{
+	if (colorCorrection_) {
+		for (unsigned int i = 0; i < 2; i++) {
+			uint8_t *line = convert_ ? stripe.bgrLines[i]
+						 : dst + i * outputConfig_.stride;
+			correctLine(stripe.bgrLines[i], line, y + i);
+		}
+	}
+
+	if (convert_)
+		(this->*convert_)(stripe, dst, y);
+}
+
+void DebayerCpu::processStripe(Stripe &stripe, const uint8_t *src, uint8_t *dst)
+{
+	if (zoom_)
+		processZoomed(stripe, src, dst);
+	else if (binning_ > 1)
+		processBinned(stripe, src, dst);
+	else if (inputConfig_.patternSize.height == 2)
+		process2(stripe, src, dst);
+	else
+		process4(stripe, src, dst);
+}
+
+void DebayerCpu::process2(Stripe &stripe, const uint8_t *src, uint8_t *dst)
+{
+	const unsigned int yStart = window_.y + stripe.yStart;
+	unsigned int yEnd = window_.y + stripe.yEnd;
+	/* With window_.y == 0 the last 2 lines of the window need special handling */
+	const bool lastLines = window_.y == 0 && stripe.yEnd == window_.height;
 	/* Holds [0] previous- [1] current- [2] next-line */
 	const uint8_t *linePointers[3];
 
-	/* Adjust src to top left corner of the window */
-	src += window_.y * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	/* Adjust src and dst to top left corner of the stripe */
+	src += yStart * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	dst += stripe.yStart * outputConfig_.stride;
 
 	/* [x] becomes [x - 1] after initial shiftLinePointers() call */
-	if (window_.y) {
+	if (yStart) {
 		linePointers[1] = src - inputConfig_.stride; /* previous-line */
 		linePointers[2] = src;
 	} else {
-		/* window_.y == 0, use the next line as prev line */
+		/* yStart == 0, use the next line as prev line */
 		linePointers[1] = src + inputConfig_.stride;
 		linePointers[2] = src;
-		/* Last 2 lines also need special handling */
-		yEnd -= 2;
 	}
 
-	setupInputMemcpy(linePointers);
+	if (lastLines)
+		yEnd -= 2;
+
+	setupInputMemcpy(stripe, linePointers);
 
-	for (unsigned int y = window_.y; y < yEnd; y += 2) {
+	for (unsigned int y = yStart; y < yEnd; y += 2) {
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine0(y, linePointers);
-		(this->*debayer0_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		stats_->processLine0(y, linePointers, stripe.index);
+		(this->*debayer0_)(outputLine(stripe, dst, 0), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		(this->*debayer1_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		(this->*debayer1_)(outputLine(stripe, dst, 1), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		convertLines(stripe, dst, y - window_.y);
+		dst += 2 * outputConfig_.stride;
 	}
 
-	if (window_.y == 0) {
+	if (lastLines) {
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine0(yEnd, linePointers);
-		(this->*debayer0_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		stats_->processLine0(yEnd, linePointers, stripe.index);
+		(this->*debayer0_)(outputLine(stripe, dst, 0), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
 		/* next line may point outside of src, use prev. */
 		linePointers[2] = linePointers[0];
-		(this->*debayer1_)(dst, linePointers);
+		(this->*debayer1_)(outputLine(stripe, dst, 1), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		convertLines(stripe, dst, yEnd - window_.y);
+		dst += 2 * outputConfig_.stride;
 	}
 }
 
-void DebayerCpu::process4(const uint8_t *src, uint8_t *dst)
+void DebayerCpu::process4(Stripe &stripe, const uint8_t *src, uint8_t *dst)
 {
-	const unsigned int yEnd = window_.y + window_.height;
+	const unsigned int yStart = window_.y + stripe.yStart;
+	const unsigned int yEnd = window_.y + stripe.yEnd;
 	/*
 	 * This holds pointers to [0] 2-lines-up [1] 1-line-up [2] current-line
 	 * [3] 1-line-down [4] 2-lines-down.
 	 */
 	const uint8_t *linePointers[5];
 
-	/* Adjust src to top left corner of the window */
-	src += window_.y * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	/* Adjust src and dst to top left corner of the stripe */
+	src += yStart * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	dst += stripe.yStart * outputConfig_.stride;
 
 	/* [x] becomes [x - 1] after initial shiftLinePointers() call */
 	linePointers[1] = src - 2 * inputConfig_.stride;
@@ -651,55 +1524,213 @@ void DebayerCpu::process4(const uint8_t *src, uint8_t *dst)
 	linePointers[3] = src;
 	linePointers[4] = src + inputConfig_.stride;
 
-	setupInputMemcpy(linePointers);
+	setupInputMemcpy(stripe, linePointers);
 
-	for (unsigned int y = window_.y; y < yEnd; y += 4) {
+	for (unsigned int y = yStart; y < yEnd; y += 4) {
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine0(y, linePointers);
-		(this->*debayer0_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		stats_->processLine0(y, linePointers, stripe.index);
+		(this->*debayer0_)(outputLine(stripe, dst, 0), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		(this->*debayer1_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		(this->*debayer1_)(outputLine(stripe, dst, 1), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		convertLines(stripe, dst, y - window_.y);
+		dst += 2 * outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine2(y, linePointers);
-		(this->*debayer2_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		stats_->processLine2(y, linePointers, stripe.index);
+		(this->*debayer2_)(outputLine(stripe, dst, 0), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		(this->*debayer3_)(dst, linePointers);
+		memcpyNextLine(stripe, linePointers);
+		(this->*debayer3_)(outputLine(stripe, dst, 1), linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		convertLines(stripe, dst, y + 2 - window_.y);
+		dst += 2 * outputConfig_.stride;
 	}
 }
 
-static inline int64_t timeDiff(timespec &after, timespec &before)
+/*
+ * Each output line is computed from binning_ input lines. The input lines are
+ * read once only, they are thus not copied to the line buffers.
+ */
+void DebayerCpu::processBinned(Stripe &stripe, const uint8_t *src, uint8_t *dst)
 {
-	return (after.tv_sec - before.tv_sec) * 1000000000LL +
-	       (int64_t)after.tv_nsec - (int64_t)before.tv_nsec;
+	const unsigned int stride = inputConfig_.stride;
+	const unsigned int yStart = window_.y + stripe.yStart;
+	const unsigned int yEnd = window_.y + stripe.yEnd;
+	const uint8_t *linePointers[kMaxBinning];
+
+	/* Adjust src and dst to top left corner of the stripe */
+	src += yStart * stride + window_.x * inputConfig_.bpp / 8;
+	dst += stripe.yStart / binning_ * outputConfig_.stride;
+
+	for (unsigned int y = yStart; y < yEnd; y += 2 * binning_) {
+		for (unsigned int line = 0; line < 2; line++) {
+			for (unsigned int i = 0; i < binning_; i++)
+				linePointers[i] = src + i * stride;
+
+			/* Gather the statistics as when processing the full window */
+			for (unsigned int i = 0; i < binning_; i += 2) {
+				const uint8_t *statsLines[3] = {
+					linePointers[i], linePointers[i], linePointers[i + 1],
+				};
+
+				stats_->processLine0(y + line * binning_ + i, statsLines,
+						     stripe.index);
+			}
+
+			(this->*debayerBinned_)(outputLine(stripe, dst, line), linePointers);
+			src += binning_ * stride;
+		}
+
+		convertLines(stripe, dst, (y - window_.y) / binning_);
+		dst += 2 * outputConfig_.stride;
+	}
 }
 
-void DebayerCpu::process(FrameBuffer *input, FrameBuffer *output, DebayerParams params)
+/*
+ * Scale a line debayered to BGR888 to the output width, picking the nearest
+ * pixel of the source line for each output pixel.
+ */
+static void scaleLine(const uint8_t *src, uint8_t *dst, unsigned int srcWidth,
+		      unsigned int dstWidth)
 {
-	timespec frameStartTime;
+	/* Position in the source line in 16.16 fixed point */
+	const uint32_t step = (srcWidth << 16) / dstWidth;
+	uint32_t pos = step / 2;
+
+	for (unsigned int x = 0; x < dstWidth; x++) {
+		const uint8_t *pixel = src + (pos >> 16) * 3;
+
+		*dst++ = pixel[0];
+		*dst++ = pixel[1];
+		*dst++ = pixel[2];
+		pos += step;
+	}
+}
+
+/*
+ * Scale crop_ to the output, picking the nearest input line for each output
+ * line. Only the lines and columns of the crop are read. The input lines are
+ * debayered at the crop width and scaled horizontally to the output. When
+ * upscaling, output lines picking the same input line reuse it.
+ *
+ * \todo Interpolate to improve the quality of upscaled lines, bin when the
+ * crop is large enough, and apply the lens shading correction grid at the
+ * position of the crop in the window
+ */
+void DebayerCpu::processZoomed(Stripe &stripe, const uint8_t *src, uint8_t *dst)
+{
+	const unsigned int width = window_.width / binning_;
+	const unsigned int height = window_.height / binning_;
+	const unsigned int yStart = stripe.yStart / binning_;
+	const unsigned int yEnd = stripe.yEnd / binning_;
+	/* As in process2(), a window starting at line 0 may end at the last one */
+	const unsigned int lastLine = window_.y + window_.height - 1;
+	const bool scale = crop_.width != width;
+	unsigned int debayeredLine = UINT_MAX;
+	unsigned int statsLine = UINT_MAX;
+
+	src += crop_.x * inputConfig_.bpp / 8;
+	dst += yStart * outputConfig_.stride;
+
+	for (unsigned int i = 0; i < kMaxLineBuffers; i++)
+		stripe.lineBufferRows[i] = UINT_MAX;
+
+	for (unsigned int y = yStart; y < yEnd; y += 2) {
+		for (unsigned int line = 0; line < 2; line++) {
+			const unsigned int row = crop_.y +
+				(2 * (y + line) + 1) * crop_.height / (2 * height);
+			uint8_t *out = outputLine(stripe, dst, line);
+
+			if (row != debayeredLine || !scale) {
+				/* Mirror the lines at the edges of the input */
+				const unsigned int rows[3] = {
+					row ? row - 1 : row + 1,
+					row,
+					row < lastLine || window_.y ? row + 1 : row - 1,
+				};
+				const uint8_t *linePointers[3];
+
+				zoomLinePointers(stripe, src, rows, linePointers);
+
+				/* Gather the statistics on the lines of the crop */
+				if (!(row & 1) && row != statsLine) {
+					stats_->processLine0(row - crop_.y, linePointers,
+							     stripe.index);
+					statsLine = row;
+				}
+
+				debayerFn debayer = row & 1 ? debayer1_ : debayer0_;
+				(this->*debayer)(scale ? stripe.zoomLine : out, linePointers);
+				debayeredLine = row;
+			}
+
+			if (scale)
+				scaleLine(stripe.zoomLine, out, crop_.width, width);
+		}
 
-	if (measuredFrames_ < DebayerCpu::kLastFrameToMeasure) {
-		frameStartTime = {};
-		clock_gettime(CLOCK_MONOTONIC_RAW, &frameStartTime);
+		convertLines(stripe, dst, y);
+		dst += 2 * outputConfig_.stride;
+	}
+}
+
+/*
+ * Select the part of window_ scaled to the output for the next frames, from
+ * the crop requested in input pixels. The statistics are gathered on the crop.
+ */
+void DebayerCpu::setCrop(const Rectangle &crop)
+{
+	const Size &patternSize = inputConfig_.patternSize;
+	Rectangle rect = window_;
+
+	if (!crop.isNull()) {
+		const Size size = crop.size()
+					  .alignedDownTo(patternSize.width, patternSize.height)
+					  .expandedTo(minCropSize_)
+					  .boundedTo(window_.size());
+
+		rect = size.centeredTo(crop.center()).enclosedIn(window_);
+		rect.x &= ~(patternSize.width - 1);
+		rect.y &= ~(patternSize.height - 1);
 	}
 
-	green_ = params.green;
-	red_ = swapRedBlueGains_ ? params.blue : params.red;
-	blue_ = swapRedBlueGains_ ? params.red : params.blue;
+	if (rect == crop_)
+		return;
+
+	crop_ = rect;
+	zoom_ = crop_ != window_;
+	debayerWidth_ = crop_.width;
+
+	stats_->setWindow(Rectangle(crop_.size()));
+
+	LOG(Debayer, Debug) << "Scaling " << crop_ << " to the output";
+}
+
+void DebayerCpu::process(uint32_t frame, FrameBuffer *input, FrameBuffer *output,
+			 const DebayerParams *params, const Rectangle &crop)
+{
+	const utils::time_point start = utils::clock::now();
+
+	LIBCAMERA_TRACEPOINT(debayer_begin, frame, input, output);
+
+	setCrop(crop);
+
+	green_ = params->green;
+	red_ = swapRedBlueGains_ ? params->blue : params->red;
+	blue_ = swapRedBlueGains_ ? params->red : params->blue;
+
+	colorCorrection_ = params->colorCorrection;
+	if (colorCorrection_)
+		setColorCorrection(params);
 
 	/* Copy metadata from the input buffer */
 	FrameMetadata &metadata = output->_d()->metadata();
@@ -707,9 +1738,15 @@ void DebayerCpu::process(FrameBuffer *input, FrameBuffer *output, DebayerParams
 	metadata.sequence = input->metadata().sequence;
 	metadata.timestamp = input->metadata().timestamp;
 
-	MappedFrameBuffer in(input, MappedFrameBuffer::MapFlag::Read);
-	MappedFrameBuffer out(output, MappedFrameBuffer::MapFlag::Write);
-	if (!in.isValid() || !out.isValid()) {
+	/* Bracket the CPU accesses to the buffers for cache coherency */
+	std::vector<DmaSyncer> dmaSyncers;
+	MappedFrameBuffer *in = inputMappings_.map(input,
+						   MappedFrameBuffer::MapFlag::Read,
+						   &dmaSyncers);
+	MappedFrameBuffer *out = outputMappings_.map(output,
+						     MappedFrameBuffer::MapFlag::Write,
+						     &dmaSyncers);
+	if (!in || !out) {
 		LOG(Debayer, Error) << "mmap-ing buffer(s) failed";
 		metadata.status = FrameMetadata::FrameError;
 		return;
@@ -717,35 +1754,131 @@ void DebayerCpu::process(FrameBuffer *input, FrameBuffer *output, DebayerParams
 
 	stats_->startFrame();
 
-	if (inputConfig_.patternSize.height == 2)
-		process2(in.planes()[0].data(), out.planes()[0].data());
-	else
-		process4(in.planes()[0].data(), out.planes()[0].data());
+	const uint8_t *src = in->planes()[0].data();
+	uint8_t *dst = out->planes()[0].data();
+
+	/*
+	 * Hand all stripes but the first one to the workers, debayer the first
+	 * stripe in this thread and wait for the workers to complete.
+	 */
+	for (unsigned int i = 1; i < stripes_.size(); i++)
+		stripeWorkers_[i - 1]->invokeMethod(&StripeWorker::process,
+						    ConnectionTypeQueued, this,
+						    &stripes_[i], src, dst);
+
+	processStripe(stripes_[0], src, dst);
+
+	stripesDone_.acquire(stripes_.size() - 1);
 
-	metadata.planes()[0].bytesused = out.planes()[0].size();
+	dmaSyncers.clear();
+
+	metadata.planes()[0].bytesused = out->planes()[0].size();
 
 	/* Measure before emitting signals */
-	if (measuredFrames_ < DebayerCpu::kLastFrameToMeasure &&
-	    ++measuredFrames_ > DebayerCpu::kFramesToSkip) {
-		timespec frameEndTime = {};
-		clock_gettime(CLOCK_MONOTONIC_RAW, &frameEndTime);
-		frameProcessTime_ += timeDiff(frameEndTime, frameStartTime);
-		if (measuredFrames_ == DebayerCpu::kLastFrameToMeasure) {
-			const unsigned int measuredFrames = DebayerCpu::kLastFrameToMeasure -
-							    DebayerCpu::kFramesToSkip;
-			LOG(Debayer, Info)
-				<< "Processed " << measuredFrames
-				<< " frames in " << frameProcessTime_ / 1000 << "us, "
-				<< frameProcessTime_ / (1000 * measuredFrames)
-				<< " us/frame";
-		}
-	}
+	recordProcessingTime(start);
 
-	stats_->finishFrame();
+	LIBCAMERA_TRACEPOINT(debayer_end, frame, input, output);
+
+	stats_->finishFrame(frame);
 	outputBufferReady.emit(output);
 	inputBufferReady.emit(input);
 }
 
+/**
+ * \brief Complete a frame without processing it
+ * \param[in] input The input buffer
+ * \param[in] output The output buffer
+ *
+ * The output buffer is completed with the FrameError status, in order with the
+ * frames queued for processing before it. This allows shedding load when
+ * processing falls behind the frame rate.
+ */
+void DebayerCpu::drop(FrameBuffer *input, FrameBuffer *output)
+{
+	FrameMetadata &metadata = output->_d()->metadata();
+	metadata.status = FrameMetadata::FrameError;
+	metadata.sequence = input->metadata().sequence;
+	metadata.timestamp = input->metadata().timestamp;
+	metadata.planes()[0].bytesused = 0;
+
+	outputBufferReady.emit(output);
+	inputBufferReady.emit(input);
+}
+
+/**
+ * \struct DebayerCpu::ProcessingTime
+ * \brief Time spent processing frames
+ *
+ * \var DebayerCpu::ProcessingTime::frames
+ * \brief Number of frames processed since the last configuration
+ *
+ * \var DebayerCpu::ProcessingTime::last
+ * \brief Processing time of the last frame
+ *
+ * \var DebayerCpu::ProcessingTime::average
+ * \brief Average processing time over the last frames
+ *
+ * \var DebayerCpu::ProcessingTime::max
+ * \brief Longest processing time over the last frames
+ */
+
+/**
+ * \brief Get the time spent processing the most recent frames
+ *
+ * The average and maximum are computed over a rolling window of the last 30
+ * frames processed. This function may be called from any thread.
+ *
+ * \return The processing time statistics
+ */
+DebayerCpu::ProcessingTime DebayerCpu::processingTime()
+{
+	MutexLocker locker(timingMutex_);
+	const unsigned int count =
+		std::min<uint64_t>(processedFrames_, kProcessingTimeWindow);
+	ProcessingTime time = {};
+	utils::duration total{};
+
+	time.frames = processedFrames_;
+	if (!count)
+		return time;
+
+	for (unsigned int i = 0; i < count; i++) {
+		total += frameTimes_[i];
+		time.max = std::max<utils::Duration>(time.max, frameTimes_[i]);
+	}
+
+	time.last = frameTimes_[(processedFrames_ - 1) % kProcessingTimeWindow];
+	time.average = utils::Duration(total) / count;
+
+	return time;
+}
+
+/*
+ * Record the processing time of a frame, from its start time. This must be
+ * called before signalling the completion of the frame.
+ */
+void DebayerCpu::recordProcessingTime(const utils::time_point &start)
+{
+	const utils::duration frameTime = utils::clock::now() - start;
+
+	MutexLocker locker(timingMutex_);
+	frameTimes_[processedFrames_ % kProcessingTimeWindow] = frameTime;
+	processedFrames_++;
+}
+
+/**
+ * \brief Stop processing frames
+ *
+ * Release the cached mappings of the buffers processed so far, as the buffers
+ * may be freed once streaming stops. This must not be called while a frame
+ * is being processed.
+ */
+void DebayerCpu::stop()
+{
+	inputMappings_.clear();
+	outputMappings_.clear();
+}
+
 SizeRange DebayerCpu::sizes(PixelFormat inputFormat, const Size &inputSize)
 {
 	Size patternSize = this->patternSize(inputFormat);
@@ -11,13 +11,19 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <stdint.h>
 #include <vector>
 
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
+#include <libcamera/base/semaphore.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/utils.h>
 
 #include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/mapped_framebuffer.h"
 
 #include "debayer.h"
 #include "swstats_cpu.h"
@@ -36,22 +42,65 @@ public:
 	std::vector<PixelFormat> formats(PixelFormat input);
 	std::tuple<unsigned int, unsigned int>
 	strideAndFrameSize(const PixelFormat &outputFormat, const Size &size);
-	void process(FrameBuffer *input, FrameBuffer *output, DebayerParams params);
+	void process(uint32_t frame, FrameBuffer *input, FrameBuffer *output,
+		     const DebayerParams *params, const Rectangle &crop);
+	void drop(FrameBuffer *input, FrameBuffer *output);
+	virtual void stop();
 	SizeRange sizes(PixelFormat inputFormat, const Size &inputSize);
 
 	/**
-	 * \brief Get the file descriptor for the statistics
+	 * \brief Get the output frame size
 	 *
-	 * \return the file descriptor pointing to the statistics
+	 * \return The output frame size
 	 */
-	const SharedFD &getStatsFD() { return stats_->getStatsFD(); }
+	unsigned int frameSize() { return outputConfig_.frameSize; }
 
 	/**
-	 * \brief Get the output frame size
+	 * \brief Get the smallest crop rectangle size supported for digital zoom
 	 *
-	 * \return The output frame size
+	 * \return The minimum crop size, in input pixels
 	 */
-	unsigned int frameSize() { return outputConfig_.frameSize; }
+	const Size &minCropSize() const { return minCropSize_; }
+
+	struct ProcessingTime {
+		uint64_t frames;
+		utils::Duration last;
+		utils::Duration average;
+		utils::Duration max;
+	};
+
+	ProcessingTime processingTime();
+
+protected:
+	struct DebayerInputConfig {
+		Size patternSize;
+		unsigned int bpp; /* Memory used per pixel, not precision */
+		unsigned int stride;
+		std::vector<PixelFormat> outputFormats;
+	};
+
+	struct DebayerOutputConfig {
+		unsigned int bpp; /* Memory used per pixel, not precision */
+		unsigned int stride;
+		unsigned int frameSize;
+	};
+
+	void recordProcessingTime(const utils::time_point &start);
+	void setCrop(const Rectangle &crop);
+
+	Rectangle window_;
+	DebayerInputConfig inputConfig_;
+	DebayerOutputConfig outputConfig_;
+	std::unique_ptr<SwStatsCpu> stats_;
+	MappedFrameBufferCache inputMappings_;
+	MappedFrameBufferCache outputMappings_;
+	unsigned int xShift_; /* Offset of 0/1 applied to window_.x */
+	bool swapRedBlueGains_;
+	/* Downscaling factor applied by binning, window_ is in input pixels */
+	unsigned int binning_;
+	/* Part of window_ scaled to the output, zoom_ is set when smaller */
+	Rectangle crop_;
+	bool zoom_;
 
 private:
 	/**
@@ -99,55 +148,146 @@ private:
 	void debayer10P_GBGB_BGR888(uint8_t *dst, const uint8_t *src[]);
 	void debayer10P_RGRG_BGR888(uint8_t *dst, const uint8_t *src[]);
 
-	struct DebayerInputConfig {
-		Size patternSize;
-		unsigned int bpp; /* Memory used per pixel, not precision */
-		unsigned int stride;
-		std::vector<PixelFormat> outputFormats;
+	/*
+	 * Vectorized versions of the above functions, producing bit-exact
+	 * output. The grLine and oddPhase template parameters select the line
+	 * type (BGBG or GRGR) and whether the line starts with a green pixel.
+	 */
+	template<typename T, unsigned int div, bool grLine>
+	void debayerSimd_BGR888(uint8_t *dst, const uint8_t *src[]);
+	template<bool grLine, bool oddPhase>
+	void debayer10PSimd_BGR888(uint8_t *dst, const uint8_t *src[]);
+
+	/*
+	 * Downscaling versions of the above functions, averaging the pixels of
+	 * each colour in blocks of scale x scale pixels. src holds scale lines.
+	 */
+	template<typename Loader, unsigned int scale>
+	void debayerBinned_BGR888(uint8_t *dst, const uint8_t *src[]);
+
+	static bool simdSupported();
+	template<typename T, unsigned int div, bool grLine>
+	static debayerFn simdFunction();
+	template<bool grLine, bool oddPhase>
+	static debayerFn simdFunction10P();
+
+	/* Max. supported Bayer pattern height is 4, debayering this requires 5 lines */
+	static constexpr unsigned int kMaxLineBuffers = 5;
+
+	/*
+	 * A horizontal stripe of the window, debayered independently from the
+	 * other stripes. yStart and yEnd are relative to window_.y.
+	 */
+	struct Stripe {
+		unsigned int index;
+		unsigned int yStart;
+		unsigned int yEnd;
+		uint8_t *lineBuffers[kMaxLineBuffers];
+		unsigned int lineBufferIndex;
+		/* Input lines held by the line buffers when zooming, or UINT_MAX */
+		unsigned int lineBufferRows[kMaxLineBuffers];
+		/* Crop line debayered before scaling to the output when zooming */
+		uint8_t *zoomLine;
+		/* Lines debayered to BGR888 before colour correction or conversion */
+		uint8_t *bgrLines[2];
 	};
 
-	struct DebayerOutputConfig {
-		unsigned int bpp; /* Memory used per pixel, not precision */
-		unsigned int stride;
-		unsigned int frameSize;
+	/**
+	 * \brief Called to convert 2 lines debayered to BGR888 to the output format
+	 * \param[in] stripe The stripe holding the debayered lines
+	 * \param[out] dst Pointer to the start of the first output line
+	 * \param[in] y The index of the first output line in the window
+	 */
+	using convertFn = void (DebayerCpu::*)(const Stripe &stripe, uint8_t *dst,
+					       unsigned int y);
+
+	void convertYUYV(const Stripe &stripe, uint8_t *dst, unsigned int y);
+	void convertNV12(const Stripe &stripe, uint8_t *dst, unsigned int y);
+
+	void setColorCorrection(const DebayerParams *params);
+	void correctLine(const uint8_t *src, uint8_t *dst, unsigned int y);
+
+	class StripeWorker : public Object
+	{
+	public:
+		void process(DebayerCpu *debayer, Stripe *stripe,
+			     const uint8_t *src, uint8_t *dst);
 	};
 
 	int getInputConfig(PixelFormat inputFormat, DebayerInputConfig &config);
 	int getOutputConfig(PixelFormat outputFormat, DebayerOutputConfig &config);
 	int setupStandardBayerOrder(BayerFormat::Order order);
 	int setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputFormat);
-	void setupInputMemcpy(const uint8_t *linePointers[]);
+	void setBinningFunction(PixelFormat inputFormat);
+	int setupStripes(unsigned int count);
+	void freeStripes();
+	void setupInputMemcpy(Stripe &stripe, const uint8_t *linePointers[]);
 	void shiftLinePointers(const uint8_t *linePointers[], const uint8_t *src);
-	void memcpyNextLine(const uint8_t *linePointers[]);
-	void process2(const uint8_t *src, uint8_t *dst);
-	void process4(const uint8_t *src, uint8_t *dst);
+	void memcpyNextLine(Stripe &stripe, const uint8_t *linePointers[]);
+	void zoomLinePointers(Stripe &stripe, const uint8_t *src,
+			      const unsigned int rows[3], const uint8_t *linePointers[]);
+	uint8_t *outputLine(Stripe &stripe, uint8_t *dst, unsigned int line);
+	void convertLines(Stripe &stripe, uint8_t *dst, unsigned int y);
+	void processStripe(Stripe &stripe, const uint8_t *src, uint8_t *dst);
+	void process2(Stripe &stripe, const uint8_t *src, uint8_t *dst);
+	void process4(Stripe &stripe, const uint8_t *src, uint8_t *dst);
+	void processBinned(Stripe &stripe, const uint8_t *src, uint8_t *dst);
+	void processZoomed(Stripe &stripe, const uint8_t *src, uint8_t *dst);
 
-	/* Max. supported Bayer pattern height is 4, debayering this requires 5 lines */
-	static constexpr unsigned int kMaxLineBuffers = 5;
+	/* Upper limit for the number of stripes a frame is split in */
+	static constexpr unsigned int kMaxStripes = 16;
+	/* Largest downscaling factor applied by binning */
+	static constexpr unsigned int kMaxBinning = 4;
+	/* Largest digital zoom factor, relative to window_ */
+	static constexpr unsigned int kMaxZoom = 8;
 
 	DebayerParams::ColorLookupTable red_;
 	DebayerParams::ColorLookupTable green_;
 	DebayerParams::ColorLookupTable blue_;
+	/*
+	 * Colour correction parameters of the current frame, in the order of
+	 * the colours of the debayered pixels in memory.
+	 */
+	bool colorCorrection_;
+	std::array<DebayerParams::LscGrid, 3> lsc_;
+	int32_t ccm_[3][3];
+	DebayerParams::GammaLookupTable gamma_;
 	debayerFn debayer0_;
 	debayerFn debayer1_;
 	debayerFn debayer2_;
 	debayerFn debayer3_;
-	Rectangle window_;
-	DebayerInputConfig inputConfig_;
-	DebayerOutputConfig outputConfig_;
-	std::unique_ptr<SwStatsCpu> stats_;
-	uint8_t *lineBuffers_[kMaxLineBuffers];
+	/* Conversion of the debayered lines for YUV output formats */
+	convertFn convert_;
+	debayerFn debayerBinned_;
+	/*
+	 * Index of the blue, green and red pixels in a 2x2 block of the Bayer
+	 * pattern, in raster order, with red and blue swapped for BGR888.
+	 */
+	unsigned int binIndices_[4];
+	unsigned int binShift_;
+	bool simd_;
+	/* Width of the lines debayered, the crop width when zooming */
+	unsigned int debayerWidth_;
+	Size minCropSize_;
 	unsigned int lineBufferLength_;
 	unsigned int lineBufferPadding_;
-	unsigned int lineBufferIndex_;
-	unsigned int xShift_; /* Offset of 0/1 applied to window_.x */
+	/* Number of stripes requested through LIBCAMERA_SOFTISP_THREADS */
+	unsigned int threads_;
+	std::vector<Stripe> stripes_;
+	/* Threads must outlive the workers bound to them, keep this order */
+	std::vector<std::unique_ptr<Thread>> stripeThreads_;
+	std::vector<std::unique_ptr<StripeWorker>> stripeWorkers_;
+	Semaphore stripesDone_;
 	bool enableInputMemcpy_;
-	bool swapRedBlueGains_;
-	unsigned int measuredFrames_;
-	int64_t frameProcessTime_;
-	/* Skip 30 frames for things to stabilize then measure 30 frames */
-	static constexpr unsigned int kFramesToSkip = 30;
-	static constexpr unsigned int kLastFrameToMeasure = 60;
+
+	/* Number of frames the average and max processing times are computed on */
+	static constexpr unsigned int kProcessingTimeWindow = 30;
+
+	/* Written in the thread processing frames, read from any thread */
+	Mutex timingMutex_;
+	std::array<utils::duration, kProcessingTimeWindow> frameTimes_
+		LIBCAMERA_TSA_GUARDED_BY(timingMutex_);
+	uint64_t processedFrames_ LIBCAMERA_TSA_GUARDED_BY(timingMutex_);
 };
 
 } /* namespace libcamera */
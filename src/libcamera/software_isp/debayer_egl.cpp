@@ -0,0 +1,757 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * GPU based debayering class
+ */
+
+#include "debayer_egl.h"
+
+#include <string.h>
+
+#include <libcamera/formats.h>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/dma_buf_allocator.h"
+#include "libcamera/internal/framebuffer.h"
+
+namespace libcamera {
+
+/**
+ * \class DebayerEGL
+ * \brief Class for debayering on the GPU
+ *
+ * Implementation of debayering with OpenGL ES 3.0 through a surfaceless EGL
+ * context. The interpolation, colour lookup and output packing are performed
+ * by a fragment shader producing bit-exact results with DebayerCpu, while the
+ * statistics are gathered on the CPU concurrently with the GPU processing.
+ *
+ * The input and output buffers are imported as EGLImage when the EGL
+ * implementation supports dma-buf import, and copied to and from textures
+ * otherwise. If no usable EGL context can be created, processing falls back to
+ * the CPU implementation.
+ */
+
+namespace {
+
+const char *kVertexShader = R"(#version 300 es
+void main()
+{
+	/* A single triangle covering the whole viewport */
+	vec2 pos = vec2(float((gl_VertexID & 1) << 2),
+			float((gl_VertexID & 2) << 1)) - 1.0;
+	gl_Position = vec4(pos, 0.0, 1.0);
+}
+)";
+
+/*
+ * Each output texel holds 4 consecutive bytes of a line of the BGR888 output
+ * stream, allowing the output to be written with the RGBA8 format. The
+ * computations match the CPU implementation: integer sums of the neighbouring
+ * pixels of the same colour, shifted right to 8-bit values and mapped through
+ * the colour lookup tables.
+ */
+const char *kFragmentShader = R"(#version 300 es
+precision highp float;
+precision highp int;
+
+uniform highp sampler2D inputTexture;
+uniform highp sampler2D lutTexture;
+uniform ivec2 origin;
+uniform int width;
+uniform int height;
+uniform bool mirror;
+uniform int format;
+uniform int shift;
+uniform ivec2 redPosition;
+
+out vec4 fragColor;
+
+uint byte(int x, int y)
+{
+	return uint(texelFetch(inputTexture, ivec2(x, y), 0).r * 255.0 + 0.5);
+}
+
+uint pixel(int x, int y)
+{
+	/* 8 MSBs of 4 pixels followed by a byte of LSBs */
+	if (format == 2)
+		return byte((x >> 2) * 5 + (x & 3), y);
+
+	/* Little endian 16-bit values */
+	if (format == 1)
+		return byte(x * 2, y) | (byte(x * 2 + 1, y) << 8);
+
+	return byte(x, y);
+}
+
+vec3 debayer(int px, int py)
+{
+	int x = origin.x + px;
+	int y = origin.y + py;
+	int yp = y - 1;
+	int yn = y + 1;
+
+	/* Mirror the first and last lines when there is no border */
+	if (mirror && py == 0)
+		yp = yn;
+	if (mirror && py == height - 1)
+		yn = yp;
+
+	uint p = pixel(x, yp);
+	uint pl = pixel(x - 1, yp);
+	uint pr = pixel(x + 1, yp);
+	uint c = pixel(x, y);
+	uint cl = pixel(x - 1, y);
+	uint cr = pixel(x + 1, y);
+	uint n = pixel(x, yn);
+	uint nl = pixel(x - 1, yn);
+	uint nr = pixel(x + 1, yn);
+
+	uint cross = (p + cl + cr + n) >> (shift + 2);
+	uint diag = (pl + pr + nl + nr) >> (shift + 2);
+	uint hor = (cl + cr) >> (shift + 1);
+	uint ver = (p + n) >> (shift + 1);
+	uint cen = c >> shift;
+
+	bool redLine = ((y ^ redPosition.y) & 1) == 0;
+	bool redColumn = ((x ^ redPosition.x) & 1) == 0;
+
+	/* Blue, green and red values, in the output byte order */
+	uvec3 bgr;
+	if (redLine && redColumn)
+		bgr = uvec3(diag, cross, cen);
+	else if (!redLine && !redColumn)
+		bgr = uvec3(cen, cross, diag);
+	else if (redLine)
+		bgr = uvec3(ver, cen, hor);
+	else
+		bgr = uvec3(hor, cen, ver);
+
+	return vec3(texelFetch(lutTexture, ivec2(int(bgr.x), 0), 0).b,
+		    texelFetch(lutTexture, ivec2(int(bgr.y), 0), 0).g,
+		    texelFetch(lutTexture, ivec2(int(bgr.z), 0), 0).r);
+}
+
+void main()
+{
+	int offset = int(gl_FragCoord.x) * 4;
+	int py = int(gl_FragCoord.y);
+	int first = offset / 3;
+
+	/* The 4 bytes of a texel span exactly 2 pixels */
+	vec3 pixels[2];
+	pixels[0] = first < width ? debayer(first, py) : vec3(0.0);
+	pixels[1] = first + 1 < width ? debayer(first + 1, py) : vec3(0.0);
+
+	float bytes[4];
+	for (int i = 0; i < 4; i++) {
+		int index = offset + i - first * 3;
+		bytes[i] = pixels[index / 3][index % 3];
+	}
+
+	fragColor = vec4(bytes[0], bytes[1], bytes[2], bytes[3]);
+}
+)";
+
+GLuint compileShader(GLenum type, const char *source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+	if (!status) {
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+		LOG(Debayer, Error) << "Failed to compile shader: " << log;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+bool hasExtension(const char *extensions, const char *name)
+{
+	if (!extensions)
+		return false;
+
+	const size_t length = strlen(name);
+	for (const char *ext = strstr(extensions, name); ext;
+	     ext = strstr(ext + length, name)) {
+		if ((ext == extensions || ext[-1] == ' ') &&
+		    (ext[length] == ' ' || ext[length] == '\0'))
+			return true;
+	}
+
+	return false;
+}
+
+} /* namespace */
+
+/**
+ * \brief Constructs a DebayerEGL object
+ * \param[in] stats Pointer to the stats object to use
+ */
+DebayerEGL::DebayerEGL(std::unique_ptr<SwStatsCpu> stats)
+	: DebayerCpu(std::move(stats)), display_(EGL_NO_DISPLAY),
+	  context_(EGL_NO_CONTEXT), eglCreateImageKHR_(nullptr),
+	  eglDestroyImageKHR_(nullptr), glEGLImageTargetTexture2DOES_(nullptr),
+	  program_(0), vertexArray_(0), inputTexture_(0), lutTexture_(0),
+	  outputTexture_(0), framebuffer_(0), outputTexelWidth_(0),
+	  lut_(DebayerParams::kRGBLookupSize * 4), dmabufImport_(false),
+	  gpuReady_(false)
+{
+}
+
+DebayerEGL::~DebayerEGL()
+{
+	cleanupEGL();
+}
+
+int DebayerEGL::initEGL()
+{
+	if (display_ != EGL_NO_DISPLAY)
+		return 0;
+
+	const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+	/* Prefer a surfaceless platform, no window system is needed */
+	if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+			eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay)
+			display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+						      EGL_DEFAULT_DISPLAY, nullptr);
+	}
+
+	if (display_ == EGL_NO_DISPLAY)
+		display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if (display_ == EGL_NO_DISPLAY) {
+		LOG(Debayer, Error) << "Failed to get EGL display";
+		return -ENODEV;
+	}
+
+	if (!eglInitialize(display_, nullptr, nullptr)) {
+		LOG(Debayer, Error) << "Failed to initialize EGL display";
+		display_ = EGL_NO_DISPLAY;
+		return -ENODEV;
+	}
+
+	const char *extensions = eglQueryString(display_, EGL_EXTENSIONS);
+	if (!hasExtension(extensions, "EGL_KHR_surfaceless_context")) {
+		LOG(Debayer, Error) << "EGL surfaceless contexts not supported";
+		cleanupEGL();
+		return -ENOTSUP;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_ES_API)) {
+		LOG(Debayer, Error) << "Failed to bind OpenGL ES API";
+		cleanupEGL();
+		return -ENOTSUP;
+	}
+
+	/* No surface is used, don't restrict the surface types */
+	static const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES3_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs;
+	if (!eglChooseConfig(display_, configAttribs, &config, 1, &numConfigs) ||
+	    numConfigs < 1) {
+		LOG(Debayer, Error) << "No OpenGL ES 3.0 capable EGL config";
+		cleanupEGL();
+		return -ENOTSUP;
+	}
+
+	static const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_NONE
+	};
+	context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context_ == EGL_NO_CONTEXT) {
+		LOG(Debayer, Error) << "Failed to create EGL context";
+		cleanupEGL();
+		return -ENOTSUP;
+	}
+
+	if (hasExtension(extensions, "EGL_EXT_image_dma_buf_import")) {
+		eglCreateImageKHR_ = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+			eglGetProcAddress("eglCreateImageKHR"));
+		eglDestroyImageKHR_ = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+			eglGetProcAddress("eglDestroyImageKHR"));
+		glEGLImageTargetTexture2DOES_ = reinterpret_cast<void (*)(GLenum, void *)>(
+			eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+	}
+
+	if (!makeCurrent()) {
+		cleanupEGL();
+		return -ENOTSUP;
+	}
+
+	int ret = createProgram();
+	if (ret) {
+		cleanupEGL();
+		return ret;
+	}
+
+	glGenVertexArrays(1, &vertexArray_);
+	glGenTextures(1, &inputTexture_);
+	glGenTextures(1, &lutTexture_);
+	glGenTextures(1, &outputTexture_);
+	glGenFramebuffers(1, &framebuffer_);
+
+	glBindTexture(GL_TEXTURE_2D, lutTexture_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, DebayerParams::kRGBLookupSize, 1,
+		     0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	return 0;
+}
+
+void DebayerEGL::cleanupEGL()
+{
+	if (display_ == EGL_NO_DISPLAY)
+		return;
+
+	if (context_ != EGL_NO_CONTEXT && makeCurrent()) {
+		releaseImports(inputImports_);
+		releaseImports(outputImports_);
+
+		glDeleteFramebuffers(1, &framebuffer_);
+		glDeleteTextures(1, &outputTexture_);
+		glDeleteTextures(1, &lutTexture_);
+		glDeleteTextures(1, &inputTexture_);
+		glDeleteVertexArrays(1, &vertexArray_);
+		glDeleteProgram(program_);
+	}
+
+	releaseCurrent();
+	if (context_ != EGL_NO_CONTEXT)
+		eglDestroyContext(display_, context_);
+	eglTerminate(display_);
+
+	display_ = EGL_NO_DISPLAY;
+	context_ = EGL_NO_CONTEXT;
+	program_ = 0;
+	gpuReady_ = false;
+}
+
+/*
+ * configure() and process() are called from different threads, and a context
+ * can only be current in a single thread. Make it current for the duration of
+ * each call only.
+ */
+bool DebayerEGL::makeCurrent()
+{
+	if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_)) {
+		LOG(Debayer, Error) << "Failed to make EGL context current";
+		return false;
+	}
+
+	return true;
+}
+
+void DebayerEGL::releaseCurrent()
+{
+	eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+int DebayerEGL::createProgram()
+{
+	GLuint vertex = compileShader(GL_VERTEX_SHADER, kVertexShader);
+	GLuint fragment = compileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+	if (!vertex || !fragment) {
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+		return -EINVAL;
+	}
+
+	program_ = glCreateProgram();
+	glAttachShader(program_, vertex);
+	glAttachShader(program_, fragment);
+	glLinkProgram(program_);
+	glDeleteShader(vertex);
+	glDeleteShader(fragment);
+
+	GLint status;
+	glGetProgramiv(program_, GL_LINK_STATUS, &status);
+	if (!status) {
+		char log[1024];
+		glGetProgramInfoLog(program_, sizeof(log), nullptr, log);
+		LOG(Debayer, Error) << "Failed to link shader program: " << log;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+void DebayerEGL::releaseImports(ImportedBuffers &imports)
+{
+	for (auto &[buffer, import] : imports) {
+		glDeleteFramebuffers(1, &import.framebuffer);
+		glDeleteTextures(1, &import.texture);
+		eglDestroyImageKHR_(display_, import.image);
+	}
+
+	imports.clear();
+}
+
+/*
+ * Import the first plane of a buffer as an EGLImage bound to a texture, and to
+ * a framebuffer when used as a render target. Imports are cached until stop()
+ * is called.
+ */
+DebayerEGL::ImportedBuffer *
+DebayerEGL::importBuffer(ImportedBuffers &imports, FrameBuffer *buffer,
+			 uint32_t fourcc, unsigned int width, unsigned int height,
+			 bool renderTarget)
+{
+	const FrameBuffer::Plane &plane = buffer->planes()[0];
+
+	auto it = imports.find(buffer);
+	if (it != imports.end()) {
+		if (it->second.fd == plane.fd)
+			return &it->second;
+
+		glDeleteFramebuffers(1, &it->second.framebuffer);
+		glDeleteTextures(1, &it->second.texture);
+		eglDestroyImageKHR_(display_, it->second.image);
+		imports.erase(it);
+	}
+
+	const EGLint attribs[] = {
+		EGL_WIDTH, static_cast<EGLint>(width),
+		EGL_HEIGHT, static_cast<EGLint>(height),
+		EGL_LINUX_DRM_FOURCC_EXT, static_cast<EGLint>(fourcc),
+		EGL_DMA_BUF_PLANE0_FD_EXT, plane.fd.get(),
+		EGL_DMA_BUF_PLANE0_OFFSET_EXT, static_cast<EGLint>(plane.offset),
+		EGL_DMA_BUF_PLANE0_PITCH_EXT,
+		static_cast<EGLint>(renderTarget ? outputConfig_.stride
+						 : inputConfig_.stride),
+		EGL_NONE
+	};
+
+	EGLImageKHR image = eglCreateImageKHR_(display_, EGL_NO_CONTEXT,
+					       EGL_LINUX_DMA_BUF_EXT, nullptr,
+					       attribs);
+	if (image == EGL_NO_IMAGE_KHR)
+		return nullptr;
+
+	ImportedBuffer import = { plane.fd, image, 0, 0 };
+
+	glGenTextures(1, &import.texture);
+	glBindTexture(GL_TEXTURE_2D, import.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glEGLImageTargetTexture2DOES_(GL_TEXTURE_2D, image);
+
+	if (renderTarget) {
+		glGenFramebuffers(1, &import.framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, import.framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+				       GL_TEXTURE_2D, import.texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			glDeleteFramebuffers(1, &import.framebuffer);
+			glDeleteTextures(1, &import.texture);
+			eglDestroyImageKHR_(display_, image);
+			return nullptr;
+		}
+	}
+
+	if (glGetError() != GL_NO_ERROR) {
+		glDeleteFramebuffers(1, &import.framebuffer);
+		glDeleteTextures(1, &import.texture);
+		eglDestroyImageKHR_(display_, image);
+		return nullptr;
+	}
+
+	return &(imports[buffer] = std::move(import));
+}
+
+int DebayerEGL::configure(const StreamConfiguration &inputCfg,
+			  const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs)
+{
+	int ret = DebayerCpu::configure(inputCfg, outputCfgs);
+	if (ret)
+		return ret;
+
+	gpuReady_ = false;
+
+	ret = initEGL();
+	if (ret) {
+		LOG(Debayer, Warning) << "GPU debayering unavailable, using the CPU";
+		return 0;
+	}
+
+	if (!makeCurrent())
+		return 0;
+
+	gpuReady_ = configureGpu(inputCfg);
+	releaseCurrent();
+
+	return 0;
+}
+
+bool DebayerEGL::configureGpu(const StreamConfiguration &inputCfg)
+{
+	/* The shader only produces the RGB888 and BGR888 formats */
+	if (outputConfig_.bpp != 24) {
+		LOG(Debayer, Info) << "Output format not supported by the GPU, using the CPU";
+		return false;
+	}
+
+	if (binning_ > 1) {
+		LOG(Debayer, Info) << "Binning not supported by the GPU, using the CPU";
+		return false;
+	}
+
+	releaseImports(inputImports_);
+	releaseImports(outputImports_);
+
+	BayerFormat bayerFormat = BayerFormat::fromPixelFormat(inputCfg.pixelFormat);
+	BayerFormat::Order order = bayerFormat.order;
+	int format;
+	int shift;
+
+	if (bayerFormat.packing == BayerFormat::Packing::CSI2) {
+		format = 2;
+		shift = 0;
+	} else if (bayerFormat.bitDepth == 8) {
+		format = 0;
+		shift = 0;
+	} else {
+		format = 1;
+		shift = bayerFormat.bitDepth - 8;
+	}
+
+	/*
+	 * Position of the red pixels in the Bayer pattern. Mirror the CPU
+	 * implementation, which swaps the red and blue pixels for BGR888.
+	 */
+	int redX = order == BayerFormat::BGGR || order == BayerFormat::GRBG;
+	int redY = order == BayerFormat::BGGR || order == BayerFormat::GBRG;
+	if (swapRedBlueGains_) {
+		redX = !redX;
+		redY = !redY;
+	}
+
+	inputSize_ = inputCfg.size;
+	outputTexelWidth_ = outputConfig_.stride / 4;
+
+	GLint maxSize;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	if (inputConfig_.stride > static_cast<unsigned int>(maxSize) ||
+	    inputSize_.height > static_cast<unsigned int>(maxSize) ||
+	    outputTexelWidth_ > static_cast<unsigned int>(maxSize)) {
+		LOG(Debayer, Warning)
+			<< "Frame size exceeds the GPU limits, using the CPU";
+		return false;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, inputTexture_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, inputConfig_.stride,
+		     inputSize_.height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+
+	glBindTexture(GL_TEXTURE_2D, outputTexture_);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, outputTexelWidth_,
+		     window_.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, outputTexture_, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		LOG(Debayer, Warning) << "Incomplete framebuffer, using the CPU";
+		return false;
+	}
+
+	glUseProgram(program_);
+	glUniform1i(glGetUniformLocation(program_, "inputTexture"), 0);
+	glUniform1i(glGetUniformLocation(program_, "lutTexture"), 1);
+	glUniform2i(glGetUniformLocation(program_, "origin"),
+		    window_.x + xShift_, window_.y);
+	glUniform1i(glGetUniformLocation(program_, "width"), window_.width);
+	glUniform1i(glGetUniformLocation(program_, "height"), window_.height);
+	glUniform1i(glGetUniformLocation(program_, "mirror"), window_.y == 0);
+	glUniform1i(glGetUniformLocation(program_, "format"), format);
+	glUniform1i(glGetUniformLocation(program_, "shift"), shift);
+	glUniform2i(glGetUniformLocation(program_, "redPosition"), redX, redY);
+
+	if (glGetError() != GL_NO_ERROR) {
+		LOG(Debayer, Warning) << "Failed to configure the GPU, using the CPU";
+		return false;
+	}
+
+	dmabufImport_ = eglCreateImageKHR_ && eglDestroyImageKHR_ &&
+			glEGLImageTargetTexture2DOES_;
+	LOG(Debayer, Info)
+		<< "Debayering on the GPU with "
+		<< reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+
+	return true;
+}
+
+/*
+ * Gather the statistics on the CPU. This only samples half of the lines and
+ * runs while the GPU processes the frame.
+ */
+void DebayerEGL::processStats(uint32_t frame, const uint8_t *src)
+{
+	const unsigned int stride = inputConfig_.stride;
+
+	src += window_.y * stride + window_.x * inputConfig_.bpp / 8;
+
+	stats_->startFrame();
+
+	for (unsigned int y = 0; y < window_.height; y += 2) {
+		const uint8_t *linePointers[3] = {
+			src, src, src + stride,
+		};
+
+		stats_->processLine0(window_.y + y, linePointers);
+		src += 2 * stride;
+	}
+
+	stats_->finishFrame(frame);
+}
+
+void DebayerEGL::process(uint32_t frame, FrameBuffer *input, FrameBuffer *output,
+			 const DebayerParams *params, const Rectangle &crop)
+{
+	setCrop(crop);
+
+	/* \todo Implement colour correction and zooming in the fragment shader */
+	if (!gpuReady_ || params->colorCorrection || zoom_ || !makeCurrent())
+		return DebayerCpu::process(frame, input, output, params, crop);
+
+	const utils::time_point start = utils::clock::now();
+
+	/* Copy metadata from the input buffer */
+	FrameMetadata &metadata = output->_d()->metadata();
+	metadata.status = input->metadata().status;
+	metadata.sequence = input->metadata().sequence;
+	metadata.timestamp = input->metadata().timestamp;
+
+	std::vector<DmaSyncer> dmaSyncers;
+	MappedFrameBuffer *in = inputMappings_.map(input,
+						   MappedFrameBuffer::MapFlag::Read,
+						   &dmaSyncers);
+	if (!in) {
+		LOG(Debayer, Error) << "mmap-ing buffer(s) failed";
+		metadata.status = FrameMetadata::FrameError;
+		releaseCurrent();
+		return;
+	}
+
+	/* Mirror the CPU implementation, which swaps the red and blue tables */
+	const DebayerParams::ColorLookupTable &red =
+		swapRedBlueGains_ ? params->blue : params->red;
+	const DebayerParams::ColorLookupTable &blue =
+		swapRedBlueGains_ ? params->red : params->blue;
+	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+		lut_[i * 4 + 0] = red[i];
+		lut_[i * 4 + 1] = params->green[i];
+		lut_[i * 4 + 2] = blue[i];
+		lut_[i * 4 + 3] = 0;
+	}
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, lutTexture_);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, DebayerParams::kRGBLookupSize, 1,
+			GL_RGBA, GL_UNSIGNED_BYTE, lut_.data());
+
+	ImportedBuffer *inImport = nullptr;
+	ImportedBuffer *outImport = nullptr;
+	if (dmabufImport_) {
+		inImport = importBuffer(inputImports_, input,
+					formats::R8.fourcc(), inputConfig_.stride,
+					inputSize_.height, false);
+		outImport = importBuffer(outputImports_, output,
+					 formats::ABGR8888.fourcc(), outputTexelWidth_,
+					 window_.height, true);
+		if (!inImport || !outImport) {
+			LOG(Debayer, Info) << "dma-buf import failed, copying buffers";
+			dmabufImport_ = false;
+			inImport = nullptr;
+			outImport = nullptr;
+		}
+	}
+
+	glActiveTexture(GL_TEXTURE0);
+	if (inImport) {
+		glBindTexture(GL_TEXTURE_2D, inImport->texture);
+	} else {
+		glBindTexture(GL_TEXTURE_2D, inputTexture_);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, inputConfig_.stride,
+				inputSize_.height, GL_RED, GL_UNSIGNED_BYTE,
+				in->planes()[0].data());
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, outImport ? outImport->framebuffer
+						    : framebuffer_);
+	glViewport(0, 0, outputTexelWidth_, window_.height);
+	glUseProgram(program_);
+	glBindVertexArray(vertexArray_);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glFlush();
+
+	processStats(frame, in->planes()[0].data());
+
+	if (outImport) {
+		glFinish();
+	} else {
+		MappedFrameBuffer *out = outputMappings_.map(output,
+							     MappedFrameBuffer::MapFlag::Write,
+							     &dmaSyncers);
+		if (!out) {
+			LOG(Debayer, Error) << "mmap-ing buffer(s) failed";
+			metadata.status = FrameMetadata::FrameError;
+			releaseCurrent();
+			return;
+		}
+
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, outputTexelWidth_, window_.height, GL_RGBA,
+			     GL_UNSIGNED_BYTE, out->planes()[0].data());
+	}
+
+	releaseCurrent();
+	dmaSyncers.clear();
+
+	metadata.planes()[0].bytesused = outputConfig_.frameSize;
+
+	recordProcessingTime(start);
+
+	outputBufferReady.emit(output);
+	inputBufferReady.emit(input);
+}
+
+/**
+ * \brief Stop processing frames
+ *
+ * Release the cached mappings and imports of the buffers processed so far.
+ * This must not be called while a frame is being processed.
+ */
+void DebayerEGL::stop()
+{
+	DebayerCpu::stop();
+
+	if (context_ != EGL_NO_CONTEXT && makeCurrent()) {
+		releaseImports(inputImports_);
+		releaseImports(outputImports_);
+		releaseCurrent();
+	}
+}
+
+} /* namespace libcamera */
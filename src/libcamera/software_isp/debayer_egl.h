@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * GPU based debayering header
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES3/gl3.h>
+
+#include "debayer_cpu.h"
+
+namespace libcamera {
+
+class DebayerEGL : public DebayerCpu
+{
+public:
+	DebayerEGL(std::unique_ptr<SwStatsCpu> stats);
+	~DebayerEGL();
+
+	int configure(const StreamConfiguration &inputCfg,
+		      const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs);
+	void process(uint32_t frame, FrameBuffer *input, FrameBuffer *output,
+		     const DebayerParams *params, const Rectangle &crop);
+	void stop();
+
+private:
+	/* A dma-buf imported as an EGLImage and bound to a texture */
+	struct ImportedBuffer {
+		SharedFD fd;
+		EGLImageKHR image;
+		GLuint texture;
+		GLuint framebuffer;
+	};
+
+	using ImportedBuffers = std::map<const FrameBuffer *, ImportedBuffer>;
+
+	int initEGL();
+	void cleanupEGL();
+	bool makeCurrent();
+	void releaseCurrent();
+	void releaseImports(ImportedBuffers &imports);
+	int createProgram();
+	bool configureGpu(const StreamConfiguration &inputCfg);
+	ImportedBuffer *importBuffer(ImportedBuffers &imports, FrameBuffer *buffer,
+				     uint32_t fourcc, unsigned int width,
+				     unsigned int height, bool renderTarget);
+	void processStats(uint32_t frame, const uint8_t *src);
+
+	EGLDisplay display_;
+	EGLContext context_;
+	PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR_;
+	PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR_;
+	void (*glEGLImageTargetTexture2DOES_)(GLenum target, void *image);
+
+	GLuint program_;
+	GLuint vertexArray_;
+	GLuint inputTexture_;
+	GLuint lutTexture_;
+	GLuint outputTexture_;
+	GLuint framebuffer_;
+
+	Size inputSize_;
+	unsigned int outputTexelWidth_;
+	std::vector<uint8_t> lut_;
+
+	/* Cleared when importing a dma-buf fails, buffers are then copied */
+	bool dmabufImport_;
+	bool gpuReady_;
+	ImportedBuffers inputImports_;
+	ImportedBuffers outputImports_;
+};
+
+} /* namespace libcamera */
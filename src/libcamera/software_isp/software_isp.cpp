@@ -7,12 +7,16 @@
 
 #include "libcamera/internal/software_isp/software_isp.h"
 
+#include <algorithm>
 #include <cmath>
 #include <stdint.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <libcamera/base/utils.h>
+
 #include <libcamera/formats.h>
 #include <libcamera/stream.h>
 
@@ -23,6 +27,9 @@
 #include "libcamera/internal/software_isp/debayer_params.h"
 
 #include "debayer_cpu.h"
+#if HAVE_DEBAYER_EGL
+#include "debayer_egl.h"
+#endif
 
 /**
  * \file software_isp.cpp
@@ -51,6 +58,9 @@ LOG_DEFINE_CATEGORY(SoftwareIsp)
 /**
  * \var SoftwareIsp::ispStatsReady
  * \brief A signal emitted when the statistics for IPA are ready
+ *
+ * The signal carries the frame number and the index of the statistics buffer
+ * to be passed to processStats().
  */
 
 /**
@@ -59,6 +69,40 @@ LOG_DEFINE_CATEGORY(SoftwareIsp)
  * ready
  */
 
+/**
+ * \struct SoftwareIsp::Metrics
+ * \brief Performance counters of the Software ISP
+ *
+ * The counters allow monitoring whether the Software ISP keeps up with the
+ * frame rate of the camera sensor. They are reset when the Software ISP is
+ * configured and started.
+ *
+ * \var SoftwareIsp::Metrics::processedFrames
+ * \brief Number of frames processed
+ *
+ * \var SoftwareIsp::Metrics::droppedFrames
+ * \brief Number of frames captured by the sensor but never processed
+ *
+ * The frames are detected as dropped from the gaps in the sequence numbers of
+ * the input buffers. This accounts for the frames dropped by the capture
+ * device when running out of buffers, which happens when processing falls
+ * behind, as well as for the frames for which no request was queued. The
+ * frames dropped by the Software ISP itself to bound the processing latency
+ * are included.
+ *
+ * \var SoftwareIsp::Metrics::queueDepth
+ * \brief Number of frames queued to the Software ISP and not yet processed
+ *
+ * \var SoftwareIsp::Metrics::lastProcessingTime
+ * \brief Processing time of the most recently processed frame
+ *
+ * \var SoftwareIsp::Metrics::averageProcessingTime
+ * \brief Average processing time over the most recently processed frames
+ *
+ * \var SoftwareIsp::Metrics::maxProcessingTime
+ * \brief Longest processing time over the most recently processed frames
+ */
+
 /**
  * \brief Constructs SoftwareIsp object
  * \param[in] pipe The pipeline handler in use
@@ -68,12 +112,27 @@ LOG_DEFINE_CATEGORY(SoftwareIsp)
 SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor)
 	: dmaHeap_(DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap |
 		   DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
-		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf)
+		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf |
+		   DmaBufAllocator::DmaBufAllocatorFlag::HugePages),
+	  droppedFrames_(0), queueDepth_(0), maxFramesInFlight_(1),
+	  framesInFlight_(0)
 {
+	if (!dmaHeap_.isValid()) {
+		LOG(SoftwareIsp, Error) << "Failed to create DmaBufAllocator object";
+		return;
+	}
+
+	sharedMem_ = SwIspSharedMem("softIsp_shared");
+	if (!sharedMem_) {
+		LOG(SoftwareIsp, Error)
+			<< "Failed to create shared memory for parameters and statistics";
+		return;
+	}
+
 	/*
-	 * debayerParams_ must be initialized because the initial value is used for
-	 * the first two frames, i.e. until stats processing starts providing its
-	 * own parameters.
+	 * The parameters buffers must be initialized because the initial value
+	 * is used for the first two frames, i.e. until stats processing starts
+	 * providing its own parameters.
 	 *
 	 * \todo This should be handled in the same place as the related
 	 * operations, in the IPA module.
@@ -81,31 +140,46 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor)
 	std::array<uint8_t, 256> gammaTable;
 	for (unsigned int i = 0; i < 256; i++)
 		gammaTable[i] = UINT8_MAX * std::pow(i / 256.0, 0.5);
-	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
-		debayerParams_.red[i] = gammaTable[i];
-		debayerParams_.green[i] = gammaTable[i];
-		debayerParams_.blue[i] = gammaTable[i];
-	}
-
-	if (!dmaHeap_.isValid()) {
-		LOG(SoftwareIsp, Error) << "Failed to create DmaBufAllocator object";
-		return;
-	}
+	for (DebayerParams &params : sharedMem_.get<DebayerParamsRing>()) {
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+			params.red[i] = gammaTable[i];
+			params.green[i] = gammaTable[i];
+			params.blue[i] = gammaTable[i];
+		}
 
-	sharedParams_ = SharedMemObject<DebayerParams>("softIsp_params");
-	if (!sharedParams_) {
-		LOG(SoftwareIsp, Error) << "Failed to create shared memory for parameters";
-		return;
+		params.colorCorrection = false;
+		params.lscRed.fill(256);
+		params.lscGreen.fill(256);
+		params.lscBlue.fill(256);
+		params.ccm = { 256, 0, 0, 0, 256, 0, 0, 0, 256 };
+		for (unsigned int i = 0; i < DebayerParams::kGammaLookupSize; i++)
+			params.gamma[i] = UINT8_MAX *
+				std::pow(i / (DebayerParams::kGammaLookupSize - 1.0), 0.5);
 	}
 
-	auto stats = std::make_unique<SwStatsCpu>();
+	auto stats = std::make_unique<SwStatsCpu>(sharedMem_.get<SwIspStatsRing>());
 	if (!stats->isValid()) {
 		LOG(SoftwareIsp, Error) << "Failed to create SwStatsCpu object";
 		return;
 	}
 	stats->statsReady.connect(this, &SoftwareIsp::statsReady);
 
-	debayer_ = std::make_unique<DebayerCpu>(std::move(stats));
+	const char *mode = utils::secure_getenv("LIBCAMERA_SOFTISP_MODE");
+	if (mode && !strcmp(mode, "gpu")) {
+#if HAVE_DEBAYER_EGL
+		debayer_ = std::make_unique<DebayerEGL>(std::move(stats));
+#else
+		LOG(SoftwareIsp, Warning)
+			<< "GPU debayering not supported, using the CPU";
+#endif
+	} else if (mode && strcmp(mode, "cpu")) {
+		LOG(SoftwareIsp, Warning)
+			<< "Invalid LIBCAMERA_SOFTISP_MODE value '" << mode
+			<< "', using the CPU";
+	}
+
+	if (!debayer_)
+		debayer_ = std::make_unique<DebayerCpu>(std::move(stats));
 	debayer_->inputBufferReady.connect(this, &SoftwareIsp::inputReady);
 	debayer_->outputBufferReady.connect(this, &SoftwareIsp::outputReady);
 
@@ -126,8 +200,7 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor)
 		ipaTuningFile = ipa_->configurationFile("uncalibrated.yaml");
 
 	int ret = ipa_->init(IPASettings{ ipaTuningFile, sensor->model() },
-			     debayer_->getStatsFD(),
-			     sharedParams_.fd(),
+			     sharedMem_.fd(),
 			     sensor->controls());
 	if (ret) {
 		LOG(SoftwareIsp, Error) << "IPA init failed";
@@ -135,10 +208,11 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor)
 		return;
 	}
 
-	ipa_->setIspParams.connect(this, &SoftwareIsp::saveIspParams);
+	ipa_->setIspParams.connect(this, &SoftwareIsp::paramsBufferReady);
 	ipa_->setSensorControls.connect(this, &SoftwareIsp::setSensorCtrls);
 
 	debayer_->moveToThread(&ispWorkerThread_);
+	ispWorkerThread_.setThreadName("swisp");
 }
 
 SoftwareIsp::~SoftwareIsp()
@@ -159,15 +233,18 @@ SoftwareIsp::~SoftwareIsp()
 
 /**
  * \brief Process the statistics gathered
+ * \param[in] frame The frame number
+ * \param[in] bufferId The index of the buffer holding the statistics
  * \param[in] sensorControls The sensor controls
  *
  * Requests the IPA to calculate new parameters for ISP and new control
  * values for the sensor.
  */
-void SoftwareIsp::processStats(const ControlList &sensorControls)
+void SoftwareIsp::processStats(const uint32_t frame, const uint32_t bufferId,
+			       const ControlList &sensorControls)
 {
 	ASSERT(ipa_);
-	ipa_->processStats(sensorControls);
+	ipa_->processStats(frame, bufferId, sensorControls);
 }
 
 /**
@@ -224,6 +301,11 @@ SoftwareIsp::strideAndFrameSize(const PixelFormat &outputFormat, const Size &siz
  * \param[in] inputCfg The input configuration
  * \param[in] outputCfgs The output configurations
  * \param[in] sensorControls ControlInfoMap of the controls supported by the sensor
+ *
+ * The number of buffers in \a inputCfg sets how many frames can be processed
+ * in the ISP worker thread at the same time, while one input buffer is being
+ * captured.
+ *
  * \return 0 on success, a negative errno on failure
  */
 int SoftwareIsp::configure(const StreamConfiguration &inputCfg,
@@ -236,6 +318,12 @@ int SoftwareIsp::configure(const StreamConfiguration &inputCfg,
 	if (ret < 0)
 		return ret;
 
+	/*
+	 * Hand as many frames to the ISP worker as the input buffers allow,
+	 * keeping one input buffer queued for capture.
+	 */
+	maxFramesInFlight_ = std::clamp(inputCfg.bufferCount, 2u, kMaxFramesInFlight + 1) - 1;
+
 	return debayer_->configure(inputCfg, outputCfgs);
 }
 
@@ -261,7 +349,7 @@ int SoftwareIsp::exportBuffers(unsigned int output, unsigned int count,
 		const size_t frameSize = debayer_->frameSize();
 
 		FrameBuffer::Plane outPlane;
-		outPlane.fd = SharedFD(dmaHeap_.alloc(name.c_str(), frameSize));
+		outPlane.fd = dmaHeap_.acquire(name.c_str(), frameSize);
 		if (!outPlane.fd.isValid()) {
 			LOG(SoftwareIsp, Error)
 				<< "failed to allocate a dma_buf";
@@ -277,15 +365,35 @@ int SoftwareIsp::exportBuffers(unsigned int output, unsigned int count,
 	return count;
 }
 
+/**
+ * \brief Get the smallest crop rectangle size supported for digital zoom
+ *
+ * The value is valid once the Software ISP has been configured.
+ *
+ * \return The minimum crop size, in input pixels
+ */
+Size SoftwareIsp::minCropSize() const
+{
+	return debayer_->minCropSize();
+}
+
 /**
  * \brief Queue buffers to Software ISP
+ * \param[in] frame The frame number
  * \param[in] input The input framebuffer
  * \param[in] outputs The container holding the output stream indexes and
  * their respective frame buffer outputs
+ * \param[in] crop The part of the input to scale to the outputs, in input
+ * pixels, or a null rectangle for the largest field of view
+ *
+ * Only the lines and columns of the input inside the crop rectangle are
+ * processed, after adjusting it to the limits of the Software ISP.
+ *
  * \return 0 on success, a negative errno on failure
  */
-int SoftwareIsp::queueBuffers(FrameBuffer *input,
-			      const std::map<unsigned int, FrameBuffer *> &outputs)
+int SoftwareIsp::queueBuffers(uint32_t frame, FrameBuffer *input,
+			      const std::map<unsigned int, FrameBuffer *> &outputs,
+			      const Rectangle &crop)
 {
 	unsigned int mask = 0;
 
@@ -308,7 +416,12 @@ int SoftwareIsp::queueBuffers(FrameBuffer *input,
 		mask |= 1 << index;
 	}
 
-	process(input, outputs.at(0));
+	const uint32_t sequence = input->metadata().sequence;
+	if (lastSequence_ && sequence > *lastSequence_ + 1)
+		droppedFrames_ += sequence - *lastSequence_ - 1;
+	lastSequence_ = sequence;
+
+	process(frame, input, outputs.at(0), crop);
 
 	return 0;
 }
@@ -323,6 +436,9 @@ int SoftwareIsp::start()
 	if (ret)
 		return ret;
 
+	lastSequence_.reset();
+	droppedFrames_ = 0;
+
 	ispWorkerThread_.start();
 	return 0;
 }
@@ -335,23 +451,122 @@ void SoftwareIsp::stop()
 	ispWorkerThread_.exit();
 	ispWorkerThread_.wait();
 
+	/* The worker thread is stopped, the debayer can be accessed directly */
+	debayer_->stop();
+
 	ipa_->stop();
+
+	queuedFrames_.clear();
+	queueDepth_ = 0;
+
+	MutexLocker locker(pendingMutex_);
+	pendingFrames_.clear();
+	framesInFlight_ = 0;
 }
 
 /**
  * \brief Passes the input framebuffer to the ISP worker to process
+ * \param[in] frame The frame number
  * \param[in] input The input framebuffer
  * \param[out] output The framebuffer to write the processed frame to
+ * \param[in] crop The part of the input to scale to the output, in input pixels
+ *
+ * The IPA is first requested to fill the parameters buffer for the frame, the
+ * frame is then passed to the ISP worker when the parameters are ready.
+ *
+ * To bound the latency when processing falls behind the frame rate, at most
+ * two frames are handed to the ISP worker at a time, and one more frame waits
+ * for the worker. When another frame is ready, the oldest waiting frame is
+ * dropped, its output buffer completing with the FrameError status.
  */
-void SoftwareIsp::process(FrameBuffer *input, FrameBuffer *output)
+void SoftwareIsp::process(uint32_t frame, FrameBuffer *input, FrameBuffer *output,
+			  const Rectangle &crop)
 {
-	debayer_->invokeMethod(&DebayerCpu::process,
-			       ConnectionTypeQueued, input, output, debayerParams_);
+	queuedFrames_[frame] = { input, output, crop, nullptr };
+	queueDepth_++;
+	ipa_->fillParamsBuffer(frame, frame % kDebayerParamsBufferCount);
 }
 
-void SoftwareIsp::saveIspParams()
+/**
+ * \brief Retrieve the performance counters of the Software ISP
+ *
+ * This function shall be called from the thread the SoftwareIsp lives in.
+ * The counters are updated when each frame completes, they can thus be
+ * retrieved when handling the outputBufferReady signal to report them along
+ * with the frame.
+ *
+ * \return The current value of the counters
+ */
+SoftwareIsp::Metrics SoftwareIsp::metrics() const
 {
-	debayerParams_ = *sharedParams_;
+	const DebayerCpu::ProcessingTime time = debayer_->processingTime();
+	Metrics metrics;
+
+	metrics.processedFrames = time.frames;
+	metrics.droppedFrames = droppedFrames_;
+	metrics.queueDepth = queueDepth_;
+	metrics.lastProcessingTime = time.last;
+	metrics.averageProcessingTime = time.average;
+	metrics.maxProcessingTime = time.max;
+
+	return metrics;
+}
+
+void SoftwareIsp::paramsBufferReady(uint32_t frame, uint32_t bufferId)
+{
+	auto it = queuedFrames_.find(frame);
+	if (it == queuedFrames_.end()) {
+		LOG(SoftwareIsp, Warning)
+			<< "Parameters ready for unknown frame " << frame;
+		return;
+	}
+
+	QueuedFrame queued = it->second;
+	queuedFrames_.erase(it);
+
+	ASSERT(bufferId < kDebayerParamsBufferCount);
+	queued.params = &sharedMem_.get<DebayerParamsRing>()[bufferId];
+
+	MutexLocker locker(pendingMutex_);
+
+	pendingFrames_.emplace_back(frame, queued);
+
+	/*
+	 * Drop the oldest frame through the ISP worker, to complete the frames
+	 * in order.
+	 */
+	if (pendingFrames_.size() > kMaxPendingFrames) {
+		const QueuedFrame &oldest = pendingFrames_.front().second;
+
+		LOG(SoftwareIsp, Debug)
+			<< "Processing is late, dropping frame "
+			<< oldest.input->metadata().sequence;
+
+		debayer_->invokeMethod(&DebayerCpu::drop, ConnectionTypeQueued,
+				       oldest.input, oldest.output);
+		pendingFrames_.pop_front();
+		framesInFlight_++;
+		droppedFrames_++;
+	}
+
+	dispatchFrames();
+}
+
+/*
+ * Hand the pending frames to the ISP worker, up to maxFramesInFlight_. This is
+ * called when a frame is ready, and when the worker completes a frame.
+ */
+void SoftwareIsp::dispatchFrames()
+{
+	while (framesInFlight_ < maxFramesInFlight_ && !pendingFrames_.empty()) {
+		const auto &[frame, queued] = pendingFrames_.front();
+
+		debayer_->invokeMethod(&DebayerCpu::process, ConnectionTypeQueued,
+				       frame, queued.input, queued.output,
+				       queued.params, queued.crop);
+		pendingFrames_.pop_front();
+		framesInFlight_++;
+	}
 }
 
 void SoftwareIsp::setSensorCtrls(const ControlList &sensorControls)
@@ -359,9 +574,9 @@ void SoftwareIsp::setSensorCtrls(const ControlList &sensorControls)
 	setSensorControls.emit(sensorControls);
 }
 
-void SoftwareIsp::statsReady()
+void SoftwareIsp::statsReady(uint32_t frame, uint32_t bufferId)
 {
-	ispStatsReady.emit();
+	ispStatsReady.emit(frame, bufferId);
 }
 
 void SoftwareIsp::inputReady(FrameBuffer *input)
@@ -371,6 +586,14 @@ void SoftwareIsp::inputReady(FrameBuffer *input)
 
 void SoftwareIsp::outputReady(FrameBuffer *output)
 {
+	queueDepth_--;
+
+	{
+		MutexLocker locker(pendingMutex_);
+		framesInFlight_--;
+		dispatchFrames();
+	}
+
 	outputBufferReady.emit(output);
 }
 
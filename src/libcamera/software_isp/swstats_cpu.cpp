@@ -11,7 +11,12 @@
 
 #include "swstats_cpu.h"
 
+#include <algorithm>
+#include <limits.h>
+#include <stdlib.h>
+
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/stream.h>
 
@@ -32,20 +37,22 @@ namespace libcamera {
  *
  * It is also possible to specify a window over which to gather statistics
  * instead of processing the whole frame.
+ *
+ * Statistics are computed from a subset of the 2x2 blocks of the window, with
+ * a fixed number of lines and pixels skipped between the sampled blocks. The
+ * skips grow with the window size to bound the number of sampled blocks, and
+ * thus the cost of the statistics. The statistics are also accumulated
+ * separately for each zone of a grid covering the window.
  */
 
 /**
  * \fn bool SwStatsCpu::isValid() const
  * \brief Gets whether the statistics object is valid
  *
- * \return True if it's valid, false otherwise
- */
-
-/**
- * \fn const SharedFD &SwStatsCpu::getStatsFD()
- * \brief Get the file descriptor for the statistics
+ * The statistics object is valid if it has been constructed with a ring of
+ * kSwIspStatsBufferCount statistics buffers.
  *
- * \return The file descriptor
+ * \return True if it's valid, false otherwise
  */
 
 /**
@@ -62,10 +69,11 @@ namespace libcamera {
  */
 
 /**
- * \fn void SwStatsCpu::processLine0(unsigned int y, const uint8_t *src[])
+ * \fn void SwStatsCpu::processLine0(unsigned int y, const uint8_t *src[], unsigned int stripe)
  * \brief Process line 0
  * \param[in] y The y coordinate.
  * \param[in] src The input data.
+ * \param[in] stripe The index of the stripe the line belongs to.
  *
  * This function processes line 0 for input formats with
  * patternSize height == 1.
@@ -74,10 +82,11 @@ namespace libcamera {
  */
 
 /**
- * \fn void SwStatsCpu::processLine2(unsigned int y, const uint8_t *src[])
+ * \fn void SwStatsCpu::processLine2(unsigned int y, const uint8_t *src[], unsigned int stripe)
  * \brief Process line 2 and 3
  * \param[in] y The y coordinate.
  * \param[in] src The input data.
+ * \param[in] stripe The index of the stripe the line belongs to.
  *
  * This function processes line 2 and 3 for input formats with
  * patternSize height == 4.
@@ -85,14 +94,18 @@ namespace libcamera {
  */
 
 /**
- * \var Signal<> SwStatsCpu::statsReady
+ * \var Signal<uint32_t, uint32_t> SwStatsCpu::statsReady
  * \brief Signals that the statistics are ready
+ *
+ * The signal carries the frame number and the index of the buffer holding the
+ * statistics in the shared memory ring of kSwIspStatsBufferCount buffers.
  */
 
 /**
  * \typedef SwStatsCpu::statsProcessFn
  * \brief Called when there is data to get statistics from
  * \param[in] src The input data
+ * \param[out] stats The statistics to accumulate the data in
  *
  * These functions take an array of (patternSize_.height + 1) src
  * pointers each pointing to a line in the source image. The middle
@@ -108,6 +121,26 @@ namespace libcamera {
  * \brief Skip lines where this bitmask is set in y
  */
 
+/**
+ * \var unsigned int SwStatsCpu::xStep_
+ * \brief Distance in pixels between two sampled 2x2 blocks of a line
+ */
+
+/**
+ * \var unsigned int SwStatsCpu::maxSamples_
+ * \brief Upper limit for the number of 2x2 blocks sampled per frame
+ *
+ * A value of 0 disables the limit.
+ */
+
+/**
+ * \var SwStatsCpu::zoneX_
+ * \brief Horizontal boundaries of the zones, relative to window_.x
+ *
+ * The boundaries are multiples of xStep_, zone i spans the pixels from
+ * zoneX_[i] included to zoneX_[i + 1] excluded.
+ */
+
 /**
  * \var Rectangle SwStatsCpu::window_
  * \brief Statistics window, set by setWindow(), used every line
@@ -129,42 +162,75 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(SwStatsCpu)
 
-SwStatsCpu::SwStatsCpu()
-	: sharedStats_("softIsp_stats")
+/**
+ * \brief Construct a SwStatsCpu object
+ * \param[in] sharedStats The ring of buffers to store the statistics in
+ *
+ * The statistics of each frame are stored in a buffer of the \a sharedStats
+ * ring, which is typically allocated in memory shared with the IPA module. The
+ * ring must contain kSwIspStatsBufferCount buffers, and must outlive the
+ * SwStatsCpu.
+ */
+SwStatsCpu::SwStatsCpu(Span<SwIspStats> sharedStats)
+	: maxSamples_(kDefaultMaxSamples), sharedStats_(sharedStats),
+	  stripeStats_(1)
 {
-	if (!sharedStats_)
+	if (!isValid())
 		LOG(SwStatsCpu, Error)
-			<< "Failed to create shared memory for statistics";
+			<< "Invalid statistics buffers ring";
+
+	const char *samples = utils::secure_getenv("LIBCAMERA_SOFTISP_STATS_SAMPLES");
+	if (samples) {
+		char *end;
+		unsigned long value = strtoul(samples, &end, 10);
+		if (*samples == '\0' || *end != '\0')
+			LOG(SwStatsCpu, Warning)
+				<< "Invalid LIBCAMERA_SOFTISP_STATS_SAMPLES value '"
+				<< samples << "', using the default";
+		else
+			maxSamples_ = std::min<unsigned long>(value, UINT_MAX);
+	}
 }
 
 static constexpr unsigned int kRedYMul = 77; /* 0.299 * 256 */
 static constexpr unsigned int kGreenYMul = 150; /* 0.587 * 256 */
 static constexpr unsigned int kBlueYMul = 29; /* 0.114 * 256 */
 
-#define SWSTATS_START_LINE_STATS(pixel_t) \
-	pixel_t r, g, g2, b;              \
-	uint64_t yVal;                    \
-                                          \
-	uint64_t sumR = 0;                \
-	uint64_t sumG = 0;                \
-	uint64_t sumB = 0;
+#define SWSTATS_START_LINE_STATS(pixel_t)                      \
+	pixel_t r, g, g2, b;                                   \
+	uint64_t yVal;                                         \
+                                                               \
+	SwIspStats::Zone *zones = &stats.zones[zoneRow(y) *    \
+					       SwIspStats::kGridWidth];
+
+#define SWSTATS_START_ZONE_STATS() \
+	uint64_t sumR = 0;         \
+	uint64_t sumG = 0;         \
+	uint64_t sumB = 0;         \
+	uint32_t count = 0;
 
 #define SWSTATS_ACCUMULATE_LINE_STATS(div) \
 	sumR += r;                         \
 	sumG += g;                         \
 	sumB += b;                         \
+	count++;                           \
                                            \
 	yVal = r * kRedYMul;               \
 	yVal += g * kGreenYMul;            \
 	yVal += b * kBlueYMul;             \
-	stats_.yHistogram[yVal * SwIspStats::kYHistogramSize / (256 * 256 * (div))]++;
-
-#define SWSTATS_FINISH_LINE_STATS() \
-	stats_.sumR_ += sumR;       \
-	stats_.sumG_ += sumG;       \
-	stats_.sumB_ += sumB;
-
-void SwStatsCpu::statsBGGR8Line0(const uint8_t *src[])
+	stats.yHistogram[yVal * SwIspStats::kYHistogramSize / (256 * 256 * (div))]++;
+
+#define SWSTATS_FINISH_ZONE_STATS(zone) \
+	zone.sumR += sumR;              \
+	zone.sumG += sumG;              \
+	zone.sumB += sumB;              \
+	zone.count += count;            \
+                                        \
+	stats.sumR_ += sumR;            \
+	stats.sumG_ += sumG;            \
+	stats.sumB_ += sumB;
+
+void SwStatsCpu::statsBGGR8Line0(unsigned int y, const uint8_t *src[], SwIspStats &stats)
 {
 	const uint8_t *src0 = src[1] + window_.x;
 	const uint8_t *src1 = src[2] + window_.x;
@@ -174,22 +240,26 @@ void SwStatsCpu::statsBGGR8Line0(const uint8_t *src[])
 	if (swapLines_)
 		std::swap(src0, src1);
 
-	/* x += 4 sample every other 2x2 block */
-	for (int x = 0; x < (int)window_.width; x += 4) {
-		b = src0[x];
-		g = src0[x + 1];
-		g2 = src1[x];
-		r = src1[x + 1];
+	for (unsigned int zone = 0; zone < SwIspStats::kGridWidth; zone++) {
+		SWSTATS_START_ZONE_STATS()
 
-		g = (g + g2) / 2;
+		/* x += xStep_ sample a 2x2 block every xStep_ pixels */
+		for (unsigned int x = zoneX_[zone]; x < zoneX_[zone + 1]; x += xStep_) {
+			b = src0[x];
+			g = src0[x + 1];
+			g2 = src1[x];
+			r = src1[x + 1];
 
-		SWSTATS_ACCUMULATE_LINE_STATS(1)
-	}
+			g = (g + g2) / 2;
+
+			SWSTATS_ACCUMULATE_LINE_STATS(1)
+		}
 
-	SWSTATS_FINISH_LINE_STATS()
+		SWSTATS_FINISH_ZONE_STATS(zones[zone])
+	}
 }
 
-void SwStatsCpu::statsBGGR10Line0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR10Line0(unsigned int y, const uint8_t *src[], SwIspStats &stats)
 {
 	const uint16_t *src0 = (const uint16_t *)src[1] + window_.x;
 	const uint16_t *src1 = (const uint16_t *)src[2] + window_.x;
@@ -199,23 +269,27 @@ void SwStatsCpu::statsBGGR10Line0(const uint8_t *src[])
 	if (swapLines_)
 		std::swap(src0, src1);
 
-	/* x += 4 sample every other 2x2 block */
-	for (int x = 0; x < (int)window_.width; x += 4) {
-		b = src0[x];
-		g = src0[x + 1];
-		g2 = src1[x];
-		r = src1[x + 1];
+	for (unsigned int zone = 0; zone < SwIspStats::kGridWidth; zone++) {
+		SWSTATS_START_ZONE_STATS()
 
-		g = (g + g2) / 2;
+		/* x += xStep_ sample a 2x2 block every xStep_ pixels */
+		for (unsigned int x = zoneX_[zone]; x < zoneX_[zone + 1]; x += xStep_) {
+			b = src0[x];
+			g = src0[x + 1];
+			g2 = src1[x];
+			r = src1[x + 1];
 
-		/* divide Y by 4 for 10 -> 8 bpp value */
-		SWSTATS_ACCUMULATE_LINE_STATS(4)
-	}
+			g = (g + g2) / 2;
+
+			/* divide Y by 4 for 10 -> 8 bpp value */
+			SWSTATS_ACCUMULATE_LINE_STATS(4)
+		}
 
-	SWSTATS_FINISH_LINE_STATS()
+		SWSTATS_FINISH_ZONE_STATS(zones[zone])
+	}
 }
 
-void SwStatsCpu::statsBGGR12Line0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR12Line0(unsigned int y, const uint8_t *src[], SwIspStats &stats)
 {
 	const uint16_t *src0 = (const uint16_t *)src[1] + window_.x;
 	const uint16_t *src1 = (const uint16_t *)src[2] + window_.x;
@@ -225,72 +299,90 @@ void SwStatsCpu::statsBGGR12Line0(const uint8_t *src[])
 	if (swapLines_)
 		std::swap(src0, src1);
 
-	/* x += 4 sample every other 2x2 block */
-	for (int x = 0; x < (int)window_.width; x += 4) {
-		b = src0[x];
-		g = src0[x + 1];
-		g2 = src1[x];
-		r = src1[x + 1];
+	for (unsigned int zone = 0; zone < SwIspStats::kGridWidth; zone++) {
+		SWSTATS_START_ZONE_STATS()
 
-		g = (g + g2) / 2;
+		/* x += xStep_ sample a 2x2 block every xStep_ pixels */
+		for (unsigned int x = zoneX_[zone]; x < zoneX_[zone + 1]; x += xStep_) {
+			b = src0[x];
+			g = src0[x + 1];
+			g2 = src1[x];
+			r = src1[x + 1];
 
-		/* divide Y by 16 for 12 -> 8 bpp value */
-		SWSTATS_ACCUMULATE_LINE_STATS(16)
-	}
+			g = (g + g2) / 2;
+
+			/* divide Y by 16 for 12 -> 8 bpp value */
+			SWSTATS_ACCUMULATE_LINE_STATS(16)
+		}
 
-	SWSTATS_FINISH_LINE_STATS()
+		SWSTATS_FINISH_ZONE_STATS(zones[zone])
+	}
 }
 
-void SwStatsCpu::statsBGGR10PLine0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR10PLine0(unsigned int y, const uint8_t *src[], SwIspStats &stats)
 {
 	const uint8_t *src0 = src[1] + window_.x * 5 / 4;
 	const uint8_t *src1 = src[2] + window_.x * 5 / 4;
-	const int widthInBytes = window_.width * 5 / 4;
+	const unsigned int step = xStep_ * 5 / 4;
 
 	if (swapLines_)
 		std::swap(src0, src1);
 
 	SWSTATS_START_LINE_STATS(uint8_t)
 
-	/* x += 5 sample every other 2x2 block */
-	for (int x = 0; x < widthInBytes; x += 5) {
-		/* BGGR */
-		b = src0[x];
-		g = src0[x + 1];
-		g2 = src1[x];
-		r = src1[x + 1];
-		g = (g + g2) / 2;
-		/* Data is already 8 bits, divide by 1 */
-		SWSTATS_ACCUMULATE_LINE_STATS(1)
-	}
+	for (unsigned int zone = 0; zone < SwIspStats::kGridWidth; zone++) {
+		const unsigned int start = zoneX_[zone] * 5 / 4;
+		const unsigned int end = zoneX_[zone + 1] * 5 / 4;
+
+		SWSTATS_START_ZONE_STATS()
+
+		/* x += step sample a 2x2 block every xStep_ pixels */
+		for (unsigned int x = start; x < end; x += step) {
+			/* BGGR */
+			b = src0[x];
+			g = src0[x + 1];
+			g2 = src1[x];
+			r = src1[x + 1];
+			g = (g + g2) / 2;
+			/* Data is already 8 bits, divide by 1 */
+			SWSTATS_ACCUMULATE_LINE_STATS(1)
+		}
 
-	SWSTATS_FINISH_LINE_STATS()
+		SWSTATS_FINISH_ZONE_STATS(zones[zone])
+	}
 }
 
-void SwStatsCpu::statsGBRG10PLine0(const uint8_t *src[])
+void SwStatsCpu::statsGBRG10PLine0(unsigned int y, const uint8_t *src[], SwIspStats &stats)
 {
 	const uint8_t *src0 = src[1] + window_.x * 5 / 4;
 	const uint8_t *src1 = src[2] + window_.x * 5 / 4;
-	const int widthInBytes = window_.width * 5 / 4;
+	const unsigned int step = xStep_ * 5 / 4;
 
 	if (swapLines_)
 		std::swap(src0, src1);
 
 	SWSTATS_START_LINE_STATS(uint8_t)
 
-	/* x += 5 sample every other 2x2 block */
-	for (int x = 0; x < widthInBytes; x += 5) {
-		/* GBRG */
-		g = src0[x];
-		b = src0[x + 1];
-		r = src1[x];
-		g2 = src1[x + 1];
-		g = (g + g2) / 2;
-		/* Data is already 8 bits, divide by 1 */
-		SWSTATS_ACCUMULATE_LINE_STATS(1)
-	}
+	for (unsigned int zone = 0; zone < SwIspStats::kGridWidth; zone++) {
+		const unsigned int start = zoneX_[zone] * 5 / 4;
+		const unsigned int end = zoneX_[zone + 1] * 5 / 4;
+
+		SWSTATS_START_ZONE_STATS()
+
+		/* x += step sample a 2x2 block every xStep_ pixels */
+		for (unsigned int x = start; x < end; x += step) {
+			/* GBRG */
+			g = src0[x];
+			b = src0[x + 1];
+			r = src1[x];
+			g2 = src1[x + 1];
+			g = (g + g2) / 2;
+			/* Data is already 8 bits, divide by 1 */
+			SWSTATS_ACCUMULATE_LINE_STATS(1)
+		}
 
-	SWSTATS_FINISH_LINE_STATS()
+		SWSTATS_FINISH_ZONE_STATS(zones[zone])
+	}
 }
 
 /**
@@ -303,21 +395,69 @@ void SwStatsCpu::startFrame(void)
 	if (window_.width == 0)
 		LOG(SwStatsCpu, Error) << "Calling startFrame() without setWindow()";
 
-	stats_.sumR_ = 0;
-	stats_.sumB_ = 0;
-	stats_.sumG_ = 0;
-	stats_.yHistogram.fill(0);
+	for (SwIspStats &stats : stripeStats_) {
+		stats.sumR_ = 0;
+		stats.sumB_ = 0;
+		stats.sumG_ = 0;
+		stats.yHistogram.fill(0);
+		stats.zones.fill({});
+	}
+}
+
+/**
+ * \brief Set the number of stripes the frame is processed in
+ * \param[in] count The number of stripes
+ *
+ * Frames may be split in horizontal stripes processed concurrently by
+ * different threads. Statistics are accumulated separately for each stripe
+ * and merged by finishFrame(), lines of different stripes may thus be passed
+ * to processLine0() and processLine2() concurrently. Lines of a single stripe
+ * must not.
+ *
+ * This may not be called while a frame is being processed.
+ */
+void SwStatsCpu::setStripeCount(unsigned int count)
+{
+	stripeStats_.resize(std::max(count, 1U));
 }
 
 /**
  * \brief Finish statistics calculation for the current frame
+ * \param[in] frame The frame number
+ *
+ * Store the statistics of the frame in the buffer of the shared memory ring
+ * selected by the frame number, and signal their availability. The buffer is
+ * not written to again before kSwIspStatsBufferCount more frames have been
+ * processed, which gives the IPA time to read the statistics without blocking
+ * the processing of the next frames.
  *
  * This may only be called after a successful setWindow() call.
  */
-void SwStatsCpu::finishFrame(void)
+void SwStatsCpu::finishFrame(uint32_t frame)
 {
-	*sharedStats_ = stats_;
-	statsReady.emit();
+	const uint32_t bufferId = frame % kSwIspStatsBufferCount;
+	SwIspStats &shared = sharedStats_[bufferId];
+
+	shared = stripeStats_[0];
+
+	for (unsigned int i = 1; i < stripeStats_.size(); i++) {
+		const SwIspStats &stats = stripeStats_[i];
+
+		shared.sumR_ += stats.sumR_;
+		shared.sumB_ += stats.sumB_;
+		shared.sumG_ += stats.sumG_;
+		for (unsigned int j = 0; j < SwIspStats::kYHistogramSize; j++)
+			shared.yHistogram[j] += stats.yHistogram[j];
+
+		for (unsigned int j = 0; j < stats.zones.size(); j++) {
+			shared.zones[j].sumR += stats.zones[j].sumR;
+			shared.zones[j].sumG += stats.zones[j].sumG;
+			shared.zones[j].sumB += stats.zones[j].sumB;
+			shared.zones[j].count += stats.zones[j].count;
+		}
+	}
+
+	statsReady.emit(frame, bufferId);
 }
 
 /**
@@ -352,7 +492,6 @@ int SwStatsCpu::setupStandardBayerOrder(BayerFormat::Order order)
 
 	patternSize_.height = 2;
 	patternSize_.width = 2;
-	ySkipMask_ = 0x02; /* Skip every 3th and 4th line */
 	return 0;
 }
 
@@ -386,8 +525,6 @@ int SwStatsCpu::configure(const StreamConfiguration &inputCfg)
 	    bayerFormat.packing == BayerFormat::Packing::CSI2) {
 		patternSize_.height = 2;
 		patternSize_.width = 4; /* 5 bytes per *4* pixels */
-		/* Skip every 3th and 4th line, sample every other 2x2 block */
-		ySkipMask_ = 0x02;
 		xShift_ = 0;
 
 		switch (bayerFormat.order) {
@@ -414,6 +551,11 @@ int SwStatsCpu::configure(const StreamConfiguration &inputCfg)
 /**
  * \brief Specify window coordinates over which to gather statistics
  * \param[in] window The window object.
+ *
+ * This also selects the lines and pixels sampled in the window. By default
+ * every other 2x2 block of every other pair of lines is sampled. The distance
+ * between the sampled blocks is doubled, alternately vertically and
+ * horizontally, until at most maxSamples_ blocks are sampled.
  */
 void SwStatsCpu::setWindow(const Rectangle &window)
 {
@@ -427,6 +569,31 @@ void SwStatsCpu::setWindow(const Rectangle &window)
 	window_.width -= xShift_;
 	window_.width &= ~(patternSize_.width - 1);
 	window_.height &= ~(patternSize_.height - 1);
+
+	/* Skip every 3th and 4th line, sample every other 2x2 block */
+	unsigned int yStep = 4;
+	xStep_ = 4;
+
+	while (maxSamples_ &&
+	       static_cast<uint64_t>(window_.width / xStep_) * (window_.height / yStep) > maxSamples_ &&
+	       (xStep_ < window_.width || yStep < window_.height)) {
+		if (yStep <= xStep_ && yStep < window_.height)
+			yStep *= 2;
+		else
+			xStep_ *= 2;
+	}
+
+	ySkipMask_ = (yStep - 1) & ~1U;
+
+	for (unsigned int i = 0; i <= SwIspStats::kGridWidth; i++)
+		zoneX_[i] = window_.width * i / SwIspStats::kGridWidth / xStep_ * xStep_;
+
+	/* Sample the blocks at the right edge in the last zone */
+	zoneX_[SwIspStats::kGridWidth] = window_.width;
+
+	LOG(SwStatsCpu, Debug)
+		<< "Sampling a 2x2 block every " << xStep_ << " pixels of "
+		<< "every " << yStep << " lines";
 }
 
 } /* namespace libcamera */
@@ -11,14 +11,16 @@
 
 #pragma once
 
+#include <array>
 #include <stdint.h>
+#include <vector>
 
 #include <libcamera/base/signal.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/geometry.h>
 
 #include "libcamera/internal/bayer_format.h"
-#include "libcamera/internal/shared_mem_object.h"
 #include "libcamera/internal/software_isp/swisp_stats.h"
 
 namespace libcamera {
@@ -29,53 +31,63 @@ struct StreamConfiguration;
 class SwStatsCpu
 {
 public:
-	SwStatsCpu();
+	SwStatsCpu(Span<SwIspStats> sharedStats);
 	~SwStatsCpu() = default;
 
-	bool isValid() const { return sharedStats_.fd().isValid(); }
-
-	const SharedFD &getStatsFD() { return sharedStats_.fd(); }
+	bool isValid() const { return sharedStats_.size() == kSwIspStatsBufferCount; }
 
 	const Size &patternSize() { return patternSize_; }
 
 	int configure(const StreamConfiguration &inputCfg);
 	void setWindow(const Rectangle &window);
+	void setStripeCount(unsigned int count);
 	void startFrame();
-	void finishFrame();
+	void finishFrame(uint32_t frame);
 
-	void processLine0(unsigned int y, const uint8_t *src[])
+	void processLine0(unsigned int y, const uint8_t *src[],
+			  unsigned int stripe = 0)
 	{
 		if ((y & ySkipMask_) || y < static_cast<unsigned int>(window_.y) ||
 		    y >= (window_.y + window_.height))
 			return;
 
-		(this->*stats0_)(src);
+		(this->*stats0_)(y, src, stripeStats_[stripe]);
 	}
 
-	void processLine2(unsigned int y, const uint8_t *src[])
+	void processLine2(unsigned int y, const uint8_t *src[],
+			  unsigned int stripe = 0)
 	{
 		if ((y & ySkipMask_) || y < static_cast<unsigned int>(window_.y) ||
 		    y >= (window_.y + window_.height))
 			return;
 
-		(this->*stats2_)(src);
+		(this->*stats2_)(y, src, stripeStats_[stripe]);
 	}
 
-	Signal<> statsReady;
+	Signal<uint32_t, uint32_t> statsReady;
 
 private:
-	using statsProcessFn = void (SwStatsCpu::*)(const uint8_t *src[]);
+	using statsProcessFn = void (SwStatsCpu::*)(unsigned int y, const uint8_t *src[],
+						    SwIspStats &stats);
 
 	int setupStandardBayerOrder(BayerFormat::Order order);
 	/* Bayer 8 bpp unpacked */
-	void statsBGGR8Line0(const uint8_t *src[]);
+	void statsBGGR8Line0(unsigned int y, const uint8_t *src[], SwIspStats &stats);
 	/* Bayer 10 bpp unpacked */
-	void statsBGGR10Line0(const uint8_t *src[]);
+	void statsBGGR10Line0(unsigned int y, const uint8_t *src[], SwIspStats &stats);
 	/* Bayer 12 bpp unpacked */
-	void statsBGGR12Line0(const uint8_t *src[]);
+	void statsBGGR12Line0(unsigned int y, const uint8_t *src[], SwIspStats &stats);
 	/* Bayer 10 bpp packed */
-	void statsBGGR10PLine0(const uint8_t *src[]);
-	void statsGBRG10PLine0(const uint8_t *src[]);
+	void statsBGGR10PLine0(unsigned int y, const uint8_t *src[], SwIspStats &stats);
+	void statsGBRG10PLine0(unsigned int y, const uint8_t *src[], SwIspStats &stats);
+
+	unsigned int zoneRow(unsigned int y) const
+	{
+		return (y - window_.y) * SwIspStats::kGridHeight / window_.height;
+	}
+
+	/* Default upper limit for the number of 2x2 blocks sampled per frame */
+	static constexpr unsigned int kDefaultMaxSamples = 65536;
 
 	/* Variables set by configure(), used every line */
 	statsProcessFn stats0_;
@@ -83,15 +95,20 @@ private:
 	bool swapLines_;
 
 	unsigned int ySkipMask_;
+	unsigned int xStep_;
+	unsigned int maxSamples_;
 
 	Rectangle window_;
+	/* Horizontal boundaries of the zones, relative to window_.x */
+	std::array<unsigned int, SwIspStats::kGridWidth + 1> zoneX_;
 
 	Size patternSize_;
 
 	unsigned int xShift_;
 
-	SharedMemObject<SwIspStats> sharedStats_;
-	SwIspStats stats_;
+	Span<SwIspStats> sharedStats_;
+	/* Partial statistics, one entry per stripe of the frame */
+	std::vector<SwIspStats> stripeStats_;
 };
 
 } /* namespace libcamera */
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Lookup tables sorted at compile time
+ */
+
+#include "libcamera/internal/sorted_table.h"
+
+/**
+ * \file sorted_table.h
+ * \brief Lookup tables sorted at compile time
+ *
+ * Static lookup tables, such as the tables describing pixel formats, are
+ * traditionally stored in std::map instances. Those are constructed at static
+ * initialization time, allocate one node per entry and are slow to search due
+ * to pointer chasing.
+ *
+ * The helpers in this file instead sort a constexpr array at compile time. The
+ * resulting table is stored in read-only data, requires no initialization and
+ * is searched with a binary search on contiguous memory. Secondary indices,
+ * sorted by a different key, can also be computed at compile time.
+ *
+ * All helpers take a projection function that returns the key of a table
+ * entry. Keys must be comparable with operator<() and operator==(), in a
+ * constexpr context for the functions that run at compile time. Integers,
+ * std::string_view and std::tuple of those are suitable.
+ */
+
+namespace libcamera {
+
+namespace utils {
+
+/**
+ * \fn sortedTable(const T (&entries)[N], Projection proj)
+ * \brief Sort table entries by key
+ * \param[in] entries The table entries
+ * \param[in] proj The projection function returning the key of an entry
+ *
+ * The sort is stable, entries with equivalent keys keep their relative order
+ * and sortedTableFind() returns the first of them in \a entries.
+ *
+ * \return A std::array containing the \a entries sorted by key
+ */
+
+/**
+ * \fn sortedTableIndex(const std::array<T, N> &table, Projection proj)
+ * \brief Create a secondary index for a table
+ * \param[in] table The table
+ * \param[in] proj The projection function returning the secondary key of an
+ * entry
+ *
+ * The index is stable, entries of \a table with equivalent secondary keys keep
+ * their relative order.
+ *
+ * \return A std::array of indices in \a table, sorted by secondary key
+ */
+
+/**
+ * \fn sortedTableIsUnique(const std::array<T, N> &table, Projection proj)
+ * \brief Check if the keys of a sorted table are unique
+ * \param[in] table The sorted table
+ * \param[in] proj The projection function returning the key of an entry
+ *
+ * This function is meant to be used in a static_assert() to catch duplicated
+ * entries at compile time.
+ *
+ * \return True if the keys in \a table are unique, false otherwise
+ */
+
+/**
+ * \fn sortedTableFind(const std::array<T, N> &table, const Key &key, Projection proj)
+ * \brief Find an entry in a sorted table
+ * \param[in] table The table, sorted with sortedTable()
+ * \param[in] key The key to search for
+ * \param[in] proj The projection function returning the key of an entry
+ * \return A pointer to the entry matching \a key, or nullptr if not found
+ */
+
+/**
+ * \fn sortedTableFind(const std::array<T, N> &table,
+ *			const std::array<unsigned int, N> &index,
+ *			const Key &key, Projection proj)
+ * \brief Find an entry in a table through a secondary index
+ * \param[in] table The table
+ * \param[in] index The secondary index, created with sortedTableIndex()
+ * \param[in] key The secondary key to search for
+ * \param[in] proj The projection function returning the secondary key of an
+ * entry
+ * \return A pointer to the entry matching \a key, or nullptr if not found
+ */
+
+} /* namespace utils */
+
+} /* namespace libcamera */
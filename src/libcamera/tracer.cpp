@@ -0,0 +1,628 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * In-process ring buffer tracer
+ */
+
+#include "libcamera/internal/tracer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <signal.h>
+#include <stdlib.h>
+#include <string_view>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
+
+/**
+ * \file tracer.h
+ * \brief In-process ring buffer tracer
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(Tracer)
+
+/**
+ * \class Tracer
+ * \brief Record tracepoints in memory and dump them in the Chrome trace format
+ *
+ * The Tracer is a lightweight alternative to lttng, meant for systems where an
+ * lttng session can't be deployed. It is fed from the LIBCAMERA_TRACEPOINT()
+ * call sites, and records events in binary form in one ring buffer per thread,
+ * without locking. Each event stores its timestamp, an event identifier and up
+ * to kMaxArgs arguments. Integer and pointer arguments are stored by value,
+ * and strings are copied and truncated to kMaxStringLength - 1 characters.
+ * When a ring buffer is full, the oldest events are overwritten.
+ *
+ * The tracer is enabled by setting the LIBCAMERA_TRACE_FILE environment
+ * variable to the path of the trace file, in which a "%p" is replaced by the
+ * process ID. The size of the ring buffers, in events, can be set with the
+ * LIBCAMERA_TRACE_BUFFER_SIZE environment variable. The ring buffers are
+ * dumped to the trace file when the process exits, and additionally on demand
+ * when the process receives the signal whose number is stored in the
+ * LIBCAMERA_TRACE_SIGNAL environment variable.
+ *
+ * The trace file uses the JSON Chrome trace event format, which can be opened
+ * in Perfetto or chrome://tracing. Events whose name ends with _begin or _end
+ * are reported as the beginning and end of a duration event, all other events
+ * are reported as instant events.
+ *
+ * When the tracer is disabled, the cost of a tracepoint is limited to a single
+ * relaxed atomic load. When enabled, recording an event costs a timestamp read
+ * and a copy of the event to the ring buffer.
+ */
+
+/**
+ * \var Tracer::kMaxArgs
+ * \brief The maximum number of arguments of a tracepoint
+ */
+
+/**
+ * \var Tracer::kMaxStringLength
+ * \brief The size of the storage for string arguments, including the
+ * terminating null character
+ */
+
+/**
+ * \enum Tracer::ArgType
+ * \brief The type of a recorded argument
+ * \var Tracer::ArgType::None
+ * \brief No argument
+ * \var Tracer::ArgType::Unsigned
+ * \brief An unsigned integer
+ * \var Tracer::ArgType::Signed
+ * \brief A signed integer
+ * \var Tracer::ArgType::Pointer
+ * \brief A pointer, stored as an integer
+ * \var Tracer::ArgType::String
+ * \brief A null-terminated string, truncated to Tracer::kMaxStringLength - 1
+ * characters
+ */
+
+/**
+ * \struct Tracer::Event
+ * \brief A recorded event
+ *
+ * \var Tracer::Event::timestamp
+ * \brief The time at which the event has been recorded, in nanoseconds, on
+ * the utils::clock clock
+ *
+ * \var Tracer::Event::id
+ * \brief The event identifier, as returned by Tracer::registerEvent()
+ *
+ * \var Tracer::Event::types
+ * \brief The type of the arguments
+ *
+ * \var Tracer::Event::args
+ * \brief The argument values
+ */
+
+/**
+ * \def LIBCAMERA_TRACER_RECORD
+ * \brief Record an event with the tracer
+ * \param[in] event The event name
+ *
+ * Record an event named \a event with the values of the variadic arguments.
+ * The argument names are the source text of the argument expressions.
+ *
+ * This macro is used by LIBCAMERA_TRACEPOINT() and shouldn't be used directly.
+ */
+
+/**
+ * \def LIBCAMERA_TRACER_RECORD_ARGS
+ * \brief Record an event with the tracer, with explicit argument names
+ * \param[in] event The event name
+ * \param[in] names The argument names, as a comma-separated string
+ *
+ * Record an event named \a event with the values of the variadic arguments.
+ */
+
+/*
+ * The Ring class stores the events of one thread. It is written by that thread
+ * only, and read concurrently by the thread dumping the trace. The reader
+ * copies the events, and then discards the ones that may have been overwritten
+ * during the copy.
+ */
+class Tracer::Ring
+{
+public:
+	Ring(unsigned int capacity)
+		: events_(std::make_unique<Event[]>(capacity)), capacity_(capacity),
+		  head_(0), tid_(syscall(SYS_gettid))
+	{
+		char name[16] = {};
+		prctl(PR_GET_NAME, name);
+		name_ = name;
+	}
+
+	void push(const Event &event)
+	{
+		uint64_t head = head_.load(std::memory_order_relaxed);
+		events_[head & (capacity_ - 1)] = event;
+		head_.store(head + 1, std::memory_order_release);
+	}
+
+	std::vector<Event> snapshot() const;
+
+	pid_t tid() const { return tid_; }
+	const std::string &name() const { return name_; }
+
+private:
+	std::unique_ptr<Event[]> events_;
+	unsigned int capacity_;
+	std::atomic<uint64_t> head_;
+
+	pid_t tid_;
+	std::string name_;
+};
+
+std::vector<Tracer::Event> Tracer::Ring::snapshot() const
+{
+	uint64_t head = head_.load(std::memory_order_acquire);
+	uint64_t first = head > capacity_ ? head - capacity_ : 0;
+
+	std::vector<Event> events;
+	events.reserve(head - first);
+	for (uint64_t i = first; i < head; ++i)
+		events.push_back(events_[i & (capacity_ - 1)]);
+
+	/*
+	 * The writer may have overwritten the oldest events, and may be
+	 * writing the next one, while they were copied. Drop them.
+	 */
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t end = head_.load(std::memory_order_relaxed);
+	if (end + 1 > first + capacity_) {
+		uint64_t stale = std::min<uint64_t>(end + 1 - capacity_ - first,
+						    events.size());
+		events.erase(events.begin(), events.begin() + stale);
+	}
+
+	return events;
+}
+
+namespace {
+
+int signalPipe = -1;
+struct sigaction oldSignalAction;
+
+void signalAction(int signal, siginfo_t *info, void *ucontext)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-result"
+	/*
+	 * We're in a signal handler so we can't dump the trace here. Wake up
+	 * the dump thread instead.
+	 */
+	char data = 0;
+	if (signalPipe != -1)
+		write(signalPipe, &data, sizeof(data));
+#pragma GCC diagnostic pop
+
+	if (oldSignalAction.sa_flags & SA_SIGINFO) {
+		oldSignalAction.sa_sigaction(signal, info, ucontext);
+	} else {
+		if (oldSignalAction.sa_handler != SIG_IGN &&
+		    oldSignalAction.sa_handler != SIG_DFL)
+			oldSignalAction.sa_handler(signal);
+	}
+}
+
+/* Write a JSON string, escaping the characters that require it. */
+void writeString(std::ostream &stream, std::string_view str)
+{
+	stream << '"';
+
+	for (char c : str) {
+		if (c == '"' || c == '\\')
+			stream << '\\' << c;
+		else if (static_cast<unsigned char>(c) < 0x20)
+			stream << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+			       << static_cast<unsigned int>(c) << std::dec;
+		else
+			stream << c;
+	}
+
+	stream << '"';
+}
+
+bool endsWith(std::string_view str, std::string_view suffix)
+{
+	return str.size() >= suffix.size() &&
+	       str.substr(str.size() - suffix.size()) == suffix;
+}
+
+/* Split a comma-separated list of expressions, ignoring nested commas. */
+std::vector<std::string> splitArgs(std::string_view names)
+{
+	std::vector<std::string> args;
+	unsigned int depth = 0;
+	bool quoted = false;
+	size_t start = 0;
+
+	for (size_t i = 0; i <= names.size(); ++i) {
+		char c = i < names.size() ? names[i] : ',';
+
+		if (quoted) {
+			if (c == '\\')
+				++i;
+			else if (c == '"')
+				quoted = false;
+			continue;
+		}
+
+		if (c == '"') {
+			quoted = true;
+		} else if (c == '(' || c == '[' || c == '{') {
+			depth++;
+		} else if ((c == ')' || c == ']' || c == '}') && depth) {
+			depth--;
+		} else if (c == ',' && !depth) {
+			std::string_view arg = names.substr(start, i - start);
+
+			size_t begin = arg.find_first_not_of(" \t\n");
+			size_t end = arg.find_last_not_of(" \t\n");
+			if (begin != std::string_view::npos)
+				args.emplace_back(arg.substr(begin, end - begin + 1));
+			else
+				args.emplace_back();
+
+			start = i + 1;
+		}
+	}
+
+	return args;
+}
+
+} /* namespace */
+
+/*
+ * The SignalHandler dumps the trace when the process receives a signal, from
+ * a dedicated thread woken up by the signal handler through a pipe.
+ */
+struct Tracer::SignalHandler {
+	SignalHandler(Tracer *tracer, int signal)
+		: signal_(signal), valid_(false)
+	{
+		int fds[2];
+		if (pipe2(fds, O_CLOEXEC)) {
+			LOG(Tracer, Error)
+				<< "Failed to create the signal pipe: "
+				<< strerror(errno);
+			return;
+		}
+
+		pipe_[0] = UniqueFD(fds[0]);
+		pipe_[1] = UniqueFD(fds[1]);
+		signalPipe = pipe_[1].get();
+
+		struct sigaction sa = {};
+		sa.sa_sigaction = &signalAction;
+		sa.sa_flags = SA_SIGINFO | SA_RESTART;
+		sigemptyset(&sa.sa_mask);
+
+		if (sigaction(signal_, &sa, &oldSignalAction)) {
+			LOG(Tracer, Error)
+				<< "Failed to install the handler for signal "
+				<< signal_ << ": " << strerror(errno);
+			signalPipe = -1;
+			return;
+		}
+
+		thread_ = std::thread([this, tracer]() { run(tracer); });
+		valid_ = true;
+	}
+
+	~SignalHandler()
+	{
+		if (!valid_)
+			return;
+
+		sigaction(signal_, &oldSignalAction, nullptr);
+		signalPipe = -1;
+
+		/* Closing the write end of the pipe stops the thread. */
+		pipe_[1].reset();
+		thread_.join();
+	}
+
+	void run(Tracer *tracer)
+	{
+		while (true) {
+			char data;
+			ssize_t ret = read(pipe_[0].get(), &data, sizeof(data));
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret <= 0)
+				break;
+
+			tracer->dumpToFile();
+		}
+	}
+
+	int signal_;
+	bool valid_;
+	UniqueFD pipe_[2];
+	std::thread thread_;
+};
+
+std::atomic<Tracer::State> Tracer::state_ = Tracer::State::Unknown;
+
+namespace {
+
+bool tracerDestroyed = false;
+
+} /* namespace */
+
+Tracer::Tracer()
+	: capacity_(8192)
+{
+	const char *path = utils::secure_getenv("LIBCAMERA_TRACE_FILE");
+	if (!path || !*path) {
+		state_.store(State::Disabled, std::memory_order_relaxed);
+		return;
+	}
+
+	path_ = path;
+	size_t pos = path_.find("%p");
+	if (pos != std::string::npos)
+		path_.replace(pos, 2, std::to_string(getpid()));
+
+	const char *size = utils::secure_getenv("LIBCAMERA_TRACE_BUFFER_SIZE");
+	if (size) {
+		unsigned long value = strtoul(size, nullptr, 10);
+		capacity_ = 64;
+		while (capacity_ < value && capacity_ < (1U << 24))
+			capacity_ <<= 1;
+	}
+
+	const char *signal = utils::secure_getenv("LIBCAMERA_TRACE_SIGNAL");
+	if (signal) {
+		int signum = atoi(signal);
+		if (signum > 0 && signum < NSIG)
+			signal_ = std::make_unique<SignalHandler>(this, signum);
+		else
+			LOG(Tracer, Warning) << "Invalid trace signal " << signal;
+	}
+
+	LOG(Tracer, Info)
+		<< "Tracing to " << path_ << " with " << capacity_
+		<< " events per thread";
+
+	state_.store(State::Enabled, std::memory_order_release);
+}
+
+/**
+ * \brief Destroy the tracer and dump the trace if enabled
+ */
+Tracer::~Tracer()
+{
+	if (state_.load(std::memory_order_acquire) == State::Enabled) {
+		state_.store(State::Disabled, std::memory_order_release);
+		signal_.reset();
+		dumpToFile();
+	}
+
+	tracerDestroyed = true;
+}
+
+/**
+ * \brief Retrieve the tracer instance
+ * \return The tracer instance, or nullptr if the tracer has been destroyed
+ */
+Tracer *Tracer::instance()
+{
+	static Tracer instance;
+
+	if (tracerDestroyed)
+		return nullptr;
+
+	return &instance;
+}
+
+/**
+ * \fn Tracer::enabled()
+ * \brief Check if the tracer is enabled
+ *
+ * The tracer is initialized the first time this function is called.
+ *
+ * \return True if the tracer is enabled, false otherwise
+ */
+
+Tracer::State Tracer::initialize()
+{
+	if (!instance())
+		return State::Disabled;
+
+	return state_.load(std::memory_order_acquire);
+}
+
+/**
+ * \brief Register an event
+ * \param[in] name The event name
+ * \param[in] argNames The argument names, as a comma-separated string
+ *
+ * Register the event, and copy its name and argument names, as they may be
+ * stored in an IPA module that can be unloaded before the trace is dumped.
+ * This function is called once for each tracepoint, the first time it is hit.
+ *
+ * \return The event identifier to be passed to record()
+ */
+unsigned int Tracer::registerEvent(const char *name, const char *argNames)
+{
+	Tracer *tracer = instance();
+	if (!tracer)
+		return 0;
+
+	MutexLocker locker(tracer->mutex_);
+	tracer->events_.push_back({ name, splitArgs(argNames) });
+	return tracer->events_.size() - 1;
+}
+
+/**
+ * \fn Tracer::record()
+ * \brief Record an event
+ * \param[in] id The event identifier, as returned by registerEvent()
+ * \param[in] args The event arguments
+ *
+ * The arguments shall be integers, enumerations, pointers or strings.
+ *
+ * \context This function is \threadsafe.
+ */
+
+void Tracer::write(Event &event)
+{
+	Tracer *tracer = instance();
+	if (!tracer)
+		return;
+
+	event.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		utils::clock::now().time_since_epoch()).count();
+
+	tracer->threadRing()->push(event);
+}
+
+Tracer::Ring *Tracer::threadRing()
+{
+	thread_local std::shared_ptr<Ring> ring;
+
+	if (ring)
+		return ring.get();
+
+	/*
+	 * The tracer keeps a reference to the ring buffer, to dump the events
+	 * of threads that have exited.
+	 */
+	ring = std::make_shared<Ring>(capacity_);
+
+	MutexLocker locker(mutex_);
+	rings_.push_back(ring);
+
+	return ring.get();
+}
+
+/**
+ * \brief Dump the recorded events in the JSON Chrome trace event format
+ * \param[in] stream The stream to write the trace to
+ *
+ * Events can be recorded concurrently while the trace is dumped.
+ *
+ * \context This function is \threadsafe.
+ */
+void Tracer::dump(std::ostream &stream)
+{
+	std::vector<std::shared_ptr<Ring>> rings;
+	std::vector<EventInfo> events;
+
+	{
+		MutexLocker locker(mutex_);
+		rings = rings_;
+		events = events_;
+	}
+
+	pid_t pid = getpid();
+	const char *separator = "\n";
+
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	for (const std::shared_ptr<Ring> &ring : rings) {
+		stream << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"
+		       << pid << ",\"tid\":" << ring->tid() << ",\"args\":{\"name\":";
+		writeString(stream, ring->name());
+		stream << "}}";
+		separator = ",\n";
+
+		for (const Event &event : ring->snapshot()) {
+			if (event.id >= events.size())
+				continue;
+
+			const EventInfo &info = events[event.id];
+			std::string_view name = info.name;
+			const char *phase = "i";
+
+			if (endsWith(name, "_begin")) {
+				name.remove_suffix(6);
+				phase = "B";
+			} else if (endsWith(name, "_end")) {
+				name.remove_suffix(4);
+				phase = "E";
+			}
+
+			stream << separator << "{\"name\":";
+			writeString(stream, name);
+			stream << ",\"cat\":\"libcamera\",\"ph\":\"" << phase << "\"";
+			if (phase[0] == 'i')
+				stream << ",\"s\":\"t\"";
+			stream << ",\"ts\":" << event.timestamp / 1000 << "."
+			       << std::setw(3) << std::setfill('0')
+			       << event.timestamp % 1000
+			       << ",\"pid\":" << pid << ",\"tid\":" << ring->tid()
+			       << ",\"args\":{";
+
+			for (unsigned int i = 0; i < kMaxArgs; ++i) {
+				if (event.types[i] == ArgType::None)
+					break;
+
+				if (i)
+					stream << ",";
+
+				if (i < info.argNames.size() && !info.argNames[i].empty())
+					writeString(stream, info.argNames[i]);
+				else
+					writeString(stream, "arg" + std::to_string(i));
+
+				stream << ":";
+
+				switch (event.types[i]) {
+				case ArgType::Unsigned:
+					stream << event.args[i].value;
+					break;
+				case ArgType::Signed:
+					stream << static_cast<int64_t>(event.args[i].value);
+					break;
+				case ArgType::Pointer:
+					stream << "\"0x" << std::hex << event.args[i].value
+					       << std::dec << "\"";
+					break;
+				case ArgType::String:
+					writeString(stream, event.args[i].string);
+					break;
+				case ArgType::None:
+					break;
+				}
+			}
+
+			stream << "}}";
+		}
+	}
+
+	stream << "\n]}\n";
+}
+
+void Tracer::dumpToFile()
+{
+	MutexLocker locker(dumpMutex_);
+
+	std::ofstream file(path_, std::ios::out | std::ios::trunc);
+	if (!file.good()) {
+		LOG(Tracer, Error) << "Failed to open trace file " << path_;
+		return;
+	}
+
+	dump(file);
+	file.close();
+
+	LOG(Tracer, Info) << "Trace written to " << path_;
+}
+
+} /* namespace libcamera */
@@ -0,0 +1,374 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Dedicated thread to dequeue buffers from V4L2 video devices
+ */
+
+#include "libcamera/internal/v4l2_dequeue_poller.h"
+
+#include <errno.h>
+#include <map>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <libcamera/base/event_notifier.h>
+#include <libcamera/base/log.h>
+#include <libcamera/base/object.h>
+
+/**
+ * \file v4l2_dequeue_poller.h
+ * \brief Dedicated thread to dequeue buffers from V4L2 video devices
+ */
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(V4L2)
+
+/*
+ * The worker lives in the poller thread. It owns the event notifiers that
+ * monitor the video devices, and enables them only when buffers are queued to
+ * the device, as V4L2 reports an error condition when polling a streaming
+ * device that has no buffer queued.
+ */
+class V4L2DequeuePoller::Worker : public Object
+{
+public:
+	void add(Channel *channel);
+	void remove(Channel *channel);
+	void arm(Channel *channel);
+
+private:
+	void dequeue(Channel *channel);
+
+	std::map<Channel *, std::unique_ptr<EventNotifier>> notifiers_;
+};
+
+void V4L2DequeuePoller::Worker::add(Channel *channel)
+{
+	EventNotifier::Type type = V4L2_TYPE_IS_OUTPUT(channel->bufferType_)
+				 ? EventNotifier::Write : EventNotifier::Read;
+
+	auto notifier = std::make_unique<EventNotifier>(channel->fd_, type);
+	notifier->activated.connect(this, [this, channel]() { dequeue(channel); });
+	notifier->setEnabled(channel->armed());
+
+	notifiers_[channel] = std::move(notifier);
+}
+
+void V4L2DequeuePoller::Worker::remove(Channel *channel)
+{
+	notifiers_.erase(channel);
+}
+
+void V4L2DequeuePoller::Worker::arm(Channel *channel)
+{
+	auto it = notifiers_.find(channel);
+	if (it == notifiers_.end())
+		return;
+
+	it->second->setEnabled(channel->armed());
+}
+
+void V4L2DequeuePoller::Worker::dequeue(Channel *channel)
+{
+	if (!channel->dequeue())
+		notifiers_[channel]->setEnabled(false);
+}
+
+/**
+ * \class V4L2DequeuePoller
+ * \brief Dequeue buffers from a group of V4L2 video devices in a dedicated
+ * thread
+ *
+ * V4L2VideoDevice instances dequeue completed buffers in the thread they are
+ * bound to, when the event loop of that thread notifies that the device is
+ * ready. When the thread is busy, for instance handling IPA calls or
+ * validating configurations, dequeuing is delayed, and so are the buffer
+ * completion and the processing that depends on it.
+ *
+ * The V4L2DequeuePoller class runs a dedicated thread that monitors a group of
+ * video devices and dequeues their buffers as soon as they complete. The
+ * thread optionally runs with a real-time scheduling policy. Each video device
+ * attaches to the poller through a Channel, which hands the dequeued buffers
+ * to the thread the device is bound to through a lock-free ring buffer, and
+ * wakes that thread up through an eventfd. The thread the device is bound to
+ * then completes the buffers as usual.
+ *
+ * A single poller is typically shared by all the video devices of a pipeline
+ * handler. It shall outlive all its channels.
+ */
+
+/**
+ * \struct V4L2DequeuePoller::Completion
+ * \brief A buffer dequeued by the poller thread
+ *
+ * \var V4L2DequeuePoller::Completion::buffer
+ * \brief The buffer returned by VIDIOC_DQBUF
+ *
+ * \var V4L2DequeuePoller::Completion::planes
+ * \brief The planes array of the buffer for the multi-planar API
+ */
+
+/**
+ * \class V4L2DequeuePoller::Channel
+ * \brief The connection between a video device and a V4L2DequeuePoller
+ *
+ * A Channel is created by V4L2DequeuePoller::attach() for a streaming video
+ * device. The video device reports every buffer it queues with queued(), the
+ * poller thread dequeues them when they complete, and the ready signal is
+ * emitted in the thread that attached the channel when completed buffers can
+ * be retrieved with pop().
+ *
+ * The functions of this class, with the exception of the constructor, shall
+ * be called from the thread that attached the channel.
+ */
+
+V4L2DequeuePoller::Channel::Channel(Worker *worker, int fd,
+				    enum v4l2_buf_type bufferType,
+				    enum v4l2_memory memoryType,
+				    unsigned int queued)
+	: worker_(worker), fd_(fd), bufferType_(bufferType),
+	  memoryType_(memoryType), stopped_(false), queued_(queued),
+	  stalled_(false), head_(0), tail_(0)
+{
+	eventFd_ = UniqueFD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+	if (!eventFd_.isValid()) {
+		int ret = errno;
+		LOG(V4L2, Error)
+			<< "Failed to create eventfd: " << strerror(ret);
+		return;
+	}
+
+	eventNotifier_ = std::make_unique<EventNotifier>(eventFd_.get(),
+							 EventNotifier::Read);
+	eventNotifier_->activated.connect(this, &Channel::notified);
+}
+
+/**
+ * \brief Destroy the channel, stopping it if needed
+ */
+V4L2DequeuePoller::Channel::~Channel()
+{
+	stop();
+}
+
+/**
+ * \brief Notify the poller that a buffer has been queued to the device
+ */
+void V4L2DequeuePoller::Channel::queued()
+{
+	if (stopped_)
+		return;
+
+	if (queued_.fetch_add(1) == 0 || stalled_.exchange(false))
+		worker_->invokeMethod(&Worker::arm, ConnectionTypeQueued, this);
+}
+
+/**
+ * \brief Retrieve the next buffer dequeued by the poller thread
+ * \param[out] completion The dequeued buffer
+ *
+ * The planes pointer of the V4L2 buffer is updated to point to the
+ * \a completion planes array for the multi-planar API.
+ *
+ * \return True if a buffer has been retrieved, false if no buffer is pending
+ */
+bool V4L2DequeuePoller::Channel::pop(Completion *completion)
+{
+	unsigned int tail = tail_.load(std::memory_order_relaxed);
+	if (tail == head_.load(std::memory_order_acquire))
+		return false;
+
+	*completion = ring_[tail % kRingSize];
+	tail_.store(tail + 1);
+
+	if (V4L2_TYPE_IS_MULTIPLANAR(bufferType_))
+		completion->buffer.m.planes = completion->planes;
+
+	/* Resume dequeuing if it was suspended. */
+	if (stalled_.exchange(false) && !stopped_)
+		worker_->invokeMethod(&Worker::arm, ConnectionTypeQueued, this);
+
+	return true;
+}
+
+/**
+ * \brief Stop dequeuing buffers
+ *
+ * This function detaches the channel from the poller thread, waiting for any
+ * dequeue operation in progress to complete. Buffers already dequeued by the
+ * poller thread can still be retrieved with pop(). The channel can't be
+ * restarted.
+ */
+void V4L2DequeuePoller::Channel::stop()
+{
+	if (stopped_)
+		return;
+
+	stopped_ = true;
+	worker_->invokeMethod(&Worker::remove, ConnectionTypeBlocking, this);
+}
+
+/**
+ * \var V4L2DequeuePoller::Channel::ready
+ * \brief A Signal emitted when buffers dequeued by the poller are available
+ */
+
+void V4L2DequeuePoller::Channel::notified()
+{
+	uint64_t value;
+	ssize_t ret = read(eventFd_.get(), &value, sizeof(value));
+	if (ret < 0 && errno != EAGAIN)
+		LOG(V4L2, Error) << "Failed to read eventfd: " << strerror(errno);
+
+	ready.emit();
+}
+
+/* Tell if the device needs to be monitored. Called from the poller thread. */
+bool V4L2DequeuePoller::Channel::armed() const
+{
+	unsigned int head = head_.load(std::memory_order_relaxed);
+
+	return queued_.load() && head - tail_.load() < kRingSize;
+}
+
+/*
+ * Dequeue all completed buffers from the device. Called from the poller
+ * thread, return false if the device doesn't need to be monitored anymore.
+ */
+bool V4L2DequeuePoller::Channel::dequeue()
+{
+	bool notify = false;
+	bool monitor = true;
+
+	while (queued_.load()) {
+		unsigned int head = head_.load(std::memory_order_relaxed);
+
+		if (head - tail_.load() == kRingSize) {
+			/*
+			 * The ring buffer is full, wait for pop() to resume
+			 * dequeuing. Check again after setting the stalled flag
+			 * to catch buffers popped in the meantime.
+			 */
+			stalled_.store(true);
+			if (head - tail_.load() == kRingSize) {
+				monitor = false;
+				break;
+			}
+
+			stalled_.store(false);
+		}
+
+		Completion &completion = ring_[head % kRingSize];
+		struct v4l2_buffer &buf = completion.buffer;
+
+		buf = {};
+		buf.type = bufferType_;
+		buf.memory = memoryType_;
+
+		if (V4L2_TYPE_IS_MULTIPLANAR(buf.type)) {
+			buf.length = VIDEO_MAX_PLANES;
+			buf.m.planes = completion.planes;
+		}
+
+		if (::ioctl(fd_, VIDIOC_DQBUF, &buf) < 0) {
+			int ret = errno;
+			if (ret == EAGAIN)
+				break;
+
+			/*
+			 * Stop monitoring the device until the next buffer is
+			 * queued or popped, to avoid spinning on persistent
+			 * errors in a thread that may run with a real-time
+			 * priority.
+			 */
+			LOG(V4L2, Error)
+				<< "Failed to dequeue buffer: " << strerror(ret);
+			stalled_.store(true);
+			monitor = false;
+			break;
+		}
+
+		head_.store(head + 1, std::memory_order_release);
+		notify = true;
+
+		if (queued_.fetch_sub(1) == 1)
+			monitor = false;
+	}
+
+	if (!queued_.load())
+		monitor = false;
+
+	if (notify) {
+		uint64_t value = 1;
+		ssize_t ret = write(eventFd_.get(), &value, sizeof(value));
+		if (ret < 0)
+			LOG(V4L2, Error)
+				<< "Failed to write eventfd: " << strerror(errno);
+	}
+
+	return monitor;
+}
+
+/**
+ * \brief Create a poller and start its thread
+ * \param[in] name The name of the poller thread
+ * \param[in] priority The real-time priority of the poller thread
+ *
+ * The poller thread runs with the SCHED_FIFO scheduling policy at the given
+ * \a priority when \a priority is not 0, which usually requires the
+ * CAP_SYS_NICE capability. Otherwise, it inherits the default scheduling of
+ * libcamera threads.
+ */
+V4L2DequeuePoller::V4L2DequeuePoller(const std::string &name, int priority)
+	: worker_(std::make_unique<Worker>())
+{
+	thread_.setThreadName(name);
+	if (priority)
+		thread_.setSchedulingPolicy(Thread::SchedulingPolicy::Fifo, priority);
+
+	worker_->moveToThread(&thread_);
+	thread_.start();
+}
+
+V4L2DequeuePoller::~V4L2DequeuePoller()
+{
+	thread_.exit();
+	thread_.wait();
+}
+
+/**
+ * \brief Attach a video device to the poller
+ * \param[in] fd The file descriptor of the video device
+ * \param[in] bufferType The V4L2 buffer type of the video device
+ * \param[in] memoryType The V4L2 memory type of the video device buffers
+ * \param[in] queued The number of buffers currently queued to the device
+ *
+ * The poller thread starts monitoring the device when the function returns.
+ * The device shall stay open until the returned channel is stopped or
+ * destroyed.
+ *
+ * \return The channel for the video device, or nullptr on error
+ */
+std::unique_ptr<V4L2DequeuePoller::Channel>
+V4L2DequeuePoller::attach(int fd, enum v4l2_buf_type bufferType,
+			  enum v4l2_memory memoryType, unsigned int queued)
+{
+	std::unique_ptr<Channel> channel{
+		new Channel(worker_.get(), fd, bufferType, memoryType, queued)
+	};
+	if (!channel->eventFd_.isValid()) {
+		channel->stopped_ = true;
+		return nullptr;
+	}
+
+	worker_->invokeMethod(&Worker::add, ConnectionTypeBlocking, channel.get());
+
+	return channel;
+}
+
+} /* namespace libcamera */
@@ -16,6 +16,7 @@
 #include <sys/ioctl.h>
 #include <sys/syscall.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 #include <linux/v4l2-mediabus.h>
@@ -25,6 +26,7 @@
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/formats.h"
+#include "libcamera/internal/media_device.h"
 #include "libcamera/internal/sysfs.h"
 
 /**
@@ -59,7 +61,7 @@ LOG_DEFINE_CATEGORY(V4L2)
  */
 V4L2Device::V4L2Device(const std::string &deviceNode)
 	: deviceNode_(deviceNode), fdEventNotifier_(nullptr),
-	  frameStartEnabled_(false)
+	  frameStartEnabled_(false), frameStartCoalescing_(false)
 {
 }
 
@@ -145,6 +147,7 @@ void V4L2Device::close()
 
 	delete fdEventNotifier_;
 
+	pendingControls_.clear();
 	fd_.reset();
 }
 
@@ -260,11 +263,16 @@ ControlList V4L2Device::getControls(const std::vector<uint32_t> &ids)
 /**
  * \brief Write controls to the device
  * \param[in] ctrls The list of controls to write
+ * \param[in] request An optional media request to bind the controls to
  *
  * This function writes the value of all controls contained in \a ctrls, and
  * stores the values actually applied to the device in the corresponding
  * \a ctrls entry.
  *
+ * If a \a request is given, the controls are stored in the request instead of
+ * being applied immediately, and are applied by the driver when it processes
+ * the request. The values in \a ctrls are not updated in that case.
+ *
  * If any control in \a ctrls is not supported by the device, is disabled (i.e.
  * has the V4L2_CTRL_FLAG_DISABLED flag set), is read-only, if any other error
  * occurs during validation of the requested controls, no control is written and
@@ -279,7 +287,7 @@ ControlList V4L2Device::getControls(const std::vector<uint32_t> &ids)
  * \retval -EINVAL One of the control is not supported or not accessible
  * \retval i The index of the control that failed
  */
-int V4L2Device::setControls(ControlList *ctrls)
+int V4L2Device::setControls(ControlList *ctrls, const MediaRequest *request)
 {
 	if (ctrls->empty())
 		return 0;
@@ -344,6 +352,11 @@ int V4L2Device::setControls(ControlList *ctrls)
 	v4l2ExtCtrls.controls = v4l2Ctrls.data();
 	v4l2ExtCtrls.count = v4l2Ctrls.size();
 
+	if (request) {
+		v4l2ExtCtrls.which = V4L2_CTRL_WHICH_REQUEST_VAL;
+		v4l2ExtCtrls.request_fd = request->fd().get();
+	}
+
 	int ret = ioctl(VIDIOC_S_EXT_CTRLS, &v4l2ExtCtrls);
 	if (ret) {
 		unsigned int errorIdx = v4l2ExtCtrls.error_idx;
@@ -364,7 +377,62 @@ int V4L2Device::setControls(ControlList *ctrls)
 		ret = errorIdx;
 	}
 
-	updateControls(ctrls, v4l2Ctrls);
+	/* Controls stored in a request are only applied when it gets queued. */
+	if (!request)
+		updateControls(ctrls, v4l2Ctrls);
+
+	return ret;
+}
+
+/**
+ * \brief Queue controls to be written to the device
+ * \param[in] ctrls The list of controls to queue
+ *
+ * This function stores the controls in \a ctrls in a list of pending controls,
+ * without writing them to the device. The pending controls are written with a
+ * single VIDIOC_S_EXT_CTRLS ioctl by the next call to flushControls(). This
+ * allows multiple components that set controls on the same device for the
+ * same frame to share a single ioctl call.
+ *
+ * If a control is queued multiple times before the pending controls are
+ * flushed, only the last value is written.
+ *
+ * Controls that need to be written before other controls, such as the
+ * vertical blanking that bounds the exposure time, shall be written with
+ * setControls() instead, as controls written with a single ioctl are all
+ * validated against the current device state.
+ */
+void V4L2Device::queueControls(const ControlList &ctrls)
+{
+	if (pendingControls_.empty())
+		pendingControls_ = ControlList(controls_);
+
+	pendingControls_.merge(ctrls, ControlList::MergePolicy::OverwriteExisting);
+}
+
+/**
+ * \brief Write the pending controls to the device
+ * \param[out] ctrls The list of controls written to the device (optional)
+ *
+ * This function writes all the controls queued with queueControls() since the
+ * last call to this function with a single VIDIOC_S_EXT_CTRLS ioctl, and
+ * clears the pending controls. If \a ctrls is not null, it is set to the list
+ * of written controls, with the values actually applied to the device, which
+ * the return value indexes in case of error.
+ *
+ * \return 0 on success or an error code otherwise, as for setControls()
+ * \retval -EINVAL One of the control is not supported or not accessible
+ * \retval i The index of the control that failed
+ */
+int V4L2Device::flushControls(ControlList *ctrls)
+{
+	ControlList pending = std::move(pendingControls_);
+	pendingControls_.clear();
+
+	int ret = setControls(&pending);
+
+	if (ctrls)
+		*ctrls = std::move(pending);
 
 	return ret;
 }
@@ -441,6 +509,20 @@ int V4L2Device::setFrameStartEnabled(bool enable)
 	return ret;
 }
 
+/**
+ * \fn V4L2Device::setFrameStartCoalescing()
+ * \brief Enable or disable coalescing of frame start events
+ * \param[in] coalesce True to coalesce frame start events
+ *
+ * When multiple frame start events are pending when the device is serviced,
+ * for instance at high frame rates or when the event loop is busy, the
+ * frameStart signal is emitted for each of them by default. When coalescing is
+ * enabled, the signal is emitted once, with the sequence number of the most
+ * recent frame. Coalescing is only suitable for receivers that care about the
+ * latest frame only. DelayedControls, in particular, requires the signal to be
+ * emitted for every frame.
+ */
+
 /**
  * \var V4L2Device::frameStart
  * \brief A Signal emitted when capture of a frame has started
@@ -746,24 +828,41 @@ void V4L2Device::updateControls(ControlList *ctrls,
  */
 void V4L2Device::eventAvailable()
 {
+	std::optional<uint32_t> sequence;
 	struct v4l2_event event{};
-	int ret = ioctl(VIDIOC_DQEVENT, &event);
-	if (ret < 0) {
-		LOG(V4L2, Error)
-			<< "Failed to dequeue event, disabling event notifier";
-		fdEventNotifier_->setEnabled(false);
-		return;
-	}
 
-	if (event.type != V4L2_EVENT_FRAME_SYNC) {
-		LOG(V4L2, Error)
-			<< "Spurious event (" << event.type
-			<< "), disabling event notifier";
-		fdEventNotifier_->setEnabled(false);
-		return;
-	}
+	/*
+	 * Dequeue all pending events, using the number of pending events
+	 * reported by the kernel to avoid blocking on subdevices opened in
+	 * blocking mode. Stop if a slot disables frame start events, as the
+	 * pending events are then discarded.
+	 */
+	do {
+		event = {};
+		int ret = ioctl(VIDIOC_DQEVENT, &event);
+		if (ret < 0) {
+			LOG(V4L2, Error)
+				<< "Failed to dequeue event, disabling event notifier";
+			fdEventNotifier_->setEnabled(false);
+			break;
+		}
+
+		if (event.type != V4L2_EVENT_FRAME_SYNC) {
+			LOG(V4L2, Error)
+				<< "Spurious event (" << event.type
+				<< "), disabling event notifier";
+			fdEventNotifier_->setEnabled(false);
+			break;
+		}
 
-	frameStart.emit(event.u.frame_sync.frame_sequence);
+		if (frameStartCoalescing_)
+			sequence = event.u.frame_sync.frame_sequence;
+		else
+			frameStart.emit(event.u.frame_sync.frame_sequence);
+	} while (event.pending && frameStartEnabled_);
+
+	if (sequence)
+		frameStart.emit(*sequence);
 }
 
 static const std::map<uint32_t, ColorSpace> v4l2ToColorSpace = {
@@ -830,6 +929,19 @@ static const std::map<ColorSpace::Range, v4l2_quantization> rangeToV4l2 = {
 	{ ColorSpace::Range::Limited, V4L2_QUANTIZATION_LIM_RANGE },
 };
 
+/*
+ * The LOG() macro resolves to the Loggable::_log() member function in the
+ * scope of the V4L2Device class, which can't be called from static member
+ * functions. Log the unrecognised color space fields from a free function.
+ */
+static void logUnrecognisedField(const char *field,
+				 const std::optional<ColorSpace> &colorSpace)
+{
+	LOG(V4L2, Warning)
+		<< "Unrecognised " << field << " in "
+		<< ColorSpace::toString(colorSpace);
+}
+
 /**
  * \brief Convert the color space fields in a V4L2 format to a ColorSpace
  * \param[in] v4l2Format A V4L2 format containing color space information
@@ -954,9 +1066,7 @@ int V4L2Device::fromColorSpace(const std::optional<ColorSpace> &colorSpace, T &v
 	if (itPrimaries != primariesToV4l2.end()) {
 		v4l2Format.colorspace = itPrimaries->second;
 	} else {
-		libcamera::LOG(V4L2, Warning)
-			<< "Unrecognised primaries in "
-			<< ColorSpace::toString(colorSpace);
+		logUnrecognisedField("primaries", colorSpace);
 		ret = -EINVAL;
 	}
 
@@ -964,9 +1074,7 @@ int V4L2Device::fromColorSpace(const std::optional<ColorSpace> &colorSpace, T &v
 	if (itTransfer != transferFunctionToV4l2.end()) {
 		v4l2Format.xfer_func = itTransfer->second;
 	} else {
-		libcamera::LOG(V4L2, Warning)
-			<< "Unrecognised transfer function in "
-			<< ColorSpace::toString(colorSpace);
+		logUnrecognisedField("transfer function", colorSpace);
 		ret = -EINVAL;
 	}
 
@@ -974,9 +1082,7 @@ int V4L2Device::fromColorSpace(const std::optional<ColorSpace> &colorSpace, T &v
 	if (itYcbcrEncoding != ycbcrEncodingToV4l2.end()) {
 		v4l2Format.ycbcr_enc = itYcbcrEncoding->second;
 	} else {
-		libcamera::LOG(V4L2, Warning)
-			<< "Unrecognised YCbCr encoding in "
-			<< ColorSpace::toString(colorSpace);
+		logUnrecognisedField("YCbCr encoding", colorSpace);
 		ret = -EINVAL;
 	}
 
@@ -984,9 +1090,7 @@ int V4L2Device::fromColorSpace(const std::optional<ColorSpace> &colorSpace, T &v
 	if (itRange != rangeToV4l2.end()) {
 		v4l2Format.quantization = itRange->second;
 	} else {
-		libcamera::LOG(V4L2, Warning)
-			<< "Unrecognised quantization in "
-			<< ColorSpace::toString(colorSpace);
+		logUnrecognisedField("quantization", colorSpace);
 		ret = -EINVAL;
 	}
 
@@ -8,8 +8,8 @@
 
 #include "libcamera/internal/v4l2_pixelformat.h"
 
+#include <algorithm>
 #include <ctype.h>
-#include <map>
 #include <string.h>
 
 #include <libcamera/base/log.h>
@@ -18,6 +18,7 @@
 #include <libcamera/pixel_format.h>
 
 #include "libcamera/internal/formats.h"
+#include "libcamera/internal/sorted_table.h"
 
 /**
  * \file v4l2_pixelformat.h
@@ -45,7 +46,17 @@ LOG_DECLARE_CATEGORY(V4L2)
 
 namespace {
 
-const std::map<V4L2PixelFormat, V4L2PixelFormat::Info> vpf2pf{
+struct V4L2PixelFormatEntry {
+	V4L2PixelFormat v4l2Format;
+	V4L2PixelFormat::Info info;
+};
+
+constexpr uint32_t v4l2FormatKey(const V4L2PixelFormatEntry &entry)
+{
+	return entry.v4l2Format.fourcc();
+}
+
+constexpr V4L2PixelFormatEntry vpf2pfEntries[] = {
 	/* RGB formats. */
 	{ V4L2PixelFormat(V4L2_PIX_FMT_RGB565),
 		{ formats::RGB565, "16-bit RGB 5-6-5" } },
@@ -225,6 +236,11 @@ const std::map<V4L2PixelFormat, V4L2PixelFormat::Info> vpf2pf{
 		{ formats::MJPEG, "JPEG JFIF" } },
 };
 
+/* Sorted by V4L2 FourCC for binary search, without static initialization */
+constexpr auto vpf2pf = utils::sortedTable(vpf2pfEntries, v4l2FormatKey);
+static_assert(utils::sortedTableIsUnique(vpf2pf, v4l2FormatKey),
+	      "Duplicated V4L2 pixel formats");
+
 } /* namespace */
 
 /**
@@ -313,15 +329,16 @@ std::string V4L2PixelFormat::toString() const
  */
 const char *V4L2PixelFormat::description() const
 {
-	const auto iter = vpf2pf.find(*this);
-	if (iter == vpf2pf.end()) {
+	const V4L2PixelFormatEntry *entry =
+		utils::sortedTableFind(vpf2pf, fourcc_, v4l2FormatKey);
+	if (!entry) {
 		LOG(V4L2, Warning)
 			<< "Unsupported V4L2 pixel format "
 			<< toString();
 		return "Unsupported format";
 	}
 
-	return iter->second.description;
+	return entry->info.description;
 }
 
 /**
@@ -338,15 +355,16 @@ const char *V4L2PixelFormat::description() const
  */
 PixelFormat V4L2PixelFormat::toPixelFormat(bool warn) const
 {
-	const auto iter = vpf2pf.find(*this);
-	if (iter == vpf2pf.end()) {
+	const V4L2PixelFormatEntry *entry =
+		utils::sortedTableFind(vpf2pf, fourcc_, v4l2FormatKey);
+	if (!entry) {
 		if (warn)
 			LOG(V4L2, Warning) << "Unsupported V4L2 pixel format "
 					   << toString();
 		return PixelFormat();
 	}
 
-	return iter->second.format;
+	return entry->info.format;
 }
 
 /**
@@ -358,16 +376,18 @@ PixelFormat V4L2PixelFormat::toPixelFormat(bool warn) const
  *
  * \return The list of V4L2PixelFormat corresponding to \a pixelFormat
  */
-const std::vector<V4L2PixelFormat> &
+Span<const V4L2PixelFormat>
 V4L2PixelFormat::fromPixelFormat(const PixelFormat &pixelFormat)
 {
-	static const std::vector<V4L2PixelFormat> empty;
-
 	const PixelFormatInfo &info = PixelFormatInfo::info(pixelFormat);
 	if (!info.isValid())
-		return empty;
+		return {};
+
+	const std::array<V4L2PixelFormat, 2> &formats = info.v4l2Formats;
+	size_t count = std::find(formats.begin(), formats.end(), V4L2PixelFormat()) -
+		       formats.begin();
 
-	return info.v4l2Formats;
+	return { formats.data(), count };
 }
 
 /**
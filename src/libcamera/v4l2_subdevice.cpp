@@ -7,6 +7,7 @@
 
 #include "libcamera/internal/v4l2_subdevice.h"
 
+#include <algorithm>
 #include <fcntl.h>
 #include <iomanip>
 #include <regex>
@@ -1003,7 +1004,8 @@ std::ostream &operator<<(std::ostream &out, const V4L2Subdevice::Routing &routin
  * path
  */
 V4L2Subdevice::V4L2Subdevice(const MediaEntity *entity)
-	: V4L2Device(entity->deviceNode()), entity_(entity)
+	: V4L2Device(entity->deviceNode()), entity_(entity),
+	  stateCacheEnabled_(false)
 {
 }
 
@@ -1022,6 +1024,8 @@ int V4L2Subdevice::open()
 	if (ret)
 		return ret;
 
+	invalidateStateCache();
+
 	/*
 	 * Try to query the subdev capabilities. The VIDIOC_SUBDEV_QUERYCAP API
 	 * was introduced in kernel v5.8, ENOTTY errors must be ignored to
@@ -1073,6 +1077,17 @@ int V4L2Subdevice::open()
 int V4L2Subdevice::getSelection(const Stream &stream, unsigned int target,
 				Rectangle *rect)
 {
+	StateCache *cache = stateCache(ActiveFormat);
+	const auto key = std::make_tuple(stream.pad, stream.stream, target);
+
+	if (cache) {
+		auto it = cache->selections.find(key);
+		if (it != cache->selections.end()) {
+			*rect = it->second;
+			return 0;
+		}
+	}
+
 	struct v4l2_subdev_selection sel = {};
 
 	sel.which = V4L2_SUBDEV_FORMAT_ACTIVE;
@@ -1094,6 +1109,9 @@ int V4L2Subdevice::getSelection(const Stream &stream, unsigned int target,
 	rect->width = sel.r.width;
 	rect->height = sel.r.height;
 
+	if (cache)
+		cache->selections[key] = *rect;
+
 	return 0;
 }
 
@@ -1134,6 +1152,17 @@ int V4L2Subdevice::setSelection(const Stream &stream, unsigned int target,
 	sel.r.width = rect->width;
 	sel.r.height = rect->height;
 
+	/*
+	 * Selection rectangles affect the formats and the other rectangles of
+	 * the subdevice. Drop the cached state, even if the call fails, as
+	 * the driver may have applied part of the change.
+	 */
+	StateCache *cache = stateCache(ActiveFormat);
+	if (cache) {
+		cache->formats.clear();
+		cache->selections.clear();
+	}
+
 	int ret = ioctl(VIDIOC_SUBDEV_S_SELECTION, &sel);
 	if (ret < 0) {
 		LOG(V4L2, Error)
@@ -1147,6 +1176,9 @@ int V4L2Subdevice::setSelection(const Stream &stream, unsigned int target,
 	rect->width = sel.r.width;
 	rect->height = sel.r.height;
 
+	if (cache)
+		cache->selections[{ stream.pad, stream.stream, target }] = *rect;
+
 	return 0;
 }
 
@@ -1170,6 +1202,12 @@ int V4L2Subdevice::setSelection(const Stream &stream, unsigned int target,
  * Enumerate all media bus codes and frame sizes supported by the subdevice on
  * a \a stream.
  *
+ * The formats of subdevices that have no sink pad, such as camera sensors,
+ * don't depend on the subdevice configuration. They are enumerated once per
+ * stream and cached for the lifetime of the subdevice. The formats of other
+ * subdevices may depend on the format of their sink pads and on their routing,
+ * and are enumerated on every call.
+ *
  * \return A list of the supported device formats
  */
 V4L2Subdevice::Formats V4L2Subdevice::formats(const Stream &stream)
@@ -1181,6 +1219,19 @@ V4L2Subdevice::Formats V4L2Subdevice::formats(const Stream &stream)
 		return {};
 	}
 
+	const bool cacheable =
+		std::none_of(entity_->pads().begin(), entity_->pads().end(),
+			     [](const MediaPad *pad) {
+				     return pad->flags() & MEDIA_PAD_FL_SINK;
+			     });
+	const std::pair<unsigned int, unsigned int> key{ stream.pad, stream.stream };
+
+	if (cacheable) {
+		auto it = formatsCache_.find(key);
+		if (it != formatsCache_.end())
+			return it->second;
+	}
+
 	for (unsigned int code : enumPadCodes(stream)) {
 		std::vector<SizeRange> sizes = enumPadSizes(stream, code);
 		if (sizes.empty())
@@ -1195,6 +1246,9 @@ V4L2Subdevice::Formats V4L2Subdevice::formats(const Stream &stream)
 		}
 	}
 
+	if (cacheable && !formats.empty())
+		formatsCache_[key] = formats;
+
 	return formats;
 }
 
@@ -1250,6 +1304,17 @@ std::optional<ColorSpace> V4L2Subdevice::toColorSpace(const v4l2_mbus_framefmt &
 int V4L2Subdevice::getFormat(const Stream &stream, V4L2SubdeviceFormat *format,
 			     Whence whence)
 {
+	StateCache *cache = stateCache(whence);
+	const std::pair<unsigned int, unsigned int> key{ stream.pad, stream.stream };
+
+	if (cache) {
+		auto it = cache->formats.find(key);
+		if (it != cache->formats.end()) {
+			*format = it->second;
+			return 0;
+		}
+	}
+
 	struct v4l2_subdev_format subdevFmt = {};
 	subdevFmt.which = whence;
 	subdevFmt.pad = stream.pad;
@@ -1268,6 +1333,9 @@ int V4L2Subdevice::getFormat(const Stream &stream, V4L2SubdeviceFormat *format,
 	format->code = subdevFmt.format.code;
 	format->colorSpace = toColorSpace(subdevFmt.format);
 
+	if (cache)
+		cache->formats[key] = *format;
+
 	return 0;
 }
 
@@ -1313,6 +1381,17 @@ int V4L2Subdevice::setFormat(const Stream &stream, V4L2SubdeviceFormat *format,
 			subdevFmt.format.flags |= V4L2_MBUS_FRAMEFMT_SET_CSC;
 	}
 
+	/*
+	 * Drivers propagate formats from sink to source pads and may reset
+	 * the selection rectangles, drop the cached state for the same whence.
+	 */
+	StateCache *cache = stateCache(whence);
+	if (cache) {
+		cache->formats.clear();
+		if (whence == ActiveFormat)
+			cache->selections.clear();
+	}
+
 	int ret = ioctl(VIDIOC_SUBDEV_S_FMT, &subdevFmt);
 	if (ret) {
 		LOG(V4L2, Error)
@@ -1326,6 +1405,9 @@ int V4L2Subdevice::setFormat(const Stream &stream, V4L2SubdeviceFormat *format,
 	format->code = subdevFmt.format.code;
 	format->colorSpace = toColorSpace(subdevFmt.format);
 
+	if (cache)
+		cache->formats[{ stream.pad, stream.stream }] = *format;
+
 	return 0;
 }
 
@@ -1437,13 +1519,23 @@ int V4L2Subdevice::getRouting(Routing *routing, Whence whence)
 	if (!caps_.hasStreams())
 		return 0;
 
+	StateCache *cache = stateCache(whence);
+	if (cache && cache->routing) {
+		*routing = *cache->routing;
+		return 0;
+	}
+
 	struct v4l2_subdev_routing rt = {};
 
 	rt.which = whence;
 
 	int ret = ioctl(VIDIOC_SUBDEV_G_ROUTING, &rt);
-	if (ret == -ENOTTY)
-		return V4L2Subdevice::getRoutingLegacy(routing, whence);
+	if (ret == -ENOTTY) {
+		ret = V4L2Subdevice::getRoutingLegacy(routing, whence);
+		if (!ret && cache)
+			cache->routing = *routing;
+		return ret;
+	}
 
 	if (ret) {
 		LOG(V4L2, Error)
@@ -1452,8 +1544,11 @@ int V4L2Subdevice::getRouting(Routing *routing, Whence whence)
 		return ret;
 	}
 
-	if (!rt.num_routes)
+	if (!rt.num_routes) {
+		if (cache)
+			cache->routing = *routing;
 		return 0;
+	}
 
 	std::vector<struct v4l2_subdev_route> routes{ rt.num_routes };
 	rt.routes = reinterpret_cast<uintptr_t>(routes.data());
@@ -1478,6 +1573,9 @@ int V4L2Subdevice::getRouting(Routing *routing, Whence whence)
 	for (const auto &[i, route] : utils::enumerate(routes))
 		routeFromKernel((*routing)[i], route);
 
+	if (cache)
+		cache->routing = *routing;
+
 	return 0;
 }
 
@@ -1538,9 +1636,18 @@ int V4L2Subdevice::setRouting(Routing *routing, Whence whence)
 	rt.num_routes = routes.size();
 	rt.routes = reinterpret_cast<uintptr_t>(routes.data());
 
+	/* Routing changes reset the formats and selections of all streams. */
+	StateCache *cache = stateCache(whence);
+	if (cache)
+		*cache = {};
+
 	int ret = ioctl(VIDIOC_SUBDEV_S_ROUTING, &rt);
-	if (ret == -ENOTTY)
-		return setRoutingLegacy(routing, whence);
+	if (ret == -ENOTTY) {
+		ret = setRoutingLegacy(routing, whence);
+		if (!ret && cache)
+			cache->routing = *routing;
+		return ret;
+	}
 
 	if (ret) {
 		LOG(V4L2, Error) << "Failed to set routes: " << strerror(-ret);
@@ -1576,9 +1683,60 @@ int V4L2Subdevice::setRouting(Routing *routing, Whence whence)
 	for (const auto &[i, route] : utils::enumerate(routes))
 		routeFromKernel((*routing)[i], route);
 
+	if (cache)
+		cache->routing = *routing;
+
 	return 0;
 }
 
+/**
+ * \brief Enable or disable the subdevice state cache
+ * \param[in] enable True to enable the cache, false to disable it
+ *
+ * Pipeline handlers commonly retrieve the formats, selection rectangles and
+ * routing table of subdevices repeatedly when validating and configuring a
+ * camera, which results in many ioctl calls on deep media graphs. When the
+ * state cache is enabled, the V4L2Subdevice records the state it retrieves
+ * with getFormat(), getSelection() and getRouting() and the state applied
+ * with the corresponding set functions, and serves subsequent get calls from
+ * the cache without calling the kernel.
+ *
+ * The set functions invalidate the cached state they may affect through the
+ * driver's state propagation. The cache can however not track changes made
+ * through other means, such as controls that modify the format (for instance
+ * flips that change the Bayer pattern of a sensor), other V4L2Subdevice
+ * instances or other processes. Callers that enable the cache are responsible
+ * for calling invalidateStateCache() when such changes may have occurred, and
+ * when starting or stopping streaming.
+ *
+ * Disabling the cache drops all the cached state. The cache is disabled by
+ * default.
+ */
+void V4L2Subdevice::enableStateCache(bool enable)
+{
+	stateCacheEnabled_ = enable;
+	invalidateStateCache();
+}
+
+/**
+ * \brief Drop all the state recorded in the subdevice state cache
+ *
+ * \sa enableStateCache()
+ */
+void V4L2Subdevice::invalidateStateCache()
+{
+	for (StateCache &cache : stateCache_)
+		cache = {};
+}
+
+V4L2Subdevice::StateCache *V4L2Subdevice::stateCache(Whence whence)
+{
+	if (!stateCacheEnabled_)
+		return nullptr;
+
+	return &stateCache_[whence == ActiveFormat ? 1 : 0];
+}
+
 /**
  * \brief Retrieve the model name of the device
  *
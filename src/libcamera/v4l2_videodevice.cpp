@@ -31,6 +31,7 @@
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/media_object.h"
+#include "libcamera/internal/tracepoints.h"
 
 /**
  * \file v4l2_videodevice.h
@@ -162,20 +163,36 @@ LOG_DECLARE_CATEGORY(V4L2)
  * index associations to help selecting V4L2 buffers. It tracks, for every
  * entry, if the V4L2 buffer is in use, and offers lookup of the best free V4L2
  * buffer for a set of dmabufs.
+ *
+ * Entries are indexed by a hash of their dmabufs, and the free entries are
+ * kept sorted by last use, to avoid scanning the whole cache every time a
+ * buffer is queued.
  */
 
 /**
- * \brief Create an empty cache with \a numEntries entries
+ * \brief Create a cache with \a numEntries entries
  * \param[in] numEntries Number of entries to reserve in the cache
+ * \param[in] buffers Buffers to pre-populate the cache with
  *
- * Create a cache with \a numEntries entries all marked as unused. The entries
- * will be populated as the cache is used. This is typically used to implement
- * buffer import, with buffers added to the cache as they are queued.
+ * Create a cache with \a numEntries entries all marked as unused. The first
+ * entries are populated with the \a buffers, and the other entries will be
+ * populated as the cache is used. This is typically used to implement buffer
+ * import, with buffers added to the cache as they are queued. The number of
+ * \a buffers shall not exceed \a numEntries.
  */
-V4L2BufferCache::V4L2BufferCache(unsigned int numEntries)
+V4L2BufferCache::V4L2BufferCache(unsigned int numEntries,
+				 Span<const FrameBuffer *const> buffers)
 	: lastUsedCounter_(1), missCounter_(0)
 {
-	cache_.resize(numEntries);
+	ASSERT(buffers.size() <= numEntries);
+
+	for (const FrameBuffer *buffer : buffers)
+		addEntry(*buffer);
+
+	for (unsigned int index = cache_.size(); index < numEntries; index++) {
+		cache_.emplace_back();
+		addFree(index);
+	}
 }
 
 /**
@@ -190,9 +207,7 @@ V4L2BufferCache::V4L2BufferCache(const std::vector<std::unique_ptr<FrameBuffer>>
 	: lastUsedCounter_(1), missCounter_(0)
 {
 	for (const std::unique_ptr<FrameBuffer> &buffer : buffers)
-		cache_.emplace_back(true,
-				    lastUsedCounter_.fetch_add(1, std::memory_order_acq_rel),
-				    *buffer.get());
+		addEntry(*buffer);
 }
 
 V4L2BufferCache::~V4L2BufferCache()
@@ -206,12 +221,7 @@ V4L2BufferCache::~V4L2BufferCache()
  */
 bool V4L2BufferCache::isEmpty() const
 {
-	for (auto const &entry : cache_) {
-		if (!entry.free_)
-			return false;
-	}
-
-	return true;
+	return freeEntries_.size() == cache_.size();
 }
 
 /**
@@ -221,46 +231,67 @@ bool V4L2BufferCache::isEmpty() const
  * Find the best V4L2 buffer index to be used for the FrameBuffer \a buffer
  * based on previous mappings of frame buffers to V4L2 buffers. If a free V4L2
  * buffer previously used with the same dmabufs as \a buffer is found in the
- * cache, return its index. Otherwise return the index of the first free V4L2
- * buffer and record its association with the dmabufs of \a buffer.
+ * cache, return its index. Otherwise return the index of the least recently
+ * used free V4L2 buffer and record its association with the dmabufs of \a
+ * buffer.
  *
  * \return The index of the best V4L2 buffer, or -ENOENT if no free V4L2 buffer
  * is available
  */
 int V4L2BufferCache::get(const FrameBuffer &buffer)
 {
-	bool hit = false;
+	const size_t hash = Entry::hash(buffer);
 	int use = -1;
-	uint64_t oldest = UINT64_MAX;
 
-	for (unsigned int index = 0; index < cache_.size(); index++) {
+	/*
+	 * Try to find a cache hit by comparing the planes of the entries with
+	 * the same hash. Pick the lowest index if the same dmabufs have been
+	 * used with multiple V4L2 buffers.
+	 */
+	auto range = index_.equal_range(hash);
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		const unsigned int index = iter->second;
 		const Entry &entry = cache_[index];
 
-		if (!entry.free_)
+		if (!entry.free_ || !(entry == buffer))
 			continue;
 
-		/* Try to find a cache hit by comparing the planes. */
-		if (entry == buffer) {
-			hit = true;
+		if (use < 0 || index < static_cast<unsigned int>(use))
 			use = index;
-			break;
-		}
-
-		if (entry.lastUsed_ < oldest) {
-			use = index;
-			oldest = entry.lastUsed_;
-		}
 	}
 
-	if (!hit)
+	const bool hit = use >= 0;
+	if (!hit) {
 		missCounter_++;
 
-	if (use < 0)
-		return -ENOENT;
+		if (freeEntries_.empty())
+			return -ENOENT;
 
-	cache_[use] = Entry(false,
-			    lastUsedCounter_.fetch_add(1, std::memory_order_acq_rel),
-			    buffer);
+		use = freeEntries_.begin()->second;
+	}
+
+	Entry &entry = cache_[use];
+	freeEntries_.erase({ entry.lastUsed_, use });
+
+	const uint64_t lastUsed = lastUsedCounter_.fetch_add(1, std::memory_order_acq_rel);
+
+	if (hit) {
+		entry.free_ = false;
+		entry.lastUsed_ = lastUsed;
+		return use;
+	}
+
+	/* Replace the entry and update the index. */
+	range = index_.equal_range(entry.hash_);
+	for (auto iter = range.first; iter != range.second; ++iter) {
+		if (iter->second == static_cast<unsigned int>(use)) {
+			index_.erase(iter);
+			break;
+		}
+	}
+
+	entry = Entry(false, lastUsed, buffer);
+	index_.emplace(entry.hash_, use);
 
 	return use;
 }
@@ -272,16 +303,39 @@ int V4L2BufferCache::get(const FrameBuffer &buffer)
 void V4L2BufferCache::put(unsigned int index)
 {
 	ASSERT(index < cache_.size());
-	cache_[index].free_ = true;
+
+	if (cache_[index].free_)
+		return;
+
+	addFree(index);
+}
+
+void V4L2BufferCache::addEntry(const FrameBuffer &buffer)
+{
+	unsigned int index = cache_.size();
+
+	cache_.emplace_back(true,
+			    lastUsedCounter_.fetch_add(1, std::memory_order_acq_rel),
+			    buffer);
+	index_.emplace(cache_.back().hash_, index);
+	addFree(index);
+}
+
+void V4L2BufferCache::addFree(unsigned int index)
+{
+	Entry &entry = cache_[index];
+
+	entry.free_ = true;
+	freeEntries_.emplace(entry.lastUsed_, index);
 }
 
 V4L2BufferCache::Entry::Entry()
-	: free_(true), lastUsed_(0)
+	: free_(true), lastUsed_(0), hash_(0)
 {
 }
 
 V4L2BufferCache::Entry::Entry(bool free, uint64_t lastUsed, const FrameBuffer &buffer)
-	: free_(free), lastUsed_(lastUsed)
+	: free_(free), lastUsed_(lastUsed), hash_(hash(buffer))
 {
 	for (const FrameBuffer::Plane &plane : buffer.planes())
 		planes_.emplace_back(plane);
@@ -301,6 +355,19 @@ bool V4L2BufferCache::Entry::operator==(const FrameBuffer &buffer) const
 	return true;
 }
 
+size_t V4L2BufferCache::Entry::hash(const FrameBuffer &buffer)
+{
+	size_t hash = 0;
+
+	for (const FrameBuffer::Plane &plane : buffer.planes()) {
+		const uint64_t key = (static_cast<uint64_t>(plane.fd.get()) << 32) |
+				     plane.length;
+		hash ^= std::hash<uint64_t>{}(key) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	return hash;
+}
+
 /**
  * \class V4L2DeviceFormat
  * \brief The V4L2 video device image format and sizes
@@ -515,7 +582,8 @@ std::ostream &operator<<(std::ostream &out, const V4L2DeviceFormat &f)
  *
  * The V4L2VideoDevice class tracks queued buffers and handles buffer events. It
  * automatically dequeues completed buffers and emits the \ref bufferReady
- * signal.
+ * signal. Buffers can optionally be dequeued from a dedicated thread with
+ * setDequeuePoller().
  *
  * Upon destruction any device left open will be closed, and any resources
  * released.
@@ -534,7 +602,8 @@ std::ostream &operator<<(std::ostream &out, const V4L2DeviceFormat &f)
  */
 V4L2VideoDevice::V4L2VideoDevice(const std::string &deviceNode)
 	: V4L2Device(deviceNode), formatInfo_(nullptr), cache_(nullptr),
-	  fdBufferNotifier_(nullptr), state_(State::Stopped),
+	  fdBufferNotifier_(nullptr), dequeuePoller_(nullptr),
+	  state_(State::Stopped),
 	  watchdogDuration_(0.0)
 {
 	/*
@@ -759,9 +828,11 @@ void V4L2VideoDevice::close()
 		return;
 
 	releaseBuffers();
+	dequeueChannel_.reset();
 	delete fdBufferNotifier_;
 
 	formatInfo_ = nullptr;
+	formatsCache_.clear();
 
 	V4L2Device::close();
 }
@@ -1073,10 +1144,25 @@ int V4L2VideoDevice::trySetFormatSingleplane(V4L2DeviceFormat *format, bool set)
  * If the \a code argument is not zero, only formats compatible with that media
  * bus code will be enumerated.
  *
+ * The formats supported by a capture or output video device don't depend on
+ * the device configuration. They are enumerated once per media bus code and
+ * cached until the device is closed, avoiding the many ioctls required by the
+ * enumeration when generating and validating camera configurations. The
+ * formats of memory-to-memory devices may depend on the format of the other
+ * queue and are thus never cached.
+ *
  * \return A list of the supported video device formats
  */
 V4L2VideoDevice::Formats V4L2VideoDevice::formats(uint32_t code)
 {
+	const bool cacheable = !caps_.isM2M();
+
+	if (cacheable) {
+		auto it = formatsCache_.find(code);
+		if (it != formatsCache_.end())
+			return it->second;
+	}
+
 	Formats formats;
 
 	for (V4L2PixelFormat pixelFormat : enumPixelformats(code)) {
@@ -1094,6 +1180,9 @@ V4L2VideoDevice::Formats V4L2VideoDevice::formats(uint32_t code)
 		formats.emplace(pixelFormat, sizes);
 	}
 
+	if (cacheable && !formats.empty())
+		formatsCache_[code] = formats;
+
 	return formats;
 }
 
@@ -1486,6 +1575,7 @@ UniqueFD V4L2VideoDevice::exportDmabufFd(unsigned int index,
 /**
  * \brief Prepare the device to import \a count buffers
  * \param[in] count Number of buffers to prepare to import
+ * \param[in] buffers Buffers known in advance to be imported (optional)
  *
  * This function initializes the driver's buffer management to import buffers
  * in DMABUF mode. It requests buffers from the driver, but doesn't allocate
@@ -1495,6 +1585,11 @@ UniqueFD V4L2VideoDevice::exportDmabufFd(unsigned int index,
  * calls. The buffers to be imported are provided to queueBuffer(), and may be
  * supplied externally, or come from a previous exportBuffers() call.
  *
+ * If the set of buffers that will be queued is known in advance, it can be
+ * passed in \a buffers. Each of the \a buffers is then associated with its own
+ * V4L2 buffer, which guarantees that queuing them will never result in a cache
+ * miss. The number of \a buffers shall not exceed \a count.
+ *
  * Device initialization performed by this function shall later be cleaned up
  * with releaseBuffers(). If buffers have already been allocated with
  * allocateBuffers() or imported with importBuffers(), this function returns
@@ -1503,20 +1598,26 @@ UniqueFD V4L2VideoDevice::exportDmabufFd(unsigned int index,
  * \return 0 on success or a negative error code otherwise
  * \retval -EBUSY buffers have already been allocated or imported
  */
-int V4L2VideoDevice::importBuffers(unsigned int count)
+int V4L2VideoDevice::importBuffers(unsigned int count,
+				   Span<const FrameBuffer *const> buffers)
 {
 	if (cache_) {
 		LOG(V4L2, Error) << "Buffers already allocated";
 		return -EINVAL;
 	}
 
+	if (buffers.size() > count) {
+		LOG(V4L2, Error) << "Too many buffers to import";
+		return -EINVAL;
+	}
+
 	memoryType_ = V4L2_MEMORY_DMABUF;
 
 	int ret = requestBuffers(count, V4L2_MEMORY_DMABUF);
 	if (ret)
 		return ret;
 
-	cache_ = new V4L2BufferCache(count);
+	cache_ = new V4L2BufferCache(count, buffers);
 
 	LOG(V4L2, Debug) << "Prepared to import " << count << " buffers";
 
@@ -1547,6 +1648,7 @@ int V4L2VideoDevice::releaseBuffers()
 /**
  * \brief Queue a buffer to the video device
  * \param[in] buffer The buffer to be queued
+ * \param[in] request An optional media request to bind the buffer to
  *
  * For capture video devices the \a buffer will be filled with data by the
  * device. For output video devices the \a buffer shall contain valid data and
@@ -1556,12 +1658,15 @@ int V4L2VideoDevice::releaseBuffers()
  * The best available V4L2 buffer is picked for \a buffer using the V4L2 buffer
  * cache.
  *
+ * If a \a request is given, the buffer is bound to the request and is only
+ * handed to the driver when the request gets queued with MediaRequest::queue().
+ *
  * Note that queueBuffer() will fail if the device is in the process of being
  * stopped from a streaming state through streamOff().
  *
  * \return 0 on success or a negative error code otherwise
  */
-int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
+int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer, const MediaRequest *request)
 {
 	struct v4l2_plane v4l2Planes[VIDEO_MAX_PLANES] = {};
 	struct v4l2_buffer buf = {};
@@ -1690,6 +1795,11 @@ int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
 		buf.timestamp.tv_usec = (metadata.timestamp / 1000) % 1000000;
 	}
 
+	if (request) {
+		buf.flags |= V4L2_BUF_FLAG_REQUEST_FD;
+		buf.request_fd = request->fd().get();
+	}
+
 	LOG(V4L2, Debug) << "Queueing buffer " << buf.index;
 
 	ret = ioctl(VIDIOC_QBUF, &buf);
@@ -1700,34 +1810,69 @@ int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
 		return ret;
 	}
 
+	LIBCAMERA_TRACEPOINT(v4l2_qbuf, deviceNode().c_str(), buffer, buf.index);
+
 	if (queuedBuffers_.empty()) {
-		fdBufferNotifier_->setEnabled(true);
+		if (!dequeueChannel_)
+			fdBufferNotifier_->setEnabled(true);
 		if (watchdogDuration_)
 			watchdog_.start(std::chrono::duration_cast<std::chrono::milliseconds>(watchdogDuration_));
 	}
 
 	queuedBuffers_[buf.index] = buffer;
 
+	if (dequeueChannel_)
+		dequeueChannel_->queued();
+
+	return 0;
+}
+
+/**
+ * \brief Queue multiple buffers to the video device
+ * \param[in] buffers The buffers to be queued
+ *
+ * Queue all the \a buffers in order, as if queueBuffer() was called for each
+ * of them. Queuing stops at the first buffer that fails to be queued, the
+ * buffers that precede it in \a buffers stay queued to the device.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int V4L2VideoDevice::queueBuffers(Span<FrameBuffer *const> buffers)
+{
+	for (FrameBuffer *buffer : buffers) {
+		int ret = queueBuffer(buffer);
+		if (ret < 0)
+			return ret;
+	}
+
 	return 0;
 }
 
 /**
  * \brief Slot to handle completed buffer events from the V4L2 video device
  *
- * When this slot is called, a Buffer has become available from the device, and
- * will be emitted through the bufferReady Signal.
+ * When this slot is called, one or more buffers have become available from the
+ * device, and will be emitted through the bufferReady Signal.
  *
  * For Capture video devices the FrameBuffer will contain valid data.
  * For Output video devices the FrameBuffer can be considered empty.
  */
 void V4L2VideoDevice::bufferAvailable()
 {
-	FrameBuffer *buffer = dequeueBuffer();
-	if (!buffer)
-		return;
+	/*
+	 * Drain all the completed buffers, as multiple buffers may complete
+	 * between two notifications when the event loop is busy. The loop
+	 * stops when DQBUF returns -EAGAIN, or when all buffers have been
+	 * dequeued or cancelled by a slot connected to bufferReady.
+	 */
+	while (!queuedBuffers_.empty()) {
+		FrameBuffer *buffer = dequeueBuffer();
+		if (!buffer)
+			return;
 
-	/* Notify anyone listening to the device. */
-	bufferReady.emit(buffer);
+		/* Notify anyone listening to the device. */
+		bufferReady.emit(buffer);
+	}
 }
 
 /**
@@ -1736,29 +1881,40 @@ void V4L2VideoDevice::bufferAvailable()
  * This function dequeues the next available buffer from the device. If no
  * buffer is available to be dequeued it will return nullptr immediately.
  *
+ * When a dequeue poller is in use, the buffer has already been dequeued from
+ * the device by the poller thread, and is retrieved from the poller channel.
+ *
  * \return A pointer to the dequeued buffer on success, or nullptr otherwise
  */
 FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 {
-	struct v4l2_buffer buf = {};
-	struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
-	int ret;
+	V4L2DequeuePoller::Completion completion;
+	struct v4l2_buffer &buf = completion.buffer;
+	struct v4l2_plane *planes = completion.planes;
 
-	buf.type = bufferType_;
-	buf.memory = memoryType_;
+	bool multiPlanar = V4L2_TYPE_IS_MULTIPLANAR(bufferType_);
 
-	bool multiPlanar = V4L2_TYPE_IS_MULTIPLANAR(buf.type);
+	if (dequeueChannel_) {
+		if (!dequeueChannel_->pop(&completion))
+			return nullptr;
+	} else {
+		buf = {};
+		buf.type = bufferType_;
+		buf.memory = memoryType_;
 
-	if (multiPlanar) {
-		buf.length = VIDEO_MAX_PLANES;
-		buf.m.planes = planes;
-	}
+		if (multiPlanar) {
+			buf.length = VIDEO_MAX_PLANES;
+			buf.m.planes = planes;
+		}
 
-	ret = ioctl(VIDIOC_DQBUF, &buf);
-	if (ret < 0) {
-		LOG(V4L2, Error)
-			<< "Failed to dequeue buffer: " << strerror(-ret);
-		return nullptr;
+		int ret = ioctl(VIDIOC_DQBUF, &buf);
+		if (ret == -EAGAIN)
+			return nullptr;
+		if (ret < 0) {
+			LOG(V4L2, Error)
+				<< "Failed to dequeue buffer: " << strerror(-ret);
+			return nullptr;
+		}
 	}
 
 	LOG(V4L2, Debug) << "Dequeuing buffer " << buf.index;
@@ -1808,8 +1964,10 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 	metadata.timestamp = buf.timestamp.tv_sec * 1000000000ULL
 			   + buf.timestamp.tv_usec * 1000ULL;
 
-	if (V4L2_TYPE_IS_OUTPUT(buf.type))
+	if (V4L2_TYPE_IS_OUTPUT(buf.type)) {
+		LIBCAMERA_TRACEPOINT(v4l2_dqbuf, deviceNode().c_str(), buffer);
 		return buffer;
+	}
 
 	/*
 	 * Detect kernel drivers which do not reset the sequence number to zero
@@ -1824,6 +1982,8 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 	}
 	metadata.sequence -= firstFrame_.value();
 
+	LIBCAMERA_TRACEPOINT(v4l2_dqbuf, deviceNode().c_str(), buffer);
+
 	unsigned int numV4l2Planes = multiPlanar ? buf.length : 1;
 
 	if (numV4l2Planes != buffer->planes().size()) {
@@ -1912,6 +2072,18 @@ int V4L2VideoDevice::streamOn()
 	if (watchdogDuration_ && !queuedBuffers_.empty())
 		watchdog_.start(std::chrono::duration_cast<std::chrono::milliseconds>(watchdogDuration_));
 
+	if (dequeuePoller_) {
+		dequeueChannel_ = dequeuePoller_->attach(fd(), bufferType_, memoryType_,
+							 queuedBuffers_.size());
+		if (dequeueChannel_) {
+			fdBufferNotifier_->setEnabled(false);
+			dequeueChannel_->ready.connect(this, &V4L2VideoDevice::bufferAvailable);
+		} else {
+			LOG(V4L2, Warning)
+				<< "Failed to attach to the dequeue poller, dequeuing in the device thread";
+		}
+	}
+
 	return 0;
 }
 
@@ -1938,10 +2110,22 @@ int V4L2VideoDevice::streamOff()
 	if (watchdogDuration_.count())
 		watchdog_.stop();
 
+	/*
+	 * Stop the dequeue poller first, and complete the buffers it has
+	 * already dequeued before cancelling the ones still queued.
+	 */
+	if (dequeueChannel_) {
+		dequeueChannel_->stop();
+		bufferAvailable();
+		dequeueChannel_.reset();
+	}
+
 	ret = ioctl(VIDIOC_STREAMOFF, &bufferType_);
 	if (ret < 0) {
 		LOG(V4L2, Error)
 			<< "Failed to stop streaming: " << strerror(-ret);
+		if (!queuedBuffers_.empty())
+			fdBufferNotifier_->setEnabled(true);
 		return ret;
 	}
 
@@ -1991,6 +2175,25 @@ void V4L2VideoDevice::setDequeueTimeout(utils::Duration timeout)
 		watchdog_.start(std::chrono::duration_cast<std::chrono::milliseconds>(timeout));
 }
 
+/**
+ * \brief Dequeue buffers in the thread of a dequeue poller
+ * \param[in] poller The dequeue poller, or nullptr to dequeue in the device
+ * thread
+ *
+ * By default buffers are dequeued from the thread the video device is bound
+ * to, when its event loop runs. Setting a \a poller moves the VIDIOC_DQBUF
+ * calls to the poller thread while the device is streaming, which reduces the
+ * dequeue latency when the device thread is busy. The bufferReady signal is
+ * still emitted in the thread the video device is bound to.
+ *
+ * The poller takes effect at the next streamOn(). It shall outlive the video
+ * device, or be reset before being destroyed.
+ */
+void V4L2VideoDevice::setDequeuePoller(V4L2DequeuePoller *poller)
+{
+	dequeuePoller_ = poller;
+}
+
 /**
  * \var V4L2VideoDevice::dequeueTimeout
  * \brief A Signal emitted when the dequeue watchdog timer expires
@@ -2052,7 +2255,7 @@ V4L2VideoDevice::fromEntityName(const MediaDevice *media,
  */
 V4L2PixelFormat V4L2VideoDevice::toV4L2PixelFormat(const PixelFormat &pixelFormat) const
 {
-	const std::vector<V4L2PixelFormat> &v4l2PixelFormats =
+	Span<const V4L2PixelFormat> v4l2PixelFormats =
 		V4L2PixelFormat::fromPixelFormat(pixelFormat);
 
 	for (const V4L2PixelFormat &v4l2Format : v4l2PixelFormats) {
@@ -7,13 +7,16 @@
 
 #include "libcamera/internal/yaml_parser.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <errno.h>
 #include <functional>
 #include <limits>
+#include <sys/stat.h>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
 
 #include <yaml.h>
 
@@ -31,6 +34,78 @@ namespace {
 /* Empty static YamlObject as a safe result for invalid operations */
 static const YamlObject empty;
 
+/* Maximum number of parsed files kept by YamlParser::parseShared() */
+constexpr unsigned int kMaxSharedFiles = 8;
+
+struct SharedFile {
+	int64_t mtime;
+	int64_t size;
+	uint64_t lastUse;
+	std::shared_ptr<const YamlObject> root;
+};
+
+Mutex sharedFilesMutex;
+std::map<std::string, SharedFile> sharedFiles LIBCAMERA_TSA_GUARDED_BY(sharedFilesMutex);
+uint64_t sharedFilesUse LIBCAMERA_TSA_GUARDED_BY(sharedFilesMutex) = 0;
+
+std::optional<long> parseSignedInteger(const std::string &str)
+{
+	if (str == "")
+		return std::nullopt;
+
+	char *end;
+
+	errno = 0;
+	long value = std::strtol(str.c_str(), &end, 10);
+
+	if ('\0' != *end || errno == ERANGE)
+		return std::nullopt;
+
+	return value;
+}
+
+std::optional<unsigned long> parseUnsignedInteger(const std::string &str)
+{
+	if (str == "")
+		return std::nullopt;
+
+	/*
+	 * strtoul() accepts strings representing a negative number, in which
+	 * case it negates the converted value. We don't want to silently accept
+	 * negative values and return a large positive number, so check for a
+	 * minus sign (after optional whitespace) and return an error.
+	 */
+	std::size_t found = str.find_first_not_of(" \t");
+	if (found != std::string::npos && str[found] == '-')
+		return std::nullopt;
+
+	char *end;
+
+	errno = 0;
+	unsigned long value = std::strtoul(str.c_str(), &end, 10);
+
+	if ('\0' != *end || errno == ERANGE)
+		return std::nullopt;
+
+	return value;
+}
+
+std::optional<double> parseDouble(const std::string &str)
+{
+	if (str == "")
+		return std::nullopt;
+
+	char *end;
+
+	errno = 0;
+	double value = utils::strtod(str.c_str(), &end);
+
+	if ('\0' != *end || errno == ERANGE)
+		return std::nullopt;
+
+	return value;
+}
+
 } /* namespace */
 
 /**
@@ -131,164 +206,67 @@ std::optional<bool> YamlObject::get() const
 	return std::nullopt;
 }
 
-namespace {
-
-bool parseSignedInteger(const std::string &str, long min, long max,
-			long *result)
-{
-	if (str == "")
-		return false;
-
-	char *end;
-
-	errno = 0;
-	long value = std::strtol(str.c_str(), &end, 10);
-
-	if ('\0' != *end || errno == ERANGE || value < min || value > max)
-		return false;
-
-	*result = value;
-	return true;
-}
-
-bool parseUnsignedInteger(const std::string &str, unsigned long max,
-			  unsigned long *result)
-{
-	if (str == "")
-		return false;
-
-	/*
-	 * strtoul() accepts strings representing a negative number, in which
-	 * case it negates the converted value. We don't want to silently accept
-	 * negative values and return a large positive number, so check for a
-	 * minus sign (after optional whitespace) and return an error.
-	 */
-	std::size_t found = str.find_first_not_of(" \t");
-	if (found != std::string::npos && str[found] == '-')
-		return false;
-
-	char *end;
-
-	errno = 0;
-	unsigned long value = std::strtoul(str.c_str(), &end, 10);
-
-	if ('\0' != *end || errno == ERANGE || value > max)
-		return false;
-
-	*result = value;
-	return true;
-}
-
-} /* namespace */
-
 template<>
 std::optional<int8_t> YamlObject::get() const
 {
-	if (type_ != Type::Value)
-		return std::nullopt;
-
-	long value;
-
-	if (!parseSignedInteger(value_, std::numeric_limits<int8_t>::min(),
-				std::numeric_limits<int8_t>::max(), &value))
+	if (!signed_ || *signed_ < std::numeric_limits<int8_t>::min() ||
+	    *signed_ > std::numeric_limits<int8_t>::max())
 		return std::nullopt;
 
-	return value;
+	return *signed_;
 }
 
 template<>
 std::optional<uint8_t> YamlObject::get() const
 {
-	if (type_ != Type::Value)
-		return std::nullopt;
-
-	unsigned long value;
-
-	if (!parseUnsignedInteger(value_, std::numeric_limits<uint8_t>::max(),
-				  &value))
+	if (!unsigned_ || *unsigned_ > std::numeric_limits<uint8_t>::max())
 		return std::nullopt;
 
-	return value;
+	return *unsigned_;
 }
 
 template<>
 std::optional<int16_t> YamlObject::get() const
 {
-	if (type_ != Type::Value)
-		return std::nullopt;
-
-	long value;
-
-	if (!parseSignedInteger(value_, std::numeric_limits<int16_t>::min(),
-				std::numeric_limits<int16_t>::max(), &value))
+	if (!signed_ || *signed_ < std::numeric_limits<int16_t>::min() ||
+	    *signed_ > std::numeric_limits<int16_t>::max())
 		return std::nullopt;
 
-	return value;
+	return *signed_;
 }
 
 template<>
 std::optional<uint16_t> YamlObject::get() const
 {
-	if (type_ != Type::Value)
+	if (!unsigned_ || *unsigned_ > std::numeric_limits<uint16_t>::max())
 		return std::nullopt;
 
-	unsigned long value;
-
-	if (!parseUnsignedInteger(value_, std::numeric_limits<uint16_t>::max(),
-				  &value))
-		return std::nullopt;
-
-	return value;
+	return *unsigned_;
 }
 
 template<>
 std::optional<int32_t> YamlObject::get() const
 {
-	if (type_ != Type::Value)
-		return std::nullopt;
-
-	long value;
-
-	if (!parseSignedInteger(value_, std::numeric_limits<int32_t>::min(),
-				std::numeric_limits<int32_t>::max(), &value))
+	if (!signed_ || *signed_ < std::numeric_limits<int32_t>::min() ||
+	    *signed_ > std::numeric_limits<int32_t>::max())
 		return std::nullopt;
 
-	return value;
+	return *signed_;
 }
 
 template<>
 std::optional<uint32_t> YamlObject::get() const
 {
-	if (type_ != Type::Value)
+	if (!unsigned_ || *unsigned_ > std::numeric_limits<uint32_t>::max())
 		return std::nullopt;
 
-	unsigned long value;
-
-	if (!parseUnsignedInteger(value_, std::numeric_limits<uint32_t>::max(),
-				  &value))
-		return std::nullopt;
-
-	return value;
+	return *unsigned_;
 }
 
 template<>
 std::optional<double> YamlObject::get() const
 {
-	if (type_ != Type::Value)
-		return std::nullopt;
-
-	if (value_ == "")
-		return std::nullopt;
-
-	char *end;
-
-	errno = 0;
-	double value = utils::strtod(value_.c_str(), &end);
-
-	if ('\0' != *end || errno == ERANGE)
-		return std::nullopt;
-
-	return value;
+	return double_;
 }
 
 template<>
@@ -353,6 +331,13 @@ std::optional<std::vector<T>> YamlObject::getList() const
 	if (type_ != Type::List)
 		return std::nullopt;
 
+	if constexpr (std::is_same_v<double, T>) {
+		if (!doubles_)
+			return std::nullopt;
+
+		return *doubles_;
+	}
+
 	std::vector<T> values;
 	values.reserve(list_.size());
 
@@ -379,6 +364,61 @@ template std::optional<std::vector<Size>> YamlObject::getList<Size>() const;
 
 #endif /* __DOXYGEN__ */
 
+/**
+ * \brief Retrieve the YamlObject as a list of double values
+ *
+ * This function returns the values of all elements of a list YamlObject as a
+ * contiguous array of double values. The values are converted once when the
+ * YAML content is parsed, making this function suitable for large tables such
+ * as lens shading or tone mapping curves, without any per-element parsing or
+ * memory allocation.
+ *
+ * \return The list values, or std::nullopt if the YamlObject is not a list or
+ * if any of its elements can't be parsed as a double
+ */
+std::optional<Span<const double>> YamlObject::getDoubleList() const
+{
+	if (!doubles_)
+		return std::nullopt;
+
+	return Span<const double>{ *doubles_ };
+}
+
+/**
+ * \brief Convert the value of a scalar YamlObject to numbers
+ *
+ * The value is parsed as a signed integer, an unsigned integer and a double
+ * once when the YAML content is parsed, to avoid string conversions every time
+ * the value is retrieved with get().
+ */
+void YamlObject::parseNumbers()
+{
+	signed_ = parseSignedInteger(value_);
+	unsigned_ = parseUnsignedInteger(value_);
+	double_ = parseDouble(value_);
+}
+
+/**
+ * \brief Gather the double values of all elements of a list YamlObject
+ *
+ * The values are stored contiguously for getDoubleList() when all elements of
+ * the list are scalars that can be parsed as a double.
+ */
+void YamlObject::collectNumbers()
+{
+	std::vector<double> values;
+	values.reserve(list_.size());
+
+	for (const Value &entry : list_) {
+		if (!entry.value->double_)
+			return;
+
+		values.push_back(*entry.value->double_);
+	}
+
+	doubles_ = std::move(values);
+}
+
 /**
  * \fn YamlObject::asDict() const
  * \brief Wrap a dictionary YamlObject in an adapter that exposes iterators
@@ -487,7 +527,8 @@ public:
 	~YamlParserContext();
 
 	int init(File &file);
-	int parseContent(YamlObject &yamlObject);
+	int parseContent(YamlObject &yamlObject,
+			 std::optional<Span<const std::string>> keys = std::nullopt);
 
 private:
 	struct EventDeleter {
@@ -507,7 +548,9 @@ private:
 	void readValue(std::string &value, EventPtr event);
 	int parseDictionaryOrList(YamlObject::Type type,
 				  const std::function<int(EventPtr event)> &parseItem);
-	int parseNextYamlObject(YamlObject &yamlObject, EventPtr event);
+	int parseNextYamlObject(YamlObject &yamlObject, EventPtr event,
+				std::optional<Span<const std::string>> keys = std::nullopt);
+	int skipNextYamlObject(EventPtr event);
 
 	bool parserValid_;
 	yaml_parser_t parser_;
@@ -600,14 +643,17 @@ YamlParserContext::EventPtr YamlParserContext::nextEvent()
  * \fn YamlParserContext::parseContent()
  * \brief Parse the content of a YAML document
  * \param[in] yamlObject The result of YamlObject
+ * \param[in] keys The keys of the root dictionary to parse
  *
  * Check YAML start and end events of a YAML document, and parse the root object
- * of the YAML document into a YamlObject.
+ * of the YAML document into a YamlObject. When \a keys is set, only the root
+ * dictionary entries listed in \a keys are parsed, see parseNextYamlObject().
  *
  * \return 0 on success or a negative error code otherwise
  * \retval -EINVAL The parser has failed to validate end of a YAML file
  */
-int YamlParserContext::parseContent(YamlObject &yamlObject)
+int YamlParserContext::parseContent(YamlObject &yamlObject,
+				    std::optional<Span<const std::string>> keys)
 {
 	/* Check start of the YAML file. */
 	EventPtr event = nextEvent();
@@ -620,7 +666,7 @@ int YamlParserContext::parseContent(YamlObject &yamlObject)
 
 	/* Parse the root object. */
 	event = nextEvent();
-	if (parseNextYamlObject(yamlObject, std::move(event)))
+	if (parseNextYamlObject(yamlObject, std::move(event), keys))
 		return -EINVAL;
 
 	/* Check end of the YAML file. */
@@ -703,13 +749,18 @@ int YamlParserContext::parseDictionaryOrList(YamlObject::Type type,
  * \brief Parse next YAML event and read it as a YamlObject
  * \param[in] yamlObject The result of YamlObject
  * \param[in] event The leading event of the object
+ * \param[in] keys The keys of the dictionary entries to parse
  *
  * Parse next YAML object separately as a value, list or dictionary.
  *
+ * When \a keys is set and the object is a dictionary, the entries whose key is
+ * not listed in \a keys are skipped without being stored in the YamlObject.
+ *
  * \return 0 on success or a negative error code otherwise
  * \retval -EINVAL Fail to parse the YAML file.
  */
-int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr event)
+int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr event,
+					   std::optional<Span<const std::string>> keys)
 {
 	if (!event)
 		return -EINVAL;
@@ -718,6 +769,7 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
 	case YAML_SCALAR_EVENT:
 		yamlObject.type_ = YamlObject::Type::Value;
 		readValue(yamlObject.value_, std::move(event));
+		yamlObject.parseNumbers();
 		return 0;
 
 	case YAML_SEQUENCE_START_EVENT: {
@@ -727,13 +779,18 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
 			list.emplace_back(std::string{}, std::make_unique<YamlObject>());
 			return parseNextYamlObject(*list.back().value, std::move(evt));
 		};
-		return parseDictionaryOrList(YamlObject::Type::List, handler);
+		int ret = parseDictionaryOrList(YamlObject::Type::List, handler);
+		if (ret)
+			return ret;
+
+		yamlObject.collectNumbers();
+		return 0;
 	}
 
 	case YAML_MAPPING_START_EVENT: {
 		yamlObject.type_ = YamlObject::Type::Dictionary;
 		auto &list = yamlObject.list_;
-		auto handler = [this, &list](EventPtr evtKey) {
+		auto handler = [this, &list, &keys](EventPtr evtKey) {
 			/* Parse key */
 			if (evtKey->type != YAML_SCALAR_EVENT) {
 				LOG(YamlParser, Error) << "Expect key at line: "
@@ -751,6 +808,9 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
 			if (!evtValue)
 				return -EINVAL;
 
+			if (keys && std::find(keys->begin(), keys->end(), key) == keys->end())
+				return skipNextYamlObject(std::move(evtValue));
+
 			auto &elem = list.emplace_back(std::move(key),
 						       std::make_unique<YamlObject>());
 			return parseNextYamlObject(*elem.value, std::move(evtValue));
@@ -772,6 +832,50 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
 	}
 }
 
+/**
+ * \fn YamlParserContext::skipNextYamlObject()
+ * \brief Skip the next YAML object
+ * \param[in] event The leading event of the object
+ *
+ * Consume all the events of the next YAML object, including nested lists and
+ * dictionaries, without storing their content.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL Fail to parse the YAML file.
+ */
+int YamlParserContext::skipNextYamlObject(EventPtr event)
+{
+	unsigned int depth = 0;
+
+	while (event) {
+		switch (event->type) {
+		case YAML_SCALAR_EVENT:
+			break;
+
+		case YAML_SEQUENCE_START_EVENT:
+		case YAML_MAPPING_START_EVENT:
+			depth++;
+			break;
+
+		case YAML_SEQUENCE_END_EVENT:
+		case YAML_MAPPING_END_EVENT:
+			depth--;
+			break;
+
+		default:
+			LOG(YamlParser, Error) << "Invalid YAML file";
+			return -EINVAL;
+		}
+
+		if (!depth)
+			return 0;
+
+		event = nextEvent();
+	}
+
+	return -EINVAL;
+}
+
 #endif /* __DOXYGEN__ */
 
 /**
@@ -824,6 +928,30 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
  * dictionaries.
  */
 
+namespace {
+
+std::unique_ptr<YamlObject> parseFile(File &file,
+				      std::optional<Span<const std::string>> keys)
+{
+	YamlParserContext context;
+
+	if (context.init(file))
+		return nullptr;
+
+	std::unique_ptr<YamlObject> root(new YamlObject());
+
+	if (context.parseContent(*root, keys)) {
+		LOG(YamlParser, Error)
+			<< "Failed to parse YAML content from "
+			<< file.fileName();
+		return nullptr;
+	}
+
+	return root;
+}
+
+} /* namespace */
+
 /**
  * \brief Parse a YAML file as a YamlObject
  * \param[in] file The YAML file to parse
@@ -836,20 +964,83 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
  */
 std::unique_ptr<YamlObject> YamlParser::parse(File &file)
 {
-	YamlParserContext context;
+	return parseFile(file, std::nullopt);
+}
 
-	if (context.init(file))
-		return nullptr;
+/**
+ * \brief Parse selected entries of a YAML file as a YamlObject
+ * \param[in] file The YAML file to parse
+ * \param[in] keys The keys of the root dictionary entries to parse
+ *
+ * This function behaves as parse(), but only stores the entries of the root
+ * dictionary whose key is listed in \a keys. The other entries are skipped as
+ * they are read from the file, without building the corresponding YamlObject
+ * trees. This lowers the parsing time and the memory consumption for callers
+ * that only need a few sections of a large YAML file.
+ *
+ * The whole file is still validated, and parsing fails if the file is not a
+ * valid YAML document. Skipped entries are reported as absent by the returned
+ * YamlObject.
+ *
+ * \return Pointer to result YamlObject on success or nullptr otherwise
+ */
+std::unique_ptr<YamlObject> YamlParser::parse(File &file, Span<const std::string> keys)
+{
+	return parseFile(file, keys);
+}
 
-	std::unique_ptr<YamlObject> root(new YamlObject());
 
-	if (context.parseContent(*root)) {
-		LOG(YamlParser, Error)
-			<< "Failed to parse YAML content from "
-			<< file.fileName();
+/**
+ * \brief Parse a YAML file as a YamlObject shared with other users
+ * \param[in] file The YAML file to parse
+ *
+ * This function behaves as parse(), but keeps the parsed YamlObject in a
+ * process-wide cache shared by all callers. Parsing the same file again
+ * returns the cached YamlObject without accessing the file contents, which
+ * avoids parsing large tuning files once per camera in multi-camera systems.
+ *
+ * The cache is keyed by the file name, and an entry is invalidated when the
+ * modification time or the size of the file changes. Up to 8 files are kept,
+ * the least recently used file being evicted first.
+ *
+ * \return Pointer to result YamlObject on success or nullptr otherwise
+ */
+std::shared_ptr<const YamlObject> YamlParser::parseShared(File &file)
+{
+	struct stat st;
+	if (stat(file.fileName().c_str(), &st) < 0)
+		return parse(file);
+
+	int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000
+		      + st.st_mtim.tv_nsec;
+	int64_t size = st.st_size;
+
+	MutexLocker locker(sharedFilesMutex);
+
+	auto iter = sharedFiles.find(file.fileName());
+	if (iter != sharedFiles.end() && iter->second.mtime == mtime &&
+	    iter->second.size == size) {
+		LOG(YamlParser, Debug)
+			<< "Using cached YAML content for " << file.fileName();
+
+		iter->second.lastUse = ++sharedFilesUse;
+		return iter->second.root;
+	}
+
+	std::shared_ptr<const YamlObject> root = parse(file);
+	if (!root)
 		return nullptr;
+
+	if (iter == sharedFiles.end() && sharedFiles.size() >= kMaxSharedFiles) {
+		auto oldest = std::min_element(sharedFiles.begin(), sharedFiles.end(),
+					       [](const auto &a, const auto &b) {
+						       return a.second.lastUse < b.second.lastUse;
+					       });
+		sharedFiles.erase(oldest);
 	}
 
+	sharedFiles[file.fileName()] = { mtime, size, ++sharedFilesUse, root };
+
 	return root;
 }
 
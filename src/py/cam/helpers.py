@@ -100,8 +100,7 @@ def to_rgb(fmt, size, data):
         rgb = rgb.astype(np.uint8)
 
     elif fmt == libcam.formats.RGB888:
-        rgb = data.reshape((h, w, 3))
-        rgb[:, :, [0, 1, 2]] = rgb[:, :, [2, 1, 0]]
+        rgb = np.ascontiguousarray(data.reshape((h, w, 3))[:, :, ::-1])
 
     elif fmt == libcam.formats.BGR888:
         rgb = data.reshape((h, w, 3))
@@ -153,6 +152,7 @@ def to_rgb(fmt, size, data):
 
 # A naive format conversion to 24-bit RGB
 def mfb_to_rgb(mfb: libcamera.utils.MappedFrameBuffer, cfg: libcam.StreamConfiguration):
-    data = np.array(mfb.planes[0], dtype=np.uint8)
+    # Access the buffer memory directly, the conversions don't modify it.
+    data = np.frombuffer(mfb.planes[0], dtype=np.uint8)
     rgb = to_rgb(cfg.pixel_format, cfg.size, data)
     return rgb
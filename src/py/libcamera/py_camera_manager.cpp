@@ -7,6 +7,7 @@
 
 #include <errno.h>
 #include <memory>
+#include <poll.h>
 #include <sys/eventfd.h>
 #include <system_error>
 #include <unistd.h>
@@ -60,33 +61,82 @@ py::list PyCameraManager::cameras()
 	return l;
 }
 
-std::vector<py::object> PyCameraManager::getReadyRequests()
+py::list PyCameraManager::getReadyRequests()
 {
-	int ret = readFd();
+	int ret;
+	std::vector<Request *> requests;
+
+	{
+		/* Don't block other Python threads while accessing the queue. */
+		py::gil_scoped_release release;
+
+		ret = readFd();
+		if (ret == 0)
+			requests = getCompletedRequests();
+	}
 
 	if (ret == -EAGAIN)
-		return std::vector<py::object>();
+		return py::list();
 
 	if (ret != 0)
 		throw std::system_error(-ret, std::generic_category());
 
-	std::vector<py::object> py_reqs;
+	/*
+	 * Return all the completed requests in a single list. The Python
+	 * objects are the ones kept alive by Camera.queue_request(), no new
+	 * object is created.
+	 */
+	py::list py_reqs(requests.size());
 
-	for (Request *request : getCompletedRequests()) {
-		py::object o = py::cast(request);
+	for (size_t i = 0; i < requests.size(); ++i) {
+		py::object o = py::cast(requests[i]);
 		/* Decrease the ref increased in Camera.queue_request() */
 		o.dec_ref();
-		py_reqs.push_back(o);
+		py_reqs[i] = std::move(o);
 	}
 
 	return py_reqs;
 }
 
+/*
+ * Wait for completed requests for up to \a timeout milliseconds, or forever if
+ * \a timeout is negative, without holding the GIL.
+ */
+py::list PyCameraManager::waitReadyRequests(int timeout)
+{
+	int ret;
+
+	{
+		py::gil_scoped_release release;
+
+		struct pollfd pfd = { eventFd_.get(), POLLIN, 0 };
+
+		do {
+			ret = poll(&pfd, 1, timeout);
+		} while (ret < 0 && errno == EINTR);
+
+		if (ret < 0)
+			ret = -errno;
+	}
+
+	if (ret < 0)
+		throw std::system_error(-ret, std::generic_category());
+
+	if (ret == 0)
+		return py::list();
+
+	return getReadyRequests();
+}
+
 /* Note: Called from another thread */
 void PyCameraManager::handleRequestCompleted(Request *req)
 {
-	pushRequest(req);
-	writeFd();
+	/*
+	 * Only signal the eventfd for the first request of a batch, the
+	 * following ones will be retrieved along with it.
+	 */
+	if (pushRequest(req))
+		writeFd();
 }
 
 void PyCameraManager::writeFd()
@@ -116,10 +166,11 @@ int PyCameraManager::readFd()
 		return -EIO;
 }
 
-void PyCameraManager::pushRequest(Request *req)
+bool PyCameraManager::pushRequest(Request *req)
 {
 	MutexLocker guard(completedRequestsMutex_);
 	completedRequests_.push_back(req);
+	return completedRequests_.size() == 1;
 }
 
 std::vector<Request *> PyCameraManager::getCompletedRequests()
@@ -26,7 +26,8 @@ public:
 
 	int eventFd() const { return eventFd_.get(); }
 
-	std::vector<pybind11::object> getReadyRequests();
+	pybind11::list getReadyRequests();
+	pybind11::list waitReadyRequests(int timeout);
 
 	void handleRequestCompleted(Request *req);
 
@@ -40,6 +41,6 @@ private:
 
 	void writeFd();
 	int readFd();
-	void pushRequest(Request *req);
+	bool pushRequest(Request *req);
 	std::vector<Request *> getCompletedRequests();
 };
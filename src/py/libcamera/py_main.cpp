@@ -7,15 +7,20 @@
 
 #include "py_main.h"
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <system_error>
 #include <vector>
 
 #include <libcamera/base/log.h>
 
 #include <libcamera/libcamera.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 #include <pybind11/functional.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
@@ -85,6 +90,88 @@ PYBIND11_DECLARE_HOLDER_TYPE(T, PyCameraSmartPtr<T>)
  */
 static std::weak_ptr<PyCameraManager> gCameraManager;
 
+/*
+ * A plane of a mapped FrameBuffer, exported to Python through the buffer
+ * protocol. The plane keeps a reference to the mapping, which stays valid for
+ * as long as Python objects (memoryviews, numpy arrays, ...) use the memory.
+ */
+class PyMappedPlane
+{
+public:
+	PyMappedPlane(std::shared_ptr<MappedFrameBuffer> mapping, Span<uint8_t> data)
+		: mapping_(std::move(mapping)), data_(data)
+	{
+	}
+
+	Span<uint8_t> data() const { return data_; }
+
+private:
+	std::shared_ptr<MappedFrameBuffer> mapping_;
+	Span<uint8_t> data_;
+};
+
+/*
+ * Cache of FrameBuffer mappings, to avoid mapping the buffers for every frame.
+ *
+ * Mappings are identified by the FrameBuffer pointer and the file descriptor
+ * of its first plane, in the same way as MappedFrameBufferCache. As there is
+ * no notification of FrameBuffer destruction, the number of cached mappings is
+ * bounded and the least recently used ones are dropped. Dropping a mapping
+ * from the cache is always safe, as planes exported to Python hold a reference
+ * to it.
+ */
+class PyMappingCache
+{
+public:
+	std::shared_ptr<MappedFrameBuffer> map(const FrameBuffer *buffer)
+	{
+		const SharedFD &fd = buffer->planes()[0].fd;
+
+		auto it = mappings_.find(buffer);
+		if (it != mappings_.end() && it->second.fd == fd) {
+			it->second.lastUse = ++useCount_;
+			return it->second.mapping;
+		}
+
+		auto mapping = std::make_shared<MappedFrameBuffer>(buffer,
+								   MappedFrameBuffer::MapFlag::ReadWrite);
+		if (!mapping->isValid())
+			throw std::system_error(-mapping->error(), std::generic_category(),
+						"Failed to map buffer");
+
+		if (it == mappings_.end() && mappings_.size() >= kMaxMappings) {
+			auto oldest = std::min_element(mappings_.begin(), mappings_.end(),
+						       [](const auto &a, const auto &b) {
+							       return a.second.lastUse < b.second.lastUse;
+						       });
+			mappings_.erase(oldest);
+		}
+
+		mappings_[buffer] = { fd, mapping, ++useCount_ };
+
+		return mapping;
+	}
+
+	void unmap(const FrameBuffer *buffer)
+	{
+		mappings_.erase(buffer);
+	}
+
+private:
+	static constexpr unsigned int kMaxMappings = 64;
+
+	struct Entry {
+		SharedFD fd;
+		std::shared_ptr<MappedFrameBuffer> mapping;
+		uint64_t lastUse;
+	};
+
+	std::map<const FrameBuffer *, Entry> mappings_;
+	uint64_t useCount_ = 0;
+};
+
+static PyMappingCache gMappingCache;
+
 void init_py_color_space(py::module &m);
 void init_py_controls_generated(py::module &m);
 void init_py_enums(py::module &m);
@@ -120,6 +207,7 @@ PYBIND11_MODULE(_libcamera, m)
 	auto pyFrameBufferAllocator = py::class_<FrameBufferAllocator>(m, "FrameBufferAllocator");
 	auto pyFrameBuffer = py::class_<FrameBuffer>(m, "FrameBuffer");
 	auto pyFrameBufferPlane = py::class_<FrameBuffer::Plane>(pyFrameBuffer, "Plane");
+	auto pyFrameBufferMappedPlane = py::class_<PyMappedPlane>(pyFrameBuffer, "MappedPlane", py::buffer_protocol());
 	auto pyStream = py::class_<Stream>(m, "Stream");
 	auto pyControlId = py::class_<ControlId>(m, "ControlId");
 	auto pyControlInfo = py::class_<ControlInfo>(m, "ControlInfo");
@@ -154,7 +242,9 @@ PYBIND11_MODULE(_libcamera, m)
 		.def_property_readonly("cameras", &PyCameraManager::cameras)
 
 		.def_property_readonly("event_fd", &PyCameraManager::eventFd)
-		.def("get_ready_requests", &PyCameraManager::getReadyRequests);
+		.def("get_ready_requests", &PyCameraManager::getReadyRequests)
+		.def("wait_ready_requests", &PyCameraManager::waitReadyRequests,
+		     py::arg("timeout") = -1);
 
 	pyCamera
 		.def_property_readonly("id", &Camera::id)
@@ -186,7 +276,12 @@ PYBIND11_MODULE(_libcamera, m)
 				controlList.set(id->id(), val);
 			}
 
-			int ret = self.start(&controlList);
+			int ret;
+			{
+				py::gil_scoped_release release;
+				ret = self.start(&controlList);
+			}
+
 			if (ret) {
 				self.requestCompleted.disconnect();
 				throw std::system_error(-ret, std::generic_category(),
@@ -195,7 +290,15 @@ PYBIND11_MODULE(_libcamera, m)
 		}, py::arg("controls") = std::unordered_map<const ControlId *, py::object>())
 
 		.def("stop", [](Camera &self) {
-			int ret = self.stop();
+			/*
+			 * Stopping waits for the pipeline handler, which only
+			 * needs the GIL-free request completion handler.
+			 */
+			int ret;
+			{
+				py::gil_scoped_release release;
+				ret = self.stop();
+			}
 
 			self.requestCompleted.disconnect();
 
@@ -380,7 +483,37 @@ PYBIND11_MODULE(_libcamera, m)
 		     py::arg("planes"), py::arg("cookie") = 0)
 		.def_property_readonly("metadata", &FrameBuffer::metadata, py::return_value_policy::reference_internal)
 		.def_property_readonly("planes", &FrameBuffer::planes)
-		.def_property("cookie", &FrameBuffer::cookie, &FrameBuffer::setCookie);
+		.def_property("cookie", &FrameBuffer::cookie, &FrameBuffer::setCookie)
+		/*
+		 * Map the buffer memory and return the planes, which support the
+		 * buffer protocol. The mapping is cached, mapping the same buffer
+		 * again is cheap.
+		 */
+		.def("map", [](FrameBuffer &self) {
+			std::shared_ptr<MappedFrameBuffer> mapping = gMappingCache.map(&self);
+
+			std::vector<PyMappedPlane> planes;
+			for (const MappedBuffer::Plane &plane : mapping->planes())
+				planes.emplace_back(mapping, plane);
+
+			return planes;
+		})
+		/* Drop the cached mapping, planes still in use stay valid */
+		.def("unmap", [](FrameBuffer &self) {
+			gMappingCache.unmap(&self);
+		});
+
+	pyFrameBufferMappedPlane
+		.def_buffer([](PyMappedPlane &self) {
+			Span<uint8_t> data = self.data();
+			return py::buffer_info(data.data(), sizeof(uint8_t),
+					       py::format_descriptor<uint8_t>::format(), 1,
+					       { static_cast<py::ssize_t>(data.size()) },
+					       { static_cast<py::ssize_t>(sizeof(uint8_t)) });
+		})
+		.def("__len__", [](const PyMappedPlane &self) {
+			return self.data().size();
+		});
 
 	pyFrameBufferPlane
 		.def(py::init())
@@ -0,0 +1,94 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+# Copyright (C) 2024, Ideas on Board Oy
+
+import asyncio
+from typing import List
+
+import libcamera
+
+
+class AsyncRequestReader:
+    """
+    Delivers the completed requests of a CameraManager to an asyncio loop
+
+    The CameraManager event fd is monitored by the event loop, and completed
+    requests are returned in batches, with a single wakeup of the awaiting
+    task for all the requests completed since the previous one.
+
+    Usage:
+
+        async with AsyncRequestReader(cm) as reader:
+            async for reqs in reader:
+                for req in reqs:
+                    ...
+    """
+    def __init__(self, cm: libcamera.CameraManager, loop: asyncio.AbstractEventLoop = None):
+        self.__cm = cm
+        self.__loop = loop if loop else asyncio.get_running_loop()
+        self.__ready = []
+        self.__waiter = None
+
+        self.__loop.add_reader(cm.event_fd, self.__readable)
+
+    def close(self):
+        if not self.__cm:
+            return
+
+        self.__loop.remove_reader(self.__cm.event_fd)
+        self.__cm = None
+
+        # Wake up the waiting task, if any
+        if self.__waiter and not self.__waiter.done():
+            self.__waiter.set_result(None)
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, exc_type, exc_value, exc_traceback):
+        self.close()
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self) -> List[libcamera.Request]:
+        reqs = await self.__wait()
+        if reqs is None:
+            raise StopAsyncIteration
+
+        return reqs
+
+    def __readable(self):
+        reqs = self.__cm.get_ready_requests()
+        if not reqs:
+            return
+
+        if self.__ready:
+            self.__ready.extend(reqs)
+        else:
+            self.__ready = reqs
+
+        if self.__waiter and not self.__waiter.done():
+            self.__waiter.set_result(None)
+
+    async def __wait(self):
+        while not self.__ready:
+            if not self.__cm:
+                return None
+
+            self.__waiter = self.__loop.create_future()
+            try:
+                await self.__waiter
+            finally:
+                self.__waiter = None
+
+        reqs = self.__ready
+        self.__ready = []
+        return reqs
+
+    async def get(self) -> List[libcamera.Request]:
+        """Wait for completed requests and return all of them"""
+        reqs = await self.__wait()
+        if reqs is None:
+            raise RuntimeError('AsyncRequestReader closed')
+
+        return reqs
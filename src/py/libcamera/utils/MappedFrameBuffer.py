@@ -7,6 +7,9 @@ from typing import Tuple
 class MappedFrameBuffer:
     """
     Provides memoryviews for the FrameBuffer's planes
+
+    The memory is mapped on first use only, munmap() releases the memoryviews
+    but keeps the mapping cached for the next frame.
     """
     def __init__(self, fb: libcamera.FrameBuffer):
         self.__fb = fb
@@ -23,59 +26,10 @@ class MappedFrameBuffer:
         if self.__planes:
             raise RuntimeError('MappedFrameBuffer already mmapped')
 
-        import os
-        import mmap
-
-        fb = self.__fb
-
-        # Collect information about the buffers
-
-        bufinfos = {}
-
-        for plane in fb.planes:
-            fd = plane.fd
-
-            if fd not in bufinfos:
-                buflen = os.lseek(fd, 0, os.SEEK_END)
-                bufinfos[fd] = {'maplen': 0, 'buflen': buflen}
-            else:
-                buflen = bufinfos[fd]['buflen']
-
-            if plane.offset > buflen or plane.offset + plane.length > buflen:
-                raise RuntimeError(f'plane is out of buffer: buffer length={buflen}, ' +
-                                   f'plane offset={plane.offset}, plane length={plane.length}')
-
-            bufinfos[fd]['maplen'] = max(bufinfos[fd]['maplen'], plane.offset + plane.length)
-
-        # mmap the buffers
-
-        maps = []
-
-        for fd, info in bufinfos.items():
-            map = mmap.mmap(fd, info['maplen'], mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
-            info['map'] = map
-            maps.append(map)
-
-        self.__maps = tuple(maps)
-
-        # Create memoryviews for the planes
-
-        planes = []
-
-        for plane in fb.planes:
-            fd = plane.fd
-            info = bufinfos[fd]
-
-            mv = memoryview(info['map'])
-
-            start = plane.offset
-            end = plane.offset + plane.length
-
-            mv = mv[start:end]
-
-            planes.append(mv)
-
-        self.__planes = tuple(planes)
+        # The mapping is cached by the bindings, the planes are memoryviews
+        # of the buffer memory and don't copy the data.
+        self.__maps = tuple(self.__fb.map())
+        self.__planes = tuple(memoryview(p) for p in self.__maps)
 
         return self
 
@@ -86,9 +40,6 @@ class MappedFrameBuffer:
         for p in self.__planes:
             p.release()
 
-        for mm in self.__maps:
-            mm.close()
-
         self.__planes = ()
         self.__maps = ()
 
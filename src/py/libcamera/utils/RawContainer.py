@@ -0,0 +1,116 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+# Copyright (C) 2024, Ideas on Board Oy
+
+from dataclasses import dataclass
+from typing import Iterator, List, Tuple
+import mmap
+import struct
+
+# Layout of the container written by 'cam --file=<name>.lcraw', see
+# src/apps/cam/raw_container.h
+FILE_HEADER = struct.Struct('<8s6I')
+STREAM_HEADER = struct.Struct('<32s8I')
+FRAME_HEADER = struct.Struct('<4s3I2QifQ4I')
+
+FILE_MAGIC = b'LCRAWCNT'
+FRAME_MAGIC = b'FRAM'
+VERSION = 1
+MAX_PLANES = 4
+
+
+def _align(size: int, alignment: int) -> int:
+    return (size + alignment - 1) // alignment * alignment
+
+
+@dataclass
+class RawContainerStream:
+    name: str
+    pixel_format: int
+    width: int
+    height: int
+    stride: int
+    frame_size: int
+
+
+@dataclass
+class RawContainerFrame:
+    stream: int
+    sequence: int
+    timestamp: int
+    sensor_timestamp: int
+    exposure_time: int
+    analogue_gain: float
+    planes: Tuple[memoryview, ...]
+
+
+class RawContainerReader:
+    """
+    Reads the frames of a raw container file without copying them
+
+    The file is mmapped, the frame planes are memoryviews of the mapping and
+    are only valid until the reader is closed.
+    """
+    def __init__(self, filename: str):
+        self.__file = open(filename, 'rb')
+        self.__map = mmap.mmap(self.__file.fileno(), 0, access=mmap.ACCESS_READ)
+        self.__view = memoryview(self.__map)
+
+        magic, version, num_streams, alignment, *_ = \
+            FILE_HEADER.unpack_from(self.__map, 0)
+        if magic != FILE_MAGIC or version != VERSION:
+            self.close()
+            raise RuntimeError(f'{filename} is not a version {VERSION} raw container')
+
+        self.__alignment = alignment
+        self.streams: List[RawContainerStream] = []
+
+        offset = FILE_HEADER.size
+        for _ in range(num_streams):
+            name, fourcc, width, height, stride, frame_size, *_ = \
+                STREAM_HEADER.unpack_from(self.__map, offset)
+            self.streams.append(RawContainerStream(name.rstrip(b'\0').decode(),
+                                                   fourcc, width, height,
+                                                   stride, frame_size))
+            offset += STREAM_HEADER.size
+
+        self.__first_frame = _align(offset, alignment)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, exc_traceback):
+        self.close()
+
+    def close(self):
+        self.__view.release()
+        self.__map.close()
+        self.__file.close()
+
+    def frames(self) -> Iterator[RawContainerFrame]:
+        offset = self.__first_frame
+        size = len(self.__map)
+
+        # Stop at the first truncated frame, the capture may have been
+        # interrupted while writing it.
+        while offset + FRAME_HEADER.size <= size:
+            (magic, stream, sequence, num_planes, timestamp, sensor_timestamp,
+             exposure_time, analogue_gain, payload_size,
+             *bytesused) = FRAME_HEADER.unpack_from(self.__map, offset)
+            if magic != FRAME_MAGIC:
+                raise RuntimeError(f'Invalid frame header at offset {offset}')
+
+            payload = offset + _align(FRAME_HEADER.size, self.__alignment)
+            if payload + payload_size > size:
+                break
+
+            planes = []
+            start = payload
+            for length in bytesused[:min(num_planes, MAX_PLANES)]:
+                planes.append(self.__view[start:start + length])
+                start += length
+
+            yield RawContainerFrame(stream, sequence, timestamp,
+                                    sensor_timestamp, exposure_time,
+                                    analogue_gain, tuple(planes))
+
+            offset = payload + _align(payload_size, self.__alignment)
@@ -1,4 +1,6 @@
 # SPDX-License-Identifier: LGPL-2.1-or-later
 # Copyright (C) 2022, Tomi Valkeinen <tomi.valkeinen@ideasonboard.com>
 
+from .AsyncRequestReader import AsyncRequestReader
 from .MappedFrameBuffer import MappedFrameBuffer
+from .RawContainer import RawContainerReader, RawContainerStream, RawContainerFrame
@@ -8,9 +8,13 @@
 #include "v4l2_camera.h"
 
 #include <errno.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include "libcamera/internal/formats.h"
 
 using namespace libcamera;
 
@@ -18,7 +22,8 @@ LOG_DECLARE_CATEGORY(V4L2Compat)
 
 V4L2Camera::V4L2Camera(std::shared_ptr<Camera> camera)
 	: camera_(camera), isRunning_(false), bufferAllocator_(nullptr),
-	  efd_(-1), bufferAvailableCount_(0)
+	  completedBuffers_{}, completedHead_(0), completedTail_(0), efd_(-1),
+	  bufferAvailableCount_(0)
 {
 	camera_->requestCompleted.connect(this, &V4L2Camera::requestComplete);
 }
@@ -50,6 +55,7 @@ int V4L2Camera::open(StreamConfiguration *streamConfig)
 void V4L2Camera::close()
 {
 	requestPool_.clear();
+	importedBuffers_.clear();
 
 	delete bufferAllocator_;
 	bufferAllocator_ = nullptr;
@@ -67,16 +73,21 @@ void V4L2Camera::unbind()
 	efd_ = -1;
 }
 
-std::vector<V4L2Camera::Buffer> V4L2Camera::completedBuffers()
+/*
+ * Retrieve the oldest completed buffer. This function must not be called
+ * concurrently, the proxy serializes the calls with its own lock.
+ */
+bool V4L2Camera::dequeueCompletedBuffer(Buffer *buffer)
 {
-	std::vector<Buffer> v;
+	unsigned int tail = completedTail_.load(std::memory_order_relaxed);
+	if (tail == completedHead_.load(std::memory_order_acquire))
+		return false;
 
-	MutexLocker lock(bufferLock_);
-	for (std::unique_ptr<Buffer> &metadata : completedBuffers_)
-		v.push_back(*metadata.get());
-	completedBuffers_.clear();
+	*buffer = completedBuffers_[tail];
+	completedTail_.store((tail + 1) % completedBuffers_.size(),
+			     std::memory_order_release);
 
-	return v;
+	return true;
 }
 
 void V4L2Camera::requestComplete(Request *request)
@@ -85,12 +96,20 @@ void V4L2Camera::requestComplete(Request *request)
 		return;
 
 	/* We only have one stream at the moment. */
-	bufferLock_.lock();
-	FrameBuffer *buffer = request->buffers().begin()->second;
-	std::unique_ptr<Buffer> metadata =
-		std::make_unique<Buffer>(request->cookie(), buffer->metadata());
-	completedBuffers_.push_back(std::move(metadata));
-	bufferLock_.unlock();
+	const FrameMetadata &fmd = request->buffers().begin()->second->metadata();
+	unsigned int head = completedHead_.load(std::memory_order_relaxed);
+	Buffer &buffer = completedBuffers_[head];
+
+	buffer.index_ = request->cookie();
+	buffer.status_ = fmd.status;
+	buffer.sequence_ = fmd.sequence;
+	buffer.timestamp_ = fmd.timestamp;
+	buffer.bytesused_ = 0;
+	for (const FrameMetadata::Plane &plane : fmd.planes())
+		buffer.bytesused_ += plane.bytesused;
+
+	completedHead_.store((head + 1) % completedBuffers_.size(),
+			     std::memory_order_release);
 
 	uint64_t data = 1;
 	int ret = ::write(efd_, &data, sizeof(data));
@@ -158,6 +177,9 @@ int V4L2Camera::validateConfiguration(const PixelFormat &pixelFormat,
 
 int V4L2Camera::allocBuffers(unsigned int count)
 {
+	if (count > kMaxBuffers)
+		return -EINVAL;
+
 	Stream *stream = config_->at(0).stream();
 
 	int ret = bufferAllocator_->allocate(stream);
@@ -176,11 +198,39 @@ int V4L2Camera::allocBuffers(unsigned int count)
 	return ret;
 }
 
+/*
+ * Create the requests for count buffers provided by the application as
+ * dma-bufs. The buffers are imported when they are queued.
+ */
+int V4L2Camera::importBuffers(unsigned int count)
+{
+	if (count > kMaxBuffers)
+		return -EINVAL;
+
+	for (unsigned int i = 0; i < count; i++) {
+		std::unique_ptr<Request> request = camera_->createRequest(i);
+		if (!request) {
+			requestPool_.clear();
+			return -ENOMEM;
+		}
+		requestPool_.push_back(std::move(request));
+	}
+
+	importedBuffers_.resize(count);
+
+	return count;
+}
+
 void V4L2Camera::freeBuffers()
 {
 	pendingRequests_.clear();
 	requestPool_.clear();
 
+	if (!importedBuffers_.empty()) {
+		importedBuffers_.clear();
+		return;
+	}
+
 	Stream *stream = config_->at(0).stream();
 	bufferAllocator_->free(stream);
 }
@@ -244,7 +294,66 @@ int V4L2Camera::streamOff()
 	return 0;
 }
 
-int V4L2Camera::qbuf(unsigned int index)
+/*
+ * Wrap the dma-buf fd in a FrameBuffer. The FrameBuffer is cached per index and
+ * reused as long as the application queues the same dma-buf, identified by the
+ * inode of the fd, as applications usually assign a fixed buffer to an index.
+ */
+FrameBuffer *V4L2Camera::importBuffer(unsigned int index, int fd)
+{
+	ImportedBuffer &imported = importedBuffers_[index];
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		LOG(V4L2Compat, Error) << "Invalid dma-buf fd " << fd;
+		return nullptr;
+	}
+
+	if (imported.buffer && imported.inode == st.st_ino)
+		return imported.buffer.get();
+
+	const StreamConfiguration &streamConfig = config_->at(0);
+	off_t size = lseek(fd, 0, SEEK_END);
+	if (size < 0 || static_cast<size_t>(size) < streamConfig.frameSize) {
+		LOG(V4L2Compat, Error)
+			<< "dma-buf too small for frame size of "
+			<< streamConfig.frameSize << " bytes";
+		return nullptr;
+	}
+
+	const PixelFormatInfo &info = PixelFormatInfo::info(streamConfig.pixelFormat);
+	unsigned int numPlanes = info.isValid() ? info.numPlanes() : 1;
+
+	/* The dup()ed fd is shared by all the planes. */
+	SharedFD dmabuf(fd);
+	std::vector<FrameBuffer::Plane> planes(numPlanes);
+	size_t offset = 0;
+
+	for (auto [i, plane] : utils::enumerate(planes)) {
+		plane.fd = dmabuf;
+		plane.offset = offset;
+
+		if (numPlanes == 1) {
+			plane.length = streamConfig.frameSize;
+			break;
+		}
+
+		/* Same computation as V4L2VideoDevice::createBuffer(). */
+		unsigned int stride = streamConfig.stride
+				    * info.planes[i].bytesPerGroup
+				    / info.planes[0].bytesPerGroup;
+
+		plane.length = info.planeSize(streamConfig.size.height, i, stride);
+		offset += plane.length;
+	}
+
+	imported.inode = st.st_ino;
+	imported.buffer = std::make_unique<FrameBuffer>(planes);
+
+	return imported.buffer.get();
+}
+
+int V4L2Camera::qbuf(unsigned int index, int fd)
 {
 	if (index >= requestPool_.size()) {
 		LOG(V4L2Compat, Error) << "Invalid index";
@@ -253,7 +362,15 @@ int V4L2Camera::qbuf(unsigned int index)
 	Request *request = requestPool_[index].get();
 
 	Stream *stream = config_->at(0).stream();
-	FrameBuffer *buffer = bufferAllocator_->buffers(stream)[index].get();
+	FrameBuffer *buffer;
+	if (importedBuffers_.empty()) {
+		buffer = bufferAllocator_->buffers(stream)[index].get();
+	} else {
+		buffer = importBuffer(index, fd);
+		if (!buffer)
+			return -EINVAL;
+	}
+
 	int ret = request->addBuffer(stream, buffer);
 	if (ret < 0) {
 		LOG(V4L2Compat, Error) << "Can't set buffer for request";
@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <deque>
+#include <linux/videodev2.h>
+#include <sys/types.h>
 #include <utility>
 
 #include <libcamera/base/mutex.h>
@@ -22,15 +26,16 @@ class V4L2Camera
 {
 public:
 	struct Buffer {
-		Buffer(unsigned int index, const libcamera::FrameMetadata &data)
-			: index_(index), data_(data)
-		{
-		}
-
 		unsigned int index_;
-		libcamera::FrameMetadata data_;
+		libcamera::FrameMetadata::Status status_;
+		unsigned int sequence_;
+		uint64_t timestamp_;
+		unsigned int bytesused_;
 	};
 
+	/* The V4L2 API doesn't support more buffers per queue. */
+	static constexpr unsigned int kMaxBuffers = VIDEO_MAX_FRAME;
+
 	V4L2Camera(std::shared_ptr<libcamera::Camera> camera);
 	~V4L2Camera();
 
@@ -39,7 +44,7 @@ public:
 	void bind(int efd);
 	void unbind();
 
-	std::vector<Buffer> completedBuffers() LIBCAMERA_TSA_EXCLUDES(bufferLock_);
+	bool dequeueCompletedBuffer(Buffer *buffer);
 
 	int configure(libcamera::StreamConfiguration *streamConfigOut,
 		      const libcamera::Size &size,
@@ -50,13 +55,14 @@ public:
 				  libcamera::StreamConfiguration *streamConfigOut);
 
 	int allocBuffers(unsigned int count);
+	int importBuffers(unsigned int count);
 	void freeBuffers();
 	int getBufferFd(unsigned int index);
 
 	int streamOn();
 	int streamOff();
 
-	int qbuf(unsigned int index);
+	int qbuf(unsigned int index, int fd = -1);
 
 	void waitForBufferAvailable() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
 	bool isBufferAvailable() LIBCAMERA_TSA_EXCLUDES(bufferMutex_);
@@ -64,22 +70,34 @@ public:
 	bool isRunning();
 
 private:
-	void requestComplete(libcamera::Request *request)
-		LIBCAMERA_TSA_EXCLUDES(bufferLock_);
+	struct ImportedBuffer {
+		ino_t inode;
+		std::unique_ptr<libcamera::FrameBuffer> buffer;
+	};
+
+	void requestComplete(libcamera::Request *request);
+	libcamera::FrameBuffer *importBuffer(unsigned int index, int fd);
 
 	std::shared_ptr<libcamera::Camera> camera_;
 	std::unique_ptr<libcamera::CameraConfiguration> config_;
 
 	bool isRunning_;
 
-	libcamera::Mutex bufferLock_;
 	libcamera::FrameBufferAllocator *bufferAllocator_;
 
 	std::vector<std::unique_ptr<libcamera::Request>> requestPool_;
+	std::vector<ImportedBuffer> importedBuffers_;
 
 	std::deque<libcamera::Request *> pendingRequests_;
-	std::deque<std::unique_ptr<Buffer>> completedBuffers_
-		LIBCAMERA_TSA_GUARDED_BY(bufferLock_);
+
+	/*
+	 * Single producer, single consumer ring of completed buffers, filled by
+	 * requestComplete() in the camera thread and drained by the proxy. As
+	 * at most kMaxBuffers requests are queued, the ring never overflows.
+	 */
+	std::array<Buffer, kMaxBuffers + 1> completedBuffers_;
+	std::atomic<unsigned int> completedHead_;
+	std::atomic<unsigned int> completedTail_;
 
 	int efd_;
 
@@ -10,7 +10,6 @@
 #include <algorithm>
 #include <array>
 #include <errno.h>
-#include <numeric>
 #include <set>
 #include <string.h>
 #include <sys/mman.h>
@@ -39,7 +38,8 @@ LOG_DECLARE_CATEGORY(V4L2Compat)
 
 V4L2CameraProxy::V4L2CameraProxy(unsigned int index,
 				 std::shared_ptr<Camera> camera)
-	: refcount_(0), index_(index), bufferCount_(0), currentBuf_(0),
+	: refcount_(0), index_(index), bufferCount_(0),
+	  memory_(V4L2_MEMORY_MMAP), currentBuf_(0),
 	  vcam_(std::make_unique<V4L2Camera>(camera)), owner_(nullptr)
 {
 	querycap(camera);
@@ -105,6 +105,12 @@ void *V4L2CameraProxy::mmap(V4L2CameraFile *file, void *addr, size_t length,
 
 	MutexLocker locker(proxyMutex_);
 
+	/* Imported dma-bufs are mapped by the application directly. */
+	if (memory_ != V4L2_MEMORY_MMAP) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
 	/*
 	 * Mimic the videobuf2 behaviour, which requires PROT_READ and
 	 * MAP_SHARED.
@@ -168,12 +174,13 @@ int V4L2CameraProxy::munmap(V4L2CameraFile *file, void *addr, size_t length)
 
 bool V4L2CameraProxy::validateBufferType(uint32_t type)
 {
-	return type == V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	return type == V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+	       type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
 }
 
 bool V4L2CameraProxy::validateMemoryType(uint32_t memory)
 {
-	return memory == V4L2_MEMORY_MMAP;
+	return memory == V4L2_MEMORY_MMAP || memory == V4L2_MEMORY_DMABUF;
 }
 
 void V4L2CameraProxy::setFmtFromConfig(const StreamConfiguration &streamConfig)
@@ -209,6 +216,7 @@ void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera)
 	/* \todo Put this in a header/config somewhere. */
 	capabilities_.version = KERNEL_VERSION(5, 2, 0);
 	capabilities_.device_caps = V4L2_CAP_VIDEO_CAPTURE
+				  | V4L2_CAP_VIDEO_CAPTURE_MPLANE
 				  | V4L2_CAP_STREAMING
 				  | V4L2_CAP_EXT_PIX_FORMAT;
 	capabilities_.capabilities = capabilities_.device_caps
@@ -216,24 +224,108 @@ void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera)
 	memset(capabilities_.reserved, 0, sizeof(capabilities_.reserved));
 }
 
+/*
+ * The frames are stored contiguously in memory, the multi-planar API is
+ * supported with a single memory plane. The formats and buffers are stored in
+ * their single-planar form and converted when exchanged with the application.
+ */
+void V4L2CameraProxy::getPixFormat(const struct v4l2_format *arg,
+				   struct v4l2_pix_format *pix)
+{
+	if (arg->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+		*pix = arg->fmt.pix;
+		return;
+	}
+
+	const struct v4l2_pix_format_mplane &mplane = arg->fmt.pix_mp;
+
+	*pix = {};
+	pix->width = mplane.width;
+	pix->height = mplane.height;
+	pix->pixelformat = mplane.pixelformat;
+	pix->field = mplane.field;
+	pix->bytesperline = mplane.plane_fmt[0].bytesperline;
+	pix->sizeimage = mplane.plane_fmt[0].sizeimage;
+	pix->colorspace = mplane.colorspace;
+	pix->ycbcr_enc = mplane.ycbcr_enc;
+	pix->quantization = mplane.quantization;
+	pix->xfer_func = mplane.xfer_func;
+}
+
+void V4L2CameraProxy::setPixFormat(struct v4l2_format *arg,
+				   const struct v4l2_pix_format &pix)
+{
+	if (arg->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+		arg->fmt.pix = pix;
+		return;
+	}
+
+	struct v4l2_pix_format_mplane &mplane = arg->fmt.pix_mp;
+
+	memset(&mplane, 0, sizeof(mplane));
+	mplane.width = pix.width;
+	mplane.height = pix.height;
+	mplane.pixelformat = pix.pixelformat;
+	mplane.field = pix.field;
+	mplane.colorspace = pix.colorspace;
+	mplane.num_planes = 1;
+	mplane.plane_fmt[0].bytesperline = pix.bytesperline;
+	mplane.plane_fmt[0].sizeimage = pix.sizeimage;
+	mplane.ycbcr_enc = pix.ycbcr_enc;
+	mplane.quantization = pix.quantization;
+	mplane.xfer_func = pix.xfer_func;
+}
+
+int V4L2CameraProxy::copyBufferToUser(const struct v4l2_buffer &buf,
+				      struct v4l2_buffer *arg)
+{
+	if (arg->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+		*arg = buf;
+		return 0;
+	}
+
+	if (!arg->m.planes || arg->length < 1)
+		return -EINVAL;
+
+	struct v4l2_plane *plane = arg->m.planes;
+	struct v4l2_buffer mplane = buf;
+
+	mplane.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+	mplane.m.planes = plane;
+	mplane.length = 1;
+	mplane.bytesused = 0;
+
+	memset(plane, 0, sizeof(*plane));
+	plane->bytesused = buf.bytesused;
+	plane->length = buf.length;
+	if (buf.memory == V4L2_MEMORY_DMABUF)
+		plane->m.fd = buf.m.fd;
+	else
+		plane->m.mem_offset = buf.m.offset;
+
+	*arg = mplane;
+
+	return 0;
+}
+
 void V4L2CameraProxy::updateBuffers()
 {
-	std::vector<V4L2Camera::Buffer> completedBuffers = vcam_->completedBuffers();
-	for (const V4L2Camera::Buffer &buffer : completedBuffers) {
-		const FrameMetadata &fmd = buffer.data_;
+	V4L2Camera::Buffer buffer;
+
+	while (vcam_->dequeueCompletedBuffer(&buffer)) {
+		/* Skip buffers completed before the buffers were reallocated. */
+		if (buffer.index_ >= buffers_.size())
+			continue;
+
 		struct v4l2_buffer &buf = buffers_[buffer.index_];
 
-		switch (fmd.status) {
+		switch (buffer.status_) {
 		case FrameMetadata::FrameSuccess:
-			buf.bytesused = std::accumulate(fmd.planes().begin(),
-							fmd.planes().end(), 0,
-							[](unsigned int total, const auto &plane) {
-								return total + plane.bytesused;
-							});
+			buf.bytesused = buffer.bytesused_;
 			buf.field = V4L2_FIELD_NONE;
-			buf.timestamp.tv_sec = fmd.timestamp / 1000000000;
-			buf.timestamp.tv_usec = (fmd.timestamp / 1000) % 1000000;
-			buf.sequence = fmd.sequence;
+			buf.timestamp.tv_sec = buffer.timestamp_ / 1000000000;
+			buf.timestamp.tv_usec = (buffer.timestamp_ / 1000) % 1000000;
+			buf.sequence = buffer.sequence_;
 
 			buf.flags |= V4L2_BUF_FLAG_DONE;
 			break;
@@ -311,16 +403,16 @@ int V4L2CameraProxy::vidioc_g_fmt(V4L2CameraFile *file, struct v4l2_format *arg)
 		return -EINVAL;
 
 	memset(&arg->fmt, 0, sizeof(arg->fmt));
-	arg->fmt.pix = v4l2PixFormat_;
+	setPixFormat(arg, v4l2PixFormat_);
 
 	return 0;
 }
 
-int V4L2CameraProxy::tryFormat(struct v4l2_format *arg)
+int V4L2CameraProxy::tryFormat(struct v4l2_pix_format *pix)
 {
-	V4L2PixelFormat v4l2Format = V4L2PixelFormat(arg->fmt.pix.pixelformat);
+	V4L2PixelFormat v4l2Format = V4L2PixelFormat(pix->pixelformat);
 	PixelFormat format = v4l2Format.toPixelFormat();
-	Size size(arg->fmt.pix.width, arg->fmt.pix.height);
+	Size size(pix->width, pix->height);
 
 	StreamConfiguration config;
 	int ret = vcam_->validateConfiguration(format, size, &config);
@@ -331,17 +423,17 @@ int V4L2CameraProxy::tryFormat(struct v4l2_format *arg)
 		return -EINVAL;
 	}
 
-	arg->fmt.pix.width        = config.size.width;
-	arg->fmt.pix.height       = config.size.height;
-	arg->fmt.pix.pixelformat  = V4L2PixelFormat::fromPixelFormat(config.pixelFormat)[0];
-	arg->fmt.pix.field        = V4L2_FIELD_NONE;
-	arg->fmt.pix.bytesperline = config.stride;
-	arg->fmt.pix.sizeimage    = config.frameSize;
-	arg->fmt.pix.colorspace   = V4L2_COLORSPACE_SRGB;
-	arg->fmt.pix.priv         = V4L2_PIX_FMT_PRIV_MAGIC;
-	arg->fmt.pix.ycbcr_enc    = V4L2_YCBCR_ENC_DEFAULT;
-	arg->fmt.pix.quantization = V4L2_QUANTIZATION_DEFAULT;
-	arg->fmt.pix.xfer_func    = V4L2_XFER_FUNC_DEFAULT;
+	pix->width        = config.size.width;
+	pix->height       = config.size.height;
+	pix->pixelformat  = V4L2PixelFormat::fromPixelFormat(config.pixelFormat)[0];
+	pix->field        = V4L2_FIELD_NONE;
+	pix->bytesperline = config.stride;
+	pix->sizeimage    = config.frameSize;
+	pix->colorspace   = V4L2_COLORSPACE_SRGB;
+	pix->priv         = V4L2_PIX_FMT_PRIV_MAGIC;
+	pix->ycbcr_enc    = V4L2_YCBCR_ENC_DEFAULT;
+	pix->quantization = V4L2_QUANTIZATION_DEFAULT;
+	pix->xfer_func    = V4L2_XFER_FUNC_DEFAULT;
 
 	return 0;
 }
@@ -361,18 +453,22 @@ int V4L2CameraProxy::vidioc_s_fmt(V4L2CameraFile *file, struct v4l2_format *arg)
 	if (ret < 0)
 		return ret;
 
-	ret = tryFormat(arg);
+	struct v4l2_pix_format pix;
+	getPixFormat(arg, &pix);
+
+	ret = tryFormat(&pix);
 	if (ret < 0)
 		return ret;
 
-	Size size(arg->fmt.pix.width, arg->fmt.pix.height);
-	V4L2PixelFormat v4l2Format = V4L2PixelFormat(arg->fmt.pix.pixelformat);
+	Size size(pix.width, pix.height);
+	V4L2PixelFormat v4l2Format = V4L2PixelFormat(pix.pixelformat);
 	ret = vcam_->configure(&streamConfig_, size, v4l2Format.toPixelFormat(),
 			       bufferCount_);
 	if (ret < 0)
 		return -EINVAL;
 
 	setFmtFromConfig(streamConfig_);
+	setPixFormat(arg, v4l2PixFormat_);
 
 	return 0;
 }
@@ -385,10 +481,15 @@ int V4L2CameraProxy::vidioc_try_fmt(V4L2CameraFile *file, struct v4l2_format *ar
 	if (!validateBufferType(arg->type))
 		return -EINVAL;
 
-	int ret = tryFormat(arg);
+	struct v4l2_pix_format pix;
+	getPixFormat(arg, &pix);
+
+	int ret = tryFormat(&pix);
 	if (ret < 0)
 		return ret;
 
+	setPixFormat(arg, pix);
+
 	return 0;
 }
 
@@ -490,7 +591,7 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 	if (!hasOwnership(file) && owner_)
 		return -EBUSY;
 
-	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP;
+	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP | V4L2_BUF_CAP_SUPPORTS_DMABUF;
 	arg->flags = 0;
 	memset(arg->reserved, 0, sizeof(arg->reserved));
 
@@ -511,6 +612,9 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 	if (bufferCount_ > 0)
 		freeBuffers();
 
+	/* Mimic the videobuf2 behaviour, which clamps the number of buffers. */
+	arg->count = std::min(arg->count, V4L2Camera::kMaxBuffers);
+
 	Size size(v4l2PixFormat_.width, v4l2PixFormat_.height);
 	V4L2PixelFormat v4l2Format = V4L2PixelFormat(v4l2PixFormat_.pixelformat);
 	int ret = vcam_->configure(&streamConfig_, size,
@@ -522,8 +626,12 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 
 	arg->count = streamConfig_.bufferCount;
 	bufferCount_ = arg->count;
+	memory_ = static_cast<enum v4l2_memory>(arg->memory);
 
-	ret = vcam_->allocBuffers(arg->count);
+	if (memory_ == V4L2_MEMORY_DMABUF)
+		ret = vcam_->importBuffers(arg->count);
+	else
+		ret = vcam_->allocBuffers(arg->count);
 	if (ret < 0) {
 		arg->count = 0;
 		return ret;
@@ -534,8 +642,11 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 		struct v4l2_buffer buf = {};
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.length = v4l2PixFormat_.sizeimage;
-		buf.memory = V4L2_MEMORY_MMAP;
-		buf.m.offset = i * v4l2PixFormat_.sizeimage;
+		buf.memory = memory_;
+		if (memory_ == V4L2_MEMORY_DMABUF)
+			buf.m.fd = -1;
+		else
+			buf.m.offset = i * v4l2PixFormat_.sizeimage;
 		buf.index = i;
 		buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 
@@ -563,9 +674,7 @@ int V4L2CameraProxy::vidioc_querybuf(V4L2CameraFile *file, struct v4l2_buffer *a
 
 	updateBuffers();
 
-	*arg = buffers_[arg->index];
-
-	return 0;
+	return copyBufferToUser(buffers_[arg->index], arg);
 }
 
 int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer *arg)
@@ -584,7 +693,7 @@ int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
 	struct v4l2_buffer &buffer = buffers_[arg->index];
@@ -616,14 +725,26 @@ int V4L2CameraProxy::vidioc_qbuf(V4L2CameraFile *file, struct v4l2_buffer *arg)
 		return -EBUSY;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory) ||
+	    arg->memory != memory_ ||
 	    arg->index >= bufferCount_)
 		return -EINVAL;
 
-	int ret = vcam_->qbuf(arg->index);
+	int fd = -1;
+	if (memory_ == V4L2_MEMORY_DMABUF) {
+		if (arg->type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+			fd = arg->m.fd;
+		else if (arg->m.planes && arg->length >= 1)
+			fd = arg->m.planes[0].m.fd;
+		else
+			return -EINVAL;
+	}
+
+	int ret = vcam_->qbuf(arg->index, fd);
 	if (ret < 0)
 		return ret;
 
+	if (memory_ == V4L2_MEMORY_DMABUF)
+		buffers_[arg->index].m.fd = fd;
 	buffers_[arg->index].flags |= V4L2_BUF_FLAG_QUEUED;
 
 	arg->flags = buffers_[arg->index].flags;
@@ -647,7 +768,11 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
+		return -EINVAL;
+
+	if (arg->type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE &&
+	    (!arg->m.planes || arg->length < 1))
 		return -EINVAL;
 
 	if (!file->nonBlocking()) {
@@ -670,12 +795,14 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 
 	buf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_PREPARED);
 	buf.length = sizeimage_;
-	*arg = buf;
+	int ret = copyBufferToUser(buf, arg);
+	if (ret < 0)
+		return ret;
 
 	currentBuf_ = (currentBuf_ + 1) % bufferCount_;
 
 	uint64_t data;
-	int ret = ::read(file->efd(), &data, sizeof(data));
+	ret = ::read(file->efd(), &data, sizeof(data));
 	if (ret != sizeof(data))
 		LOG(V4L2Compat, Error) << "Failed to clear eventfd POLLIN";
 
@@ -690,8 +817,8 @@ int V4L2CameraProxy::vidioc_expbuf(V4L2CameraFile *file, struct v4l2_exportbuffe
 	if (!hasOwnership(file))
 		return -EBUSY;
 
-	/* \todo Verify that the memory type is MMAP when adding DMABUF support */
-	if (!validateBufferType(arg->type))
+	if (!validateBufferType(arg->type) || memory_ != V4L2_MEMORY_MMAP ||
+	    arg->plane != 0)
 		return -EINVAL;
 
 	if (arg->index >= bufferCount_)
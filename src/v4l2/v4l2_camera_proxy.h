@@ -42,7 +42,10 @@ private:
 	bool validateMemoryType(uint32_t memory);
 	void setFmtFromConfig(const libcamera::StreamConfiguration &streamConfig);
 	void querycap(std::shared_ptr<libcamera::Camera> camera);
-	int tryFormat(struct v4l2_format *arg);
+	void getPixFormat(const struct v4l2_format *arg, struct v4l2_pix_format *pix);
+	void setPixFormat(struct v4l2_format *arg, const struct v4l2_pix_format &pix);
+	int copyBufferToUser(const struct v4l2_buffer &buf, struct v4l2_buffer *arg);
+	int tryFormat(struct v4l2_pix_format *pix);
 	enum v4l2_priority maxPriority();
 	void updateBuffers();
 	void freeBuffers();
@@ -79,6 +82,7 @@ private:
 
 	libcamera::StreamConfiguration streamConfig_;
 	unsigned int bufferCount_;
+	enum v4l2_memory memory_;
 	unsigned int currentBuf_;
 	unsigned int sizeimage_;
 
@@ -0,0 +1,349 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * CameraGroup test
+ */
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include <libcamera/camera.h>
+#include <libcamera/camera_group.h>
+#include <libcamera/camera_manager.h>
+#include <libcamera/control_ids.h>
+#include <libcamera/framebuffer_allocator.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* The frame period of the virtual cameras, in nanoseconds. */
+constexpr int64_t kFramePeriod = 1000000000 / 30;
+
+struct Frame {
+	uint32_t sequence;
+	int64_t timestamp;
+	int64_t syncFrame;
+	int64_t syncError;
+};
+
+class GroupedCamera
+{
+public:
+	GroupedCamera(shared_ptr<Camera> camera)
+		: camera_(std::move(camera))
+	{
+	}
+
+	~GroupedCamera()
+	{
+		requests_.clear();
+		allocator_.reset();
+		camera_->release();
+	}
+
+	int init()
+	{
+		if (camera_->acquire()) {
+			cerr << "Failed to acquire " << camera_->id() << endl;
+			return TestFail;
+		}
+
+		config_ = camera_->generateConfiguration({ StreamRole::Viewfinder });
+		if (!config_ || camera_->configure(config_.get())) {
+			cerr << "Failed to configure " << camera_->id() << endl;
+			return TestFail;
+		}
+
+		Stream *stream = config_->at(0).stream();
+		allocator_ = make_unique<FrameBufferAllocator>(camera_);
+		if (allocator_->allocate(stream) < 0) {
+			cerr << "Failed to allocate buffers" << endl;
+			return TestFail;
+		}
+
+		for (const unique_ptr<FrameBuffer> &buffer : allocator_->buffers(stream)) {
+			unique_ptr<Request> request = camera_->createRequest();
+			if (!request || request->addBuffer(stream, buffer.get())) {
+				cerr << "Failed to create request" << endl;
+				return TestFail;
+			}
+
+			requests_.push_back(std::move(request));
+		}
+
+		camera_->requestCompleted.connect(this, &GroupedCamera::requestComplete);
+
+		return TestPass;
+	}
+
+	int start()
+	{
+		if (camera_->start())
+			return TestFail;
+
+		for (unique_ptr<Request> &request : requests_) {
+			if (camera_->queueRequest(request.get()))
+				return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int stop()
+	{
+		return camera_->stop() ? TestFail : TestPass;
+	}
+
+	const shared_ptr<Camera> &camera() const { return camera_; }
+	const vector<Frame> &frames() const { return frames_; }
+	unsigned int unsynchronised() const { return unsynchronised_; }
+
+private:
+	void requestComplete(Request *request)
+	{
+		if (request->status() != Request::RequestComplete)
+			return;
+
+		const ControlList &metadata = request->metadata();
+		const auto syncFrame = metadata.get(controls::draft::SyncFrame);
+		const auto syncError = metadata.get(controls::draft::SyncError);
+
+		if (syncFrame && syncError)
+			frames_.push_back({ request->buffers().begin()->second->metadata().sequence,
+					    metadata.get(controls::SensorTimestamp).value_or(0),
+					    *syncFrame, *syncError });
+		else
+			unsynchronised_++;
+
+		request->reuse(Request::ReuseBuffers);
+		camera_->queueRequest(request);
+	}
+
+	shared_ptr<Camera> camera_;
+	unique_ptr<CameraConfiguration> config_;
+	unique_ptr<FrameBufferAllocator> allocator_;
+	vector<unique_ptr<Request>> requests_;
+
+	vector<Frame> frames_;
+	unsigned int unsynchronised_ = 0;
+};
+
+} /* namespace */
+
+class CameraGroupTest : public Test
+{
+protected:
+	int init() override
+	{
+		/* Create two free-running virtual cameras with the same frame rate. */
+		configFile_ = "/tmp/libcamera-camera-group-test-" +
+			      to_string(getpid()) + ".yaml";
+
+		ofstream file(configFile_);
+		file << "cameras:\n";
+		for (const char *id : { "Virtual0", "Virtual1" })
+			file << "  - id: \"" << id << "\"\n"
+			     << "    size: [320, 240]\n"
+			     << "    frame_rate: 30\n"
+			     << "    test_pattern: false\n";
+		file.close();
+
+		setenv("LIBCAMERA_VIRTUAL_CONFIG_FILE", configFile_.c_str(), 1);
+
+		cm_ = make_unique<CameraManager>();
+		if (cm_->start()) {
+			cerr << "Failed to start camera manager" << endl;
+			return TestFail;
+		}
+
+		for (const char *id : { "Virtual0", "Virtual1" }) {
+			shared_ptr<Camera> camera = cm_->get(id);
+			if (!camera) {
+				cerr << "Can not find '" << id << "' camera" << endl;
+				return TestSkip;
+			}
+
+			cameras_.push_back(make_unique<GroupedCamera>(camera));
+			if (cameras_.back()->init())
+				return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		CameraGroup group;
+		Camera *camera0 = cameras_[0]->camera().get();
+		Camera *camera1 = cameras_[1]->camera().get();
+
+		/* Test group membership. */
+		if (group.addCamera(cameras_[0]->camera())) {
+			cerr << "Failed to add camera to the group" << endl;
+			return TestFail;
+		}
+
+		if (group.addCamera(cameras_[0]->camera()) != -EBUSY) {
+			cerr << "Camera added twice to the group" << endl;
+			return TestFail;
+		}
+
+		if (group.removeCamera(camera1) != -ENOENT) {
+			cerr << "Removed a camera not part of the group" << endl;
+			return TestFail;
+		}
+
+		if (group.addCamera(cameras_[1]->camera())) {
+			cerr << "Failed to add camera to the group" << endl;
+			return TestFail;
+		}
+
+		vector<shared_ptr<Camera>> members = group.cameras();
+		if (members.size() != 2 || members[0].get() != camera0 ||
+		    members[1].get() != camera1) {
+			cerr << "Invalid group cameras" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Start the cameras a few frames apart, for their sequence
+		 * numbers to be offset on the group timeline.
+		 */
+		if (cameras_[0]->start()) {
+			cerr << "Failed to start camera 0" << endl;
+			return TestFail;
+		}
+
+		wait(200ms);
+
+		if (cameras_[1]->start()) {
+			cerr << "Failed to start camera 1" << endl;
+			return TestFail;
+		}
+
+		wait(1000ms);
+
+		if (cameras_[0]->stop() || cameras_[1]->stop()) {
+			cerr << "Failed to stop cameras" << endl;
+			return TestFail;
+		}
+
+		return check();
+	}
+
+	void cleanup() override
+	{
+		cameras_.clear();
+		if (cm_)
+			cm_->stop();
+		unlink(configFile_.c_str());
+	}
+
+private:
+	void wait(std::chrono::milliseconds duration)
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timer;
+
+		timer.start(duration);
+		while (timer.isRunning())
+			dispatcher->processEvents();
+	}
+
+	int check()
+	{
+		const vector<Frame> &frames0 = cameras_[0]->frames();
+		const vector<Frame> &frames1 = cameras_[1]->frames();
+
+		if (frames0.size() < 10 || frames1.size() < 10) {
+			cerr << "Not enough synchronised frames (" << frames0.size()
+			     << ", " << frames1.size() << ")" << endl;
+			return TestFail;
+		}
+
+		/* The first camera to produce frames defines the timeline. */
+		if (cameras_[0]->unsynchronised()) {
+			cerr << "Reference camera frames not synchronised" << endl;
+			return TestFail;
+		}
+
+		for (const Frame &frame : frames0) {
+			if (frame.syncFrame != frame.sequence || frame.syncError) {
+				cerr << "Invalid reference frame " << frame.sequence
+				     << " sync " << frame.syncFrame << " error "
+				     << frame.syncError << endl;
+				return TestFail;
+			}
+		}
+
+		/*
+		 * The second camera started later, its frames are matched to
+		 * later frames of the timeline, within half a frame period.
+		 */
+		map<int64_t, int64_t> timestamps;
+		for (const Frame &frame : frames0)
+			timestamps[frame.syncFrame] = frame.timestamp;
+
+		int64_t previous = -1;
+		unsigned int matched = 0;
+
+		for (const Frame &frame : frames1) {
+			if (frame.syncFrame <= previous ||
+			    frame.syncFrame <= frame.sequence) {
+				cerr << "Invalid frame " << frame.sequence
+				     << " sync " << frame.syncFrame << endl;
+				return TestFail;
+			}
+
+			previous = frame.syncFrame;
+
+			/* Allow for the timer jitter of the virtual cameras. */
+			if (llabs(frame.syncError) > kFramePeriod * 3 / 4) {
+				cerr << "Sync error " << frame.syncError
+				     << " too large for frame " << frame.sequence << endl;
+				return TestFail;
+			}
+
+			auto it = timestamps.find(frame.syncFrame);
+			if (it == timestamps.end())
+				continue;
+
+			if (llabs(frame.timestamp - it->second) > kFramePeriod * 3 / 4) {
+				cerr << "Frames matched to " << frame.syncFrame
+				     << " captured " << frame.timestamp - it->second
+				     << " ns apart" << endl;
+				return TestFail;
+			}
+
+			matched++;
+		}
+
+		if (matched < 10) {
+			cerr << "Only " << matched << " frames matched" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	string configFile_;
+	unique_ptr<CameraManager> cm_;
+	vector<unique_ptr<GroupedCamera>> cameras_;
+};
+
+TEST_REGISTER(CameraGroupTest)
@@ -131,6 +131,24 @@ protected:
 			return TestFail;
 		}
 
+		/* Reprocessing requests are rejected when not supported. */
+		if (!camera_->supportsReprocessing()) {
+			Request *request = requests_.front().get();
+			FrameBuffer *buffer = request->buffers().begin()->second;
+
+			request->setReprocessBuffer(buffer);
+			if (camera_->queueRequest(request) != -EINVAL) {
+				cout << "Reprocessing request not rejected" << endl;
+				return TestFail;
+			}
+
+			request->reuse(Request::ReuseBuffers);
+			if (request->reprocessBuffer()) {
+				cout << "Reprocessing buffer not cleared" << endl;
+				return TestFail;
+			}
+		}
+
 		for (std::unique_ptr<Request> &request : requests_) {
 			if (camera_->queueRequest(request.get())) {
 				cout << "Failed to queue request" << endl;
@@ -165,6 +183,22 @@ protected:
 			return TestFail;
 		}
 
+		const CameraStatistics stats = camera_->statistics();
+		if (stats.requestsCompleted != completeRequestsCount_) {
+			cout << "Statistics report " << stats.requestsCompleted
+			     << " completed requests, expected "
+			     << completeRequestsCount_ << endl;
+			return TestFail;
+		}
+
+		const CameraStatistics::Latency &latency =
+			stats.stages[CameraStatistics::StageComplete];
+		if (latency.count != completeRequestsCount_ ||
+		    latency.min > latency.max) {
+			cout << "Invalid request completion latency statistics" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Test starting the camera manager with a subset of the pipeline handlers
+ */
+
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+
+#include <libcamera/camera_manager.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+class PipelineFilterTest : public Test
+{
+protected:
+	int init() override
+	{
+		/* The environment variable would override the filter. */
+		unsetenv("LIBCAMERA_PIPELINES_MATCH_LIST");
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		unique_ptr<CameraManager> cm = make_unique<CameraManager>();
+		if (cm->start()) {
+			cerr << "Failed to start camera manager" << endl;
+			return TestFail;
+		}
+
+		bool hasVimc = !!cm->get("platform/vimc.0 Sensor B");
+		cm.reset();
+
+		if (!hasVimc) {
+			cerr << "vimc camera not found" << endl;
+			return TestSkip;
+		}
+
+		/* Check that the cameras of unlisted pipeline handlers are absent. */
+		cm = make_unique<CameraManager>();
+		if (cm->start({ "nonexistent" })) {
+			cerr << "Failed to start camera manager with an unknown pipeline" << endl;
+			return TestFail;
+		}
+
+		if (!cm->cameras().empty()) {
+			cerr << "Cameras found with an unknown pipeline" << endl;
+			return TestFail;
+		}
+
+		cm.reset();
+
+		/* Check that the cameras of listed pipeline handlers are present. */
+		cm = make_unique<CameraManager>();
+		if (cm->start({ "nonexistent", "vimc" })) {
+			cerr << "Failed to start camera manager with the vimc pipeline" << endl;
+			return TestFail;
+		}
+
+		if (!cm->get("platform/vimc.0 Sensor B")) {
+			cerr << "vimc camera not found with the vimc pipeline" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(PipelineFilterTest)
@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Request benchmark
+ *
+ * Measure the cost of creating requests and of recycling them with
+ * Request::reuse(), with and without keeping the buffers associated with the
+ * request. Run with 'meson test --benchmark request_benchmark -v'.
+ */
+
+#include <iostream>
+#include <memory>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/framebuffer_allocator.h>
+#include <libcamera/request.h>
+
+#include "benchmark.h"
+#include "camera_test.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+namespace {
+
+class RequestBenchmark : public CameraTest, public Test
+{
+public:
+	RequestBenchmark()
+		: CameraTest("platform/vimc.0 Sensor B")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		config_ = camera_->generateConfiguration({ StreamRole::VideoRecording });
+		if (!config_ || config_->size() != 1) {
+			cout << "Failed to generate default configuration" << endl;
+			return TestFail;
+		}
+
+		if (camera_->acquire()) {
+			cout << "Failed to acquire the camera" << endl;
+			return TestFail;
+		}
+
+		if (camera_->configure(config_.get())) {
+			cout << "Failed to set default configuration" << endl;
+			return TestFail;
+		}
+
+		allocator_ = make_unique<FrameBufferAllocator>(camera_);
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		allocator_.reset();
+		camera_->release();
+	}
+
+	int run() override
+	{
+		Stream *stream = config_->at(0).stream();
+
+		if (allocator_->allocate(stream) < 0) {
+			cout << "Failed to allocate buffers" << endl;
+			return TestFail;
+		}
+
+		FrameBuffer *buffer = allocator_->buffers(stream).front().get();
+
+		table_.printHeader();
+
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			unique_ptr<Request> request = camera_->createRequest();
+			if (!request) {
+				cout << "Failed to create request" << endl;
+				return TestFail;
+			}
+		}
+		report("createRequest", Clock::now() - start);
+
+		unique_ptr<Request> request = camera_->createRequest();
+		if (request->addBuffer(stream, buffer)) {
+			cout << "Failed to associate buffer with request" << endl;
+			return TestFail;
+		}
+
+		/* Populate the controls as an application would for each frame. */
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			request->controls().set(controls::ExposureTime, 10000);
+			request->controls().set(controls::AnalogueGain, 2.0f);
+			request->reuse(Request::ReuseBuffers);
+		}
+		report("reuse, keep buffers", Clock::now() - start);
+
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			request->controls().set(controls::ExposureTime, 10000);
+			request->controls().set(controls::AnalogueGain, 2.0f);
+			request->reuse();
+			request->addBuffer(stream, buffer);
+		}
+		report("reuse, addBuffer", Clock::now() - start);
+
+		return TestPass;
+	}
+
+private:
+	void report(const char *operation, Clock::duration duration)
+	{
+		table_.printRow(operation, nsPerOperation(duration, kIterations));
+	}
+
+	static constexpr unsigned int kIterations = 100000;
+
+	const benchmark::Table table_{ { { "operation", 32 }, { "ns/op", 12 } } };
+
+	unique_ptr<CameraConfiguration> config_;
+	unique_ptr<FrameBufferAllocator> allocator_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(RequestBenchmark)
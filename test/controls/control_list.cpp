@@ -246,6 +246,30 @@ protected:
 			return TestFail;
 		}
 
+		/* Test that controls are iterated in numerical ID order. */
+		unsigned int prevId = 0;
+		for (const auto &[id, value] : mergeList) {
+			if (id <= prevId) {
+				cout << "Controls not sorted by numerical ID" << endl;
+				return TestFail;
+			}
+
+			prevId = id;
+		}
+
+		/*
+		 * Test that setting a control from the value of another control
+		 * stored in the same list doesn't use an invalidated reference.
+		 */
+		list.clear();
+		list.set(controls::Brightness, 0.5f);
+		list.set(controls::Contrast.id(), list.get(controls::Brightness.id()));
+
+		if (list.get(controls::Contrast) != 0.5f) {
+			cout << "Control set from list entry has wrong value" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 };
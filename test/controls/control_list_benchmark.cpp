@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * ControlList benchmark
+ *
+ * Measure the cost of setting, getting and merging the controls commonly
+ * found in requests and metadata, in lists validated against a ControlInfoMap
+ * and in lists without validation. Run with
+ * 'meson test --benchmark control_list_benchmark -v'.
+ */
+
+#include <iostream>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+
+#include "benchmark.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+namespace {
+
+/* The number of controls set by fill(). */
+constexpr unsigned int kNumControls = 8;
+
+void fill(ControlList &list, unsigned int i)
+{
+	list.set(controls::ExposureTime, 10000 + i);
+	list.set(controls::AnalogueGain, 1.0f + i % 8);
+	list.set(controls::AeEnable, i % 2 == 0);
+	list.set(controls::Brightness, 0.1f);
+	list.set(controls::Contrast, 1.2f);
+	list.set(controls::ColourGains, { 1.5f, 2.0f });
+	list.set(controls::FrameDurationLimits, { INT64_C(33333), INT64_C(33333) });
+	list.set(controls::ScalerCrop, Rectangle(0, 0, 1920, 1080));
+}
+
+} /* namespace */
+
+class ControlListBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		infoMap_ = ControlInfoMap({
+			{ &controls::ExposureTime, ControlInfo(1, 1000000) },
+			{ &controls::AnalogueGain, ControlInfo(1.0f, 16.0f) },
+			{ &controls::AeEnable, ControlInfo(false, true) },
+			{ &controls::Brightness, ControlInfo(-1.0f, 1.0f) },
+			{ &controls::Contrast, ControlInfo(0.0f, 2.0f) },
+			{ &controls::ColourGains, ControlInfo(0.0f, 8.0f) },
+			{ &controls::FrameDurationLimits, ControlInfo(INT64_C(33333), INT64_C(1000000)) },
+			{ &controls::ScalerCrop, ControlInfo(Rectangle(0, 0, 1, 1),
+							     Rectangle(0, 0, 1920, 1080)) },
+		}, controls::controls);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		table_.printHeader();
+
+		ControlList unvalidated(controls::controls);
+		benchmark("id map", unvalidated);
+
+		ControlList validated(infoMap_);
+		benchmark("info map", validated);
+
+		return TestPass;
+	}
+
+private:
+	void benchmark(const char *name, ControlList &list)
+	{
+		ControlList target = list;
+		int64_t sum = 0;
+
+		/* Warm up to include the steady state only. */
+		fill(list, 0);
+
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			fill(list, i);
+		Clock::duration setTime = Clock::now() - start;
+
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			sum += list.get(controls::ExposureTime).value_or(0);
+			sum += list.get(controls::AnalogueGain).value_or(0.0f);
+			sum += list.get(controls::AeEnable).value_or(false);
+			sum += list.get(controls::Brightness).value_or(0.0f);
+			sum += list.get(controls::Contrast).value_or(0.0f);
+			sum += list.get(controls::ColourGains).has_value();
+			sum += list.get(controls::FrameDurationLimits).has_value();
+			sum += list.get(controls::ScalerCrop).value_or(Rectangle{}).width;
+		}
+		Clock::duration getTime = Clock::now() - start;
+
+		/* Merge into an empty list, as done for request metadata. */
+		Clock::duration mergeTime{};
+		Clock::duration clearTime{};
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			start = Clock::now();
+			target.merge(list);
+			mergeTime += Clock::now() - start;
+
+			start = Clock::now();
+			target.clear();
+			clearTime += Clock::now() - start;
+		}
+
+		table_.printRow(name,
+				nsPerOperation(setTime, kIterations * kNumControls),
+				nsPerOperation(getTime, kIterations * kNumControls),
+				nsPerOperation(mergeTime, kIterations),
+				nsPerOperation(clearTime, kIterations));
+
+		/* Prevent the compiler from optimizing the gets out. */
+		if (!sum)
+			cout << "No control found" << endl;
+	}
+
+	static constexpr unsigned int kIterations = 100000;
+
+	const benchmark::Table table_{ {
+		{ "list", 24 }, { "set ns", 12 }, { "get ns", 12 },
+		{ "merge ns", 12 }, { "clear ns", 12 },
+	} };
+
+	ControlInfoMap infoMap_;
+};
+
+TEST_REGISTER(ControlListBenchmark)
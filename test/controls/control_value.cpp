@@ -6,6 +6,7 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <iostream>
 
 #include <libcamera/controls.h>
@@ -257,6 +258,49 @@ protected:
 			return TestFail;
 		}
 
+		/*
+		 * Inline storage. Arrays up to 56 bytes shall be stored in the
+		 * ControlValue instance, larger arrays in allocated memory.
+		 */
+		const std::array<float, 14> inlineFloats{};
+		value.set(Span<const float>(inlineFloats));
+		const uint8_t *begin = reinterpret_cast<const uint8_t *>(&value);
+		const uint8_t *end = begin + sizeof(value);
+		if (value.data().data() < begin || value.data().data() >= end) {
+			cerr << "Small control value not stored inline" << endl;
+			return TestFail;
+		}
+
+		const std::array<float, 15> largeFloats{};
+		value.set(Span<const float>(largeFloats));
+		if (value.data().data() >= begin && value.data().data() < end) {
+			cerr << "Large control value stored inline" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Move construction and assignment. Use a string that doesn't
+		 * fit in the inline storage to check that the storage is
+		 * transferred.
+		 */
+		string = "libcamera, a complex camera support library for Linux";
+		string += string;
+		value.set(string);
+		const uint8_t *data = value.data().data();
+		ControlValue moved(std::move(value));
+		if (!value.isNone() || moved.data().data() != data ||
+		    moved.get<std::string>() != string) {
+			cerr << "Control value mismatch after move construction" << endl;
+			return TestFail;
+		}
+
+		value = std::move(moved);
+		if (!moved.isNone() || value.data().data() != data ||
+		    value.get<std::string>() != string) {
+			cerr << "Control value mismatch after move assignment" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 };
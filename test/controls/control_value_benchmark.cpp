@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * ControlValue benchmark
+ *
+ * Measure the cost of setting and copying control values of the types
+ * commonly set on every request. Values that fit in the ControlValue inline
+ * storage are compared with a larger array that requires memory allocation.
+ * Run with 'meson test --benchmark control_value_benchmark -v'.
+ */
+
+#include <array>
+#include <iostream>
+#include <vector>
+
+#include <libcamera/base/span.h>
+
+#include <libcamera/controls.h>
+#include <libcamera/geometry.h>
+
+#include "benchmark.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+class ControlValueBenchmark : public Test
+{
+protected:
+	int run() override
+	{
+		table_.printHeader();
+
+		const std::array<float, 2> gains{ 1.5f, 2.0f };
+		benchmark("float[2]", Span<const float>(gains));
+
+		const std::array<int64_t, 2> durations{ 33333, 66666 };
+		benchmark("int64_t[2]", Span<const int64_t>(durations));
+
+		benchmark("Rectangle", Rectangle(0, 0, 1920, 1080));
+
+		const std::array<float, 9> ccm{ 1.5f, -0.3f, -0.2f,
+						-0.2f, 1.4f, -0.2f,
+						-0.1f, -0.4f, 1.5f };
+		benchmark("float[9]", Span<const float>(ccm));
+
+		const std::array<Rectangle, 3> windows{
+			Rectangle(0, 0, 640, 480),
+			Rectangle(640, 0, 640, 480),
+			Rectangle(1280, 0, 640, 480),
+		};
+		benchmark("Rectangle[3]", Span<const Rectangle>(windows));
+
+		/* A value larger than the inline storage, for comparison. */
+		const std::vector<float> lut(32, 1.0f);
+		benchmark("float[32]", Span<const float>(lut));
+
+		return TestPass;
+	}
+
+private:
+	template<typename T>
+	void benchmark(const char *name, const T &value)
+	{
+		/*
+		 * Keep the values alive until the end of the measurement to
+		 * account for the memory allocations without measuring their
+		 * release.
+		 */
+		vector<ControlValue> values(kIterations);
+
+		Clock::time_point start = Clock::now();
+		for (ControlValue &v : values)
+			v.set(value);
+		Clock::duration setTime = Clock::now() - start;
+
+		vector<ControlValue> copies;
+		copies.reserve(kIterations);
+
+		start = Clock::now();
+		for (const ControlValue &v : values)
+			copies.push_back(v);
+		Clock::duration copyTime = Clock::now() - start;
+
+		table_.printRow(name, values[0].data().size(),
+				nsPerOperation(setTime, kIterations),
+				nsPerOperation(copyTime, kIterations));
+	}
+
+	static constexpr unsigned int kIterations = 200000;
+
+	const benchmark::Table table_{ {
+		{ "value", 24 }, { "bytes", 8 }, { "set ns", 12 }, { "copy ns", 12 },
+	} };
+};
+
+TEST_REGISTER(ControlValueBenchmark)
@@ -6,6 +6,7 @@
  */
 
 #include <iostream>
+#include <map>
 
 #include "libcamera/internal/delayed_controls.h"
 #include "libcamera/internal/device_enumerator.h"
@@ -267,6 +268,180 @@ protected:
 		return TestPass;
 	}
 
+	int configurableDepth()
+	{
+		static const unsigned int maxDelay = 2;
+		static const unsigned int depth = 32;
+		static const unsigned int lookahead = 20;
+
+		std::unordered_map<uint32_t, DelayedControls::ControlParams> delays = {
+			{ V4L2_CID_CONTRAST, { maxDelay, false } },
+		};
+		std::unique_ptr<DelayedControls> delayed =
+			std::make_unique<DelayedControls>(dev_.get(), delays, depth);
+		ControlList ctrls;
+
+		if (delayed->depth() != depth || delayed->maxDelay() != maxDelay) {
+			cerr << "Invalid depth " << delayed->depth()
+			     << " or delay " << delayed->maxDelay() << endl;
+			return TestFail;
+		}
+
+		ctrls.set(V4L2_CID_CONTRAST, 100);
+		dev_->setControls(&ctrls);
+		delayed->reset();
+
+		delayed->applyControls(0);
+
+		/*
+		 * Queue more controls ahead than the default queue depth, and
+		 * record the frame each of them is expected to take effect for.
+		 */
+		std::map<uint32_t, int32_t> expected;
+		for (unsigned int i = 0; i < lookahead; i++) {
+			int32_t value = 10 + i;
+
+			expected[delayed->nextSequence()] = value;
+
+			ctrls.set(V4L2_CID_CONTRAST, value);
+			delayed->push(ctrls);
+		}
+
+		for (unsigned int i = 1; i <= lookahead; i++)
+			delayed->applyControls(i);
+
+		for (const auto &[sequence, value] : expected) {
+			ControlList result = delayed->get(sequence);
+			int32_t contrast = result.get(V4L2_CID_CONTRAST).get<int32_t>();
+			if (contrast != value) {
+				cerr << "Failed lookahead"
+				     << " frame " << sequence
+				     << " expected " << value
+				     << " got " << contrast
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int cookies()
+	{
+		static const unsigned int delay = 2;
+		std::unordered_map<uint32_t, DelayedControls::ControlParams> delays = {
+			{ V4L2_CID_CONTRAST, { delay, false } },
+		};
+		std::unique_ptr<DelayedControls> delayed =
+			std::make_unique<DelayedControls>(dev_.get(), delays);
+		ControlList ctrls;
+
+		/*
+		 * Use the control value as the cookie, the cookie reported for a
+		 * frame must then match the control value in effect.
+		 */
+		ctrls.set(V4L2_CID_CONTRAST, 100);
+		dev_->setControls(&ctrls);
+		delayed->reset(100);
+
+		for (unsigned int i = 0; i < 16; i++) {
+			/* Skip pushes on some frames to test cookie propagation. */
+			if (i < 10 && i % 3 != 2) {
+				int32_t value = 10 + i;
+
+				ctrls.set(V4L2_CID_CONTRAST, value);
+				delayed->push(ctrls, value);
+			}
+
+			delayed->applyControls(i);
+
+			unsigned int cookie;
+			ControlList result = delayed->get(i, &cookie);
+			int32_t contrast = result.get(V4L2_CID_CONTRAST).get<int32_t>();
+			if (static_cast<unsigned int>(contrast) != cookie) {
+				cerr << "Failed cookie"
+				     << " frame " << i
+				     << " expected " << contrast
+				     << " got " << cookie
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int skipTo()
+	{
+		static const unsigned int delay = 2;
+		static const unsigned int skip = 3;
+		std::unordered_map<uint32_t, DelayedControls::ControlParams> delays = {
+			{ V4L2_CID_CONTRAST, { delay, false } },
+		};
+		std::unique_ptr<DelayedControls> delayed =
+			std::make_unique<DelayedControls>(dev_.get(), delays);
+		ControlList ctrls;
+
+		ctrls.set(V4L2_CID_CONTRAST, 100);
+		dev_->setControls(&ctrls);
+		delayed->reset();
+
+		delayed->applyControls(0);
+
+		uint32_t first = delayed->nextSequence();
+		ctrls.set(V4L2_CID_CONTRAST, 10);
+		delayed->push(ctrls);
+
+		/* Delay the next controls by a few frames. */
+		uint32_t target = delayed->nextSequence() + skip;
+		delayed->skipTo(target);
+		if (delayed->nextSequence() != target) {
+			cerr << "Failed to skip to frame " << target
+			     << ", next frame is " << delayed->nextSequence()
+			     << endl;
+			return TestFail;
+		}
+
+		/* Skipping to an earlier frame has no effect. */
+		delayed->skipTo(target - 1);
+		if (delayed->nextSequence() != target) {
+			cerr << "Skipping backwards changed the next frame" << endl;
+			return TestFail;
+		}
+
+		ctrls.set(V4L2_CID_CONTRAST, 20);
+		delayed->push(ctrls);
+
+		/*
+		 * The skipped frames keep the previous value, and the controls
+		 * pushed after skipping take effect for the target frame.
+		 */
+		for (uint32_t i = 1; i <= target; i++) {
+			delayed->applyControls(i);
+
+			ControlList result = delayed->get(i);
+			int32_t contrast = result.get(V4L2_CID_CONTRAST).get<int32_t>();
+			int32_t expected = i < first ? 100 : i < target ? 10 : 20;
+			if (contrast != expected) {
+				cerr << "Failed skip"
+				     << " frame " << i
+				     << " expected " << expected
+				     << " got " << contrast
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		/* The number of skipped frames is limited by the queue depth. */
+		delayed->skipTo(target + 1000);
+		if (delayed->nextSequence() >= target + 1000) {
+			cerr << "Skipped beyond the queue depth" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
 	int run() override
 	{
 		int ret;
@@ -291,6 +466,21 @@ protected:
 		if (ret)
 			return ret;
 
+		/* Test queuing controls ahead with a custom queue depth. */
+		ret = configurableDepth();
+		if (ret)
+			return ret;
+
+		/* Test cookies associated with controls. */
+		ret = cookies();
+		if (ret)
+			return ret;
+
+		/* Test delaying controls to align multiple cameras. */
+		ret = skipTo();
+		if (ret)
+			return ret;
+
 		return TestPass;
 	}
 
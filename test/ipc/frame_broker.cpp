@@ -0,0 +1,223 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * FrameBroker test
+ */
+
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "libcamera/internal/frame_broker.h"
+#include "libcamera/internal/framebuffer.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+class Consumer
+{
+public:
+	Consumer()
+		: received_(0)
+	{
+		client_.frameReady.connect(this, &Consumer::frameReady);
+	}
+
+	FrameBrokerClient &client() { return client_; }
+	const FrameBrokerClient::Frame &frame() const { return frame_; }
+	unsigned int received() const { return received_; }
+
+private:
+	void frameReady(const FrameBrokerClient::Frame &frame)
+	{
+		frame_ = frame;
+		received_++;
+	}
+
+	FrameBrokerClient client_;
+	FrameBrokerClient::Frame frame_;
+	unsigned int received_;
+};
+
+class FrameBrokerTest : public Test
+{
+protected:
+	int init()
+	{
+		path_ = "/tmp/libcamera-frame-broker-test-" + to_string(getpid());
+
+		UniqueFD fd(memfd_create("frame-broker-test", MFD_CLOEXEC));
+		if (!fd.isValid() || ftruncate(fd.get(), 8192) < 0) {
+			cerr << "Failed to create memfd" << endl;
+			return TestFail;
+		}
+
+		/* Two planes sharing the same dmabuf. */
+		SharedFD shared(std::move(fd));
+		vector<FrameBuffer::Plane> planes(2);
+		planes[0] = { shared, 0, 4096 };
+		planes[1] = { shared, 4096, 4096 };
+
+		buffer_ = make_unique<FrameBuffer>(planes);
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		released_ = 0;
+		broker_.bufferReleased.connect(this, &FrameBrokerTest::bufferReleased);
+
+		int ret = broker_.listen(path_);
+		if (ret) {
+			cerr << "Failed to listen: " << ret << endl;
+			return TestFail;
+		}
+
+		Consumer consumers[2];
+		for (Consumer &consumer : consumers) {
+			if (consumer.client().connect(path_)) {
+				cerr << "Failed to connect" << endl;
+				return TestFail;
+			}
+		}
+
+		wait([&]() { return broker_.consumers() == 2; });
+		if (broker_.consumers() != 2) {
+			cerr << "Consumers not accepted" << endl;
+			return TestFail;
+		}
+
+		/* Share the buffer with both consumers, passing the planes. */
+		FrameMetadata &metadata = buffer_->_d()->metadata();
+		metadata.sequence = 42;
+		metadata.timestamp = 1234567;
+		metadata.planes()[0].bytesused = 4000;
+		metadata.planes()[1].bytesused = 2000;
+
+		if (broker_.publish(buffer_.get()) != 2) {
+			cerr << "Failed to publish buffer" << endl;
+			return TestFail;
+		}
+
+		if (broker_.publish(buffer_.get()) != -EBUSY) {
+			cerr << "Published a referenced buffer" << endl;
+			return TestFail;
+		}
+
+		wait([&]() {
+			return consumers[0].received() == 1 &&
+			       consumers[1].received() == 1;
+		});
+
+		for (Consumer &consumer : consumers) {
+			const FrameBrokerClient::Frame &frame = consumer.frame();
+			if (consumer.received() != 1 || frame.sequence != 42 ||
+			    frame.timestamp != 1234567 || frame.planes.size() != 2 ||
+			    !frame.planes[0].fd.isValid() ||
+			    frame.planes[0].fd.get() != frame.planes[1].fd.get() ||
+			    frame.planes[1].offset != 4096 ||
+			    frame.bytesused[0] != 4000 || frame.bytesused[1] != 2000) {
+				cerr << "Invalid frame received" << endl;
+				return TestFail;
+			}
+		}
+
+		/* The buffer is released when the last consumer releases it. */
+		uint32_t id = consumers[0].frame().id;
+		consumers[0].client().release(id);
+		wait([&]() { return false; }, 50ms);
+		if (released_) {
+			cerr << "Buffer released while referenced" << endl;
+			return TestFail;
+		}
+
+		consumers[1].client().release(id);
+		wait([&]() { return released_ == 1; });
+		if (released_ != 1) {
+			cerr << "Buffer not released" << endl;
+			return TestFail;
+		}
+
+		/* Publish again, the consumers use their cached planes. */
+		metadata.sequence = 43;
+		if (broker_.publish(buffer_.get()) != 2) {
+			cerr << "Failed to publish buffer again" << endl;
+			return TestFail;
+		}
+
+		wait([&]() {
+			return consumers[0].received() == 2 &&
+			       consumers[1].received() == 2;
+		});
+
+		for (Consumer &consumer : consumers) {
+			const FrameBrokerClient::Frame &frame = consumer.frame();
+			if (consumer.received() != 2 || frame.sequence != 43 ||
+			    frame.id != id || !frame.planes[0].fd.isValid()) {
+				cerr << "Invalid cached frame received" << endl;
+				return TestFail;
+			}
+		}
+
+		/* Disconnecting consumers drops their references. */
+		consumers[0].client().release(id);
+		consumers[1].client().close();
+
+		wait([&]() { return released_ == 2; });
+		if (released_ != 2 || broker_.consumers() != 1) {
+			cerr << "Buffer not released on disconnection" << endl;
+			return TestFail;
+		}
+
+		if (broker_.removeBuffer(buffer_.get())) {
+			cerr << "Failed to remove buffer" << endl;
+			return TestFail;
+		}
+
+		broker_.close();
+
+		return TestPass;
+	}
+
+	void cleanup()
+	{
+		broker_.close();
+	}
+
+private:
+	template<typename Func>
+	void wait(Func done, std::chrono::milliseconds duration = 1000ms)
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timeout;
+
+		timeout.start(duration);
+		while (!done() && timeout.isRunning())
+			dispatcher->processEvents();
+	}
+
+	void bufferReleased(FrameBuffer *buffer)
+	{
+		if (buffer == buffer_.get())
+			released_++;
+	}
+
+	string path_;
+	FrameBroker broker_;
+	unique_ptr<FrameBuffer> buffer_;
+	unsigned int released_;
+};
+
+TEST_REGISTER(FrameBrokerTest)
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -34,10 +35,17 @@ enum {
 	CmdExit = 0,
 	CmdGetSync = 1,
 	CmdSetAsync = 2,
+	CmdSetFdAsync = 3,
+	CmdGetLargeSync = 4,
+	CmdBatchAsync = 5,
 };
 
 const int32_t kInitialValue = 1337;
 const int32_t kChangedValue = 9001;
+const int32_t kFdValue = 42;
+
+/* Larger than the shared memory rings, to be transported over the socket */
+const size_t kLargeSize = 96 * 1024;
 
 class UnixSocketTestIPCSlave
 {
@@ -77,7 +85,13 @@ private:
 		}
 
 		IPCMessage ipcMessage(message);
+		processMessage(ipcMessage);
+	}
+
+	void processMessage(const IPCMessage &ipcMessage)
+	{
 		uint32_t cmd = ipcMessage.header().cmd;
+		int ret;
 
 		switch (cmd) {
 		case CmdExit: {
@@ -105,6 +119,46 @@ private:
 			value_ = IPADataSerializer<int32_t>::deserialize(ipcMessage.data());
 			break;
 		}
+
+		case CmdSetFdAsync: {
+			if (ipcMessage.fds().size() != 1 ||
+			    !ipcMessage.fds()[0].isValid()) {
+				cerr << "File descriptor not received" << endl;
+				stop(EXIT_FAILURE);
+				break;
+			}
+
+			value_ = IPADataSerializer<int32_t>::deserialize(ipcMessage.data());
+			break;
+		}
+
+		case CmdBatchAsync: {
+			vector<IPCMessage> messages;
+			if (ipcMessage.unbatch(&messages) < 0) {
+				cerr << "Invalid batch message" << endl;
+				stop(EXIT_FAILURE);
+				break;
+			}
+
+			for (const IPCMessage &msg : messages)
+				processMessage(msg);
+			break;
+		}
+
+		case CmdGetLargeSync: {
+			IPCMessage::Header header = { cmd, ipcMessage.header().cookie };
+			IPCMessage response(header);
+
+			response.data().resize(kLargeSize);
+			memcpy(response.data().data(), &value_, sizeof(value_));
+
+			ret = ipc_.send(response.payload());
+			if (ret < 0) {
+				cerr << "Reply failed" << endl;
+				stop(ret);
+			}
+			break;
+		}
 		}
 	}
 
@@ -158,6 +212,65 @@ protected:
 		return IPADataSerializer<int32_t>::deserialize(buf.data());
 	}
 
+	int setValueWithFd(int32_t val)
+	{
+		IPCMessage msg(CmdSetFdAsync);
+		tie(msg.data(), ignore) = IPADataSerializer<int32_t>::serialize(val);
+		msg.fds().push_back(SharedFD(UniqueFD(open("/dev/null", O_RDONLY))));
+
+		int ret = ipc_->sendAsync(msg);
+		if (ret < 0) {
+			cerr << "Failed to call set value with fd" << endl;
+			return ret;
+		}
+
+		return 0;
+	}
+
+	int getLargeValue()
+	{
+		IPCMessage msg(CmdGetLargeSync);
+		IPCMessage buf;
+
+		int ret = ipc_->sendSync(msg, &buf);
+		if (ret < 0) {
+			cerr << "Failed to call get large value" << endl;
+			return ret;
+		}
+
+		if (buf.data().size() != kLargeSize) {
+			cerr << "Wrong large reply size " << buf.data().size() << endl;
+			return -EINVAL;
+		}
+
+		int32_t value;
+		memcpy(&value, buf.data().data(), sizeof(value));
+		return value;
+	}
+
+	int setValueBatched(int32_t val)
+	{
+		vector<IPCMessage> messages;
+
+		/* The last message of the batch sets the value. */
+		for (int32_t value : { kInitialValue, val }) {
+			IPCMessage &msg = messages.emplace_back(CmdSetAsync);
+			tie(msg.data(), ignore) = IPADataSerializer<int32_t>::serialize(value);
+		}
+
+		IPCMessage &msg = messages.emplace_back(CmdSetFdAsync);
+		tie(msg.data(), ignore) = IPADataSerializer<int32_t>::serialize(val);
+		msg.fds().push_back(SharedFD(UniqueFD(open("/dev/null", O_RDONLY))));
+
+		int ret = ipc_->sendAsync(IPCMessage::batch({ CmdBatchAsync, 0 }, messages));
+		if (ret < 0) {
+			cerr << "Failed to call batched set value" << endl;
+			return ret;
+		}
+
+		return 0;
+	}
+
 	int exit()
 	{
 		IPCMessage msg(CmdExit);
@@ -199,6 +312,50 @@ protected:
 			return TestFail;
 		}
 
+		/*
+		 * Messages carrying file descriptors and messages larger than
+		 * the shared memory rings are transported over the socket,
+		 * make sure they're ordered with the other messages.
+		 */
+		ret = setValueWithFd(kFdValue);
+		if (ret < 0) {
+			cerr << "Failed to set value with fd: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		ret = getValue();
+		if (ret != kFdValue) {
+			cerr << "Wrong value set with fd, expected " << kFdValue
+			     << ", got " << ret << endl;
+			return TestFail;
+		}
+
+		ret = setValue(kChangedValue);
+		if (ret < 0) {
+			cerr << "Failed to set value: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		ret = getLargeValue();
+		if (ret != kChangedValue) {
+			cerr << "Wrong large value, expected " << kChangedValue
+			     << ", got " << ret << endl;
+			return TestFail;
+		}
+
+		ret = setValueBatched(kInitialValue + 1);
+		if (ret < 0) {
+			cerr << "Failed to set batched value: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		ret = getValue();
+		if (ret != kInitialValue + 1) {
+			cerr << "Wrong batched value, expected " << kInitialValue + 1
+			     << ", got " << ret << endl;
+			return TestFail;
+		}
+
 		ret = exit();
 		if (ret < 0) {
 			cerr << "Failed to exit: " << strerror(-ret) << endl;
@@ -0,0 +1,34 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Helpers to time operations and report benchmark results
+ */
+
+#include "benchmark.h"
+
+namespace benchmark {
+
+/* Compute the average duration of an operation, in nanoseconds. */
+double nsPerOperation(Clock::duration duration, unsigned int operations)
+{
+	return std::chrono::duration<double, std::nano>(duration).count() / operations;
+}
+
+Table::Table(std::vector<Column> columns, unsigned int precision)
+	: columns_(std::move(columns)), precision_(precision)
+{
+}
+
+void Table::printHeader() const
+{
+	std::cout << std::left << std::setw(columns_[0].width) << columns_[0].name
+		  << std::right;
+
+	for (unsigned int i = 1; i < columns_.size(); i++)
+		std::cout << std::setw(columns_[i].width) << columns_[i].name;
+
+	std::cout << std::endl;
+}
+
+} /* namespace benchmark */
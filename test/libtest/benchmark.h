@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Helpers to time operations and report benchmark results
+ */
+
+#pragma once
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace benchmark {
+
+using Clock = std::chrono::steady_clock;
+
+double nsPerOperation(Clock::duration duration, unsigned int operations);
+
+/*
+ * Print benchmark results as a table. The first column holds the row name and
+ * is left-aligned, the other columns are right-aligned. Floating point values
+ * are printed with a fixed precision.
+ */
+class Table
+{
+public:
+	struct Column {
+		std::string name;
+		unsigned int width;
+	};
+
+	Table(std::vector<Column> columns, unsigned int precision = 1);
+
+	void printHeader() const;
+
+	template<typename... Values>
+	void printRow(const std::string &name, Values... values) const
+	{
+		std::cout << std::left << std::setw(columns_[0].width) << name
+			  << std::right;
+
+		unsigned int column = 1;
+		(printValue(column++, values), ...);
+
+		std::cout << std::endl;
+	}
+
+private:
+	template<typename T>
+	void printValue(unsigned int column, T value) const
+	{
+		unsigned int width = column < columns_.size()
+				   ? columns_[column].width : 0;
+
+		if constexpr (std::is_floating_point_v<T>)
+			std::cout << std::fixed << std::setprecision(precision_);
+
+		std::cout << std::setw(width) << value;
+	}
+
+	std::vector<Column> columns_;
+	unsigned int precision_;
+};
+
+} /* namespace benchmark */
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Asynchronous logging test
+ */
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/logging.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+LOG_DEFINE_CATEGORY(LogAsyncTest)
+
+class LogAsyncTest : public Test
+{
+protected:
+	int init() override
+	{
+		if (!getenv("LIBCAMERA_LOG_ASYNC")) {
+			cout << "Asynchronous logging not enabled" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		static constexpr unsigned int kThreads = 4;
+		static constexpr unsigned int kMessages = 5000;
+
+		stringstream log;
+		logSetStream(&log);
+		logSetLevel("LogAsyncTest", "DEBUG");
+
+		/* Pad the messages to overflow the ring buffers occasionally. */
+		const string padding(200, '-');
+		vector<thread> threads;
+
+		for (unsigned int i = 0; i < kThreads; i++) {
+			threads.emplace_back([&, i]() {
+				for (unsigned int j = 0; j < kMessages; j++)
+					LOG(LogAsyncTest, Info)
+						<< padding << " " << i << " " << j;
+			});
+		}
+
+		for (thread &t : threads)
+			t.join();
+
+		/* Releasing the output writes all pending messages. */
+		logSetTarget(LoggingTargetNone);
+
+		map<unsigned int, int> last;
+		unsigned int received = 0;
+		unsigned int dropped = 0;
+		string line;
+
+		while (getline(log, line)) {
+			unsigned int count;
+			if (sscanf(line.c_str(), "%u log messages dropped", &count) == 1) {
+				dropped += count;
+				continue;
+			}
+
+			size_t pos = line.find(padding);
+			if (pos == string::npos) {
+				cout << "Unexpected log line: " << line << endl;
+				return TestFail;
+			}
+
+			unsigned int thread, message;
+			istringstream(line.substr(pos + padding.size())) >> thread >> message;
+
+			/* Messages from each thread shall be written in order. */
+			auto iter = last.find(thread);
+			if (iter != last.end() && static_cast<int>(message) <= iter->second) {
+				cout << "Message " << message << " of thread " << thread
+				     << " out of order" << endl;
+				return TestFail;
+			}
+
+			last[thread] = message;
+			received++;
+		}
+
+		if (received + dropped != kThreads * kMessages) {
+			cout << "Expected " << kThreads * kMessages << " messages, got "
+			     << received << " and " << dropped << " dropped" << endl;
+			return TestFail;
+		}
+
+		cout << received << " messages written, " << dropped << " dropped"
+		     << endl;
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(LogAsyncTest)
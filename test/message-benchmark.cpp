@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Message queue benchmark
+ *
+ * Measure the cost of posting messages from multiple threads to an object
+ * bound to another thread, and of dispatching them, and compare it with a
+ * message queue stored in a std::list protected by a mutex. The dispatch time
+ * of the thread message queue includes starting the thread and running its
+ * event loop. Run with 'meson test --benchmark message-benchmark -v'.
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/message.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/object.h>
+#include <libcamera/base/thread.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+class CountingReceiver : public Object
+{
+public:
+	void reset(unsigned int expected)
+	{
+		count_ = 0;
+		expected_ = expected;
+	}
+
+	void receive()
+	{
+		if (++count_ == expected_ && thread()->isRunning())
+			thread()->exit(0);
+	}
+
+protected:
+	void message(Message *msg) override
+	{
+		if (msg->type() != Message::None) {
+			Object::message(msg);
+			return;
+		}
+
+		receive();
+	}
+
+private:
+	unsigned int count_ = 0;
+	unsigned int expected_ = 0;
+};
+
+/*
+ * The message queue implementation used by Thread before becoming lock-free,
+ * including the accounting of the pending messages of the receiver.
+ */
+class LockedMessageQueue
+{
+public:
+	void post(std::unique_ptr<Message> msg)
+	{
+		MutexLocker locker(mutex_);
+		list_.push_back(std::move(msg));
+		pendingMessages_++;
+	}
+
+	void dispatch(CountingReceiver *receiver)
+	{
+		MutexLocker locker(mutex_);
+
+		for (std::unique_ptr<Message> &msg : list_) {
+			if (!msg)
+				continue;
+
+			std::unique_ptr<Message> message = std::move(msg);
+			pendingMessages_--;
+
+			locker.unlock();
+			receiver->receive();
+			message.reset();
+			locker.lock();
+		}
+
+		for (auto iter = list_.begin(); iter != list_.end(); ) {
+			if (!*iter)
+				iter = list_.erase(iter);
+			else
+				++iter;
+		}
+	}
+
+private:
+	Mutex mutex_;
+	std::list<std::unique_ptr<Message>> list_;
+	unsigned int pendingMessages_ = 0;
+};
+
+double nsPerMessage(Clock::duration duration, unsigned int messages)
+{
+	return chrono::duration<double, nano>(duration).count() / messages;
+}
+
+} /* namespace */
+
+class MessageBenchmark : public Test
+{
+protected:
+	int run() override
+	{
+		cout << left << setw(12) << "queue" << setw(11) << "producers"
+		     << right << setw(14) << "post ns/msg" << setw(18)
+		     << "dispatch ns/msg" << endl;
+
+		for (unsigned int producers : { 1, 2, 4 }) {
+			int ret = benchmarkThread(producers);
+			if (ret != TestPass)
+				return ret;
+
+			benchmarkLocked(producers);
+		}
+
+		return TestPass;
+	}
+
+private:
+	/*
+	 * Post kMessages messages from each producer thread. The messages are
+	 * allocated beforehand to measure the cost of the queue only.
+	 */
+	template<typename Post>
+	Clock::duration post(unsigned int producers, Post &&postMessage)
+	{
+		vector<vector<std::unique_ptr<Message>>> messages(producers);
+		vector<thread> threads;
+
+		for (auto &list : messages) {
+			for (unsigned int j = 0; j < kMessages; j++)
+				list.push_back(std::make_unique<Message>(Message::None));
+		}
+
+		Clock::time_point start = Clock::now();
+
+		for (auto &list : messages) {
+			threads.emplace_back([&]() {
+				for (std::unique_ptr<Message> &msg : list)
+					postMessage(std::move(msg));
+			});
+		}
+
+		for (thread &t : threads)
+			t.join();
+
+		return Clock::now() - start;
+	}
+
+	void report(const char *queue, unsigned int producers,
+		    Clock::duration postTime, Clock::duration dispatchTime)
+	{
+		const unsigned int messages = producers * kMessages;
+
+		cout << left << setw(12) << queue << setw(11) << producers
+		     << right << fixed << setprecision(1)
+		     << setw(14) << nsPerMessage(postTime, messages)
+		     << setw(18) << nsPerMessage(dispatchTime, messages) << endl;
+	}
+
+	/*
+	 * Post the messages while the receiver's thread is stopped, to measure
+	 * the queue alone without waking up the event loop for each message,
+	 * and dispatch them when starting the thread.
+	 */
+	int benchmarkThread(unsigned int producers)
+	{
+		Thread thread;
+		CountingReceiver receiver;
+
+		receiver.moveToThread(&thread);
+		receiver.reset(producers * kMessages);
+
+		Clock::duration postTime = post(producers, [&](std::unique_ptr<Message> msg) {
+			receiver.postMessage(std::move(msg));
+		});
+
+		Clock::time_point start = Clock::now();
+		thread.start();
+		bool finished = thread.wait(chrono::seconds(10));
+		Clock::duration dispatchTime = Clock::now() - start;
+
+		if (!finished) {
+			cerr << "Failed to dispatch all messages" << endl;
+			thread.exit();
+			thread.wait();
+			return TestFail;
+		}
+
+		report("lock-free", producers, postTime, dispatchTime);
+
+		return TestPass;
+	}
+
+	void benchmarkLocked(unsigned int producers)
+	{
+		LockedMessageQueue queue;
+		CountingReceiver receiver;
+
+		receiver.reset(producers * kMessages);
+
+		Clock::duration postTime = post(producers, [&](std::unique_ptr<Message> msg) {
+			queue.post(std::move(msg));
+		});
+
+		Clock::time_point start = Clock::now();
+		queue.dispatch(&receiver);
+		Clock::duration dispatchTime = Clock::now() - start;
+
+		report("locked-list", producers, postTime, dispatchTime);
+	}
+
+	static constexpr unsigned int kMessages = 200000;
+};
+
+TEST_REGISTER(MessageBenchmark)
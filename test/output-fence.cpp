@@ -0,0 +1,171 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Output fence test
+ */
+
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include <libcamera/fence.h>
+#include <libcamera/framebuffer_allocator.h>
+
+#include "camera_test.h"
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+class OutputFenceTest : public CameraTest, public Test
+{
+public:
+	OutputFenceTest()
+		: CameraTest("platform/vimc.0 Sensor B")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		config_ = camera_->generateConfiguration({ StreamRole::Viewfinder });
+		if (!config_ || config_->size() != 1) {
+			cerr << "Failed to generate default configuration" << endl;
+			return TestFail;
+		}
+
+		if (camera_->acquire()) {
+			cerr << "Failed to acquire the camera" << endl;
+			return TestFail;
+		}
+
+		if (camera_->configure(config_.get())) {
+			cerr << "Failed to set default configuration" << endl;
+			return TestFail;
+		}
+
+		stream_ = config_->at(0).stream();
+
+		allocator_ = make_unique<FrameBufferAllocator>(camera_);
+		if (allocator_->allocate(stream_) < 0) {
+			cerr << "Failed to allocate buffers" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		for (const unique_ptr<FrameBuffer> &buffer : allocator_->buffers(stream_)) {
+			unique_ptr<Request> request = camera_->createRequest();
+			if (!request || request->addBuffer(stream_, buffer.get())) {
+				cerr << "Failed to create request" << endl;
+				return TestFail;
+			}
+
+			unique_ptr<Fence> fence = request->exportFence(stream_);
+			if (!fence || !fence->isValid()) {
+				cerr << "Failed to export output fence" << endl;
+				return TestFail;
+			}
+
+			if (signalled(*fence)) {
+				cerr << "Output fence signalled before completion" << endl;
+				return TestFail;
+			}
+
+			fences_.push_back(std::move(fence));
+			requests_.push_back(std::move(request));
+		}
+
+		completed_ = 0;
+		unsignalled_ = 0;
+		camera_->bufferCompleted.connect(this, &OutputFenceTest::bufferComplete);
+
+		if (camera_->start()) {
+			cerr << "Failed to start camera" << endl;
+			return TestFail;
+		}
+
+		for (unique_ptr<Request> &request : requests_) {
+			if (camera_->queueRequest(request.get())) {
+				cerr << "Failed to queue request" << endl;
+				return TestFail;
+			}
+		}
+
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timer;
+		timer.start(500ms * requests_.size());
+		while (timer.isRunning() && completed_ < requests_.size())
+			dispatcher->processEvents();
+
+		camera_->bufferCompleted.disconnect(this);
+
+		if (camera_->stop()) {
+			cerr << "Failed to stop camera" << endl;
+			return TestFail;
+		}
+
+		if (completed_ != requests_.size()) {
+			cerr << "Only " << completed_ << " of " << requests_.size()
+			     << " buffers completed" << endl;
+			return TestFail;
+		}
+
+		/* The fences must be signalled by the time slots are called. */
+		if (unsignalled_) {
+			cerr << unsignalled_ << " output fences not signalled in "
+			     << "bufferCompleted" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	static bool signalled(const Fence &fence)
+	{
+		struct pollfd fds = { fence.fd().get(), POLLIN, 0 };
+		return poll(&fds, 1, 0) == 1 && (fds.revents & POLLIN);
+	}
+
+	void bufferComplete([[maybe_unused]] Request *request, FrameBuffer *buffer)
+	{
+		const vector<unique_ptr<FrameBuffer>> &buffers =
+			allocator_->buffers(stream_);
+
+		for (unsigned int i = 0; i < buffers.size(); i++) {
+			if (buffers[i].get() != buffer)
+				continue;
+
+			if (!signalled(*fences_[i]))
+				unsignalled_++;
+			completed_++;
+			break;
+		}
+	}
+
+	unique_ptr<CameraConfiguration> config_;
+	unique_ptr<FrameBufferAllocator> allocator_;
+	Stream *stream_;
+
+	vector<unique_ptr<Request>> requests_;
+	vector<unique_ptr<Fence>> fences_;
+
+	unsigned int completed_;
+	unsigned int unsignalled_;
+};
+
+TEST_REGISTER(OutputFenceTest)
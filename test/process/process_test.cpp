@@ -5,6 +5,7 @@
  * Process test
  */
 
+#include <fcntl.h>
 #include <iostream>
 #include <unistd.h>
 #include <vector>
@@ -12,6 +13,7 @@
 #include <libcamera/base/event_dispatcher.h>
 #include <libcamera/base/thread.h>
 #include <libcamera/base/timer.h>
+#include <libcamera/base/unique_fd.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/process.h"
@@ -25,10 +27,14 @@ using namespace std::chrono_literals;
 class ProcessTestChild
 {
 public:
-	int run(int status)
+	int run(int status, int keptFd, int closedFd)
 	{
 		usleep(50000);
 
+		/* Check that only the requested file descriptors are inherited. */
+		if (fcntl(keptFd, F_GETFD) < 0 || fcntl(closedFd, F_GETFD) >= 0)
+			return EXIT_FAILURE;
+
 		return status;
 	}
 };
@@ -48,15 +54,26 @@ protected:
 		Timer timeout;
 
 		int exitCode = 42;
+		UniqueFD keptFd(open("/dev/null", O_RDONLY));
+		UniqueFD closedFd(open("/dev/null", O_RDONLY));
 		vector<std::string> args;
 		args.push_back(to_string(exitCode));
+		args.push_back(to_string(keptFd.get()));
+		args.push_back(to_string(closedFd.get()));
 		proc_.finished.connect(this, &ProcessTest::procFinished);
 
 		/* Test that kill() on an unstarted process is safe. */
 		proc_.kill();
 
+		/* Test that a failure to execute the process is reported. */
+		int ret = proc_.start("/nonexistent/executable", args);
+		if (ret != -ENOENT) {
+			cerr << "failure to execute process not reported" << endl;
+			return TestFail;
+		}
+
 		/* Test starting the process and retrieving the exit code. */
-		int ret = proc_.start(self(), args);
+		ret = proc_.start(self(), args, { keptFd.get() });
 		if (ret) {
 			cerr << "failed to start process" << endl;
 			return TestFail;
@@ -100,10 +117,10 @@ private:
  */
 int main(int argc, char **argv)
 {
-	if (argc == 2) {
+	if (argc == 4) {
 		int status = std::stoi(argv[1]);
 		ProcessTestChild child;
-		return child.run(status);
+		return child.run(status, std::stoi(argv[2]), std::stoi(argv[3]));
 	}
 
 	ProcessTest test;
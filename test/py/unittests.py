@@ -4,8 +4,10 @@
 # Copyright (C) 2022, Tomi Valkeinen <tomi.valkeinen@ideasonboard.com>
 
 from collections import defaultdict
+import asyncio
 import gc
 import libcamera as libcam
+import libcamera.utils
 import selectors
 import typing
 import unittest
@@ -161,6 +163,33 @@ class AllocatorTestMethods(CameraTesterBase):
         self.assertIsDead(wr_camconfig)
         self.assertIsDead(wr_streamconfig)
 
+    def test_map(self):
+        cam = self.cam
+
+        camconfig = cam.generate_configuration([libcam.StreamRole.StillCapture])
+        cam.configure(camconfig)
+        stream = camconfig.at(0).stream
+
+        allocator = libcam.FrameBufferAllocator(cam)
+        self.assertTrue(allocator.allocate(stream) > 0)
+
+        buffer = allocator.buffers(stream)[0]
+
+        planes = buffer.map()
+        self.assertEqual(len(planes), len(buffer.planes))
+        for plane, info in zip(planes, buffer.planes):
+            self.assertEqual(len(memoryview(plane)), info.length)
+
+        # The mapping is shared, writes are visible through a new mapping
+        mv = memoryview(planes[0])
+        mv[0] = 0x5a
+        self.assertEqual(memoryview(buffer.map()[0])[0], 0x5a)
+
+        # Planes stay valid after the cached mapping is dropped
+        buffer.unmap()
+        self.assertEqual(mv[0], 0x5a)
+        mv.release()
+
 
 class SimpleCaptureMethods(CameraTesterBase):
     def test_blocking(self):
@@ -298,6 +327,67 @@ class SimpleCaptureMethods(CameraTesterBase):
 
         cam.stop()
 
+    def test_asyncio(self):
+        cm = self.cm
+        cam = self.cam
+
+        camconfig = cam.generate_configuration([libcam.StreamRole.StillCapture])
+        self.assertTrue(camconfig.size == 1)
+
+        streamconfig = camconfig.at(0)
+        cam.configure(camconfig)
+
+        stream = streamconfig.stream
+
+        allocator = libcam.FrameBufferAllocator(cam)
+        num_bufs = allocator.allocate(stream)
+        self.assertTrue(num_bufs > 0)
+
+        num_bufs = len(allocator.buffers(stream))
+
+        reqs = []
+        for i in range(num_bufs):
+            req = cam.create_request(i)
+            self.assertIsNotNone(req)
+
+            buffer = allocator.buffers(stream)[i]
+            req.add_buffer(stream, buffer)
+
+            reqs.append(req)
+
+        buffer = None
+
+        cam.start()
+
+        for req in reqs:
+            cam.queue_request(req)
+
+        reqs = None
+        gc.collect()
+
+        async def capture():
+            reqs = []
+
+            async with libcamera.utils.AsyncRequestReader(cm) as reader:
+                async for ready_reqs in reader:
+                    reqs += ready_reqs
+                    if len(reqs) == num_bufs:
+                        break
+
+            return reqs
+
+        reqs = asyncio.run(asyncio.wait_for(capture(), 5))
+
+        self.assertTrue(len(reqs) == num_bufs)
+
+        for i, req in enumerate(reqs):
+            self.assertTrue(i == req.cookie)
+
+        reqs = None
+        gc.collect()
+
+        cam.stop()
+
 
 # Recursively expand slist's objects into olist, using seen to track already
 # processed objects.
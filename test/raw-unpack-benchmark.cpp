@@ -0,0 +1,76 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * RAW unpacking benchmark
+ *
+ * Measure the cost of unpacking lines of the packed RAW formats, for a 1920
+ * pixels wide line. Run with 'meson test --benchmark raw-unpack-benchmark -v'.
+ */
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/raw_unpack.h"
+
+#include "benchmark.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+class RawUnpackBenchmark : public Test
+{
+protected:
+	int run()
+	{
+		table_.printHeader();
+
+		benchmark("RAW10P", { BayerFormat::BGGR, 10, BayerFormat::Packing::CSI2 });
+		benchmark("RAW10P, shift", { BayerFormat::BGGR, 10, BayerFormat::Packing::CSI2 }, 6);
+		benchmark("RAW12P", { BayerFormat::BGGR, 12, BayerFormat::Packing::CSI2 });
+		benchmark("IPU3", { BayerFormat::BGGR, 10, BayerFormat::Packing::IPU3 });
+		benchmark("RAW10", { BayerFormat::BGGR, 10, BayerFormat::Packing::None });
+
+		return TestPass;
+	}
+
+private:
+	void benchmark(const char *name, const BayerFormat &format,
+		       unsigned int shift = 0)
+	{
+		/* Large enough for all formats, including the IPU3 blocks. */
+		vector<uint8_t> src(kWidth * 2 + 32);
+		for (uint8_t &value : src)
+			value = rand();
+
+		vector<uint16_t> dst(kWidth);
+		uint64_t sum = 0;
+
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; i++) {
+			raw::unpackLine(format, src.data(), dst.data(), kWidth, shift);
+			sum += dst[i % kWidth];
+		}
+		Clock::duration duration = Clock::now() - start;
+
+		table_.printRow(name, nsPerOperation(duration, kIterations * kWidth));
+
+		/* Prevent the compiler from optimizing the unpacking out. */
+		if (!sum)
+			cout << "No pixel unpacked" << endl;
+	}
+
+	static constexpr unsigned int kWidth = 1920;
+	static constexpr unsigned int kIterations = 20000;
+
+	const benchmark::Table table_{ { { "format", 24 }, { "ns/pixel", 12 } }, 3 };
+};
+
+TEST_REGISTER(RawUnpackBenchmark)
@@ -0,0 +1,148 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * RAW unpacking test
+ */
+
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/raw_unpack.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+vector<uint8_t> pack10P(const vector<uint16_t> &pixels)
+{
+	vector<uint8_t> data((pixels.size() + 3) / 4 * 5);
+
+	for (unsigned int i = 0; i < pixels.size(); i++) {
+		data[i / 4 * 5 + i % 4] = pixels[i] >> 2;
+		data[i / 4 * 5 + 4] |= (pixels[i] & 0x03) << (i % 4 * 2);
+	}
+
+	return data;
+}
+
+vector<uint8_t> pack12P(const vector<uint16_t> &pixels)
+{
+	vector<uint8_t> data((pixels.size() + 1) / 2 * 3);
+
+	for (unsigned int i = 0; i < pixels.size(); i++) {
+		data[i / 2 * 3 + i % 2] = pixels[i] >> 4;
+		data[i / 2 * 3 + 2] |= (pixels[i] & 0x0f) << (i % 2 * 4);
+	}
+
+	return data;
+}
+
+vector<uint8_t> packIPU3(const vector<uint16_t> &pixels)
+{
+	vector<uint8_t> data((pixels.size() + 24) / 25 * 32);
+
+	for (unsigned int i = 0; i < pixels.size(); i++) {
+		const unsigned int bit = i / 25 * 256 + i % 25 * 10;
+
+		for (unsigned int b = 0; b < 10; b++) {
+			if (pixels[i] & (1 << b))
+				data[(bit + b) / 8] |= 1 << ((bit + b) % 8);
+		}
+	}
+
+	return data;
+}
+
+} /* namespace */
+
+class RawUnpackTest : public Test
+{
+protected:
+	int run()
+	{
+		/* Cover partial packing units at the end of the lines. */
+		for (unsigned int pixels : { 100U, 101U, 102U, 103U, 124U }) {
+			vector<uint16_t> values10(pixels);
+			vector<uint16_t> values12(pixels);
+			for (unsigned int i = 0; i < pixels; i++) {
+				values10[i] = rand() & 0x3ff;
+				values12[i] = rand() & 0xfff;
+			}
+
+			if (check("RAW10P", BayerFormat{ BayerFormat::BGGR, 10, BayerFormat::Packing::CSI2 },
+				  pack10P(values10), values10) ||
+			    check("RAW12P", BayerFormat{ BayerFormat::BGGR, 12, BayerFormat::Packing::CSI2 },
+				  pack12P(values12), values12) ||
+			    check("IPU3", BayerFormat{ BayerFormat::BGGR, 10, BayerFormat::Packing::IPU3 },
+				  packIPU3(values10), values10))
+				return TestFail;
+		}
+
+		/* Extract the MSBs of RAW10P. */
+		vector<uint16_t> values(16);
+		for (unsigned int i = 0; i < values.size(); i++)
+			values[i] = rand() & 0x3ff;
+
+		const vector<uint8_t> packed = pack10P(values);
+		uint8_t msb[16];
+		raw::unpackMsb10P(packed.data(), msb, values.size());
+
+		for (unsigned int i = 0; i < values.size(); i++) {
+			if (msb[i] != values[i] >> 2) {
+				cerr << "Invalid RAW10P MSB at pixel " << i << endl;
+				return TestFail;
+			}
+		}
+
+		/* Unsupported formats are rejected. */
+		uint16_t dst[4];
+		if (raw::unpackLine(BayerFormat{ BayerFormat::BGGR, 14, BayerFormat::Packing::CSI2 },
+				    packed.data(), dst, 4) != -EINVAL) {
+			cerr << "Unsupported format accepted" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	int check(const char *name, const BayerFormat &format,
+		  const vector<uint8_t> &packed, const vector<uint16_t> &expected)
+	{
+		for (unsigned int shift : { 0U, 4U }) {
+			vector<uint16_t> unpacked(expected.size() + 1, 0xdead);
+
+			int ret = raw::unpackLine(format, packed.data(), unpacked.data(),
+						  expected.size(), shift);
+			if (ret) {
+				cerr << name << ": Failed to unpack: " << ret << endl;
+				return TestFail;
+			}
+
+			for (unsigned int i = 0; i < expected.size(); i++) {
+				if (unpacked[i] != static_cast<uint16_t>(expected[i] << shift)) {
+					cerr << name << ": Invalid pixel " << i << " of "
+					     << expected.size() << ", got " << unpacked[i]
+					     << ", expected " << (expected[i] << shift) << endl;
+					return TestFail;
+				}
+			}
+
+			if (unpacked[expected.size()] != 0xdead) {
+				cerr << name << ": Buffer overflow" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(RawUnpackTest)
@@ -11,6 +11,8 @@
 #include <libcamera/control_ids.h>
 #include <libcamera/controls.h>
 
+#include <libcamera/ipa/ipa_controls.h>
+
 #include "libcamera/internal/byte_stream_buffer.h"
 #include "libcamera/internal/control_serializer.h"
 
@@ -169,6 +171,97 @@ protected:
 			return TestFail;
 		}
 
+		/*
+		 * Reset the serializers and serialize a copy of the control
+		 * info map. It should be serialized as a reference to the map
+		 * retained across the reset.
+		 */
+		serializer.reset();
+		deserializer.reset();
+
+		const ControlInfoMap infoMapCopy = infoMap;
+
+		size = serializer.binarySize(infoMapCopy);
+		infoData.resize(size);
+		buffer = ByteStreamBuffer(infoData.data(), infoData.size());
+
+		ret = serializer.serialize(infoMapCopy, buffer);
+		if (ret < 0) {
+			cerr << "Failed to serialize ControlInfoMap copy" << endl;
+			return TestFail;
+		}
+
+		if (buffer.offset() != sizeof(struct ipa_controls_header)) {
+			cerr << "Identical ControlInfoMap not serialized as a reference"
+			     << endl;
+			return TestFail;
+		}
+
+		buffer = ByteStreamBuffer(const_cast<const uint8_t *>(infoData.data()),
+					  infoData.size());
+
+		newInfoMap = deserializer.deserialize<ControlInfoMap>(buffer);
+		if (!equals(infoMap, newInfoMap)) {
+			cerr << "Deserialized map reference doesn't match original"
+			     << endl;
+			return TestFail;
+		}
+
+		/* Lists using the map copy should be serialized and deserialized. */
+		ControlList listCopy(infoMapCopy);
+		listCopy.set(controls::Brightness, 0.5f);
+		listCopy.set(controls::Contrast, 1.2f);
+		listCopy.set(controls::Saturation, 0.2f);
+
+		size = serializer.binarySize(listCopy);
+		listData.resize(size);
+		buffer = ByteStreamBuffer(listData.data(), listData.size());
+
+		ret = serializer.serialize(listCopy, buffer);
+		if (ret) {
+			cerr << "Failed to serialize ControlList after reset" << endl;
+			return TestFail;
+		}
+
+		buffer = ByteStreamBuffer(const_cast<const uint8_t *>(listData.data()),
+					  listData.size());
+
+		newList = deserializer.deserialize<ControlList>(buffer);
+		if (!equals(list, newList)) {
+			cerr << "Deserialized list doesn't match original after reset"
+			     << endl;
+			return TestFail;
+		}
+
+		/*
+		 * The map isn't used between the next two resets, it should be
+		 * dropped and serialized in full.
+		 */
+		serializer.reset();
+		deserializer.reset();
+		serializer.reset();
+		deserializer.reset();
+
+		size = serializer.binarySize(infoMapCopy);
+		infoData.resize(size);
+		buffer = ByteStreamBuffer(infoData.data(), infoData.size());
+
+		ret = serializer.serialize(infoMapCopy, buffer);
+		if (ret < 0 || buffer.offset() != size) {
+			cerr << "Dropped ControlInfoMap not serialized in full" << endl;
+			return TestFail;
+		}
+
+		buffer = ByteStreamBuffer(const_cast<const uint8_t *>(infoData.data()),
+					  infoData.size());
+
+		newInfoMap = deserializer.deserialize<ControlInfoMap>(buffer);
+		if (!equals(infoMap, newInfoMap)) {
+			cerr << "Deserialized map doesn't match original after drop"
+			     << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 };
@@ -123,6 +123,68 @@ if (struct1.field != struct2.field) {				\
 		TEST_SCOPED_ENUM_EQUALITY(v[1], w[1], e);
 		TEST_SCOPED_ENUM_EQUALITY(v[1], w[1], f);
 
+		if (testPod() != TestPass)
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int testPod()
+	{
+		/*
+		 * Structs without padding are serialized with memcpy(), others
+		 * field by field. Both must produce the packed wire format.
+		 */
+		static_assert(IPADataSerializer<ipa::test::TestPodStruct>::kTriviallySerializable);
+		static_assert(!IPADataSerializer<ipa::test::TestPaddedStruct>::kTriviallySerializable);
+
+		ipa::test::TestPodStruct t{ 0xdeadbeef, -42, ipa::test::IPAOperationStop,
+					    1.5f, UINT64_C(0x0123456789abcdef) };
+		std::vector<uint8_t> serialized;
+
+		std::tie(serialized, ignore) =
+			IPADataSerializer<ipa::test::TestPodStruct>::serialize(t);
+
+		if (serialized.size() != 24) {
+			cerr << "Unexpected POD struct size " << serialized.size() << endl;
+			return TestFail;
+		}
+
+		ipa::test::TestPodStruct u =
+			IPADataSerializer<ipa::test::TestPodStruct>::deserialize(serialized);
+
+		if (u.a != t.a || u.b != t.b || u.c != t.c || u.e != t.e ||
+		    u.d != t.d) {
+			cerr << "POD struct fields incorrect" << endl;
+			return TestFail;
+		}
+
+		/* Truncated data must be rejected. */
+		serialized.pop_back();
+		u = IPADataSerializer<ipa::test::TestPodStruct>::deserialize(serialized);
+		if (u.a == t.a) {
+			cerr << "Truncated POD struct deserialized" << endl;
+			return TestFail;
+		}
+
+		ipa::test::TestPaddedStruct p{ true, 58527, 42 };
+
+		std::tie(serialized, ignore) =
+			IPADataSerializer<ipa::test::TestPaddedStruct>::serialize(p);
+
+		if (serialized.size() != 7) {
+			cerr << "Unexpected padded struct size " << serialized.size() << endl;
+			return TestFail;
+		}
+
+		ipa::test::TestPaddedStruct q =
+			IPADataSerializer<ipa::test::TestPaddedStruct>::deserialize(serialized);
+
+		if (q.a != p.a || q.b != p.b || q.c != p.c) {
+			cerr << "Padded struct fields incorrect" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
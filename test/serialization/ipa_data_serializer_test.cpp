@@ -140,6 +140,10 @@ protected:
 		if (ret != TestPass)
 			return ret;
 
+		ret = testAppend();
+		if (ret != TestPass)
+			return ret;
+
 		return TestPass;
 	}
 
@@ -431,6 +435,76 @@ private:
 
 		return TestPass;
 	}
+
+	int testAppend()
+	{
+		ControlSerializer cs(ControlSerializer::Role::Proxy);
+
+		const ControlInfoMap &infoMap = camera_->controls();
+		ControlList list = generateControlList(infoMap);
+
+		std::vector<std::string> vecString = { "foo", "bar", "baz" };
+		std::map<std::string, std::vector<uint32_t>> mapStrVec = {
+			{ "a", { 1, 2, 3 } },
+			{ "b", { 4, 5 } },
+		};
+
+		/* Cache the ControlInfoMap to serialize the list identically. */
+		IPADataSerializer<ControlInfoMap>::serialize(infoMap, &cs);
+
+		std::vector<uint8_t> listBuf;
+		std::tie(listBuf, std::ignore) =
+			IPADataSerializer<ControlList>::serialize(list, &cs);
+
+		std::vector<uint8_t> vecBuf;
+		std::tie(vecBuf, std::ignore) =
+			IPADataSerializer<std::vector<std::string>>::serialize(vecString);
+
+		std::vector<uint8_t> mapBuf;
+		std::tie(mapBuf, std::ignore) =
+			IPADataSerializer<std::map<std::string, std::vector<uint32_t>>>::serialize(mapStrVec);
+
+		/*
+		 * Serialize the same objects at the end of vectors that are
+		 * reused multiple times, and check that the appended data
+		 * matches the serialized objects.
+		 */
+		std::vector<uint8_t> buf;
+		std::vector<SharedFD> fds;
+
+		for (unsigned int i = 0; i < 2; i++) {
+			buf.clear();
+			fds.clear();
+
+			appendPOD<uint32_t>(buf, 0xdeadbeef);
+
+			IPADataSerializer<ControlList>::serialize(list, &buf, &fds, &cs);
+			IPADataSerializer<std::vector<std::string>>::serialize(vecString, &buf, &fds);
+			IPADataSerializer<std::map<std::string, std::vector<uint32_t>>>::serialize(mapStrVec, &buf, &fds);
+
+			std::vector<uint8_t> expected;
+			appendPOD<uint32_t>(expected, 0xdeadbeef);
+			expected.insert(expected.end(), listBuf.begin(), listBuf.end());
+			expected.insert(expected.end(), vecBuf.begin(), vecBuf.end());
+			expected.insert(expected.end(), mapBuf.begin(), mapBuf.end());
+
+			if (buf != expected || !fds.empty()) {
+				cerr << "Appended serialization doesn't match" << endl;
+				return TestFail;
+			}
+		}
+
+		auto vecStart = buf.cbegin() + 4 + listBuf.size();
+		std::vector<std::string> vecOut =
+			IPADataSerializer<std::vector<std::string>>::deserialize(vecStart,
+										 vecStart + vecBuf.size());
+		if (vecOut != vecString) {
+			cerr << "Deserialized appended vector doesn't match original" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
 };
 
 TEST_REGISTER(IPADataSerializerTest)
@@ -0,0 +1,258 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Serialization benchmark
+ *
+ * Measure the cost of serializing and deserializing the data exchanged with
+ * isolated IPA modules, with the ControlSerializer and the IPADataSerializer.
+ * Run with 'meson test --benchmark serialization_benchmark -v'.
+ */
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <libcamera/control_ids.h>
+#include <libcamera/controls.h>
+
+#include "libcamera/internal/byte_stream_buffer.h"
+#include "libcamera/internal/control_serializer.h"
+#include "libcamera/internal/ipa_data_serializer.h"
+
+#include "benchmark.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+class SerializationBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		infoMap_ = ControlInfoMap({
+			{ &controls::ExposureTime, ControlInfo(1, 1000000) },
+			{ &controls::AnalogueGain, ControlInfo(1.0f, 16.0f) },
+			{ &controls::AeEnable, ControlInfo(false, true) },
+			{ &controls::Brightness, ControlInfo(-1.0f, 1.0f) },
+			{ &controls::Contrast, ControlInfo(0.0f, 2.0f) },
+			{ &controls::ColourGains, ControlInfo(0.0f, 8.0f) },
+			{ &controls::FrameDurationLimits, ControlInfo(INT64_C(33333), INT64_C(1000000)) },
+			{ &controls::ScalerCrop, ControlInfo(Rectangle(0, 0, 1, 1),
+							     Rectangle(0, 0, 1920, 1080)) },
+		}, controls::controls);
+
+		list_ = ControlList(infoMap_);
+		list_.set(controls::ExposureTime, 10000);
+		list_.set(controls::AnalogueGain, 2.0f);
+		list_.set(controls::AeEnable, true);
+		list_.set(controls::Brightness, 0.1f);
+		list_.set(controls::Contrast, 1.2f);
+		list_.set(controls::ColourGains, { 1.5f, 2.0f });
+		list_.set(controls::FrameDurationLimits, { INT64_C(33333), INT64_C(33333) });
+		list_.set(controls::ScalerCrop, Rectangle(0, 0, 1920, 1080));
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		table_.printHeader();
+
+		int ret = benchmarkControlSerializer();
+		if (ret != TestPass)
+			return ret;
+
+		ret = benchmarkControlList();
+		if (ret != TestPass)
+			return ret;
+
+		benchmarkVector();
+		benchmarkMap();
+
+		return TestPass;
+	}
+
+private:
+	void report(const char *name, size_t size, Clock::duration serializeTime,
+		    Clock::duration deserializeTime)
+	{
+		table_.printRow(name, size,
+				nsPerOperation(serializeTime, kIterations),
+				nsPerOperation(deserializeTime, kIterations));
+	}
+
+	int benchmarkControlSerializer()
+	{
+		ControlSerializer serializer(ControlSerializer::Role::Proxy);
+		ControlSerializer deserializer(ControlSerializer::Role::Worker);
+
+		/* The info map must be known on both sides to handle lists. */
+		vector<uint8_t> infoData(serializer.binarySize(infoMap_));
+		ByteStreamBuffer buffer(infoData.data(), infoData.size());
+
+		if (serializer.serialize(infoMap_, buffer) < 0 || buffer.overflow()) {
+			cerr << "Failed to serialize ControlInfoMap" << endl;
+			return TestFail;
+		}
+
+		buffer = ByteStreamBuffer(const_cast<const uint8_t *>(infoData.data()),
+					  infoData.size());
+		if (deserializer.deserialize<ControlInfoMap>(buffer).empty()) {
+			cerr << "Failed to deserialize ControlInfoMap" << endl;
+			return TestFail;
+		}
+
+		vector<uint8_t> listData;
+		Clock::duration serializeTime{};
+		Clock::duration deserializeTime{};
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			Clock::time_point start = Clock::now();
+
+			listData.resize(serializer.binarySize(list_));
+			buffer = ByteStreamBuffer(listData.data(), listData.size());
+			serializer.serialize(list_, buffer);
+
+			serializeTime += Clock::now() - start;
+
+			start = Clock::now();
+
+			buffer = ByteStreamBuffer(const_cast<const uint8_t *>(listData.data()),
+						  listData.size());
+			ControlList list = deserializer.deserialize<ControlList>(buffer);
+
+			deserializeTime += Clock::now() - start;
+
+			if (list.size() != list_.size()) {
+				cerr << "Failed to deserialize ControlList" << endl;
+				return TestFail;
+			}
+		}
+
+		report("ControlSerializer, ControlList", listData.size(),
+		       serializeTime, deserializeTime);
+
+		return TestPass;
+	}
+
+	int benchmarkControlList()
+	{
+		ControlSerializer cs(ControlSerializer::Role::Proxy);
+
+		vector<uint8_t> infoMapBuf;
+		tie(infoMapBuf, ignore) =
+			IPADataSerializer<ControlInfoMap>::serialize(infoMap_, &cs);
+		IPADataSerializer<ControlInfoMap>::deserialize(infoMapBuf, &cs);
+
+		vector<uint8_t> listBuf;
+		Clock::duration serializeTime{};
+		Clock::duration deserializeTime{};
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			Clock::time_point start = Clock::now();
+			tie(listBuf, ignore) =
+				IPADataSerializer<ControlList>::serialize(list_, &cs);
+			serializeTime += Clock::now() - start;
+
+			start = Clock::now();
+			ControlList list =
+				IPADataSerializer<ControlList>::deserialize(listBuf, &cs);
+			deserializeTime += Clock::now() - start;
+
+			if (list.size() != list_.size()) {
+				cerr << "Failed to deserialize ControlList" << endl;
+				return TestFail;
+			}
+		}
+
+		report("IPADataSerializer, ControlList", listBuf.size(),
+		       serializeTime, deserializeTime);
+
+		return TestPass;
+	}
+
+	void benchmarkVector()
+	{
+		/* A typical statistics buffer, such as a histogram. */
+		vector<uint32_t> histogram(256);
+		for (unsigned int i = 0; i < histogram.size(); ++i)
+			histogram[i] = i * 13;
+
+		vector<uint8_t> buf;
+		Clock::duration serializeTime{};
+		Clock::duration deserializeTime{};
+		uint64_t sum = 0;
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			Clock::time_point start = Clock::now();
+			tie(buf, ignore) =
+				IPADataSerializer<vector<uint32_t>>::serialize(histogram);
+			serializeTime += Clock::now() - start;
+
+			start = Clock::now();
+			vector<uint32_t> out =
+				IPADataSerializer<vector<uint32_t>>::deserialize(buf);
+			deserializeTime += Clock::now() - start;
+
+			sum += out.back();
+		}
+
+		report("IPADataSerializer, vector", buf.size(), serializeTime,
+		       deserializeTime);
+
+		/* Prevent the compiler from optimizing the deserialization out. */
+		if (!sum)
+			cout << "Empty vector" << endl;
+	}
+
+	void benchmarkMap()
+	{
+		map<string, vector<uint32_t>> tables;
+		for (const char *name : { "lsc.r", "lsc.gr", "lsc.gb", "lsc.b" })
+			tables[name] = vector<uint32_t>(16 * 12, 1024);
+
+		vector<uint8_t> buf;
+		Clock::duration serializeTime{};
+		Clock::duration deserializeTime{};
+		size_t count = 0;
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			Clock::time_point start = Clock::now();
+			tie(buf, ignore) =
+				IPADataSerializer<map<string, vector<uint32_t>>>::serialize(tables);
+			serializeTime += Clock::now() - start;
+
+			start = Clock::now();
+			map<string, vector<uint32_t>> out =
+				IPADataSerializer<map<string, vector<uint32_t>>>::deserialize(buf);
+			deserializeTime += Clock::now() - start;
+
+			count += out.size();
+		}
+
+		report("IPADataSerializer, map", buf.size(), serializeTime,
+		       deserializeTime);
+
+		if (!count)
+			cout << "Empty map" << endl;
+	}
+
+	static constexpr unsigned int kIterations = 20000;
+
+	ControlInfoMap infoMap_;
+	ControlList list_;
+
+	const benchmark::Table table_{ {
+		{ "data", 32 }, { "bytes", 10 },
+		{ "serialize ns", 16 }, { "deserialize ns", 16 },
+	} };
+};
+
+TEST_REGISTER(SerializationBenchmark)
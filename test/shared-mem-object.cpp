@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * SharedMem and SharedMemObjects test
+ */
+
+#include <array>
+#include <fcntl.h>
+#include <iostream>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "libcamera/internal/shared_mem_object.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+struct Counter {
+	Counter()
+		: value(42)
+	{
+		constructed++;
+	}
+
+	~Counter()
+	{
+		destroyed++;
+	}
+
+	uint32_t value;
+
+	static unsigned int constructed;
+	static unsigned int destroyed;
+};
+
+unsigned int Counter::constructed = 0;
+unsigned int Counter::destroyed = 0;
+
+using Small = std::array<uint8_t, 3>;
+using Large = std::array<uint32_t, 1000>;
+
+} /* namespace */
+
+class SharedMemObjectTest : public Test
+{
+protected:
+	int run()
+	{
+		using Objects = SharedMemObjects<Small, Counter, Large>;
+
+		static_assert(Objects::offset<Small>() == 0);
+		static_assert(Objects::offset<Counter>() == 64);
+		static_assert(Objects::offset<Large>() == 128);
+		static_assert(Objects::kSize == 128 + sizeof(Large));
+
+		{
+			Objects objects("test");
+			if (!objects) {
+				cout << "Failed to allocate shared memory" << endl;
+				return TestFail;
+			}
+
+			if (Counter::constructed != 1 ||
+			    objects.get<Counter>().value != 42 ||
+			    objects.get<Large>()[999] != 0) {
+				cout << "Objects not constructed" << endl;
+				return TestFail;
+			}
+
+			/* The objects must be visible through the file descriptor. */
+			objects.get<Large>()[10] = 0xcafe;
+
+			Objects moved(std::move(objects));
+			if (objects || !moved || Counter::destroyed != 0) {
+				cout << "Move construction failed" << endl;
+				return TestFail;
+			}
+
+			const int fd = moved.fd().get();
+			void *mem = mmap(nullptr, Objects::kSize, PROT_READ,
+					 MAP_SHARED, fd, 0);
+			if (mem == MAP_FAILED) {
+				cout << "Failed to map shared memory" << endl;
+				return TestFail;
+			}
+
+			const uint8_t *data = static_cast<const uint8_t *>(mem);
+			const Large *large = reinterpret_cast<const Large *>(
+				data + Objects::offset<Large>());
+			bool match = (*large)[10] == 0xcafe;
+			munmap(mem, Objects::kSize);
+
+			if (!match) {
+				cout << "Object not found in shared memory" << endl;
+				return TestFail;
+			}
+
+			/* The size of the backing file must be sealed. */
+			int seals = fcntl(fd, F_GET_SEALS);
+			if (seals < 0 || !(seals & F_SEAL_SHRINK) ||
+			    !(seals & F_SEAL_GROW) || !(seals & F_SEAL_SEAL)) {
+				cout << "Shared memory not sealed" << endl;
+				return TestFail;
+			}
+
+			if (ftruncate(fd, 0) == 0) {
+				cout << "Shared memory shrunk" << endl;
+				return TestFail;
+			}
+		}
+
+		if (Counter::destroyed != 1) {
+			cout << "Objects not destroyed" << endl;
+			return TestFail;
+		}
+
+		/* Huge pages may not be available, but allocation must succeed. */
+		SharedMemObjects<Large> huge("test", SharedMem::Backing::HugePages);
+		if (!huge || huge.mem().size() < sizeof(Large)) {
+			cout << "Failed to allocate huge pages shared memory" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(SharedMemObjectTest)
@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Cross-thread signal and method invocation memory allocation test
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <stdlib.h>
+#include <thread>
+
+#include <libcamera/base/object.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/thread.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+/* Count the heap allocations performed by the threads that enable counting */
+thread_local bool countAllocations = false;
+atomic<unsigned int> allocations = 0;
+
+} /* namespace */
+
+void *operator new(size_t size)
+{
+	if (countAllocations)
+		allocations++;
+
+	void *ptr = malloc(size ? size : 1);
+	if (!ptr)
+		throw bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] size_t size) noexcept
+{
+	free(ptr);
+}
+
+class Receiver : public Object
+{
+public:
+	void slot(int value)
+	{
+		sum_ += value;
+		count_++;
+	}
+
+	int method(int value)
+	{
+		count_++;
+		return value + 1;
+	}
+
+	unsigned int count() const { return count_; }
+
+private:
+	atomic<unsigned int> count_ = 0;
+	atomic<int> sum_ = 0;
+};
+
+class SignalAllocationTest : public Test
+{
+protected:
+	int init()
+	{
+		receiver_ = new Receiver();
+		receiver_->moveToThread(&thread_);
+		signal_.connect(receiver_, &Receiver::slot);
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		/*
+		 * Warm up the memory pools with queued invocations while the
+		 * receiver's thread is stopped, to allocate more blocks than
+		 * will be in flight at any time in the bursts below.
+		 */
+		for (unsigned int i = 0; i < kInvocations; i++) {
+			signal_.emit(i);
+			receiver_->invokeMethod(&Receiver::method,
+						ConnectionTypeQueued, i);
+			receiver_->invokeMethod(&Receiver::method,
+						ConnectionTypeQueued, i);
+		}
+
+		thread_.start();
+
+		if (wait(kInvocations * 3) != TestPass)
+			return TestFail;
+
+		for (unsigned int i = 0; i < 10; i++) {
+			if (burst() != TestPass)
+				return TestFail;
+		}
+
+		if (allocations) {
+			cout << allocations << " memory allocations in steady state"
+			     << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup()
+	{
+		thread_.exit(0);
+		thread_.wait();
+
+		delete receiver_;
+	}
+
+private:
+	/*
+	 * Emit queued signals and invoke methods with queued and blocking
+	 * connections, counting the allocations in the calling thread only.
+	 */
+	int burst()
+	{
+		unsigned int expected = receiver_->count() + kInvocations * 3;
+
+		countAllocations = true;
+
+		for (unsigned int i = 0; i < kInvocations; i++)
+			signal_.emit(i);
+
+		for (unsigned int i = 0; i < kInvocations; i++)
+			receiver_->invokeMethod(&Receiver::method,
+						ConnectionTypeQueued, i);
+
+		for (unsigned int i = 0; i < kInvocations; i++) {
+			int ret = receiver_->invokeMethod(&Receiver::method,
+							  ConnectionTypeBlocking, i);
+			if (ret != static_cast<int>(i) + 1) {
+				countAllocations = false;
+				cout << "Invalid blocking invocation return value"
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		countAllocations = false;
+
+		return wait(expected);
+	}
+
+	int wait(unsigned int expected)
+	{
+		for (unsigned int i = 0; i < 100 && receiver_->count() != expected; i++)
+			this_thread::sleep_for(chrono::milliseconds(10));
+
+		if (receiver_->count() != expected) {
+			cout << "Invocations not delivered" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	static constexpr unsigned int kInvocations = 16;
+
+	Receiver *receiver_;
+	Signal<int> signal_;
+	Thread thread_;
+};
+
+TEST_REGISTER(SignalAllocationTest)
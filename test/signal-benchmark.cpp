@@ -0,0 +1,172 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * Signal and method invocation benchmark
+ *
+ * Measure the cost of emitting signals and invoking methods, with direct
+ * delivery in the emitter's thread and with queued delivery to an object bound
+ * to another thread. The cost of queued delivery includes posting the message,
+ * waking up the receiver's thread and dispatching the message. Run with
+ * 'meson test --benchmark signal-benchmark -v'.
+ */
+
+#include <iostream>
+
+#include <libcamera/base/object.h>
+#include <libcamera/base/semaphore.h>
+#include <libcamera/base/signal.h>
+#include <libcamera/base/thread.h>
+
+#include "benchmark.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+namespace {
+
+class Receiver : public Object
+{
+public:
+	void reset(unsigned int expected)
+	{
+		count_ = 0;
+		expected_ = expected;
+	}
+
+	void slot(unsigned int value)
+	{
+		sum_ += value;
+		if (++count_ == expected_)
+			done_.release();
+	}
+
+	unsigned int sum() const { return sum_; }
+	Semaphore &done() { return done_; }
+
+private:
+	unsigned int count_ = 0;
+	unsigned int expected_ = 0;
+	unsigned int sum_ = 0;
+	Semaphore done_;
+};
+
+unsigned int staticSum = 0;
+
+void staticSlot(unsigned int value)
+{
+	staticSum += value;
+}
+
+} /* namespace */
+
+class SignalBenchmark : public Test
+{
+protected:
+	int run() override
+	{
+		table_.printHeader();
+
+		benchmarkDirect();
+		benchmarkQueued();
+
+		return TestPass;
+	}
+
+private:
+	void report(const char *operation, Clock::duration duration,
+		    unsigned int operations)
+	{
+		table_.printRow(operation, nsPerOperation(duration, operations));
+	}
+
+	void benchmarkDirect()
+	{
+		Signal<unsigned int> signal;
+		Receiver receiver;
+
+		signal.connect(&staticSlot);
+
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			signal.emit(i);
+		report("emit, static function", Clock::now() - start, kIterations);
+
+		signal.disconnect();
+		signal.connect(&receiver, &Receiver::slot);
+
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			signal.emit(i);
+		report("emit, object, direct", Clock::now() - start, kIterations);
+
+		signal.disconnect();
+		Receiver receivers[4];
+		for (Receiver &r : receivers)
+			signal.connect(&r, &Receiver::slot);
+
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			signal.emit(i);
+		report("emit, 4 objects, direct", Clock::now() - start, kIterations);
+
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			receiver.invokeMethod(&Receiver::slot, ConnectionTypeDirect, i);
+		report("invokeMethod, direct", Clock::now() - start, kIterations);
+
+		/* Prevent the compiler from optimizing the slots out. */
+		if (!receiver.sum() || !staticSum)
+			cout << "No slot called" << endl;
+	}
+
+	void benchmarkQueued()
+	{
+		Thread thread;
+		Signal<unsigned int> signal;
+		Receiver receiver;
+
+		receiver.moveToThread(&thread);
+		thread.start();
+
+		signal.connect(&receiver, &Receiver::slot);
+
+		receiver.reset(kIterations);
+		Clock::time_point start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			signal.emit(i);
+		receiver.done().acquire();
+		report("emit, object, queued", Clock::now() - start, kIterations);
+
+		receiver.reset(kIterations);
+		start = Clock::now();
+		for (unsigned int i = 0; i < kIterations; ++i)
+			receiver.invokeMethod(&Receiver::slot, ConnectionTypeQueued, i);
+		receiver.done().acquire();
+		report("invokeMethod, queued", Clock::now() - start, kIterations);
+
+		/* Blocking calls measure the round trip to the thread. */
+		constexpr unsigned int blockingIterations = kIterations / 20;
+
+		receiver.reset(blockingIterations);
+		start = Clock::now();
+		for (unsigned int i = 0; i < blockingIterations; ++i)
+			receiver.invokeMethod(&Receiver::slot, ConnectionTypeBlocking, i);
+		report("invokeMethod, blocking", Clock::now() - start,
+		       blockingIterations);
+		receiver.done().acquire();
+
+		thread.exit();
+		thread.wait();
+	}
+
+	static constexpr unsigned int kIterations = 200000;
+
+	const benchmark::Table table_{ { { "operation", 32 }, { "ns/op", 12 } } };
+};
+
+TEST_REGISTER(SignalBenchmark)
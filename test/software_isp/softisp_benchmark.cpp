@@ -0,0 +1,359 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Software ISP benchmark
+ *
+ * Feed synthetic Bayer frames of all supported formats through DebayerCpu and
+ * SwStatsCpu, and report the throughput and time spent per frame. The number of
+ * frames measured for each configuration defaults to 10, and can be set with
+ * the SOFTISP_BENCHMARK_FRAMES environment variable. Run with
+ * 'meson test --benchmark --suite software_isp -v'.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <memory>
+#include <random>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+#include "libcamera/internal/software_isp/debayer_params.h"
+#include "libcamera/internal/software_isp/swisp_shared_mem.h"
+
+#include "debayer_cpu.h"
+#include "swstats_cpu.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+/* Count the cache misses of the calling thread, if supported by the system */
+class CacheMissCounter
+{
+public:
+	CacheMissCounter()
+	{
+		perf_event_attr attr = {};
+
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.size = sizeof(attr);
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		fd_ = UniqueFD(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+
+	bool isValid() const { return fd_.isValid(); }
+
+	void start()
+	{
+		if (!isValid())
+			return;
+
+		ioctl(fd_.get(), PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd_.get(), PERF_EVENT_IOC_ENABLE, 0);
+	}
+
+	uint64_t stop()
+	{
+		uint64_t count = 0;
+
+		if (!isValid())
+			return 0;
+
+		ioctl(fd_.get(), PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd_.get(), &count, sizeof(count)) != sizeof(count))
+			return 0;
+
+		return count;
+	}
+
+private:
+	UniqueFD fd_;
+};
+
+int64_t timestamp()
+{
+	timespec ts = {};
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+} /* namespace */
+
+class SoftIspBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		const char *frames = getenv("SOFTISP_BENCHMARK_FRAMES");
+		if (frames)
+			frameCount_ = std::max(atoi(frames), 1);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		static const std::vector<Size> sizes = {
+			{ 640, 480 },
+			{ 1920, 1080 },
+		};
+		static const BayerFormat::Order orders[] = {
+			BayerFormat::BGGR, BayerFormat::GBRG,
+			BayerFormat::GRBG, BayerFormat::RGGB,
+		};
+		static const std::pair<uint8_t, BayerFormat::Packing> depths[] = {
+			{ 8, BayerFormat::Packing::None },
+			{ 10, BayerFormat::Packing::None },
+			{ 12, BayerFormat::Packing::None },
+			{ 10, BayerFormat::Packing::CSI2 },
+		};
+
+		if (!cacheMisses_.isValid())
+			cout << "Cache misses not available" << endl;
+
+		cout << left << setw(16) << "input" << setw(10) << "output"
+		     << setw(11) << "size" << setw(6) << "simd"
+		     << right << setw(10) << "MPix/s" << setw(12) << "frame us"
+		     << setw(12) << "stats us" << setw(12) << "misses" << endl;
+
+		for (const Size &size : sizes) {
+			for (const auto &[bitDepth, packing] : depths) {
+				for (BayerFormat::Order order : orders) {
+					BayerFormat bayer{ order, bitDepth, packing };
+					int ret = benchmarkFormat(bayer.toPixelFormat(), size);
+					if (ret != TestPass)
+						return ret;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+private:
+	std::unique_ptr<FrameBuffer> createBuffer(size_t size)
+	{
+		UniqueFD fd(memfd_create("softisp-benchmark", MFD_CLOEXEC));
+		if (!fd.isValid() || ftruncate(fd.get(), size) < 0)
+			return nullptr;
+
+		FrameBuffer::Plane plane;
+		plane.fd = SharedFD(std::move(fd));
+		plane.offset = 0;
+		plane.length = size;
+
+		return std::make_unique<FrameBuffer>(std::vector<FrameBuffer::Plane>{ plane });
+	}
+
+	void fillBuffer(FrameBuffer *buffer, const BayerFormat &bayer)
+	{
+		MappedFrameBuffer mapped(buffer, MappedFrameBuffer::MapFlag::Write);
+		Span<uint8_t> data = mapped.planes()[0];
+		std::mt19937 random(1);
+
+		if (bayer.bitDepth > 8 && bayer.packing == BayerFormat::Packing::None) {
+			uint16_t *pixels = reinterpret_cast<uint16_t *>(data.data());
+			const uint16_t mask = (1 << bayer.bitDepth) - 1;
+
+			for (size_t i = 0; i < data.size() / 2; i++)
+				pixels[i] = random() & mask;
+		} else {
+			for (uint8_t &byte : data)
+				byte = random();
+		}
+	}
+
+	int benchmarkFormat(const PixelFormat &inputFormat, const Size &size)
+	{
+		const BayerFormat bayer = BayerFormat::fromPixelFormat(inputFormat);
+		StreamConfiguration inputCfg;
+
+		inputCfg.pixelFormat = inputFormat;
+		inputCfg.size = size;
+		inputCfg.stride = bayer.packing == BayerFormat::Packing::CSI2
+				? size.width * 5 / 4
+				: size.width * (bayer.bitDepth > 8 ? 2 : 1);
+
+		std::unique_ptr<FrameBuffer> input =
+			createBuffer(inputCfg.stride * size.height);
+		if (!input) {
+			cerr << "Failed to allocate input buffer" << endl;
+			return TestFail;
+		}
+
+		fillBuffer(input.get(), bayer);
+
+		double statsTime = benchmarkStats(inputCfg, input.get());
+		if (statsTime < 0)
+			return TestFail;
+
+		std::vector<PixelFormat> outputFormats =
+			DebayerCpu(std::make_unique<SwStatsCpu>(stats_)).formats(inputFormat);
+
+		for (const PixelFormat &outputFormat : outputFormats) {
+			for (bool simd : { true, false }) {
+				int ret = benchmarkDebayer(inputCfg, input.get(),
+							   outputFormat, simd,
+							   statsTime);
+				if (ret != TestPass)
+					return ret;
+			}
+		}
+
+		return TestPass;
+	}
+
+	/* Measure the statistics alone, over the whole frame */
+	double benchmarkStats(const StreamConfiguration &inputCfg, FrameBuffer *input)
+	{
+		SwStatsCpu stats(stats_);
+
+		if (!stats.isValid() || stats.configure(inputCfg)) {
+			cerr << "Failed to configure statistics for "
+			     << inputCfg.pixelFormat << endl;
+			return -1;
+		}
+
+		stats.setWindow(Rectangle(inputCfg.size));
+		stats.setStripeCount(1);
+
+		MappedFrameBuffer mapped(input, MappedFrameBuffer::MapFlag::Read);
+		const uint8_t *src = mapped.planes()[0].data();
+		const unsigned int stride = inputCfg.stride;
+		int64_t total = 0;
+
+		for (unsigned int frame = 0; frame < kWarmupFrames + frameCount_; frame++) {
+			int64_t start = timestamp();
+
+			stats.startFrame();
+
+			for (unsigned int y = 0; y + 1 < inputCfg.size.height; y += 2) {
+				const uint8_t *lines[3] = {
+					src + (y ? y - 1 : 1) * stride,
+					src + y * stride,
+					src + (y + 1) * stride,
+				};
+
+				stats.processLine0(y, lines);
+			}
+
+			stats.finishFrame(frame);
+
+			if (frame >= kWarmupFrames)
+				total += timestamp() - start;
+		}
+
+		return total / 1000.0 / frameCount_;
+	}
+
+	int benchmarkDebayer(const StreamConfiguration &inputCfg, FrameBuffer *input,
+			     const PixelFormat &outputFormat, bool simd,
+			     double statsTime)
+	{
+		if (simd)
+			unsetenv("LIBCAMERA_SOFTISP_SIMD");
+		else
+			setenv("LIBCAMERA_SOFTISP_SIMD", "0", 1);
+
+		DebayerCpu debayer(std::make_unique<SwStatsCpu>(stats_));
+
+		StreamConfiguration outputCfg;
+		outputCfg.pixelFormat = outputFormat;
+		outputCfg.size = debayer.sizes(inputCfg.pixelFormat, inputCfg.size).max;
+		std::tie(outputCfg.stride, std::ignore) =
+			debayer.strideAndFrameSize(outputFormat, outputCfg.size);
+
+		std::vector<std::reference_wrapper<StreamConfiguration>> outputCfgs{ outputCfg };
+		if (debayer.configure(inputCfg, outputCfgs)) {
+			cerr << "Failed to configure " << inputCfg.pixelFormat
+			     << " to " << outputFormat << endl;
+			return TestFail;
+		}
+
+		std::unique_ptr<FrameBuffer> output = createBuffer(debayer.frameSize());
+		if (!output) {
+			cerr << "Failed to allocate output buffer" << endl;
+			return TestFail;
+		}
+
+		DebayerParams params = {};
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++)
+			params.red[i] = params.green[i] = params.blue[i] = i;
+
+		int64_t total = 0;
+		uint64_t misses = 0;
+
+		for (unsigned int frame = 0; frame < kWarmupFrames + frameCount_; frame++) {
+			const bool measure = frame >= kWarmupFrames;
+
+			if (measure)
+				cacheMisses_.start();
+			int64_t start = timestamp();
+
+			debayer.process(frame, input, output.get(), &params, {});
+
+			if (!measure)
+				continue;
+
+			total += timestamp() - start;
+			misses += cacheMisses_.stop();
+		}
+
+		unsetenv("LIBCAMERA_SOFTISP_SIMD");
+
+		if (output->metadata().status != FrameMetadata::FrameSuccess) {
+			cerr << "Failed to process " << inputCfg.pixelFormat
+			     << " to " << outputFormat << endl;
+			return TestFail;
+		}
+
+		const double frameTime = total / 1000.0 / frameCount_;
+		const double mpixels = inputCfg.size.width * inputCfg.size.height / frameTime;
+
+		cout << left << setw(16) << inputCfg.pixelFormat.toString()
+		     << setw(10) << outputFormat.toString()
+		     << setw(11) << inputCfg.size.toString()
+		     << setw(6) << (simd ? "yes" : "no")
+		     << right << fixed << setprecision(1)
+		     << setw(10) << mpixels << setw(12) << frameTime
+		     << setw(12) << statsTime;
+
+		if (cacheMisses_.isValid())
+			cout << setw(12) << misses / frameCount_;
+		else
+			cout << setw(12) << "-";
+
+		cout << endl;
+
+		return TestPass;
+	}
+
+	static constexpr unsigned int kWarmupFrames = 2;
+
+	unsigned int frameCount_ = 10;
+	CacheMissCounter cacheMisses_;
+	SwIspStatsRing stats_;
+};
+
+TEST_REGISTER(SoftIspBenchmark)
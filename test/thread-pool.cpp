@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Thread pool test
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/semaphore.h>
+#include <libcamera/base/thread_pool.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+class ThreadPoolTest : public Test
+{
+protected:
+	int run()
+	{
+		if (testPriorities() != TestPass)
+			return TestFail;
+
+		if (testStealing() != TestPass)
+			return TestFail;
+
+		if (testDestruction() != TestPass)
+			return TestFail;
+
+		return TestPass;
+	}
+
+private:
+	/*
+	 * Queue tasks to a single worker while it is busy, and check that they
+	 * run by priority, and in submission order for the same priority.
+	 */
+	int testPriorities()
+	{
+		ThreadPool pool(1);
+		Semaphore blocked;
+		Semaphore done;
+		Mutex mutex;
+		vector<unsigned int> order;
+
+		auto task = [&](unsigned int id) {
+			return [&, id]() {
+				{
+					MutexLocker locker(mutex);
+					order.push_back(id);
+				}
+				done.release();
+			};
+		};
+
+		pool.submit([&]() { blocked.acquire(); });
+
+		pool.submit(task(4), ThreadPool::Priority::Low);
+		pool.submit(task(2));
+		pool.submit(task(3));
+		pool.submit(task(1), ThreadPool::Priority::High);
+
+		blocked.release();
+		done.acquire(4);
+
+		if (order != vector<unsigned int>{ 1, 2, 3, 4 }) {
+			cout << "Tasks not run in priority order" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Submit tasks from a worker that then waits for them to complete.
+	 * They are queued to the busy worker, and can only complete if the
+	 * other worker takes them.
+	 */
+	int testStealing()
+	{
+		static constexpr unsigned int kTasks = 100;
+
+		ThreadPool pool(2);
+		atomic<unsigned int> count = 0;
+		atomic<bool> stolen = false;
+		Semaphore done;
+
+		pool.submit([&]() {
+			for (unsigned int i = 0; i < kTasks; i++)
+				pool.submit([&]() { count++; });
+
+			for (unsigned int i = 0; i < 100 && count != kTasks; i++)
+				this_thread::sleep_for(chrono::milliseconds(10));
+
+			stolen = count == kTasks;
+			done.release();
+		});
+
+		done.acquire();
+
+		if (!stolen) {
+			cout << "Tasks of a busy worker not taken by idle worker"
+			     << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/* Check that destroying the pool runs all the queued tasks. */
+	int testDestruction()
+	{
+		static constexpr unsigned int kTasks = 1000;
+
+		atomic<unsigned int> count = 0;
+
+		{
+			ThreadPool pool(4);
+
+			for (unsigned int i = 0; i < kTasks; i++)
+				pool.submit([&]() { count++; });
+		}
+
+		if (count != kTasks) {
+			cout << "Queued tasks not run on destruction" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(ThreadPoolTest)
@@ -9,6 +9,9 @@
 #include <iostream>
 #include <memory>
 #include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/resource.h>
 #include <thread>
 #include <time.h>
 
@@ -66,6 +69,30 @@ private:
 	bool &cancelled_;
 };
 
+class SchedulingThread : public Thread
+{
+public:
+	cpu_set_t cpuset;
+	int nice;
+	std::string name;
+
+protected:
+	void run()
+	{
+		char threadName[16] = {};
+		pthread_getname_np(pthread_self(), threadName, sizeof(threadName));
+		name = threadName;
+
+		CPU_ZERO(&cpuset);
+		sched_getaffinity(0, sizeof(cpuset), &cpuset);
+
+		errno = 0;
+		nice = getpriority(PRIO_PROCESS, 0);
+		if (errno)
+			nice = -100;
+	}
+};
+
 class ThreadTest : public Test
 {
 protected:
@@ -165,6 +192,56 @@ protected:
 			return TestFail;
 		}
 
+		/* Test the affinity and scheduling of a custom thread. */
+		cpu_set_t allowed;
+		unsigned int cpu = 0;
+
+		CPU_ZERO(&allowed);
+		sched_getaffinity(0, sizeof(allowed), &allowed);
+		while (cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed))
+			cpu++;
+
+		SchedulingThread schedThread;
+
+		if (schedThread.setThreadAffinity({ { CPU_SETSIZE } }) != -EINVAL ||
+		    schedThread.setThreadAffinity({}) != -EINVAL) {
+			cout << "Invalid thread affinity accepted" << endl;
+			return TestFail;
+		}
+
+		if (schedThread.setSchedulingPolicy(Thread::SchedulingPolicy::Normal, 20) != -EINVAL ||
+		    schedThread.setSchedulingPolicy(Thread::SchedulingPolicy::Fifo, 0) != -EINVAL) {
+			cout << "Invalid thread scheduling accepted" << endl;
+			return TestFail;
+		}
+
+		if (schedThread.setThreadAffinity({ { cpu } }) ||
+		    schedThread.setSchedulingPolicy(Thread::SchedulingPolicy::Normal, 19)) {
+			cout << "Failed to set thread affinity and scheduling" << endl;
+			return TestFail;
+		}
+
+		schedThread.setThreadName("a-thread-name-too-long");
+
+		schedThread.start();
+		schedThread.wait();
+
+		if (CPU_COUNT(&schedThread.cpuset) != 1 ||
+		    !CPU_ISSET(cpu, &schedThread.cpuset)) {
+			cout << "Thread affinity not applied" << endl;
+			return TestFail;
+		}
+
+		if (schedThread.nice != 19) {
+			cout << "Thread scheduling not applied" << endl;
+			return TestFail;
+		}
+
+		if (schedThread.name != "a-thread-name-t") {
+			cout << "Thread name not applied" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Linaro Ltd
+ *
+ * Timer queue test
+ */
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <libcamera/base/timer.h>
+#include <libcamera/base/timer_queue.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+class TimerQueueTest : public Test
+{
+protected:
+	int run()
+	{
+		static constexpr unsigned int kTimers = 1000;
+
+		utils::time_point now = utils::clock::now();
+		vector<unique_ptr<Timer>> timers;
+		mt19937 random(42);
+		TimerQueue queue;
+
+		/*
+		 * Set the timer deadlines without leaving them registered with
+		 * the event dispatcher of the thread. A timer can only be in a
+		 * single queue at a time, this must thus not be called on
+		 * timers stored in the test queue.
+		 */
+		auto setDeadline = [&](Timer *timer) {
+			timer->start(now + chrono::milliseconds(random() % 10000));
+			timer->stop();
+		};
+
+		for (unsigned int i = 0; i < kTimers; i++) {
+			timers.push_back(make_unique<Timer>());
+			setDeadline(timers.back().get());
+			queue.insert(timers.back().get());
+		}
+
+		/* Remove a third of the timers and reschedule another third. */
+		set<Timer *> queued;
+		for (const unique_ptr<Timer> &timer : timers)
+			queued.insert(timer.get());
+
+		for (unsigned int i = 0; i < kTimers; i++) {
+			Timer *timer = timers[i].get();
+
+			switch (random() % 3) {
+			case 0:
+				queue.remove(timer);
+				queued.erase(timer);
+				break;
+			case 1:
+				/*
+				 * Inserting a queued timer again shall move it
+				 * without duplicating it.
+				 */
+				queue.remove(timer);
+				setDeadline(timer);
+				queue.insert(timer);
+				queue.insert(timer);
+				break;
+			default:
+				break;
+			}
+		}
+
+		/* Removing a timer that isn't queued shall be a no-op. */
+		for (unsigned int i = 0; i < kTimers; i++) {
+			if (!queued.count(timers[i].get()))
+				queue.remove(timers[i].get());
+		}
+
+		/* Drain the queue and check the ordering. */
+		utils::time_point previous = now;
+		unsigned int count = 0;
+
+		while (!queue.empty()) {
+			Timer *timer = queue.front();
+
+			if (queue.deadline() != timer->deadline()) {
+				cout << "Deadline mismatch for timer " << count << endl;
+				return TestFail;
+			}
+
+			if (timer->deadline() < previous) {
+				cout << "Timers not sorted by deadline" << endl;
+				return TestFail;
+			}
+
+			if (!queued.count(timer)) {
+				cout << "Removed timer still queued" << endl;
+				return TestFail;
+			}
+
+			previous = timer->deadline();
+			queue.remove(timer);
+			count++;
+		}
+
+		if (count != queued.size()) {
+			cout << "Expected " << queued.size() << " timers, got "
+			     << count << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(TimerQueueTest)
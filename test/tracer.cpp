@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * In-process tracer test
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+
+#include "libcamera/internal/tracer.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+class TracerTest : public Test
+{
+protected:
+	int init()
+	{
+		/* The trace is dumped when the process exits, discard it. */
+		setenv("LIBCAMERA_TRACE_FILE", "/dev/null", 1);
+		setenv("LIBCAMERA_TRACE_BUFFER_SIZE", "64", 1);
+
+		if (!Tracer::enabled()) {
+			cout << "Failed to enable the tracer" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		int value = -3;
+		const char *device = "/dev/video0";
+		const char *longName = "a string too long to fit in an event";
+
+		LIBCAMERA_TRACER_RECORD(test_event, value, device);
+		LIBCAMERA_TRACER_RECORD(test_span_begin, longName);
+		LIBCAMERA_TRACER_RECORD(test_span_end, value + 1);
+
+		/* Overflow the ring buffer of another thread. */
+		std::thread thread([]() {
+			for (unsigned int i = 0; i < 100; ++i)
+				LIBCAMERA_TRACER_RECORD(test_loop, i);
+		});
+		thread.join();
+
+		ostringstream stream;
+		Tracer::instance()->dump(stream);
+		string trace = stream.str();
+
+		if (trace.find("{\"name\":\"test_event\",\"cat\":\"libcamera\",\"ph\":\"i\"") == string::npos ||
+		    trace.find("\"args\":{\"value\":-3,\"device\":\"/dev/video0\"}") == string::npos) {
+			cout << "Instant event not found" << endl;
+			return TestFail;
+		}
+
+		if (trace.find("{\"name\":\"test_span\",\"cat\":\"libcamera\",\"ph\":\"B\"") == string::npos ||
+		    trace.find("{\"name\":\"test_span\",\"cat\":\"libcamera\",\"ph\":\"E\"") == string::npos ||
+		    trace.find("\"value + 1\":-2") == string::npos) {
+			cout << "Duration event not found" << endl;
+			return TestFail;
+		}
+
+		string truncated(longName, Tracer::kMaxStringLength - 1);
+		if (trace.find("\"longName\":\"" + truncated + "\"}") == string::npos) {
+			cout << "String argument not truncated" << endl;
+			return TestFail;
+		}
+
+		/* Only the most recent events of the thread are kept. */
+		unsigned int count = 0;
+		for (size_t pos = 0; (pos = trace.find("\"test_loop\"", pos)) != string::npos; ++pos)
+			count++;
+
+		if (count > 64 || count < 63) {
+			cout << "Unexpected number of events " << count << endl;
+			return TestFail;
+		}
+
+		if (trace.find("\"i\":99}") == string::npos ||
+		    trace.find("\"i\":0}") != string::npos) {
+			cout << "Ring buffer overflow not handled" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(TracerTest)
@@ -5,6 +5,7 @@
  * Test the buffer cache different operation modes
  */
 
+#include <algorithm>
 #include <iostream>
 #include <random>
 #include <vector>
@@ -126,6 +127,39 @@ public:
 		return TestPass;
 	}
 
+	/*
+	 * Test that a buffer queued again while in use gets a different index,
+	 * and that both indexes are then hits for the buffer.
+	 */
+	int testBusy(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
+	{
+		V4L2BufferCache cache(buffers.size());
+		const FrameBuffer &buffer = *buffers[0].get();
+
+		int first = cache.get(buffer);
+		int second = cache.get(buffer);
+		if (first < 0 || second < 0 || first == second) {
+			std::cout << "Busy buffer got index " << second
+				  << ", already used by index " << first
+				  << std::endl;
+			return TestFail;
+		}
+
+		cache.put(first);
+		cache.put(second);
+
+		int index = cache.get(buffer);
+		int other = cache.get(buffer);
+		if (index != std::min(first, second) ||
+		    other != std::max(first, second)) {
+			std::cout << "Busy buffer indexes are not hits"
+				  << std::endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
 	int testIsEmpty(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
 	{
 		V4L2BufferCache cache(buffers.size());
@@ -155,6 +189,52 @@ public:
 		return TestPass;
 	}
 
+	int testRegistered(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
+	{
+		const unsigned int numRegistered = buffers.size() / 2;
+		std::vector<const FrameBuffer *> registered;
+
+		for (unsigned int i = 0; i < numRegistered; i++)
+			registered.push_back(buffers[i].get());
+
+		V4L2BufferCache cache(buffers.size(), registered);
+
+		/*
+		 * Registered buffers shall hit their pre-populated entry from
+		 * the first use, and keep it while the other buffers go
+		 * through the remaining entries.
+		 */
+		for (unsigned int round = 0; round < 2; round++) {
+			for (unsigned int i = 0; i < numRegistered; i++) {
+				int index = cache.get(*registered[i]);
+				if (index != static_cast<int>(i)) {
+					std::cout << "Registered buffer " << i
+						  << " got index " << index
+						  << std::endl;
+					return TestFail;
+				}
+
+				cache.put(index);
+			}
+
+			for (unsigned int i = 0; i < 100; i++) {
+				const FrameBuffer &buffer =
+					*buffers[numRegistered + i % (buffers.size() - numRegistered)];
+
+				int index = cache.get(buffer);
+				if (index < static_cast<int>(numRegistered)) {
+					std::cout << "Unregistered buffer evicted a registered buffer"
+						  << std::endl;
+					return TestFail;
+				}
+
+				cache.put(index);
+			}
+		}
+
+		return TestPass;
+	}
+
 	int init() override
 	{
 		std::random_device rd;
@@ -240,6 +320,12 @@ public:
 		if (testIsEmpty(buffers) != TestPass)
 			return TestFail;
 
+		if (testBusy(buffers) != TestPass)
+			return TestFail;
+
+		if (testRegistered(buffers) != TestPass)
+			return TestFail;
+
 		return TestPass;
 	}
 
@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * V4L2BufferCache benchmark
+ *
+ * Measure the cost of looking up the V4L2 buffer index of a FrameBuffer, when
+ * the cache has an entry per buffer and the lookup hits, and when the
+ * application cycles through more buffers than the cache has entries. Run with
+ * 'meson test --benchmark buffer_cache_benchmark -v'.
+ */
+
+#include <iostream>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "benchmark.h"
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+using benchmark::Clock;
+using benchmark::nsPerOperation;
+
+class BufferCacheBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		for (unsigned int i = 0; i < kNumBuffers; ++i) {
+			UniqueFD fd(memfd_create("buffer-cache-benchmark", MFD_CLOEXEC));
+			if (!fd.isValid() || ftruncate(fd.get(), 4096) < 0) {
+				cerr << "Failed to allocate buffer" << endl;
+				return TestFail;
+			}
+
+			FrameBuffer::Plane plane;
+			plane.fd = SharedFD(std::move(fd));
+			plane.offset = 0;
+			plane.length = 4096;
+
+			buffers_.push_back(make_unique<FrameBuffer>(vector<FrameBuffer::Plane>{ plane }));
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		table_.printHeader();
+
+		int ret = benchmark("populated, 8 entries", kNumBuffers, true);
+		if (ret != TestPass)
+			return ret;
+
+		ret = benchmark("empty, 8 entries", kNumBuffers, false);
+		if (ret != TestPass)
+			return ret;
+
+		/* Cycle through more buffers than entries, all lookups miss. */
+		return benchmark("empty, 4 entries", kNumBuffers / 2, false);
+	}
+
+private:
+	int benchmark(const char *name, unsigned int numEntries, bool populate)
+	{
+		vector<const FrameBuffer *> buffers;
+		for (const unique_ptr<FrameBuffer> &buffer : buffers_)
+			buffers.push_back(buffer.get());
+
+		/* A populated cache is filled with the buffers at creation time. */
+		unique_ptr<V4L2BufferCache> cache;
+		if (populate)
+			cache = make_unique<V4L2BufferCache>(numEntries, buffers);
+		else
+			cache = make_unique<V4L2BufferCache>(numEntries);
+
+		Clock::time_point start = Clock::now();
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			int index = cache->get(*buffers_[i % kNumBuffers]);
+			if (index < 0) {
+				cerr << "Failed lookup from cache" << endl;
+				return TestFail;
+			}
+
+			cache->put(index);
+		}
+
+		Clock::duration duration = Clock::now() - start;
+
+		table_.printRow(name, nsPerOperation(duration, kIterations));
+
+		return TestPass;
+	}
+
+	static constexpr unsigned int kNumBuffers = 8;
+	static constexpr unsigned int kIterations = 1000000;
+
+	const benchmark::Table table_{ { { "cache", 32 }, { "ns/op", 12 } } };
+
+	vector<unique_ptr<FrameBuffer>> buffers_;
+};
+
+TEST_REGISTER(BufferCacheBenchmark)
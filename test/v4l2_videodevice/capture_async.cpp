@@ -6,6 +6,7 @@
  */
 
 #include <iostream>
+#include <vector>
 
 #include <libcamera/framebuffer.h>
 
@@ -50,11 +51,13 @@ protected:
 
 		capture_->bufferReady.connect(this, &CaptureAsyncTest::receiveBuffer);
 
-		for (const std::unique_ptr<FrameBuffer> &buffer : buffers_) {
-			if (capture_->queueBuffer(buffer.get())) {
-				std::cout << "Failed to queue buffer" << std::endl;
-				return TestFail;
-			}
+		std::vector<FrameBuffer *> buffers;
+		for (const std::unique_ptr<FrameBuffer> &buffer : buffers_)
+			buffers.push_back(buffer.get());
+
+		if (capture_->queueBuffers(buffers)) {
+			std::cout << "Failed to queue buffers" << std::endl;
+			return TestFail;
 		}
 
 		ret = capture_->streamOn();
@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Ideas on Board Oy
+ *
+ * libcamera V4L2 dequeue poller test
+ */
+
+#include <iostream>
+#include <vector>
+
+#include <libcamera/framebuffer.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "libcamera/internal/v4l2_dequeue_poller.h"
+
+#include "v4l2_videodevice_test.h"
+
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+class DequeuePollerTest : public V4L2VideoDeviceTest
+{
+public:
+	DequeuePollerTest()
+		: V4L2VideoDeviceTest("vimc", "Raw Capture 0"), thread_(nullptr),
+		  frames_(0), wrongThread_(false), cancelled_(0) {}
+
+protected:
+	int run()
+	{
+		constexpr unsigned int bufferCount = 8;
+		constexpr unsigned int nFrames = 30;
+
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		V4L2DequeuePoller poller("test:dqbuf");
+		Timer timeout;
+
+		thread_ = Thread::current();
+
+		int ret = capture_->allocateBuffers(bufferCount, &buffers_);
+		if (ret < 0) {
+			std::cout << "Failed to allocate buffers" << std::endl;
+			return TestFail;
+		}
+
+		capture_->setDequeuePoller(&poller);
+		capture_->bufferReady.connect(this, &DequeuePollerTest::receiveBuffer);
+
+		std::vector<FrameBuffer *> buffers;
+		for (const std::unique_ptr<FrameBuffer> &buffer : buffers_)
+			buffers.push_back(buffer.get());
+
+		if (capture_->queueBuffers(buffers)) {
+			std::cout << "Failed to queue buffers" << std::endl;
+			return TestFail;
+		}
+
+		ret = capture_->streamOn();
+		if (ret)
+			return TestFail;
+
+		timeout.start(500ms * nFrames);
+		while (timeout.isRunning()) {
+			dispatcher->processEvents();
+			if (frames_ > nFrames)
+				break;
+		}
+
+		ret = capture_->streamOff();
+		if (ret)
+			return TestFail;
+
+		if (frames_ < nFrames) {
+			std::cout << "Failed to capture " << nFrames
+				  << " frames within timeout." << std::endl;
+			return TestFail;
+		}
+
+		if (wrongThread_) {
+			std::cout << "Buffer completed in the wrong thread" << std::endl;
+			return TestFail;
+		}
+
+		/* All buffers are requeued, they must all be cancelled. */
+		if (cancelled_ != bufferCount) {
+			std::cout << "Cancelled " << cancelled_ << " buffers, expected "
+				  << bufferCount << std::endl;
+			return TestFail;
+		}
+
+		capture_->setDequeuePoller(nullptr);
+
+		return TestPass;
+	}
+
+private:
+	void receiveBuffer(FrameBuffer *buffer)
+	{
+		if (Thread::current() != thread_)
+			wrongThread_ = true;
+
+		if (buffer->metadata().status == FrameMetadata::FrameCancelled) {
+			cancelled_++;
+			return;
+		}
+
+		frames_++;
+
+		/* Requeue the buffer for further use. */
+		capture_->queueBuffer(buffer);
+	}
+
+	Thread *thread_;
+	unsigned int frames_;
+	bool wrongThread_;
+	unsigned int cancelled_;
+};
+
+TEST_REGISTER(DequeuePollerTest)
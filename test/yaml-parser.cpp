@@ -6,6 +6,7 @@
  */
 
 #include <array>
+#include <fcntl.h>
 #include <iostream>
 #include <map>
 #include <string>
@@ -547,6 +548,18 @@ protected:
 			return TestFail;
 		}
 
+		const auto &doubles = firstElement.getDoubleList();
+		if (!doubles || doubles->size() != 2 ||
+		    (*doubles)[0] != 1.0 || (*doubles)[1] != 2.0) {
+			cerr << "getDoubleList() failed to return correct values" << std::endl;
+			return TestFail;
+		}
+
+		if (listObj.getDoubleList() || level2Obj.getDoubleList()) {
+			cerr << "getDoubleList() accepted non-numeric list" << std::endl;
+			return TestFail;
+		}
+
 		auto &secondElement = level2Obj[1];
 		if (!secondElement.isDictionary() ||
 		    !secondElement.contains("one") ||
@@ -557,6 +570,63 @@ protected:
 			return TestFail;
 		}
 
+		/* Test shared parsing */
+		file.close();
+		if (!file.open(File::OpenModeFlag::ReadOnly)) {
+			cerr << "Fail to reopen test YAML file" << std::endl;
+			return TestFail;
+		}
+
+		std::shared_ptr<const YamlObject> shared = YamlParser::parseShared(file);
+		if (!shared || !shared->contains("level1")) {
+			cerr << "Fail to parse test YAML file as shared" << std::endl;
+			return TestFail;
+		}
+
+		if (YamlParser::parseShared(file) != shared) {
+			cerr << "Shared YAML content not reused" << std::endl;
+			return TestFail;
+		}
+
+		const string extraYaml = "extra: 1\n";
+		int fd = open(testYamlFile_.c_str(), O_WRONLY | O_APPEND);
+		if (fd == -1)
+			return TestFail;
+
+		int ret = write(fd, extraYaml.c_str(), extraYaml.size());
+		close(fd);
+		if (ret != static_cast<int>(extraYaml.size()))
+			return TestFail;
+
+		file.close();
+		if (!file.open(File::OpenModeFlag::ReadOnly)) {
+			cerr << "Fail to reopen test YAML file" << std::endl;
+			return TestFail;
+		}
+
+		std::shared_ptr<const YamlObject> updated = YamlParser::parseShared(file);
+		if (!updated || updated == shared || !updated->contains("extra")) {
+			cerr << "Shared YAML content not invalidated" << std::endl;
+			return TestFail;
+		}
+
+		/* Test parsing selected keys */
+		file.close();
+		if (!file.open(File::OpenModeFlag::ReadOnly)) {
+			cerr << "Fail to reopen test YAML file" << std::endl;
+			return TestFail;
+		}
+
+		static const std::array<std::string, 2> keys = { "uint8_t", "level1" };
+		std::unique_ptr<YamlObject> filtered = YamlParser::parse(file, keys);
+		if (!filtered || filtered->size() != keys.size() ||
+		    (*filtered)["uint8_t"].get<uint8_t>(0) != 100 ||
+		    (*filtered)["level1"]["level2"][1]["two"].get<int32_t>(0) != 2 ||
+		    filtered->contains("list") || filtered->contains("dictionary")) {
+			cerr << "Fail to parse selected keys of test YAML file" << std::endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
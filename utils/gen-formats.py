@@ -53,15 +53,16 @@ class DRMFourCC(object):
 
 
 def generate_h(formats, drm_fourcc):
-    template = string.Template('constexpr PixelFormat ${name}{ __fourcc(${fourcc}), __mod(${mod}) };')
+    template = string.Template('constexpr PixelFormat ${name}{ ${fourcc}, __mod(${mod}) };')
 
     fmts = []
 
     for format in formats:
         name, format = format.popitem()
-        fourcc = drm_fourcc.fourcc(format['fourcc'])
-        if format.get('big-endian'):
-            fourcc += '| DRM_FORMAT_BIG_ENDIAN'
+        fourcc = '__fourcc(%s)' % drm_fourcc.fourcc(format['fourcc'])
+        # DRM_FORMAT_BIG_ENDIAN, drm_fourcc.h isn't included by formats.h
+        if format.get('big_endian'):
+            fourcc += ' | (1U << 31)'
 
         data = {
             'name': name,
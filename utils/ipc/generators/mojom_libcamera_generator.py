@@ -212,6 +212,14 @@ def IsAsync(method):
             return True
     return False
 
+def IsBatched(method):
+    if method.attributes is None:
+        return False
+    return 'batch' in method.attributes and method.attributes['batch']
+
+def HasBatchedMethods(interface):
+    return len([x for x in interface.methods if IsBatched(x)]) > 0
+
 def IsArray(element):
     return mojom.IsArrayKind(element.kind)
 
@@ -258,6 +266,16 @@ def IsPod(element):
 def IsStr(element):
     return element.kind.spec == 's'
 
+# Structs whose fields are all PODs or enums can be serialized with a single
+# memcpy() when their in-memory layout matches the packed wire format.
+def IsTriviallySerializable(element):
+    if len(element.fields) == 0:
+        return False
+    return all((IsPod(x) or IsEnum(x)) and not IsFlags(x) for x in element.fields)
+
+def PackedSize(element):
+    return sum([int(BitWidth(x)) // 8 for x in element.fields])
+
 def BitWidth(element):
     if element.kind in _bit_widths:
         return _bit_widths[element.kind]
@@ -410,6 +428,15 @@ def ValidateInterfaces(interfaces):
         ValidateZeroLength(method.response_parameters,
                            f'{method.mojom_name} response parameters', False)
 
+    # Validate that batched methods are async methods of the main interface
+    for method in intf.methods:
+        if IsBatched(method) and not IsAsync(method):
+            raise Exception(f'{method.mojom_name}: batch attribute requires async')
+
+    for method in event.methods:
+        if IsBatched(method):
+            raise Exception(f'{method.mojom_name}: events can\'t be batched')
+
     event_methods_async = [x for x in event.methods if IsAsync(x)]
     for method in event_methods_async:
         ValidateZeroLength(method.response_parameters,
@@ -432,6 +459,7 @@ class Generator(generator.Generator):
             'has_default_fields': HasDefaultFields,
             'has_fd': HasFd,
             'is_async': IsAsync,
+            'is_batched': IsBatched,
             'is_array': IsArray,
             'is_controls': IsControls,
             'is_enum': IsEnum,
@@ -443,6 +471,7 @@ class Generator(generator.Generator):
             'is_pod': IsPod,
             'is_scoped': IsScoped,
             'is_str': IsStr,
+            'is_trivially_serializable': IsTriviallySerializable,
             'method_input_has_fd': MethodInputHasFd,
             'method_output_has_fd': MethodOutputHasFd,
             'method_param_names': MethodParamNames,
@@ -453,6 +482,7 @@ class Generator(generator.Generator):
             'name': GetNameForElement,
             'name_full': GetFullNameForElement,
             'needs_control_serializer': NeedsControlSerializer,
+            'packed_size': PackedSize,
             'params_comma_sep': ParamsCommaSep,
             'with_default_values': WithDefaultValues,
             'with_fds': WithFds,
@@ -466,6 +496,7 @@ class Generator(generator.Generator):
             'consts': self.module.constants,
             'enums': self.module.enums,
             'has_array': len([x for x in self.module.kinds.keys() if x[0] == 'a']) > 0,
+            'has_batch': HasBatchedMethods(GetMainInterface(self.module.interfaces)),
             'has_map': len([x for x in self.module.kinds.keys() if x[0] == 'm']) > 0,
             'has_namespace': self.module.mojom_namespace != '',
             'interface_event': GetEventInterface(self.module.interfaces),
@@ -17,27 +17,164 @@ timestamps = {}
 # pipeline:function -> samples[]
 samples = {}
 
+# stage -> samples[], for the per-stage latency breakdown
+stages = {}
+
+# name -> values[], for the queue depths
+depths = {}
+
+
+class StageTracker(object):
+    """Match the begin and end events of a stage through a key"""
+
+    def __init__(self, name):
+        self.name = name
+        self.pending = {}
+
+    def begin(self, key, timestamp_ns):
+        self.pending[key] = timestamp_ns
+
+    def end(self, key, timestamp_ns, name=None):
+        ts = self.pending.pop(key, None)
+        if ts is None:
+            return
+
+        add_sample(stages, name or self.name, timestamp_ns - ts)
+
+
+def add_sample(table, key, value):
+    if key not in table:
+        table[key] = []
+    table[key].append(value)
+
+
+def field(msg, name):
+    return msg.event.payload_field[name]
+
+
+# Last dequeue time of each buffer, to measure how long buffers wait before
+# being processed by the next stage.
+dequeued = {}
+
+v4l2 = StageTracker('v4l2 qbuf -> dqbuf')
+waiting = StageTracker('request queue -> device queue')
+device = StageTracker('request device queue -> complete')
+controls = StageTracker('delayed controls push -> apply')
+debayer = StageTracker('soft isp debayer')
+converter = StageTracker('converter queue -> complete')
+
+
+def process_pipeline_event(msg, timestamp_ns):
+    event = msg.event.name
+    ts = timestamp_ns
+
+    if event == 'libcamera:v4l2_qbuf':
+        v4l2.begin((str(field(msg, 'device')), int(field(msg, 'buffer'))), ts)
+
+    elif event == 'libcamera:v4l2_dqbuf':
+        dev = str(field(msg, 'device'))
+        buf = int(field(msg, 'buffer'))
+        v4l2.end((dev, buf), ts, f'v4l2 qbuf -> dqbuf ({dev})')
+        dequeued[buf] = ts
+
+    elif event == 'libcamera:request_queue':
+        waiting.begin(int(field(msg, 'request')), ts)
+
+    elif event == 'libcamera:request_device_queue':
+        req = int(field(msg, 'request'))
+        waiting.end(req, ts)
+        device.begin(req, ts)
+
+    elif event in ['libcamera:request_complete', 'libcamera:request_cancel']:
+        device.end(int(field(msg, 'request')), ts)
+
+    elif event == 'libcamera:request_queue_depth':
+        add_sample(depths, 'requests waiting', int(field(msg, 'waiting')))
+        add_sample(depths, 'requests queued', int(field(msg, 'queued')))
+
+    elif event == 'libcamera:delayed_controls_push':
+        controls.begin((str(field(msg, 'device')), int(field(msg, 'index'))), ts)
+
+    elif event == 'libcamera:delayed_controls_apply':
+        dev = str(field(msg, 'device'))
+        controls.end((dev, int(field(msg, 'sequence'))), ts,
+                     f'delayed controls push -> apply ({dev})')
+
+    elif event == 'libcamera:debayer_begin':
+        buf = int(field(msg, 'input'))
+        if buf in dequeued:
+            add_sample(stages, 'soft isp dqbuf -> debayer', ts - dequeued.pop(buf))
+        debayer.begin(int(field(msg, 'output')), ts)
+
+    elif event == 'libcamera:debayer_end':
+        debayer.end(int(field(msg, 'output')), ts)
+
+    elif event == 'libcamera:converter_queue':
+        buf = int(field(msg, 'input'))
+        if buf in dequeued:
+            add_sample(stages, 'converter dqbuf -> queue', ts - dequeued.pop(buf))
+        converter.begin((int(field(msg, 'stream')), int(field(msg, 'output'))), ts)
+
+    elif event == 'libcamera:converter_complete':
+        converter.end((int(field(msg, 'stream')), int(field(msg, 'output'))), ts)
+
+    elif event == 'libcamera:ipa_algorithm_timing':
+        key = f'ipa {field(msg, "algorithm_name")}:{field(msg, "function_name")}'
+        add_sample(stages, key, int(field(msg, 'duration_ns')))
+
+
+def print_table(header, table):
+    rows = []
+    rows.append([header, 'min', 'max', 'mean', 'stddev'])
+    for k, v in table.items():
+        mean = int(stats.mean(v))
+        stddev = int(stats.stdev(v)) if len(v) > 1 else 0
+        minv = min(v)
+        maxv = max(v)
+        rows.append([k, str(minv), str(maxv), str(mean), str(stddev)])
+
+    # Get maximum string width for every column
+    widths = []
+    for i in range(len(rows[0])):
+        widths.append(max([len(row[i]) for row in rows]))
+
+    # Print stats table
+    for row in rows:
+        fmt = [row[i].rjust(widths[i]) for i in range(1, 5)]
+        print('{} {} {} {} {}'.format(row[0].ljust(widths[0]), *fmt))
+
+
 def main(argv):
     parser = argparse.ArgumentParser(
-            description='A simple analysis script to get statistics on time taken for IPA calls')
+            description='A simple analysis script to get statistics on time taken for IPA calls'
+                        ' and for the stages of the frame pipeline')
     parser.add_argument('-p', '--pipeline', type=str,
                         help='Name of pipeline to filter for')
+    parser.add_argument('-s', '--stages', action='store_true',
+                        help='Print the per-stage latency breakdown of the frame pipeline')
     parser.add_argument('trace_path', type=str,
                         help='Path to lttng trace (eg. ~/lttng-traces/demo-20201029-184003)')
     args = parser.parse_args(argv[1:])
 
     traces = bt2.TraceCollectionMessageIterator(args.trace_path)
     for msg in traces:
-        if type(msg) is not bt2._EventMessageConst or \
-           'pipeline_name' not in msg.event.payload_field or \
-           (args.pipeline is not None and \
-            msg.event.payload_field['pipeline_name'] != args.pipeline):
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+
+        timestamp_ns = msg.default_clock_snapshot.ns_from_origin
+
+        if 'pipeline_name' not in msg.event.payload_field:
+            if args.stages:
+                process_pipeline_event(msg, timestamp_ns)
+            continue
+
+        if args.pipeline is not None and \
+           msg.event.payload_field['pipeline_name'] != args.pipeline:
             continue
 
         pipeline = msg.event.payload_field['pipeline_name']
         event = msg.event.name
         func = msg.event.payload_field['function_name']
-        timestamp_ns = msg.default_clock_snapshot.ns_from_origin
 
         if event == 'libcamera:ipa_call_begin':
             if pipeline not in timestamps:
@@ -54,24 +191,20 @@ def main(argv):
             samples[key].append(timestamp_ns - ts)
 
     # Compute stats
-    rows = []
-    rows.append(['pipeline:function', 'min', 'max', 'mean', 'stddev'])
-    for k, v in samples.items():
-        mean = int(stats.mean(v))
-        stddev = int(stats.stdev(v))
-        minv = min(v)
-        maxv = max(v)
-        rows.append([k, str(minv), str(maxv), str(mean), str(stddev)])
+    print_table('pipeline:function', samples)
 
-    # Get maximum string width for every column
-    widths = []
-    for i in range(len(rows[0])):
-        widths.append(max([len(row[i]) for row in rows]))
+    if not args.stages:
+        return 0
+
+    print()
+    print_table('stage (ns)', stages)
+
+    if depths:
+        print()
+        print_table('queue depth', depths)
+
+    return 0
 
-    # Print stats table
-    for row in rows:
-        fmt = [row[i].rjust(widths[i]) for i in range(1, 5)]
-        print('{} {} {} {} {}'.format(row[0].ljust(widths[0]), *fmt))
 
 if __name__ == '__main__':
     sys.exit(main(sys.argv))